@@ -0,0 +1,241 @@
+#include "bench_common.h"
+#include "kitchen_sink_gen.h"
+#include <cstddef>
+#include <cstdio>
+#include <type_traits>
+
+// --- Generated Code vs Interpreter ---
+//
+// The kitchen_sink schema is compiled and turned into C by `cnd gen-c` at
+// build time (see CMakeLists.txt). The interpreter runs the same IL against
+// the generated struct through a binding table, so both sides read and write
+// identical host memory and must produce identical bytes.
+
+static bool LoadKitchenSink(std::vector<uint8_t>& il, cnd_program* program) {
+    FILE* f = fopen(CND_KITCHEN_SINK_IL, "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    il.resize(size > 0 ? (size_t)size : 0);
+    size_t got = fread(il.data(), 1, il.size(), f);
+    fclose(f);
+    return got == il.size() && cnd_program_load_il(program, il.data(), il.size()) == CND_ERR_OK;
+}
+
+#define KS_BIND(name, ...) do { \
+        cnd_binding e_ = {__VA_ARGS__}; \
+        cnd_binding_set(table, count, program, name, &e_); \
+    } while (0)
+
+static void BindKitchenSink(const cnd_program* program, cnd_binding* table, uint16_t count) {
+    typedef decltype(KitchenSink::waypoints[0]) WaypointRef;
+    typedef std::remove_reference<WaypointRef>::type Waypoint;
+    const uint32_t str = KITCHENSINK_MAX_STRING + 1;
+
+    KS_BIND("magic", offsetof(KitchenSink, magic), 0, 0, 0, OP_IO_U32, 0);
+    KS_BIND("flags_a", offsetof(KitchenSink, flags_a), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("flag_b", offsetof(KitchenSink, flag_b), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("val_c", offsetof(KitchenSink, val_c), 0, 0, 0, OP_IO_I8, 0);
+    KS_BIND("timestamp", offsetof(KitchenSink, timestamp), 0, 0, 0, OP_IO_I64, 0);
+    // Nested fields bind flat (struct frame at the root) so expressions that
+    // read position.x from the top level find the same storage
+    KS_BIND("position", 0, 0, 0, 0, OP_ENTER_STRUCT, 0);
+    KS_BIND("position.x", offsetof(KitchenSink, position.x), 0, 0, 0, OP_IO_F32, 0);
+    KS_BIND("position.y", offsetof(KitchenSink, position.y), 0, 0, 0, OP_IO_F32, 0);
+    KS_BIND("position.z", offsetof(KitchenSink, position.z), 0, 0, 0, OP_IO_F32, 0);
+    KS_BIND("waypoints", offsetof(KitchenSink, waypoints), sizeof(Waypoint), 4, 0, OP_ENTER_STRUCT, 0);
+    KS_BIND("waypoints.x", offsetof(Waypoint, x), 0, 0, 0, OP_IO_F32, 0);
+    KS_BIND("waypoints.y", offsetof(Waypoint, y), 0, 0, 0, OP_IO_F32, 0);
+    KS_BIND("waypoints.z", offsetof(Waypoint, z), 0, 0, 0, OP_IO_F32, 0);
+    KS_BIND("matrix", offsetof(KitchenSink, matrix), 1, 4, 0, OP_IO_U8, 0);
+    KS_BIND("points", offsetof(KitchenSink, points), sizeof(uint16_t), KITCHENSINK_MAX_ARRAY,
+            offsetof(KitchenSink, points_count), OP_IO_U16, OP_IO_U8);
+    KS_BIND("name", offsetof(KitchenSink, name), 0, sizeof(KitchenSink::name), 0, OP_STR_NULL, 0);
+    KS_BIND("status", offsetof(KitchenSink, status), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("confidence", offsetof(KitchenSink, confidence), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("error_code", offsetof(KitchenSink, error_code), 0, 0, 0, OP_IO_U16, 0);
+    KS_BIND("reason", offsetof(KitchenSink, reason), 0, str, 0, OP_STR_NULL, 0);
+    KS_BIND("percentage", offsetof(KitchenSink, percentage), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("temperature", offsetof(KitchenSink, temperature), 0, 0, 0, OP_IO_F64, 0);
+    KS_BIND("val_add", offsetof(KitchenSink, val_add), 0, 0, 0, OP_IO_I64, 0);
+    KS_BIND("val_sub", offsetof(KitchenSink, val_sub), 0, 0, 0, OP_IO_I64, 0);
+    KS_BIND("val_mul", offsetof(KitchenSink, val_mul), 0, 0, 0, OP_IO_I64, 0);
+    KS_BIND("val_div", offsetof(KitchenSink, val_div), 0, 0, 0, OP_IO_I64, 0);
+    KS_BIND("year", offsetof(KitchenSink, year), 0, 0, 0, OP_IO_I64, 0);
+    KS_BIND("poly_val", offsetof(KitchenSink, poly_val), 0, 0, 0, OP_IO_F64, 0);
+    KS_BIND("spline_val", offsetof(KitchenSink, spline_val), 0, 0, 0, OP_IO_F64, 0);
+    KS_BIND("expr_val", offsetof(KitchenSink, expr_val), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("bit_packed", 0, 0, 0, 0, OP_ENTER_STRUCT, 0);
+    KS_BIND("bit_packed.a_3bits", offsetof(KitchenSink, bit_packed.a_3bits), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("bit_packed.b_5bits", offsetof(KitchenSink, bit_packed.b_5bits), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("bit_packed.c_4bits", offsetof(KitchenSink, bit_packed.c_4bits), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("bit_packed.d_aligned", offsetof(KitchenSink, bit_packed.d_aligned), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("has_extra", offsetof(KitchenSink, has_extra), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("extra_data", offsetof(KitchenSink, extra_data), 0, str, 0, OP_STR_NULL, 0);
+    KS_BIND("adv_mode", offsetof(KitchenSink, adv_mode), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("adv_simple_val", offsetof(KitchenSink, adv_simple_val), 0, 0, 0, OP_IO_U16, 0);
+    KS_BIND("adv_has_details", offsetof(KitchenSink, adv_has_details), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("adv_details", offsetof(KitchenSink, adv_details), 0, str, 0, OP_STR_NULL, 0);
+    KS_BIND("adv_fallback_code", offsetof(KitchenSink, adv_fallback_code), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("dynamic_len", offsetof(KitchenSink, dynamic_len), 0, 0, 0, OP_IO_U16, 0);
+    KS_BIND("dynamic_bytes", offsetof(KitchenSink, dynamic_bytes), 1, KITCHENSINK_MAX_ARRAY, 0, OP_IO_U8, 0);
+    KS_BIND("str_count", offsetof(KitchenSink, str_count), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("dynamic_strings", offsetof(KitchenSink, dynamic_strings), str, KITCHENSINK_MAX_ARRAY, 0, OP_STR_NULL, 0);
+    KS_BIND("is_far_x", offsetof(KitchenSink, is_far_x), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("is_grounded", offsetof(KitchenSink, is_grounded), 0, 0, 0, OP_IO_U8, 0);
+    KS_BIND("rest_of_stream", offsetof(KitchenSink, rest_of_stream), 1, KITCHENSINK_MAX_ARRAY, 0, OP_IO_U8, 0);
+}
+
+// The sample values of examples/kitchen_sink
+static void FillKitchenSink(KitchenSink* k) {
+    memset(k, 0, sizeof(*k));
+    k->magic = 0xCAFEBABE;
+    k->flags_a = 1;
+    k->flag_b = 1;
+    k->val_c = -5;
+    k->timestamp = 123456789;
+    k->position.x = 1.0f;
+    k->position.y = 2.0f;
+    k->position.z = 3.0f;
+    for (int i = 0; i < 4; i++) {
+        k->waypoints[i].x = 10.0f + 30.0f * i;
+        k->waypoints[i].y = 20.0f + 30.0f * i;
+        k->waypoints[i].z = 30.0f + 30.0f * i;
+        k->matrix[i] = (uint8_t)(i + 1);
+    }
+    k->points_count = 3;
+    k->points[0] = 10;
+    k->points[1] = 20;
+    k->points[2] = 30;
+    strcpy(k->name, "Manual Demo");
+    k->confidence = 100;
+    k->percentage = 50;
+    k->temperature = 25.5;
+    k->val_add = 10;
+    k->val_sub = 20;
+    k->val_mul = 6;
+    k->val_div = 40;
+    k->year = 2025;
+    k->poly_val = 75.0;
+    k->spline_val = 50.0;
+    k->bit_packed.a_3bits = 7;
+    k->bit_packed.b_5bits = 31;
+    k->bit_packed.c_4bits = 15;
+    k->bit_packed.d_aligned = 255;
+    k->has_extra = 1;
+    strcpy(k->extra_data, "Manual Extra");
+    k->adv_simple_val = 777;
+    k->dynamic_len = 5;
+    for (int i = 0; i < 5; i++) k->dynamic_bytes[i] = (uint8_t)(0xAA + 0x11 * i);
+    k->str_count = 2;
+    strcpy(k->dynamic_strings[0], "Hello");
+    strcpy(k->dynamic_strings[1], "World");
+    k->rest_of_stream_count = 4;
+    k->rest_of_stream[0] = 0xDE;
+    k->rest_of_stream[1] = 0xAD;
+    k->rest_of_stream[2] = 0xBE;
+    k->rest_of_stream[3] = 0xEF;
+}
+
+struct KitchenSinkBench {
+    std::vector<uint8_t> il;
+    cnd_program program;
+    cnd_binding table[64];
+    KitchenSink data;
+    std::vector<uint8_t> packet; // Encoded by the generated code
+    bool ok;
+
+    KitchenSinkBench() : program(), table(), data(), ok(false) {
+        if (!LoadKitchenSink(il, &program)) return;
+        BindKitchenSink(&program, table, 64);
+        FillKitchenSink(&data);
+
+        // Until-EOF arrays run to the end of the buffer, so the packet length
+        // is the buffer length for both sides
+        uint8_t buf[1024];
+        size_t len = 0;
+        if (KitchenSink_encode(&data, buf, sizeof(buf), &len) != CND_GEN_OK) return;
+        packet.assign(buf, buf + len);
+
+        std::vector<uint8_t> vm(len);
+        cnd_binder binder;
+        cnd_binder_init(&binder, table, 64, &data);
+        cnd_vm_ctx ctx;
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, vm.data(), vm.size(), cnd_bind_io, &binder);
+        if (cnd_execute(&ctx) != CND_ERR_OK || vm != packet) return;
+
+        KitchenSink a, b;
+        memset(&a, 0, sizeof(a));
+        memset(&b, 0, sizeof(b));
+        size_t used = 0;
+        if (KitchenSink_decode(&a, packet.data(), packet.size(), &used) != CND_GEN_OK || used != len) return;
+        cnd_binder_init(&binder, table, 64, &b);
+        cnd_init(&ctx, CND_MODE_DECODE, &program, packet.data(), packet.size(), cnd_bind_io, &binder);
+        if (cnd_execute(&ctx) != CND_ERR_OK) return;
+        b.rest_of_stream_count = a.rest_of_stream_count; // Not reported by the binder
+        ok = memcmp(&a, &b, sizeof(a)) == 0;
+    }
+};
+
+static KitchenSinkBench& KitchenSinkFixture() {
+    static KitchenSinkBench bench;
+    return bench;
+}
+
+static void BM_KitchenSinkEncodeVM(benchmark::State& state) {
+    KitchenSinkBench& ks = KitchenSinkFixture();
+    if (!ks.ok) { state.SkipWithError("kitchen_sink setup failed"); return; }
+    std::vector<uint8_t> buffer(ks.packet.size());
+    cnd_binder binder;
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        cnd_binder_init(&binder, ks.table, 64, &ks.data);
+        cnd_init(&ctx, CND_MODE_ENCODE, &ks.program, buffer.data(), buffer.size(), cnd_bind_io, &binder);
+        benchmark::DoNotOptimize(cnd_execute(&ctx));
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)buffer.size());
+}
+BENCHMARK(BM_KitchenSinkEncodeVM);
+
+static void BM_KitchenSinkEncodeGenerated(benchmark::State& state) {
+    KitchenSinkBench& ks = KitchenSinkFixture();
+    if (!ks.ok) { state.SkipWithError("kitchen_sink setup failed"); return; }
+    std::vector<uint8_t> buffer(ks.packet.size());
+    size_t len;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(KitchenSink_encode(&ks.data, buffer.data(), buffer.size(), &len));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)buffer.size());
+}
+BENCHMARK(BM_KitchenSinkEncodeGenerated);
+
+static void BM_KitchenSinkDecodeVM(benchmark::State& state) {
+    KitchenSinkBench& ks = KitchenSinkFixture();
+    if (!ks.ok) { state.SkipWithError("kitchen_sink setup failed"); return; }
+    KitchenSink out;
+    cnd_binder binder;
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        cnd_binder_init(&binder, ks.table, 64, &out);
+        cnd_init(&ctx, CND_MODE_DECODE, &ks.program, ks.packet.data(), ks.packet.size(), cnd_bind_io, &binder);
+        benchmark::DoNotOptimize(cnd_execute(&ctx));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)ks.packet.size());
+}
+BENCHMARK(BM_KitchenSinkDecodeVM);
+
+static void BM_KitchenSinkDecodeGenerated(benchmark::State& state) {
+    KitchenSinkBench& ks = KitchenSinkFixture();
+    if (!ks.ok) { state.SkipWithError("kitchen_sink setup failed"); return; }
+    KitchenSink out;
+    size_t len;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(KitchenSink_decode(&out, ks.packet.data(), ks.packet.size(), &len));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)ks.packet.size());
+}
+BENCHMARK(BM_KitchenSinkDecodeGenerated);
@@ -18,7 +18,7 @@
 #define NULL_DEVICE "/dev/null"
 #endif
 
-void CompileSchema(const char* schema, std::vector<uint8_t>& bytecode) {
+void CompileSchema(const char* schema, std::vector<uint8_t>& bytecode, int opt_level) {
     // We use a temporary file for compilation as the compiler API currently works with files
     FILE* f = fopen("bench_temp.cnd", "wb");
     if (!f) {
@@ -36,7 +36,7 @@ void CompileSchema(const char* schema, std::vector<uint8_t>& bytecode) {
     dup2(null_fd, STDERR_FILENO);
     close(null_fd);
 
-    int res = cnd_compile_file("bench_temp.cnd", "bench_temp.il", 0, 0);
+    int res = cnd_compile_file_ex("bench_temp.cnd", "bench_temp.il", 0, 0, opt_level);
 
     dup2(stdout_fd, STDOUT_FILENO);
     dup2(stderr_fd, STDERR_FILENO);
@@ -127,3 +127,23 @@ cnd_error_t bench_io_callback_complex(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t
     }
     return CND_ERR_OK;
 }
+
+void BenchDispatchArgs(benchmark::internal::Benchmark* b) {
+    b->ArgName("threaded")->Arg(0)->Arg(1);
+}
+
+cnd_dispatch_t BenchDispatch(benchmark::State& state) {
+    cnd_dispatch_t dispatch = state.range(0) ? CND_DISPATCH_THREADED : CND_DISPATCH_SWITCH;
+
+    // Probe with a one-instruction program so unsupported variants are reported, not timed
+    static const uint8_t noop = OP_NOOP;
+    uint8_t scratch[1];
+    cnd_program probe;
+    cnd_vm_ctx ctx;
+    cnd_program_load(&probe, &noop, 1);
+    cnd_init(&ctx, CND_MODE_ENCODE, &probe, scratch, sizeof(scratch), NULL, NULL);
+    if (cnd_execute_dispatch(&ctx, dispatch) != CND_ERR_OK) {
+        state.SkipWithError("dispatch variant not compiled in");
+    }
+    return dispatch;
+}
@@ -5,7 +5,8 @@
 #include <vector>
 #include <cstring>
 
-void CompileSchema(const char* schema, std::vector<uint8_t>& bytecode);
+// An `opt_level` above 0 runs the IL optimizer, as `cnd compile -O` does
+void CompileSchema(const char* schema, std::vector<uint8_t>& bytecode, int opt_level = 0);
 
 struct BenchData {
     uint32_t id;
@@ -21,3 +22,8 @@ struct BenchContext {
 };
 
 cnd_error_t bench_io_callback_complex(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr);
+
+// Dispatch variants: register with ->Apply(BenchDispatchArgs) and run the VM
+// through cnd_execute_dispatch(&ctx, BenchDispatch(state)).
+void BenchDispatchArgs(benchmark::internal::Benchmark* b);
+cnd_dispatch_t BenchDispatch(benchmark::State& state);
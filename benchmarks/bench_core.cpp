@@ -1,4 +1,6 @@
 #include "bench_common.h"
+#include <cstddef>
+#include <string>
 
 // --- Nested Struct Benchmark ---
 
@@ -38,6 +40,7 @@ static cnd_error_t bench_io_callback_nested(cnd_vm_ctx* ctx, uint16_t key_id, ui
 }
 
 static void BM_EncodeNested(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema(
         "struct Point { float x; float y; float z; }"
@@ -57,12 +60,13 @@ static void BM_EncodeNested(benchmark::State& state) {
     for (auto _ : state) {
         memset(buffer, 0, sizeof(buffer));
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_nested, &bc);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EncodeNested);
+BENCHMARK(BM_EncodeNested)->Apply(BenchDispatchArgs);
 
 static void BM_DecodeNested(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema(
         "struct Point { float x; float y; float z; }"
@@ -81,16 +85,16 @@ static void BM_DecodeNested(benchmark::State& state) {
     
     // Pre-encode
     cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_nested, &bc);
-    cnd_execute(&ctx);
+    cnd_execute_dispatch(&ctx, dispatch);
     size_t encoded_size = ctx.cursor;
 
     for (auto _ : state) {
         BenchNestedContext out_bc;
         cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_io_callback_nested, &out_bc);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_DecodeNested);
+BENCHMARK(BM_DecodeNested)->Apply(BenchDispatchArgs);
 
 // --- Array of Structs Benchmark ---
 
@@ -175,6 +179,7 @@ static cnd_error_t bench_io_callback_array_struct(cnd_vm_ctx* ctx, uint16_t key_
 }
 
 static void BM_EncodeArrayStruct(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema(
         "struct Item { uint32 id; uint16 val; }"
@@ -193,12 +198,13 @@ static void BM_EncodeArrayStruct(benchmark::State& state) {
     for (auto _ : state) {
         memset(buffer, 0, sizeof(buffer));
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_array_struct, &bc);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EncodeArrayStruct);
+BENCHMARK(BM_EncodeArrayStruct)->Apply(BenchDispatchArgs);
 
 static void BM_DecodeArrayStruct(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema(
         "struct Item { uint32 id; uint16 val; }"
@@ -216,18 +222,95 @@ static void BM_DecodeArrayStruct(benchmark::State& state) {
     
     // Pre-encode
     cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_array_struct, &bc);
-    cnd_execute(&ctx);
+    cnd_execute_dispatch(&ctx, dispatch);
     size_t encoded_size = ctx.cursor;
 
     for (auto _ : state) {
         BenchArrayStructContext out_bc;
         cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_io_callback_array_struct, &out_bc);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
+    }
+}
+BENCHMARK(BM_DecodeArrayStruct)->Apply(BenchDispatchArgs);
+
+// Same schema served from a binding table instead of a callback
+static void BindItemList(const cnd_program* program, cnd_binding* table, uint16_t count) {
+    cnd_binding items = {offsetof(ItemList, items), sizeof(Item), 100, 0, OP_ENTER_STRUCT, 0};
+    cnd_binding id = {offsetof(Item, id), 0, 0, 0, OP_IO_U32, 0};
+    cnd_binding val = {offsetof(Item, val), 0, 0, 0, OP_IO_U16, 0};
+    cnd_binding_set(table, count, program, "items", &items);
+    cnd_binding_set(table, count, program, "items.id", &id);
+    cnd_binding_set(table, count, program, "items.val", &val);
+}
+
+static void BM_EncodeArrayStructBound(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
+    std::vector<uint8_t> bytecode;
+    CompileSchema(
+        "struct Item { uint32 id; uint16 val; }"
+        "packet List { Item items[100]; }", 
+        bytecode);
+    
+    cnd_program program;
+    cnd_program_load_il(&program, bytecode.data(), bytecode.size());
+
+    cnd_binding table[8] = {};
+    BindItemList(&program, table, 8);
+    
+    ItemList list;
+    for(int i=0; i<100; i++) { list.items[i] = {(uint32_t)i, (uint16_t)(i*2)}; }
+    
+    uint8_t buffer[1024];
+    cnd_vm_ctx ctx;
+    cnd_binder binder;
+
+    for (auto _ : state) {
+        cnd_binder_init(&binder, table, 8, &list);
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), cnd_bind_io, &binder);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_DecodeArrayStruct);
+BENCHMARK(BM_EncodeArrayStructBound)->Apply(BenchDispatchArgs);
+
+static void BM_DecodeArrayStructBound(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
+    std::vector<uint8_t> bytecode;
+    CompileSchema(
+        "struct Item { uint32 id; uint16 val; }"
+        "packet List { Item items[100]; }", 
+        bytecode);
+    
+    cnd_program program;
+    cnd_program_load_il(&program, bytecode.data(), bytecode.size());
+
+    cnd_binding table[8] = {};
+    BindItemList(&program, table, 8);
+    
+    ItemList list;
+    for(int i=0; i<100; i++) { list.items[i] = {(uint32_t)i, (uint16_t)(i*2)}; }
+    
+    uint8_t buffer[1024];
+    cnd_vm_ctx ctx;
+    cnd_binder binder;
+
+    // Pre-encode
+    cnd_binder_init(&binder, table, 8, &list);
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), cnd_bind_io, &binder);
+    cnd_execute_dispatch(&ctx, dispatch);
+    size_t encoded_size = ctx.cursor;
+
+    for (auto _ : state) {
+        ItemList out;
+        cnd_binder_init(&binder, table, 8, &out);
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, cnd_bind_io, &binder);
+        cnd_execute_dispatch(&ctx, dispatch);
+        benchmark::DoNotOptimize(out);
+    }
+}
+BENCHMARK(BM_DecodeArrayStructBound)->Apply(BenchDispatchArgs);
 
 static void BM_EncodeBigEndian(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema("packet P { @big_endian uint32 val; }", bytecode);
     
@@ -242,12 +325,13 @@ static void BM_EncodeBigEndian(benchmark::State& state) {
     for (auto _ : state) {
         memset(buffer, 0, sizeof(buffer));
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback, &d);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EncodeBigEndian);
+BENCHMARK(BM_EncodeBigEndian)->Apply(BenchDispatchArgs);
 
 static void BM_EncodeLargeArray(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema("packet P { uint8 data[1024]; }", bytecode);
     
@@ -263,12 +347,13 @@ static void BM_EncodeLargeArray(benchmark::State& state) {
     for (auto _ : state) {
         memset(buffer, 0, sizeof(buffer));
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_large_array, &bc);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EncodeLargeArray);
+BENCHMARK(BM_EncodeLargeArray)->Apply(BenchDispatchArgs);
 
 static void BM_EncodeSimple(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> il_image;
     CompileSchema("packet P { uint32 id; float val; uint8 data[16]; }", il_image);
     
@@ -286,12 +371,13 @@ static void BM_EncodeSimple(benchmark::State& state) {
     for (auto _ : state) {
         memset(buffer, 0, sizeof(buffer));
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_complex, &bc);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EncodeSimple);
+BENCHMARK(BM_EncodeSimple)->Apply(BenchDispatchArgs);
 
 static void BM_DecodeSimple(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> il_image;
     CompileSchema("packet P { uint32 id; float val; uint8 data[16]; }", il_image);
     
@@ -308,13 +394,502 @@ static void BM_DecodeSimple(benchmark::State& state) {
     
     // Pre-encode
     cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_complex, &bc);
-    cnd_execute(&ctx);
+    cnd_execute_dispatch(&ctx, dispatch);
     size_t encoded_size = ctx.cursor;
 
     for (auto _ : state) {
         BenchContext out_bc;
         cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_io_callback_complex, &out_bc);
+        cnd_execute_dispatch(&ctx, dispatch);
+    }
+}
+BENCHMARK(BM_DecodeSimple)->Apply(BenchDispatchArgs);
+
+// --- Prepared Program Benchmarks ---
+
+static void BM_DecodeSimplePrepared(benchmark::State& state) {
+    std::vector<uint8_t> il_image;
+    CompileSchema("packet P { uint32 id; float val; uint8 data[16]; }", il_image);
+    
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    size_t cap = 0;
+    cnd_program_prepare_size(&program, &cap);
+    std::vector<cnd_insn> insns(cap);
+    cnd_prepared prepared;
+    cnd_program_prepare(&prepared, &program, insns.data(), cap);
+    
+    BenchContext bc;
+    bc.data.id = 0x12345678;
+    bc.data.val = 3.14159f;
+    memset(bc.data.data, 0xAA, 16);
+    
+    uint8_t buffer[128];
+    cnd_vm_ctx ctx;
+    
+    // Pre-encode
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_complex, &bc);
+    cnd_execute_prepared(&ctx, &prepared);
+    size_t encoded_size = ctx.cursor;
+
+    for (auto _ : state) {
+        BenchContext out_bc;
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_io_callback_complex, &out_bc);
+        cnd_execute_prepared(&ctx, &prepared);
+    }
+}
+BENCHMARK(BM_DecodeSimplePrepared);
+
+static void BM_DecodeArrayStructPrepared(benchmark::State& state) {
+    std::vector<uint8_t> bytecode;
+    CompileSchema(
+        "struct Item { uint32 id; uint16 val; }"
+        "packet List { Item items[100]; }", 
+        bytecode);
+    
+    cnd_program program;
+    cnd_program_load_il(&program, bytecode.data(), bytecode.size());
+
+    size_t cap = 0;
+    cnd_program_prepare_size(&program, &cap);
+    std::vector<cnd_insn> insns(cap);
+    cnd_prepared prepared;
+    cnd_program_prepare(&prepared, &program, insns.data(), cap);
+    
+    BenchArrayStructContext bc;
+    for(int i=0; i<100; i++) { bc.list.items[i] = {(uint32_t)i, (uint16_t)(i*2)}; }
+    
+    uint8_t buffer[1024]; 
+    cnd_vm_ctx ctx;
+    
+    // Pre-encode
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_array_struct, &bc);
+    cnd_execute_prepared(&ctx, &prepared);
+    size_t encoded_size = ctx.cursor;
+
+    for (auto _ : state) {
+        BenchArrayStructContext out_bc;
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_io_callback_array_struct, &out_bc);
+        cnd_execute_prepared(&ctx, &prepared);
+    }
+}
+BENCHMARK(BM_DecodeArrayStructPrepared);
+
+// --- Batch Benchmarks ---
+// Packets/sec for a stream of small packets, one cnd_init + cnd_execute per
+// packet versus cnd_execute_batch. The argument is the batch size.
+
+static const char* BATCH_SCHEMA =
+    "packet Msg { uint8 kind; uint16 seq; uint32 stamp; @big_endian uint32 value; }";
+static const size_t BATCH_PACKET_SIZE = 11;
+
+static cnd_error_t bench_io_callback_sum(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    uint64_t* sum = (uint64_t*)ctx->user_ptr;
+    switch (type) {
+        case OP_IO_U8: *sum += *(uint8_t*)ptr; break;
+        case OP_IO_U16: *sum += *(uint16_t*)ptr; break;
+        case OP_IO_U32: *sum += *(uint32_t*)ptr; break;
+        default: break;
+    }
+    (void)key_id;
+    return CND_ERR_OK;
+}
+
+static void BatchPackets(size_t count, std::vector<uint8_t>& packed, std::vector<size_t>& offsets,
+                         std::vector<size_t>& lengths) {
+    packed.resize(count * BATCH_PACKET_SIZE);
+    offsets.resize(count);
+    lengths.assign(count, BATCH_PACKET_SIZE);
+    for (size_t i = 0; i < count; i++) {
+        offsets[i] = i * BATCH_PACKET_SIZE;
+        for (size_t j = 0; j < BATCH_PACKET_SIZE; j++) packed[offsets[i] + j] = (uint8_t)(i + j);
+    }
+}
+
+static void BM_DecodeBatchLoop(benchmark::State& state) {
+    std::vector<uint8_t> il_image;
+    CompileSchema(BATCH_SCHEMA, il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    size_t count = (size_t)state.range(0);
+    std::vector<uint8_t> packed;
+    std::vector<size_t> offsets, lengths;
+    BatchPackets(count, packed, offsets, lengths);
+
+    uint64_t sum = 0;
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        for (size_t i = 0; i < count; i++) {
+            cnd_init(&ctx, CND_MODE_DECODE, &program, packed.data() + offsets[i], lengths[i], bench_io_callback_sum, &sum);
+            cnd_execute(&ctx);
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * (int64_t)count);
+}
+BENCHMARK(BM_DecodeBatchLoop)->RangeMultiplier(4)->Range(1, 4096);
+
+static void BM_DecodeBatch(benchmark::State& state) {
+    std::vector<uint8_t> il_image;
+    CompileSchema(BATCH_SCHEMA, il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    size_t count = (size_t)state.range(0);
+    std::vector<uint8_t> packed;
+    std::vector<size_t> offsets, lengths;
+    BatchPackets(count, packed, offsets, lengths);
+    std::vector<cnd_error_t> errors(count);
+
+    cnd_batch batch = {};
+    batch.base = packed.data();
+    batch.offsets = offsets.data();
+    batch.lengths = lengths.data();
+    batch.count = count;
+
+    uint64_t sum = 0;
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_DECODE, &program, NULL, 0, bench_io_callback_sum, &sum);
+    for (auto _ : state) {
+        cnd_execute_batch(&ctx, &batch, errors.data(), NULL);
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * (int64_t)count);
+}
+BENCHMARK(BM_DecodeBatch)->RangeMultiplier(4)->Range(1, 4096);
+
+// --- Columnar Benchmarks ---
+// The batch stream pivoted into one column per field: a hand-written
+// callback scattering each value versus cnd_decode_columns.
+
+struct BatchColumns {
+    std::vector<uint8_t> kind;
+    std::vector<uint16_t> seq;
+    std::vector<uint32_t> stamp;
+    std::vector<uint32_t> value;
+
+    explicit BatchColumns(size_t n) : kind(n), seq(n), stamp(n), value(n) {}
+};
+
+static cnd_error_t bench_io_callback_columns(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    BatchColumns* cols = (BatchColumns*)ctx->user_ptr;
+    size_t i = ctx->batch_index;
+    switch (key_id) {
+        case 0: cols->kind[i] = *(uint8_t*)ptr; break;
+        case 1: cols->seq[i] = *(uint16_t*)ptr; break;
+        case 2: cols->stamp[i] = *(uint32_t*)ptr; break;
+        case 3: cols->value[i] = *(uint32_t*)ptr; break;
+    }
+    (void)type;
+    return CND_ERR_OK;
+}
+
+static void BM_DecodeColumnsCallback(benchmark::State& state) {
+    std::vector<uint8_t> il_image;
+    CompileSchema(BATCH_SCHEMA, il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    size_t count = (size_t)state.range(0);
+    std::vector<uint8_t> packed;
+    std::vector<size_t> offsets, lengths;
+    BatchPackets(count, packed, offsets, lengths);
+    BatchColumns cols(count);
+
+    cnd_batch batch = {};
+    batch.base = packed.data();
+    batch.offsets = offsets.data();
+    batch.lengths = lengths.data();
+    batch.count = count;
+
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_DECODE, &program, NULL, 0, bench_io_callback_columns, &cols);
+    for (auto _ : state) {
+        cnd_execute_batch(&ctx, &batch, NULL, NULL);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)count);
+}
+BENCHMARK(BM_DecodeColumnsCallback)->Arg(64)->Arg(4096);
+
+static void BM_DecodeColumns(benchmark::State& state) {
+    std::vector<uint8_t> il_image;
+    CompileSchema(BATCH_SCHEMA, il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    size_t count = (size_t)state.range(0);
+    std::vector<uint8_t> packed;
+    std::vector<size_t> offsets, lengths;
+    BatchPackets(count, packed, offsets, lengths);
+    BatchColumns cols(count);
+
+    cnd_batch batch = {};
+    batch.base = packed.data();
+    batch.offsets = offsets.data();
+    batch.lengths = lengths.data();
+    batch.count = count;
+
+    cnd_column columns[4] = {
+        {cols.kind.data(), OP_IO_U8},
+        {cols.seq.data(), OP_IO_U16},
+        {cols.stamp.data(), OP_IO_U32},
+        {cols.value.data(), OP_IO_U32},
+    };
+    for (auto _ : state) {
+        cnd_decode_columns(&program, &batch, columns, 4, NULL);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)count);
+}
+BENCHMARK(BM_DecodeColumns)->Arg(64)->Arg(4096);
+
+// --- Bulk Array Benchmarks ---
+// A 4096-sample big-endian waveform, element by element versus
+// CND_CTX_ARRAY_SPANS. Arg 0 is the raw array, Arg 1 the same array with
+// @scale applied.
+
+static const char* WAVEFORM_SCHEMA[2] = {
+    "packet W { @big_endian int16 samples[4096]; }",
+    "packet W { @scale(0.001) @big_endian int16 samples[4096]; }",
+};
+
+static cnd_error_t bench_io_callback_waveform(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    (void)key_id;
+    double* sum = (double*)ctx->user_ptr;
+    if (type == OP_IO_I16) { int16_t v; memcpy(&v, ptr, 2); *sum += v; }
+    else if (type == OP_IO_F64) { double v; memcpy(&v, ptr, 8); *sum += v; }
+    else if (type == OP_ARR_SPAN) {
+        const cnd_span* s = (const cnd_span*)ptr;
+        if (s->type == OP_IO_F64) {
+            const double* d = (const double*)s->data;
+            for (uint32_t i = 0; i < s->count; i++) *sum += d[i];
+        } else {
+            const int16_t* d = (const int16_t*)s->data;
+            for (uint32_t i = 0; i < s->count; i++) *sum += d[i];
+        }
+    }
+    return CND_ERR_OK;
+}
+
+static void RunWaveform(benchmark::State& state, uint8_t flags) {
+    std::vector<uint8_t> il_image;
+    CompileSchema(WAVEFORM_SCHEMA[state.range(0)], il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    std::vector<uint8_t> buffer(4096 * 2);
+    for (size_t i = 0; i < buffer.size(); i++) buffer[i] = (uint8_t)(i * 31);
+
+    double sum = 0;
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer.data(), buffer.size(), bench_io_callback_waveform, &sum);
+        ctx.flags = flags;
         cnd_execute(&ctx);
     }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * 4096);
+}
+
+static void BM_DecodeWaveform(benchmark::State& state) { RunWaveform(state, 0); }
+BENCHMARK(BM_DecodeWaveform)->Arg(0)->Arg(1);
+
+static void BM_DecodeWaveformSpans(benchmark::State& state) { RunWaveform(state, CND_CTX_ARRAY_SPANS); }
+BENCHMARK(BM_DecodeWaveformSpans)->Arg(0)->Arg(1);
+
+// --- Superinstruction Benchmarks ---
+// A flat packet of 100 mixed primitives. Arg 0 is compiled as is, Arg 1 with
+// -O, which fuses the fields into one OP_IO_RUN with a single bounds check.
+
+static std::string FlatSchema() {
+    static const char* types[] = {"uint8", "uint16", "uint32", "int16", "float", "uint8", "int32", "uint64"};
+    std::string s = "packet Flat {";
+    for (int i = 0; i < 100; i++) s += std::string(" ") + types[i % 8] + " f" + std::to_string(i) + ";";
+    return s + " }";
+}
+
+static cnd_error_t bench_io_callback_flat(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    uint64_t* sum = (uint64_t*)ctx->user_ptr;
+    size_t size = (type == OP_IO_U8) ? 1 : (type == OP_IO_U16 || type == OP_IO_I16) ? 2 :
+                  (type == OP_IO_U64) ? 8 : 4;
+    uint64_t v = 0;
+    if (ctx->mode == CND_MODE_ENCODE) {
+        v = key_id * 3u + 1;
+        memcpy(ptr, &v, size);
+    } else {
+        memcpy(&v, ptr, size);
+        *sum += v;
+    }
+    return CND_ERR_OK;
+}
+
+static void RunFlat(benchmark::State& state, cnd_mode_t mode) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
+    std::vector<uint8_t> il_image;
+    CompileSchema(FlatSchema().c_str(), il_image, (int)state.range(1));
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    uint8_t buffer[512];
+    uint64_t sum = 0;
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_flat, &sum);
+    if (cnd_execute_dispatch(&ctx, dispatch) != CND_ERR_OK) {
+        state.SkipWithError("encode failed");
+        return;
+    }
+    size_t len = (mode == CND_MODE_ENCODE) ? sizeof(buffer) : ctx.cursor;
+
+    for (auto _ : state) {
+        cnd_init(&ctx, mode, &program, buffer, len, bench_io_callback_flat, &sum);
+        cnd_execute_dispatch(&ctx, dispatch);
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * 100);
+}
+
+static void FlatArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"threaded", "fused"});
+    for (int threaded = 0; threaded < 2; threaded++) {
+        b->Args({threaded, 0})->Args({threaded, 1});
+    }
+}
+
+static void BM_EncodeFlat(benchmark::State& state) { RunFlat(state, CND_MODE_ENCODE); }
+static void BM_DecodeFlat(benchmark::State& state) { RunFlat(state, CND_MODE_DECODE); }
+BENCHMARK(BM_EncodeFlat)->Apply(FlatArgs);
+BENCHMARK(BM_DecodeFlat)->Apply(FlatArgs);
+
+// The same packet through a prepared program. Arg 1 runs the fixed prefix
+// (all 100 fields here) behind the one length check the prepared program
+// does up front; Arg 0 clears the prefix to compare with per-field checks.
+static void BM_DecodeFlatPrepared(benchmark::State& state) {
+    std::vector<uint8_t> il_image;
+    CompileSchema(FlatSchema().c_str(), il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    size_t cap = 0;
+    cnd_program_prepare_size(&program, &cap);
+    std::vector<cnd_insn> insns(cap);
+    cnd_prepared prepared;
+    if (cnd_program_prepare(&prepared, &program, insns.data(), cap) != CND_ERR_OK) {
+        state.SkipWithError("prepare failed");
+        return;
+    }
+    if (state.range(0) == 0) prepared.fixed_count = 0;
+
+    uint8_t buffer[512];
+    uint64_t sum = 0;
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_flat, &sum);
+    cnd_execute_prepared(&ctx, &prepared);
+    size_t len = ctx.cursor;
+
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, len, bench_io_callback_flat, &sum);
+        cnd_execute_prepared(&ctx, &prepared);
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * 100);
 }
-BENCHMARK(BM_DecodeSimple);
+BENCHMARK(BM_DecodeFlatPrepared)->ArgName("prefix")->Arg(0)->Arg(1);
+
+// --- JIT Benchmarks ---
+// The flat packet through cnd_program_jit(), compared with the prepared runs
+// above. Skipped unless the library is built with CND_JIT.
+
+static void RunFlatJit(benchmark::State& state, cnd_mode_t mode) {
+    std::vector<uint8_t> il_image;
+    CompileSchema(FlatSchema().c_str(), il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    size_t cap = 0;
+    cnd_program_prepare_size(&program, &cap);
+    std::vector<cnd_insn> insns(cap);
+    cnd_prepared prepared;
+    cnd_jit jit;
+    if (cnd_program_prepare(&prepared, &program, insns.data(), cap) != CND_ERR_OK ||
+        cnd_program_jit(&jit, &prepared) != CND_ERR_OK) {
+        state.SkipWithError("JIT not available");
+        return;
+    }
+
+    uint8_t buffer[512];
+    uint64_t sum = 0;
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_flat, &sum);
+    cnd_execute_jit(&ctx, &jit);
+    size_t len = (mode == CND_MODE_ENCODE) ? sizeof(buffer) : ctx.cursor;
+
+    for (auto _ : state) {
+        cnd_init(&ctx, mode, &program, buffer, len, bench_io_callback_flat, &sum);
+        cnd_execute_jit(&ctx, &jit);
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * 100);
+    cnd_jit_free(&jit);
+}
+
+static void BM_EncodeFlatJit(benchmark::State& state) { RunFlatJit(state, CND_MODE_ENCODE); }
+static void BM_DecodeFlatJit(benchmark::State& state) { RunFlatJit(state, CND_MODE_DECODE); }
+BENCHMARK(BM_EncodeFlatJit);
+BENCHMARK(BM_DecodeFlatJit);
+
+// A calibrated telemetry frame: 32 scaled fields inside a CRC-32 region.
+// Arg 0 runs the prepared executor, Arg 1 the generated code.
+static cnd_error_t bench_io_callback_scaled(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    double* sum = (double*)ctx->user_ptr;
+    if (type != OP_IO_F64) return CND_ERR_OK;
+    if (ctx->mode == CND_MODE_ENCODE) *(double*)ptr = key_id * 0.5 + 1.0;
+    else *sum += *(double*)ptr;
+    return CND_ERR_OK;
+}
+
+static void RunScaledJit(benchmark::State& state, cnd_mode_t mode) {
+    std::string schema = "packet Scaled { @crc_begin uint8 head;";
+    for (int i = 0; i < 32; i++) schema += " @scale(0.5) @offset(-20.0) int16 s" + std::to_string(i) + ";";
+    schema += " @crc(32) uint32 crc; }";
+    std::vector<uint8_t> il_image;
+    CompileSchema(schema.c_str(), il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    size_t cap = 0;
+    cnd_program_prepare_size(&program, &cap);
+    std::vector<cnd_insn> insns(cap);
+    cnd_prepared prepared;
+    cnd_jit jit;
+    memset(&jit, 0, sizeof(jit));
+    bool use_jit = state.range(0) != 0;
+    if (cnd_program_prepare(&prepared, &program, insns.data(), cap) != CND_ERR_OK ||
+        (use_jit && cnd_program_jit(&jit, &prepared) != CND_ERR_OK)) {
+        state.SkipWithError("JIT not available");
+        return;
+    }
+
+    uint8_t buffer[128];
+    double sum = 0;
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_scaled, &sum);
+    cnd_execute_prepared(&ctx, &prepared);
+    size_t len = (mode == CND_MODE_ENCODE) ? sizeof(buffer) : ctx.cursor;
+
+    for (auto _ : state) {
+        cnd_init(&ctx, mode, &program, buffer, len, bench_io_callback_scaled, &sum);
+        if (use_jit) cnd_execute_jit(&ctx, &jit);
+        else cnd_execute_prepared(&ctx, &prepared);
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * 32);
+    cnd_jit_free(&jit);
+}
+
+static void BM_EncodeScaledJit(benchmark::State& state) { RunScaledJit(state, CND_MODE_ENCODE); }
+static void BM_DecodeScaledJit(benchmark::State& state) { RunScaledJit(state, CND_MODE_DECODE); }
+BENCHMARK(BM_EncodeScaledJit)->ArgName("jit")->Arg(0)->Arg(1);
+BENCHMARK(BM_DecodeScaledJit)->ArgName("jit")->Arg(0)->Arg(1);
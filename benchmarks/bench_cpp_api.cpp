@@ -0,0 +1,258 @@
+#include "bench_common.h"
+#include "../include/concordia.hpp"
+#include "ground_telemetry_il.h"
+
+// --- C++ Visitors vs Callback ---
+//
+// ground_telemetry.cnd is compiled with -O and embedded by `cnd embed` at
+// build time (see CMakeLists.txt). The same frame goes through a C callback
+// switching on the key (cnd_execute), a visitor over the runtime-loaded
+// program (cnd::execute), a visitor over the embedded program
+// (cnd::embedded, fully unrolled) and hand-written code.
+
+struct GroundFrame {
+    uint16_t apid;
+    uint32_t seq;
+    uint64_t time_ns;
+    float position[3];
+    float velocity[3];
+    int16_t temp_a;
+    int16_t temp_b;
+    uint8_t mode;
+    uint8_t health;
+    double battery_v;
+    bool armed;
+};
+
+// Key IDs: string table order of ground_telemetry.cnd
+enum : uint16_t {
+    GT_SYNC, GT_APID, GT_SEQ, GT_TIME_NS,
+    GT_POSITION, GT_POSITION_X, GT_POSITION_Y, GT_POSITION_Z,
+    GT_VELOCITY, GT_VELOCITY_X, GT_VELOCITY_Y, GT_VELOCITY_Z,
+    GT_TEMP_A, GT_TEMP_B, GT_MODE, GT_HEALTH, GT_BATTERY_V, GT_ARMED
+};
+
+static const size_t kGroundFrameSize = 55;
+
+template <cnd_mode_t Mode>
+struct GroundVisitor {
+    GroundFrame& f;
+
+    void on(uint16_t key, uint16_t& v) { if (key == GT_APID) cnd::transfer<Mode>(v, f.apid); }
+    void on(uint16_t, uint32_t& v) { cnd::transfer<Mode>(v, f.seq); }
+    void on(uint16_t, uint64_t& v) { cnd::transfer<Mode>(v, f.time_ns); }
+    void on(uint16_t key, float& v) {
+        cnd::transfer<Mode>(v, key < GT_VELOCITY ? f.position[key - GT_POSITION_X] : f.velocity[key - GT_VELOCITY_X]);
+    }
+    void on(uint16_t key, int16_t& v) { cnd::transfer<Mode>(v, key == GT_TEMP_A ? f.temp_a : f.temp_b); }
+    void on(uint16_t key, uint8_t& v) { cnd::transfer<Mode>(v, key == GT_MODE ? f.mode : f.health); }
+    void on(uint16_t, double& v) { cnd::transfer<Mode>(v, f.battery_v); }
+    void on(uint16_t, bool& v) { cnd::transfer<Mode>(v, f.armed); }
+};
+
+#define GT_FIELD(ctype, member) \
+    if (ctx->mode == CND_MODE_ENCODE) *(ctype*)ptr = (ctype)(member); else (member) = *(ctype*)ptr; \
+    break
+
+static cnd_error_t ground_callback(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, void* ptr) {
+    GroundFrame* f = (GroundFrame*)ctx->user_ptr;
+    if (type == OP_ENTER_STRUCT || type == OP_EXIT_STRUCT) return CND_ERR_OK;
+    switch (key) {
+        case GT_SYNC: break;
+        case GT_APID: GT_FIELD(uint16_t, f->apid);
+        case GT_SEQ: GT_FIELD(uint32_t, f->seq);
+        case GT_TIME_NS: GT_FIELD(uint64_t, f->time_ns);
+        case GT_POSITION_X: GT_FIELD(float, f->position[0]);
+        case GT_POSITION_Y: GT_FIELD(float, f->position[1]);
+        case GT_POSITION_Z: GT_FIELD(float, f->position[2]);
+        case GT_VELOCITY_X: GT_FIELD(float, f->velocity[0]);
+        case GT_VELOCITY_Y: GT_FIELD(float, f->velocity[1]);
+        case GT_VELOCITY_Z: GT_FIELD(float, f->velocity[2]);
+        case GT_TEMP_A: GT_FIELD(int16_t, f->temp_a);
+        case GT_TEMP_B: GT_FIELD(int16_t, f->temp_b);
+        case GT_MODE: GT_FIELD(uint8_t, f->mode);
+        case GT_HEALTH: GT_FIELD(uint8_t, f->health);
+        case GT_BATTERY_V: GT_FIELD(double, f->battery_v);
+        case GT_ARMED:
+            if (ctx->mode == CND_MODE_ENCODE) *(uint8_t*)ptr = f->armed ? 1 : 0;
+            else f->armed = *(uint8_t*)ptr != 0;
+            break;
+        default: return CND_ERR_CALLBACK;
+    }
+    return CND_ERR_OK;
+}
+
+// Hand-written codec for the same layout (little-endian host)
+static bool ground_decode(GroundFrame* f, const uint8_t* p, size_t len) {
+    if (len < kGroundFrameSize || p[0] != 0xEB || p[1] != 0x90 || p[54] > 1) return false;
+    memcpy(&f->apid, p + 2, 2);
+    memcpy(&f->seq, p + 4, 4);
+    memcpy(&f->time_ns, p + 8, 8);
+    memcpy(f->position, p + 16, 12);
+    memcpy(f->velocity, p + 28, 12);
+    memcpy(&f->temp_a, p + 40, 2);
+    memcpy(&f->temp_b, p + 42, 2);
+    f->mode = p[44];
+    f->health = p[45];
+    memcpy(&f->battery_v, p + 46, 8);
+    f->armed = p[54] != 0;
+    return true;
+}
+
+static bool ground_encode(const GroundFrame* f, uint8_t* p, size_t len) {
+    if (len < kGroundFrameSize) return false;
+    p[0] = 0xEB;
+    p[1] = 0x90;
+    memcpy(p + 2, &f->apid, 2);
+    memcpy(p + 4, &f->seq, 4);
+    memcpy(p + 8, &f->time_ns, 8);
+    memcpy(p + 16, f->position, 12);
+    memcpy(p + 28, f->velocity, 12);
+    memcpy(p + 40, &f->temp_a, 2);
+    memcpy(p + 42, &f->temp_b, 2);
+    p[44] = f->mode;
+    p[45] = f->health;
+    memcpy(p + 46, &f->battery_v, 8);
+    p[54] = f->armed ? 1 : 0;
+    return true;
+}
+
+typedef cnd::embedded<ground_telemetry_il, sizeof(ground_telemetry_il)> GroundProgram;
+
+struct GroundBench {
+    GroundProgram embedded;
+    cnd_program program;
+    GroundFrame frame;
+    uint8_t packet[kGroundFrameSize];
+    bool ok;
+
+    GroundBench() : program(), frame(), ok(false) {
+        if (embedded.status() != CND_ERR_OK) return;
+        if (cnd_program_load_il(&program, ground_telemetry_il, sizeof(ground_telemetry_il)) != CND_ERR_OK) return;
+        frame = GroundFrame{0x1A5, 123456, 1700000000123456789ull, {1.5f, -2.25f, 3.0f}, {0.5f, 0.25f, -7.0f},
+                            -40, 85, 3, 200, 27.75, true};
+
+        // Every path must produce and read back the same frame
+        uint8_t a[kGroundFrameSize], b[kGroundFrameSize], c[kGroundFrameSize], d[kGroundFrameSize];
+        cnd_vm_ctx ctx;
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, a, sizeof(a), ground_callback, &frame);
+        if (cnd_execute(&ctx) != CND_ERR_OK || ctx.cursor != sizeof(a)) return;
+        size_t used = 0;
+        if (cnd::encode(program, b, sizeof(b), GroundVisitor<CND_MODE_ENCODE>{frame}, &used) != CND_ERR_OK || used != sizeof(b)) return;
+        if (cnd::encode(embedded, c, sizeof(c), GroundVisitor<CND_MODE_ENCODE>{frame}, &used) != CND_ERR_OK || used != sizeof(c)) return;
+        if (!ground_encode(&frame, d, sizeof(d))) return;
+        if (memcmp(a, b, sizeof(a)) != 0 || memcmp(a, c, sizeof(a)) != 0 || memcmp(a, d, sizeof(a)) != 0) return;
+        memcpy(packet, a, sizeof(packet));
+
+        GroundFrame x = GroundFrame(), y = GroundFrame();
+        if (cnd::decode(embedded, packet, sizeof(packet), GroundVisitor<CND_MODE_DECODE>{x}) != CND_ERR_OK) return;
+        if (!ground_decode(&y, packet, sizeof(packet))) return;
+        ok = memcmp(&x, &frame, sizeof(x)) == 0 && memcmp(&y, &frame, sizeof(y)) == 0 &&
+             GroundProgram::prefix_end == GroundProgram::bytecode_len;
+    }
+};
+
+static GroundBench& GroundFixture() {
+    static GroundBench bench;
+    return bench;
+}
+
+static void BM_CppDecodeCallback(benchmark::State& state) {
+    GroundBench& g = GroundFixture();
+    if (!g.ok) { state.SkipWithError("ground_telemetry setup failed"); return; }
+    GroundFrame out;
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &g.program, g.packet, sizeof(g.packet), ground_callback, &out);
+        benchmark::DoNotOptimize(cnd_execute(&ctx));
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)sizeof(g.packet));
+}
+BENCHMARK(BM_CppDecodeCallback);
+
+static void BM_CppDecodeVisitor(benchmark::State& state) {
+    GroundBench& g = GroundFixture();
+    if (!g.ok) { state.SkipWithError("ground_telemetry setup failed"); return; }
+    GroundFrame out;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cnd::decode(g.program, g.packet, sizeof(g.packet), GroundVisitor<CND_MODE_DECODE>{out}));
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)sizeof(g.packet));
+}
+BENCHMARK(BM_CppDecodeVisitor);
+
+static void BM_CppDecodeEmbedded(benchmark::State& state) {
+    GroundBench& g = GroundFixture();
+    if (!g.ok) { state.SkipWithError("ground_telemetry setup failed"); return; }
+    GroundFrame out;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cnd::decode(g.embedded, g.packet, sizeof(g.packet), GroundVisitor<CND_MODE_DECODE>{out}));
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)sizeof(g.packet));
+}
+BENCHMARK(BM_CppDecodeEmbedded);
+
+static void BM_CppDecodeHandwritten(benchmark::State& state) {
+    GroundBench& g = GroundFixture();
+    if (!g.ok) { state.SkipWithError("ground_telemetry setup failed"); return; }
+    GroundFrame out;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ground_decode(&out, g.packet, sizeof(g.packet)));
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)sizeof(g.packet));
+}
+BENCHMARK(BM_CppDecodeHandwritten);
+
+static void BM_CppEncodeCallback(benchmark::State& state) {
+    GroundBench& g = GroundFixture();
+    if (!g.ok) { state.SkipWithError("ground_telemetry setup failed"); return; }
+    uint8_t buf[kGroundFrameSize];
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_ENCODE, &g.program, buf, sizeof(buf), ground_callback, &g.frame);
+        benchmark::DoNotOptimize(cnd_execute(&ctx));
+        benchmark::DoNotOptimize(buf);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)sizeof(buf));
+}
+BENCHMARK(BM_CppEncodeCallback);
+
+static void BM_CppEncodeVisitor(benchmark::State& state) {
+    GroundBench& g = GroundFixture();
+    if (!g.ok) { state.SkipWithError("ground_telemetry setup failed"); return; }
+    uint8_t buf[kGroundFrameSize];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cnd::encode(g.program, buf, sizeof(buf), GroundVisitor<CND_MODE_ENCODE>{g.frame}));
+        benchmark::DoNotOptimize(buf);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)sizeof(buf));
+}
+BENCHMARK(BM_CppEncodeVisitor);
+
+static void BM_CppEncodeEmbedded(benchmark::State& state) {
+    GroundBench& g = GroundFixture();
+    if (!g.ok) { state.SkipWithError("ground_telemetry setup failed"); return; }
+    uint8_t buf[kGroundFrameSize];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cnd::encode(g.embedded, buf, sizeof(buf), GroundVisitor<CND_MODE_ENCODE>{g.frame}));
+        benchmark::DoNotOptimize(buf);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)sizeof(buf));
+}
+BENCHMARK(BM_CppEncodeEmbedded);
+
+static void BM_CppEncodeHandwritten(benchmark::State& state) {
+    GroundBench& g = GroundFixture();
+    if (!g.ok) { state.SkipWithError("ground_telemetry setup failed"); return; }
+    uint8_t buf[kGroundFrameSize];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ground_encode(&g.frame, buf, sizeof(buf)));
+        benchmark::DoNotOptimize(buf);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)sizeof(buf));
+}
+BENCHMARK(BM_CppEncodeHandwritten);
@@ -1,4 +1,5 @@
 #include "bench_common.h"
+#include <string>
 
 // --- Bitfield Benchmark ---
 
@@ -22,6 +23,7 @@ static cnd_error_t bench_io_callback_bitfield(cnd_vm_ctx* ctx, uint16_t key_id,
 }
 
 static void BM_EncodeBitfields(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema(
         "packet Flags { uint32 a:5; uint32 b:12; uint32 c:3; uint32 d:12; }", 
@@ -38,12 +40,13 @@ static void BM_EncodeBitfields(benchmark::State& state) {
     for (auto _ : state) {
         memset(buffer, 0, sizeof(buffer));
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_bitfield, &f);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EncodeBitfields);
+BENCHMARK(BM_EncodeBitfields)->Apply(BenchDispatchArgs);
 
 static void BM_DecodeBitfields(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema(
         "packet Flags { uint32 a:5; uint32 b:12; uint32 c:3; uint32 d:12; }", 
@@ -59,16 +62,70 @@ static void BM_DecodeBitfields(benchmark::State& state) {
     
     // Pre-encode
     cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_bitfield, &f);
-    cnd_execute(&ctx);
+    cnd_execute_dispatch(&ctx, dispatch);
     size_t encoded_size = ctx.cursor;
 
     for (auto _ : state) {
         Flags out_f;
         cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_io_callback_bitfield, &out_f);
+        cnd_execute_dispatch(&ctx, dispatch);
+    }
+}
+BENCHMARK(BM_DecodeBitfields)->Apply(BenchDispatchArgs);
+
+// Status word of 40 flags, 1-5 bits each (120 bits)
+static cnd_error_t bench_io_callback_flags(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    if (type != OP_IO_BIT_U || key_id >= 64) return CND_ERR_OK;
+    uint64_t* flags = (uint64_t*)ctx->user_ptr;
+    if (ctx->mode == CND_MODE_ENCODE) *(uint64_t*)ptr = flags[key_id];
+    else flags[key_id] = *(uint64_t*)ptr;
+    return CND_ERR_OK;
+}
+
+static cnd_error_t bench_io_callback_flag_groups(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    if (type != OP_IO_BIT_GROUP) return bench_io_callback_flags(ctx, key_id, type, ptr);
+    cnd_bit_group* group = (cnd_bit_group*)ptr;
+    uint64_t* flags = (uint64_t*)ctx->user_ptr;
+    for (uint8_t i = 0; i < group->count; i++) {
+        uint16_t key = (uint16_t)((group->fields[i * 4 + 1] | (group->fields[i * 4 + 2] << 8)) + group->key_base);
+        if (key < 64) flags[key] = group->values[i];
+    }
+    return CND_ERR_OK;
+}
+
+// Arg: 0 = one event per flag, 1 = one event per bit group (CND_CTX_BIT_GROUPS)
+static void BM_DecodeStatusFlags(benchmark::State& state) {
+    std::string schema = "@unaligned_bytes struct Status {";
+    int bits = 0;
+    for (int i = 0; i < 40; i++) {
+        int width = 1 + (i * 7) % 5;
+        bits += width;
+        schema += " uint8 f" + std::to_string(i) + ":" + std::to_string(width) + ";";
+    }
+    schema += " @fill; } packet P { Status s; }";
+    std::vector<uint8_t> bytecode;
+    CompileSchema(schema.c_str(), bytecode);
+    cnd_program program;
+    cnd_program_load_il(&program, bytecode.data(), bytecode.size());
+
+    uint64_t flags[64];
+    for (int i = 0; i < 64; i++) flags[i] = (uint64_t)(i * 5) & 1;
+    uint8_t buffer[64] = {0};
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_flags, flags);
+    cnd_execute(&ctx);
+    size_t encoded_size = ctx.cursor;
+
+    bool groups = state.range(0) != 0;
+    cnd_io_cb cb = groups ? bench_io_callback_flag_groups : bench_io_callback_flags;
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, cb, flags);
+        if (groups) ctx.flags |= CND_CTX_BIT_GROUPS;
         cnd_execute(&ctx);
     }
+    state.counters["bits"] = bits;
 }
-BENCHMARK(BM_DecodeBitfields);
+BENCHMARK(BM_DecodeStatusFlags)->Arg(0)->Arg(1);
 
 // --- Optional Benchmark ---
 
@@ -92,6 +149,7 @@ static cnd_error_t bench_io_callback_optional(cnd_vm_ctx* ctx, uint16_t key_id,
 }
 
 static void BM_EncodeOptional(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema(
         "packet P { uint32 always; @optional uint32 maybe; }", 
@@ -109,12 +167,13 @@ static void BM_EncodeOptional(benchmark::State& state) {
     for (auto _ : state) {
         memset(buffer, 0, sizeof(buffer));
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_optional, &d);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EncodeOptional);
+BENCHMARK(BM_EncodeOptional)->Apply(BenchDispatchArgs);
 
 static void BM_DecodeOptional(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema(
         "packet P { uint32 always; @optional uint32 maybe; }", 
@@ -130,16 +189,16 @@ static void BM_DecodeOptional(benchmark::State& state) {
     
     // Pre-encode
     cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_optional, &d);
-    cnd_execute(&ctx);
+    cnd_execute_dispatch(&ctx, dispatch);
     size_t encoded_size = ctx.cursor;
 
     for (auto _ : state) {
         OptionalData out_d;
         cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_io_callback_optional, &out_d);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_DecodeOptional);
+BENCHMARK(BM_DecodeOptional)->Apply(BenchDispatchArgs);
 
 // --- Transform Benchmark ---
 
@@ -159,6 +218,7 @@ static cnd_error_t bench_io_callback_transform(cnd_vm_ctx* ctx, uint16_t key_id,
 }
 
 static void BM_EncodeTransform(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema(
         "packet P { @scale(0.1) @offset(10.0) uint16 val; }", 
@@ -175,12 +235,13 @@ static void BM_EncodeTransform(benchmark::State& state) {
     for (auto _ : state) {
         memset(buffer, 0, sizeof(buffer));
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_transform, &d);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EncodeTransform);
+BENCHMARK(BM_EncodeTransform)->Apply(BenchDispatchArgs);
 
 static void BM_DecodeTransform(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> bytecode;
     CompileSchema(
         "packet P { @scale(0.1) @offset(10.0) uint16 val; }", 
@@ -196,16 +257,16 @@ static void BM_DecodeTransform(benchmark::State& state) {
     
     // Pre-encode
     cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_transform, &d);
-    cnd_execute(&ctx);
+    cnd_execute_dispatch(&ctx, dispatch);
     size_t encoded_size = ctx.cursor;
 
     for (auto _ : state) {
         TransformData out_d;
         cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_io_callback_transform, &out_d);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_DecodeTransform);
+BENCHMARK(BM_DecodeTransform)->Apply(BenchDispatchArgs);
 
 // --- CRC Benchmark ---
 
@@ -232,6 +293,7 @@ static cnd_error_t bench_io_callback_crc(cnd_vm_ctx* ctx, uint16_t key_id, uint8
 }
 
 static void BM_EncodeCRC(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> il_image;
     CompileSchema(
         "packet P { string data prefix u16; @crc(32) uint32 crc; }", 
@@ -251,12 +313,13 @@ static void BM_EncodeCRC(benchmark::State& state) {
     for (auto _ : state) {
         memset(buffer, 0, sizeof(buffer));
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_crc, &d);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EncodeCRC);
+BENCHMARK(BM_EncodeCRC)->Apply(BenchDispatchArgs);
 
 static void BM_DecodeCRC(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> il_image;
     CompileSchema(
         "packet P { string data prefix u16; @crc(32) uint32 crc; }", 
@@ -275,16 +338,85 @@ static void BM_DecodeCRC(benchmark::State& state) {
     
     // Pre-encode
     cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_crc, &d);
-    cnd_execute(&ctx);
+    cnd_execute_dispatch(&ctx, dispatch);
     size_t encoded_size = ctx.cursor;
 
     for (auto _ : state) {
         CRCData out_d;
         cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_io_callback_crc, &out_d);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
+    }
+}
+BENCHMARK(BM_DecodeCRC)->Apply(BenchDispatchArgs);
+
+// --- CRC Payload Benchmark ---
+// Bytes/sec verifying a CRC over 64 B - 64 KB payloads. The second argument
+// picks the configuration: standard CRC-32, CRC-16/CCITT-FALSE (MSB-first),
+// CRC-32C (custom reflected polynomial), CRC-16/MODBUS (reflected 16-bit).
+
+static const char* CRC_PAYLOAD_FIELDS[4] = {
+    "@crc(32) uint32 c;",
+    "@crc(16) uint16 c;",
+    "@crc(32) @crc_poly(0x1EDC6F41) uint32 c;",
+    "@crc(16) @crc_poly(0x8005) @crc_refin @crc_refout uint16 c;",
+};
+
+static cnd_error_t bench_io_callback_payload(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    (void)ctx; (void)key_id; (void)type; (void)ptr;
+    return CND_ERR_OK; // Payload stays in the buffer (OP_RAW_BYTES)
+}
+
+static void BM_DecodeCRCPayload(benchmark::State& state) {
+    size_t size = (size_t)state.range(0);
+    std::string schema = "packet P { uint8 payload[" + std::to_string(size) + "]; " +
+                         CRC_PAYLOAD_FIELDS[state.range(1)] + " }";
+    std::vector<uint8_t> il_image;
+    CompileSchema(schema.c_str(), il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    std::vector<uint8_t> buffer(size + 4);
+    for (size_t i = 0; i < size; i++) buffer[i] = (uint8_t)(i * 131 + 7);
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer.data(), buffer.size(), bench_io_callback_payload, NULL);
+    cnd_execute(&ctx);
+    size_t encoded_size = ctx.cursor;
+
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer.data(), encoded_size, bench_io_callback_payload, NULL);
+        if (cnd_execute(&ctx) != CND_ERR_OK) state.SkipWithError("CRC mismatch");
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)size);
+}
+BENCHMARK(BM_DecodeCRCPayload)->ArgsProduct({{64, 1024, 16384, 65536}, {0, 1, 2, 3}});
+
+// Frame of N 256-byte sections, each followed by a CRC-32 over the frame so
+// far. The running CRC register keeps this linear in the frame size.
+static void BM_DecodeCRCSections(benchmark::State& state) {
+    int sections = (int)state.range(0);
+    std::string schema = "packet P {";
+    for (int i = 0; i < sections; i++) {
+        schema += " uint8 s" + std::to_string(i) + "[256]; @crc(32) uint32 c" + std::to_string(i) + ";";
+    }
+    schema += " }";
+    std::vector<uint8_t> il_image;
+    CompileSchema(schema.c_str(), il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    std::vector<uint8_t> buffer((size_t)sections * 260);
+    for (size_t i = 0; i < buffer.size(); i++) buffer[i] = (uint8_t)(i * 131 + 7);
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer.data(), buffer.size(), bench_io_callback_payload, NULL);
+    cnd_execute(&ctx);
+
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer.data(), buffer.size(), bench_io_callback_payload, NULL);
+        if (cnd_execute(&ctx) != CND_ERR_OK) state.SkipWithError("CRC mismatch");
     }
+    state.SetBytesProcessed(state.iterations() * (int64_t)buffer.size());
 }
-BENCHMARK(BM_DecodeCRC);
+BENCHMARK(BM_DecodeCRCSections)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
 
 // --- String Benchmark ---
 
@@ -307,6 +439,7 @@ static cnd_error_t bench_io_callback_string(cnd_vm_ctx* ctx, uint16_t key_id, ui
 }
 
 static void BM_EncodeString(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> il_image;
     CompileSchema("packet P { string s max 64; }", il_image);
     
@@ -322,12 +455,13 @@ static void BM_EncodeString(benchmark::State& state) {
     for (auto _ : state) {
         memset(buffer, 0, sizeof(buffer));
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_string, &d);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EncodeString);
+BENCHMARK(BM_EncodeString)->Apply(BenchDispatchArgs);
 
 static void BM_DecodeString(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> il_image;
     CompileSchema("packet P { string s max 64; }", il_image);
     
@@ -341,18 +475,19 @@ static void BM_DecodeString(benchmark::State& state) {
     cnd_vm_ctx ctx;
     
     cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_string, &d);
-    cnd_execute(&ctx);
+    cnd_execute_dispatch(&ctx, dispatch);
     size_t encoded_size = ctx.cursor;
 
     for (auto _ : state) {
         StringData out_d;
         cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_io_callback_string, &out_d);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_DecodeString);
+BENCHMARK(BM_DecodeString)->Apply(BenchDispatchArgs);
 
 static void BM_EnumEncode(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> il_image;
     CompileSchema(
         "enum Status : uint8 { Ok = 0, Error = 1, Unknown = 2 }"
@@ -374,12 +509,13 @@ static void BM_EnumEncode(benchmark::State& state) {
     
     for (auto _ : state) {
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), cb, NULL);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EnumEncode);
+BENCHMARK(BM_EnumEncode)->Apply(BenchDispatchArgs);
 
 static void BM_EnumDecode(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     std::vector<uint8_t> il_image;
     CompileSchema(
         "enum Status : uint8 { Ok = 0, Error = 1, Unknown = 2 }"
@@ -407,15 +543,15 @@ static void BM_EnumDecode(benchmark::State& state) {
     
     // Pre-encode
     cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), cb, NULL);
-    cnd_execute(&ctx);
+    cnd_execute_dispatch(&ctx, dispatch);
     size_t encoded_size = ctx.cursor;
     
     for (auto _ : state) {
         cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, cb, NULL);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_EnumDecode);
+BENCHMARK(BM_EnumDecode)->Apply(BenchDispatchArgs);
 
 // --- String Array Benchmark ---
 
@@ -449,6 +585,7 @@ static cnd_error_t bench_string_array_callback(cnd_vm_ctx* ctx, uint16_t key_id,
 }
 
 static void BM_StringArray_Encode(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     const char* schema = R"(
         packet BenchPacket {
             @count(5)
@@ -476,12 +613,13 @@ static void BM_StringArray_Encode(benchmark::State& state) {
     for (auto _ : state) {
         bc.current_idx = 0;
         cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_string_array_callback, &bc);
-        cnd_execute(&ctx);
+        cnd_execute_dispatch(&ctx, dispatch);
     }
 }
-BENCHMARK(BM_StringArray_Encode);
+BENCHMARK(BM_StringArray_Encode)->Apply(BenchDispatchArgs);
 
 static void BM_StringArray_Decode(benchmark::State& state) {
+    cnd_dispatch_t dispatch = BenchDispatch(state);
     const char* schema = R"(
         packet BenchPacket {
             @count(5)
@@ -509,13 +647,137 @@ static void BM_StringArray_Decode(benchmark::State& state) {
     // Pre-encode to get valid buffer
     bc.current_idx = 0;
     cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_string_array_callback, &bc);
-    cnd_execute(&ctx);
+    cnd_execute_dispatch(&ctx, dispatch);
     size_t encoded_size = ctx.cursor;
     
     for (auto _ : state) {
         bc.current_idx = 0;
         cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, encoded_size, bench_string_array_callback, &bc);
+        cnd_execute_dispatch(&ctx, dispatch);
+    }
+}
+BENCHMARK(BM_StringArray_Decode)->Apply(BenchDispatchArgs);
+
+// --- Random Field Access Benchmark ---
+// Routing code that needs 3 fields out of a 200-field packet: a full decode
+// against cnd_field_read from the static layout table.
+
+static void BuildWideSchema(std::string& src) {
+    src = "packet Wide { uint16 route; ";
+    for (int i = 0; i < 200; i++) src += "uint32 f" + std::to_string(i) + "; ";
+    src += "}";
+}
+
+static cnd_error_t bench_io_callback_sink(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    (void)ctx; (void)key_id; (void)type; (void)ptr;
+    return CND_ERR_OK;
+}
+
+static void BM_WideDecodeFull(benchmark::State& state) {
+    std::string src;
+    BuildWideSchema(src);
+    std::vector<uint8_t> bytecode;
+    CompileSchema(src.c_str(), bytecode);
+
+    cnd_program program;
+    cnd_program_load_il(&program, bytecode.data(), bytecode.size());
+
+    std::vector<uint8_t> buffer(2 + 200 * 4, 0x5A);
+    cnd_vm_ctx ctx;
+
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer.data(), buffer.size(), bench_io_callback_sink, NULL);
         cnd_execute(&ctx);
     }
 }
-BENCHMARK(BM_StringArray_Decode);
+BENCHMARK(BM_WideDecodeFull);
+
+static void BM_WideFieldRead(benchmark::State& state) {
+    std::string src;
+    BuildWideSchema(src);
+    std::vector<uint8_t> bytecode;
+    CompileSchema(src.c_str(), bytecode);
+
+    cnd_program program;
+    cnd_program_load_il(&program, bytecode.data(), bytecode.size());
+    uint16_t keys[3] = {
+        cnd_get_key_id(&program, "route"),
+        cnd_get_key_id(&program, "f17"),
+        cnd_get_key_id(&program, "f190"),
+    };
+
+    std::vector<uint8_t> buffer(2 + 200 * 4, 0x5A);
+
+    for (auto _ : state) {
+        uint64_t sum = 0;
+        for (uint16_t key : keys) {
+            uint64_t v = 0;
+            cnd_field_read(&program, buffer.data(), buffer.size(), key, &v);
+            sum += v;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+BENCHMARK(BM_WideFieldRead);
+
+// --- Enum Validation Benchmark ---
+// Decodes 256 uint16 enum fields drawn from an enum of N values spaced by the
+// second argument: step 3 compiles to a bitmap, step 251 to a sorted table
+// (a linear scan up to 16 values).
+
+static void BM_DecodeEnumArray(benchmark::State& state) {
+    int count = (int)state.range(0);
+    int step = (int)state.range(1);
+    std::string schema = "enum E : uint16 {";
+    for (int i = 0; i < count; i++) {
+        schema += (i ? ", V" : " V") + std::to_string(i) + " = " + std::to_string(3 + i * step);
+    }
+    schema += " } packet P { E values[256]; }";
+    std::vector<uint8_t> il_image;
+    CompileSchema(schema.c_str(), il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    uint8_t buffer[512];
+    for (int i = 0; i < 256; i++) {
+        uint16_t v = (uint16_t)(3 + ((i * 7) % count) * step);
+        buffer[i * 2] = (uint8_t)v;
+        buffer[i * 2 + 1] = (uint8_t)(v >> 8);
+    }
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, sizeof(buffer), bench_io_callback_payload, NULL);
+        if (cnd_execute(&ctx) != CND_ERR_OK) state.SkipWithError("Enum value rejected");
+    }
+    state.SetItemsProcessed(state.iterations() * 256);
+}
+BENCHMARK(BM_DecodeEnumArray)->ArgsProduct({{4, 16, 64, 256}, {3, 251}});
+
+// --- Reused Struct Benchmark ---
+// A packet of N instances of one 10-field struct. Each instance calls the
+// struct's single subroutine, so the IL grows by a call per use rather than by
+// a copy of the struct.
+
+static void BM_DecodeReusedStructs(benchmark::State& state) {
+    int uses = (int)state.range(0);
+    std::string schema =
+        "struct Sample { uint16 id; uint32 time; uint8 flags; uint16 value; uint8 quality; "
+        "uint32 seq; int16 temp; int16 volt; uint8 mode; uint32 crc; } packet Log { ";
+    for (int i = 0; i < uses; i++) schema += "Sample s" + std::to_string(i) + "; ";
+    schema += "}";
+    std::vector<uint8_t> il_image;
+    CompileSchema(schema.c_str(), il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    std::vector<uint8_t> buffer((size_t)uses * 23, 0x5A);
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer.data(), buffer.size(), bench_io_callback_sink, NULL);
+        if (cnd_execute(&ctx) != CND_ERR_OK) state.SkipWithError("Decode failed");
+    }
+    state.SetItemsProcessed(state.iterations() * uses * 10);
+    state.counters["il_bytes"] = (double)il_image.size();
+    state.counters["bytecode"] = (double)program.bytecode_len;
+}
+BENCHMARK(BM_DecodeReusedStructs)->Arg(4)->Arg(32)->Arg(128);
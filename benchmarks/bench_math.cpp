@@ -174,3 +174,81 @@ static void BM_DecodeSpline(benchmark::State& state) {
     }
 }
 BENCHMARK(BM_DecodeSpline);
+
+// --- Derived Telemetry Benchmark ---
+// Four raw fields and eight fields computed from them. Arg 0 runs the
+// prepared program with checked stacks, Arg 1 with the depth proof from
+// cnd_program_prepare (unchecked expression evaluation).
+
+static cnd_error_t bench_io_callback_derived(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    uint64_t* sum = (uint64_t*)ctx->user_ptr;
+    if (type == OP_LOAD_CTX) {
+        *(uint64_t*)ptr = key_id * 5u + 3;
+    } else if (type == OP_STORE_CTX) {
+        *sum += *(uint64_t*)ptr;
+    } else if (type == OP_IO_U16 && ctx->mode == CND_MODE_ENCODE) {
+        *(uint16_t*)ptr = (uint16_t)(key_id * 5u + 3);
+    }
+    return CND_ERR_OK;
+}
+
+static const char* kDerivedSchema =
+    "packet Derived {"
+    "  uint16 v; uint16 i; uint16 t; uint16 n;"
+    "  @expr(v * i) uint32 power;"
+    "  @expr(v * i / 1000 + t) uint32 load;"
+    "  @expr(t * 9 / 5 + 32) uint16 temp_f;"
+    "  @expr(v + i + t + n) uint32 total;"
+    "  @expr(v * 3 + i * 5 - t) uint32 mix;"
+    "  @expr(n % 7 + v >> 2) uint16 phase;"
+    "  @expr(v & 255 | i << 8) uint32 packed;"
+    "  @expr(v * v + i * i) uint32 mag;"
+    "}";
+
+static void BM_EncodeDerivedPrepared(benchmark::State& state) {
+    std::vector<uint8_t> bytecode;
+    CompileSchema(kDerivedSchema, bytecode);
+
+    cnd_program program;
+    cnd_program_load_il(&program, bytecode.data(), bytecode.size());
+
+    size_t cap = 0;
+    cnd_program_prepare_size(&program, &cap);
+    std::vector<cnd_insn> insns(cap);
+    cnd_prepared prepared;
+    if (cnd_program_prepare(&prepared, &program, insns.data(), cap) != CND_ERR_OK || !prepared.stacks_verified) {
+        state.SkipWithError("prepare failed");
+        return;
+    }
+    if (state.range(0) == 0) prepared.stacks_verified = false;
+
+    uint8_t buffer[128];
+    uint64_t sum = 0;
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_derived, &sum);
+        cnd_execute_prepared(&ctx, &prepared);
+    }
+    benchmark::DoNotOptimize(sum);
+}
+BENCHMARK(BM_EncodeDerivedPrepared)->ArgName("unchecked")->Arg(0)->Arg(1);
+
+// Arg 1 compiles with -O, which evaluates each expression as one register
+// program instead of a run of stack instructions
+static void BM_EncodeDerived(benchmark::State& state) {
+    std::vector<uint8_t> bytecode;
+    CompileSchema(kDerivedSchema, bytecode, (int)state.range(0));
+
+    cnd_program program;
+    cnd_program_load_il(&program, bytecode.data(), bytecode.size());
+
+    uint8_t buffer[128];
+    uint64_t sum = 0;
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer, sizeof(buffer), bench_io_callback_derived, &sum);
+        cnd_execute(&ctx);
+    }
+    benchmark::DoNotOptimize(sum);
+}
+BENCHMARK(BM_EncodeDerived)->ArgName("opt")->Arg(0)->Arg(1);
@@ -0,0 +1,119 @@
+#include "bench_common.h"
+
+// --- Streaming Decode ---
+//
+// A 64 KiB upload arrives in 1460-byte chunks (one TCP segment each). The
+// host either copies the chunks into one buffer and runs cnd_execute() on
+// it, or feeds them to cnd_stream_feed() as they come, in which case the
+// payload reaches the callback as spans into the chunks. The whole-buffer
+// run is the lower bound.
+
+static const char* kUploadSchema =
+    "packet Upload {"
+    "  uint16 id;"
+    "  @crc_begin uint32 seq;"
+    "  uint8 payload[] prefix uint32;"
+    "  @crc(32) uint32 crc;"
+    "}";
+
+static const uint32_t kPayload = 64 * 1024;
+static const size_t kChunk = 1460;
+
+struct UploadSink {
+    uint32_t count;
+    uint64_t bytes;
+};
+
+static cnd_error_t upload_io(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    (void)key_id;
+    UploadSink* sink = (UploadSink*)ctx->user_ptr;
+    switch (type) {
+        case OP_ARR_PRE_U32:
+            if (ctx->mode == CND_MODE_ENCODE) *(uint32_t*)ptr = kPayload;
+            sink->count = *(uint32_t*)ptr;
+            break;
+        case OP_RAW_BYTES:
+            if (ctx->mode == CND_MODE_ENCODE) {
+                for (uint32_t i = 0; i < sink->count; i++) ((uint8_t*)ptr)[i] = (uint8_t)(i * 31);
+            }
+            sink->bytes += sink->count;
+            break;
+        case OP_ARR_SPAN:
+            sink->bytes += ((cnd_span*)ptr)->count;
+            break;
+        case OP_IO_U16: if (ctx->mode == CND_MODE_ENCODE) *(uint16_t*)ptr = 7; break;
+        case OP_IO_U32: if (ctx->mode == CND_MODE_ENCODE) *(uint32_t*)ptr = 1; break;
+        default: break;
+    }
+    return CND_ERR_OK;
+}
+
+struct UploadFixture {
+    std::vector<uint8_t> il;
+    cnd_program program;
+    std::vector<uint8_t> wire;
+
+    UploadFixture() {
+        CompileSchema(kUploadSchema, il);
+        cnd_program_load_il(&program, il.data(), il.size());
+        wire.resize(kPayload + 64);
+        UploadSink sink = {0, 0};
+        cnd_vm_ctx ctx;
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, wire.data(), wire.size(), upload_io, &sink);
+        cnd_execute(&ctx);
+        wire.resize(ctx.cursor);
+    }
+};
+
+static void BM_StreamWholeBuffer(benchmark::State& state) {
+    UploadFixture f;
+    UploadSink sink = {0, 0};
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &f.program, f.wire.data(), f.wire.size(), upload_io, &sink);
+        ctx.flags = CND_CTX_ARRAY_SPANS;
+        if (cnd_execute(&ctx) != CND_ERR_OK) state.SkipWithError("decode failed");
+    }
+    benchmark::DoNotOptimize(sink.bytes);
+    state.SetBytesProcessed(state.iterations() * f.wire.size());
+}
+BENCHMARK(BM_StreamWholeBuffer);
+
+static void BM_StreamReassemble(benchmark::State& state) {
+    UploadFixture f;
+    UploadSink sink = {0, 0};
+    std::vector<uint8_t> rx(f.wire.size());
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        for (size_t off = 0; off < f.wire.size(); off += kChunk) {
+            size_t n = std::min(kChunk, f.wire.size() - off);
+            memcpy(rx.data() + off, f.wire.data() + off, n);
+        }
+        cnd_init(&ctx, CND_MODE_DECODE, &f.program, rx.data(), rx.size(), upload_io, &sink);
+        ctx.flags = CND_CTX_ARRAY_SPANS;
+        if (cnd_execute(&ctx) != CND_ERR_OK) state.SkipWithError("decode failed");
+    }
+    benchmark::DoNotOptimize(sink.bytes);
+    state.SetBytesProcessed(state.iterations() * f.wire.size());
+}
+BENCHMARK(BM_StreamReassemble);
+
+static void BM_StreamChunks(benchmark::State& state) {
+    UploadFixture f;
+    UploadSink sink = {0, 0};
+    uint8_t carry[16];
+    cnd_stream stream;
+    for (auto _ : state) {
+        cnd_stream_init(&stream, &f.program, carry, sizeof(carry), upload_io, &sink);
+        stream.ctx.flags |= CND_CTX_ARRAY_SPANS;
+        cnd_error_t err = CND_ERR_NEED_MORE;
+        for (size_t off = 0; off < f.wire.size() && err == CND_ERR_NEED_MORE; off += kChunk) {
+            size_t n = std::min(kChunk, f.wire.size() - off);
+            err = cnd_stream_feed(&stream, f.wire.data() + off, n, NULL);
+        }
+        if (err != CND_ERR_OK) state.SkipWithError("stream failed");
+    }
+    benchmark::DoNotOptimize(sink.bytes);
+    state.SetBytesProcessed(state.iterations() * f.wire.size());
+}
+BENCHMARK(BM_StreamChunks);
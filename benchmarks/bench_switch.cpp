@@ -1,4 +1,5 @@
 #include "bench_common.h"
+#include <string>
 
 // --- Switch Benchmark ---
 
@@ -110,3 +111,147 @@ static void BM_SwitchDecode(benchmark::State& state) {
     }
 }
 BENCHMARK(BM_SwitchDecode);
+
+// --- Sparse Command Switch ---
+
+// A command decoder: uint16 opcode spread over the 16-bit space, one body per
+// opcode. state.range(0) is the number of commands.
+struct CommandBenchData {
+    uint64_t opcode;
+    uint64_t sink;
+};
+
+static cnd_error_t bench_command_callback(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    CommandBenchData* d = (CommandBenchData*)ctx->user_ptr;
+    if (type == OP_CTX_QUERY) {
+        *(uint64_t*)ptr = d->opcode;
+        return CND_ERR_OK;
+    }
+    if (ctx->mode == CND_MODE_ENCODE) {
+        uint64_t v = (key_id == 0) ? d->opcode : 0x5A;
+        switch (type) {
+            case OP_IO_U8: *(uint8_t*)ptr = (uint8_t)v; break;
+            case OP_IO_U16: *(uint16_t*)ptr = (uint16_t)v; break;
+            case OP_IO_U32: *(uint32_t*)ptr = (uint32_t)v; break;
+        }
+    } else {
+        uint64_t v = 0;
+        switch (type) {
+            case OP_IO_U8: v = *(uint8_t*)ptr; break;
+            case OP_IO_U16: v = *(uint16_t*)ptr; break;
+            case OP_IO_U32: v = *(uint32_t*)ptr; break;
+        }
+        if (key_id == 0) d->opcode = v;
+        else d->sink += v;
+    }
+    return CND_ERR_OK;
+}
+
+static void BM_SwitchSparseDecode(benchmark::State& state) {
+    static const char* types[] = {"uint8", "uint16", "uint32"};
+    int count = (int)state.range(0);
+    std::vector<uint16_t> opcodes;
+    std::string schema = "packet Command { uint16 opcode; switch (opcode) {";
+    for (int i = 0; i < count; i++) {
+        uint16_t op = (uint16_t)(i * 40503u + 0x0101);
+        opcodes.push_back(op);
+        schema += " case " + std::to_string(op) + ": " + types[i % 3] + " arg" + std::to_string(i) + ";";
+    }
+    schema += " } }";
+
+    std::vector<uint8_t> il_image;
+    CompileSchema(schema.c_str(), il_image);
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    std::vector<cnd_insn> storage;
+    cnd_prepared prepared;
+    bool use_prepared = state.range(1) != 0;
+    if (use_prepared) {
+        size_t cap = 0;
+        cnd_program_prepare_size(&program, &cap);
+        storage.resize(cap);
+        cnd_program_prepare(&prepared, &program, storage.data(), cap);
+    }
+
+    // Pre-encode a stream of commands in pseudo-random order
+    const int packets = 256;
+    std::vector<uint8_t> stream(packets * 8);
+    std::vector<size_t> lengths(packets);
+    CommandBenchData d = {0, 0};
+    uint32_t rng = 12345;
+    cnd_vm_ctx ctx;
+    for (int p = 0; p < packets; p++) {
+        rng = rng * 1103515245u + 12345u;
+        d.opcode = opcodes[(rng >> 16) % opcodes.size()];
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, &stream[p * 8], 8, bench_command_callback, &d);
+        cnd_execute(&ctx);
+        lengths[p] = ctx.cursor;
+    }
+
+    int p = 0;
+    for (auto _ : state) {
+        cnd_init(&ctx, CND_MODE_DECODE, &program, &stream[p * 8], lengths[p], bench_command_callback, &d);
+        if (use_prepared) cnd_execute_prepared(&ctx, &prepared);
+        else cnd_execute(&ctx);
+        p = (p + 1) & (packets - 1);
+    }
+    benchmark::DoNotOptimize(d.sink);
+}
+BENCHMARK(BM_SwitchSparseDecode)->ArgsProduct({{8, 32, 200}, {0, 1}});
+
+// --- Context Reads ---
+
+// A host that finds earlier fields by name, as the JSON binding does. Under
+// -O the switch, the count and the condition read the scoreboard instead.
+struct NamedBenchData {
+    const cnd_program* program;
+    std::vector<std::pair<std::string, uint64_t>> fields;
+};
+
+static cnd_error_t bench_named_callback(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    NamedBenchData* d = (NamedBenchData*)ctx->user_ptr;
+    const char* name = cnd_get_key_name(d->program, key_id);
+    if (!name) return CND_ERR_OK;
+
+    if (type == OP_CTX_QUERY || type == OP_LOAD_CTX) {
+        for (const auto& f : d->fields) {
+            if (f.first == name) { *(uint64_t*)ptr = f.second; return CND_ERR_OK; }
+        }
+        return CND_ERR_CALLBACK;
+    }
+    uint64_t v = 0;
+    switch (type) {
+        case OP_IO_U8: v = *(uint8_t*)ptr; break;
+        case OP_IO_U16: v = *(uint16_t*)ptr; break;
+        default: return CND_ERR_OK;
+    }
+    if (d->fields.size() < 8) d->fields.emplace_back(name, v);
+    return CND_ERR_OK;
+}
+
+static void BM_ContextReadDecode(benchmark::State& state) {
+    const char* schema = R"(
+        packet Frame {
+            uint8 version; uint8 flags; uint16 length; uint8 kind; uint8 n;
+            switch (kind) { case 1: uint32 a; case 2: uint16 b; default: uint8 c; }
+            @count(n) uint8 items[];
+            if (flags == 3) { uint16 extra; }
+        }
+    )";
+    std::vector<uint8_t> il_image;
+    CompileSchema(schema, il_image, (int)state.range(0));
+    cnd_program program;
+    cnd_program_load_il(&program, il_image.data(), il_image.size());
+
+    uint8_t buffer[] = {1, 3, 20, 0, 2, 4, 0x34, 0x12, 9, 8, 7, 6, 0xAA, 0xBB};
+    NamedBenchData d = {&program, {}};
+    d.fields.reserve(8);
+    cnd_vm_ctx ctx;
+    for (auto _ : state) {
+        d.fields.clear();
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buffer, sizeof(buffer), bench_named_callback, &d);
+        if (cnd_execute(&ctx) != CND_ERR_OK) { state.SkipWithError("decode failed"); break; }
+    }
+}
+BENCHMARK(BM_ContextReadDecode)->Arg(0)->Arg(1);
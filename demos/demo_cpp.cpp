@@ -2,8 +2,9 @@
 #include <fstream>
 #include <vector>
 #include <iomanip>
-#include <cstring>
-#include "concordia.h"
+#include <iterator>
+#include "concordia.hpp"
+#include "telemetry_il.h" // telemetry.cnd compiled and embedded at build time (`cnd embed`)
 
 // --- Application Data Class ---
 struct TelemetryData {
@@ -13,75 +14,47 @@ struct TelemetryData {
     uint8_t status;
 };
 
-// --- C++ Wrapper for Callback ---
-// We can use a static method or a lambda-friendly wrapper.
-// Since the VM is C, we must pass a C-compatible function pointer.
-extern "C" cnd_error_t cpp_io_callback(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
-    (void)type;
-    auto* data = static_cast<TelemetryData*>(ctx->user_ptr);
+// --- Visitor ---
+// concordia.hpp calls the overload matching each field's type, so there is
+// no switch on the type opcode and no void* to cast. cnd::transfer copies in
+// the direction of the run: into the wire value when encoding, out of it when
+// decoding. Keys are the field indices of telemetry.cnd.
+template <cnd_mode_t Mode>
+struct TelemetryVisitor {
+    TelemetryData& data;
 
-    switch (key_id) {
-        case 0: // device_id
-            if (ctx->mode == CND_MODE_ENCODE) *static_cast<uint32_t*>(ptr) = data->device_id;
-            else data->device_id = *static_cast<uint32_t*>(ptr);
-            break;
-        case 1: // temperature
-            if (ctx->mode == CND_MODE_ENCODE) *static_cast<float*>(ptr) = data->temperature;
-            else data->temperature = *static_cast<float*>(ptr);
-            break;
-        case 2: // battery_level
-            if (ctx->mode == CND_MODE_ENCODE) *static_cast<uint8_t*>(ptr) = data->battery_level;
-            else data->battery_level = *static_cast<uint8_t*>(ptr);
-            break;
-        case 3: // status
-            if (ctx->mode == CND_MODE_ENCODE) *static_cast<uint8_t*>(ptr) = data->status;
-            else data->status = *static_cast<uint8_t*>(ptr);
-            break;
-        default:
-            return CND_ERR_INVALID_OP;
-    }
-    return CND_ERR_OK;
+    void on(uint16_t, uint32_t& v) { cnd::transfer<Mode>(v, data.device_id); }
+    void on(uint16_t, float& v) { cnd::transfer<Mode>(v, data.temperature); }
+    void on(uint16_t key, uint8_t& v) { cnd::transfer<Mode>(v, key == 2 ? data.battery_level : data.status); }
+};
+
+static void print(const TelemetryData& d) {
+    std::cout << "Device ID: 0x" << std::hex << d.device_id << std::dec << std::endl;
+    std::cout << "Temperature: " << d.temperature << std::endl;
+    std::cout << "Battery: " << (int)d.battery_level << "%" << std::endl;
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: demo_cpp <path_to_telemetry.il>" << std::endl;
-        return 1;
-    }
-
-    // Load IL File
-    std::ifstream file(argv[1], std::ios::binary | std::ios::ate);
-    if (!file) {
-        std::cerr << "Failed to open IL file" << std::endl;
+    // The schema is known at compile time: its fixed fields are unrolled
+    static const cnd::embedded<telemetry_il, sizeof(telemetry_il)> telemetry;
+    if (telemetry.status() != CND_ERR_OK) {
+        std::cerr << "Invalid embedded IL" << std::endl;
         return 1;
     }
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    std::vector<uint8_t> il_data(size);
-    if (!file.read((char*)il_data.data(), size)) return 1;
-
-    // Parse Header
-    if (size < 16) return 1;
-    uint32_t bytecode_offset = *reinterpret_cast<uint32_t*>(il_data.data() + 12);
-    
-    cnd_program program;
-    cnd_program_load(&program, il_data.data() + bytecode_offset, size - bytecode_offset);
 
     // --- ENCODE ---
     std::cout << "--- C++ Encoding ---" << std::endl;
     TelemetryData data = { 0xCAFEBABE, 36.6f, 100, 0 };
-    
+
     std::vector<uint8_t> buffer(128);
-    cnd_vm_ctx ctx;
-    cnd_init(&ctx, CND_MODE_ENCODE, &program, buffer.data(), buffer.size(), cpp_io_callback, &data);
-    
-    if (cnd_execute(&ctx) != CND_ERR_OK) {
+    size_t size = 0;
+    if (cnd::encode(telemetry, buffer.data(), buffer.size(), TelemetryVisitor<CND_MODE_ENCODE>{data}, &size) != CND_ERR_OK) {
         std::cerr << "Encoding failed" << std::endl;
         return 1;
     }
 
-    std::cout << "Encoded " << ctx.cursor << " bytes: ";
-    for(size_t i=0; i<ctx.cursor; i++) {
+    std::cout << "Encoded " << size << " bytes: ";
+    for (size_t i = 0; i < size; i++) {
         std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)buffer[i] << " ";
     }
     std::cout << std::dec << std::endl;
@@ -89,16 +62,32 @@ int main(int argc, char** argv) {
     // --- DECODE ---
     std::cout << "\n--- C++ Decoding ---" << std::endl;
     TelemetryData decoded = {};
-    cnd_init(&ctx, CND_MODE_DECODE, &program, buffer.data(), ctx.cursor, cpp_io_callback, &decoded);
-    
-    if (cnd_execute(&ctx) != CND_ERR_OK) {
+    if (cnd::decode(telemetry, buffer.data(), size, TelemetryVisitor<CND_MODE_DECODE>{decoded}) != CND_ERR_OK) {
         std::cerr << "Decoding failed" << std::endl;
         return 1;
     }
+    print(decoded);
 
-    std::cout << "Device ID: 0x" << std::hex << decoded.device_id << std::dec << std::endl;
-    std::cout << "Temperature: " << decoded.temperature << std::endl;
-    std::cout << "Battery: " << (int)decoded.battery_level << "%" << std::endl;
+    // --- DECODE (IL loaded at run time) ---
+    // The same visitor works with any program; only the unrolling needs the
+    // schema at compile time
+    if (argc > 1) {
+        std::ifstream file(argv[1], std::ios::binary);
+        std::vector<uint8_t> il_data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        cnd_program program;
+        if (cnd_program_load_il(&program, il_data.data(), il_data.size()) != CND_ERR_OK) {
+            std::cerr << "Failed to load " << argv[1] << std::endl;
+            return 1;
+        }
+
+        std::cout << "\n--- C++ Decoding (" << argv[1] << ") ---" << std::endl;
+        TelemetryData loaded = {};
+        if (cnd::decode(program, buffer.data(), size, TelemetryVisitor<CND_MODE_DECODE>{loaded}) != CND_ERR_OK) {
+            std::cerr << "Decoding failed" << std::endl;
+            return 1;
+        }
+        print(loaded);
+    }
 
     return 0;
 }
@@ -149,6 +149,10 @@ func LoadProgram(data []byte) (*Program, error) {
 		cProg.bytecode_len = cLen
 		cProg.string_table = nil
 		cProg.string_count = 0
+		cProg.layout = nil
+		cProg.layout_count = 0
+		cProg.min_size = 0
+		cProg.max_size = 0
 	}
 
 	return &Program{
@@ -16,6 +16,7 @@ const (
 	ErrStackUnderflow Error = 6
 	ErrCRCMismatch Error = 7
 	ErrArithmetic Error = 8
+	ErrNeedMore Error = 9
 )
 
 const (
@@ -11,6 +11,10 @@ extern "C" {
 // Returns 0 on success, non-zero on error
 int cnd_compile_file(const char* in_path, const char* out_path, int json_output, int verbose);
 
+// Same as cnd_compile_file; an `opt_level` above 0 runs the IL optimizer
+// (cnd compile -O) and reports the bytecode size before and after
+int cnd_compile_file_ex(const char* in_path, const char* out_path, int json_output, int verbose, int opt_level);
+
 // Format a .cnd file
 // If out_path is NULL, prints to stdout
 int cnd_format_file(const char* in_path, const char* out_path);
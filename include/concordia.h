@@ -34,6 +34,15 @@ extern "C" {
 #define OP_IO_F64           0x19
 #define OP_IO_BOOL          0x1A
 
+// Category B (cont.): Superinstructions emitted by `cnd compile -O`. They are
+// built from the bytes of the instructions they replace, so each field still
+// looks like a single OP_IO_* Type(1) Key(2) to the host and to field scans.
+// OP_IO_SLOT marks a field that later expressions, switches or counts read:
+// its value is also kept in the scoreboard (see cnd_vm_ctx).
+#define OP_IO_RUN           0x1B // Count(1) Bytes(2) + Count * {Type(1) Key(2)}, one bounds check
+#define OP_IO_CHECK         0x1C // Type(1) Key(2) + an OP_RANGE_CHECK or OP_ENUM_* of that type
+#define OP_IO_SLOT          0x1D // Type(1) Key(2) of an integer or bool field kept in the scoreboard
+
 // Category C: Bitfields & Padding
 #define OP_IO_BIT_U         0x20
 #define OP_IO_BIT_I         0x21
@@ -42,6 +51,7 @@ extern "C" {
 #define OP_ALIGN_FILL       0x24
 #define OP_ENTER_BIT_MODE   0x25
 #define OP_EXIT_BIT_MODE    0x26
+#define OP_IO_BIT_GROUP     0x27 // Count(1) + Count * {Type(1) Key(2) Width(1)}, see cnd_bit_group
 
 // Category D: Arrays & Strings
 #define OP_STR_NULL         0x30
@@ -56,6 +66,7 @@ extern "C" {
 #define OP_RAW_BYTES        0x39
 #define OP_ARR_EOF          0x3A
 #define OP_ARR_DYNAMIC      0x3B
+#define OP_ARR_SPAN         0x3C // Callback event only (cnd_span*), see CND_CTX_ARRAY_SPANS
 
 // Category E: Validation
 #define OP_CONST_CHECK      0x40
@@ -72,12 +83,26 @@ extern "C" {
 #define OP_ENUM_CHECK       0x4B
 #define OP_TRANS_POLY       0x4C
 #define OP_TRANS_SPLINE     0x4D
+#define OP_CRC_BEGIN        0x4E // Start the CRC region at the cursor
+#define OP_CRC_END          0x4F // End the CRC region at the cursor
 
 // Category F: Control Flow
 #define OP_JUMP_IF_NOT      0x50
 #define OP_SWITCH           0x51
 #define OP_JUMP             0x52
 #define OP_SWITCH_TABLE     0x53
+#define OP_SWITCH_SORTED    0x54 // OP_SWITCH with cases sorted by value (binary search)
+#define OP_SWITCH_HASH      0x55 // OP_SWITCH over a perfect-hash table
+
+// Category E (cont.): Enum validation encodings chosen by the compiler
+#define OP_ENUM_BITMAP      0x56 // Type(1) Base(type size) Span(2) Bits((Span+7)/8)
+#define OP_ENUM_SORTED      0x57 // OP_ENUM_CHECK with values in ascending order
+
+// Category F (cont.): Struct subroutines. Key IDs inside a subroutine are
+// relative to the key base set by its OP_CALL; OP_RET at the top level ends
+// the program.
+#define OP_CALL             0x58 // KeyBase(2) KeyCount(2) Offset(4), base relative to the caller's
+#define OP_RET              0x59
 
 // Category G: Expression Stack & ALU
 #define OP_LOAD_CTX         0x60
@@ -88,6 +113,26 @@ extern "C" {
 #define OP_DUP              0x64
 #define OP_EMIT             0x65
 
+// Category G (cont.): Register expressions emitted by `cnd compile -O`. An
+// OP_EXPR pushes the result of a whole expression, computed by a register
+// program with CND_EXPR_REGS integer (r, uint64) and float (f, double)
+// registers. Register instructions are Op(1) D(1) A(1) B(1); OP_REG_CONST and
+// OP_REG_FCONST carry 8 more bytes. The ALU opcodes above compute
+// rD = rA op rB, or rD = op rA when unary; float arithmetic and math
+// functions use f registers, float comparisons write rD, OP_ITOF reads rA
+// into fD and OP_FTOI reads fA into rD. An integer operation whose D has
+// CND_EXPR_IMM set takes B as a signed 8-bit immediate instead of rB.
+#define OP_EXPR             0x66 // Len(1) + Len bytes of register instructions, ending in OP_REG_RET
+#define OP_REG_LOAD         0x79 // rD = context value of key A | B << 8 (as OP_LOAD_CTX)
+#define OP_REG_IMM          0x7A // rD = A | B << 8, sign-extended
+#define OP_REG_CONST        0x7B // rD = the 8-byte value that follows
+#define OP_REG_FCONST       0x7C // fD = the 8-byte IEEE double that follows
+#define OP_REG_ITOB         0x7D // fD = the bits of rA
+#define OP_REG_BTOI         0x7E // rD = the bits of fA
+#define OP_REG_RET          0x7F // Result: rA, or the bits of fA when B is 1
+
+#define CND_EXPR_IMM        0x80 // D flag: B is an immediate
+
 // Arithmetic (Integer)
 #define OP_ADD              0x72
 #define OP_SUB              0x73
@@ -156,7 +201,8 @@ typedef enum {
     CND_ERR_STACK_OVERFLOW = 5,
     CND_ERR_STACK_UNDERFLOW = 6,
     CND_ERR_CRC_MISMATCH = 7,   // CRC check failed
-    CND_ERR_ARITHMETIC = 8      // Arithmetic error (div by zero, overflow, etc.)
+    CND_ERR_ARITHMETIC = 8,     // Arithmetic error (div by zero, overflow, etc.)
+    CND_ERR_NEED_MORE = 9       // Streaming decode ran out of input (see cnd_stream_feed)
 } cnd_error_t;
 
 typedef enum {
@@ -164,6 +210,12 @@ typedef enum {
     CND_MODE_DECODE = 1  // Binary -> Map
 } cnd_mode_t;
 
+typedef enum {
+    CND_DISPATCH_AUTO = 0,     // Threaded when compiled in, otherwise switch
+    CND_DISPATCH_SWITCH = 1,   // Portable switch-based loop
+    CND_DISPATCH_THREADED = 2  // Computed-goto loop (GCC/Clang, CND_THREADED_DISPATCH)
+} cnd_dispatch_t;
+
 typedef enum {
     CND_LE = 0, // Little Endian
     CND_BE = 1  // Big Endian
@@ -182,12 +234,20 @@ typedef enum {
 
 #define CND_MAX_LOOP_DEPTH 8
 #define CND_MAX_EXPR_STACK 8
+#define CND_EXPR_REGS CND_MAX_EXPR_STACK // Registers of each type in an OP_EXPR
+#define CND_MAX_CALL_DEPTH 16
+#define CND_SCOREBOARD_SLOTS 16 // Field values a run keeps for later expressions (power of 2)
 
 typedef struct {
     size_t start_ip;
     uint32_t remaining;
 } cnd_loop_frame;
 
+typedef struct {
+    size_t return_ip;
+    uint16_t key_base;  // Caller's key base
+} cnd_call_frame;
+
 // Forward declaration for the IO callback
 struct cnd_vm_ctx_t;
 
@@ -201,11 +261,71 @@ typedef cnd_error_t (*cnd_io_cb)(
     void* data_ptr       // Pointer to read from or write to
 );
 
+// Bulk array events (OP_ARR_SPAN). Arrays whose body is a single primitive
+// (optionally with @scale/@offset) are delivered as one or more spans of
+// consecutive elements in host byte order instead of one event per element.
+// Decode: read `count` elements from `data`. Encode: write them to `data`.
+// The spans of an array arrive in order and replace its OP_ARR_END event.
+typedef struct {
+    void* data;      // Elements in host byte order; may be unaligned
+    uint32_t first;  // Index of the first element within the array
+    uint32_t count;  // Elements in this span
+    uint8_t type;    // Element type (OP_IO_*); OP_IO_F64 for scaled arrays
+} cnd_span;
+
+// Packed bitfield events (OP_IO_BIT_GROUP). The compiler merges runs of
+// adjacent bitfields of up to 64 bits into one instruction that reads or
+// writes the container once. By default the VM still reports each field as
+// its own OP_IO_BIT_* event; hosts that set CND_CTX_BIT_GROUPS get the whole
+// run as one event keyed by its first field instead.
+// `fields` describes field i in four bytes: type (OP_IO_BIT_U/I/BOOL), Key ID
+// (little-endian) and width. Decode: read `values` (zero-extended, or
+// sign-extended for OP_IO_BIT_I) or unpack `word`, the `bits`-bit container
+// with the first field in its most (big-endian bit order) or least
+// (little-endian) significant bits. Encode: fill `values`. Add `key_base` to
+// the Key IDs in `fields` when the group sits in a struct subroutine.
+#define CND_MAX_BIT_GROUP 64
+
+typedef struct {
+    uint64_t word;                       // Decode only: the container as read
+    uint64_t values[CND_MAX_BIT_GROUP];  // One value per field
+    const uint8_t* fields;               // Field descriptors (count * 4 bytes)
+    uint8_t count;                       // Fields in the group
+    uint8_t bits;                        // Total width
+    uint16_t key_base;                   // Added to the Key IDs in `fields`
+} cnd_bit_group;
+
+// ctx->flags
+#define CND_CTX_ARRAY_SPANS 0x01 // Host handles OP_ARR_SPAN (always on for cnd_bind_io)
+#define CND_CTX_BIT_GROUPS  0x02 // Host handles OP_IO_BIT_GROUP events (cnd_bit_group*)
+#define CND_CTX_STREAM      0x04 // Decode input arrives in chunks (set by cnd_stream_init)
+#define CND_CTX_STREAM_END  0x08 // No input follows the current buffer (set by cnd_stream_finish)
+
+// --- IL Image Format ---
+// Header: "CNDIL" Ver(1) StrCount(2) StrOff(4) BCOff(4), then for v2
+// LayoutOff(4) LayoutCount(2) Reserved(2), then for v3 MinSize(4) MaxSize(4).
+// All fields are little-endian. Bytecode runs from BCOff to the end of the image.
+// MinSize/MaxSize bound the encoded packet in bytes (see cnd_program_size_bounds);
+// MaxSize 0 means unbounded.
+
+#define CND_IL_VERSION        3
+#define CND_IL_HEADER_SIZE    32 // v3 (v2 headers are 24 bytes, v1 headers 16)
+
+// Static layout entry: Key(2) Type(1) Info(1) BitOffset(4), sorted by Key ID.
+// Type is the wire opcode (OP_IO_* or OP_IO_BIT_*); Info holds the width in
+// bits, with CND_LAYOUT_BE set for big-endian fields.
+#define CND_LAYOUT_ENTRY_SIZE 8
+#define CND_LAYOUT_BE         0x80
+
 typedef struct {
     const uint8_t* bytecode;    // Pointer to IL Bytecode
     size_t bytecode_len;        // Length of IL Bytecode
     const char* string_table;   // Pointer to string table (packed null-terminated strings)
     uint16_t string_count;      // Number of strings in the table
+    const uint8_t* layout;      // Static layout entries (NULL if absent)
+    uint16_t layout_count;      // Number of layout entries
+    uint32_t min_size;          // Smallest encoded packet in bytes (0 if unknown)
+    uint32_t max_size;          // Largest encoded packet in bytes (0 if unbounded or unknown)
 } cnd_program;
 
 typedef struct cnd_vm_ctx_t {
@@ -218,6 +338,8 @@ typedef struct cnd_vm_ctx_t {
     
     cnd_io_cb io_callback;      // Host callback for mapping KeyIDs to values
     void* user_ptr;             // User context for the callback
+    uint8_t flags;              // CND_CTX_* options (cleared by cnd_init)
+    size_t batch_index;         // Packet being run by cnd_execute_batch() (0 otherwise)
 
     // --- Runtime State ---
     size_t ip;                  // Instruction Pointer (Index into il_code)
@@ -241,13 +363,150 @@ typedef struct cnd_vm_ctx_t {
 
     bool is_next_optional;      // If true, OOB reads return 0 instead of error
 
+    // CRC Region State (OP_CRC_BEGIN / OP_CRC_END)
+    size_t crc_start;           // First byte covered by CRC fields
+    size_t crc_end;             // End of the region (SIZE_MAX while open)
+    size_t crc_done;            // Bytes [crc_start, crc_done) are already in crc_reg
+    uint32_t crc_reg;           // Running CRC register
+    uint32_t crc_poly;          // Parameters crc_reg was computed with
+    uint32_t crc_init;
+    uint8_t crc_flags;
+    uint8_t crc_width;          // 0 = no running register
+
     cnd_loop_frame loop_stack[CND_MAX_LOOP_DEPTH];
     uint8_t loop_depth;
 
+    uint16_t key_base;          // Added to every Key ID in the IL (see OP_CALL)
+    cnd_call_frame call_stack[CND_MAX_CALL_DEPTH];
+    uint8_t call_depth;
+
     uint64_t expr_stack[CND_MAX_EXPR_STACK];
     uint8_t expr_sp;
+
+    // Scoreboard: values of OP_IO_SLOT fields and OP_STORE_CTX, in slot
+    // Key ID % CND_SCOREBOARD_SLOTS. Context reads of a key found here do not
+    // call the host.
+    uint16_t slot_valid;        // Bit per slot; cleared at the start of every run
+    uint16_t slot_keys[CND_SCOREBOARD_SLOTS];
+    uint64_t slot_values[CND_SCOREBOARD_SLOTS];
+
+    // Streaming decode (CND_CTX_STREAM). An instruction that runs out of
+    // input is undone back to its mark; a byte array running past the input
+    // goes to the host as it arrives, span_left bytes still to come.
+    size_t mark_ip;
+    size_t mark_cursor;
+    uint8_t mark_bit_offset;
+    uint8_t mark_expr_sp;
+    uint8_t span_type;
+    uint16_t span_key;
+    uint32_t span_first;
+    uint32_t span_left;
 } cnd_vm_ctx;
 
+// --- Streaming Decode ---
+
+// Decode run fed one chunk at a time (cnd_stream_feed). Fields are decoded
+// straight out of each chunk; only the bytes of a field split between two
+// chunks are copied, into `carry`, which must hold the largest such field
+// (strings included). Byte arrays are never copied: with CND_CTX_ARRAY_SPANS
+// one that runs past a chunk arrives as OP_ARR_SPAN events as its bytes do,
+// otherwise as one OP_IO_U8 event per byte.
+typedef struct {
+    cnd_vm_ctx ctx;         // Run state kept between chunks
+    uint8_t* carry;         // Host buffer for a field split between chunks
+    size_t carry_size;
+    size_t carry_len;       // Bytes waiting in `carry`
+    uint32_t crc_poly;      // Parameters shared by the program's CRC fields
+    uint32_t crc_init;
+    uint8_t crc_flags;
+    uint8_t crc_width;      // 0 = the program has no CRC field
+} cnd_stream;
+
+// --- Prepared Programs ---
+
+// A pre-decoded instruction. Operands are unpacked into fixed fields and all
+// jump, loop-exit and switch targets are absolute instruction indices.
+// Switches, OP_RANGE_CHECK, OP_ENUM_BITMAP and OP_SCALE_LIN are followed by
+// extension slots carrying the rest of their operands.
+typedef struct {
+    uint8_t op;     // Opcode (OP_*)
+    uint8_t arg;    // Type opcode, bit width, CRC flags, fill bit or point count
+    uint16_t key;   // Key ID
+    uint32_t a;     // Count, max length, or absolute target (jump / call / loop exit / default case)
+    uint64_t imm;   // Immediate value, bound, scale factor, case value or bytecode offset
+} cnd_insn;
+
+typedef struct {
+    const cnd_program* program; // Source program (string table, enum and transform tables)
+    const cnd_insn* insns;      // Pre-decoded instructions
+    size_t insn_count;          // Number of instructions (including extension slots)
+    size_t fixed_count;         // Leading instructions whose fields are always at the same place
+    size_t fixed_size;          // Bytes those fields occupy
+    bool stacks_verified;       // Expression and loop stack depths proved at prepare time
+    uint8_t max_stack_depth;    // Deepest expression stack of any path (when verified)
+    uint8_t max_loop_depth;     // Most arrays open at once on any path (when verified)
+} cnd_prepared;
+
+// --- Native Code ---
+
+// Machine code generated for a prepared program (CND_JIT builds on x86-64 Linux)
+typedef struct {
+    const cnd_prepared* prepared; // Program the code was generated for
+    void* code;                   // Executable mapping, owned by the cnd_jit
+    size_t code_size;             // Bytes mapped
+    size_t entry[2];              // Entry point offsets, indexed by cnd_mode_t
+} cnd_jit;
+
+// --- Native Struct Binding ---
+
+#define CND_MAX_BIND_DEPTH 16 // Nested structs + arrays a binder can track
+
+// How one Key ID maps onto host memory. Offsets are relative to the innermost
+// enclosing struct (the root host struct for top-level fields).
+typedef struct {
+    uint32_t offset;       // offsetof() the field (array: first element)
+    uint32_t stride;       // Array element size in bytes; 0 for non-array fields
+    uint32_t capacity;     // Arrays: max elements; strings: buffer size incl. NUL
+    uint32_t count_offset; // Variable arrays: offsetof() the host element count
+    uint8_t type;          // Host value type: OP_IO_*, OP_STR_NULL (char buffer) or OP_ENTER_STRUCT; 0 = unbound
+    uint8_t count_type;    // Host count type (OP_IO_U8..OP_IO_U64); 0 = no count field
+} cnd_binding;
+
+typedef struct {
+    uint8_t* base;   // Struct that field offsets are relative to
+    uint8_t* elems;  // Array frames: first element
+    uint32_t stride; // Array frames: element size
+    uint32_t index;  // Array frames: next element
+    uint32_t limit;  // Array frames: element count
+    uint16_t key;    // Array frames: array Key ID; 0xFFFF for struct frames
+} cnd_bind_frame;
+
+typedef struct {
+    const cnd_binding* table;   // Indexed by Key ID
+    uint16_t count;             // Number of table entries
+    uint8_t depth;              // Active frames
+    cnd_bind_frame frames[CND_MAX_BIND_DEPTH];
+} cnd_binder;
+
+// --- Batch Execution ---
+
+// Packets for cnd_execute_batch(): either one packed buffer with per-packet
+// offsets, or one buffer pointer per packet.
+typedef struct {
+    uint8_t* base;            // Packed buffer; NULL to use `buffers`
+    const size_t* offsets;    // Packed: start of each packet within `base`
+    uint8_t* const* buffers;  // Unpacked: one buffer per packet
+    const size_t* lengths;    // Packet length (encode: buffer capacity)
+    size_t count;             // Number of packets
+    size_t host_stride;       // Bound runs: bytes between consecutive root structs (0 = same struct)
+} cnd_batch;
+
+// Columnar batches: one column per Key ID, element i belongs to packet i.
+typedef struct {
+    void* data;    // Column storage (at least batch->count elements)
+    uint8_t type;  // Element type (OP_IO_*); 0 = no column for this key
+} cnd_column;
+
 // --- 3. Public API ---
 
 /**
@@ -259,7 +518,8 @@ void cnd_program_load(cnd_program* program, const uint8_t* bytecode, size_t len)
 
 /**
  * Load a program from a full IL binary image (Header + Strings + Bytecode).
- * Parses the header to locate bytecode and string table.
+ * Parses the header to locate bytecode, string table, (v2) layout table and
+ * (v3) packet size bounds. Accepts IL versions 1 to 3.
  * Returns CND_ERR_OK on success, or CND_ERR_INVALID_OP if header is invalid.
  */
 cnd_error_t cnd_program_load_il(cnd_program* program, const uint8_t* image, size_t len);
@@ -287,16 +547,199 @@ void cnd_init(cnd_vm_ctx* ctx,
 
 /**
  * Execute the VM until completion or error.
+ * Encode and decode run in separately compiled loops selected from ctx->mode
+ * at entry; changing ctx->mode from a callback has no effect on the run.
+ * With CND_CTX_STREAM (decode only, switch loop) an instruction that runs
+ * out of data is undone and the run returns CND_ERR_NEED_MORE; cnd_stream_feed()
+ * builds on this.
  */
 cnd_error_t cnd_execute(cnd_vm_ctx* ctx);
 
+/**
+ * Execute the VM with an explicit dispatch strategy.
+ * Results are identical for every strategy. Returns CND_ERR_INVALID_OP if
+ * the requested strategy was not compiled into the library.
+ */
+cnd_error_t cnd_execute_dispatch(cnd_vm_ctx* ctx, cnd_dispatch_t dispatch);
+
+/**
+ * Start a streaming decode of one packet. ctx.flags options other than the
+ * CND_CTX_STREAM ones may be set afterwards (e.g. CND_CTX_ARRAY_SPANS).
+ * Bytes that leave the stream are hashed as they go, so all CRC fields of the
+ * program must share their parameters (CND_ERR_INVALID_OP otherwise), as they
+ * do in practice. Also CND_ERR_INVALID_OP without a carry buffer.
+ */
+cnd_error_t cnd_stream_init(cnd_stream* stream, const cnd_program* program,
+                            uint8_t* carry, size_t carry_size,
+                            cnd_io_cb cb, void* user);
+
+/**
+ * Decode the next chunk of input. Returns CND_ERR_NEED_MORE when the chunk
+ * ran out: the instruction that needed more is undone (ctx.ip points at it)
+ * and resumes from the next chunk; no field before it is decoded again.
+ * Returns CND_ERR_OK when the packet is complete; `used` (optional) then
+ * tells how much of the chunk it took, the rest belongs to the next packet.
+ * A field split between chunks that does not fit the carry fails with
+ * CND_ERR_OOB. The chunk only has to live for the duration of the call.
+ */
+cnd_error_t cnd_stream_feed(cnd_stream* stream, const uint8_t* chunk, size_t len, size_t* used);
+
+/**
+ * End of input: run the rest of the packet on the bytes already fed, where
+ * @optional fields and until-EOF arrays see the end of the data, like
+ * cnd_execute() on the whole packet. Never returns CND_ERR_NEED_MORE.
+ */
+cnd_error_t cnd_stream_finish(cnd_stream* stream);
+
+/** Start the next packet with the same program, callback and flags. */
+void cnd_stream_reset(cnd_stream* stream);
+
+/**
+ * Run one program over many packets with a single context set up by
+ * cnd_init() (its data buffer is ignored). Loop selection and state that
+ * does not change between packets are done once; the next packet is
+ * prefetched while the current one runs. ctx->batch_index tells the callback
+ * which packet is running. With cnd_bind_io the binder is rewound before each
+ * packet and its root struct advances by batch->host_stride.
+ * `errors` and `used` (bytes consumed or written) are optional per-packet
+ * outputs. Returns the first packet error, or CND_ERR_OK if every packet
+ * succeeded; a failing packet does not stop the batch.
+ */
+cnd_error_t cnd_execute_batch(cnd_vm_ctx* ctx, const cnd_batch* batch,
+                              cnd_error_t* errors, size_t* used);
+
+/**
+ * Decode a batch of packets into per-field columns (`columns` is indexed by
+ * Key ID). Values are converted to the column type; fields without a column
+ * are skipped. When a key repeats within a packet its last value is kept.
+ * Programs whose fields all have a fixed position are decoded column by
+ * column straight from the layout table once the first packet has been
+ * validated by the VM. `errors` is optional; returns the first packet error.
+ */
+cnd_error_t cnd_decode_columns(const cnd_program* program, const cnd_batch* batch,
+                               const cnd_column* columns, uint16_t column_count,
+                               cnd_error_t* errors);
+
+/**
+ * Encode a batch of packets from per-field columns, the reverse of
+ * cnd_decode_columns(). Every scalar field and array count the program
+ * encodes needs a column (CND_ERR_CALLBACK otherwise); strings are not
+ * supported. `errors` and `used` (bytes written) are optional.
+ */
+cnd_error_t cnd_encode_columns(const cnd_program* program, const cnd_batch* batch,
+                               const cnd_column* columns, uint16_t column_count,
+                               cnd_error_t* errors, size_t* used);
+
 /**
  * Verify a program's bytecode for basic structural validity.
  * Checks for invalid opcodes, out-of-bounds arguments, and invalid jump targets.
+ * Packet size bounds loaded from the IL header must hold for the bytecode
+ * (CND_ERR_VALIDATION otherwise).
  * Returns CND_ERR_OK if valid.
  */
 cnd_error_t cnd_verify_program(const cnd_program* program);
 
+/**
+ * Compute the smallest and largest encoded packet of a program, in bytes, by
+ * walking every path through its bytecode (branches, switch cases, array
+ * bodies and subroutines). *max_size is 0 when the packet has no upper bound
+ * (EOF, dynamic or 32-bit prefixed arrays and strings) or its bytecode is not
+ * shaped the way the compiler emits it. The compiler stores the result in the
+ * IL header.
+ */
+cnd_error_t cnd_program_size_bounds(const cnd_program* program, uint32_t* min_size, uint32_t* max_size);
+
+/**
+ * Get the number of cnd_insn slots cnd_program_prepare() needs for a program.
+ * This includes scratch space used while resolving jump targets and proving
+ * stack depths, so it is larger than the final instruction count.
+ */
+cnd_error_t cnd_program_prepare_size(const cnd_program* program, size_t* out_capacity);
+
+/**
+ * Verify a program once and translate it into pre-decoded instructions.
+ * `storage` must hold at least cnd_program_prepare_size() slots and must outlive
+ * the prepared program, as must the program's bytecode.
+ * Preparing also bounds the expression and loop stacks of every path. When
+ * that succeeds (stacks_verified), runs from instruction 0 evaluate
+ * expressions without per-operation stack checks; otherwise they stay checked.
+ * Returns CND_ERR_OOB if storage is too small.
+ */
+cnd_error_t cnd_program_prepare(cnd_prepared* prepared, const cnd_program* program,
+                                cnd_insn* storage, size_t capacity);
+
+/**
+ * Execute a prepared program. Behaves like cnd_execute(), but ctx->ip is an
+ * instruction index rather than a bytecode offset. A run starting at ip 0
+ * with at least fixed_size bytes left in the buffer checks the length once
+ * and runs the program's fixed prefix without per-field bounds checks.
+ */
+cnd_error_t cnd_execute_prepared(cnd_vm_ctx* ctx, const cnd_prepared* prepared);
+
+/**
+ * Generate machine code for a prepared program. Primitive fields, byte order
+ * changes and jumps become native code; all other instructions call into the
+ * prepared executor, so results are identical to cnd_execute_prepared().
+ * Under cnd_bind_io, primitive fields bound with their own type in the
+ * current struct are read from or written to host memory without a call.
+ * The prepared program must outlive the cnd_jit. Release with cnd_jit_free().
+ * Returns CND_ERR_INVALID_OP when the library was built without CND_JIT or
+ * for a target other than x86-64 Linux.
+ */
+cnd_error_t cnd_program_jit(cnd_jit* jit, const cnd_prepared* prepared);
+
+/**
+ * Execute generated code. Behaves like cnd_execute_prepared() with the
+ * program the code was generated for.
+ */
+cnd_error_t cnd_execute_jit(cnd_vm_ctx* ctx, const cnd_jit* jit);
+
+/** Unmap the code of a cnd_jit. Safe on a zeroed or already freed cnd_jit. */
+void cnd_jit_free(cnd_jit* jit);
+
+/**
+ * Read one scalar field from an encoded buffer without running the program.
+ * Fields at a fixed position are read straight from the layout table; others
+ * are located by a decode scan that stops at the field. For repeated keys
+ * (array elements) the first occurrence is used.
+ * Integers are sign- or zero-extended, floats are returned as IEEE-754 double
+ * bits and transforms are not applied (the raw wire value is returned).
+ * Returns CND_ERR_VALIDATION if the key is not a scalar field in this buffer.
+ */
+cnd_error_t cnd_field_read(const cnd_program* program, const uint8_t* data, size_t len,
+                           uint16_t key_id, uint64_t* value);
+
+/**
+ * Overwrite one scalar field in an encoded buffer in place, using the same
+ * lookup and value representation as cnd_field_read(). Values that do not
+ * fit the field fail with CND_ERR_VALIDATION. CRCs are not updated.
+ */
+cnd_error_t cnd_field_write(const cnd_program* program, uint8_t* data, size_t len,
+                            uint16_t key_id, uint64_t value);
+
+/**
+ * Reset a binder to the start of a run against `host` (the root struct).
+ * Call before every execution; the table must outlive the binder.
+ */
+void cnd_binder_init(cnd_binder* binder, const cnd_binding* table, uint16_t count, void* host);
+
+/**
+ * Set the table entry for a field by name (nested fields use dotted names,
+ * e.g. "pos.x"). Returns CND_ERR_VALIDATION if the name is unknown or its
+ * Key ID does not fit in the table.
+ */
+cnd_error_t cnd_binding_set(cnd_binding* table, uint16_t count, const cnd_program* program,
+                            const char* name, const cnd_binding* entry);
+
+/**
+ * IO callback that serves fields from a binding table instead of host code.
+ * Pass it to cnd_init() with a cnd_binder as user pointer. cnd_execute()
+ * recognises it and reads and writes primitive fields in host memory
+ * directly; this function serves the remaining events (structs, arrays,
+ * strings, bitfields, transformed values and expression context).
+ */
+cnd_error_t cnd_bind_io(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr);
+
 /**
  * Get a human-readable error message for a given error code.
  */
@@ -0,0 +1,1355 @@
+#ifndef CONCORDIA_HPP
+#define CONCORDIA_HPP
+
+// Header-only C++ front end for Concordia programs.
+//
+// cnd::execute<Mode>(program, buf, len, visitor) runs a program with the
+// interpreter loop instantiated for the visitor type: every field calls an
+// overload of visitor.on(key, value) directly, chosen by the field's C++ type,
+// instead of going through a cnd_io_cb and a switch on the type opcode. The
+// compiler can inline those calls into the loop.
+//
+// The loop implements the common layout instructions itself (primitive
+// fields, fused runs, constants, bitfields, fixed and length-prefixed arrays,
+// structs and byte order). At the first instruction it does not implement
+// (strings, checks, transforms, switches, expressions, CRCs, struct
+// subroutines...) it hands its state to cnd_execute(), which finishes the
+// packet through the same visitor via cnd::visitor_callback. Results, errors
+// and the order of visitor calls are those of cnd_execute().
+//
+// Programs embedded at compile time (cnd::embedded) additionally get their
+// fixed-layout prefix unrolled at compile time: every field up to the first
+// variable-length or conditional element is read or written at a constant
+// offset after one bounds check, with the byte order resolved statically.
+//
+// Visitor interface. Field overloads receive the value by reference: fill it
+// when encoding, read it when decoding. Hooks may return void, bool (false
+// fails the run) or cnd_error_t. Missing field overloads fail the run with
+// CND_ERR_CALLBACK; missing optional hooks succeed, except on_bytes and
+// on_query which decline.
+//
+//   on(key, uint8_t&) ... on(key, int64_t&), on(key, float&), on(key, double&)
+//                                     Primitive fields (also @const values on
+//                                     decode, bitfields as uint64_t/int64_t)
+//   on(key, bool&)                    bool fields and 1-bit bool bitfields
+//   on(key, const char*&)             Strings (encode: set a NUL-terminated
+//                                     string; decode: points into the buffer)
+//   on_enter(key), on_exit()          Struct boundaries
+//   on_array(key, uint32_t& count)    Array start (encode: set the count of
+//                                     prefixed arrays)
+//   on_array_end()                    Array end
+//   on_bytes(key, uint8_t* data, uint32_t count)
+//                                     Byte arrays in place; declining falls
+//                                     back to one on() per element
+//   on_query(key, uint64_t& value)    Value of a field read by a switch,
+//                                     @count or expression (not served by the
+//                                     scoreboard), as in OP_LOAD_CTX
+//   on_store(key, uint64_t value)     Value computed for an @expr field
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "concordia.h"
+
+namespace cnd {
+
+// Copies between the wire value and the host value in the direction of Mode
+template <cnd_mode_t Mode, class Wire, class Host>
+inline void transfer(Wire& wire, Host& host) {
+    if (Mode == CND_MODE_ENCODE) wire = static_cast<Wire>(host);
+    else host = static_cast<Host>(wire);
+}
+
+namespace detail {
+
+// --- Visitor dispatch ---
+
+inline bool status_ok(bool ok) { return ok; }
+inline bool status_ok(cnd_error_t err) { return err == CND_ERR_OK; }
+
+template <class F>
+inline bool call_hook(F&& f, std::true_type /* returns void */) { f(); return true; }
+template <class F>
+inline bool call_hook(F&& f, std::false_type) { return status_ok(f()); }
+
+template <class V, class T>
+inline auto field(V& v, uint16_t key, T& val, int) -> decltype(v.on(key, val), bool()) {
+    return call_hook([&] { return v.on(key, val); }, std::is_void<decltype(v.on(key, val))>());
+}
+template <class V, class T>
+inline bool field(V&, uint16_t, T&, long) { return false; }
+
+template <class V>
+inline auto enter(V& v, uint16_t key, int) -> decltype(v.on_enter(key), bool()) {
+    return call_hook([&] { return v.on_enter(key); }, std::is_void<decltype(v.on_enter(key))>());
+}
+template <class V>
+inline bool enter(V&, uint16_t, long) { return true; }
+
+template <class V>
+inline auto leave(V& v, int) -> decltype(v.on_exit(), bool()) {
+    return call_hook([&] { return v.on_exit(); }, std::is_void<decltype(v.on_exit())>());
+}
+template <class V>
+inline bool leave(V&, long) { return true; }
+
+template <class V>
+inline auto array(V& v, uint16_t key, uint32_t& count, int) -> decltype(v.on_array(key, count), bool()) {
+    return call_hook([&] { return v.on_array(key, count); }, std::is_void<decltype(v.on_array(key, count))>());
+}
+template <class V>
+inline bool array(V&, uint16_t, uint32_t&, long) { return true; }
+
+template <class V>
+inline auto array_end(V& v, int) -> decltype(v.on_array_end(), bool()) {
+    return call_hook([&] { return v.on_array_end(); }, std::is_void<decltype(v.on_array_end())>());
+}
+template <class V>
+inline bool array_end(V&, long) { return true; }
+
+template <class V>
+inline auto bytes(V& v, uint16_t key, uint8_t* data, uint32_t count, int) -> decltype(v.on_bytes(key, data, count), bool()) {
+    return call_hook([&] { return v.on_bytes(key, data, count); }, std::is_void<decltype(v.on_bytes(key, data, count))>());
+}
+template <class V>
+inline bool bytes(V&, uint16_t, uint8_t*, uint32_t, long) { return false; }
+
+template <class V, class = void>
+struct has_bytes : std::false_type {};
+template <class V>
+struct has_bytes<V, decltype((void)std::declval<V&>().on_bytes(uint16_t(), (uint8_t*)nullptr, uint32_t()))> : std::true_type {};
+
+template <class V>
+inline auto query(V& v, uint16_t key, uint64_t& val, int) -> decltype(v.on_query(key, val), bool()) {
+    return call_hook([&] { return v.on_query(key, val); }, std::is_void<decltype(v.on_query(key, val))>());
+}
+template <class V>
+inline bool query(V&, uint16_t, uint64_t&, long) { return false; }
+
+template <class V>
+inline auto store(V& v, uint16_t key, uint64_t val, int) -> decltype(v.on_store(key, val), bool()) {
+    return call_hook([&] { return v.on_store(key, val); }, std::is_void<decltype(v.on_store(key, val))>());
+}
+template <class V>
+inline bool store(V&, uint16_t, uint64_t, long) { return true; }
+
+// --- Bytecode and wire access ---
+
+constexpr uint16_t il_u16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+constexpr uint32_t il_u32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+constexpr uint64_t il_u64(const uint8_t* p) {
+    return static_cast<uint64_t>(il_u32(p)) | (static_cast<uint64_t>(il_u32(p + 4)) << 32);
+}
+
+constexpr uint32_t type_size(uint8_t type) {
+    return (type == OP_IO_U8 || type == OP_IO_I8 || type == OP_IO_BOOL) ? 1 :
+           (type == OP_IO_U16 || type == OP_IO_I16) ? 2 :
+           (type == OP_IO_U32 || type == OP_IO_I32 || type == OP_IO_F32) ? 4 :
+           (type == OP_IO_U64 || type == OP_IO_I64 || type == OP_IO_F64) ? 8 : 0;
+}
+
+// Loads and stores of unsigned integers; compilers turn these into single
+// (byte-swapped) moves
+template <class U>
+inline U load(const uint8_t* p, bool be) {
+    U v = 0;
+    for (size_t i = 0; i < sizeof(U); i++) {
+        v = static_cast<U>(v | static_cast<U>(static_cast<U>(p[i]) << (8 * (be ? sizeof(U) - 1 - i : i))));
+    }
+    return v;
+}
+
+template <class U>
+inline void store(uint8_t* p, U v, bool be) {
+    for (size_t i = 0; i < sizeof(U); i++) {
+        p[i] = static_cast<uint8_t>(v >> (8 * (be ? sizeof(U) - 1 - i : i)));
+    }
+}
+
+template <size_t N> struct uint_of;
+template <> struct uint_of<1> { typedef uint8_t type; };
+template <> struct uint_of<2> { typedef uint16_t type; };
+template <> struct uint_of<4> { typedef uint32_t type; };
+template <> struct uint_of<8> { typedef uint64_t type; };
+
+// Host type <-> wire bits
+template <class T>
+struct wire {
+    typedef typename uint_of<sizeof(T)>::type bits;
+    static T from(bits b) { return static_cast<T>(b); }
+    static bits to(T v) { return static_cast<bits>(v); }
+};
+template <>
+struct wire<float> {
+    typedef uint32_t bits;
+    static float from(bits b) { float v; std::memcpy(&v, &b, 4); return v; }
+    static bits to(float v) { bits b; std::memcpy(&b, &v, 4); return b; }
+};
+template <>
+struct wire<double> {
+    typedef uint64_t bits;
+    static double from(bits b) { double v; std::memcpy(&v, &b, 8); return v; }
+    static bits to(double v) { bits b; std::memcpy(&b, &v, 8); return b; }
+};
+
+template <uint8_t Op> struct io_type;
+template <> struct io_type<OP_IO_U8> { typedef uint8_t type; };
+template <> struct io_type<OP_IO_U16> { typedef uint16_t type; };
+template <> struct io_type<OP_IO_U32> { typedef uint32_t type; };
+template <> struct io_type<OP_IO_U64> { typedef uint64_t type; };
+template <> struct io_type<OP_IO_I8> { typedef int8_t type; };
+template <> struct io_type<OP_IO_I16> { typedef int16_t type; };
+template <> struct io_type<OP_IO_I32> { typedef int32_t type; };
+template <> struct io_type<OP_IO_I64> { typedef int64_t type; };
+template <> struct io_type<OP_IO_F32> { typedef float type; };
+template <> struct io_type<OP_IO_F64> { typedef double type; };
+
+// --- Run state ---
+
+// Mirrors the cnd_vm_ctx fields the native loop uses, so a run can be handed
+// to cnd_execute() at any instruction boundary
+struct run_state {
+    uint8_t* buf;
+    size_t len;
+    size_t ip;
+    size_t cursor;
+    uint8_t bit;
+    cnd_endian_t endian;
+    bool optional;
+    uint8_t loop_depth;
+    cnd_loop_frame loops[CND_MAX_LOOP_DEPTH];
+    uint16_t slot_valid;
+    uint16_t slot_keys[CND_SCOREBOARD_SLOTS];
+    uint64_t slot_values[CND_SCOREBOARD_SLOTS];
+
+    run_state(uint8_t* b, size_t n)
+        : buf(b), len(n), ip(0), cursor(0), bit(0), endian(CND_LE), optional(false),
+          loop_depth(0), slot_valid(0) {}
+};
+
+inline void align(run_state& s) {
+    if (s.bit != 0) {
+        s.cursor++;
+        s.bit = 0;
+    }
+}
+
+// Scoreboard entry for an integer or bool field that ends at the cursor
+inline void slot_set(run_state& s, uint16_t key, uint8_t type) {
+    uint32_t size = type_size(type);
+    const uint8_t* p = s.buf + s.cursor - size;
+    bool be = (s.endian == CND_BE);
+    uint64_t v;
+    switch (type) {
+        case OP_IO_I8:   v = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int8_t>(p[0]))); break;
+        case OP_IO_I16:  v = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int16_t>(load<uint16_t>(p, be)))); break;
+        case OP_IO_I32:  v = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(load<uint32_t>(p, be)))); break;
+        case OP_IO_BOOL: v = p[0] != 0; break;
+        default:
+            v = size == 1 ? p[0] : size == 2 ? load<uint16_t>(p, be) : size == 4 ? load<uint32_t>(p, be) : load<uint64_t>(p, be);
+            break;
+    }
+    uint32_t i = key & (CND_SCOREBOARD_SLOTS - 1);
+    s.slot_keys[i] = key;
+    s.slot_values[i] = v;
+    s.slot_valid = static_cast<uint16_t>(s.slot_valid | (1u << i));
+}
+
+// Bit stream access through a 64-bit window at the cursor byte, as in the C
+// interpreter (src/vm/vm_internal.h): LE streams fill each byte from bit 0 and
+// load the window little-endian, BE streams fill from bit 7 and load it
+// big-endian, so a field is one shift and mask. Those helpers work on a
+// cnd_vm_ctx and are private to the library, so this header keeps its own
+// copy over run_state; cpp_api_tests.cpp holds both to the same bytes and
+// cursors. Fields past the end of the buffer go bit by bit and stop there.
+inline uint64_t bit_mask(uint32_t count) {
+    return count >= 64 ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << count) - 1;
+}
+
+// True when `count` bits from the cursor lie inside the buffer
+inline bool bits_in_bounds(const run_state& s, uint32_t count) {
+    size_t nbytes = (static_cast<size_t>(s.bit) + count + 7) >> 3;
+    return s.cursor <= s.len && nbytes <= s.len - s.cursor;
+}
+
+// Loads `nbytes` (1-8) bytes at the cursor as a window; missing bytes are 0
+inline uint64_t bit_window_load(const run_state& s, size_t nbytes) {
+    const uint8_t* p = s.buf + s.cursor;
+    bool be = (s.endian == CND_BE);
+    if (s.len - s.cursor >= 8) {
+        uint8_t b[8];
+        std::memcpy(b, p, 8);
+        return load<uint64_t>(b, be);
+    }
+    uint64_t w = 0;
+    for (size_t i = 0; i < nbytes; i++) w |= static_cast<uint64_t>(p[i]) << (be ? 56 - 8 * i : 8 * i);
+    return w;
+}
+
+inline void bit_advance(run_state& s, uint32_t bits) {
+    s.cursor += bits >> 3;
+    s.bit = static_cast<uint8_t>(bits & 7);
+}
+
+// One field of at most 64 - s.bit bits
+inline uint64_t read_bits_window(run_state& s, uint8_t count) {
+    uint32_t span = s.bit + count;
+    uint64_t w = bit_window_load(s, (span + 7) >> 3);
+    uint64_t v = (s.endian == CND_BE) ? (w << s.bit) >> (64 - count) : (w >> s.bit) & bit_mask(count);
+    bit_advance(s, span);
+    return v;
+}
+
+inline uint64_t read_bits_tail(run_state& s, uint8_t count) {
+    uint64_t val = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (s.cursor >= s.len) break;
+        uint8_t byte = s.buf[s.cursor];
+        if (s.endian == CND_BE) val = (val << 1) | ((byte >> (7 - s.bit)) & 1u);
+        else if (((byte >> s.bit) & 1u) && i < 64) val |= static_cast<uint64_t>(1) << i;
+        if (++s.bit == 8) {
+            s.bit = 0;
+            s.cursor++;
+        }
+    }
+    return val;
+}
+
+inline uint64_t read_bits(run_state& s, uint8_t count) {
+    if (count == 0) return 0;
+    if (count > 64 || !bits_in_bounds(s, count)) return read_bits_tail(s, count);
+    if (s.bit + count <= 64) return read_bits_window(s, count);
+
+    uint64_t first = read_bits_window(s, 32);
+    uint64_t rest = read_bits_window(s, static_cast<uint8_t>(count - 32));
+    return (s.endian == CND_BE) ? (first << (count - 32)) | rest : first | (rest << 32);
+}
+
+inline void write_bits_window(run_state& s, uint64_t val, uint8_t count) {
+    bool be = (s.endian == CND_BE);
+    uint32_t span = s.bit + count;
+    size_t nbytes = (span + 7) >> 3;
+    uint64_t w = bit_window_load(s, nbytes);
+    uint64_t m = bit_mask(count);
+    uint32_t shift = be ? 64 - span : s.bit;
+    w = (w & ~(m << shift)) | ((val & m) << shift);
+
+    uint8_t* p = s.buf + s.cursor;
+    if (s.len - s.cursor >= 8) {
+        uint8_t b[8];
+        store<uint64_t>(b, w, be);
+        std::memcpy(p, b, 8);
+    } else {
+        for (size_t i = 0; i < nbytes; i++) p[i] = static_cast<uint8_t>(w >> (be ? 56 - 8 * i : 8 * i));
+    }
+    bit_advance(s, span);
+}
+
+inline void write_bits_tail(run_state& s, uint64_t val, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (s.cursor >= s.len) return;
+        unsigned shift = (s.endian == CND_BE) ? static_cast<unsigned>(count - 1 - i) : i;
+        uint8_t bit = shift < 64 ? static_cast<uint8_t>((val >> shift) & 1u) : 0;
+        uint8_t mask = static_cast<uint8_t>((s.endian == CND_BE) ? 1u << (7 - s.bit) : 1u << s.bit);
+        if (bit) s.buf[s.cursor] = static_cast<uint8_t>(s.buf[s.cursor] | mask);
+        else s.buf[s.cursor] = static_cast<uint8_t>(s.buf[s.cursor] & ~mask);
+        if (++s.bit == 8) {
+            s.bit = 0;
+            s.cursor++;
+        }
+    }
+}
+
+inline void write_bits(run_state& s, uint64_t val, uint8_t count) {
+    if (count == 0) return;
+    if (count > 64 || !bits_in_bounds(s, count)) { write_bits_tail(s, val, count); return; }
+    if (s.bit + count <= 64) { write_bits_window(s, val, count); return; }
+
+    if (s.endian == CND_BE) {
+        write_bits_window(s, val >> (count - 32), 32);
+        write_bits_window(s, val, static_cast<uint8_t>(count - 32));
+    } else {
+        write_bits_window(s, val, 32);
+        write_bits_window(s, val >> 32, static_cast<uint8_t>(count - 32));
+    }
+}
+
+inline int64_t sign_extend(uint64_t val, uint8_t bits) {
+    if (bits == 0 || bits >= 64) return static_cast<int64_t>(val);
+    uint64_t m = static_cast<uint64_t>(1) << (bits - 1);
+    return static_cast<int64_t>((val ^ m) - m);
+}
+
+} // namespace detail
+
+// --- Visitors as C callbacks ---
+
+// Adapts a visitor to cnd_io_cb, for cnd_execute() and friends:
+//
+//   cnd::visitor_callback<MyVisitor> adapter(visitor);
+//   cnd_init(&ctx, mode, &program, buf, len, adapter.callback, &adapter);
+template <class Visitor>
+class visitor_callback {
+public:
+    explicit visitor_callback(Visitor& visitor) : visitor_(visitor), count_(0), array_pending_(false) {}
+
+    static cnd_error_t callback(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, void* ptr) {
+        visitor_callback& self = *static_cast<visitor_callback*>(ctx->user_ptr);
+        bool was_array = self.array_pending_;
+        self.array_pending_ = false;
+        return self.dispatch(ctx, key, type, ptr, was_array) ? CND_ERR_OK : CND_ERR_CALLBACK;
+    }
+
+private:
+    template <class Count>
+    bool array(uint16_t key, void* ptr) {
+        Count* p = static_cast<Count*>(ptr);
+        uint32_t count = static_cast<uint32_t>(*p);
+        if (!detail::array(visitor_, key, count, 0)) return false;
+        *p = static_cast<Count>(count);
+        count_ = static_cast<uint32_t>(*p);
+        array_pending_ = true;
+        return true;
+    }
+
+    bool flag(uint16_t key, void* ptr) {
+        uint8_t* p = static_cast<uint8_t*>(ptr);
+        bool b = *p != 0;
+        if (!detail::field(visitor_, key, b, 0)) return false;
+        *p = b ? 1 : 0;
+        return true;
+    }
+
+    // OP_RAW_BYTES comes from a byte[] instruction (count in the instruction,
+    // which ends at ctx->ip in cnd_execute) or from a byte array right after
+    // its array event (count from that event; prepared runs too)
+    bool raw(const cnd_vm_ctx* ctx, uint16_t key, void* ptr, bool was_array) {
+        const uint8_t* code = ctx->program->bytecode;
+        size_t ip = ctx->ip;
+        uint32_t count;
+        if (ip >= 7 && ip <= ctx->program->bytecode_len && code[ip - 7] == OP_RAW_BYTES &&
+            static_cast<uint16_t>(detail::il_u16(code + ip - 6) + ctx->key_base) == key) {
+            count = detail::il_u32(code + ip - 4);
+        } else if (was_array) {
+            count = count_;
+        } else {
+            return false;
+        }
+        // Never past the buffer, whatever the count
+        size_t room = ctx->cursor <= ctx->data_len ? ctx->data_len - ctx->cursor : 0;
+        if (count > room) return false;
+        return detail::bytes(visitor_, key, static_cast<uint8_t*>(ptr), count, 0);
+    }
+
+    bool dispatch(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, void* ptr, bool was_array) {
+        Visitor& v = visitor_;
+        switch (type) {
+            case OP_IO_U8:  return detail::field(v, key, *static_cast<uint8_t*>(ptr), 0);
+            case OP_IO_U16: return detail::field(v, key, *static_cast<uint16_t*>(ptr), 0);
+            case OP_IO_U32: return detail::field(v, key, *static_cast<uint32_t*>(ptr), 0);
+            case OP_IO_U64: return detail::field(v, key, *static_cast<uint64_t*>(ptr), 0);
+            case OP_IO_I8:  return detail::field(v, key, *static_cast<int8_t*>(ptr), 0);
+            case OP_IO_I16: return detail::field(v, key, *static_cast<int16_t*>(ptr), 0);
+            case OP_IO_I32: return detail::field(v, key, *static_cast<int32_t*>(ptr), 0);
+            case OP_IO_I64: return detail::field(v, key, *static_cast<int64_t*>(ptr), 0);
+            case OP_IO_F32: return detail::field(v, key, *static_cast<float*>(ptr), 0);
+            case OP_IO_F64: return detail::field(v, key, *static_cast<double*>(ptr), 0);
+            case OP_IO_BIT_U: return detail::field(v, key, *static_cast<uint64_t*>(ptr), 0);
+            case OP_IO_BIT_I: return detail::field(v, key, *static_cast<int64_t*>(ptr), 0);
+            case OP_IO_BOOL:
+            case OP_IO_BIT_BOOL:
+                return flag(key, ptr);
+            case OP_STR_NULL:
+            case OP_STR_PRE_U8:
+            case OP_STR_PRE_U16:
+            case OP_STR_PRE_U32:
+                if (ctx->mode == CND_MODE_ENCODE) return detail::field(v, key, *static_cast<const char**>(ptr), 0);
+                else {
+                    const char* str = static_cast<const char*>(ptr);
+                    return detail::field(v, key, str, 0);
+                }
+            case OP_ENTER_STRUCT: return detail::enter(v, key, 0);
+            case OP_EXIT_STRUCT: return detail::leave(v, 0);
+            case OP_ARR_FIXED:
+            case OP_ARR_DYNAMIC:
+                return array<uint32_t>(key, ptr);
+            case OP_ARR_PRE_U8: return array<uint8_t>(key, ptr);
+            case OP_ARR_PRE_U16: return array<uint16_t>(key, ptr);
+            case OP_ARR_PRE_U32: return array<uint32_t>(key, ptr);
+            case OP_ARR_END: return detail::array_end(v, 0);
+            case OP_RAW_BYTES: return raw(ctx, key, ptr, was_array);
+            case OP_LOAD_CTX:
+            case OP_CTX_QUERY:
+                return detail::query(v, key, *static_cast<uint64_t*>(ptr), 0);
+            case OP_STORE_CTX: return detail::store(v, key, *static_cast<uint64_t*>(ptr), 0);
+            default: return false;
+        }
+    }
+
+    Visitor& visitor_;
+    uint32_t count_;       // Count of the last array event
+    bool array_pending_;   // The previous event was an array start
+};
+
+namespace detail {
+
+// Finishes the run in the C interpreter from the current instruction
+template <cnd_mode_t Mode, class V>
+cnd_error_t handoff(const cnd_program& program, run_state& s, V& v) {
+    visitor_callback<V> adapter(v);
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, Mode, &program, s.buf, s.len, &visitor_callback<V>::callback, &adapter);
+    ctx.ip = s.ip;
+    ctx.cursor = s.cursor;
+    ctx.bit_offset = s.bit;
+    ctx.endianness = s.endian;
+    ctx.is_next_optional = s.optional;
+    ctx.loop_depth = s.loop_depth;
+    std::memcpy(ctx.loop_stack, s.loops, sizeof(s.loops[0]) * s.loop_depth);
+    ctx.slot_valid = s.slot_valid;
+    std::memcpy(ctx.slot_keys, s.slot_keys, sizeof(s.slot_keys));
+    std::memcpy(ctx.slot_values, s.slot_values, sizeof(s.slot_values));
+    cnd_error_t err = cnd_execute(&ctx);
+    s.cursor = ctx.cursor;
+    return err;
+}
+
+// One primitive field at the cursor (alignment done, no @optional pending)
+template <cnd_mode_t Mode, class T, class V>
+inline cnd_error_t io_value(run_state& s, V& v, uint16_t key) {
+    typedef typename wire<T>::bits bits;
+    T val = T();
+    uint8_t* p = s.buf + s.cursor;
+    bool be = (s.endian == CND_BE);
+    if (Mode == CND_MODE_ENCODE) {
+        if (!field(v, key, val, 0)) return CND_ERR_CALLBACK;
+        store<bits>(p, wire<T>::to(val), be);
+    } else {
+        val = wire<T>::from(load<bits>(p, be));
+        if (!field(v, key, val, 0)) return CND_ERR_CALLBACK;
+    }
+    s.cursor += sizeof(T);
+    return CND_ERR_OK;
+}
+
+template <cnd_mode_t Mode, class V>
+inline cnd_error_t io_bool(run_state& s, V& v, uint16_t key) {
+    bool val = false;
+    if (s.cursor + 1 > s.len) {
+        if (s.optional) {
+            s.optional = false;
+            return field(v, key, val, 0) ? CND_ERR_OK : CND_ERR_CALLBACK;
+        }
+        return CND_ERR_OOB;
+    }
+    if (Mode == CND_MODE_ENCODE) {
+        if (!field(v, key, val, 0)) return CND_ERR_CALLBACK;
+        s.buf[s.cursor] = val ? 1 : 0;
+    } else {
+        uint8_t raw = s.buf[s.cursor];
+        if (raw > 1) return CND_ERR_VALIDATION;
+        val = raw != 0;
+        if (!field(v, key, val, 0)) return CND_ERR_CALLBACK;
+    }
+    s.cursor += 1;
+    s.optional = false;
+    return CND_ERR_OK;
+}
+
+// A field instruction: bounds check and @optional, then the transfer
+template <cnd_mode_t Mode, class T, class V>
+inline cnd_error_t io_field(run_state& s, V& v, uint16_t key) {
+    align(s);
+    if (s.cursor + sizeof(T) > s.len) {
+        if (s.optional) {
+            s.optional = false;
+            T val = T();
+            return field(v, key, val, 0) ? CND_ERR_OK : CND_ERR_CALLBACK;
+        }
+        return CND_ERR_OOB;
+    }
+    cnd_error_t err = io_value<Mode, T>(s, v, key);
+    if (err == CND_ERR_OK) s.optional = false;
+    return err;
+}
+
+// A field of a fused run or slot: the buffer was checked up to `limit`
+template <cnd_mode_t Mode, class V>
+inline cnd_error_t io_fused(run_state& s, V& v, uint8_t type, uint16_t key, size_t limit) {
+    if (type == OP_IO_BOOL) return io_bool<Mode>(s, v, key);
+    uint32_t size = type_size(type);
+    if (size == 0 || s.cursor + size > limit) return CND_ERR_INVALID_OP;
+    switch (type) {
+        case OP_IO_U8:  return io_value<Mode, uint8_t>(s, v, key);
+        case OP_IO_U16: return io_value<Mode, uint16_t>(s, v, key);
+        case OP_IO_U32: return io_value<Mode, uint32_t>(s, v, key);
+        case OP_IO_U64: return io_value<Mode, uint64_t>(s, v, key);
+        case OP_IO_I8:  return io_value<Mode, int8_t>(s, v, key);
+        case OP_IO_I16: return io_value<Mode, int16_t>(s, v, key);
+        case OP_IO_I32: return io_value<Mode, int32_t>(s, v, key);
+        case OP_IO_I64: return io_value<Mode, int64_t>(s, v, key);
+        case OP_IO_F32: return io_value<Mode, float>(s, v, key);
+        default:        return io_value<Mode, double>(s, v, key);
+    }
+}
+
+template <cnd_mode_t Mode, class V>
+inline cnd_error_t const_check(run_state& s, V& v, uint16_t key, uint8_t type, uint64_t expected) {
+    uint32_t size = (type == OP_IO_F32 || type == OP_IO_F64 || type == OP_IO_BOOL) ? 0 : type_size(type);
+    if (size == 0) return CND_ERR_INVALID_OP;
+    if (s.cursor + size > s.len) return CND_ERR_OOB;
+    uint8_t* p = s.buf + s.cursor;
+    bool be = (s.endian == CND_BE);
+    if (Mode == CND_MODE_ENCODE) {
+        if (size == 1) p[0] = static_cast<uint8_t>(expected);
+        else if (size == 2) store<uint16_t>(p, static_cast<uint16_t>(expected), be);
+        else if (size == 4) store<uint32_t>(p, static_cast<uint32_t>(expected), be);
+        else store<uint64_t>(p, expected, be);
+    } else {
+        uint64_t actual = size == 1 ? p[0] : size == 2 ? load<uint16_t>(p, be) : size == 4 ? load<uint32_t>(p, be) : load<uint64_t>(p, be);
+        if (actual != expected) return CND_ERR_VALIDATION;
+        bool ok;
+        switch (type) {
+            case OP_IO_U8:  { uint8_t x = static_cast<uint8_t>(actual); ok = field(v, key, x, 0); break; }
+            case OP_IO_I8:  { int8_t x = static_cast<int8_t>(actual); ok = field(v, key, x, 0); break; }
+            case OP_IO_U16: { uint16_t x = static_cast<uint16_t>(actual); ok = field(v, key, x, 0); break; }
+            case OP_IO_I16: { int16_t x = static_cast<int16_t>(actual); ok = field(v, key, x, 0); break; }
+            case OP_IO_U32: { uint32_t x = static_cast<uint32_t>(actual); ok = field(v, key, x, 0); break; }
+            case OP_IO_I32: { int32_t x = static_cast<int32_t>(actual); ok = field(v, key, x, 0); break; }
+            case OP_IO_U64: { uint64_t x = actual; ok = field(v, key, x, 0); break; }
+            default:        { int64_t x = static_cast<int64_t>(actual); ok = field(v, key, x, 0); break; }
+        }
+        if (!ok) return CND_ERR_CALLBACK;
+    }
+    s.cursor += size;
+    return CND_ERR_OK;
+}
+
+template <cnd_mode_t Mode, class V>
+inline cnd_error_t bit_field(run_state& s, V& v, uint8_t type, uint16_t key, uint8_t width) {
+    if (type == OP_IO_BIT_BOOL) {
+        bool b = false;
+        if (Mode == CND_MODE_ENCODE) {
+            if (!field(v, key, b, 0)) return CND_ERR_CALLBACK;
+            write_bits(s, b ? 1 : 0, 1);
+        } else {
+            b = read_bits(s, 1) != 0;
+            if (!field(v, key, b, 0)) return CND_ERR_CALLBACK;
+        }
+    } else if (type == OP_IO_BIT_I) {
+        int64_t x = 0;
+        if (Mode == CND_MODE_ENCODE) {
+            if (!field(v, key, x, 0)) return CND_ERR_CALLBACK;
+            write_bits(s, static_cast<uint64_t>(x), width);
+        } else {
+            x = sign_extend(read_bits(s, width), width);
+            if (!field(v, key, x, 0)) return CND_ERR_CALLBACK;
+        }
+    } else {
+        uint64_t x = 0;
+        if (Mode == CND_MODE_ENCODE) {
+            if (!field(v, key, x, 0)) return CND_ERR_CALLBACK;
+            write_bits(s, x, width);
+        } else {
+            x = read_bits(s, width);
+            if (!field(v, key, x, 0)) return CND_ERR_CALLBACK;
+        }
+    }
+    return CND_ERR_OK;
+}
+
+// A bit group within the buffer collects all its values before writing any
+// (nothing is written if one fails), as in the C interpreter. Returns false
+// for groups to encode field by field.
+template <class V>
+inline bool bit_group_encode(run_state& s, V& v, const uint8_t* fields, uint8_t count, cnd_error_t* err) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < count; i++) total += fields[static_cast<size_t>(i) * 4 + 3];
+    if (total > 64 || s.cursor > s.len || (s.bit + total + 7) / 8 > s.len - s.cursor) return false;
+    bool be = (s.endian == CND_BE);
+    uint64_t word = 0;
+    uint32_t cum = 0;
+    for (const uint8_t* f = fields; f < fields + static_cast<size_t>(count) * 4; f += 4) {
+        uint8_t w = f[3];
+        uint16_t key = il_u16(f + 1);
+        uint64_t x = 0;
+        bool ok;
+        if (f[0] == OP_IO_BIT_BOOL) {
+            bool b = false;
+            ok = field(v, key, b, 0);
+            x = b ? 1 : 0;
+        } else if (f[0] == OP_IO_BIT_I) {
+            int64_t i = 0;
+            ok = field(v, key, i, 0);
+            x = static_cast<uint64_t>(i);
+        } else {
+            ok = field(v, key, x, 0);
+        }
+        if (!ok) {
+            *err = CND_ERR_CALLBACK;
+            return true;
+        }
+        if (w < 64) x &= (static_cast<uint64_t>(1) << w) - 1;
+        if (be) word = (w >= 64) ? x : (word << w) | x;
+        else word |= (cum >= 64) ? 0 : x << cum;
+        cum += w;
+    }
+    write_bits(s, word, static_cast<uint8_t>(total));
+    *err = CND_ERR_OK;
+    return true;
+}
+
+// Skips the body of an empty array, as the C interpreter does
+inline size_t skip_loop_body(const cnd_program& program, size_t ip) {
+    int depth = 1;
+    while (ip < program.bytecode_len && depth > 0) {
+        uint8_t op = program.bytecode[ip];
+        if (op == OP_ARR_FIXED || op == OP_ARR_PRE_U8 || op == OP_ARR_PRE_U16 ||
+            op == OP_ARR_PRE_U32 || op == OP_ARR_EOF || op == OP_ARR_DYNAMIC) depth++;
+        if (op == OP_ARR_END) depth--;
+        ip++;
+    }
+    return ip;
+}
+
+// Starts the body of an array of `count` elements; s.ip is at the body
+template <cnd_mode_t Mode, class V>
+inline cnd_error_t array_body(const cnd_program& program, run_state& s, V& v, uint32_t count) {
+    if (count == 0) {
+        s.ip = skip_loop_body(program, s.ip);
+        return CND_ERR_OK;
+    }
+    const uint8_t* code = program.bytecode;
+    size_t ip = s.ip;
+    if (has_bytes<V>::value && ip + 3 < program.bytecode_len && code[ip + 3] == OP_ARR_END &&
+        (code[ip] == OP_IO_U8 || code[ip] == OP_IO_I8) && s.cursor + count <= s.len &&
+        bytes(v, il_u16(code + ip + 1), s.buf + s.cursor, count, 0)) {
+        s.cursor += count;
+        s.ip = ip + 4;
+        return CND_ERR_OK;
+    }
+    if (s.loop_depth >= CND_MAX_LOOP_DEPTH) return CND_ERR_OOB;
+    s.loops[s.loop_depth].start_ip = ip;
+    s.loops[s.loop_depth].remaining = count;
+    s.loop_depth++;
+    return CND_ERR_OK;
+}
+
+template <cnd_mode_t Mode, class Count, class V>
+inline cnd_error_t array_prefixed(const cnd_program& program, run_state& s, V& v, uint16_t key) {
+    Count count = 0;
+    bool be = (s.endian == CND_BE);
+    uint32_t n = 0;
+    if (Mode == CND_MODE_ENCODE) {
+        if (!array(v, key, n, 0)) return CND_ERR_CALLBACK;
+        count = static_cast<Count>(n);
+        if (s.cursor + sizeof(Count) > s.len) return CND_ERR_OOB;
+        store<Count>(s.buf + s.cursor, count, be);
+        s.cursor += sizeof(Count);
+    } else {
+        if (s.cursor + sizeof(Count) > s.len) return CND_ERR_OOB;
+        count = load<Count>(s.buf + s.cursor, be);
+        s.cursor += sizeof(Count);
+        n = count;
+        if (!array(v, key, n, 0)) return CND_ERR_CALLBACK;
+        count = static_cast<Count>(n);
+    }
+    return array_body<Mode>(program, s, v, static_cast<uint32_t>(count));
+}
+
+// The instruction loop. Returns through handoff() at the first instruction
+// it does not implement, or whose operands run past the bytecode.
+template <cnd_mode_t Mode, class V>
+cnd_error_t interpret(const cnd_program& program, run_state& s, V& v) {
+    const uint8_t* code = program.bytecode;
+    const size_t end = program.bytecode_len;
+    cnd_error_t err = CND_ERR_OK;
+
+    while (s.ip < end) {
+        const size_t at = s.ip;
+        const uint8_t* pc = code + at;
+        const size_t avail = end - at;
+        switch (pc[0]) {
+            case OP_NOOP:
+            case OP_ENTER_BIT_MODE:
+                s.ip = at + 1;
+                break;
+            case OP_META_VERSION:
+                if (avail < 2) return handoff<Mode>(program, s, v);
+                s.ip = at + 2;
+                break;
+            case OP_META_NAME:
+                if (avail < 3) return handoff<Mode>(program, s, v);
+                s.ip = at + 3;
+                break;
+            case OP_SET_ENDIAN_LE:
+                s.endian = CND_LE;
+                s.ip = at + 1;
+                break;
+            case OP_SET_ENDIAN_BE:
+                s.endian = CND_BE;
+                s.ip = at + 1;
+                break;
+            case OP_MARK_OPTIONAL:
+                s.optional = true;
+                s.ip = at + 1;
+                break;
+            case OP_ENTER_STRUCT:
+                if (avail < 3) return handoff<Mode>(program, s, v);
+                s.ip = at + 3;
+                if (!enter(v, il_u16(pc + 1), 0)) return CND_ERR_CALLBACK;
+                break;
+            case OP_EXIT_STRUCT:
+                s.ip = at + 1;
+                if (!leave(v, 0)) return CND_ERR_CALLBACK;
+                break;
+
+            case OP_IO_U8:  case OP_IO_U16: case OP_IO_U32: case OP_IO_U64:
+            case OP_IO_I8:  case OP_IO_I16: case OP_IO_I32: case OP_IO_I64:
+            case OP_IO_F32: case OP_IO_F64: case OP_IO_BOOL: {
+                if (avail < 3) return handoff<Mode>(program, s, v);
+                uint16_t key = il_u16(pc + 1);
+                s.ip = at + 3;
+                switch (pc[0]) {
+                    case OP_IO_U8:  err = io_field<Mode, uint8_t>(s, v, key); break;
+                    case OP_IO_U16: err = io_field<Mode, uint16_t>(s, v, key); break;
+                    case OP_IO_U32: err = io_field<Mode, uint32_t>(s, v, key); break;
+                    case OP_IO_U64: err = io_field<Mode, uint64_t>(s, v, key); break;
+                    case OP_IO_I8:  err = io_field<Mode, int8_t>(s, v, key); break;
+                    case OP_IO_I16: err = io_field<Mode, int16_t>(s, v, key); break;
+                    case OP_IO_I32: err = io_field<Mode, int32_t>(s, v, key); break;
+                    case OP_IO_I64: err = io_field<Mode, int64_t>(s, v, key); break;
+                    case OP_IO_F32: err = io_field<Mode, float>(s, v, key); break;
+                    case OP_IO_F64: err = io_field<Mode, double>(s, v, key); break;
+                    default:
+                        align(s);
+                        err = io_bool<Mode>(s, v, key);
+                        break;
+                }
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_IO_RUN: {
+                if (avail < 4) return handoff<Mode>(program, s, v);
+                uint8_t n = pc[1];
+                uint16_t run_bytes = il_u16(pc + 2);
+                if (avail - 4 < static_cast<size_t>(n) * 3) return handoff<Mode>(program, s, v);
+                align(s);
+                s.ip = at + 4;
+                // Short buffers and @optional run the embedded fields one by one
+                if (n == 0 || s.cursor + run_bytes > s.len || s.optional) break;
+                size_t limit = s.cursor + run_bytes;
+                for (const uint8_t* f = pc + 4; f < pc + 4 + static_cast<size_t>(n) * 3; f += 3) {
+                    err = io_fused<Mode>(s, v, f[0], il_u16(f + 1), limit);
+                    if (err != CND_ERR_OK) return err;
+                }
+                s.ip = at + 4 + static_cast<size_t>(n) * 3;
+                break;
+            }
+
+            case OP_IO_SLOT: {
+                if (avail < 4) return handoff<Mode>(program, s, v);
+                uint8_t type = pc[1];
+                uint32_t size = type_size(type);
+                align(s);
+                s.ip = at + 1;
+                if (size == 0 || s.cursor + size > s.len || s.optional) break;
+                uint16_t key = il_u16(pc + 2);
+                s.ip = at + 4;
+                err = io_fused<Mode>(s, v, type, key, s.cursor + size);
+                if (err != CND_ERR_OK) return err;
+                slot_set(s, key, type);
+                break;
+            }
+
+            case OP_CONST_CHECK: {
+                if (avail < 4 || avail - 4 < type_size(pc[3])) return handoff<Mode>(program, s, v);
+                uint8_t type = pc[3];
+                uint32_t size = type_size(type);
+                uint64_t expected = size == 1 ? pc[4] : size == 2 ? il_u16(pc + 4) : size == 4 ? il_u32(pc + 4) : size == 8 ? il_u64(pc + 4) : 0;
+                align(s);
+                s.ip = at + 4 + size;
+                err = const_check<Mode>(s, v, il_u16(pc + 1), type, expected);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_CONST_WRITE: {
+                if (avail < 2 || avail - 2 < type_size(pc[1])) return handoff<Mode>(program, s, v);
+                uint8_t type = pc[1];
+                uint32_t size = type_size(type);
+                align(s);
+                if (type != OP_IO_U8 && type != OP_IO_U16 && type != OP_IO_U32 && type != OP_IO_U64) return CND_ERR_INVALID_OP;
+                if (s.cursor + size > s.len) return CND_ERR_OOB;
+                if (Mode == CND_MODE_ENCODE) {
+                    uint8_t* p = s.buf + s.cursor;
+                    bool be = (s.endian == CND_BE);
+                    if (size == 1) p[0] = pc[2];
+                    else if (size == 2) store<uint16_t>(p, il_u16(pc + 2), be);
+                    else if (size == 4) store<uint32_t>(p, il_u32(pc + 2), be);
+                    else store<uint64_t>(p, il_u64(pc + 2), be);
+                }
+                s.cursor += size;
+                s.ip = at + 2 + size;
+                break;
+            }
+
+            case OP_IO_BIT_U:
+            case OP_IO_BIT_I:
+            case OP_IO_BIT_BOOL:
+                if (avail < 4) return handoff<Mode>(program, s, v);
+                s.ip = at + 4;
+                err = bit_field<Mode>(s, v, pc[0], il_u16(pc + 1), pc[3]);
+                if (err != CND_ERR_OK) return err;
+                break;
+
+            case OP_IO_BIT_GROUP: {
+                if (avail < 2 || avail - 2 < static_cast<size_t>(pc[1]) * 4) return handoff<Mode>(program, s, v);
+                uint8_t n = pc[1];
+                // The same guard as the C interpreter, which runs unverified IL
+                if (n == 0 || n > CND_MAX_BIT_GROUP) return CND_ERR_INVALID_OP;
+                for (const uint8_t* f = pc + 2; f < pc + 2 + static_cast<size_t>(n) * 4; f += 4) {
+                    if (f[3] == 0) return CND_ERR_INVALID_OP;
+                }
+                s.ip = at + 2 + static_cast<size_t>(n) * 4;
+                if (Mode == CND_MODE_ENCODE && bit_group_encode(s, v, pc + 2, n, &err)) {
+                    if (err != CND_ERR_OK) return err;
+                    break;
+                }
+                for (const uint8_t* f = pc + 2; f < pc + 2 + static_cast<size_t>(n) * 4; f += 4) {
+                    err = bit_field<Mode>(s, v, f[0], il_u16(f + 1), f[3]);
+                    if (err != CND_ERR_OK) return err;
+                }
+                break;
+            }
+
+            case OP_ALIGN_PAD:
+                if (avail < 2) return handoff<Mode>(program, s, v);
+                s.ip = at + 2;
+                if (Mode == CND_MODE_ENCODE) {
+                    write_bits(s, 0, pc[1]);
+                } else {
+                    size_t bits = static_cast<size_t>(s.bit) + pc[1];
+                    s.cursor += bits / 8;
+                    s.bit = static_cast<uint8_t>(bits % 8);
+                }
+                break;
+
+            case OP_ALIGN_FILL:
+                if (avail < 2) return handoff<Mode>(program, s, v);
+                s.ip = at + 2;
+                if (s.bit > 0) {
+                    uint8_t needed = static_cast<uint8_t>(8 - s.bit);
+                    if (Mode == CND_MODE_ENCODE) write_bits(s, pc[1] ? ~static_cast<uint64_t>(0) : 0, needed);
+                    else read_bits(s, needed);
+                }
+                break;
+
+            case OP_EXIT_BIT_MODE:
+                if (s.bit > 0) return CND_ERR_VALIDATION;
+                s.ip = at + 1;
+                break;
+
+            case OP_ARR_FIXED: {
+                if (avail < 7) return handoff<Mode>(program, s, v);
+                align(s);
+                uint16_t key = il_u16(pc + 1);
+                uint32_t count = il_u32(pc + 3);
+                s.ip = at + 7;
+                if (!array(v, key, count, 0)) return CND_ERR_CALLBACK;
+                err = array_body<Mode>(program, s, v, count);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_ARR_PRE_U8:
+            case OP_ARR_PRE_U16:
+            case OP_ARR_PRE_U32: {
+                if (avail < 3) return handoff<Mode>(program, s, v);
+                align(s);
+                uint16_t key = il_u16(pc + 1);
+                s.ip = at + 3;
+                if (pc[0] == OP_ARR_PRE_U8) err = array_prefixed<Mode, uint8_t>(program, s, v, key);
+                else if (pc[0] == OP_ARR_PRE_U16) err = array_prefixed<Mode, uint16_t>(program, s, v, key);
+                else err = array_prefixed<Mode, uint32_t>(program, s, v, key);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_ARR_END: {
+                align(s);
+                if (s.loop_depth == 0) return CND_ERR_INVALID_OP;
+                cnd_loop_frame& frame = s.loops[s.loop_depth - 1];
+                // EOF loops (remaining 0xFFFFFFFF) are only opened by the C interpreter
+                bool again = (frame.remaining == 0xFFFFFFFF) ? s.cursor < s.len : (frame.remaining > 0 && --frame.remaining > 0);
+                if (again) {
+                    s.ip = frame.start_ip;
+                } else {
+                    s.ip = at + 1;
+                    if (!array_end(v, 0)) return CND_ERR_CALLBACK;
+                    s.loop_depth--;
+                }
+                break;
+            }
+
+            case OP_JUMP: {
+                if (avail < 5) return handoff<Mode>(program, s, v);
+                int32_t offset = static_cast<int32_t>(il_u32(pc + 1));
+                size_t next = at + 5;
+                if (offset < 0) {
+                    size_t back = static_cast<size_t>(-static_cast<int64_t>(offset));
+                    if (next < back) return CND_ERR_OOB;
+                    next -= back;
+                } else {
+                    next += static_cast<size_t>(offset);
+                }
+                if (next > end) return CND_ERR_OOB;
+                s.ip = next;
+                break;
+            }
+
+            default:
+                return handoff<Mode>(program, s, v);
+        }
+    }
+    return CND_ERR_OK;
+}
+
+// --- Compile-time prefix of embedded programs ---
+
+struct fixed_prefix {
+    size_t end;    // First instruction outside the prefix
+    size_t bytes;  // Bytes the prefix occupies
+};
+
+// The leading instructions whose fields are at a constant offset and need
+// nothing but the buffer check: metadata, byte order, struct events,
+// primitives, fused runs, slots and constants
+constexpr fixed_prefix scan_prefix(const uint8_t* code, size_t len) {
+    size_t ip = 0, bytes = 0;
+    while (ip < len) {
+        uint8_t op = code[ip];
+        size_t step = 0, size = 0;
+        if (op == OP_NOOP || op == OP_SET_ENDIAN_LE || op == OP_SET_ENDIAN_BE || op == OP_EXIT_STRUCT) {
+            step = 1;
+        } else if (op == OP_META_VERSION) {
+            step = 2;
+        } else if (op == OP_META_NAME || op == OP_ENTER_STRUCT) {
+            step = 3;
+        } else if (op >= OP_IO_U8 && op <= OP_IO_BOOL) {
+            step = 3;
+            size = type_size(op);
+        } else if (op == OP_IO_RUN && ip + 4 <= len) {
+            size_t n = code[ip + 1];
+            if (n == 0 || ip + 4 + n * 3 > len) break;
+            for (size_t i = 0; i < n; i++) {
+                uint8_t type = code[ip + 4 + i * 3];
+                if (type < OP_IO_U8 || type > OP_IO_BOOL) return fixed_prefix{ip, bytes};
+                size += type_size(type);
+            }
+            if (size != il_u16(code + ip + 2)) break;
+            step = 4 + n * 3;
+        } else if (op == OP_IO_SLOT && ip + 4 <= len && code[ip + 1] >= OP_IO_U8 && code[ip + 1] <= OP_IO_BOOL) {
+            step = 4;
+            size = type_size(code[ip + 1]);
+        } else if (op == OP_CONST_CHECK && ip + 4 <= len && code[ip + 3] >= OP_IO_U8 && code[ip + 3] <= OP_IO_I64) {
+            size = type_size(code[ip + 3]);
+            step = 4 + size;
+        } else if (op == OP_CONST_WRITE && ip + 2 <= len && code[ip + 1] >= OP_IO_U8 && code[ip + 1] <= OP_IO_U64) {
+            size = type_size(code[ip + 1]);
+            step = 2 + size;
+        } else {
+            break;
+        }
+        if (ip + step > len) break;
+        ip += step;
+        bytes += size;
+    }
+    return fixed_prefix{ip, bytes};
+}
+
+enum fixed_kind_t { FIXED_SKIP, FIXED_ENDIAN, FIXED_ENTER, FIXED_EXIT, FIXED_FIELD, FIXED_BOOL, FIXED_RUN, FIXED_SLOT, FIXED_CONST_CHECK, FIXED_CONST_WRITE };
+
+constexpr int fixed_kind(uint8_t op) {
+    return (op == OP_SET_ENDIAN_LE || op == OP_SET_ENDIAN_BE) ? FIXED_ENDIAN :
+           op == OP_ENTER_STRUCT ? FIXED_ENTER :
+           op == OP_EXIT_STRUCT ? FIXED_EXIT :
+           op == OP_IO_BOOL ? FIXED_BOOL :
+           (op >= OP_IO_U8 && op <= OP_IO_F64) ? FIXED_FIELD :
+           op == OP_IO_RUN ? FIXED_RUN :
+           op == OP_IO_SLOT ? FIXED_SLOT :
+           op == OP_CONST_CHECK ? FIXED_CONST_CHECK :
+           op == OP_CONST_WRITE ? FIXED_CONST_WRITE : FIXED_SKIP;
+}
+
+constexpr size_t fixed_skip_len(uint8_t op) {
+    return op == OP_META_VERSION ? 2 : op == OP_META_NAME ? 3 : 1;
+}
+
+// A primitive or bool field at constant offset Cur in byte order BE
+template <cnd_mode_t Mode, uint8_t Type, bool BE, size_t Cur>
+struct fixed_io {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v, uint16_t key) {
+        typedef typename io_type<Type>::type T;
+        typedef typename wire<T>::bits bits;
+        T val = T();
+        if (Mode == CND_MODE_ENCODE) {
+            if (!field(v, key, val, 0)) { s.cursor = Cur; return CND_ERR_CALLBACK; }
+            store<bits>(s.buf + Cur, wire<T>::to(val), BE);
+        } else {
+            val = wire<T>::from(load<bits>(s.buf + Cur, BE));
+            if (!field(v, key, val, 0)) { s.cursor = Cur; return CND_ERR_CALLBACK; }
+        }
+        return CND_ERR_OK;
+    }
+};
+
+template <cnd_mode_t Mode, bool BE, size_t Cur>
+struct fixed_io<Mode, OP_IO_BOOL, BE, Cur> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v, uint16_t key) {
+        bool val = false;
+        if (Mode == CND_MODE_ENCODE) {
+            if (!field(v, key, val, 0)) { s.cursor = Cur; return CND_ERR_CALLBACK; }
+            s.buf[Cur] = val ? 1 : 0;
+        } else {
+            uint8_t raw = s.buf[Cur];
+            s.cursor = Cur;
+            if (raw > 1) return CND_ERR_VALIDATION;
+            val = raw != 0;
+            if (!field(v, key, val, 0)) return CND_ERR_CALLBACK;
+        }
+        return CND_ERR_OK;
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, bool Done = (IP >= P::prefix_end)>
+struct fixed_step;
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op = P::at(IP), int Kind = fixed_kind(Op)>
+struct fixed_op;
+
+// End of the prefix: hand the position to the instruction loop
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur>
+struct fixed_step<P, Mode, IP, BE, Cur, true> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V&) {
+        s.ip = IP;
+        s.cursor = Cur;
+        s.endian = BE ? CND_BE : CND_LE;
+        return CND_ERR_OK;
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur>
+struct fixed_step<P, Mode, IP, BE, Cur, false> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        return fixed_op<P, Mode, IP, BE, Cur>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op>
+struct fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_SKIP> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        return fixed_step<P, Mode, IP + fixed_skip_len(Op), BE, Cur>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op>
+struct fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_ENDIAN> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        return fixed_step<P, Mode, IP + 1, Op == OP_SET_ENDIAN_BE, Cur>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op>
+struct fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_ENTER> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        if (!enter(v, P::key(IP + 1), 0)) { s.cursor = Cur; return CND_ERR_CALLBACK; }
+        return fixed_step<P, Mode, IP + 3, BE, Cur>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op>
+struct fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_EXIT> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        if (!leave(v, 0)) { s.cursor = Cur; return CND_ERR_CALLBACK; }
+        return fixed_step<P, Mode, IP + 1, BE, Cur>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op>
+struct fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_FIELD> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        cnd_error_t err = fixed_io<Mode, Op, BE, Cur>::run(s, v, P::key(IP + 1));
+        if (err != CND_ERR_OK) return err;
+        return fixed_step<P, Mode, IP + 3, BE, Cur + type_size(Op)>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op>
+struct fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_BOOL> : fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_FIELD> {};
+
+// Fields of a fused run, entry by entry
+template <class P, cnd_mode_t Mode, size_t E, size_t Last, bool BE, size_t Cur, bool Done = (E >= Last)>
+struct fixed_entries {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        cnd_error_t err = fixed_io<Mode, P::at(E), BE, Cur>::run(s, v, P::key(E + 1));
+        if (err != CND_ERR_OK) return err;
+        return fixed_entries<P, Mode, E + 3, Last, BE, Cur + type_size(P::at(E))>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t E, size_t Last, bool BE, size_t Cur>
+struct fixed_entries<P, Mode, E, Last, BE, Cur, true> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        return fixed_step<P, Mode, Last, BE, Cur>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op>
+struct fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_RUN> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        return fixed_entries<P, Mode, IP + 4, IP + 4 + static_cast<size_t>(P::at(IP + 1)) * 3, BE, Cur>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op>
+struct fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_SLOT> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        const uint16_t key = P::key(IP + 2);
+        cnd_error_t err = fixed_io<Mode, P::at(IP + 1), BE, Cur>::run(s, v, key);
+        if (err != CND_ERR_OK) return err;
+        s.cursor = Cur + type_size(P::at(IP + 1));
+        s.endian = BE ? CND_BE : CND_LE;
+        slot_set(s, key, P::at(IP + 1));
+        return fixed_step<P, Mode, IP + 4, BE, Cur + type_size(P::at(IP + 1))>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op>
+struct fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_CONST_CHECK> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        s.cursor = Cur;
+        s.endian = BE ? CND_BE : CND_LE;
+        cnd_error_t err = const_check<Mode>(s, v, P::key(IP + 1), P::at(IP + 3), P::operand(IP + 4, type_size(P::at(IP + 3))));
+        if (err != CND_ERR_OK) return err;
+        return fixed_step<P, Mode, IP + 4 + type_size(P::at(IP + 3)), BE, Cur + type_size(P::at(IP + 3))>::run(s, v);
+    }
+};
+
+template <class P, cnd_mode_t Mode, size_t IP, bool BE, size_t Cur, uint8_t Op>
+struct fixed_op<P, Mode, IP, BE, Cur, Op, FIXED_CONST_WRITE> {
+    template <class V>
+    static cnd_error_t run(run_state& s, V& v) {
+        typedef typename io_type<P::at(IP + 1)>::type T;
+        if (Mode == CND_MODE_ENCODE) {
+            store<T>(s.buf + Cur, static_cast<T>(P::operand(IP + 2, sizeof(T))), BE);
+        }
+        return fixed_step<P, Mode, IP + 2 + sizeof(T), BE, Cur + sizeof(T)>::run(s, v);
+    }
+};
+
+} // namespace detail
+
+// --- Embedded programs ---
+
+// An IL image available at compile time, e.g. the output of `cnd compile`
+// turned into a constexpr array:
+//
+//   static constexpr uint8_t kTelemetryIL[] = { 0x43, 0x4E, 0x44, ... };
+//   static const cnd::embedded<kTelemetryIL, sizeof(kTelemetryIL)> telemetry;
+//   cnd::decode(telemetry, buf, len, visitor);
+template <const uint8_t* Image, size_t Size>
+class embedded {
+public:
+    static_assert(Size >= 16 && Image[0] == 'C' && Image[1] == 'N' && Image[2] == 'D' &&
+                  Image[3] == 'I' && Image[4] == 'L', "not a Concordia IL image");
+
+    static constexpr size_t bytecode_offset = detail::il_u32(Image + 12);
+    static_assert(bytecode_offset <= Size, "IL bytecode offset out of range");
+    static constexpr size_t bytecode_len = Size - bytecode_offset;
+
+    static constexpr uint8_t at(size_t ip) { return Image[bytecode_offset + ip]; }
+    static constexpr uint16_t key(size_t ip) { return detail::il_u16(Image + bytecode_offset + ip); }
+    static constexpr uint64_t operand(size_t ip, size_t size) {
+        return size == 1 ? at(ip) : size == 2 ? key(ip) : size == 4 ? detail::il_u32(Image + bytecode_offset + ip) : detail::il_u64(Image + bytecode_offset + ip);
+    }
+
+    // Instructions and bytes unrolled at compile time
+    static constexpr size_t prefix_end = detail::scan_prefix(Image + bytecode_offset, bytecode_len).end;
+    static constexpr size_t prefix_bytes = detail::scan_prefix(Image + bytecode_offset, bytecode_len).bytes;
+
+    embedded() : status_(cnd_program_load_il(&program_, Image, Size)) {}
+
+    const cnd_program& program() const { return program_; }
+    cnd_error_t status() const { return status_; }
+
+private:
+    cnd_program program_;
+    cnd_error_t status_;
+};
+
+// --- Execution ---
+
+// Runs `program` over buf[0..len) in the given mode, reporting fields to
+// `visitor`. *used receives the bytes read or written.
+template <cnd_mode_t Mode, class Visitor>
+cnd_error_t execute(const cnd_program& program, uint8_t* buf, size_t len, Visitor&& visitor, size_t* used = nullptr) {
+    if (!program.bytecode || !buf) return CND_ERR_OOB;
+    detail::run_state s(buf, len);
+    cnd_error_t err = detail::interpret<Mode>(program, s, visitor);
+    if (used) *used = s.cursor;
+    return err;
+}
+
+template <cnd_mode_t Mode, const uint8_t* Image, size_t Size, class Visitor>
+cnd_error_t execute(const embedded<Image, Size>& program, uint8_t* buf, size_t len, Visitor&& visitor, size_t* used = nullptr) {
+    if (program.status() != CND_ERR_OK) return program.status();
+    if (!buf) return CND_ERR_OOB;
+    detail::run_state s(buf, len);
+    cnd_error_t err = CND_ERR_OK;
+    // Buffers too short for the prefix take the checked path for exact errors
+    if (len >= embedded<Image, Size>::prefix_bytes) {
+        err = detail::fixed_step<embedded<Image, Size>, Mode, 0, false, 0>::run(s, visitor);
+    }
+    if (err == CND_ERR_OK) err = detail::interpret<Mode>(program.program(), s, visitor);
+    if (used) *used = s.cursor;
+    return err;
+}
+
+template <class Program, class Visitor>
+cnd_error_t encode(const Program& program, uint8_t* buf, size_t len, Visitor&& visitor, size_t* written = nullptr) {
+    return execute<CND_MODE_ENCODE>(program, buf, len, visitor, written);
+}
+
+template <class Program, class Visitor>
+cnd_error_t decode(const Program& program, const uint8_t* buf, size_t len, Visitor&& visitor, size_t* used = nullptr) {
+    // Decoding never writes to the buffer
+    return execute<CND_MODE_DECODE>(program, const_cast<uint8_t*>(buf), len, visitor, used);
+}
+
+} // namespace cnd
+
+#endif // CONCORDIA_HPP
@@ -1,25 +1,28 @@
 #include "cli_helpers.h"
 
 // Defined in src/compiler/cndc.c
-extern int cnd_compile_file(const char* in_path, const char* out_path, int json_output, int verbose);
+extern int cnd_compile_file_ex(const char* in_path, const char* out_path, int json_output, int verbose, int opt_level);
 
 int cmd_compile(int argc, char** argv) {
     if (argc < 4) {
-        printf("Usage: cnd compile <input.cnd> <output.il> [--json] [--verbose]\n");
+        printf("Usage: cnd compile <input.cnd> <output.il> [-O] [--json] [--verbose]\n");
         return 1;
     }
     
     int json_output = 0;
     int verbose = 0;
+    int opt_level = 0;
     
     for (int i = 4; i < argc; i++) {
         if (strcmp(argv[i], "--json") == 0) {
             json_output = 1;
         } else if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
             verbose = 1;
+        } else if (strcmp(argv[i], "-O") == 0) {
+            opt_level = 1;
         }
     }
     
-    return cnd_compile_file(argv[2], argv[3], json_output, verbose);
+    return cnd_compile_file_ex(argv[2], argv[3], json_output, verbose, opt_level);
 }
 
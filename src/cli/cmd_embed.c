@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "concordia.h"
+#include "cli_helpers.h"
+
+// `cnd embed`: writes an IL image as a header with a byte array, constexpr in
+// C++ so that cnd::embedded (concordia.hpp) can specialize on it.
+
+static int embed_valid_ident(const char* s) {
+    if (!s[0] || !(isalpha((unsigned char)s[0]) || s[0] == '_')) return 0;
+    for (const char* p = s + 1; *p; p++) {
+        if (!(isalnum((unsigned char)*p) || *p == '_')) return 0;
+    }
+    return 1;
+}
+
+int cmd_embed(int argc, char** argv) {
+    if (argc < 4) {
+        printf("Usage: cnd embed <schema.il> <out.h> [name]\n");
+        printf("Writes the IL image as array `name` (default: the header name), constexpr in C++.\n");
+        return 1;
+    }
+    const char* il_path = argv[2];
+    const char* out_path = argv[3];
+
+    char name[128];
+    if (argc > 4) {
+        snprintf(name, sizeof(name), "%s", argv[4]);
+    } else {
+        const char* base = strrchr(out_path, '/');
+        base = base ? base + 1 : out_path;
+        snprintf(name, sizeof(name), "%s", base);
+        char* dot = strchr(name, '.');
+        if (dot) *dot = '\0';
+    }
+    if (!embed_valid_ident(name)) {
+        printf("embed: '%s' is not a C identifier\n", name);
+        return 1;
+    }
+
+    size_t len = 0;
+    uint8_t* image = read_file_bytes(il_path, &len);
+    if (!image) { printf("Failed to read IL\n"); return 1; }
+    cnd_program program;
+    if (cnd_program_load_il(&program, image, len) != CND_ERR_OK) {
+        printf("embed: %s is not a valid IL image\n", il_path);
+        free(image);
+        return 1;
+    }
+
+    char guard[160];
+    size_t g = 0;
+    for (const char* p = name; *p && g < sizeof(guard) - 3; p++) guard[g++] = (char)toupper((unsigned char)*p);
+    memcpy(guard + g, "_H", 3);
+
+    // "0x00, " per byte plus the indent of every line of 16
+    size_t cap = 512 + strlen(il_path) + len * 7;
+    char* text = malloc(cap);
+    if (!text) { free(image); return 1; }
+    size_t pos = 0;
+    pos += (size_t)snprintf(text + pos, cap - pos,
+        "// Generated by `cnd embed` from %s. Do not edit.\n"
+        "#ifndef %s\n#define %s\n\n#include <stdint.h>\n\n"
+        "#ifdef __cplusplus\nstatic constexpr uint8_t %s[] = {\n#else\nstatic const uint8_t %s[] = {\n#endif\n",
+        il_path, guard, guard, name, name);
+    for (size_t i = 0; i < len; i++) {
+        pos += (size_t)snprintf(text + pos, cap - pos, "%s0x%02X,%s", (i % 16) == 0 ? "    " : "",
+                                image[i], (i % 16) == 15 || i + 1 == len ? "\n" : " ");
+    }
+    pos += (size_t)snprintf(text + pos, cap - pos, "};\n\n#endif // %s\n", guard);
+
+    int status = write_file_text(out_path, text) ? 0 : 1;
+    if (status != 0) printf("Failed to write %s\n", out_path);
+    free(text);
+    free(image);
+    return status;
+}
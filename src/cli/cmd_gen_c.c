@@ -0,0 +1,2630 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+#include "cli_helpers.h"
+#include "../vm/vm_internal.h"
+
+// cnd gen-c: translates an IL program into a C99 encode/decode pair over a
+// generated struct. The bytecode is walked once per direction and every
+// instruction becomes straight-line C: field offsets, transforms, checks and
+// constant expressions are resolved here, arrays become counted loops,
+// subroutines are inlined and jumps and switches become gotos. The generated
+// code follows the interpreter's semantics (error codes, bounds, bit order);
+// the differences are noted where they are made.
+
+// --- Output Buffers ---
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} gen_buf;
+
+static void gb_vprintf(gen_buf* b, const char* fmt, va_list ap) {
+    va_list ap2;
+    va_copy(ap2, ap);
+    int n = vsnprintf(NULL, 0, fmt, ap2);
+    va_end(ap2);
+    if (n < 0) return;
+    if (b->len + (size_t)n + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap : 1024;
+        while (b->len + (size_t)n + 1 > cap) cap *= 2;
+        char* data = realloc(b->data, cap);
+        if (!data) { fprintf(stderr, "gen-c: out of memory\n"); exit(1); }
+        b->data = data;
+        b->cap = cap;
+    }
+    vsnprintf(b->data + b->len, (size_t)n + 1, fmt, ap);
+    b->len += (size_t)n;
+}
+
+static void gb_printf(gen_buf* b, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    gb_vprintf(b, fmt, ap);
+    va_end(ap);
+}
+
+static void gb_free(gen_buf* b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = b->cap = 0;
+}
+
+// --- Generator State ---
+
+// A value on the symbolic expression stack: a constant (its 64 bits) or a
+// local of the generated function holding integer bits or a double.
+enum { GV_CONST, GV_U, GV_F };
+
+typedef struct {
+    int kind;
+    uint64_t bits;
+    char name[24];
+} gen_val;
+
+// Pending transform, applied by the next primitive field
+enum { GT_NONE, GT_SCALE, GT_POLY, GT_SPLINE, GT_ADD, GT_SUB, GT_MUL, GT_DIV };
+
+// What is known at a point of the program: byte order and the bit offset
+// (-1 when it depends on the path)
+typedef struct {
+    int endian;
+    int bitpos;
+} gen_flow;
+
+typedef struct {
+    gen_flow f;
+    int trans;
+    double fac, off;
+    int64_t k;
+    int curve, curve_n;
+    bool optional;
+    int sp;
+    gen_val stack[CND_MAX_EXPR_STACK];
+} gen_state;
+
+// Members of the generated struct, built from the dotted key names
+enum { NODE_NEW, NODE_STRUCT, NODE_VALUE, NODE_STRING, NODE_BYTES };
+enum { ARR_NONE, ARR_FIXED_LEN, ARR_VAR_LEN };
+
+typedef struct {
+    char name[64];
+    int parent;
+    int kind;
+    const char* ctype;  // NODE_VALUE
+    bool is_bool;
+    bool weak;          // Only read by expressions so far
+    uint32_t size;      // NODE_STRING: max characters (0 = <NAME>_MAX_STRING); NODE_BYTES: count
+    int array;
+    uint32_t array_len;
+} gen_node;
+
+typedef struct {
+    uint16_t key;
+    bool fixed;
+    uint32_t count;
+    bool eof;
+} gen_loop;
+
+typedef struct {
+    uint32_t poly, init, xorout;
+    uint8_t flags;
+    int width;
+} gen_crc;
+
+typedef struct {
+    const uint8_t* bc;
+    size_t len;
+    const char** strtab;
+    uint16_t str_count;
+    char name[64];
+    char upper[64];
+
+    int pass;       // 0: layout only, 1: encode, 2: decode
+    bool encode;
+    gen_buf* out;
+    int indent;
+    bool failed;
+    char err[256];
+
+    gen_node* nodes;
+    int node_count, node_cap;
+
+    gen_loop loops[CND_MAX_LOOP_DEPTH];
+    int depth;
+    uint16_t key_base;
+    int call_depth;
+    int regions;
+
+    // Per generated function
+    int n_u, n_f, max_depth;
+    bool var_count[CND_MAX_LOOP_DEPTH];
+    bool uses_i[CND_MAX_LOOP_DEPTH];
+    bool uses_bit, uses_s;
+    uint8_t* stored; // Per key: GEN_KEY_* flags
+
+    // Per program, found by the layout pass
+    bool has_crc, has_crc_marks, named;
+    bool uses_max_array, uses_max_string;
+
+    // File scope of the .c: curve coefficients and CRC functions
+    gen_buf statics;
+    size_t* curve_ips;
+    int curve_count;
+    gen_crc crcs[16];
+    int crc_count;
+
+    // The last primitive field, whose bytes end at the cursor
+    struct {
+        bool valid;
+        uint8_t type;
+        char expr[256];
+    } last_io;
+} gen_ctx;
+
+#define GEN_KEY_LOCAL      1 // Read back after a store: kept in a local
+#define GEN_KEY_STORED_NOW 2 // Stored earlier in the function being generated
+
+#define GEN_MAX_RUN 64
+
+static void gen_fail(gen_ctx* g, const char* fmt, ...) {
+    if (g->failed) return;
+    g->failed = true;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(g->err, sizeof(g->err), fmt, ap);
+    va_end(ap);
+}
+
+static void gen_line(gen_ctx* g, const char* fmt, ...) {
+    gb_printf(g->out, "%*s", g->indent, "");
+    va_list ap;
+    va_start(ap, fmt);
+    gb_vprintf(g->out, fmt, ap);
+    va_end(ap);
+    gb_printf(g->out, "\n");
+}
+
+static void gen_return_ok(gen_ctx* g) {
+    gen_line(g, "if (out_len) *out_len = cur;");
+    gen_line(g, "return CND_GEN_OK;");
+}
+
+// --- Types and Literals ---
+
+static const char* io_ctype(uint8_t type) {
+    switch (type) {
+        case OP_IO_U8: return "uint8_t";
+        case OP_IO_U16: return "uint16_t";
+        case OP_IO_U32: return "uint32_t";
+        case OP_IO_U64: return "uint64_t";
+        case OP_IO_I8: return "int8_t";
+        case OP_IO_I16: return "int16_t";
+        case OP_IO_I32: return "int32_t";
+        case OP_IO_I64: return "int64_t";
+        case OP_IO_F32: return "float";
+        case OP_IO_F64: return "double";
+        case OP_IO_BOOL: return "uint8_t";
+        default: return NULL;
+    }
+}
+
+static bool io_is_float(uint8_t type) {
+    return type == OP_IO_F32 || type == OP_IO_F64;
+}
+
+static bool io_is_signed(uint8_t type) {
+    return type >= OP_IO_I8 && type <= OP_IO_I64;
+}
+
+static bool ctype_is_float(const char* ctype) {
+    return strcmp(ctype, "float") == 0 || strcmp(ctype, "double") == 0;
+}
+
+static bool ctype_is_signed(const char* ctype) {
+    return ctype[0] == 'i';
+}
+
+static const char* bits_ctype(int width, bool is_signed) {
+    if (width <= 8) return is_signed ? "int8_t" : "uint8_t";
+    if (width <= 16) return is_signed ? "int16_t" : "uint16_t";
+    if (width <= 32) return is_signed ? "int32_t" : "uint32_t";
+    return is_signed ? "int64_t" : "uint64_t";
+}
+
+// A double literal that reads back as exactly `v`
+static void gen_dbl(char* out, size_t n, double v) {
+    if (v != v) { snprintf(out, n, "NAN"); return; }
+    if (v == HUGE_VAL) { snprintf(out, n, "HUGE_VAL"); return; }
+    if (v == -HUGE_VAL) { snprintf(out, n, "(-HUGE_VAL)"); return; }
+    snprintf(out, n, "%.17g", v);
+    if (!strpbrk(out, ".e")) strncat(out, ".0", n - strlen(out) - 1);
+    if (v < 0) {
+        char tmp[48];
+        snprintf(tmp, sizeof(tmp), "(%s)", out);
+        snprintf(out, n, "%s", tmp);
+    }
+}
+
+static double bits_to_dbl(uint64_t bits) {
+    double d;
+    memcpy(&d, &bits, 8);
+    return d;
+}
+
+static uint64_t dbl_to_bits(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, 8);
+    return bits;
+}
+
+// Integer literal of `type` for IL bits zero-extended from the type's size
+static void gen_int_lit(char* out, size_t n, uint8_t type, uint64_t bits) {
+    switch (type) {
+        case OP_IO_I8:  snprintf(out, n, "%d", (int)(int8_t)bits); return;
+        case OP_IO_I16: snprintf(out, n, "%d", (int)(int16_t)bits); return;
+        case OP_IO_I32: snprintf(out, n, "INT32_C(%" PRId32 ")", (int32_t)bits); return;
+        case OP_IO_I64:
+            if ((int64_t)bits == INT64_MIN) snprintf(out, n, "INT64_MIN");
+            else snprintf(out, n, "INT64_C(%" PRId64 ")", (int64_t)bits);
+            return;
+        case OP_IO_U64: snprintf(out, n, "UINT64_C(%" PRIu64 ")", bits); return;
+        default: snprintf(out, n, "%" PRIu64 "u", bits); return;
+    }
+}
+
+// Loads and stores of `type` at buf + at in byte order `endian`
+static void gen_load(char* out, size_t n, uint8_t type, int endian, const char* at) {
+    const char* e = endian == CND_BE ? "be" : "le";
+    switch (type) {
+        case OP_IO_U8: case OP_IO_BOOL: snprintf(out, n, "buf[%s]", at); return;
+        case OP_IO_I8:  snprintf(out, n, "(int8_t)buf[%s]", at); return;
+        case OP_IO_U16: snprintf(out, n, "cg_ld16%s(buf + %s)", e, at); return;
+        case OP_IO_I16: snprintf(out, n, "(int16_t)cg_ld16%s(buf + %s)", e, at); return;
+        case OP_IO_U32: snprintf(out, n, "cg_ld32%s(buf + %s)", e, at); return;
+        case OP_IO_I32: snprintf(out, n, "(int32_t)cg_ld32%s(buf + %s)", e, at); return;
+        case OP_IO_U64: snprintf(out, n, "cg_ld64%s(buf + %s)", e, at); return;
+        case OP_IO_I64: snprintf(out, n, "(int64_t)cg_ld64%s(buf + %s)", e, at); return;
+        case OP_IO_F32: snprintf(out, n, "cg_f32(cg_ld32%s(buf + %s))", e, at); return;
+        case OP_IO_F64: snprintf(out, n, "cg_f64(cg_ld64%s(buf + %s))", e, at); return;
+        default: snprintf(out, n, "0"); return;
+    }
+}
+
+// The stored bits of `type` at buf + at, zero-extended
+static void gen_load_bits(char* out, size_t n, uint32_t size, int endian, const char* at) {
+    const char* e = endian == CND_BE ? "be" : "le";
+    if (size == 1) snprintf(out, n, "buf[%s]", at);
+    else snprintf(out, n, "cg_ld%u%s(buf + %s)", (unsigned)size * 8, e, at);
+}
+
+static void gen_store(gen_ctx* g, uint8_t type, int endian, const char* at, const char* val) {
+    const char* e = endian == CND_BE ? "be" : "le";
+    switch (il_type_size(type)) {
+        case 1: gen_line(g, "buf[%s] = (uint8_t)(%s);", at, val); return;
+        case 2: gen_line(g, "cg_st16%s(buf + %s, (uint16_t)(%s));", e, at, val); return;
+        case 4:
+            if (type == OP_IO_F32) gen_line(g, "cg_st32%s(buf + %s, cg_f32bits(%s));", e, at, val);
+            else gen_line(g, "cg_st32%s(buf + %s, (uint32_t)(%s));", e, at, val);
+            return;
+        default:
+            if (type == OP_IO_F64) gen_line(g, "cg_st64%s(buf + %s, cg_f64bits(%s));", e, at, val);
+            else gen_line(g, "cg_st64%s(buf + %s, (uint64_t)(%s));", e, at, val);
+            return;
+    }
+}
+
+static void gen_at(char* out, size_t n, uint32_t off) {
+    if (off == 0) snprintf(out, n, "cur");
+    else snprintf(out, n, "cur + %u", (unsigned)off);
+}
+
+// --- Struct Layout ---
+
+static const char* const c_keywords[] = {
+    "auto", "break", "case", "char", "const", "continue", "default", "do", "double",
+    "else", "enum", "extern", "float", "for", "goto", "if", "inline", "int", "long",
+    "register", "restrict", "return", "short", "signed", "sizeof", "static", "struct",
+    "switch", "typedef", "union", "unsigned", "void", "volatile", "while", "bool",
+    "class", "delete", "new", "private", "protected", "public", "template", "this",
+    "namespace", "operator", "virtual", "true", "false", NULL
+};
+
+static void gen_ident(char* out, size_t n, const char* seg, size_t seg_len) {
+    if (seg_len >= n - 2) seg_len = n - 2;
+    memcpy(out, seg, seg_len);
+    out[seg_len] = '\0';
+    for (int i = 0; c_keywords[i]; i++) {
+        if (strcmp(out, c_keywords[i]) == 0) { strcat(out, "_"); break; }
+    }
+}
+
+static int gen_node_child(gen_ctx* g, int parent, const char* name) {
+    for (int i = 1; i < g->node_count; i++) {
+        if (g->nodes[i].parent == parent && strcmp(g->nodes[i].name, name) == 0) return i;
+    }
+    if (g->pass != 0) {
+        gen_fail(g, "internal error: member %s missing from the layout", name);
+        return -1;
+    }
+    if (g->node_count == g->node_cap) {
+        g->node_cap = g->node_cap ? g->node_cap * 2 : 64;
+        g->nodes = realloc(g->nodes, (size_t)g->node_cap * sizeof(gen_node));
+        if (!g->nodes) { fprintf(stderr, "gen-c: out of memory\n"); exit(1); }
+    }
+    gen_node* node = &g->nodes[g->node_count];
+    memset(node, 0, sizeof(*node));
+    snprintf(node->name, sizeof(node->name), "%s", name);
+    node->parent = parent;
+    node->kind = NODE_NEW;
+    return g->node_count++;
+}
+
+static const char* gen_key_name(gen_ctx* g, uint16_t key) {
+    if (key >= g->str_count) {
+        gen_fail(g, "key %u has no name in the string table", (unsigned)key);
+        return NULL;
+    }
+    return g->strtab[key];
+}
+
+static const char* gen_cap_expr(gen_ctx* g, const gen_loop* loop, char* buf, size_t n) {
+    if (loop->fixed) {
+        snprintf(buf, n, "%" PRIu32 "u", loop->count);
+    } else {
+        int w = snprintf(buf, n, "%s_MAX_ARRAY", g->upper);
+        if (w < 0 || (size_t)w >= n) gen_fail(g, "array capacity macro for '%s' is too long", g->name);
+        g->uses_max_array = true;
+    }
+    return buf;
+}
+
+// Resolves `key` to an lvalue of the generated struct in `out` and returns
+// its node, created in the layout pass. A path prefix naming the key of an
+// open array is that array, indexed by the array's loop counter; `all_loops`
+// requires every open array to be on the path (transferred fields). With
+// `suffix`, the last segment is a sibling member such as the count of an
+// array that is about to open.
+static int gen_member(gen_ctx* g, uint16_t key, const char* suffix, bool all_loops, char* out, size_t n) {
+    const char* name = gen_key_name(g, key);
+    if (!name) return -1;
+
+    bool matched[CND_MAX_LOOP_DEPTH] = {false};
+    int node = 0;
+    size_t pos = 0;
+    int written = snprintf(out, n, "p->");
+    (void)written;
+
+    while (!g->failed) {
+        const char* dot = strchr(name + pos, '.');
+        size_t seg_end = dot ? (size_t)(dot - name) : strlen(name);
+        char seg[64];
+        gen_ident(seg, sizeof(seg) - 8, name + pos, seg_end - pos);
+        bool last = (dot == NULL);
+        if (last && suffix) strcat(seg, suffix);
+
+        int child = gen_node_child(g, node, seg);
+        if (child < 0) return -1;
+        gen_node* c = &g->nodes[child];
+        if (!last) {
+            if (c->kind == NODE_NEW) c->kind = NODE_STRUCT;
+            if (c->kind != NODE_STRUCT) { gen_fail(g, "%s is both a field and a struct", name); return -1; }
+        }
+        strncat(out, seg, n - strlen(out) - 1);
+
+        if (!(last && suffix)) {
+            for (int d = 0; d < g->depth; d++) {
+                const char* loop_name = gen_key_name(g, g->loops[d].key);
+                if (!loop_name || matched[d]) continue;
+                if (strlen(loop_name) != seg_end || strncmp(loop_name, name, seg_end) != 0) continue;
+                int array = g->loops[d].fixed ? ARR_FIXED_LEN : ARR_VAR_LEN;
+                uint32_t array_len = g->loops[d].fixed ? g->loops[d].count : 0;
+                if (g->pass == 0 && c->array == ARR_NONE) {
+                    c->array = array;
+                    c->array_len = array_len;
+                } else if (c->array != array || c->array_len != array_len) {
+                    gen_fail(g, "array %s has conflicting lengths", loop_name);
+                    return -1;
+                }
+                char idx[16];
+                snprintf(idx, sizeof(idx), "[i%d]", d);
+                strncat(out, idx, n - strlen(out) - 1);
+                matched[d] = true;
+                break;
+            }
+        }
+
+        node = child;
+        if (last) break;
+        strncat(out, ".", n - strlen(out) - 1);
+        pos = seg_end + 1;
+    }
+    if (g->failed) return -1;
+
+    if (all_loops) {
+        for (int d = 0; d < g->depth; d++) {
+            if (!matched[d]) {
+                gen_fail(g, "field %s is inside array %s but not one of its members", name,
+                         gen_key_name(g, g->loops[d].key));
+                return -1;
+            }
+        }
+    }
+    return node;
+}
+
+// Sets the kind of a transferred member; conflicting uses fail
+static bool gen_leaf(gen_ctx* g, int node, int kind, const char* ctype, uint32_t size, bool is_bool) {
+    if (node < 0) return false;
+    gen_node* c = &g->nodes[node];
+    if (g->pass == 0 && (c->kind == NODE_NEW || c->weak)) {
+        c->kind = kind;
+        c->ctype = ctype;
+        c->size = size;
+        c->is_bool = is_bool;
+        c->weak = false;
+        return true;
+    }
+    if (c->kind != kind || c->size != size || (ctype && (!c->ctype || strcmp(c->ctype, ctype) != 0))) {
+        gen_fail(g, "member %s is transferred as different types", c->name);
+        return false;
+    }
+    return true;
+}
+
+// Resolves a transferred field of `kind`
+static int gen_field(gen_ctx* g, uint16_t key, int kind, const char* ctype, uint32_t size,
+                     bool is_bool, char* out, size_t n) {
+    int node = gen_member(g, key, NULL, true, out, n);
+    if (node < 0 || !gen_leaf(g, node, kind, ctype, size, is_bool)) return -1;
+    return node;
+}
+
+// --- Expressions ---
+
+static gen_val gen_const(uint64_t bits) {
+    gen_val v;
+    memset(&v, 0, sizeof(v));
+    v.kind = GV_CONST;
+    v.bits = bits;
+    return v;
+}
+
+// New local of the generated function, assigned `expr` unless NULL
+static gen_val gen_temp(gen_ctx* g, int kind, const char* expr) {
+    gen_val v;
+    memset(&v, 0, sizeof(v));
+    v.kind = kind;
+    if (kind == GV_F) snprintf(v.name, sizeof(v.name), "d%d", g->n_f++);
+    else snprintf(v.name, sizeof(v.name), "t%d", g->n_u++);
+    if (expr) gen_line(g, "%s = %s;", v.name, expr);
+    return v;
+}
+
+// The value as uint64_t bits / as a double
+static const char* gen_u(const gen_val* v, char* buf, size_t n) {
+    if (v->kind == GV_CONST) snprintf(buf, n, "UINT64_C(%" PRIu64 ")", v->bits);
+    else if (v->kind == GV_F) snprintf(buf, n, "cg_f64bits(%s)", v->name);
+    else snprintf(buf, n, "%s", v->name);
+    return buf;
+}
+
+static const char* gen_f(const gen_val* v, char* buf, size_t n) {
+    if (v->kind == GV_CONST) {
+        double d = bits_to_dbl(v->bits);
+        if (d != d) snprintf(buf, n, "cg_f64(UINT64_C(%" PRIu64 "))", v->bits);
+        else gen_dbl(buf, n, d);
+    } else if (v->kind == GV_U) {
+        snprintf(buf, n, "cg_f64(%s)", v->name);
+    } else {
+        snprintf(buf, n, "%s", v->name);
+    }
+    return buf;
+}
+
+static bool gen_push(gen_ctx* g, gen_state* st, gen_val v) {
+    if (st->sp >= CND_MAX_EXPR_STACK) { gen_fail(g, "expression stack overflow"); return false; }
+    st->stack[st->sp++] = v;
+    return true;
+}
+
+static bool gen_pop(gen_ctx* g, gen_state* st, gen_val* v) {
+    if (st->sp == 0) { gen_fail(g, "expression stack underflow"); return false; }
+    *v = st->stack[--st->sp];
+    return true;
+}
+
+static bool alu_float_result(uint8_t op) {
+    switch (op) {
+        case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FDIV: case OP_FNEG:
+        case OP_SIN: case OP_COS: case OP_TAN: case OP_SQRT: case OP_LOG: case OP_ABS: case OP_POW:
+        case OP_ITOF:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool alu_float_args(uint8_t op) {
+    switch (op) {
+        case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FDIV: case OP_FNEG:
+        case OP_SIN: case OP_COS: case OP_TAN: case OP_SQRT: case OP_LOG: case OP_ABS: case OP_POW:
+        case OP_FTOI:
+        case OP_EQ_F: case OP_NEQ_F: case OP_GT_F: case OP_LT_F: case OP_GTE_F: case OP_LTE_F:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static int alu_arity(uint8_t op) {
+    switch (op) {
+        case OP_NEG: case OP_FNEG: case OP_ITOF: case OP_FTOI: case OP_BIT_NOT: case OP_LOG_NOT:
+        case OP_SIN: case OP_COS: case OP_TAN: case OP_SQRT: case OP_LOG: case OP_ABS:
+            return 1;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FDIV:
+        case OP_EQ_F: case OP_NEQ_F: case OP_GT_F: case OP_LT_F: case OP_GTE_F: case OP_LTE_F:
+        case OP_BIT_AND: case OP_BIT_OR: case OP_BIT_XOR: case OP_SHL: case OP_SHR:
+        case OP_EQ: case OP_NEQ: case OP_GT: case OP_LT: case OP_GTE: case OP_LTE:
+        case OP_LOG_AND: case OP_LOG_OR: case OP_POW:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// Folds an operation on constants as the interpreter computes it. Math
+// library functions and operations that fail are left to run time.
+static bool gen_fold(uint8_t op, uint64_t a, uint64_t b, uint64_t* out) {
+    double fa = bits_to_dbl(a), fb = bits_to_dbl(b);
+    switch (op) {
+        case OP_ADD: *out = a + b; return true;
+        case OP_SUB: *out = a - b; return true;
+        case OP_MUL: *out = a * b; return true;
+        case OP_DIV: if (b == 0) return false; *out = a / b; return true;
+        case OP_MOD: if (b == 0) return false; *out = a % b; return true;
+        case OP_NEG: *out = (uint64_t)0 - a; return true;
+        case OP_FADD: *out = dbl_to_bits(fa + fb); return true;
+        case OP_FSUB: *out = dbl_to_bits(fa - fb); return true;
+        case OP_FMUL: *out = dbl_to_bits(fa * fb); return true;
+        case OP_FDIV: if (fb == 0.0) return false; *out = dbl_to_bits(fa / fb); return true;
+        case OP_FNEG: *out = dbl_to_bits(-fa); return true;
+        case OP_ITOF: *out = dbl_to_bits((double)(int64_t)a); return true;
+        case OP_FTOI:
+            if (!(fa > -9223372036854775808.0 && fa < 9223372036854775808.0)) return false;
+            *out = (uint64_t)(int64_t)fa;
+            return true;
+        case OP_EQ_F: *out = fa == fb; return true;
+        case OP_NEQ_F: *out = fa != fb; return true;
+        case OP_GT_F: *out = fa > fb; return true;
+        case OP_LT_F: *out = fa < fb; return true;
+        case OP_GTE_F: *out = fa >= fb; return true;
+        case OP_LTE_F: *out = fa <= fb; return true;
+        case OP_BIT_AND: *out = a & b; return true;
+        case OP_BIT_OR: *out = a | b; return true;
+        case OP_BIT_XOR: *out = a ^ b; return true;
+        case OP_BIT_NOT: *out = ~a; return true;
+        case OP_SHL: if (b >= 64) return false; *out = a << b; return true;
+        case OP_SHR: if (b >= 64) return false; *out = a >> b; return true;
+        case OP_EQ: *out = a == b; return true;
+        case OP_NEQ: *out = a != b; return true;
+        case OP_GT: *out = a > b; return true;
+        case OP_LT: *out = a < b; return true;
+        case OP_GTE: *out = a >= b; return true;
+        case OP_LTE: *out = a <= b; return true;
+        case OP_LOG_AND: *out = a && b; return true;
+        case OP_LOG_OR: *out = a || b; return true;
+        case OP_LOG_NOT: *out = !a; return true;
+        default: return false;
+    }
+}
+
+// One ALU operation (vm_alu_eval) on `a` and `b`
+static gen_val gen_alu(gen_ctx* g, uint8_t op, const gen_val* a, const gen_val* b) {
+    int arity = alu_arity(op);
+    uint64_t folded;
+    if (a->kind == GV_CONST && (arity == 1 || b->kind == GV_CONST) &&
+        gen_fold(op, a->bits, arity == 2 ? b->bits : 0, &folded)) {
+        return gen_const(folded);
+    }
+
+    char x[64], y[64], e[256];
+    if (alu_float_args(op)) {
+        gen_f(a, x, sizeof(x));
+        if (arity == 2) gen_f(b, y, sizeof(y));
+    } else {
+        gen_u(a, x, sizeof(x));
+        if (arity == 2) gen_u(b, y, sizeof(y));
+    }
+
+    switch (op) {
+        case OP_ADD: snprintf(e, sizeof(e), "%s + %s", x, y); break;
+        case OP_SUB: snprintf(e, sizeof(e), "%s - %s", x, y); break;
+        case OP_MUL: snprintf(e, sizeof(e), "%s * %s", x, y); break;
+        case OP_DIV:
+        case OP_MOD:
+            gen_line(g, "if (%s == 0) return CND_GEN_ERR_ARITHMETIC;", y);
+            snprintf(e, sizeof(e), "%s %c %s", x, op == OP_DIV ? '/' : '%', y);
+            break;
+        case OP_NEG: snprintf(e, sizeof(e), "(uint64_t)0 - %s", x); break;
+        case OP_FADD: snprintf(e, sizeof(e), "%s + %s", x, y); break;
+        case OP_FSUB: snprintf(e, sizeof(e), "%s - %s", x, y); break;
+        case OP_FMUL: snprintf(e, sizeof(e), "%s * %s", x, y); break;
+        case OP_FDIV:
+            gen_line(g, "if (%s == 0.0) return CND_GEN_ERR_ARITHMETIC;", y);
+            snprintf(e, sizeof(e), "%s / %s", x, y);
+            break;
+        case OP_FNEG: snprintf(e, sizeof(e), "-%s", x); break;
+        case OP_SIN: snprintf(e, sizeof(e), "sin(%s)", x); break;
+        case OP_COS: snprintf(e, sizeof(e), "cos(%s)", x); break;
+        case OP_TAN: snprintf(e, sizeof(e), "tan(%s)", x); break;
+        case OP_SQRT:
+            gen_line(g, "if (%s < 0) return CND_GEN_ERR_ARITHMETIC;", x);
+            snprintf(e, sizeof(e), "sqrt(%s)", x);
+            break;
+        case OP_LOG:
+            gen_line(g, "if (%s <= 0) return CND_GEN_ERR_ARITHMETIC;", x);
+            snprintf(e, sizeof(e), "log(%s)", x);
+            break;
+        case OP_ABS: snprintf(e, sizeof(e), "fabs(%s)", x); break;
+        case OP_POW:
+            gen_line(g, "if ((%s < 0 && floor(%s) != %s) || (%s == 0 && %s <= 0)) return CND_GEN_ERR_ARITHMETIC;",
+                     x, y, y, x, y);
+            snprintf(e, sizeof(e), "pow(%s, %s)", x, y);
+            break;
+        case OP_ITOF: snprintf(e, sizeof(e), "(double)(int64_t)%s", x); break;
+        case OP_FTOI: snprintf(e, sizeof(e), "(uint64_t)(int64_t)%s", x); break;
+        case OP_EQ_F: case OP_EQ: snprintf(e, sizeof(e), "(uint64_t)(%s == %s)", x, y); break;
+        case OP_NEQ_F: case OP_NEQ: snprintf(e, sizeof(e), "(uint64_t)(%s != %s)", x, y); break;
+        case OP_GT_F: case OP_GT: snprintf(e, sizeof(e), "(uint64_t)(%s > %s)", x, y); break;
+        case OP_LT_F: case OP_LT: snprintf(e, sizeof(e), "(uint64_t)(%s < %s)", x, y); break;
+        case OP_GTE_F: case OP_GTE: snprintf(e, sizeof(e), "(uint64_t)(%s >= %s)", x, y); break;
+        case OP_LTE_F: case OP_LTE: snprintf(e, sizeof(e), "(uint64_t)(%s <= %s)", x, y); break;
+        case OP_BIT_AND: snprintf(e, sizeof(e), "%s & %s", x, y); break;
+        case OP_BIT_OR: snprintf(e, sizeof(e), "%s | %s", x, y); break;
+        case OP_BIT_XOR: snprintf(e, sizeof(e), "%s ^ %s", x, y); break;
+        case OP_BIT_NOT: snprintf(e, sizeof(e), "~%s", x); break;
+        case OP_SHL: snprintf(e, sizeof(e), "%s << %s", x, y); break;
+        case OP_SHR: snprintf(e, sizeof(e), "%s >> %s", x, y); break;
+        case OP_LOG_AND: snprintf(e, sizeof(e), "(uint64_t)(%s && %s)", x, y); break;
+        case OP_LOG_OR: snprintf(e, sizeof(e), "(uint64_t)(%s || %s)", x, y); break;
+        case OP_LOG_NOT: snprintf(e, sizeof(e), "(uint64_t)!%s", x); break;
+        default: snprintf(e, sizeof(e), "0"); break;
+    }
+    return gen_temp(g, alu_float_result(op) ? GV_F : GV_U, e);
+}
+
+// Context value of `key` (OP_LOAD_CTX / OP_CTX_QUERY): a stored expression
+// result, or the member as the host reports it: signed values sign-extended,
+// booleans 0 or 1, floats as doubles. Keys that are never transferred become
+// uint64_t input members.
+static gen_val gen_ctx_value(gen_ctx* g, uint16_t key) {
+    char m[256];
+    if (g->pass == 0 && (g->stored[key] & GEN_KEY_STORED_NOW)) g->stored[key] |= GEN_KEY_LOCAL;
+    if ((g->stored[key] & GEN_KEY_LOCAL) && (g->stored[key] & GEN_KEY_STORED_NOW)) {
+        snprintf(m, sizeof(m), "v%u", (unsigned)key);
+        return gen_temp(g, GV_U, m);
+    }
+
+    int node = gen_member(g, key, NULL, false, m, sizeof(m));
+    if (node < 0) return gen_const(0);
+    gen_node* c = &g->nodes[node];
+    if (c->kind == NODE_NEW) {
+        c->kind = NODE_VALUE;
+        c->ctype = "uint64_t";
+        c->weak = true;
+    }
+    if (c->kind != NODE_VALUE) {
+        gen_fail(g, "%s is read in an expression but is not a number", g->strtab[key]);
+        return gen_const(0);
+    }
+
+    char e[300];
+    if (ctype_is_float(c->ctype)) {
+        snprintf(e, sizeof(e), "(double)%s", m);
+        return gen_temp(g, GV_F, e);
+    }
+    if (c->is_bool) snprintf(e, sizeof(e), "(uint64_t)(%s != 0)", m);
+    else if (ctype_is_signed(c->ctype)) snprintf(e, sizeof(e), "(uint64_t)(int64_t)%s", m);
+    else snprintf(e, sizeof(e), "(uint64_t)%s", m);
+    return gen_temp(g, GV_U, e);
+}
+
+// --- Regions ---
+//
+// A region is the code reachable from an entry point: the program, or one
+// inlined call of a subroutine. Its instructions are emitted in address
+// order; jumps, switches and loop exits become gotos to labels named after
+// the target address. Jumps only go forward, so the state at a label is
+// known once all gotos to it have been emitted.
+
+typedef struct {
+    int id;
+    bool top;
+    size_t* order;
+    size_t count;
+    uint8_t* reach;
+    int* refs;
+    gen_flow* lflow;
+    uint8_t* lhas;
+    size_t* loop_of;   // 1 + address of the innermost array, 0 outside arrays
+    size_t* arr_end;   // Matching OP_ARR_END of each array opcode
+    int ret_refs;
+    bool ret_fall;
+    bool ret_has;
+    gen_flow ret_flow;
+} gen_region;
+
+// Bytes of the instruction at `ip`. Superinstruction headers count alone:
+// the instructions they were built from follow them and run one by one.
+static bool gen_insn_len(gen_ctx* g, size_t ip, size_t* out) {
+    uint8_t op = g->bc[ip];
+    if (op == OP_IO_RUN) { *out = 4; return ip + 4 <= g->len; }
+    if (op == OP_IO_CHECK || op == OP_IO_SLOT) { *out = 1; return true; }
+    if (vm_insn_length(g->bc, g->len, ip, out) != CND_ERR_OK) {
+        gen_fail(g, "malformed instruction 0x%02X at 0x%zx", op, ip);
+        return false;
+    }
+    return true;
+}
+
+static bool is_switch(uint8_t op) {
+    return op == OP_SWITCH || op == OP_SWITCH_TABLE || op == OP_SWITCH_SORTED || op == OP_SWITCH_HASH;
+}
+
+static bool is_array(uint8_t op) {
+    return op == OP_ARR_FIXED || op == OP_ARR_PRE_U8 || op == OP_ARR_PRE_U16 ||
+           op == OP_ARR_PRE_U32 || op == OP_ARR_EOF || op == OP_ARR_DYNAMIC;
+}
+
+static bool is_plain_io(uint8_t op) {
+    return op >= OP_IO_U8 && op <= OP_IO_F64;
+}
+
+// Cases of a switch at `ip` as (value, target) pairs, first match winning,
+// and its default target. Returns the number of cases or -1.
+typedef struct {
+    uint64_t value;
+    size_t target;
+} gen_case;
+
+static int gen_switch_cases(gen_ctx* g, size_t ip, gen_case** cases, size_t* def) {
+    uint8_t op = g->bc[ip];
+    size_t table, table_len;
+    *cases = NULL;
+    if (vm_switch_table_span(g->bc, g->len, ip, &table, &table_len) != CND_ERR_OK) {
+        gen_fail(g, "malformed switch table at 0x%zx", ip);
+        return -1;
+    }
+    size_t code_start = ip + 7;
+    const uint8_t* t = g->bc + table;
+    int32_t def_off;
+    size_t n = 0, cap = 0;
+    gen_case* out = NULL;
+
+    #define GEN_ADD_CASE(v, off) do { \
+        size_t target_; \
+        if (vm_switch_target(code_start, (off), g->len, &target_) != CND_ERR_OK) { \
+            gen_fail(g, "switch target out of range at 0x%zx", ip); free(out); return -1; \
+        } \
+        if (n == cap) { \
+            cap = cap ? cap * 2 : 16; \
+            out = realloc(out, cap * sizeof(gen_case)); \
+            if (!out) { fprintf(stderr, "gen-c: out of memory\n"); exit(1); } \
+        } \
+        out[n].value = (v); out[n].target = target_; n++; \
+    } while (0)
+
+    if (op == OP_SWITCH || op == OP_SWITCH_SORTED) {
+        uint16_t count = il_get_u16(t);
+        def_off = (int32_t)il_get_u32(t + 2);
+        for (uint16_t i = 0; i < count; i++) {
+            const uint8_t* e = t + 6 + (size_t)i * 12;
+            uint64_t v = il_get_u64(e);
+            int32_t off = (op == OP_SWITCH) ? (int32_t)il_get_u32(e + 8) : vm_switch_sorted_lookup(t, v);
+            bool seen = false;
+            for (size_t j = 0; j < n; j++) if (out[j].value == v) seen = true;
+            if (!seen) GEN_ADD_CASE(v, off);
+        }
+    } else if (op == OP_SWITCH_TABLE) {
+        uint64_t min = il_get_u64(t), max = il_get_u64(t + 8);
+        def_off = (int32_t)il_get_u32(t + 16);
+        for (uint64_t i = 0; i <= max - min; i++) {
+            int32_t off = (int32_t)il_get_u32(t + 20 + (size_t)i * 4);
+            if (off != def_off) GEN_ADD_CASE(min + i, off);
+        }
+    } else {
+        def_off = (int32_t)il_get_u32(t);
+        uint8_t slot_bits = t[12], bucket_bits = t[13];
+        const uint8_t* slots = t + 14 + ((size_t)2 << bucket_bits);
+        for (size_t s = 0; s < ((size_t)1 << slot_bits); s++) {
+            uint64_t v = il_get_u64(slots + s * 12);
+            int32_t off = vm_switch_hash_lookup(t, v);
+            bool seen = false;
+            for (size_t j = 0; j < n; j++) if (out[j].value == v) seen = true;
+            if (!seen && off != def_off) GEN_ADD_CASE(v, off);
+        }
+    }
+    #undef GEN_ADD_CASE
+
+    if (vm_switch_target(code_start, def_off, g->len, def) != CND_ERR_OK) {
+        gen_fail(g, "switch target out of range at 0x%zx", ip);
+        free(out);
+        return -1;
+    }
+    *cases = out;
+    return (int)n;
+}
+
+static void gen_region_free(gen_region* r) {
+    free(r->order);
+    free(r->reach);
+    free(r->refs);
+    free(r->lflow);
+    free(r->lhas);
+    free(r->loop_of);
+    free(r->arr_end);
+}
+
+// Finds the instructions reachable from `entry` and pairs the arrays
+static bool gen_region_scan(gen_ctx* g, gen_region* r, size_t entry) {
+    size_t n = g->len + 1;
+    r->reach = calloc(n, 1);
+    r->refs = calloc(n, sizeof(int));
+    r->lflow = calloc(n, sizeof(gen_flow));
+    r->lhas = calloc(n, 1);
+    r->loop_of = calloc(n, sizeof(size_t));
+    r->arr_end = calloc(n, sizeof(size_t));
+    size_t* work = malloc(n * sizeof(size_t));
+    if (!r->reach || !r->refs || !r->lflow || !r->lhas || !r->loop_of || !r->arr_end || !work) {
+        fprintf(stderr, "gen-c: out of memory\n");
+        exit(1);
+    }
+
+    size_t top = 0;
+    work[top++] = entry;
+    while (top > 0 && !g->failed) {
+        size_t ip = work[--top];
+        if (ip > g->len || r->reach[ip]) continue;
+        r->reach[ip] = 1;
+        if (ip == g->len) continue;
+
+        uint8_t op = g->bc[ip];
+        size_t ilen;
+        if (!gen_insn_len(g, ip, &ilen)) break;
+        size_t next = ip + ilen;
+
+        if (op == OP_JUMP || op == OP_JUMP_IF_NOT) {
+            int32_t off = (int32_t)il_get_u32(g->bc + ip + 1);
+            size_t target;
+            if (vm_switch_target(next, off, g->len, &target) != CND_ERR_OK) {
+                gen_fail(g, "jump target out of range at 0x%zx", ip);
+                break;
+            }
+            work[top++] = target;
+            if (op == OP_JUMP) continue;
+        } else if (is_switch(op)) {
+            gen_case* cases;
+            size_t def;
+            int count = gen_switch_cases(g, ip, &cases, &def);
+            if (count < 0) break;
+            // Targets may repeat; the work list is bounded by marking
+            size_t* grown = realloc(work, (n + (size_t)count + 1) * sizeof(size_t));
+            if (!grown) { fprintf(stderr, "gen-c: out of memory\n"); exit(1); }
+            work = grown;
+            for (int i = 0; i < count; i++) {
+                if (!r->reach[cases[i].target]) work[top++] = cases[i].target;
+            }
+            work[top++] = def;
+            free(cases);
+            n = g->len + 1 + (size_t)count + 1;
+            continue;
+        } else if (op == OP_RET) {
+            continue;
+        }
+        work[top++] = next;
+    }
+    free(work);
+    if (g->failed) return false;
+
+    r->order = malloc((g->len + 1) * sizeof(size_t));
+    if (!r->order) { fprintf(stderr, "gen-c: out of memory\n"); exit(1); }
+    r->count = 0;
+    for (size_t ip = 0; ip < g->len; ip++) {
+        if (r->reach[ip]) r->order[r->count++] = ip;
+    }
+
+    // Arrays nest in address order
+    size_t stack[64];
+    int sp = 0;
+    size_t prev_end = 0;
+    for (size_t i = 0; i < r->count; i++) {
+        size_t ip = r->order[i], ilen;
+        if (ip < prev_end) {
+            gen_fail(g, "instructions overlap at 0x%zx", ip);
+            return false;
+        }
+        gen_insn_len(g, ip, &ilen);
+        prev_end = ip + ilen;
+        uint8_t op = g->bc[ip];
+        r->loop_of[ip] = sp > 0 ? stack[sp - 1] + 1 : 0;
+        if (is_array(op)) {
+            if (sp == 64) { gen_fail(g, "arrays nested too deeply"); return false; }
+            stack[sp++] = ip;
+        } else if (op == OP_ARR_END) {
+            if (sp == 0) { gen_fail(g, "OP_ARR_END without an array at 0x%zx", ip); return false; }
+            r->arr_end[stack[--sp]] = ip;
+        }
+    }
+    if (sp != 0) {
+        gen_fail(g, "array at 0x%zx has no OP_ARR_END", stack[sp - 1]);
+        return false;
+    }
+    return true;
+}
+
+static bool gen_check_boundary(gen_ctx* g, const gen_state* st, size_t ip) {
+    if (st->sp != 0 || st->trans != GT_NONE || st->optional) {
+        gen_fail(g, "control flow at 0x%zx with a pending expression, transform or @optional", ip);
+        return false;
+    }
+    return true;
+}
+
+static bool gen_merge(gen_ctx* g, gen_flow* into, uint8_t* has, const gen_flow* from, size_t ip) {
+    if (!*has) {
+        *into = *from;
+        *has = 1;
+        return true;
+    }
+    if (into->endian != from->endian) {
+        gen_fail(g, "byte order differs between paths joining at 0x%zx", ip);
+        return false;
+    }
+    if (into->bitpos != from->bitpos) into->bitpos = -1;
+    return true;
+}
+
+// Records a forward goto from `src` to `target` and returns its label
+static bool gen_goto_label(gen_ctx* g, gen_region* r, const gen_state* st, size_t src, size_t target,
+                           char* label, size_t n) {
+    if (!gen_check_boundary(g, st, src)) return false;
+    if (target <= src) {
+        gen_fail(g, "backward jump at 0x%zx is not supported", src);
+        return false;
+    }
+    if (r->loop_of[src] != r->loop_of[target]) {
+        gen_fail(g, "jump at 0x%zx crosses an array boundary", src);
+        return false;
+    }
+    if (!gen_merge(g, &r->lflow[target], &r->lhas[target], &st->f, target)) return false;
+    r->refs[target]++;
+    snprintf(label, n, "L%d_%zx", r->id, target);
+    return true;
+}
+
+// --- Fields ---
+
+static void gen_align(gen_ctx* g, gen_state* st) {
+    if (st->f.bitpos != 0) {
+        gen_line(g, "if (bit) { cur++; bit = 0; }");
+        st->f.bitpos = 0;
+    }
+}
+
+// The (transformed) member type of a primitive field
+static const char* gen_prim_ctype(uint8_t type, int trans) {
+    if (trans == GT_NONE) return io_ctype(type);
+    if (trans == GT_SCALE) return "double";
+    if (trans == GT_POLY || trans == GT_SPLINE) return io_is_float(type) ? "int64_t" : "double";
+    return "int64_t";
+}
+
+// A plain primitive field at cur + off, already bounds checked
+static void gen_plain_field(gen_ctx* g, uint8_t type, uint16_t key, uint32_t off, int endian) {
+    char m[256], at[32], e[320];
+    if (gen_field(g, key, NODE_VALUE, io_ctype(type), 0, false, m, sizeof(m)) < 0) return;
+    gen_at(at, sizeof(at), off);
+    if (g->encode) {
+        gen_store(g, type, endian, at, m);
+    } else {
+        gen_load(e, sizeof(e), type, endian, at);
+        gen_line(g, "%s = %s;", m, e);
+    }
+    g->last_io.valid = true;
+    g->last_io.type = type;
+    snprintf(g->last_io.expr, sizeof(g->last_io.expr), "%s", m);
+}
+
+// Consecutive plain fields share one bounds check
+static void gen_run(gen_ctx* g, gen_state* st, const uint8_t* types, const uint16_t* keys, int n) {
+    gen_align(g, st);
+    uint32_t total = 0;
+    for (int i = 0; i < n; i++) total += il_type_size(types[i]);
+    gen_line(g, "if (cur + %u > len) return CND_GEN_ERR_OOB;", (unsigned)total);
+    uint32_t off = 0;
+    for (int i = 0; i < n && !g->failed; i++) {
+        gen_plain_field(g, types[i], keys[i], off, st->f.endian);
+        off += il_type_size(types[i]);
+    }
+    gen_line(g, "cur += %u;", (unsigned)total);
+}
+
+// A primitive field with a transform, @optional or bool validation
+static void gen_prim(gen_ctx* g, gen_state* st, uint8_t type, uint16_t key) {
+    uint32_t size = il_type_size(type);
+    gen_align(g, st);
+
+    bool optional = st->optional;
+    st->optional = false;
+    int trans = GT_NONE;
+    if (type != OP_IO_BOOL) {
+        trans = st->trans;
+        st->trans = GT_NONE;
+    }
+    const char* ctype = gen_prim_ctype(type, trans);
+    char m[256];
+    if (gen_field(g, key, NODE_VALUE, ctype, 0, type == OP_IO_BOOL, m, sizeof(m)) < 0) return;
+
+    if (optional) {
+        // A missing optional field is reported as zero and skipped
+        if (g->encode) {
+            gen_line(g, "if (cur + %u <= len) {", (unsigned)size);
+        } else {
+            gen_line(g, "if (cur + %u > len) {", (unsigned)size);
+            gen_line(g, "    %s = 0;", m);
+            gen_line(g, "} else {");
+        }
+        g->indent += 4;
+    } else {
+        gen_line(g, "if (cur + %u > len) return CND_GEN_ERR_OOB;", (unsigned)size);
+    }
+
+    const char* raw_ctype = io_ctype(type);
+    char ld[128], e[512], fac[48], off[48];
+    gen_load(ld, sizeof(ld), type, st->f.endian, "cur");
+    gen_dbl(fac, sizeof(fac), st->fac);
+    gen_dbl(off, sizeof(off), st->off);
+    char curve[32];
+    snprintf(curve, sizeof(curve), "cg_curve%d, %d", st->curve, st->curve_n);
+    int64_t k = st->k;
+
+    if (g->encode) {
+        switch (trans) {
+            case GT_NONE:
+                if (type == OP_IO_BOOL) gen_line(g, "if (%s > 1) return CND_GEN_ERR_VALIDATION;", m);
+                snprintf(e, sizeof(e), "%s", m);
+                break;
+            case GT_SCALE:
+                if (st->off == 0) snprintf(e, sizeof(e), "(%s)(%s / %s)", raw_ctype, m, fac);
+                else snprintf(e, sizeof(e), "(%s)((%s - %s) / %s)", raw_ctype, m, off, fac);
+                break;
+            case GT_POLY:
+            case GT_SPLINE:
+                if (io_is_float(type)) snprintf(e, sizeof(e), "(%s)%s", raw_ctype, m);
+                else snprintf(e, sizeof(e), "(%s)cg_%s_solve(%s, %s)", raw_ctype,
+                              trans == GT_POLY ? "poly" : "spline", curve, m);
+                break;
+            case GT_ADD: snprintf(e, sizeof(e), "(%s)(%s - INT64_C(%" PRId64 "))", raw_ctype, m, k); break;
+            case GT_SUB: snprintf(e, sizeof(e), "(%s)(%s + INT64_C(%" PRId64 "))", raw_ctype, m, k); break;
+            case GT_MUL:
+                if (k != 0) snprintf(e, sizeof(e), "(%s)(%s / INT64_C(%" PRId64 "))", raw_ctype, m, k);
+                else snprintf(e, sizeof(e), "(%s)%s", raw_ctype, m);
+                break;
+            case GT_DIV: snprintf(e, sizeof(e), "(%s)(%s * INT64_C(%" PRId64 "))", raw_ctype, m, k); break;
+            default: e[0] = '\0'; break;
+        }
+        gen_store(g, type, st->f.endian, "cur", e);
+    } else {
+        switch (trans) {
+            case GT_NONE:
+                if (type == OP_IO_BOOL) gen_line(g, "if (buf[cur] > 1) return CND_GEN_ERR_VALIDATION;");
+                snprintf(e, sizeof(e), "%s", ld);
+                break;
+            case GT_SCALE: snprintf(e, sizeof(e), "(double)%s * %s + %s", ld, fac, off); break;
+            case GT_POLY:
+            case GT_SPLINE:
+                if (io_is_float(type)) snprintf(e, sizeof(e), "(int64_t)%s", ld);
+                else snprintf(e, sizeof(e), "cg_%s_eval(%s, (double)%s)",
+                              trans == GT_POLY ? "poly" : "spline", curve, ld);
+                break;
+            case GT_ADD: snprintf(e, sizeof(e), "(int64_t)%s + INT64_C(%" PRId64 ")", ld, k); break;
+            case GT_SUB: snprintf(e, sizeof(e), "(int64_t)%s - INT64_C(%" PRId64 ")", ld, k); break;
+            case GT_MUL: snprintf(e, sizeof(e), "(int64_t)%s * INT64_C(%" PRId64 ")", ld, k); break;
+            case GT_DIV:
+                if (k != 0) snprintf(e, sizeof(e), "(int64_t)%s / INT64_C(%" PRId64 ")", ld, k);
+                else snprintf(e, sizeof(e), "(int64_t)%s", ld);
+                break;
+            default: e[0] = '\0'; break;
+        }
+        gen_line(g, "%s = %s;", m, e);
+    }
+    gen_line(g, "cur += %u;", (unsigned)size);
+
+    if (optional) {
+        g->indent -= 4;
+        gen_line(g, "}");
+    } else if (trans == GT_NONE) {
+        g->last_io.valid = true;
+        g->last_io.type = type;
+        snprintf(g->last_io.expr, sizeof(g->last_io.expr), "%s", m);
+    }
+}
+
+// Length-prefixed (prefix bytes `w`) or NUL-terminated (w == 0) strings
+static void gen_string(gen_ctx* g, gen_state* st, uint16_t key, uint32_t w, uint16_t max_len) {
+    gen_align(g, st);
+    st->optional = false;
+    g->uses_s = true;
+    if (w != 0) g->uses_max_string = true;
+    char m[256];
+    if (gen_field(g, key, NODE_STRING, NULL, w == 0 ? max_len : 0, false, m, sizeof(m)) < 0) return;
+    const char* e = st->f.endian == CND_BE ? "be" : "le";
+
+    if (g->encode) {
+        gen_line(g, "s = cg_strlen(%s, sizeof(%s));", m, m);
+        gen_line(g, "if (s == sizeof(%s)) return CND_GEN_ERR_VALIDATION;", m);
+        if (w == 0) {
+            gen_line(g, "if (cur + s + 1 > len) return CND_GEN_ERR_OOB;");
+            gen_line(g, "memcpy(buf + cur, %s, s);", m);
+            gen_line(g, "buf[cur + s] = 0;");
+            gen_line(g, "cur += s + 1;");
+            return;
+        }
+        if (w == 1) gen_line(g, "if (s > 0xFF) s = 0xFF;");
+        if (w == 2) gen_line(g, "if (s > 0xFFFF) s = 0xFFFF;");
+        gen_line(g, "if (cur + %u + s > len) return CND_GEN_ERR_OOB;", (unsigned)w);
+        if (w == 1) gen_line(g, "buf[cur] = (uint8_t)s;");
+        else gen_line(g, "cg_st%u%s(buf + cur, (uint%u_t)s);", (unsigned)w * 8, e, (unsigned)w * 8);
+        gen_line(g, "memcpy(buf + cur + %u, %s, s);", (unsigned)w, m);
+        gen_line(g, "cur += %u + s;", (unsigned)w);
+        return;
+    }
+
+    // Decoded strings longer than the member are truncated, as cnd_bind_io does
+    if (w == 0) {
+        gen_line(g, "s = cg_strnul(buf, len, cur, %u);", (unsigned)max_len);
+        gen_line(g, "if (cur + s >= len) return CND_GEN_ERR_OOB;");
+        gen_line(g, "cg_copy_str(%s, sizeof(%s), buf + cur, s);", m, m);
+        gen_line(g, "cur += s + 1;");
+        return;
+    }
+    char ld[64];
+    gen_load_bits(ld, sizeof(ld), w, st->f.endian, "cur");
+    gen_line(g, "if (cur + %u > len) return CND_GEN_ERR_OOB;", (unsigned)w);
+    gen_line(g, "s = %s;", ld);
+    gen_line(g, "if (cur + %u + s > len) return CND_GEN_ERR_OOB;", (unsigned)w);
+    gen_line(g, "cg_copy_str(%s, sizeof(%s), buf + cur + %u, s);", m, m, (unsigned)w);
+    gen_line(g, "cur += %u + s;", (unsigned)w);
+}
+
+static void gen_raw_bytes(gen_ctx* g, gen_state* st, uint16_t key, uint32_t count) {
+    gen_align(g, st);
+    char m[256];
+    if (gen_field(g, key, NODE_BYTES, NULL, count, false, m, sizeof(m)) < 0) return;
+    gen_line(g, "if (cur + %" PRIu32 "u > len) return CND_GEN_ERR_OOB;", count);
+    if (g->encode) gen_line(g, "memcpy(buf + cur, %s, %" PRIu32 "u);", m, count);
+    else gen_line(g, "memcpy(%s, buf + cur, %" PRIu32 "u);", m, count);
+    gen_line(g, "cur += %" PRIu32 "u;", count);
+}
+
+// Bitfields: fields of one OP_IO_BIT_GROUP, or a single OP_IO_BIT_*
+typedef struct {
+    uint8_t type;
+    uint16_t key;
+    uint8_t width;
+} gen_bitfield;
+
+static const char* bitfield_ctype(const gen_bitfield* f) {
+    if (f->type == OP_IO_BIT_BOOL) return "uint8_t";
+    return bits_ctype(f->width, f->type == OP_IO_BIT_I);
+}
+
+static void gen_bits_value(char* out, size_t n, const gen_bitfield* f, const char* bits) {
+    if (f->type == OP_IO_BIT_I) snprintf(out, n, "(%s)cg_sext(%s, %u)", bitfield_ctype(f), bits, (unsigned)f->width);
+    else snprintf(out, n, "(%s)(%s)", bitfield_ctype(f), bits);
+}
+
+static uint64_t width_mask(unsigned w) {
+    return w >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << w) - 1);
+}
+
+static void gen_bits(gen_ctx* g, gen_state* st, const gen_bitfield* fields, int n) {
+    g->uses_bit = true;
+    int be = st->f.endian == CND_BE;
+    char m[CND_MAX_BIT_GROUP][256];
+    unsigned total = 0;
+    for (int i = 0; i < n; i++) {
+        if (gen_field(g, fields[i].key, NODE_VALUE, bitfield_ctype(&fields[i]), 0,
+                      fields[i].type == OP_IO_BIT_BOOL, m[i], sizeof(m[i])) < 0) return;
+        total += fields[i].width;
+    }
+    if (st->f.bitpos >= 0) st->f.bitpos = (int)((st->f.bitpos + total) % 8);
+
+    if (g->encode) {
+        for (int i = 0; i < n; i++) {
+            if (fields[i].type == OP_IO_BIT_BOOL) gen_line(g, "if (%s > 1) return CND_GEN_ERR_VALIDATION;", m[i]);
+        }
+        if (total > 64 || n == 1) {
+            for (int i = 0; i < n; i++) {
+                gen_line(g, "cg_put_bits(buf, len, &cur, &bit, (uint64_t)%s, %u, %d);", m[i],
+                         (unsigned)fields[i].width, be);
+            }
+            return;
+        }
+        // One word, first field in the low bits (LE) or the high bits (BE)
+        gen_buf word = {0};
+        unsigned shift = 0;
+        for (int i = 0; i < n; i++) {
+            unsigned w = fields[i].width;
+            unsigned at = be ? total - shift - w : shift;
+            gb_printf(&word, "%s((uint64_t)%s & UINT64_C(0x%" PRIX64 "))", i ? " | " : "", m[i], width_mask(w));
+            if (at) gb_printf(&word, " << %u", at);
+            shift += w;
+        }
+        gen_line(g, "cg_put_bits(buf, len, &cur, &bit, %s, %u, %d);", word.data, total, be);
+        gb_free(&word);
+        return;
+    }
+
+    if (total > 64 || n == 1) {
+        for (int i = 0; i < n; i++) {
+            char bits[96], v[160];
+            snprintf(bits, sizeof(bits), "cg_get_bits(buf, len, &cur, &bit, %u, %d)", (unsigned)fields[i].width, be);
+            gen_bits_value(v, sizeof(v), &fields[i], bits);
+            gen_line(g, "%s = %s;", m[i], v);
+        }
+        return;
+    }
+
+    gen_val word = gen_temp(g, GV_U, NULL);
+    if (be) {
+        // Past the end of the buffer, big-endian groups read field by field
+        gen_line(g, "if (!cg_bits_fit(len, cur, bit, %u)) {", total);
+        g->indent += 4;
+        for (int i = 0; i < n; i++) {
+            char bits[96], v[160];
+            snprintf(bits, sizeof(bits), "cg_get_bits(buf, len, &cur, &bit, %u, 1)", (unsigned)fields[i].width);
+            gen_bits_value(v, sizeof(v), &fields[i], bits);
+            gen_line(g, "%s = %s;", m[i], v);
+        }
+        g->indent -= 4;
+        gen_line(g, "} else {");
+        g->indent += 4;
+    }
+    gen_line(g, "%s = cg_get_bits(buf, len, &cur, &bit, %u, %d);", word.name, total, be);
+    unsigned shift = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned w = fields[i].width;
+        unsigned at = be ? total - shift - w : shift;
+        char bits[128], v[192];
+        if (at) snprintf(bits, sizeof(bits), "(%s >> %u) & UINT64_C(0x%" PRIX64 ")", word.name, at, width_mask(w));
+        else snprintf(bits, sizeof(bits), "%s & UINT64_C(0x%" PRIX64 ")", word.name, width_mask(w));
+        gen_bits_value(v, sizeof(v), &fields[i], bits);
+        gen_line(g, "%s = %s;", m[i], v);
+        shift += w;
+    }
+    if (be) {
+        g->indent -= 4;
+        gen_line(g, "}");
+    }
+}
+
+// --- Checks ---
+
+// The value of `type` ending at the cursor, unsigned at its stored width
+// (`as_bits`) or typed: the last field's member when it is that field
+static void gen_check_value(gen_ctx* g, const gen_state* st, uint8_t type, bool as_bits, char* out, size_t n) {
+    uint32_t size = il_type_size(type);
+    if (g->last_io.valid && il_type_size(g->last_io.type) == size &&
+        (as_bits || g->last_io.type == type)) {
+        if (as_bits) snprintf(out, n, "(uint%u_t)%s", (unsigned)size * 8, g->last_io.expr);
+        else snprintf(out, n, "%s", g->last_io.expr);
+        return;
+    }
+    char at[16];
+    snprintf(at, sizeof(at), "cur - %u", (unsigned)size);
+    gen_line(g, "if (cur < %u) return CND_GEN_ERR_OOB;", (unsigned)size);
+    if (as_bits) gen_load_bits(out, n, size, st->f.endian, at);
+    else gen_load(out, n, type, st->f.endian, at);
+}
+
+static void gen_range_check(gen_ctx* g, const gen_state* st, uint8_t type, uint64_t lo, uint64_t hi) {
+    char v[300], a[64], b[64];
+    gen_check_value(g, st, type, false, v, sizeof(v));
+    if (type == OP_IO_F32 || type == OP_IO_F64) {
+        double dlo, dhi;
+        if (type == OP_IO_F32) {
+            uint32_t l = (uint32_t)lo, h = (uint32_t)hi;
+            float fl, fh;
+            memcpy(&fl, &l, 4);
+            memcpy(&fh, &h, 4);
+            dlo = fl;
+            dhi = fh;
+        } else {
+            dlo = bits_to_dbl(lo);
+            dhi = bits_to_dbl(hi);
+        }
+        gen_dbl(a, sizeof(a), dlo);
+        gen_dbl(b, sizeof(b), dhi);
+        const char* cast = type == OP_IO_F32 ? "(float)" : "";
+        gen_line(g, "if (%s < %s%s || %s > %s%s) return CND_GEN_ERR_VALIDATION;", v, cast, a, v, cast, b);
+        return;
+    }
+
+    uint32_t size = il_type_size(type);
+    uint64_t mask = width_mask(size * 8);
+    bool check_lo, check_hi;
+    if (io_is_signed(type)) {
+        uint64_t sign = (uint64_t)1 << (size * 8 - 1);
+        check_lo = (lo & mask) != sign;
+        check_hi = (hi & mask) != sign - 1;
+    } else {
+        check_lo = (lo & mask) != 0;
+        check_hi = (hi & mask) != mask;
+    }
+    gen_int_lit(a, sizeof(a), type, lo & mask);
+    gen_int_lit(b, sizeof(b), type, hi & mask);
+    if (check_lo && check_hi) gen_line(g, "if (%s < %s || %s > %s) return CND_GEN_ERR_VALIDATION;", v, a, v, b);
+    else if (check_lo) gen_line(g, "if (%s < %s) return CND_GEN_ERR_VALIDATION;", v, a);
+    else if (check_hi) gen_line(g, "if (%s > %s) return CND_GEN_ERR_VALIDATION;", v, b);
+}
+
+// Enum checks of every encoding become one switch over the allowed values
+static void gen_enum_check(gen_ctx* g, gen_state* st, uint8_t type, const uint64_t* values, size_t count) {
+    if (type == OP_IO_BOOL || io_is_float(type) || il_type_size(type) == 0) {
+        gen_fail(g, "enum check on a non-integer type");
+        return;
+    }
+    gen_align(g, st);
+    char v[300];
+    gen_check_value(g, st, type, true, v, sizeof(v));
+    gen_line(g, "switch (%s) {", v);
+    for (size_t i = 0; i < count; i++) {
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; j++) seen = values[j] == values[i];
+        if (!seen) gen_line(g, "case UINT64_C(%" PRIu64 "):", values[i]);
+    }
+    if (count > 0) gen_line(g, "    break;");
+    gen_line(g, "default:");
+    gen_line(g, "    return CND_GEN_ERR_VALIDATION;");
+    gen_line(g, "}");
+}
+
+// Decodes the value list of OP_ENUM_CHECK / OP_ENUM_SORTED / OP_ENUM_BITMAP
+// at `p` (after the opcode) and emits the check. Returns the operand length.
+static size_t gen_enum_insn(gen_ctx* g, gen_state* st, uint8_t op, const uint8_t* p, size_t avail) {
+    uint8_t type = p[0];
+    uint32_t size = il_type_size(type);
+    if (size == 0) { gen_fail(g, "enum check with invalid type"); return 0; }
+    uint64_t* values = NULL;
+    size_t count = 0, used;
+    if (op == OP_ENUM_BITMAP) {
+        if (avail < 3 + (size_t)size) { gen_fail(g, "truncated enum check"); return 0; }
+        uint64_t base = size == 1 ? p[1] : size == 2 ? il_get_u16(p + 1) : size == 4 ? il_get_u32(p + 1) : il_get_u64(p + 1);
+        uint16_t span = il_get_u16(p + 1 + size);
+        used = 3 + size + ((size_t)span + 7) / 8;
+        if (avail < used) { gen_fail(g, "truncated enum check"); return 0; }
+        const uint8_t* bits = p + 3 + size;
+        values = malloc(((size_t)span + 1) * sizeof(uint64_t));
+        for (uint32_t i = 0; i < span; i++) {
+            if (bits[i >> 3] & (1u << (i & 7))) values[count++] = (base + i) & width_mask(size * 8);
+        }
+    } else {
+        if (avail < 3) { gen_fail(g, "truncated enum check"); return 0; }
+        count = il_get_u16(p + 1);
+        used = 3 + count * size;
+        if (avail < used) { gen_fail(g, "truncated enum check"); return 0; }
+        values = malloc((count + 1) * sizeof(uint64_t));
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t* v = p + 3 + i * size;
+            values[i] = size == 1 ? v[0] : size == 2 ? il_get_u16(v) : size == 4 ? il_get_u32(v) : il_get_u64(v);
+        }
+    }
+    gen_enum_check(g, st, type, values, count);
+    free(values);
+    return used;
+}
+
+static uint64_t il_sized(const uint8_t* p, uint32_t size) {
+    if (size == 1) return p[0];
+    if (size == 2) return il_get_u16(p);
+    if (size == 4) return il_get_u32(p);
+    return il_get_u64(p);
+}
+
+// --- File Scope Helpers ---
+
+static int gen_curve(gen_ctx* g, size_t ip, const uint8_t* data, int count, int doubles_per) {
+    for (int i = 0; i < g->curve_count; i++) {
+        if (g->curve_ips[i] == ip) return i;
+    }
+    int id = g->curve_count++;
+    g->curve_ips = realloc(g->curve_ips, (size_t)g->curve_count * sizeof(size_t));
+    if (!g->curve_ips) { fprintf(stderr, "gen-c: out of memory\n"); exit(1); }
+    g->curve_ips[id] = ip;
+
+    int n = count * doubles_per;
+    gb_printf(&g->statics, "static const double cg_curve%d[%d] = {", id, n > 0 ? n : 1);
+    for (int i = 0; i < n; i++) {
+        char d[48];
+        gen_dbl(d, sizeof(d), bits_to_dbl(il_get_u64(data + (size_t)i * 8)));
+        gb_printf(&g->statics, "%s%s", i ? ", " : " ", d);
+    }
+    gb_printf(&g->statics, "%s };\n", n > 0 ? "" : " 0.0");
+    return id;
+}
+
+static int gen_crc_fn(gen_ctx* g, uint32_t poly, uint32_t init, uint32_t xorout, uint8_t flags, int width) {
+    flags &= 3;
+    for (int i = 0; i < g->crc_count; i++) {
+        const gen_crc* c = &g->crcs[i];
+        if (c->poly == poly && c->init == init && c->xorout == xorout && c->flags == flags && c->width == width) return i;
+    }
+    if (g->crc_count == (int)(sizeof(g->crcs) / sizeof(g->crcs[0]))) {
+        gen_fail(g, "too many CRC configurations");
+        return 0;
+    }
+    int id = g->crc_count++;
+    gen_crc* c = &g->crcs[id];
+    c->poly = poly;
+    c->init = init;
+    c->xorout = xorout;
+    c->flags = flags;
+    c->width = width;
+
+    // The running register as vm_crc_start/update/finish keep it: reflected
+    // in the low bits, or left-aligned in 32 bits
+    gen_buf* s = &g->statics;
+    gb_printf(s, "\nstatic uint32_t cg_crc%d(const uint8_t* d, size_t n)\n{\n", id);
+    gb_printf(s, "    static const uint32_t t[256] = {");
+    for (int b = 0; b < 256; b++) {
+        uint8_t byte = (uint8_t)b;
+        uint32_t v = vm_crc_update(0, &byte, 1, poly, flags, width);
+        gb_printf(s, "%s0x%08" PRIX32 "u%s", b % 8 == 0 ? "\n        " : "", v, b < 255 ? ", " : "");
+    }
+    gb_printf(s, "\n    };\n");
+    gb_printf(s, "    uint32_t c = 0x%08" PRIX32 "u;\n", vm_crc_start(poly, init, flags, width));
+    gb_printf(s, "    size_t i;\n");
+    if (flags & 1) gb_printf(s, "    for (i = 0; i < n; i++) c = (c >> 8) ^ t[(c ^ d[i]) & 0xFF];\n");
+    else gb_printf(s, "    for (i = 0; i < n; i++) c = (c << 8) ^ t[((c >> 24) ^ d[i]) & 0xFF];\n");
+    if (flags & 1) {
+        if (!(flags & 2)) gb_printf(s, "    c = cg_reflect(c, %d);\n", width);
+    } else {
+        gb_printf(s, "    c >>= %d;\n", 32 - width);
+        if (flags & 2) gb_printf(s, "    c = cg_reflect(c, %d);\n", width);
+    }
+    gb_printf(s, "    return (c ^ 0x%08" PRIX32 "u) & 0x%08" PRIX32 "u;\n}\n",
+              xorout, width == 32 ? 0xFFFFFFFFu : 0xFFFFu);
+    return id;
+}
+
+// --- Instructions ---
+
+static bool gen_emit_region(gen_ctx* g, size_t entry, gen_state* st, bool top, bool* returns);
+
+static void gen_loop_open(gen_ctx* g, gen_region* r, gen_state* st, size_t ip, bool* live) {
+    uint8_t op = g->bc[ip];
+    uint16_t key = (uint16_t)(il_get_u16(g->bc + ip + 1) + g->key_base);
+    size_t end_ip = r->arr_end[ip];
+    int d = g->depth;
+    if (d >= CND_MAX_LOOP_DEPTH) { gen_fail(g, "arrays nested deeper than %d", CND_MAX_LOOP_DEPTH); return; }
+    if (!gen_check_boundary(g, st, ip)) return;
+    gen_align(g, st);
+
+    gen_loop loop;
+    memset(&loop, 0, sizeof(loop));
+    loop.key = key;
+    loop.eof = (op == OP_ARR_EOF);
+    if (op == OP_ARR_FIXED) {
+        loop.fixed = true;
+        loop.count = il_get_u32(g->bc + ip + 3);
+    }
+    char cap[sizeof(g->upper) + sizeof("_MAX_ARRAY")], m[256], label[48];
+    gen_cap_expr(g, &loop, cap, sizeof(cap));
+    if (g->depth + 1 > g->max_depth) g->max_depth = g->depth + 1;
+    if (!loop.fixed) g->var_count[d] = true;
+
+    // Element count in nD, the member it is kept in for prefixed and EOF arrays
+    const char* count_ctype = op == OP_ARR_PRE_U8 ? "uint8_t" : op == OP_ARR_PRE_U16 ? "uint16_t" : "uint32_t";
+    bool counted = (op == OP_ARR_PRE_U8 || op == OP_ARR_PRE_U16 || op == OP_ARR_PRE_U32 || op == OP_ARR_EOF);
+    if (counted) {
+        int node = gen_member(g, key, "_count", false, m, sizeof(m));
+        if (node < 0 || !gen_leaf(g, node, NODE_VALUE, count_ctype, 0, false)) return;
+    }
+
+    if (op == OP_ARR_PRE_U8 || op == OP_ARR_PRE_U16 || op == OP_ARR_PRE_U32) {
+        uint32_t w = op == OP_ARR_PRE_U8 ? 1 : op == OP_ARR_PRE_U16 ? 2 : 4;
+        if (g->encode) {
+            gen_line(g, "n%d = %s;", d, m);
+            gen_line(g, "if (n%d > %s) return CND_GEN_ERR_VALIDATION;", d, cap);
+            gen_line(g, "if (cur + %u > len) return CND_GEN_ERR_OOB;", (unsigned)w);
+            if (w == 1) gen_line(g, "buf[cur] = (uint8_t)n%d;", d);
+            else gen_line(g, "cg_st%u%s(buf + cur, (uint%u_t)n%d);", (unsigned)w * 8,
+                          st->f.endian == CND_BE ? "be" : "le", (unsigned)w * 8, d);
+        } else {
+            char ld[64];
+            gen_load_bits(ld, sizeof(ld), w, st->f.endian, "cur");
+            gen_line(g, "if (cur + %u > len) return CND_GEN_ERR_OOB;", (unsigned)w);
+            gen_line(g, "n%d = %s;", d, ld);
+            gen_line(g, "if (n%d > %s) return CND_GEN_ERR_VALIDATION;", d, cap);
+            gen_line(g, "%s = (%s)n%d;", m, count_ctype, d);
+        }
+        gen_line(g, "cur += %u;", (unsigned)w);
+    } else if (op == OP_ARR_DYNAMIC) {
+        uint16_t ref = (uint16_t)(il_get_u16(g->bc + ip + 3) + g->key_base);
+        gen_val count = gen_ctx_value(g, ref);
+        char u[64];
+        gen_u(&count, u, sizeof(u));
+        gen_line(g, "if (%s > 0xFFFFFFFFu) return CND_GEN_ERR_ARITHMETIC;", u);
+        gen_line(g, "n%d = (uint32_t)%s;", d, u);
+        gen_line(g, "if (n%d > %s) return CND_GEN_ERR_VALIDATION;", d, cap);
+    } else if (op == OP_ARR_EOF && g->encode) {
+        // Encoding writes the elements the count member holds, where the
+        // interpreter keeps asking the host until the buffer is full
+        gen_line(g, "n%d = %s;", d, m);
+        gen_line(g, "if (n%d > %s) return CND_GEN_ERR_VALIDATION;", d, cap);
+    }
+
+    // Body of one primitive element: a single bounds check and a loop
+    size_t body = ip + 0;
+    size_t ilen;
+    gen_insn_len(g, ip, &ilen);
+    body = ip + ilen;
+    uint8_t elem = body < g->len ? g->bc[body] : 0;
+    size_t elem_len = 0;
+    if (is_plain_io(elem)) gen_insn_len(g, body, &elem_len);
+    if (is_plain_io(elem) && r->reach[body] && body + elem_len == end_ip && r->refs[body] == 0 &&
+        r->refs[end_ip] == 0 && (uint16_t)(il_get_u16(g->bc + body + 1) + g->key_base) == key &&
+        st->trans == GT_NONE && !st->optional) {
+        uint32_t size = il_type_size(elem);
+        g->loops[g->depth++] = loop;
+        char em[256], ld[128], at[64], n[48];
+        int node = gen_field(g, key, NODE_VALUE, io_ctype(elem), 0, false, em, sizeof(em));
+        g->depth--;
+        if (node < 0) return;
+        if (loop.fixed) snprintf(n, sizeof(n), "%" PRIu32 "u", loop.count);
+        else snprintf(n, sizeof(n), "n%d", d);
+
+        if (op == OP_ARR_EOF && !g->encode) {
+            g->uses_s = true;
+            gen_line(g, "s = cur < len ? len - cur : 0;");
+            if (size > 1) gen_line(g, "if (s %% %u != 0) return CND_GEN_ERR_OOB;", (unsigned)size);
+            gen_line(g, "n%d = (uint32_t)(s / %u);", d, (unsigned)size);
+            gen_line(g, "if (n%d > %s) return CND_GEN_ERR_VALIDATION;", d, cap);
+        }
+        gen_line(g, "if (cur + (size_t)%s * %u > len) return CND_GEN_ERR_OOB;", n, (unsigned)size);
+        if (size == 1 && !(elem == OP_IO_I8 && !g->encode)) {
+            // The element member without its index is the array
+            char arr[256];
+            snprintf(arr, sizeof(arr), "%s", em);
+            char* idx = strrchr(arr, '[');
+            if (idx) *idx = '\0';
+            if (g->encode) gen_line(g, "memcpy(buf + cur, %s, %s);", arr, n);
+            else gen_line(g, "memcpy(%s, buf + cur, %s);", arr, n);
+        } else {
+            g->uses_i[d] = true;
+            snprintf(at, sizeof(at), "cur + (size_t)i%d * %u", d, (unsigned)size);
+            gen_line(g, "for (i%d = 0; i%d < %s; i%d++) {", d, d, n, d);
+            g->indent += 4;
+            if (g->encode) {
+                gen_store(g, elem, st->f.endian, at, em);
+            } else {
+                gen_load(ld, sizeof(ld), elem, st->f.endian, at);
+                gen_line(g, "%s = %s;", em, ld);
+            }
+            g->indent -= 4;
+            gen_line(g, "}");
+        }
+        gen_line(g, "cur += (size_t)%s * %u;", n, (unsigned)size);
+        if (op == OP_ARR_EOF && !g->encode) gen_line(g, "%s = n%d;", m, d);
+        // Continue after the OP_ARR_END
+        r->refs[end_ip] = -1;
+        *live = true;
+        return;
+    }
+
+    g->uses_i[d] = true;
+    if (op == OP_ARR_EOF && !g->encode) {
+        gen_line(g, "i%d = 0;", d);
+        if (!gen_goto_label(g, r, st, ip, end_ip + 1, label, sizeof(label))) return;
+        gen_line(g, "if (cur >= len) goto %s;", label);
+    } else {
+        if (loop.fixed && loop.count == 0) {
+            if (!gen_goto_label(g, r, st, ip, end_ip + 1, label, sizeof(label))) return;
+            gen_line(g, "goto %s;", label);
+        } else if (!loop.fixed) {
+            if (!gen_goto_label(g, r, st, ip, end_ip + 1, label, sizeof(label))) return;
+            gen_line(g, "if (n%d == 0) goto %s;", d, label);
+        }
+        gen_line(g, "i%d = 0;", d);
+    }
+    gb_printf(g->out, "B%d_%zx: ;\n", r->id, ip);
+    if (op == OP_ARR_EOF && !g->encode) {
+        gen_line(g, "if (i%d >= %s) return CND_GEN_ERR_VALIDATION;", d, cap);
+    }
+    g->loops[g->depth++] = loop;
+    *live = true;
+}
+
+static void gen_loop_close(gen_ctx* g, gen_region* r, gen_state* st, size_t ip) {
+    if (g->depth == 0) { gen_fail(g, "OP_ARR_END outside an array at 0x%zx", ip); return; }
+    if (!gen_check_boundary(g, st, ip)) return;
+    gen_align(g, st);
+    int d = g->depth - 1;
+    const gen_loop* loop = &g->loops[d];
+
+    // The array opcode whose body this closes
+    size_t arr_ip = r->loop_of[ip] - 1;
+    if (st->f.endian != r->lflow[arr_ip].endian) {
+        gen_fail(g, "byte order differs between array iterations at 0x%zx", ip);
+        return;
+    }
+    if (loop->eof && !g->encode) {
+        gen_line(g, "i%d++;", d);
+        gen_line(g, "if (cur < len) goto B%d_%zx;", r->id, arr_ip);
+    } else if (loop->fixed) {
+        gen_line(g, "if (++i%d < %" PRIu32 "u) goto B%d_%zx;", d, loop->count, r->id, arr_ip);
+    } else {
+        gen_line(g, "if (++i%d < n%d) goto B%d_%zx;", d, d, r->id, arr_ip);
+    }
+    bool eof_decode = loop->eof && !g->encode;
+    uint16_t key = loop->key;
+    g->depth--;
+
+    // The exit label, merged with skips of the whole body
+    size_t next = ip + 1;
+    if (r->refs[next] > 0) {
+        if (!gen_merge(g, &r->lflow[next], &r->lhas[next], &st->f, next)) return;
+        st->f = r->lflow[next];
+        gb_printf(g->out, "L%d_%zx: ;\n", r->id, next);
+        r->refs[next] = 0;
+    }
+    if (eof_decode) {
+        char m[256];
+        int node = gen_member(g, key, "_count", false, m, sizeof(m));
+        if (node >= 0) gen_line(g, "%s = i%d;", m, d);
+    }
+}
+
+// The state flowing out of the array opcode at `ip`, for gen_loop_close
+static void gen_loop_mark(gen_region* r, const gen_state* st, size_t ip) {
+    r->lflow[ip] = st->f;
+}
+
+static void gen_crc_op(gen_ctx* g, gen_state* st, uint32_t poly, uint32_t init, uint32_t xorout, uint8_t flags, int width) {
+    gen_align(g, st);
+    if (g->pass == 0) g->has_crc = true;
+    int id = gen_crc_fn(g, poly, init, xorout, flags, width);
+    char call[160];
+    if (g->has_crc_marks && g->has_crc) {
+        g->uses_s = true;
+        gen_line(g, "s = crc_hi < cur ? crc_hi : cur;");
+        gen_line(g, "if (s < crc_lo) s = crc_lo;");
+        snprintf(call, sizeof(call), "(uint64_t)cg_crc%d(buf + crc_lo, s - crc_lo)", id);
+    } else {
+        snprintf(call, sizeof(call), "(uint64_t)cg_crc%d(buf, cur)", id);
+    }
+    gen_val crc = gen_temp(g, GV_U, call);
+    unsigned size = (unsigned)width / 8;
+    const char* e = st->f.endian == CND_BE ? "be" : "le";
+    gen_line(g, "if (cur + %u > len) return CND_GEN_ERR_OOB;", size);
+    if (g->encode) {
+        gen_line(g, "cg_st%u%s(buf + cur, (uint%u_t)%s);", size * 8, e, size * 8, crc.name);
+    } else {
+        gen_line(g, "if (cg_ld%u%s(buf + cur) != %s) return CND_GEN_ERR_CRC_MISMATCH;", size * 8, e, crc.name);
+    }
+    gen_line(g, "cur += %u;", size);
+}
+
+static void gen_emit(gen_ctx* g, gen_state* st, uint8_t type, const gen_val* v) {
+    uint32_t size = il_type_size(type);
+    if (size == 0) { gen_fail(g, "OP_EMIT of an invalid type"); return; }
+    char u[64], f[64], ld[128];
+    gen_u(v, u, sizeof(u));
+    gen_f(v, f, sizeof(f));
+    const char* e = st->f.endian == CND_BE ? "be" : "le";
+    gen_line(g, "if (cur + %u > len) return CND_GEN_ERR_OOB;", (unsigned)size);
+    if (g->encode) {
+        if (type == OP_IO_F32) gen_line(g, "cg_st32%s(buf + cur, cg_f32bits((float)%s));", e, f);
+        else if (size == 1) gen_line(g, "buf[cur] = (uint8_t)%s;", u);
+        else gen_line(g, "cg_st%u%s(buf + cur, (uint%u_t)%s);", (unsigned)size * 8, e, (unsigned)size * 8, u);
+    } else {
+        gen_load_bits(ld, sizeof(ld), size, st->f.endian, "cur");
+        if (type == OP_IO_F32) {
+            gen_line(g, "if (!cg_near_f32((float)%s, cg_f32(%s))) return CND_GEN_ERR_VALIDATION;", f, ld);
+        } else if (type == OP_IO_F64) {
+            gen_line(g, "if (!cg_near_f64(%s, cg_f64(%s))) return CND_GEN_ERR_VALIDATION;", f, ld);
+        } else {
+            gen_line(g, "if ((uint64_t)%s != %s) return CND_GEN_ERR_VALIDATION;", ld, u);
+        }
+    }
+    gen_line(g, "cur += %u;", (unsigned)size);
+}
+
+static void gen_store_ctx(gen_ctx* g, size_t ip, uint16_t key, const gen_val* v) {
+    char u[64], f[64], m[256];
+    gen_u(v, u, sizeof(u));
+    gen_f(v, f, sizeof(f));
+    if (g->stored[key] & GEN_KEY_LOCAL) gen_line(g, "v%u = %s;", (unsigned)key, u);
+    g->stored[key] |= GEN_KEY_STORED_NOW;
+
+    // The member takes the type of the OP_EMIT that usually follows
+    int node = gen_member(g, key, NULL, false, m, sizeof(m));
+    if (node < 0) return;
+    gen_node* c = &g->nodes[node];
+    if (c->kind == NODE_NEW || (g->pass == 0 && c->weak)) {
+        size_t next = ip + 3;
+        const char* ctype = v->kind == GV_F ? "double" : "uint64_t";
+        if (next + 1 < g->len && g->bc[next] == OP_EMIT && io_ctype(g->bc[next + 1])) ctype = io_ctype(g->bc[next + 1]);
+        c->kind = NODE_VALUE;
+        c->ctype = ctype;
+        c->is_bool = (next + 1 < g->len && g->bc[next] == OP_EMIT && g->bc[next + 1] == OP_IO_BOOL);
+        c->weak = false;
+    }
+    if (c->kind != NODE_VALUE) { gen_fail(g, "%s is stored but is not a number", c->name); return; }
+    if (!g->encode) {
+        if (ctype_is_float(c->ctype)) gen_line(g, "%s = (%s)%s;", m, c->ctype, f);
+        else gen_line(g, "%s = (%s)%s;", m, c->ctype, u);
+    }
+}
+
+// Register expressions (OP_EXPR) evaluate symbolically like the stack
+static void gen_expr(gen_ctx* g, gen_state* st, const uint8_t* code, size_t len) {
+    gen_val r[CND_EXPR_REGS], f[CND_EXPR_REGS];
+    for (int i = 0; i < CND_EXPR_REGS; i++) r[i] = f[i] = gen_const(0);
+    const uint8_t* p = code;
+    const uint8_t* end = code + len;
+
+    #define EXPR_REG(i) ((i) & (CND_EXPR_REGS - 1))
+    while (end - p >= 4 && !g->failed) {
+        uint8_t op = p[0];
+        int d = EXPR_REG(p[1]), a = EXPR_REG(p[2]);
+        gen_val rb = (p[1] & CND_EXPR_IMM) ? gen_const((uint64_t)(int64_t)(int8_t)p[3]) : r[EXPR_REG(p[3])];
+        switch (op) {
+            case OP_REG_LOAD:
+                r[d] = gen_ctx_value(g, (uint16_t)(il_get_u16(p + 2) + g->key_base));
+                break;
+            case OP_REG_IMM:
+                r[d] = gen_const((uint64_t)(int64_t)(int16_t)il_get_u16(p + 2));
+                break;
+            case OP_REG_CONST:
+            case OP_REG_FCONST:
+                if (end - p < 12) { gen_fail(g, "truncated register expression"); return; }
+                if (op == OP_REG_CONST) r[d] = gen_const(il_get_u64(p + 4));
+                else f[d] = gen_const(il_get_u64(p + 4));
+                p += 8;
+                break;
+            case OP_REG_ITOB: f[d] = r[a]; break;
+            case OP_REG_BTOI: r[d] = f[a]; break;
+            case OP_REG_RET:
+                gen_push(g, st, p[3] ? f[a] : r[a]);
+                return;
+            default: {
+                int arity = alu_arity(op);
+                if (arity == 0) { gen_fail(g, "unsupported register operation 0x%02X", op); return; }
+                gen_val x, y;
+                if (alu_float_args(op)) {
+                    x = f[a];
+                    y = f[EXPR_REG(p[3])];
+                } else {
+                    x = r[a];
+                    y = rb;
+                }
+                gen_val out = gen_alu(g, op, &x, &y);
+                if (alu_float_result(op)) f[d] = out;
+                else r[d] = out;
+                break;
+            }
+        }
+        p += 4;
+    }
+    #undef EXPR_REG
+    gen_fail(g, "register expression without OP_REG_RET");
+}
+
+static const char* gen_op_name(uint8_t op) {
+    static char buf[8];
+    snprintf(buf, sizeof(buf), "0x%02X", op);
+    return buf;
+}
+
+// Emits the instruction at r->order[*idx] (and those it absorbs), advancing
+// *idx. *live tells whether control reaches the next instruction.
+static void gen_insn(gen_ctx* g, gen_region* r, gen_state* st, size_t* idx, bool* live) {
+    size_t ip = r->order[*idx];
+    const uint8_t* p = g->bc + ip;
+    uint8_t op = p[0];
+    size_t ilen;
+    if (!gen_insn_len(g, ip, &ilen)) return;
+    if (ilen > g->len - ip) { gen_fail(g, "truncated instruction at 0x%zx", ip); return; }
+    size_t next = ip + ilen;
+    uint16_t key = ilen >= 3 ? (uint16_t)(il_get_u16(p + 1) + g->key_base) : 0;
+    bool keep_last = false;
+    (*idx)++;
+    *live = true;
+
+    switch (op) {
+        case OP_NOOP: case OP_ENTER_STRUCT: case OP_EXIT_STRUCT: case OP_META_VERSION:
+        case OP_CTX_QUERY: case OP_ENTER_BIT_MODE: case OP_IO_RUN: case OP_IO_CHECK: case OP_IO_SLOT:
+            keep_last = true;
+            break;
+        case OP_META_NAME:
+            if (g->pass == 0 && !g->named && key < g->str_count) {
+                snprintf(g->name, sizeof(g->name), "%s", g->strtab[key]);
+                g->named = true;
+            }
+            keep_last = true;
+            break;
+        case OP_SET_ENDIAN_LE: st->f.endian = CND_LE; keep_last = true; break;
+        case OP_SET_ENDIAN_BE: st->f.endian = CND_BE; keep_last = true; break;
+
+        case OP_IO_U8: case OP_IO_U16: case OP_IO_U32: case OP_IO_U64:
+        case OP_IO_I8: case OP_IO_I16: case OP_IO_I32: case OP_IO_I64:
+        case OP_IO_F32: case OP_IO_F64: {
+            if (st->trans != GT_NONE || st->optional) {
+                gen_prim(g, st, op, key);
+                return;
+            }
+            // Merge the plain fields that follow into one bounds check
+            uint8_t types[GEN_MAX_RUN];
+            uint16_t keys[GEN_MAX_RUN];
+            int n = 0;
+            types[n] = op;
+            keys[n++] = key;
+            size_t at = next;
+            while (*idx < r->count && n < GEN_MAX_RUN) {
+                size_t nip = r->order[*idx], nlen;
+                if (nip != at || r->refs[nip] != 0) break;
+                uint8_t nop = g->bc[nip];
+                if (!gen_insn_len(g, nip, &nlen)) return;
+                if (nop == OP_IO_RUN || nop == OP_IO_SLOT) {
+                    (*idx)++;
+                    at = nip + nlen;
+                    continue;
+                }
+                if (!is_plain_io(nop)) break;
+                types[n] = nop;
+                keys[n++] = (uint16_t)(il_get_u16(g->bc + nip + 1) + g->key_base);
+                (*idx)++;
+                at = nip + nlen;
+            }
+            gen_run(g, st, types, keys, n);
+            return;
+        }
+        case OP_IO_BOOL:
+            gen_prim(g, st, op, key);
+            return;
+
+        case OP_IO_BIT_U: case OP_IO_BIT_I: case OP_IO_BIT_BOOL: {
+            gen_bitfield f = { op, key, p[3] };
+            if (op == OP_IO_BIT_BOOL) f.width = 1;
+            gen_bits(g, st, &f, 1);
+            break;
+        }
+        case OP_IO_BIT_GROUP: {
+            gen_bitfield fields[CND_MAX_BIT_GROUP];
+            uint8_t n = p[1];
+            if (n > CND_MAX_BIT_GROUP) { gen_fail(g, "bit group too large at 0x%zx", ip); return; }
+            for (uint8_t i = 0; i < n; i++) {
+                const uint8_t* fp = p + 2 + (size_t)i * 4;
+                fields[i].type = fp[0];
+                fields[i].key = (uint16_t)(il_get_u16(fp + 1) + g->key_base);
+                fields[i].width = fp[0] == OP_IO_BIT_BOOL ? 1 : fp[3];
+            }
+            if (n > 0) gen_bits(g, st, fields, n);
+            break;
+        }
+        case OP_ALIGN_PAD: {
+            unsigned bits = p[1];
+            g->uses_bit = true;
+            if (g->encode) {
+                gen_line(g, "cg_put_bits(buf, len, &cur, &bit, 0, %u, %d);", bits, st->f.endian == CND_BE);
+            } else if (st->f.bitpos == 0 && bits % 8 == 0) {
+                if (bits) gen_line(g, "cur += %u;", bits / 8);
+            } else {
+                gen_line(g, "cur += ((size_t)bit + %u) / 8;", bits);
+                gen_line(g, "bit = (uint8_t)((bit + %u) %% 8);", bits);
+            }
+            if (st->f.bitpos >= 0) st->f.bitpos = (int)((st->f.bitpos + bits) % 8);
+            break;
+        }
+        case OP_ALIGN_FILL:
+            if (st->f.bitpos != 0) {
+                int be = st->f.endian == CND_BE;
+                if (g->encode) {
+                    gen_line(g, "if (bit) cg_put_bits(buf, len, &cur, &bit, %s, 8u - bit, %d);",
+                             p[1] ? "~(uint64_t)0" : "0", be);
+                } else {
+                    gen_line(g, "if (bit) (void)cg_get_bits(buf, len, &cur, &bit, 8u - bit, %d);", be);
+                }
+                st->f.bitpos = 0;
+            }
+            break;
+        case OP_EXIT_BIT_MODE:
+            if (st->f.bitpos != 0) {
+                gen_line(g, "if (bit) return CND_GEN_ERR_VALIDATION;");
+                st->f.bitpos = 0;
+            }
+            break;
+
+        case OP_STR_NULL: gen_string(g, st, key, 0, il_get_u16(p + 3)); break;
+        case OP_STR_PRE_U8: gen_string(g, st, key, 1, 0); break;
+        case OP_STR_PRE_U16: gen_string(g, st, key, 2, 0); break;
+        case OP_STR_PRE_U32: gen_string(g, st, key, 4, 0); break;
+        case OP_RAW_BYTES: gen_raw_bytes(g, st, key, il_get_u32(p + 3)); break;
+
+        case OP_ARR_FIXED: case OP_ARR_PRE_U8: case OP_ARR_PRE_U16: case OP_ARR_PRE_U32:
+        case OP_ARR_EOF: case OP_ARR_DYNAMIC:
+            gen_loop_open(g, r, st, ip, live);
+            gen_loop_mark(r, st, ip);
+            if (r->refs[r->arr_end[ip]] == -1) {
+                // Emitted as a whole: resume after the OP_ARR_END
+                r->refs[r->arr_end[ip]] = 0;
+                while (*idx < r->count && r->order[*idx] <= r->arr_end[ip]) (*idx)++;
+            }
+            break;
+        case OP_ARR_END:
+            gen_loop_close(g, r, st, ip);
+            break;
+
+        case OP_CONST_CHECK: case OP_CONST_WRITE: {
+            size_t tp = op == OP_CONST_CHECK ? 3 : 1;
+            uint8_t type = p[tp];
+            uint32_t size = il_type_size(type);
+            bool ok = op == OP_CONST_CHECK ? (type >= OP_IO_U8 && type <= OP_IO_I64) : (type >= OP_IO_U8 && type <= OP_IO_U64);
+            if (!ok) { gen_fail(g, "constant of unsupported type at 0x%zx", ip); return; }
+            uint64_t val = il_sized(p + tp + 1, size);
+            char lit[64], u[64];
+            gen_align(g, st);
+            gen_line(g, "if (cur + %u > len) return CND_GEN_ERR_OOB;", (unsigned)size);
+            snprintf(u, sizeof(u), "UINT64_C(%" PRIu64 ")", val);
+            if (g->encode) {
+                gen_store(g, (uint8_t)(OP_IO_U8 + (size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3)),
+                          st->f.endian, "cur", u);
+            } else if (op == OP_CONST_CHECK) {
+                // Checked, then reported to the host like a decoded field
+                char m[256], ld[64];
+                if (gen_field(g, key, NODE_VALUE, io_ctype(type), 0, false, m, sizeof(m)) < 0) return;
+                gen_load_bits(ld, sizeof(ld), size, st->f.endian, "cur");
+                gen_line(g, "if (%s != %s) return CND_GEN_ERR_VALIDATION;", ld, u);
+                gen_int_lit(lit, sizeof(lit), type, val);
+                gen_line(g, "%s = %s;", m, lit);
+            }
+            // OP_CONST_WRITE skips its bytes when decoding (the interpreter
+            // writes them into the buffer it decodes)
+            if (op == OP_CONST_CHECK && g->encode) {
+                char m[256];
+                if (gen_field(g, key, NODE_VALUE, io_ctype(type), 0, false, m, sizeof(m)) < 0) return;
+            }
+            gen_line(g, "cur += %u;", (unsigned)size);
+            break;
+        }
+        case OP_RANGE_CHECK: {
+            uint8_t type = p[1];
+            uint32_t size = il_type_size(type);
+            if (size == 0 || type == OP_IO_BOOL) { gen_fail(g, "range check of unsupported type at 0x%zx", ip); return; }
+            gen_range_check(g, st, type, il_sized(p + 2, size), il_sized(p + 2 + size, size));
+            break;
+        }
+        case OP_ENUM_CHECK: case OP_ENUM_SORTED: case OP_ENUM_BITMAP:
+            gen_enum_insn(g, st, op, p + 1, g->len - ip - 1);
+            break;
+
+        case OP_SCALE_LIN:
+            st->trans = GT_SCALE;
+            st->fac = bits_to_dbl(il_get_u64(p + 1));
+            st->off = bits_to_dbl(il_get_u64(p + 9));
+            keep_last = true;
+            break;
+        case OP_TRANS_ADD: case OP_TRANS_SUB: case OP_TRANS_MUL: case OP_TRANS_DIV:
+            st->trans = op == OP_TRANS_ADD ? GT_ADD : op == OP_TRANS_SUB ? GT_SUB : op == OP_TRANS_MUL ? GT_MUL : GT_DIV;
+            st->k = (int64_t)il_get_u64(p + 1);
+            keep_last = true;
+            break;
+        case OP_TRANS_POLY: case OP_TRANS_SPLINE:
+            st->trans = op == OP_TRANS_POLY ? GT_POLY : GT_SPLINE;
+            st->curve_n = p[1];
+            st->curve = gen_curve(g, ip, p + 2, p[1], op == OP_TRANS_POLY ? 1 : 2);
+            keep_last = true;
+            break;
+        case OP_MARK_OPTIONAL:
+            st->optional = true;
+            keep_last = true;
+            break;
+
+        case OP_CRC_16:
+            gen_crc_op(g, st, il_get_u16(p + 1), il_get_u16(p + 3), il_get_u16(p + 5), p[7], 16);
+            break;
+        case OP_CRC_32:
+            gen_crc_op(g, st, il_get_u32(p + 1), il_get_u32(p + 5), il_get_u32(p + 9), p[13], 32);
+            break;
+        case OP_CRC_BEGIN:
+            if (g->pass == 0) g->has_crc_marks = true;
+            if (g->has_crc_marks && g->has_crc) {
+                gen_line(g, "crc_lo = cur;");
+                gen_line(g, "crc_hi = SIZE_MAX;");
+            }
+            break;
+        case OP_CRC_END:
+            if (g->pass == 0) g->has_crc_marks = true;
+            if (g->has_crc_marks && g->has_crc) gen_line(g, "crc_hi = cur;");
+            break;
+
+        case OP_JUMP: case OP_JUMP_IF_NOT: {
+            size_t target;
+            char label[48];
+            if (vm_switch_target(next, (int32_t)il_get_u32(p + 1), g->len, &target) != CND_ERR_OK) {
+                gen_fail(g, "jump target out of range at 0x%zx", ip);
+                return;
+            }
+            if (op == OP_JUMP_IF_NOT) {
+                gen_val cond;
+                char u[64];
+                if (!gen_pop(g, st, &cond)) return;
+                if (!gen_goto_label(g, r, st, ip, target, label, sizeof(label))) return;
+                gen_line(g, "if (!%s) goto %s;", gen_u(&cond, u, sizeof(u)), label);
+                break;
+            }
+            if (*idx < r->count ? r->order[*idx] == target : target == g->len) {
+                // Falls through to its target
+                if (!gen_check_boundary(g, st, ip)) return;
+                break;
+            }
+            if (!gen_goto_label(g, r, st, ip, target, label, sizeof(label))) return;
+            gen_line(g, "goto %s;", label);
+            *live = false;
+            break;
+        }
+        case OP_SWITCH: case OP_SWITCH_TABLE: case OP_SWITCH_SORTED: case OP_SWITCH_HASH: {
+            gen_case* cases;
+            size_t def;
+            int count = gen_switch_cases(g, ip, &cases, &def);
+            if (count < 0) return;
+            gen_val disc = gen_ctx_value(g, key);
+            char u[64], label[48];
+            gen_line(g, "switch (%s) {", gen_u(&disc, u, sizeof(u)));
+            for (int i = 0; i < count && !g->failed; i++) {
+                if (cases[i].target == def) continue;
+                if (!gen_goto_label(g, r, st, ip, cases[i].target, label, sizeof(label))) break;
+                gen_line(g, "case UINT64_C(%" PRIu64 "): goto %s;", cases[i].value, label);
+            }
+            free(cases);
+            if (g->failed) return;
+            if (!gen_goto_label(g, r, st, ip, def, label, sizeof(label))) return;
+            gen_line(g, "default: goto %s;", label);
+            gen_line(g, "}");
+            *live = false;
+            break;
+        }
+        case OP_CALL: {
+            if (!gen_check_boundary(g, st, ip)) return;
+            if (g->call_depth >= CND_MAX_CALL_DEPTH) { gen_fail(g, "subroutines nested deeper than %d", CND_MAX_CALL_DEPTH); return; }
+            size_t target;
+            if (vm_switch_target(next, (int32_t)il_get_u32(p + 5), g->len, &target) != CND_ERR_OK) {
+                gen_fail(g, "call target out of range at 0x%zx", ip);
+                return;
+            }
+            uint16_t saved_base = g->key_base;
+            g->key_base = key;
+            g->call_depth++;
+            bool returns = false;
+            gen_emit_region(g, target, st, false, &returns);
+            g->call_depth--;
+            g->key_base = saved_base;
+            *live = returns;
+            break;
+        }
+        case OP_RET:
+            if (!gen_check_boundary(g, st, ip)) return;
+            if (r->loop_of[ip] != 0) { gen_fail(g, "return from inside an array at 0x%zx", ip); return; }
+            if (r->top) {
+                gen_return_ok(g);
+            } else {
+                if (!gen_merge(g, &r->ret_flow, (uint8_t*)&r->ret_has, &st->f, ip)) return;
+                if (*idx == r->count && r->refs[g->len] == 0) {
+                    r->ret_fall = true;
+                } else {
+                    gen_line(g, "goto R%d;", r->id);
+                    r->ret_refs++;
+                }
+            }
+            *live = false;
+            break;
+
+        case OP_LOAD_CTX:
+            gen_push(g, st, gen_ctx_value(g, key));
+            break;
+        case OP_PUSH_IMM:
+            gen_push(g, st, gen_const(il_get_u64(p + 1)));
+            break;
+        case OP_POP: {
+            gen_val v;
+            if (gen_pop(g, st, &v) && v.kind != GV_CONST) gen_line(g, "(void)%s;", v.name);
+            break;
+        }
+        case OP_SWAP:
+            if (st->sp < 2) { gen_fail(g, "expression stack underflow"); return; }
+            {
+                gen_val t = st->stack[st->sp - 1];
+                st->stack[st->sp - 1] = st->stack[st->sp - 2];
+                st->stack[st->sp - 2] = t;
+            }
+            break;
+        case OP_DUP:
+            if (st->sp < 1) { gen_fail(g, "expression stack underflow"); return; }
+            gen_push(g, st, st->stack[st->sp - 1]);
+            break;
+        case OP_EMIT: {
+            gen_val v;
+            if (gen_pop(g, st, &v)) gen_emit(g, st, p[1], &v);
+            break;
+        }
+        case OP_STORE_CTX: {
+            gen_val v;
+            if (gen_pop(g, st, &v)) gen_store_ctx(g, ip, key, &v);
+            break;
+        }
+        case OP_EXPR:
+            gen_expr(g, st, p + 2, p[1]);
+            break;
+
+        default: {
+            int arity = alu_arity(op);
+            if (arity == 0) {
+                gen_fail(g, "opcode %s at 0x%zx is not supported by gen-c", gen_op_name(op), ip);
+                return;
+            }
+            gen_val a, b = gen_const(0);
+            if (arity == 2 && !gen_pop(g, st, &b)) return;
+            if (!gen_pop(g, st, &a)) return;
+            gen_push(g, st, gen_alu(g, op, &a, &b));
+            break;
+        }
+    }
+    if (!keep_last) g->last_io.valid = false;
+}
+
+// Emits the region reachable from `entry`. For subroutines, *returns tells
+// whether control comes back to the caller (with `st` as it does).
+static bool gen_emit_region(gen_ctx* g, size_t entry, gen_state* st, bool top, bool* returns) {
+    gen_region r;
+    memset(&r, 0, sizeof(r));
+    r.id = g->regions++;
+    r.top = top;
+    if (!gen_region_scan(g, &r, entry)) { gen_region_free(&r); return false; }
+
+    bool live = true;
+    size_t i = 0;
+    while (i < r.count && !g->failed) {
+        size_t ip = r.order[i];
+        if (r.refs[ip] > 0) {
+            if (live) {
+                if (!gen_check_boundary(g, st, ip)) break;
+                if (!gen_merge(g, &r.lflow[ip], &r.lhas[ip], &st->f, ip)) break;
+            }
+            st->f = r.lflow[ip];
+            gb_printf(g->out, "L%d_%zx: ;\n", r.id, ip);
+            g->last_io.valid = false;
+            live = true;
+        } else if (!live) {
+            gen_fail(g, "code at 0x%zx is only reached by a backward jump", ip);
+            break;
+        }
+        gen_insn(g, &r, st, &i, &live);
+    }
+
+    if (!g->failed) {
+        // Jumps to the end, or running off it, end the program
+        if (r.refs[g->len] > 0) {
+            if (live && !gen_merge(g, &r.lflow[g->len], &r.lhas[g->len], &st->f, g->len)) live = false;
+            gb_printf(g->out, "L%d_%zx: ;\n", r.id, g->len);
+            live = true;
+        }
+        if (live) gen_return_ok(g);
+        if (!top) {
+            if (r.ret_refs > 0) gb_printf(g->out, "R%d: ;\n", r.id);
+            if (r.ret_has) st->f = r.ret_flow;
+            *returns = r.ret_refs > 0 || r.ret_fall;
+        }
+    }
+    gen_region_free(&r);
+    return !g->failed;
+}
+
+// --- Output Files ---
+
+static const char* cg_prelude =
+    "static inline uint16_t cg_ld16le(const uint8_t* b) { return (uint16_t)(b[0] | b[1] << 8); }\n"
+    "static inline uint16_t cg_ld16be(const uint8_t* b) { return (uint16_t)(b[0] << 8 | b[1]); }\n"
+    "static inline uint32_t cg_ld32le(const uint8_t* b) { return (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24; }\n"
+    "static inline uint32_t cg_ld32be(const uint8_t* b) { return (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 | (uint32_t)b[3]; }\n"
+    "static inline uint64_t cg_ld64le(const uint8_t* b) { return (uint64_t)cg_ld32le(b) | (uint64_t)cg_ld32le(b + 4) << 32; }\n"
+    "static inline uint64_t cg_ld64be(const uint8_t* b) { return (uint64_t)cg_ld32be(b) << 32 | (uint64_t)cg_ld32be(b + 4); }\n"
+    "static inline void cg_st16le(uint8_t* b, uint16_t v) { b[0] = (uint8_t)v; b[1] = (uint8_t)(v >> 8); }\n"
+    "static inline void cg_st16be(uint8_t* b, uint16_t v) { b[0] = (uint8_t)(v >> 8); b[1] = (uint8_t)v; }\n"
+    "static inline void cg_st32le(uint8_t* b, uint32_t v) { cg_st16le(b, (uint16_t)v); cg_st16le(b + 2, (uint16_t)(v >> 16)); }\n"
+    "static inline void cg_st32be(uint8_t* b, uint32_t v) { cg_st16be(b, (uint16_t)(v >> 16)); cg_st16be(b + 2, (uint16_t)v); }\n"
+    "static inline void cg_st64le(uint8_t* b, uint64_t v) { cg_st32le(b, (uint32_t)v); cg_st32le(b + 4, (uint32_t)(v >> 32)); }\n"
+    "static inline void cg_st64be(uint8_t* b, uint64_t v) { cg_st32be(b, (uint32_t)(v >> 32)); cg_st32be(b + 4, (uint32_t)v); }\n"
+    "static inline float cg_f32(uint32_t v) { float f; memcpy(&f, &v, 4); return f; }\n"
+    "static inline uint32_t cg_f32bits(float f) { uint32_t v; memcpy(&v, &f, 4); return v; }\n"
+    "static inline double cg_f64(uint64_t v) { double d; memcpy(&d, &v, 8); return d; }\n"
+    "static inline uint64_t cg_f64bits(double d) { uint64_t v; memcpy(&v, &d, 8); return v; }\n"
+    "static inline int cg_near_f32(float a, float b) { float d = a - b; return !(d < -0.00001f || d > 0.00001f); }\n"
+    "static inline int cg_near_f64(double a, double b) { double d = a - b; return !(d < -0.0000001 || d > 0.0000001); }\n"
+    "static inline int64_t cg_sext(uint64_t v, unsigned n) { uint64_t m = (uint64_t)1 << (n - 1); return n >= 64 ? (int64_t)v : (int64_t)((v ^ m) - m); }\n"
+    "\n"
+    "static inline size_t cg_strlen(const char* s, size_t cap)\n"
+    "{\n"
+    "    const char* z = (const char*)memchr(s, 0, cap);\n"
+    "    return z ? (size_t)(z - s) : cap;\n"
+    "}\n"
+    "\n"
+    "static inline size_t cg_strnul(const uint8_t* buf, size_t len, size_t cur, size_t max)\n"
+    "{\n"
+    "    size_t n = cur < len ? len - cur : 0;\n"
+    "    const uint8_t* z;\n"
+    "    if (n > max) n = max;\n"
+    "    z = (const uint8_t*)memchr(buf + cur, 0, n);\n"
+    "    return z ? (size_t)(z - (buf + cur)) : n;\n"
+    "}\n"
+    "\n"
+    "static inline void cg_copy_str(char* dst, size_t cap, const uint8_t* src, size_t n)\n"
+    "{\n"
+    "    if (n > cap - 1) n = cap - 1;\n"
+    "    memcpy(dst, src, n);\n"
+    "    dst[n] = '\\0';\n"
+    "}\n";
+
+static const char* cg_prelude_bits =
+    "\n"
+    "// Bit fields: LE streams fill each byte from bit 0, BE streams from bit 7.\n"
+    "// Fields running past the end of the buffer stop there, bit by bit.\n"
+    "static inline int cg_bits_fit(size_t len, size_t cur, unsigned bit, unsigned n)\n"
+    "{\n"
+    "    return cur <= len && (bit + n + 7) / 8 <= len - cur;\n"
+    "}\n"
+    "\n"
+    "static inline uint64_t cg_get_bits(const uint8_t* buf, size_t len, size_t* cur, uint8_t* bit, unsigned n, int be)\n"
+    "{\n"
+    "    uint64_t v = 0;\n"
+    "    unsigned i;\n"
+    "    if (n == 0) return 0;\n"
+    "    if (*bit + n <= 64 && cg_bits_fit(len, *cur, *bit, n)) {\n"
+    "        unsigned span = *bit + n, k;\n"
+    "        uint64_t w = 0;\n"
+    "        for (k = 0; k < (span + 7) / 8; k++) w |= (uint64_t)buf[*cur + k] << (be ? 56 - 8 * k : 8 * k);\n"
+    "        v = be ? (w << *bit) >> (64 - n) : (w >> *bit) & (n >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1);\n"
+    "        *cur += span / 8;\n"
+    "        *bit = (uint8_t)(span % 8);\n"
+    "        return v;\n"
+    "    }\n"
+    "    for (i = 0; i < n && *cur < len; i++) {\n"
+    "        unsigned b = (buf[*cur] >> (be ? 7 - *bit : *bit)) & 1;\n"
+    "        if (be) v = (v << 1) | b;\n"
+    "        else v |= (uint64_t)b << i;\n"
+    "        if (++*bit == 8) { *bit = 0; (*cur)++; }\n"
+    "    }\n"
+    "    return v;\n"
+    "}\n"
+    "\n"
+    "static inline void cg_put_bits(uint8_t* buf, size_t len, size_t* cur, uint8_t* bit, uint64_t v, unsigned n, int be)\n"
+    "{\n"
+    "    unsigned i;\n"
+    "    if (n == 0) return;\n"
+    "    if (*bit + n <= 64 && cg_bits_fit(len, *cur, *bit, n)) {\n"
+    "        unsigned span = *bit + n, nb = (span + 7) / 8, k;\n"
+    "        unsigned sh = be ? 64 - span : *bit;\n"
+    "        uint64_t m = n >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1, w = 0;\n"
+    "        for (k = 0; k < nb; k++) w |= (uint64_t)buf[*cur + k] << (be ? 56 - 8 * k : 8 * k);\n"
+    "        w = (w & ~(m << sh)) | ((v & m) << sh);\n"
+    "        for (k = 0; k < nb; k++) buf[*cur + k] = (uint8_t)(w >> (be ? 56 - 8 * k : 8 * k));\n"
+    "        *cur += span / 8;\n"
+    "        *bit = (uint8_t)(span % 8);\n"
+    "        return;\n"
+    "    }\n"
+    "    for (i = 0; i < n && *cur < len; i++) {\n"
+    "        unsigned s = be ? 7u - *bit : *bit;\n"
+    "        unsigned b = (unsigned)((be ? v >> (n - 1 - i) : v >> i) & 1);\n"
+    "        buf[*cur] = (uint8_t)((buf[*cur] & ~(1u << s)) | (b << s));\n"
+    "        if (++*bit == 8) { *bit = 0; (*cur)++; }\n"
+    "    }\n"
+    "}\n";
+
+static const char* cg_prelude_crc =
+    "\n"
+    "static inline uint32_t cg_reflect(uint32_t v, int bits)\n"
+    "{\n"
+    "    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);\n"
+    "    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);\n"
+    "    v = ((v >> 4) & 0x0F0F0F0Fu) | ((v & 0x0F0F0F0Fu) << 4);\n"
+    "    v = ((v >> 8) & 0x00FF00FFu) | ((v & 0x00FF00FFu) << 8);\n"
+    "    v = (v >> 16) | (v << 16);\n"
+    "    return v >> (32 - bits);\n"
+    "}\n";
+
+static const char* cg_prelude_curves =
+    "\n"
+    "// Curve transforms, as the interpreter evaluates and inverts them\n"
+    "static inline double cg_poly_eval(const double* c, int n, double x)\n"
+    "{\n"
+    "    double y = 0;\n"
+    "    int i;\n"
+    "    if (n > 0) {\n"
+    "        y = c[n - 1];\n"
+    "        for (i = n - 2; i >= 0; i--) y = y * x + c[i];\n"
+    "    }\n"
+    "    return y;\n"
+    "}\n"
+    "\n"
+    "static inline double cg_poly_solve(const double* c, int n, double target)\n"
+    "{\n"
+    "    double x = 0;\n"
+    "    int iter, i;\n"
+    "    for (iter = 0; iter < 20; iter++) {\n"
+    "        double y = 0, dy = 0, diff;\n"
+    "        if (n > 0) {\n"
+    "            y = c[n - 1];\n"
+    "            for (i = n - 2; i >= 0; i--) {\n"
+    "                dy = dy * x + y;\n"
+    "                y = y * x + c[i];\n"
+    "            }\n"
+    "        }\n"
+    "        diff = y - target;\n"
+    "        if (diff > -0.001 && diff < 0.001) break;\n"
+    "        if (dy == 0) break;\n"
+    "        x = x - diff / dy;\n"
+    "    }\n"
+    "    return x;\n"
+    "}\n"
+    "\n"
+    "static inline double cg_spline_eval(const double* p, int n, double x)\n"
+    "{\n"
+    "    int i;\n"
+    "    for (i = 0; i + 1 < n; i++) {\n"
+    "        double x0 = p[2 * i], y0 = p[2 * i + 1], x1 = p[2 * i + 2], y1 = p[2 * i + 3];\n"
+    "        if ((x >= x0 && x <= x1) || i == n - 2) return x1 == x0 ? y0 : y0 + (x - x0) * (y1 - y0) / (x1 - x0);\n"
+    "    }\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "static inline double cg_spline_solve(const double* p, int n, double y)\n"
+    "{\n"
+    "    int i;\n"
+    "    for (i = 0; i + 1 < n; i++) {\n"
+    "        double x0 = p[2 * i], y0 = p[2 * i + 1], x1 = p[2 * i + 2], y1 = p[2 * i + 3];\n"
+    "        if ((y >= y0 && y <= y1) || (y <= y0 && y >= y1)) return y1 == y0 ? x0 : x0 + (y - y0) * (x1 - x0) / (y1 - y0);\n"
+    "    }\n"
+    "    return 0;\n"
+    "}\n";
+
+// Generates one direction into `body` (pass 1: encode, 2: decode, 0: layout)
+static bool gen_function(gen_ctx* g, int pass, gen_buf* body) {
+    g->pass = pass;
+    g->encode = (pass != 2);
+    g->out = body;
+    g->indent = 4;
+    g->depth = 0;
+    g->key_base = 0;
+    g->call_depth = 0;
+    g->regions = 0;
+    g->n_u = g->n_f = g->max_depth = 0;
+    memset(g->var_count, 0, sizeof(g->var_count));
+    memset(g->uses_i, 0, sizeof(g->uses_i));
+    g->uses_bit = g->uses_s = false;
+    g->last_io.valid = false;
+    for (size_t k = 0; k < 65536; k++) g->stored[k] &= (uint8_t)~GEN_KEY_STORED_NOW;
+
+    gen_state st;
+    memset(&st, 0, sizeof(st));
+    st.f.endian = CND_LE;
+    bool returns = false;
+    gen_emit_region(g, 0, &st, true, &returns);
+    return !g->failed;
+}
+
+static void gen_function_text(gen_ctx* g, gen_buf* out, bool encode, const gen_buf* body) {
+    if (encode) gb_printf(out, "\nint %s_encode(const %s* p, uint8_t* buf, size_t len, size_t* out_len)\n{\n", g->name, g->name);
+    else gb_printf(out, "\nint %s_decode(%s* p, const uint8_t* buf, size_t len, size_t* out_len)\n{\n", g->name, g->name);
+    gb_printf(out, "    size_t cur = 0;\n");
+    if (g->uses_bit) gb_printf(out, "    uint8_t bit = 0;\n");
+    if (g->uses_s) gb_printf(out, "    size_t s;\n");
+    if (g->has_crc_marks && g->has_crc) gb_printf(out, "    size_t crc_lo = 0, crc_hi = SIZE_MAX;\n");
+    for (int d = 0; d < g->max_depth; d++) {
+        if (g->uses_i[d] && g->var_count[d]) gb_printf(out, "    uint32_t i%d, n%d;\n", d, d);
+        else if (g->uses_i[d]) gb_printf(out, "    uint32_t i%d;\n", d);
+        else if (g->var_count[d]) gb_printf(out, "    uint32_t n%d;\n", d);
+    }
+    for (size_t k = 0; k < 65536; k++) {
+        if (g->stored[k] & GEN_KEY_LOCAL) gb_printf(out, "    uint64_t v%u = 0;\n", (unsigned)k);
+    }
+    for (int i = 0; i < g->n_u; i++) gb_printf(out, "%s t%d%s", i == 0 ? "    uint64_t" : ",", i, i == g->n_u - 1 ? ";\n" : "");
+    for (int i = 0; i < g->n_f; i++) gb_printf(out, "%s d%d%s", i == 0 ? "    double" : ",", i, i == g->n_f - 1 ? ";\n" : "");
+    gb_printf(out, "\n%s}\n", body->data ? body->data : "");
+}
+
+static void gen_struct_members(gen_ctx* g, gen_buf* out, int parent, int indent) {
+    int count = 0;
+    for (int i = 1; i < g->node_count; i++) {
+        const gen_node* c = &g->nodes[i];
+        if (c->parent != parent || c->kind == NODE_NEW) continue;
+        char dims[96] = "";
+        if (c->array == ARR_FIXED_LEN) snprintf(dims, sizeof(dims), "[%" PRIu32 "]", c->array_len);
+        else if (c->array == ARR_VAR_LEN) snprintf(dims, sizeof(dims), "[%s_MAX_ARRAY]", g->upper);
+        switch (c->kind) {
+            case NODE_STRUCT:
+                gb_printf(out, "%*sstruct {\n", indent, "");
+                gen_struct_members(g, out, i, indent + 4);
+                gb_printf(out, "%*s} %s%s;\n", indent, "", c->name, dims);
+                break;
+            case NODE_VALUE:
+                gb_printf(out, "%*s%s %s%s;\n", indent, "", c->ctype, c->name, dims);
+                break;
+            case NODE_STRING:
+                if (c->size) gb_printf(out, "%*schar %s%s[%" PRIu32 "];\n", indent, "", c->name, dims, c->size + 1);
+                else gb_printf(out, "%*schar %s%s[%s_MAX_STRING + 1];\n", indent, "", c->name, dims, g->upper);
+                break;
+            case NODE_BYTES:
+                gb_printf(out, "%*suint8_t %s%s[%" PRIu32 "];\n", indent, "", c->name, dims, c->size > 0 ? c->size : 1);
+                break;
+            default:
+                break;
+        }
+        count++;
+    }
+    if (count == 0) gb_printf(out, "%*suint8_t reserved_;\n", indent, "");
+}
+
+static void gen_header(gen_ctx* g, gen_buf* out, const char* il_path) {
+    gb_printf(out, "// Generated by `cnd gen-c` from %s. Do not edit: regenerate from the IL.\n", il_path);
+    gb_printf(out, "#ifndef %s_GEN_H\n#define %s_GEN_H\n\n", g->upper, g->upper);
+    gb_printf(out, "#include <stddef.h>\n#include <stdint.h>\n\n");
+    gb_printf(out, "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n");
+    gb_printf(out, "#ifndef CND_GEN_OK\n");
+    gb_printf(out, "// Return codes, numbered like cnd_error_t\n");
+    gb_printf(out, "#define CND_GEN_OK                 0\n");
+    gb_printf(out, "#define CND_GEN_ERR_OOB            1\n");
+    gb_printf(out, "#define CND_GEN_ERR_INVALID_OP     2\n");
+    gb_printf(out, "#define CND_GEN_ERR_VALIDATION     3\n");
+    gb_printf(out, "#define CND_GEN_ERR_CALLBACK       4\n");
+    gb_printf(out, "#define CND_GEN_ERR_STACK_OVERFLOW 5\n");
+    gb_printf(out, "#define CND_GEN_ERR_STACK_UNDERFLOW 6\n");
+    gb_printf(out, "#define CND_GEN_ERR_CRC_MISMATCH   7\n");
+    gb_printf(out, "#define CND_GEN_ERR_ARITHMETIC     8\n");
+    gb_printf(out, "#endif\n\n");
+    if (g->uses_max_array) {
+        gb_printf(out, "// Capacity of arrays without a fixed length\n");
+        gb_printf(out, "#ifndef %s_MAX_ARRAY\n#define %s_MAX_ARRAY 64\n#endif\n\n", g->upper, g->upper);
+    }
+    if (g->uses_max_string) {
+        gb_printf(out, "// Capacity of length-prefixed strings, without the terminator\n");
+        gb_printf(out, "#ifndef %s_MAX_STRING\n#define %s_MAX_STRING 64\n#endif\n\n", g->upper, g->upper);
+    }
+    gb_printf(out, "typedef struct {\n");
+    gen_struct_members(g, out, 0, 4);
+    gb_printf(out, "} %s;\n\n", g->name);
+    gb_printf(out, "// Encodes *p into buf[0..len) and stores the bytes written in *out_len\n");
+    gb_printf(out, "int %s_encode(const %s* p, uint8_t* buf, size_t len, size_t* out_len);\n\n", g->name, g->name);
+    gb_printf(out, "// Decodes buf[0..len) into *p and stores the bytes read in *out_len\n");
+    gb_printf(out, "int %s_decode(%s* p, const uint8_t* buf, size_t len, size_t* out_len);\n\n", g->name, g->name);
+    gb_printf(out, "#ifdef __cplusplus\n}\n#endif\n\n#endif\n");
+}
+
+static bool gen_valid_ident(const char* s) {
+    if (!s[0] || !(s[0] == '_' || (s[0] >= 'A' && s[0] <= 'Z') || (s[0] >= 'a' && s[0] <= 'z'))) return false;
+    for (const char* c = s; *c; c++) {
+        if (!(*c == '_' || (*c >= 'A' && *c <= 'Z') || (*c >= 'a' && *c <= 'z') || (*c >= '0' && *c <= '9'))) return false;
+    }
+    return true;
+}
+
+int cmd_gen_c(int argc, char** argv) {
+    if (argc < 4) {
+        printf("Usage: cnd gen-c <schema.il> <out_base>\n");
+        printf("Writes <out_base>.h and <out_base>.c with a struct and encode/decode functions.\n");
+        return 1;
+    }
+    const char* il_path = argv[2];
+    const char* out_base = argv[3];
+
+    ILFile il;
+    memset(&il, 0, sizeof(il));
+    if (!load_il(il_path, &il)) { printf("Failed to load IL\n"); return 1; }
+
+    gen_ctx g;
+    memset(&g, 0, sizeof(g));
+    g.bc = il.bytecode;
+    g.len = il.bytecode_len;
+    g.strtab = il.string_table;
+    g.str_count = il.str_count;
+    g.stored = calloc(65536, 1);
+    if (!g.stored) { free_il(&il); return 1; }
+
+    // Root of the layout
+    g.nodes = calloc(64, sizeof(gen_node));
+    g.node_cap = 64;
+    g.node_count = 1;
+    g.nodes[0].kind = NODE_STRUCT;
+    g.nodes[0].parent = -1;
+
+    gen_buf layout = {0}, enc = {0}, dec = {0};
+    int status = 1;
+
+    // Layout pass: members, packet name, stored keys read back
+    snprintf(g.upper, sizeof(g.upper), "CND_GEN");
+    if (!gen_function(&g, 0, &layout)) goto done;
+    if (!g.named) {
+        const char* base = strrchr(out_base, '/');
+        base = base ? base + 1 : out_base;
+        snprintf(g.name, sizeof(g.name), "%s", base);
+        char* dot = strchr(g.name, '.');
+        if (dot) *dot = '\0';
+    }
+    if (!gen_valid_ident(g.name)) {
+        printf("gen-c: packet name '%s' is not a C identifier\n", g.name);
+        goto done;
+    }
+    for (size_t i = 0; i <= strlen(g.name); i++) {
+        char c = g.name[i];
+        g.upper[i] = (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+    }
+    gb_free(&g.statics);
+    free(g.curve_ips);
+    g.curve_ips = NULL;
+    g.curve_count = g.crc_count = 0;
+    g.uses_max_array = g.uses_max_string = false;
+
+    gen_buf c_out = {0};
+    gen_buf fn = {0};
+    if (!gen_function(&g, 1, &enc)) goto done;
+    gen_function_text(&g, &fn, true, &enc);
+    if (!gen_function(&g, 2, &dec)) { gb_free(&fn); goto done; }
+    gen_function_text(&g, &fn, false, &dec);
+
+    const char* base = strrchr(out_base, '/');
+    base = base ? base + 1 : out_base;
+    gb_printf(&c_out, "// Generated by `cnd gen-c` from %s. Do not edit: regenerate from the IL.\n", il_path);
+    gb_printf(&c_out, "#include \"%s.h\"\n\n#include <math.h>\n#include <string.h>\n\n", base);
+    gb_printf(&c_out, "%s", cg_prelude);
+    gb_printf(&c_out, "%s", cg_prelude_bits);
+    if (g.crc_count > 0) gb_printf(&c_out, "%s", cg_prelude_crc);
+    if (g.curve_count > 0) gb_printf(&c_out, "%s", cg_prelude_curves);
+    if (g.statics.data) gb_printf(&c_out, "\n%s", g.statics.data);
+    gb_printf(&c_out, "%s", fn.data);
+
+    gen_buf h_out = {0};
+    gen_header(&g, &h_out, il_path);
+
+    size_t path_len = strlen(out_base) + 3;
+    char* h_path = malloc(path_len);
+    char* c_path = malloc(path_len);
+    snprintf(h_path, path_len, "%s.h", out_base);
+    snprintf(c_path, path_len, "%s.c", out_base);
+    if (write_file_text(h_path, h_out.data) && write_file_text(c_path, c_out.data)) {
+        printf("Generated %s and %s (%s_encode, %s_decode)\n", h_path, c_path, g.name, g.name);
+        status = 0;
+    } else {
+        printf("gen-c: failed to write %s / %s\n", h_path, c_path);
+    }
+    free(h_path);
+    free(c_path);
+    gb_free(&h_out);
+    gb_free(&c_out);
+    gb_free(&fn);
+
+done:
+    if (g.failed) printf("gen-c: %s\n", g.err);
+    gb_free(&layout);
+    gb_free(&enc);
+    gb_free(&dec);
+    gb_free(&g.statics);
+    free(g.curve_ips);
+    free(g.nodes);
+    free(g.stored);
+    free_il(&il);
+    return status;
+}
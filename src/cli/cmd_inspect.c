@@ -53,11 +53,15 @@ static const char* get_opcode_name(uint8_t op) {
         case OP_IO_F32: return "IO_F32";
         case OP_IO_F64: return "IO_F64";
         case OP_IO_BOOL: return "IO_BOOL";
+        case OP_IO_RUN: return "IO_RUN";
+        case OP_IO_CHECK: return "IO_CHECK";
+        case OP_IO_SLOT: return "IO_SLOT";
         case OP_IO_BIT_U: return "IO_BIT_U";
         case OP_IO_BIT_I: return "IO_BIT_I";
         case OP_IO_BIT_BOOL: return "IO_BIT_BOOL";
         case OP_ENTER_BIT_MODE: return "ENTER_BIT_MODE";
         case OP_EXIT_BIT_MODE: return "EXIT_BIT_MODE";
+        case OP_IO_BIT_GROUP: return "IO_BIT_GROUP";
         case OP_ALIGN_PAD: return "ALIGN_PAD";
         case OP_ALIGN_FILL: return "ALIGN_FILL";
         case OP_STR_NULL: return "STR_NULL";
@@ -85,10 +89,19 @@ static const char* get_opcode_name(uint8_t op) {
         case OP_TRANS_SPLINE: return "TRANS_SPLINE";
         case OP_CRC_32: return "CRC_32";
         case OP_MARK_OPTIONAL: return "MARK_OPTIONAL";
+        case OP_CRC_BEGIN: return "CRC_BEGIN";
+        case OP_CRC_END: return "CRC_END";
         case OP_ENUM_CHECK: return "ENUM_CHECK";
+        case OP_ENUM_SORTED: return "ENUM_SORTED";
+        case OP_ENUM_BITMAP: return "ENUM_BITMAP";
         case OP_JUMP_IF_NOT: return "JUMP_IF_NOT";
         case OP_SWITCH: return "SWITCH";
+        case OP_SWITCH_TABLE: return "SWITCH_TABLE";
+        case OP_SWITCH_SORTED: return "SWITCH_SORTED";
+        case OP_SWITCH_HASH: return "SWITCH_HASH";
         case OP_JUMP: return "JUMP";
+        case OP_CALL: return "CALL";
+        case OP_RET: return "RET";
         case OP_LOAD_CTX: return "LOAD_CTX";
         case OP_STORE_CTX: return "STORE_CTX";
         case OP_PUSH_IMM: return "PUSH_IMM";
@@ -137,10 +150,59 @@ static const char* get_opcode_name(uint8_t op) {
         case OP_LT: return "LT";
         case OP_GTE: return "GTE";
         case OP_LTE: return "LTE";
+        case OP_EXPR: return "EXPR";
+        case OP_REG_LOAD: return "REG_LOAD";
+        case OP_REG_IMM: return "REG_IMM";
+        case OP_REG_CONST: return "REG_CONST";
+        case OP_REG_FCONST: return "REG_FCONST";
+        case OP_REG_ITOB: return "REG_ITOB";
+        case OP_REG_BTOI: return "REG_BTOI";
+        case OP_REG_RET: return "REG_RET";
         default: return "UNKNOWN";
     }
 }
 
+// One line per register instruction of an OP_EXPR
+static void print_expr(const uint8_t* code, size_t len) {
+    size_t i = 0;
+    while (i + 4 <= len) {
+        const uint8_t* p = code + i;
+        uint8_t op = p[0], d = p[1] & (uint8_t)~CND_EXPR_IMM, a = p[2], b = p[3];
+        int float_in = (op >= OP_FADD && op <= OP_ABS) || (op >= OP_EQ_F && op <= OP_LTE_F) || op == OP_FTOI;
+        int float_out = (op >= OP_FADD && op <= OP_ABS) || op == OP_ITOF;
+        printf("\n        %-11s", get_opcode_name(op));
+        i += 4;
+        switch (op) {
+            case OP_REG_LOAD: printf(" r%d KeyID=%d", d, a | (b << 8)); break;
+            case OP_REG_IMM: printf(" r%d %d", d, (int16_t)(a | (b << 8))); break;
+            case OP_REG_CONST:
+            case OP_REG_FCONST: {
+                if (i + 8 > len) return;
+                uint64_t v = 0;
+                for (int k = 7; k >= 0; k--) v = (v << 8) | code[i + k];
+                i += 8;
+                if (op == OP_REG_CONST) {
+                    printf(" r%d %" PRIu64, d, v);
+                } else {
+                    double f;
+                    memcpy(&f, &v, 8);
+                    printf(" f%d %g", d, f);
+                }
+                break;
+            }
+            case OP_REG_ITOB: printf(" f%d r%d", d, a); break;
+            case OP_REG_BTOI: printf(" r%d f%d", d, a); break;
+            case OP_REG_RET: printf(" %c%d", b ? 'f' : 'r', a); break;
+            default:
+                printf(" %c%d %c%d", float_out ? 'f' : 'r', d, float_in ? 'f' : 'r', a);
+                if (p[1] & CND_EXPR_IMM) printf(" #%d", (int8_t)b);
+                else if (op == OP_POW || (op >= OP_FADD && op <= OP_FDIV) || (op >= OP_EQ_F && op <= OP_LTE_F)) printf(" f%d", b);
+                else if (op != OP_NEG && op != OP_BIT_NOT && op != OP_LOG_NOT && !float_in && op != OP_ITOF) printf(" r%d", b);
+                break;
+        }
+    }
+}
+
 int cmd_inspect(int argc, char** argv) {
     if (argc < 3) {
         printf("Usage: cnd inspect <file.il>\n");
@@ -181,6 +243,20 @@ int cmd_inspect(int argc, char** argv) {
     printf("String Table Offset: %d\n", str_offset);
     printf("Bytecode Offset: %d\n", bc_offset);
 
+    uint32_t layout_offset = 0;
+    uint16_t layout_count = 0;
+    if (version >= 2 && size >= 24) {
+        layout_offset = data[16] | (data[17] << 8) | (data[18] << 16) | (data[19] << 24);
+        layout_count = data[20] | (data[21] << 8);
+        printf("Layout Entries: %d\n", layout_count);
+    }
+    if (version >= 3 && size >= CND_IL_HEADER_SIZE) {
+        uint32_t min_size = data[24] | (data[25] << 8) | (data[26] << 16) | ((uint32_t)data[27] << 24);
+        uint32_t max_size = data[28] | (data[29] << 8) | (data[30] << 16) | ((uint32_t)data[31] << 24);
+        if (max_size) printf("Packet Size: %u to %u bytes\n", min_size, max_size);
+        else printf("Packet Size: %u bytes or more\n", min_size);
+    }
+
     // Print String Table
     printf("\n--- String Table ---\n");
     if ((long)str_offset < size) {
@@ -193,6 +269,17 @@ int cmd_inspect(int argc, char** argv) {
         }
     }
 
+    // Print Static Layout
+    if (layout_count > 0 && (long)layout_offset + (long)layout_count * CND_LAYOUT_ENTRY_SIZE <= size) {
+        printf("\n--- Static Layout ---\n");
+        for (int i = 0; i < layout_count; i++) {
+            const uint8_t* e = data + layout_offset + i * CND_LAYOUT_ENTRY_SIZE;
+            uint16_t key = e[0] | (e[1] << 8);
+            uint32_t bit = e[4] | (e[5] << 8) | (e[6] << 16) | ((uint32_t)e[7] << 24);
+            printf("KeyID=%d Bit=%u Width=%d%s\n", key, bit, e[3] & ~CND_LAYOUT_BE, (e[3] & CND_LAYOUT_BE) ? " BE" : "");
+        }
+    }
+
     // Disassemble Bytecode
     printf("\n--- Bytecode ---\n");
     if ((long)bc_offset < size) {
@@ -233,6 +320,32 @@ int cmd_inspect(int argc, char** argv) {
                     printf(" KeyID=%d", read_u16(&ptr, end));
                     break;
 
+                case OP_IO_RUN: {
+                    uint8_t count = read_u8(&ptr, end);
+                    uint16_t bytes = read_u16(&ptr, end);
+                    printf(" Count=%d Bytes=%d Fields=[", count, bytes);
+                    for (int i = 0; i < count; i++) {
+                        uint8_t type = read_u8(&ptr, end);
+                        uint16_t k = read_u16(&ptr, end);
+                        printf("%s%d:%s", i > 0 ? ", " : "", k, get_opcode_name(type));
+                    }
+                    printf("]");
+                    break;
+                }
+
+                case OP_IO_CHECK: {
+                    // The embedded check follows as the next line
+                    uint8_t type = read_u8(&ptr, end);
+                    printf(" Type=%s KeyID=%d", get_opcode_name(type), read_u16(&ptr, end));
+                    break;
+                }
+
+                case OP_IO_SLOT: {
+                    uint8_t type = read_u8(&ptr, end);
+                    printf(" Type=%s KeyID=%d", get_opcode_name(type), read_u16(&ptr, end));
+                    break;
+                }
+
                 case OP_ENTER_BIT_MODE:
                 case OP_EXIT_BIT_MODE:
                     break;
@@ -266,8 +379,24 @@ int cmd_inspect(int argc, char** argv) {
                 
                 case OP_IO_BIT_BOOL:
                     printf(" KeyID=%d", read_u16(&ptr, end));
+                    read_u8(&ptr, end); // Width (always 1)
                     break;
 
+                case OP_IO_BIT_GROUP: {
+                    uint8_t count = read_u8(&ptr, end);
+                    printf(" Count=%d Fields=[", count);
+                    for (int i = 0; i < count; i++) {
+                        uint8_t type = read_u8(&ptr, end);
+                        uint16_t k = read_u16(&ptr, end);
+                        uint8_t b = read_u8(&ptr, end);
+                        if (i > 0) printf(", ");
+                        if (type == OP_IO_BIT_BOOL) printf("%d:bool", k);
+                        else printf("%d:%s%d", k, type == OP_IO_BIT_I ? "i" : "u", b);
+                    }
+                    printf("]");
+                    break;
+                }
+
                 case OP_ARR_FIXED: {
                     uint16_t k = read_u16(&ptr, end);
                     uint32_t c = read_u32(&ptr, end);
@@ -381,7 +510,8 @@ int cmd_inspect(int argc, char** argv) {
                         read_u32(&ptr, end), read_u32(&ptr, end), read_u32(&ptr, end), read_u8(&ptr, end));
                     break;
 
-                case OP_ENUM_CHECK: {
+                case OP_ENUM_CHECK:
+                case OP_ENUM_SORTED: {
                     uint8_t type = read_u8(&ptr, end);
                     uint16_t count = read_u16(&ptr, end);
                     printf(" Type=%s Count=%d Values=[", get_opcode_name(type), count);
@@ -400,7 +530,31 @@ int cmd_inspect(int argc, char** argv) {
                     break;
                 }
 
-                case OP_SWITCH: {
+                case OP_ENUM_BITMAP: {
+                    uint8_t type = read_u8(&ptr, end);
+                    printf(" Type=%s Base=", get_opcode_name(type));
+                    if (type == OP_IO_U8) printf("%u", read_u8(&ptr, end));
+                    else if (type == OP_IO_U16) printf("%u", read_u16(&ptr, end));
+                    else if (type == OP_IO_U32) printf("%u", read_u32(&ptr, end));
+                    else if (type == OP_IO_U64) printf("%" PRIu64, read_u64(&ptr, end));
+                    else if (type == OP_IO_I8) printf("%d", (int8_t)read_u8(&ptr, end));
+                    else if (type == OP_IO_I16) printf("%d", (int16_t)read_u16(&ptr, end));
+                    else if (type == OP_IO_I32) printf("%d", (int32_t)read_u32(&ptr, end));
+                    else if (type == OP_IO_I64) printf("%" PRId64, (int64_t)read_u64(&ptr, end));
+                    uint16_t span = read_u16(&ptr, end);
+                    int members = 0;
+                    for (int i = 0; i < (span + 7) / 8; i++) {
+                        uint8_t bits = read_u8(&ptr, end);
+                        for (; bits; bits &= (uint8_t)(bits - 1)) members++;
+                    }
+                    printf(" Span=%u Count=%d", span, members);
+                    break;
+                }
+
+                case OP_SWITCH:
+                case OP_SWITCH_TABLE:
+                case OP_SWITCH_SORTED:
+                case OP_SWITCH_HASH: {
                     uint16_t k = read_u16(&ptr, end);
                     uint32_t t = read_u32(&ptr, end);
                     printf(" KeyID=%d TableOff=%u", k, t);
@@ -419,6 +573,14 @@ int cmd_inspect(int argc, char** argv) {
                     break;
                 }
 
+                case OP_CALL: {
+                    uint16_t base = read_u16(&ptr, end);
+                    uint16_t count = read_u16(&ptr, end);
+                    int32_t off = (int32_t)read_u32(&ptr, end);
+                    printf(" KeyBase=%d KeyCount=%d Offset=%d", base, count, off);
+                    break;
+                }
+
                 case OP_LOAD_CTX: {
                     uint16_t k = read_u16(&ptr, end);
                     printf(" KeyID=%d", k);
@@ -437,6 +599,15 @@ int cmd_inspect(int argc, char** argv) {
                     break;
                 }
 
+                case OP_EXPR: {
+                    uint8_t n = read_u8(&ptr, end);
+                    if (n > end - ptr) n = (uint8_t)(end - ptr);
+                    printf(" Len=%d", n);
+                    print_expr(ptr, n);
+                    ptr += n;
+                    break;
+                }
+
                 case OP_EMIT: {
                     uint8_t type = read_u8(&ptr, end);
                     printf(" Type=%s", get_opcode_name(type));
@@ -425,8 +425,12 @@ static void skip_instruction(const uint8_t** ptr, const uint8_t* end, uint8_t op
         case OP_STR_NULL: *ptr += 4; break;
         case OP_STR_PRE_U8: case OP_STR_PRE_U16: case OP_STR_PRE_U32:
         case OP_ARR_PRE_U8: case OP_ARR_PRE_U16: case OP_ARR_PRE_U32: *ptr += 2; break;
-        case OP_IO_BIT_U: case OP_IO_BIT_I: *ptr += 3; break;
-        case OP_IO_BIT_BOOL: *ptr += 2; break;
+        case OP_IO_BIT_U: case OP_IO_BIT_I: case OP_IO_BIT_BOOL: *ptr += 3; break;
+        case OP_IO_BIT_GROUP: {
+            uint8_t count = read_u8(ptr, end);
+            *ptr += (size_t)count * 4;
+            break;
+        }
         case OP_ARR_FIXED: *ptr += 6; break;
         case OP_RAW_BYTES: *ptr += 6; break;
         case OP_CONST_WRITE: {
@@ -468,7 +472,8 @@ static void skip_instruction(const uint8_t** ptr, const uint8_t* end, uint8_t op
         }
         case OP_CRC_16: *ptr += 7; break;
         case OP_CRC_32: *ptr += 13; break;
-        case OP_ENUM_CHECK: {
+        case OP_ENUM_CHECK:
+        case OP_ENUM_SORTED: {
             uint8_t type = read_u8(ptr, end);
             uint16_t count = read_u16(ptr, end);
             int sz = 0;
@@ -479,8 +484,21 @@ static void skip_instruction(const uint8_t** ptr, const uint8_t* end, uint8_t op
             *ptr += count * sz;
             break;
         }
-        case OP_SWITCH: *ptr += 6; break;
+        case OP_ENUM_BITMAP: {
+            uint8_t type = read_u8(ptr, end);
+            int sz = 0;
+            if (type == OP_IO_U8 || type == OP_IO_I8) sz = 1;
+            else if (type == OP_IO_U16 || type == OP_IO_I16) sz = 2;
+            else if (type == OP_IO_U32 || type == OP_IO_I32) sz = 4;
+            else if (type == OP_IO_U64 || type == OP_IO_I64) sz = 8;
+            *ptr += sz;
+            uint16_t span = read_u16(ptr, end);
+            *ptr += (span + 7) / 8;
+            break;
+        }
+        case OP_SWITCH: case OP_SWITCH_TABLE: case OP_SWITCH_SORTED: case OP_SWITCH_HASH: *ptr += 6; break;
         case OP_JUMP: case OP_JUMP_IF_NOT: *ptr += 4; break;
+        case OP_CALL: *ptr += 8; break;
         case OP_LOAD_CTX: case OP_STORE_CTX: *ptr += 2; break;
         case OP_PUSH_IMM: *ptr += 8; break;
         case OP_ALIGN_PAD: case OP_ALIGN_FILL: *ptr += 1; break;
@@ -697,9 +715,21 @@ static void handle_completion(cJSON* id, cJSON* params) {
                             }
                         }
                         // Skip remaining bytes for ops that have more data after key
-                        if (op == OP_IO_BIT_U || op == OP_IO_BIT_I) bc_ptr += 1; // bits
+                        if (op == OP_IO_BIT_U || op == OP_IO_BIT_I || op == OP_IO_BIT_BOOL) bc_ptr += 1; // bits
                         else if (op == OP_STR_NULL) bc_ptr += 2; // max_len
                         else if (op == OP_ARR_FIXED) bc_ptr += 4; // count
+                    } else if (op == OP_IO_BIT_GROUP) {
+                        // Count(1) + Count * {Type(1) Key(2) Width(1)}
+                        uint8_t count = read_u8(&bc_ptr, end);
+                        for (uint8_t i = 0; i < count && bc_ptr + 4 <= end; i++, bc_ptr += 4) {
+                            uint16_t key = (uint16_t)(bc_ptr[1] | (bc_ptr[2] << 8));
+                            if (key >= p.strtab.count) continue;
+                            cJSON* item = cJSON_CreateObject();
+                            cJSON_AddStringToObject(item, "label", p.strtab.strings[key]);
+                            cJSON_AddNumberToObject(item, "kind", 5); // Field
+                            cJSON_AddStringToObject(item, "detail", "Field");
+                            cJSON_AddItemToArray(items, item);
+                        }
                     } else {
                         skip_instruction(&bc_ptr, end, op);
                     }
@@ -15,6 +15,8 @@ extern int cmd_decode(int argc, char** argv);
 extern int cmd_fmt(int argc, char** argv);
 extern int cmd_inspect(int argc, char** argv);
 extern int cmd_lsp(int argc, char** argv);
+extern int cmd_gen_c(int argc, char** argv);
+extern int cmd_embed(int argc, char** argv);
 
 
 // --- main function for the cnd CLI tool ---
@@ -24,11 +26,13 @@ int main(int argc, char** argv) {
     if (argc < 2) {
         printf("Concordia CLI %s (%s)\n", CND_VERSION, CND_GIT_HASH);
         printf("Usage:\n");
-        printf("  cnd compile <in.cnd> <out.il>\n");
+        printf("  cnd compile <in.cnd> <out.il> [-O]\n");
         printf("  cnd fmt <in.cnd> [out.cnd]\n");
         printf("  cnd inspect <file.il>\n");
         printf("  cnd encode <schema.il> <in.json> <out.bin>\n");
         printf("  cnd decode <schema.il> <in.bin> <out.json>\n");
+        printf("  cnd gen-c <schema.il> <out_base>\n");
+        printf("  cnd embed <schema.il> <out.h> [name]\n");
         printf("  cnd lsp\n");
         printf("  cnd version\n");
         return 1;
@@ -40,14 +44,18 @@ int main(int argc, char** argv) {
     if (strcmp(argv[1], "encode") == 0) return cmd_encode(argc, argv);
     if (strcmp(argv[1], "decode") == 0) return cmd_decode(argc, argv);
     if (strcmp(argv[1], "lsp") == 0) return cmd_lsp(argc, argv);
+    if (strcmp(argv[1], "gen-c") == 0) return cmd_gen_c(argc, argv);
+    if (strcmp(argv[1], "embed") == 0) return cmd_embed(argc, argv);
     if (strcmp(argv[1], "help") == 0 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
         printf("Concordia CLI %s (%s)\n", CND_VERSION, CND_GIT_HASH);
         printf("Usage:\n");
-        printf("  cnd compile <in.cnd> <out.il>\n");
+        printf("  cnd compile <in.cnd> <out.il> [-O]\n");
         printf("  cnd fmt <in.cnd> [out.cnd]\n");
         printf("  cnd inspect <file.il>\n");
         printf("  cnd encode <schema.il> <in.json> <out.bin>\n");
         printf("  cnd decode <schema.il> <in.bin> <out.json>\n");
+        printf("  cnd gen-c <schema.il> <out_base>\n");
+        printf("  cnd embed <schema.il> <out.h> [name]\n");
         printf("  cnd lsp\n");
         printf("  cnd version\n");
         printf("  cnd help\n");
@@ -128,8 +128,12 @@ void buf_push_u64(Buffer* b, uint64_t val);
 void buf_write_u16_at(Buffer* b, size_t offset, uint16_t val);
 void buf_write_u32_at(Buffer* b, size_t offset, uint32_t val);
 void buf_write_u8_at(Buffer* b, size_t offset, uint8_t val);
+void buf_insert(Buffer* b, size_t offset, const uint8_t* data, size_t len);
 size_t buf_current_offset(Buffer* b);
 
+// Little-endian u16 operand of emitted IL, at any alignment
+static inline uint16_t il_get_u16(const uint8_t* b) { return (uint16_t)(b[0] | (b[1] << 8)); }
+
 // --- Utils: String Table ---
 typedef struct {
     char** strings;
@@ -145,6 +149,13 @@ uint16_t strtab_add(StringTable* t, const char* start, int len);
 void buf_append_with_prefix(Buffer* b, const uint8_t* src, size_t len, 
                             const char* prefix, int prefix_len, StringTable* strtab);
 
+// Key ID of `prefix.<name of old_key>`, added to the string table if new
+uint16_t prefixed_key(uint16_t old_key, const char* prefix, int prefix_len, StringTable* strtab);
+
+// Size of the instruction at `ins` (`avail` bytes left), or -1 if unknown.
+// *keyid_offset is the offset of its Key ID, or -1.
+int get_opcode_size_and_keyid_offset(const uint8_t* ins, size_t avail, int* keyid_offset);
+
 // --- Utils: StringBuilder ---
 typedef struct {
     char* data;
@@ -161,12 +172,18 @@ void sb_reset(StringBuilder* sb);
 char* sb_build(StringBuilder* sb);
 
 // --- Utils: Registry ---
+#define SUBR_NONE   (-1) // Subroutine not built yet
+#define SUBR_INLINE (-2) // Struct is always inlined
+
 typedef struct {
     char* name;
     Buffer bytecode;
     int line;
     char* file; // File path where defined
     char* doc_comment;
+    int32_t subr_at;          // Subroutine body offset in Parser.subr_bc, or SUBR_*
+    uint16_t* subr_keys;      // Key IDs of the body's local keys
+    uint16_t subr_key_count;
 } StructDef;
 
 typedef struct {
@@ -209,6 +226,40 @@ void enum_reg_free(EnumRegistry* r);
 EnumDef* enum_reg_add(EnumRegistry* r, const char* name, int len, int line, const char* file, const char* doc);
 EnumDef* enum_reg_find(EnumRegistry* r, const char* name, int len);
 
+// --- Static Layout (cnd_layout.c) ---
+
+// Builds the IL layout section for `bc`: one entry per scalar field whose bit
+// offset does not depend on the data. Entries are appended to `out`.
+void layout_build(const uint8_t* bc, size_t len, uint16_t key_count, Buffer* out, uint16_t* out_count);
+
+// --- Switch Tables (cnd_switch.c) ---
+
+typedef struct {
+    uint64_t val;
+    int32_t offset; // Case body, relative to the end of the switch instruction
+} SwitchCase;
+
+// Appends the jump table for `cases` (reordered as needed) and returns the
+// switch opcode that reads it. A `default_offset` of -1 targets the end of
+// the table, which is returned in `table_end`.
+uint8_t switch_emit_table(Buffer* b, SwitchCase* cases, size_t case_count,
+                          int32_t default_offset, size_t code_start_loc, size_t* table_end);
+
+// Jump tables are data placed after the code they dispatch into. Linear
+// bytecode walkers record each switch's table and step over it on arrival.
+#define CND_MAX_PENDING_TABLES 64
+
+typedef struct {
+    size_t start[CND_MAX_PENDING_TABLES];
+    size_t end[CND_MAX_PENDING_TABLES];
+    int count;
+} SwitchTables;
+
+// Records the table of the switch instruction at `ip`
+void switch_tables_add(SwitchTables* t, const uint8_t* bc, size_t len, size_t ip);
+// End of the recorded table starting at `ip` (and forgets it), or 0
+size_t switch_tables_skip(SwitchTables* t, size_t ip);
+
 // --- Parser ---
 typedef struct {
     int line;
@@ -251,12 +302,22 @@ typedef struct {
     int current_bit_count; // Bits consumed in current struct
     int is_bit_count_valid; // 1 if bit count is deterministic, 0 if dynamic (loops/ifs)
 
+    // Bitfield Grouping: last bitfield instruction emitted into `target`
+    size_t bit_group_at;   // Offset of that OP_IO_BIT_* or OP_IO_BIT_GROUP
+    size_t bit_group_end;  // Offset just past it (0 if the next bitfield starts a new run)
+    int bit_group_bits;    // Bits covered so far
+
     // Field Name Prefix for nested structs (e.g., "position." when inside Vec3 position)
     char field_prefix[256];
     int field_prefix_len;
 
     CompilerError* errors; // List of errors for LSP
     size_t error_cap;
+
+    // Struct Subroutines
+    int subroutines;   // Flag: call struct fields of the packet instead of inlining them
+    Buffer subr_bc;    // Subroutine bodies, in the order they were built
+    size_t subr_calls; // OP_CALLs emitted into the packet
 } Parser;
 
 // Returns a newly-allocated canonicalized path string for de-duplication.
@@ -270,6 +331,26 @@ int match_keyword(Token t, const char* kw);
 
 void parse_top_level(Parser* p);
 
+// --- Struct Subroutines (cnd_subr.c) ---
+
+// Emits an OP_CALL to the subroutine of `def` for the packet field `name`
+// (after its OP_ENTER_STRUCT). Returns 0 if the struct must be inlined.
+int subr_emit_call(Parser* p, StructDef* def, const char* name, int name_len);
+// Appends the subroutine bodies behind the packet and resolves the calls.
+// Runs once the string table is final.
+void subr_link(Parser* p);
+
+// --- IL Optimizer (cnd_opt.c) ---
+
+typedef struct {
+    size_t bytes_before, bytes_after;
+    size_t insns_before, insns_after;
+} OptStats;
+
+// Rewrites the linked program in `bc` (see cnd_opt.c). Returns 0, leaving
+// `bc` as it is, if the bytecode cannot be decoded.
+int il_optimize(Buffer* bc, OptStats* stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,340 @@
+#include "cnd_internal.h"
+
+// --- Static Layout Analysis ---
+//
+// Walks the final packet bytecode from the start and records the bit position
+// of each scalar field, up to the first instruction whose effect on the data
+// cursor depends on the data itself (strings, prefixed/EOF/dynamic arrays,
+// conditionals, switches). Fixed-count arrays are stepped over when their
+// body has a fixed size. Struct subroutines are walked at each OP_CALL with
+// their key base applied. When a key occurs more than once (array elements)
+// its first occurrence is recorded, matching what a decode scan would find.
+
+#define LAYOUT_NONE (-1)
+
+// What ends a walk (see layout_walk)
+#define LAYOUT_TOP  0 // End of the bytecode or top-level OP_RET
+#define LAYOUT_LOOP 1 // OP_ARR_END of the loop body
+#define LAYOUT_CALL 2 // OP_RET of the subroutine
+
+typedef struct {
+    int64_t bit;   // Bit offset, or LAYOUT_NONE
+    uint8_t type;  // Wire opcode (OP_IO_* or OP_IO_BIT_*)
+    uint8_t info;  // Width in bits | CND_LAYOUT_BE
+} LayoutSlot;
+
+typedef struct {
+    uint64_t bit;        // Current data position in bits
+    int big_endian;
+    int record;          // 0 while sizing a loop body that never runs
+    uint16_t key_base;   // Key base of the subroutine being walked
+    uint8_t call_depth;
+    LayoutSlot* slots;   // Indexed by Key ID
+    uint16_t key_count;
+} LayoutState;
+
+static uint32_t layout_type_size(uint8_t type) {
+    switch (type) {
+        case OP_IO_U8: case OP_IO_I8: case OP_IO_BOOL: return 1;
+        case OP_IO_U16: case OP_IO_I16: return 2;
+        case OP_IO_U32: case OP_IO_I32: case OP_IO_F32: return 4;
+        case OP_IO_U64: case OP_IO_I64: case OP_IO_F64: return 8;
+        default: return 0;
+    }
+}
+
+static uint16_t layout_u16(const uint8_t* b) { return (uint16_t)(b[0] | (b[1] << 8)); }
+static uint32_t layout_u32(const uint8_t* b) {
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static void layout_align(LayoutState* s) {
+    s->bit = (s->bit + 7) & ~(uint64_t)7;
+}
+
+static void layout_field(LayoutState* s, uint16_t key, uint8_t type, uint8_t width) {
+    key = (uint16_t)(key + s->key_base);
+    if (!s->record || key >= s->key_count) return;
+    LayoutSlot* slot = &s->slots[key];
+    if (slot->bit != LAYOUT_NONE) return; // First occurrence wins
+    if (s->bit > 0xFFFFFFFFu) return;
+    slot->bit = (int64_t)s->bit;
+    slot->type = type;
+    slot->info = (uint8_t)(width | (s->big_endian ? CND_LAYOUT_BE : 0));
+}
+
+static void layout_primitive(LayoutState* s, uint8_t type, uint16_t key) {
+    uint32_t size = layout_type_size(type);
+    layout_align(s);
+    layout_field(s, key, type, (uint8_t)(size * 8));
+    s->bit += (uint64_t)size * 8;
+}
+
+// Walks from `ip` until the end of the program, the ARR_END closing the
+// current loop body, the OP_RET closing the current subroutine (`until`), or
+// the first data-dependent instruction. Returns the offset where the walk
+// stopped; *complete is 0 in the last case.
+static size_t layout_walk(const uint8_t* bc, size_t len, size_t ip, LayoutState* s, int until, int* complete) {
+    *complete = 0;
+    while (ip < len) {
+        uint8_t op = bc[ip];
+        size_t n;
+
+        if (op >= OP_IO_U8 && op <= OP_IO_BOOL) {
+            if (ip + 3 > len) return ip;
+            layout_primitive(s, op, layout_u16(bc + ip + 1));
+            ip += 3;
+            continue;
+        }
+        if (op == OP_IO_SLOT) {
+            if (ip + 4 > len || layout_type_size(bc[ip + 1]) == 0) return ip;
+            layout_primitive(s, bc[ip + 1], layout_u16(bc + ip + 2));
+            ip += 4;
+            continue;
+        }
+        if (op == OP_IO_CHECK) {
+            // The field, then the embedded check as the next instruction
+            if (ip + 4 > len || layout_type_size(bc[ip + 1]) == 0) return ip;
+            layout_primitive(s, bc[ip + 1], layout_u16(bc + ip + 2));
+            ip += 4;
+            continue;
+        }
+
+        switch (op) {
+            case OP_NOOP: case OP_EXIT_STRUCT: case OP_ENTER_BIT_MODE: case OP_EXIT_BIT_MODE:
+            case OP_MARK_OPTIONAL: case OP_CRC_BEGIN: case OP_CRC_END:
+                n = 1; break;
+            case OP_SET_ENDIAN_LE: s->big_endian = 0; n = 1; break;
+            case OP_SET_ENDIAN_BE: s->big_endian = 1; n = 1; break;
+            case OP_META_VERSION: n = 2; break;
+            case OP_META_NAME: case OP_ENTER_STRUCT: n = 3; break;
+
+            case OP_IO_BIT_U: case OP_IO_BIT_I: case OP_IO_BIT_BOOL: {
+                if (ip + 4 > len) return ip;
+                uint8_t width = (op == OP_IO_BIT_BOOL) ? 1 : bc[ip + 3];
+                if (width == 0 || width > 64) return ip;
+                layout_field(s, layout_u16(bc + ip + 1), op, width);
+                s->bit += width;
+                n = 4;
+                break;
+            }
+            case OP_IO_RUN: {
+                if (ip + 4 > len) return ip;
+                uint8_t count = bc[ip + 1];
+                n = 4 + (size_t)count * 3;
+                if (ip + n > len) return ip;
+                for (uint8_t i = 0; i < count; i++) {
+                    const uint8_t* f = bc + ip + 4 + (size_t)i * 3;
+                    if (layout_type_size(f[0]) == 0) return ip;
+                    layout_primitive(s, f[0], layout_u16(f + 1));
+                }
+                break;
+            }
+            case OP_IO_BIT_GROUP: {
+                if (ip + 2 > len) return ip;
+                uint8_t count = bc[ip + 1];
+                if (ip + 2 + (size_t)count * 4 > len) return ip;
+                for (uint8_t i = 0; i < count; i++) {
+                    const uint8_t* f = bc + ip + 2 + (size_t)i * 4;
+                    if (f[3] == 0 || f[3] > 64) return ip;
+                    layout_field(s, layout_u16(f + 1), f[0], f[3]);
+                    s->bit += f[3];
+                }
+                n = 2 + (size_t)count * 4;
+                break;
+            }
+            case OP_ALIGN_PAD:
+                if (ip + 2 > len) return ip;
+                s->bit += bc[ip + 1];
+                n = 2;
+                break;
+            case OP_ALIGN_FILL:
+                layout_align(s);
+                n = 2;
+                break;
+
+            case OP_CONST_CHECK: {
+                if (ip + 4 > len) return ip;
+                uint32_t size = layout_type_size(bc[ip + 3]);
+                if (size == 0) return ip;
+                layout_align(s);
+                layout_field(s, layout_u16(bc + ip + 1), bc[ip + 3], (uint8_t)(size * 8));
+                s->bit += (uint64_t)size * 8;
+                n = 4 + size;
+                break;
+            }
+            case OP_CONST_WRITE: {
+                if (ip + 2 > len) return ip;
+                uint32_t size = layout_type_size(bc[ip + 1]);
+                if (size == 0) return ip;
+                layout_align(s);
+                s->bit += (uint64_t)size * 8;
+                n = 2 + size;
+                break;
+            }
+            case OP_RANGE_CHECK: {
+                if (ip + 2 > len) return ip;
+                uint32_t size = layout_type_size(bc[ip + 1]);
+                if (size == 0) return ip;
+                n = 2 + 2 * size;
+                break;
+            }
+            case OP_ENUM_CHECK:
+            case OP_ENUM_SORTED: {
+                if (ip + 4 > len) return ip;
+                uint32_t size = layout_type_size(bc[ip + 1]);
+                if (size == 0) return ip;
+                layout_align(s);
+                n = 4 + (size_t)layout_u16(bc + ip + 2) * size;
+                break;
+            }
+            case OP_ENUM_BITMAP: {
+                if (ip + 2 > len) return ip;
+                uint32_t size = layout_type_size(bc[ip + 1]);
+                if (size == 0 || ip + 4 + size > len) return ip;
+                layout_align(s);
+                n = 4 + size + ((size_t)layout_u16(bc + ip + 2 + size) + 7) / 8;
+                break;
+            }
+            case OP_CRC_16: layout_align(s); s->bit += 16; n = 8; break;
+            case OP_CRC_32: layout_align(s); s->bit += 32; n = 14; break;
+
+            case OP_SCALE_LIN: n = 17; break;
+            case OP_TRANS_ADD: case OP_TRANS_SUB: case OP_TRANS_MUL: case OP_TRANS_DIV: n = 9; break;
+            case OP_TRANS_POLY:
+                if (ip + 2 > len) return ip;
+                layout_align(s);
+                n = 2 + (size_t)bc[ip + 1] * 8;
+                break;
+            case OP_TRANS_SPLINE:
+                if (ip + 2 > len) return ip;
+                layout_align(s);
+                n = 2 + (size_t)bc[ip + 1] * 16;
+                break;
+
+            case OP_RAW_BYTES:
+                if (ip + 7 > len) return ip;
+                layout_align(s);
+                s->bit += (uint64_t)layout_u32(bc + ip + 3) * 8;
+                n = 7;
+                break;
+
+            case OP_ARR_FIXED: {
+                if (ip + 7 > len) return ip;
+                uint32_t count = layout_u32(bc + ip + 3);
+                layout_align(s);
+
+                uint64_t start = s->bit;
+                int saved_endian = s->big_endian;
+                int saved_record = s->record;
+                if (count == 0) s->record = 0;
+
+                int body_complete;
+                size_t body_end = layout_walk(bc, len, ip + 7, s, LAYOUT_LOOP, &body_complete);
+                s->record = saved_record;
+                if (!body_complete) return body_end;
+
+                // Every iteration must start byte aligned for the body to repeat exactly
+                uint64_t body_bits = s->bit - start;
+                if (body_bits % 8 != 0) return ip;
+                s->bit = start + body_bits * count;
+                if (count == 0) s->big_endian = saved_endian;
+                ip = body_end + 1;
+                continue;
+            }
+            case OP_ARR_END:
+                if (until != LAYOUT_LOOP) return ip;
+                *complete = 1;
+                return ip;
+
+            case OP_CALL: {
+                if (ip + 9 > len || s->call_depth >= CND_MAX_CALL_DEPTH) return ip;
+                int64_t target = (int64_t)(ip + 9) + (int32_t)layout_u32(bc + ip + 5);
+                if (target < 0 || (uint64_t)target >= len) return ip;
+
+                uint16_t saved_base = s->key_base;
+                s->key_base = (uint16_t)(s->key_base + layout_u16(bc + ip + 1));
+                s->call_depth++;
+                int body_complete;
+                layout_walk(bc, len, (size_t)target, s, LAYOUT_CALL, &body_complete);
+                s->call_depth--;
+                s->key_base = saved_base;
+                if (!body_complete) return ip;
+                n = 9;
+                break;
+            }
+            case OP_RET:
+                if (until == LAYOUT_LOOP) return ip;
+                *complete = 1;
+                return ip;
+
+            // Expression fields: DUP, STORE_CTX(key), EMIT(type)
+            case OP_LOAD_CTX: n = 3; break;
+            case OP_PUSH_IMM: n = 9; break;
+            case OP_EXPR:
+                if (ip + 2 > len) return ip;
+                n = 2 + (size_t)bc[ip + 1];
+                break;
+            case OP_STORE_CTX: {
+                if (ip + 3 > len) return ip;
+                if (ip + 5 <= len && bc[ip + 3] == OP_EMIT) {
+                    uint32_t size = layout_type_size(bc[ip + 4]);
+                    if (size == 0 || (s->bit % 8) != 0) return ip;
+                    layout_field(s, layout_u16(bc + ip + 1), bc[ip + 4], (uint8_t)(size * 8));
+                }
+                n = 3;
+                break;
+            }
+            case OP_EMIT: {
+                if (ip + 2 > len) return ip;
+                uint32_t size = layout_type_size(bc[ip + 1]);
+                if (size == 0 || (s->bit % 8) != 0) return ip;
+                s->bit += (uint64_t)size * 8;
+                n = 2;
+                break;
+            }
+
+            default:
+                // Stack ALU ops move no data; everything else is data dependent
+                if ((op >= OP_POP && op <= OP_DUP) || (op >= OP_EQ && op <= OP_NEG) ||
+                    (op >= OP_FADD && op <= OP_ABS) || (op >= OP_ITOF && op <= OP_LTE_F) ||
+                    (op >= OP_BIT_AND && op <= OP_SHR)) {
+                    n = 1;
+                    break;
+                }
+                return ip;
+        }
+
+        if (ip + n > len) return ip;
+        ip += n;
+    }
+    *complete = (until == LAYOUT_TOP);
+    return ip;
+}
+
+void layout_build(const uint8_t* bc, size_t len, uint16_t key_count, Buffer* out, uint16_t* out_count) {
+    *out_count = 0;
+    if (key_count == 0) return;
+
+    LayoutState s;
+    memset(&s, 0, sizeof(s));
+    s.record = 1;
+    s.key_count = key_count;
+    s.slots = malloc(key_count * sizeof(LayoutSlot));
+    if (!s.slots) return;
+    for (uint16_t i = 0; i < key_count; i++) s.slots[i].bit = LAYOUT_NONE;
+
+    int complete;
+    layout_walk(bc, len, 0, &s, LAYOUT_TOP, &complete);
+
+    // Entries sorted by Key ID: Key(2) Type(1) Info(1) BitOffset(4)
+    for (uint16_t i = 0; i < key_count; i++) {
+        if (s.slots[i].bit == LAYOUT_NONE) continue;
+        buf_push_u16(out, i);
+        buf_push(out, s.slots[i].type);
+        buf_push(out, s.slots[i].info);
+        buf_push_u32(out, (uint32_t)s.slots[i].bit);
+        (*out_count)++;
+    }
+    free(s.slots);
+}
@@ -0,0 +1,1269 @@
+#include "cnd_internal.h"
+
+// --- IL Optimizer ---
+//
+// Runs on the linked program (packet, then subroutine bodies) for `cnd
+// compile -O`. The bytecode is decoded into an instruction list whose
+// branches refer to instructions rather than offsets, rewritten until nothing
+// changes, and emitted again with fresh offsets:
+//
+// - Peephole: no-ops, jumps to the next instruction and byte order sets
+//   overridden by the next instruction are dropped; adjacent @pad and @fill
+//   are merged.
+// - Byte order: OP_SET_ENDIAN_* that set the order already in effect on
+//   every path reaching them are dropped.
+// - Constant folding: integer and IEEE float arithmetic, comparisons and
+//   conversions on PUSH_IMM operands. Math library calls (absent from
+//   CND_NO_MATH builds) and operations that fail at run time stay in the VM.
+// - @const propagation: a switch or expression reading an unsigned @const
+//   field that every path to it has decoded uses the constant. The switch
+//   becomes a jump to its arm, and conditions on it fold. Hosts are assumed
+//   to report @const fields with their value.
+// - Jump threading: branches to an unconditional jump go to its target.
+// - Dead code: instructions no path reaches are removed, including the other
+//   arms of folded switches and conditions.
+// - Scoreboard slots, once nothing else changes: an integer or bool field
+//   that dominates every switch, dynamic count and expression reading it in
+//   its region becomes OP_IO_SLOT, so those reads skip the host.
+// - Superinstructions: a field followed by its
+//   range or enum check becomes OP_IO_CHECK, and runs of primitive fields
+//   become OP_IO_RUN, which the VM bounds-checks once.
+// - Register expressions, last: an expression that loads a context value
+//   becomes one OP_EXPR, evaluated in typed registers (see concordia.h).
+//
+// Bytecode the decoder does not understand is left as it is.
+
+#define OPT_NONE (-1)
+#define OPT_NO_OFFSET ((size_t)-1)
+#define OPT_MAX_PASSES 16
+#define OPT_MAX_HOPS 16
+#define OPT_MAX_RUN 255
+
+enum { OPT_INSN, OPT_TABLE };
+enum { ORDER_UNSEEN, ORDER_LE, ORDER_BE, ORDER_VARIES };
+
+typedef struct {
+    size_t at;         // Offset in the input
+    size_t new_at;     // Offset in the output
+    size_t target_at;  // Decoded branch target offset, until resolved
+    uint64_t imm;      // Operand of a rewritten PUSH_IMM or ALIGN_PAD, Count | Bytes << 8 of an OP_IO_RUN
+    uint32_t size;
+    uint8_t op;        // Switch opcode for tables
+    uint8_t kind;      // OPT_INSN or OPT_TABLE
+    uint8_t dead;
+    uint8_t rewritten; // Encoded from op / imm / target instead of the input
+    uint8_t absorbed;  // Dead, but emitted as part of a superinstruction
+    int32_t target;    // Branch or call target
+    int32_t link;      // Switch <-> table, array start -> past its ARR_END, ARR_END -> array start,
+                       // superinstruction -> its last part
+    uint32_t first_case, case_count; // Tables: entries in Opt.cases, default first
+} OptInsn;
+
+typedef struct {
+    size_t target_at;
+    uint64_t val;
+    uint32_t field;    // Offset(4) field within the table
+    int32_t target;
+} OptCase;
+
+typedef struct {
+    const uint8_t* src;
+    size_t len;
+    OptInsn* insns;
+    size_t count, cap;
+    OptCase* cases;
+    size_t case_total, case_cap;
+
+    uint8_t* is_target;  // Some branch lands on the instruction
+    uint32_t* seen;      // Walk marks, compared against `gen`
+    uint32_t gen;
+    int32_t* queue;
+    int32_t* succ;
+    int32_t* region;     // First instruction of the packet or subroutine
+    uint8_t* order;      // Byte order on entry
+    Buffer exprs;        // Register programs of OP_EXPRs, at their `imm`
+    int changed;
+} Opt;
+
+static uint64_t opt_get(const uint8_t* p, int size) {
+    uint64_t v = 0;
+    for (int i = size - 1; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static int32_t opt_add(Opt* o, size_t at, uint32_t size, uint8_t op, uint8_t kind) {
+    if (o->count == o->cap) {
+        size_t cap = o->cap ? o->cap * 2 : 64;
+        OptInsn* insns = realloc(o->insns, cap * sizeof(OptInsn));
+        if (!insns) return OPT_NONE;
+        o->insns = insns;
+        o->cap = cap;
+    }
+    OptInsn* in = &o->insns[o->count];
+    memset(in, 0, sizeof(*in));
+    in->at = at;
+    in->size = size;
+    in->op = op;
+    in->kind = kind;
+    in->target = OPT_NONE;
+    in->link = OPT_NONE;
+    in->target_at = OPT_NO_OFFSET;
+    return (int32_t)o->count++;
+}
+
+static int opt_add_case(Opt* o, size_t base, uint32_t field, uint64_t val, const uint8_t* table) {
+    if (o->case_total == o->case_cap) {
+        size_t cap = o->case_cap ? o->case_cap * 2 : 64;
+        OptCase* cases = realloc(o->cases, cap * sizeof(OptCase));
+        if (!cases) return 0;
+        o->cases = cases;
+        o->case_cap = cap;
+    }
+    int32_t rel = (int32_t)(uint32_t)opt_get(table + field, 4);
+    if (rel < 0 && (size_t)(-(int64_t)rel) > base) return 0;
+    OptCase* c = &o->cases[o->case_total++];
+    c->target_at = (size_t)((int64_t)base + rel);
+    c->val = val;
+    c->field = field;
+    c->target = OPT_NONE;
+    return 1;
+}
+
+// Size of the table of switch `op` at `h`, 0 if malformed
+static size_t opt_table_size(uint8_t op, const uint8_t* h, size_t avail) {
+    uint64_t size = 0;
+    switch (op) {
+        case OP_SWITCH:
+        case OP_SWITCH_SORTED:
+            if (avail < 6) return 0;
+            size = 6 + opt_get(h, 2) * 12;
+            break;
+        case OP_SWITCH_TABLE: {
+            if (avail < 20) return 0;
+            uint64_t min_val = opt_get(h, 8), max_val = opt_get(h + 8, 8);
+            if (max_val < min_val || max_val - min_val >= 0xFFFFFFFF) return 0;
+            size = 20 + (max_val - min_val + 1) * 4;
+            break;
+        }
+        case OP_SWITCH_HASH:
+            if (avail < 14 || h[12] > 16 || h[13] > 16) return 0;
+            size = 14 + ((uint64_t)2 << h[13]) + ((uint64_t)12 << h[12]);
+            break;
+        default:
+            return 0;
+    }
+    return size <= avail ? (size_t)size : 0;
+}
+
+// Records the entries of table `t`, default first. Case offsets are relative
+// to the end of the switch instruction.
+static int opt_table_cases(Opt* o, int32_t t) {
+    OptInsn* table = &o->insns[t];
+    const uint8_t* h = o->src + table->at;
+    size_t base = o->insns[table->link].at + 7;
+    table->first_case = (uint32_t)o->case_total;
+
+    switch (table->op) {
+        case OP_SWITCH:
+        case OP_SWITCH_SORTED: {
+            uint64_t n = opt_get(h, 2);
+            if (!opt_add_case(o, base, 2, 0, h)) return 0;
+            for (uint64_t k = 0; k < n; k++) {
+                uint32_t e = (uint32_t)(6 + k * 12);
+                if (!opt_add_case(o, base, e + 8, opt_get(h + e, 8), h)) return 0;
+            }
+            break;
+        }
+        case OP_SWITCH_TABLE: {
+            uint64_t min_val = opt_get(h, 8), range = opt_get(h + 8, 8) - min_val;
+            if (!opt_add_case(o, base, 16, 0, h)) return 0;
+            for (uint64_t k = 0; k <= range; k++) {
+                if (!opt_add_case(o, base, (uint32_t)(20 + k * 4), min_val + k, h)) return 0;
+            }
+            break;
+        }
+        case OP_SWITCH_HASH: {
+            size_t slots = (size_t)1 << h[12];
+            size_t buckets = (size_t)1 << h[13];
+            if (!opt_add_case(o, base, 0, 0, h)) return 0;
+            for (size_t k = 0; k < slots; k++) {
+                uint32_t e = (uint32_t)(14 + buckets * 2 + k * 12);
+                if (!opt_add_case(o, base, e + 8, opt_get(h + e, 8), h)) return 0;
+            }
+            break;
+        }
+        default:
+            return 0;
+    }
+    table->case_count = (uint32_t)(o->case_total - table->first_case);
+    return 1;
+}
+
+static int opt_is_array_start(uint8_t op) {
+    return op == OP_ARR_FIXED || op == OP_ARR_EOF || op == OP_ARR_DYNAMIC ||
+           (op >= OP_ARR_PRE_U8 && op <= OP_ARR_PRE_U32);
+}
+
+static int opt_is_switch(uint8_t op) {
+    return op == OP_SWITCH || op == OP_SWITCH_TABLE || op == OP_SWITCH_SORTED || op == OP_SWITCH_HASH;
+}
+
+// Splits the bytecode into instructions and resolves branch offsets to
+// instruction indices. Returns 0 if the bytecode cannot be decoded.
+static int opt_decode(Opt* o) {
+    const uint8_t* bc = o->src;
+    size_t len = o->len;
+    size_t pending_at[CND_MAX_PENDING_TABLES];
+    int32_t pending_switch[CND_MAX_PENDING_TABLES];
+    int pending = 0;
+    int32_t arrays[CND_MAX_LOOP_DEPTH * 4];
+    int depth = 0;
+    size_t i = 0;
+
+    while (i < len) {
+        int p = 0;
+        while (p < pending && pending_at[p] != i) p++;
+        if (p < pending) {
+            int32_t sw = pending_switch[p];
+            pending--;
+            pending_at[p] = pending_at[pending];
+            pending_switch[p] = pending_switch[pending];
+
+            size_t size = opt_table_size(o->insns[sw].op, bc + i, len - i);
+            if (size == 0) return 0;
+            int32_t t = opt_add(o, i, (uint32_t)size, o->insns[sw].op, OPT_TABLE);
+            if (t == OPT_NONE) return 0;
+            o->insns[t].link = sw;
+            o->insns[sw].link = t;
+            if (!opt_table_cases(o, t)) return 0;
+            i += size;
+            continue;
+        }
+
+        uint8_t op = bc[i];
+        size_t size;
+        if (op == OP_IO_BIT_GROUP) {
+            if (i + 2 > len) return 0;
+            size = 2 + (size_t)bc[i + 1] * 4;
+        } else {
+            int keyid_offset;
+            int n = get_opcode_size_and_keyid_offset(bc + i, len - i, &keyid_offset);
+            if (n < 0) return 0;
+            size = (size_t)n;
+        }
+        if (size > len - i) return 0;
+
+        int32_t at = opt_add(o, i, (uint32_t)size, op, OPT_INSN);
+        if (at == OPT_NONE) return 0;
+        OptInsn* in = &o->insns[at];
+
+        if (op == OP_JUMP || op == OP_JUMP_IF_NOT || op == OP_CALL) {
+            size_t end = i + size;
+            int32_t rel = (int32_t)(uint32_t)opt_get(bc + end - 4, 4);
+            if (rel < 0 && (size_t)(-(int64_t)rel) > end) return 0;
+            in->target_at = (size_t)((int64_t)end + rel);
+        } else if (opt_is_switch(op)) {
+            if (pending == CND_MAX_PENDING_TABLES) return 0;
+            pending_at[pending] = i + 7 + (size_t)opt_get(bc + i + 3, 4);
+            pending_switch[pending] = at;
+            pending++;
+        } else if (opt_is_array_start(op)) {
+            if (depth == (int)(sizeof(arrays) / sizeof(arrays[0]))) return 0;
+            arrays[depth++] = at;
+        } else if (op == OP_ARR_END) {
+            if (depth == 0) return 0;
+            int32_t start = arrays[--depth];
+            o->insns[start].link = at + 1;
+            in->link = start;
+        }
+        i += size;
+    }
+    if (pending > 0 || depth > 0) return 0;
+
+    // Offsets to instruction indices; the end of the program is `count`
+    int32_t* index = malloc((len + 1) * sizeof(int32_t));
+    if (!index) return 0;
+    for (size_t k = 0; k <= len; k++) index[k] = OPT_NONE;
+    for (size_t k = 0; k < o->count; k++) index[o->insns[k].at] = (int32_t)k;
+    index[len] = (int32_t)o->count;
+
+    int ok = 1;
+    for (size_t k = 0; k < o->count && ok; k++) {
+        OptInsn* in = &o->insns[k];
+        if (in->target_at == OPT_NO_OFFSET) continue;
+        if (in->target_at > len || index[in->target_at] == OPT_NONE) ok = 0;
+        else in->target = index[in->target_at];
+    }
+    for (size_t k = 0; k < o->case_total && ok; k++) {
+        OptCase* c = &o->cases[k];
+        if (c->target_at > len || index[c->target_at] == OPT_NONE) ok = 0;
+        else c->target = index[c->target_at];
+    }
+    free(index);
+    return ok;
+}
+
+// --- Control Flow ---
+
+// First live instruction at or after `i` (`count` past the end)
+static int32_t opt_resolve(const Opt* o, int32_t i) {
+    while (i < (int32_t)o->count && o->insns[i].dead) i++;
+    return i;
+}
+
+static int32_t opt_next(const Opt* o, int32_t i) {
+    return opt_resolve(o, i + 1);
+}
+
+// Successors of live instruction `i` into o->succ. Calls continue at the
+// next instruction; `follow_calls` also enters the subroutine.
+static size_t opt_successors(Opt* o, int32_t i, int follow_calls) {
+    const OptInsn* in = &o->insns[i];
+    size_t n = 0;
+    if (in->kind == OPT_TABLE) return 0;
+
+    switch (in->op) {
+        case OP_JUMP:
+            o->succ[n++] = opt_resolve(o, in->target);
+            break;
+        case OP_RET:
+            break;
+        case OP_JUMP_IF_NOT:
+            o->succ[n++] = opt_next(o, i);
+            o->succ[n++] = opt_resolve(o, in->target);
+            break;
+        case OP_CALL:
+            o->succ[n++] = opt_next(o, i);
+            if (follow_calls) o->succ[n++] = opt_resolve(o, in->target);
+            break;
+        case OP_ARR_END:
+            // Back to the first body instruction for the next element
+            o->succ[n++] = opt_next(o, i);
+            o->succ[n++] = opt_next(o, in->link);
+            break;
+        default:
+            if (opt_is_switch(in->op)) {
+                const OptInsn* t = &o->insns[in->link];
+                for (uint32_t c = 0; c < t->case_count; c++) {
+                    o->succ[n++] = opt_resolve(o, o->cases[t->first_case + c].target);
+                }
+            } else {
+                o->succ[n++] = opt_next(o, i);
+                // Empty arrays skip their body
+                if (opt_is_array_start(in->op)) o->succ[n++] = opt_resolve(o, in->link);
+            }
+            break;
+    }
+    return n;
+}
+
+// Marks everything reachable from `root` without passing through `avoid`
+// with the current `gen`
+static void opt_walk(Opt* o, int32_t root, int32_t avoid, int follow_calls) {
+    size_t head = 0, tail = 0;
+    if (root >= (int32_t)o->count || root == avoid) return;
+    o->seen[root] = o->gen;
+    o->queue[tail++] = root;
+    while (head < tail) {
+        int32_t i = o->queue[head++];
+        size_t n = opt_successors(o, i, follow_calls);
+        for (size_t s = 0; s < n; s++) {
+            int32_t j = o->succ[s];
+            if (j >= (int32_t)o->count || j == avoid || o->seen[j] == o->gen) continue;
+            o->seen[j] = o->gen;
+            o->queue[tail++] = j;
+        }
+    }
+}
+
+static void opt_kill(Opt* o, int32_t i) {
+    o->insns[i].dead = 1;
+    // Branches to it now land on the next instruction
+    if (o->is_target[i]) {
+        int32_t next = opt_resolve(o, i);
+        if (next < (int32_t)o->count) o->is_target[next] = 1;
+    }
+    o->changed = 1;
+}
+
+static void opt_rewrite(Opt* o, int32_t i, uint8_t op, uint32_t size) {
+    o->insns[i].op = op;
+    o->insns[i].size = size;
+    o->insns[i].rewritten = 1;
+    o->changed = 1;
+}
+
+static void opt_mark_targets(Opt* o) {
+    memset(o->is_target, 0, o->count);
+    for (size_t i = 0; i < o->count; i++) {
+        const OptInsn* in = &o->insns[i];
+        if (in->dead) continue;
+        int32_t t = OPT_NONE;
+        if (in->kind == OPT_TABLE) {
+            for (uint32_t c = 0; c < in->case_count; c++) {
+                t = opt_resolve(o, o->cases[in->first_case + c].target);
+                if (t < (int32_t)o->count) o->is_target[t] = 1;
+            }
+            continue;
+        }
+        if (in->op == OP_JUMP || in->op == OP_JUMP_IF_NOT || in->op == OP_CALL) t = opt_resolve(o, in->target);
+        else if (in->op == OP_ARR_END) t = opt_next(o, in->link);
+        else if (opt_is_array_start(in->op)) t = opt_resolve(o, in->link);
+        if (t != OPT_NONE && t < (int32_t)o->count) o->is_target[t] = 1;
+    }
+}
+
+// Assigns every live instruction to the packet (0) or to the subroutine
+// whose first instruction reaches it
+static void opt_regions(Opt* o) {
+    for (size_t i = 0; i < o->count; i++) o->region[i] = OPT_NONE;
+    int32_t root = opt_resolve(o, 0);
+    for (;;) {
+        o->gen++;
+        opt_walk(o, root, OPT_NONE, 0);
+        for (size_t i = 0; i < o->count; i++) {
+            if (o->seen[i] == o->gen && o->region[i] == OPT_NONE) o->region[i] = root;
+        }
+        // Next subroutine not yet assigned
+        root = OPT_NONE;
+        for (size_t i = 0; i < o->count && root == OPT_NONE; i++) {
+            const OptInsn* in = &o->insns[i];
+            if (in->dead || in->op != OP_CALL || in->kind != OPT_INSN || o->region[i] == OPT_NONE) continue;
+            int32_t t = opt_resolve(o, in->target);
+            if (t < (int32_t)o->count && o->region[t] == OPT_NONE) root = t;
+        }
+        if (root == OPT_NONE) break;
+    }
+}
+
+// --- Constant Folding ---
+
+static double opt_f(uint64_t bits) { double d; memcpy(&d, &bits, 8); return d; }
+static uint64_t opt_bits(double d) { uint64_t b; memcpy(&b, &d, 8); return b; }
+
+static int opt_is_unary(uint8_t op) {
+    return op == OP_NEG || op == OP_BIT_NOT || op == OP_LOG_NOT || op == OP_FNEG ||
+           op == OP_ITOF || op == OP_FTOI;
+}
+
+static int opt_is_binary(uint8_t op) {
+    return (op >= OP_ADD && op <= OP_MOD) || (op >= OP_BIT_AND && op <= OP_BIT_XOR) ||
+           op == OP_SHL || op == OP_SHR || (op >= OP_EQ && op <= OP_LOG_OR) ||
+           (op >= OP_FADD && op <= OP_FDIV) || (op >= OP_EQ_F && op <= OP_LTE_F);
+}
+
+// Same results as vm_alu; returns 0 where the VM would fail or C would not
+// define the result
+static int opt_fold_unary(uint8_t op, uint64_t a, uint64_t* r) {
+    switch (op) {
+        case OP_NEG: *r = (uint64_t)(-(int64_t)a); return 1;
+        case OP_BIT_NOT: *r = ~a; return 1;
+        case OP_LOG_NOT: *r = !a; return 1;
+        case OP_FNEG: *r = opt_bits(-opt_f(a)); return 1;
+        case OP_ITOF: *r = opt_bits((double)(int64_t)a); return 1;
+        case OP_FTOI: {
+            double f = opt_f(a);
+            if (!(f > -9223372036854775808.0 && f < 9223372036854775808.0)) return 0;
+            *r = (uint64_t)(int64_t)f;
+            return 1;
+        }
+        default: return 0;
+    }
+}
+
+static int opt_fold_binary(uint8_t op, uint64_t a, uint64_t b, uint64_t* r) {
+    double fa = opt_f(a), fb = opt_f(b);
+    switch (op) {
+        case OP_ADD: *r = a + b; return 1;
+        case OP_SUB: *r = a - b; return 1;
+        case OP_MUL: *r = a * b; return 1;
+        case OP_DIV: if (b == 0) return 0; *r = a / b; return 1;
+        case OP_MOD: if (b == 0) return 0; *r = a % b; return 1;
+        case OP_BIT_AND: *r = a & b; return 1;
+        case OP_BIT_OR: *r = a | b; return 1;
+        case OP_BIT_XOR: *r = a ^ b; return 1;
+        case OP_SHL: if (b >= 64) return 0; *r = a << b; return 1;
+        case OP_SHR: if (b >= 64) return 0; *r = a >> b; return 1;
+        case OP_EQ: *r = a == b; return 1;
+        case OP_NEQ: *r = a != b; return 1;
+        case OP_GT: *r = a > b; return 1;
+        case OP_LT: *r = a < b; return 1;
+        case OP_GTE: *r = a >= b; return 1;
+        case OP_LTE: *r = a <= b; return 1;
+        case OP_LOG_AND: *r = a && b; return 1;
+        case OP_LOG_OR: *r = a || b; return 1;
+        case OP_FADD: *r = opt_bits(fa + fb); return 1;
+        case OP_FSUB: *r = opt_bits(fa - fb); return 1;
+        case OP_FMUL: *r = opt_bits(fa * fb); return 1;
+        case OP_FDIV: if (fb == 0.0) return 0; *r = opt_bits(fa / fb); return 1;
+        case OP_EQ_F: *r = fa == fb; return 1;
+        case OP_NEQ_F: *r = fa != fb; return 1;
+        case OP_GT_F: *r = fa > fb; return 1;
+        case OP_LT_F: *r = fa < fb; return 1;
+        case OP_GTE_F: *r = fa >= fb; return 1;
+        case OP_LTE_F: *r = fa <= fb; return 1;
+        default: return 0;
+    }
+}
+
+static uint64_t opt_imm(const Opt* o, int32_t i) {
+    const OptInsn* in = &o->insns[i];
+    return in->rewritten ? in->imm : opt_get(o->src + in->at + 1, 8);
+}
+
+static int opt_is_push(const Opt* o, int32_t i) {
+    return i < (int32_t)o->count && o->insns[i].kind == OPT_INSN && o->insns[i].op == OP_PUSH_IMM;
+}
+
+static void opt_set_push(Opt* o, int32_t i, uint64_t v) {
+    opt_rewrite(o, i, OP_PUSH_IMM, 9);
+    o->insns[i].imm = v;
+}
+
+// Folds the operation reached by falling through from the PUSH_IMM at `i`
+static void opt_fold_at(Opt* o, int32_t i) {
+    int32_t j = opt_next(o, i);
+    if (j >= (int32_t)o->count || o->is_target[j] || o->insns[j].kind != OPT_INSN) return;
+    uint64_t a = opt_imm(o, i), r;
+    uint8_t op = o->insns[j].op;
+
+    if (opt_is_unary(op)) {
+        if (!opt_fold_unary(op, a, &r)) return;
+        opt_set_push(o, i, r);
+        opt_kill(o, j);
+    } else if (op == OP_JUMP_IF_NOT) {
+        if (a != 0) {
+            opt_kill(o, i);
+            opt_kill(o, j);
+        } else {
+            o->insns[i].target = o->insns[j].target;
+            opt_rewrite(o, i, OP_JUMP, 5);
+            opt_kill(o, j);
+        }
+    } else if (op == OP_PUSH_IMM) {
+        int32_t k = opt_next(o, j);
+        if (k >= (int32_t)o->count || o->is_target[k] || o->insns[k].kind != OPT_INSN) return;
+        if (!opt_is_binary(o->insns[k].op)) return;
+        if (!opt_fold_binary(o->insns[k].op, a, opt_imm(o, j), &r)) return;
+        opt_set_push(o, i, r);
+        opt_kill(o, j);
+        opt_kill(o, k);
+    }
+}
+
+static void opt_fold(Opt* o) {
+    for (int32_t i = 0; i < (int32_t)o->count; i++) {
+        if (!o->insns[i].dead && opt_is_push(o, i)) opt_fold_at(o, i);
+    }
+}
+
+// --- @const Propagation ---
+
+// Value of the switch arm taken for `v`. A matching entry that goes to the
+// default is ambiguous in hash tables (empty slots hold 0) and changes
+// nothing elsewhere, so only entries leaving the default count.
+static int32_t opt_switch_pick(const Opt* o, const OptInsn* table, uint64_t v) {
+    const OptCase* cases = &o->cases[table->first_case];
+    int32_t def = opt_resolve(o, cases[0].target);
+    for (uint32_t c = 1; c < table->case_count; c++) {
+        if (cases[c].val != v) continue;
+        int32_t t = opt_resolve(o, cases[c].target);
+        if (t != def) return t;
+    }
+    return def;
+}
+
+// Whether the LOAD_CTX at `i` would fold once it reads a constant
+static int opt_load_folds(const Opt* o, int32_t i) {
+    int32_t j = opt_next(o, i);
+    if (j >= (int32_t)o->count || o->is_target[j] || o->insns[j].kind != OPT_INSN) return 0;
+    uint8_t op = o->insns[j].op;
+    if (opt_is_unary(op) || op == OP_JUMP_IF_NOT) return 1;
+    if (op == OP_PUSH_IMM) {
+        int32_t k = opt_next(o, j);
+        return k < (int32_t)o->count && !o->is_target[k] && o->insns[k].kind == OPT_INSN &&
+               opt_is_binary(o->insns[k].op);
+    }
+    if (opt_is_binary(op) && !o->is_target[i]) {
+        // Previous live instruction pushes the other operand
+        int32_t p = i - 1;
+        while (p >= 0 && o->insns[p].dead) p--;
+        return p >= 0 && opt_is_push(o, p);
+    }
+    return 0;
+}
+
+static int opt_key_of(const Opt* o, int32_t i, uint16_t* key) {
+    const OptInsn* in = &o->insns[i];
+    int keyid_offset;
+    if (in->kind != OPT_INSN || in->rewritten || in->op == OP_IO_BIT_GROUP) return 0;
+    if (get_opcode_size_and_keyid_offset(o->src + in->at, o->len - in->at, &keyid_offset) < 0 || keyid_offset < 0) return 0;
+    *key = (uint16_t)opt_get(o->src + in->at + keyid_offset, 2);
+    return 1;
+}
+
+// The only field named `key` in its region is the one at `c`, and it is not
+// @optional
+static int opt_sole_field(const Opt* o, int32_t c, uint16_t key) {
+    // An @optional field can be missing
+    int32_t p = c - 1;
+    while (p >= 0 && (o->insns[p].dead || o->insns[p].op == OP_SET_ENDIAN_LE || o->insns[p].op == OP_SET_ENDIAN_BE)) p--;
+    if (p >= 0 && o->insns[p].kind == OPT_INSN && o->insns[p].op == OP_MARK_OPTIONAL) return 0;
+
+    for (int32_t i = 0; i < (int32_t)o->count; i++) {
+        const OptInsn* in = &o->insns[i];
+        if (i == c || in->dead || in->kind != OPT_INSN || o->region[i] != o->region[c]) continue;
+        if (in->op == OP_IO_BIT_GROUP) {
+            const uint8_t* f = o->src + in->at + 2;
+            for (uint8_t k = 0; k < o->src[in->at + 1]; k++) {
+                if (opt_get(f + k * 4 + 1, 2) == key) return 0;
+            }
+            continue;
+        }
+        uint16_t k;
+        if (in->op == OP_LOAD_CTX || opt_is_switch(in->op)) continue;
+        if (opt_key_of(o, i, &k) && k == key) return 0;
+    }
+    return 1;
+}
+
+static void opt_propagate_consts(Opt* o) {
+    opt_regions(o);
+    for (int32_t c = 0; c < (int32_t)o->count; c++) {
+        const OptInsn* in = &o->insns[c];
+        if (in->dead || in->kind != OPT_INSN || in->rewritten || in->op != OP_CONST_CHECK) continue;
+        if (o->region[c] == OPT_NONE) continue;
+        const uint8_t* s = o->src + in->at;
+        uint8_t type = s[3];
+        if (type != OP_IO_U8 && type != OP_IO_U16 && type != OP_IO_U32 && type != OP_IO_U64) continue;
+        uint16_t key = (uint16_t)opt_get(s + 1, 2);
+        uint64_t value = opt_get(s + 4, (int)in->size - 4);
+        if (!opt_sole_field(o, c, key)) continue;
+
+        // Uses reachable without passing the field are not dominated by it
+        o->gen++;
+        opt_walk(o, o->region[c], c, 0);
+        for (int32_t u = 0; u < (int32_t)o->count; u++) {
+            OptInsn* use = &o->insns[u];
+            uint16_t k;
+            if (use->dead || use->kind != OPT_INSN || o->region[u] != o->region[c]) continue;
+            if (o->seen[u] == o->gen) continue;
+            if (!opt_key_of(o, u, &k) || k != key) continue;
+
+            if (opt_is_switch(use->op)) {
+                int32_t table = use->link;
+                use->target = opt_switch_pick(o, &o->insns[table], value);
+                opt_rewrite(o, u, OP_JUMP, 5);
+                opt_kill(o, table);
+            } else if (use->op == OP_LOAD_CTX && opt_load_folds(o, u)) {
+                opt_set_push(o, u, value);
+            }
+        }
+    }
+}
+
+// --- Peephole ---
+
+static int opt_is_order(const Opt* o, int32_t i) {
+    return i < (int32_t)o->count && o->insns[i].kind == OPT_INSN &&
+           (o->insns[i].op == OP_SET_ENDIAN_LE || o->insns[i].op == OP_SET_ENDIAN_BE);
+}
+
+static uint8_t opt_pad_bits(const Opt* o, int32_t i) {
+    const OptInsn* in = &o->insns[i];
+    return in->rewritten ? (uint8_t)in->imm : o->src[in->at + 1];
+}
+
+static void opt_peephole(Opt* o) {
+    for (int32_t i = 0; i < (int32_t)o->count; i++) {
+        OptInsn* in = &o->insns[i];
+        if (in->dead || in->kind != OPT_INSN) continue;
+        int32_t next = opt_next(o, i);
+        int next_plain = next < (int32_t)o->count && !o->is_target[next] && o->insns[next].kind == OPT_INSN;
+
+        switch (in->op) {
+            case OP_NOOP:
+                opt_kill(o, i);
+                break;
+
+            case OP_JUMP:
+            case OP_JUMP_IF_NOT: {
+                // Thread through unconditional jumps
+                int32_t t = opt_resolve(o, in->target);
+                for (int hops = 0; hops < OPT_MAX_HOPS && t < (int32_t)o->count && t != i; hops++) {
+                    const OptInsn* d = &o->insns[t];
+                    if (d->kind != OPT_INSN || d->op != OP_JUMP) break;
+                    t = opt_resolve(o, d->target);
+                }
+                if (t != opt_resolve(o, in->target)) {
+                    in->target = t;
+                    if (t < (int32_t)o->count) o->is_target[t] = 1;
+                    o->changed = 1;
+                }
+                if (t == next) {
+                    if (in->op == OP_JUMP) opt_kill(o, i);
+                    else opt_rewrite(o, i, OP_POP, 1);
+                } else if (in->op == OP_JUMP && t < (int32_t)o->count &&
+                           o->insns[t].kind == OPT_INSN && o->insns[t].op == OP_RET) {
+                    opt_rewrite(o, i, OP_RET, 1);
+                }
+                break;
+            }
+
+            case OP_SET_ENDIAN_LE:
+            case OP_SET_ENDIAN_BE:
+                // Overridden before anything reads it
+                if (opt_is_order(o, next)) opt_kill(o, i);
+                break;
+
+            case OP_ALIGN_PAD: {
+                uint8_t bits = opt_pad_bits(o, i);
+                if (bits == 0) { opt_kill(o, i); break; }
+                if (next_plain && o->insns[next].op == OP_ALIGN_PAD) {
+                    unsigned sum = (unsigned)bits + opt_pad_bits(o, next);
+                    if (sum <= 255) {
+                        opt_rewrite(o, i, OP_ALIGN_PAD, 2);
+                        in->imm = sum;
+                        opt_kill(o, next);
+                    }
+                }
+                break;
+            }
+
+            case OP_ALIGN_FILL:
+                // Already aligned after the first
+                if (next_plain && o->insns[next].op == OP_ALIGN_FILL) opt_kill(o, next);
+                break;
+        }
+    }
+
+    // Switch arms
+    for (size_t i = 0; i < o->count; i++) {
+        OptInsn* t = &o->insns[i];
+        if (t->dead || t->kind != OPT_TABLE) continue;
+        for (uint32_t c = 0; c < t->case_count; c++) {
+            OptCase* e = &o->cases[t->first_case + c];
+            int32_t to = opt_resolve(o, e->target);
+            int32_t final = to;
+            for (int hops = 0; hops < OPT_MAX_HOPS && final < (int32_t)o->count; hops++) {
+                const OptInsn* d = &o->insns[final];
+                if (d->kind != OPT_INSN || d->op != OP_JUMP) break;
+                final = opt_resolve(o, d->target);
+            }
+            if (final != to) {
+                e->target = final;
+                if (final < (int32_t)o->count) o->is_target[final] = 1;
+                o->changed = 1;
+            }
+        }
+    }
+}
+
+// --- Byte Order ---
+
+static uint8_t opt_join(uint8_t a, uint8_t b) {
+    if (a == ORDER_UNSEEN) return b;
+    return a == b ? a : ORDER_VARIES;
+}
+
+// Drops byte order sets that change nothing. The packet starts little
+// endian; subroutines start in whatever order their callers are in.
+static void opt_byte_order(Opt* o) {
+    memset(o->order, ORDER_UNSEEN, o->count);
+    opt_regions(o);
+
+    size_t head = 0, tail = 0;
+    uint8_t* queued = calloc(o->count ? o->count : 1, 1);
+    if (!queued) return;
+    int32_t* q = malloc((o->count + 1) * sizeof(int32_t) * 2);
+    if (!q) { free(queued); return; }
+    size_t cap = (o->count + 1) * 2;
+
+    for (size_t i = 0; i < o->count; i++) {
+        if (o->region[i] != (int32_t)i) continue;
+        o->order[i] = (i == (size_t)opt_resolve(o, 0)) ? ORDER_LE : ORDER_VARIES;
+        q[tail++ % cap] = (int32_t)i;
+        queued[i] = 1;
+    }
+    while (head != tail) {
+        int32_t i = q[head++ % cap];
+        queued[i] = 0;
+        const OptInsn* in = &o->insns[i];
+        uint8_t out = o->order[i];
+        if (in->kind == OPT_INSN) {
+            if (in->op == OP_SET_ENDIAN_LE) out = ORDER_LE;
+            else if (in->op == OP_SET_ENDIAN_BE) out = ORDER_BE;
+            else if (in->op == OP_CALL) out = ORDER_VARIES;
+        }
+        size_t n = opt_successors(o, i, 0);
+        for (size_t s = 0; s < n; s++) {
+            int32_t j = o->succ[s];
+            if (j >= (int32_t)o->count) continue;
+            uint8_t joined = opt_join(o->order[j], out);
+            if (joined == o->order[j]) continue;
+            o->order[j] = joined;
+            if (!queued[j]) { queued[j] = 1; q[tail++ % cap] = j; }
+        }
+    }
+    free(q);
+    free(queued);
+
+    for (int32_t i = 0; i < (int32_t)o->count; i++) {
+        const OptInsn* in = &o->insns[i];
+        if (in->dead || !opt_is_order(o, i)) continue;
+        if ((in->op == OP_SET_ENDIAN_LE && o->order[i] == ORDER_LE) ||
+            (in->op == OP_SET_ENDIAN_BE && o->order[i] == ORDER_BE)) {
+            opt_kill(o, i);
+        }
+    }
+}
+
+// --- Dead Code ---
+
+static void opt_dead_code(Opt* o) {
+    o->gen++;
+    opt_walk(o, opt_resolve(o, 0), OPT_NONE, 1);
+    for (size_t i = 0; i < o->count; i++) {
+        OptInsn* in = &o->insns[i];
+        if (in->dead || in->kind != OPT_INSN || o->seen[i] == o->gen) continue;
+        opt_kill(o, (int32_t)i);
+    }
+    for (size_t i = 0; i < o->count; i++) {
+        OptInsn* in = &o->insns[i];
+        if (!in->dead && in->kind == OPT_TABLE && o->insns[in->link].dead) opt_kill(o, (int32_t)i);
+    }
+}
+
+// --- Superinstructions ---
+
+static int opt_is_primitive(const Opt* o, int32_t i) {
+    const OptInsn* in = &o->insns[i];
+    return in->kind == OPT_INSN && !in->rewritten && in->op >= OP_IO_U8 && in->op <= OP_IO_BOOL;
+}
+
+static uint32_t opt_type_size(uint8_t type) {
+    switch (type) {
+        case OP_IO_U16: case OP_IO_I16: return 2;
+        case OP_IO_U32: case OP_IO_I32: case OP_IO_F32: return 4;
+        case OP_IO_U64: case OP_IO_I64: case OP_IO_F64: return 8;
+        default: return 1;
+    }
+}
+
+static int opt_is_value_check(uint8_t op) {
+    return op == OP_RANGE_CHECK || op == OP_ENUM_CHECK || op == OP_ENUM_SORTED || op == OP_ENUM_BITMAP;
+}
+
+// Whether the field at `i` is read plainly: no transform or @optional
+// precedes it, so the fused fast path applies
+static int opt_plain_field(const Opt* o, int32_t i) {
+    int32_t p = i - 1;
+    while (p >= 0 && o->insns[p].dead) p--;
+    if (p < 0 || o->insns[p].kind != OPT_INSN) return 1;
+    switch (o->insns[p].op) {
+        case OP_MARK_OPTIONAL: case OP_SCALE_LIN: case OP_TRANS_POLY: case OP_TRANS_SPLINE:
+        case OP_TRANS_ADD: case OP_TRANS_SUB: case OP_TRANS_MUL: case OP_TRANS_DIV:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+static void opt_absorb(Opt* o, int32_t head, int32_t part) {
+    o->insns[part].dead = 1;
+    o->insns[part].absorbed = 1;
+    o->insns[head].size += o->insns[part].size;
+    o->insns[head].link = part;
+}
+
+// Superinstructions carry the bytes of their parts, so this runs on the
+// final instruction list. Nothing branches into the middle of one.
+static void opt_fuse(Opt* o) {
+    opt_mark_targets(o);
+
+    // Field + check
+    for (int32_t i = 0; i < (int32_t)o->count; i++) {
+        if (o->insns[i].dead || !opt_is_primitive(o, i) || !opt_plain_field(o, i)) continue;
+        int32_t j = opt_next(o, i);
+        if (j >= (int32_t)o->count || o->is_target[j] || o->insns[j].kind != OPT_INSN || o->insns[j].rewritten) continue;
+        if (!opt_is_value_check(o->insns[j].op) || o->src[o->insns[j].at + 1] != o->insns[i].op) continue;
+        opt_rewrite(o, i, OP_IO_CHECK, 1 + o->insns[i].size);
+        opt_absorb(o, i, j);
+    }
+
+    // Runs of plain fields
+    for (int32_t i = 0; i < (int32_t)o->count; i++) {
+        if (o->insns[i].dead || !opt_is_primitive(o, i) || !opt_plain_field(o, i)) continue;
+        uint32_t count = 1;
+        uint32_t bytes = opt_type_size(o->insns[i].op);
+        int32_t last = i;
+        for (int32_t j = opt_next(o, i); j < (int32_t)o->count && count < OPT_MAX_RUN; j = opt_next(o, j)) {
+            if (o->is_target[j] || !opt_is_primitive(o, j)) break;
+            count++;
+            bytes += opt_type_size(o->insns[j].op);
+            last = j;
+        }
+        if (count < 2) continue;
+
+        opt_rewrite(o, i, OP_IO_RUN, 4 + o->insns[i].size);
+        o->insns[i].imm = ((uint64_t)bytes << 8) | count;
+        for (int32_t j = opt_next(o, i); j <= last; j = opt_next(o, j)) opt_absorb(o, i, j);
+        i = last;
+    }
+}
+
+// --- Scoreboard Slots ---
+
+// Whether live instruction `u` reads context key `key`: a switch, the count
+// of a dynamic array or a LOAD_CTX
+static int opt_reads_key(const Opt* o, int32_t u, uint16_t key) {
+    const OptInsn* in = &o->insns[u];
+    if (in->dead || in->kind != OPT_INSN || in->rewritten) return 0;
+    if (in->op == OP_ARR_DYNAMIC) return opt_get(o->src + in->at + 3, 2) == key;
+    if (in->op != OP_LOAD_CTX && !opt_is_switch(in->op)) return 0;
+    return opt_get(o->src + in->at + 1, 2) == key;
+}
+
+// The scoreboard answers every read of a slot's key for the rest of the run,
+// so a field only gets one if each read in its region comes after it on
+// every path, as a host keeping the last value of each key would answer them
+static void opt_slots(Opt* o) {
+    opt_regions(o);
+    for (int32_t c = 0; c < (int32_t)o->count; c++) {
+        const OptInsn* in = &o->insns[c];
+        if (in->dead || !opt_is_primitive(o, c) || !opt_plain_field(o, c)) continue;
+        if (in->op == OP_IO_F32 || in->op == OP_IO_F64 || o->region[c] == OPT_NONE) continue;
+        uint16_t key = (uint16_t)opt_get(o->src + in->at + 1, 2);
+
+        int used = 0;
+        for (int32_t u = 0; u < (int32_t)o->count && !used; u++) {
+            used = o->region[u] == o->region[c] && opt_reads_key(o, u, key);
+        }
+        if (!used || !opt_sole_field(o, c, key)) continue;
+
+        o->gen++;
+        opt_walk(o, o->region[c], c, 0);
+        int dominated = 1;
+        for (int32_t u = 0; u < (int32_t)o->count && dominated; u++) {
+            if (o->region[u] != o->region[c] || !opt_reads_key(o, u, key)) continue;
+            dominated = o->seen[u] != o->gen;
+        }
+        if (dominated) opt_rewrite(o, c, OP_IO_SLOT, 4);
+    }
+}
+
+// --- Register Expressions ---
+//
+// A run of PUSH_IMM, LOAD_CTX and ALU operations that starts on an empty
+// stack and leaves one value is translated into a register program. The
+// value at stack depth k lives in register k, in the integer or float file
+// depending on the operation that produced it; constants are only placed in
+// a register when an operation needs them there, and small ones become an
+// OP_REG_IMM or the immediate operand of an integer operation. Values a
+// float operation reads as raw bits (context values and integer literals
+// without a conversion) move between the files unchanged, as on the stack.
+
+#define OPT_EXPR_MIN_INSNS 3
+#define OPT_EXPR_MAX_CODE 255
+
+enum { EXPR_INT, EXPR_FLOAT, EXPR_CONST };
+
+typedef struct {
+    uint8_t kind[CND_EXPR_REGS];
+    uint64_t val[CND_EXPR_REGS]; // EXPR_CONST values
+    uint8_t code[OPT_EXPR_MAX_CODE];
+    size_t len;
+    int ok;
+} OptExpr;
+
+static int opt_is_float_op(uint8_t op) {
+    return (op >= OP_FADD && op <= OP_ABS) || (op >= OP_EQ_F && op <= OP_LTE_F);
+}
+
+// Operands an ALU operation takes, including math library calls
+static int opt_expr_arity(uint8_t op) {
+    if (op == OP_POW) return 2;
+    if (opt_is_binary(op)) return 2;
+    if (opt_is_unary(op) || (op >= OP_SIN && op <= OP_ABS)) return 1;
+    return 0;
+}
+
+static void opt_expr_put(OptExpr* x, uint8_t op, uint8_t d, uint8_t a, uint8_t b) {
+    if (x->len + 4 > sizeof(x->code)) { x->ok = 0; return; }
+    uint8_t* p = x->code + x->len;
+    p[0] = op; p[1] = d; p[2] = a; p[3] = b;
+    x->len += 4;
+}
+
+static void opt_expr_put_const(OptExpr* x, uint8_t op, uint8_t d, uint64_t v) {
+    opt_expr_put(x, op, d, 0, 0);
+    if (!x->ok || x->len + 8 > sizeof(x->code)) { x->ok = 0; return; }
+    for (int i = 0; i < 8; i++) x->code[x->len++] = (uint8_t)(v >> (8 * i));
+}
+
+// Places the value at depth `k` in integer register k
+static void opt_expr_int(OptExpr* x, uint8_t k) {
+    if (x->kind[k] == EXPR_CONST) {
+        int64_t v = (int64_t)x->val[k];
+        if (v >= INT16_MIN && v <= INT16_MAX) opt_expr_put(x, OP_REG_IMM, k, (uint8_t)v, (uint8_t)((uint64_t)v >> 8));
+        else opt_expr_put_const(x, OP_REG_CONST, k, x->val[k]);
+    } else if (x->kind[k] == EXPR_FLOAT) {
+        opt_expr_put(x, OP_REG_BTOI, k, k, 0);
+    }
+    x->kind[k] = EXPR_INT;
+}
+
+// Places the value at depth `k` in float register k
+static void opt_expr_float(OptExpr* x, uint8_t k) {
+    if (x->kind[k] == EXPR_CONST) opt_expr_put_const(x, OP_REG_FCONST, k, x->val[k]);
+    else if (x->kind[k] == EXPR_INT) opt_expr_put(x, OP_REG_ITOB, k, k, 0);
+    x->kind[k] = EXPR_FLOAT;
+}
+
+// Translates the ALU operation `op` on the value(s) ending at depth `k`
+static void opt_expr_alu(OptExpr* x, uint8_t op, uint8_t k, int arity) {
+    if (arity == 1) {
+        if (op == OP_ITOF) {
+            opt_expr_int(x, k);
+            opt_expr_put(x, op, k, k, 0);
+            x->kind[k] = EXPR_FLOAT;
+        } else if (op == OP_FTOI || !opt_is_float_op(op)) {
+            if (op == OP_FTOI) opt_expr_float(x, k);
+            else opt_expr_int(x, k);
+            opt_expr_put(x, op, k, k, 0);
+            x->kind[k] = EXPR_INT;
+        } else {
+            opt_expr_float(x, k);
+            opt_expr_put(x, op, k, k, 0);
+            x->kind[k] = EXPR_FLOAT;
+        }
+        return;
+    }
+
+    uint8_t r = (uint8_t)(k + 1);
+    if (opt_is_float_op(op)) {
+        opt_expr_float(x, k);
+        opt_expr_float(x, r);
+        opt_expr_put(x, op, k, k, r);
+        x->kind[k] = (op >= OP_EQ_F && op <= OP_LTE_F) ? EXPR_INT : EXPR_FLOAT;
+        return;
+    }
+
+    opt_expr_int(x, k);
+    int64_t v = (int64_t)x->val[r];
+    if (x->kind[r] == EXPR_CONST && v >= INT8_MIN && v <= INT8_MAX) {
+        opt_expr_put(x, op, (uint8_t)(k | CND_EXPR_IMM), k, (uint8_t)v);
+    } else {
+        opt_expr_int(x, r);
+        opt_expr_put(x, op, k, k, r);
+    }
+    x->kind[k] = EXPR_INT;
+}
+
+// Replaces the run from `first` to `last` with one OP_EXPR
+static int opt_lower_run(Opt* o, int32_t first, int32_t last) {
+    OptExpr x;
+    memset(&x, 0, sizeof(x));
+    x.ok = 1;
+    uint8_t depth = 0;
+
+    for (int32_t j = first;; j = opt_next(o, j)) {
+        const OptInsn* in = &o->insns[j];
+        if (in->op == OP_PUSH_IMM) {
+            x.kind[depth] = EXPR_CONST;
+            x.val[depth++] = opt_imm(o, j);
+        } else if (in->op == OP_LOAD_CTX) {
+            const uint8_t* key = o->src + in->at + 1;
+            opt_expr_put(&x, OP_REG_LOAD, depth, key[0], key[1]);
+            x.kind[depth++] = EXPR_INT;
+        } else {
+            int arity = opt_expr_arity(in->op);
+            depth = (uint8_t)(depth - arity);
+            opt_expr_alu(&x, in->op, depth++, arity);
+        }
+        if (j == last) break;
+    }
+
+    if (x.kind[0] == EXPR_CONST) opt_expr_int(&x, 0);
+    opt_expr_put(&x, OP_REG_RET, 0, 0, x.kind[0] == EXPR_FLOAT);
+    if (!x.ok) return 0;
+
+    for (int32_t j = opt_next(o, first); j <= last; j = opt_next(o, j)) opt_kill(o, j);
+    opt_rewrite(o, first, OP_EXPR, (uint32_t)(2 + x.len));
+    o->insns[first].imm = o->exprs.size;
+    buf_append(&o->exprs, x.code, x.len);
+    return 1;
+}
+
+static void opt_lower_exprs(Opt* o) {
+    opt_mark_targets(o);
+    for (int32_t i = 0; i < (int32_t)o->count; i++) {
+        const OptInsn* head = &o->insns[i];
+        if (head->dead || head->kind != OPT_INSN) continue;
+        if (head->op != OP_PUSH_IMM && head->op != OP_LOAD_CTX) continue;
+
+        // Longest run from `i` that ends with exactly its own value on the stack
+        int32_t last = OPT_NONE;
+        int depth = 0, insns = 0, loads = 0, run_insns = 0, run_loads = 0;
+        for (int32_t j = i; j < (int32_t)o->count; j = opt_next(o, j)) {
+            const OptInsn* in = &o->insns[j];
+            if (in->kind != OPT_INSN || (j != i && o->is_target[j])) break;
+            int arity = opt_expr_arity(in->op);
+            if (in->op == OP_PUSH_IMM || in->op == OP_LOAD_CTX) depth++;
+            else if (arity > 0 && depth >= arity) depth -= arity - 1;
+            else break;
+            if (depth > CND_EXPR_REGS) break;
+            insns++;
+            if (in->op == OP_LOAD_CTX) loads++;
+            if (depth == 1) {
+                last = j;
+                run_insns = insns;
+                run_loads = loads;
+            }
+        }
+
+        // Constant expressions are left to folding
+        if (last == OPT_NONE || run_insns < OPT_EXPR_MIN_INSNS || run_loads == 0) continue;
+        if (opt_lower_run(o, i, last)) i = last;
+    }
+}
+
+// --- Emission ---
+
+static uint32_t opt_rel(const Opt* o, int32_t target, size_t from, size_t new_len) {
+    int32_t t = opt_resolve(o, target);
+    size_t to = t < (int32_t)o->count ? o->insns[t].new_at : new_len;
+    return (uint32_t)(int32_t)((int64_t)to - (int64_t)from);
+}
+
+// Header operands and the parts of the superinstruction at `i`, whose first
+// part is the field it was rewritten from
+static void opt_emit_parts(const Opt* o, int32_t i, Buffer* out) {
+    const OptInsn* in = &o->insns[i];
+    if (in->op == OP_IO_RUN) {
+        buf_push(out, (uint8_t)in->imm);
+        buf_push_u16(out, (uint16_t)(in->imm >> 8));
+    }
+    buf_append(out, o->src + in->at, 3);
+    for (int32_t k = i + 1; k <= in->link; k++) {
+        const OptInsn* part = &o->insns[k];
+        if (part->absorbed) buf_append(out, o->src + part->at, part->size);
+    }
+}
+
+static void opt_emit(const Opt* o, Buffer* out) {
+    size_t new_len = 0;
+    for (size_t i = 0; i < o->count; i++) {
+        OptInsn* in = &o->insns[i];
+        if (in->dead) continue;
+        in->new_at = new_len;
+        new_len += in->size;
+    }
+
+    for (size_t i = 0; i < o->count; i++) {
+        const OptInsn* in = &o->insns[i];
+        if (in->dead) continue;
+        size_t at = out->size;
+
+        if (in->kind == OPT_TABLE) {
+            size_t base = o->insns[in->link].new_at + 7;
+            buf_append(out, o->src + in->at, in->size);
+            for (uint32_t c = 0; c < in->case_count; c++) {
+                const OptCase* e = &o->cases[in->first_case + c];
+                buf_write_u32_at(out, at + e->field, opt_rel(o, e->target, base, new_len));
+            }
+            continue;
+        }
+
+        if (in->rewritten) {
+            buf_push(out, in->op);
+            if (in->op == OP_JUMP) buf_push_u32(out, opt_rel(o, in->target, at + 5, new_len));
+            else if (in->op == OP_PUSH_IMM) buf_push_u64(out, in->imm);
+            else if (in->op == OP_ALIGN_PAD) buf_push(out, (uint8_t)in->imm);
+            else if (in->op == OP_IO_RUN || in->op == OP_IO_CHECK) opt_emit_parts(o, (int32_t)i, out);
+            else if (in->op == OP_IO_SLOT) buf_append(out, o->src + in->at, 3);
+            else if (in->op == OP_EXPR) {
+                buf_push(out, (uint8_t)(in->size - 2));
+                buf_append(out, o->exprs.data + in->imm, in->size - 2);
+            }
+            continue;
+        }
+
+        buf_append(out, o->src + in->at, in->size);
+        if (in->op == OP_JUMP || in->op == OP_JUMP_IF_NOT || in->op == OP_CALL) {
+            buf_write_u32_at(out, at + in->size - 4, opt_rel(o, in->target, at + in->size, new_len));
+        } else if (opt_is_switch(in->op)) {
+            const OptInsn* t = &o->insns[in->link];
+            buf_write_u32_at(out, at + 3, (uint32_t)(t->new_at - (at + 7)));
+        }
+    }
+}
+
+static size_t opt_count_insns(const Opt* o) {
+    size_t n = 0;
+    for (size_t i = 0; i < o->count; i++) {
+        if (!o->insns[i].dead && o->insns[i].kind == OPT_INSN) n++;
+    }
+    return n;
+}
+
+static void opt_free(Opt* o) {
+    free(o->insns);
+    free(o->cases);
+    free(o->is_target);
+    free(o->seen);
+    free(o->queue);
+    free(o->succ);
+    free(o->region);
+    free(o->order);
+    buf_free(&o->exprs);
+}
+
+int il_optimize(Buffer* bc, OptStats* stats) {
+    Opt o;
+    memset(&o, 0, sizeof(o));
+    o.src = bc->data;
+    o.len = bc->size;
+
+    stats->bytes_before = stats->bytes_after = bc->size;
+    stats->insns_before = stats->insns_after = 0;
+    if (bc->size == 0) return 0;
+    buf_init(&o.exprs);
+
+    if (!opt_decode(&o)) { opt_free(&o); return 0; }
+    stats->insns_before = stats->insns_after = opt_count_insns(&o);
+
+    size_t n = o.count;
+    o.is_target = calloc(n, 1);
+    o.seen = calloc(n, sizeof(uint32_t));
+    o.queue = malloc(n * sizeof(int32_t));
+    o.succ = malloc((o.case_total + 4) * sizeof(int32_t));
+    o.region = malloc(n * sizeof(int32_t));
+    o.order = malloc(n);
+    if (!o.is_target || !o.seen || !o.queue || !o.succ || !o.region || !o.order) { opt_free(&o); return 0; }
+
+    for (int pass = 0; pass < OPT_MAX_PASSES; pass++) {
+        o.changed = 0;
+        opt_mark_targets(&o);
+        opt_propagate_consts(&o);
+        opt_fold(&o);
+        opt_peephole(&o);
+        opt_dead_code(&o);
+        opt_byte_order(&o);
+        if (!o.changed) break;
+    }
+    opt_slots(&o);
+    opt_fuse(&o);
+    opt_lower_exprs(&o);
+
+    Buffer out;
+    buf_init(&out);
+    opt_emit(&o, &out);
+    stats->bytes_after = out.size;
+    stats->insns_after = opt_count_insns(&o);
+    opt_free(&o);
+
+    buf_free(bc);
+    *bc = out;
+    return 1;
+}
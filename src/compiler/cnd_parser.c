@@ -123,7 +123,7 @@ static ExprType parse_binary(Parser* p, ExprType left) {
 }
 
 static ExprType parse_grouping(Parser* p) {
-    advance(p); // Consume (
+    // parse_precedence has consumed the (
     ExprType t = parse_expression(p);
     consume(p, TOK_RPAREN, "Expect ) after expression");
     return t;
@@ -279,6 +279,33 @@ int match_keyword(Token t, const char* kw) {
 
 
 
+// Runs of adjacent bitfields are emitted as one OP_IO_BIT_GROUP so the VM
+// reads or writes their container once. A bitfield joins the previous one when
+// nothing was emitted in between and the run stays within 64 bits; a single
+// bitfield instruction already has the shape of a group entry, so turning it
+// into a group only needs the two header bytes in front of it.
+static void emit_bitfield(Parser* p, uint8_t op, uint16_t key_id, uint8_t width) {
+    Buffer* b = p->target;
+    if (p->bit_group_end != 0 && p->bit_group_end == b->size && p->bit_group_bits + width <= 64) {
+        if (b->data[p->bit_group_at] != OP_IO_BIT_GROUP) {
+            uint8_t head[2] = { OP_IO_BIT_GROUP, 1 };
+            buf_insert(b, p->bit_group_at, head, 2);
+        }
+        b->data[p->bit_group_at + 1]++;
+        p->bit_group_bits += width;
+    } else {
+        p->bit_group_at = b->size;
+        p->bit_group_bits = width;
+    }
+    buf_push(b, op); buf_push_u16(b, key_id); buf_push(b, width);
+    p->bit_group_end = b->size;
+}
+
+// Ends the current bitfield run, e.g. where a jump lands right after it
+static void bit_group_break(Parser* p) {
+    p->bit_group_end = 0;
+}
+
 void emit_range_check(Parser* p, uint8_t type_op, Token min_tok, Token max_tok) {
     // Validate range
     if (type_op == OP_IO_U8 || type_op == OP_IO_U16 || type_op == OP_IO_U32) {
@@ -345,6 +372,74 @@ void emit_range_check(Parser* p, uint8_t type_op, Token min_tok, Token max_tok)
     }
 }
 
+static void buf_push_sized(Buffer* b, uint32_t size, uint64_t v) {
+    if (size == 1) buf_push(b, (uint8_t)v);
+    else if (size == 2) buf_push_u16(b, (uint16_t)v);
+    else if (size == 4) buf_push_u32(b, (uint32_t)v);
+    else buf_push_u64(b, v);
+}
+
+static int u64_cmp(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Emits the validation for an enum field, picking the cheapest encoding for
+// its value set: a contiguous set becomes an OP_RANGE_CHECK, a dense one a
+// bitmap indexed by (value - min), and a sparse one a sorted table searched in
+// O(log n). Only a handful of sparse values keep the linear OP_ENUM_CHECK.
+static void emit_enum_check(Parser* p, const EnumDef* edef) {
+    uint8_t type = edef->underlying_type;
+    uint32_t size = (type == OP_IO_U8 || type == OP_IO_I8) ? 1 :
+                    (type == OP_IO_U16 || type == OP_IO_I16) ? 2 :
+                    (type == OP_IO_U32 || type == OP_IO_I32) ? 4 : 8;
+    uint64_t mask = (size == 8) ? UINT64_MAX : (((uint64_t)1 << (size * 8)) - 1);
+    // Flipping the sign bit makes unsigned order match signed order
+    uint64_t bias = (type == OP_IO_I8 || type == OP_IO_I16 || type == OP_IO_I32 || type == OP_IO_I64)
+                    ? ((uint64_t)1 << (size * 8 - 1)) : 0;
+    Buffer* b = p->target;
+
+    uint64_t* keys = edef->count ? malloc(edef->count * sizeof(uint64_t)) : NULL;
+    size_t n = 0;
+    if (edef->count && !keys) { parser_error(p, "Out of memory"); return; }
+    for (size_t i = 0; i < edef->count; i++) keys[i] = ((uint64_t)edef->values[i].value & mask) ^ bias;
+    if (edef->count) qsort(keys, edef->count, sizeof(uint64_t), u64_cmp);
+    for (size_t i = 0; i < edef->count; i++) {
+        if (n == 0 || keys[n - 1] != keys[i]) keys[n++] = keys[i];
+    }
+
+    uint64_t spread = n ? keys[n - 1] - keys[0] : 0;
+    if (n > 0 && spread == n - 1) {
+        buf_push(b, OP_RANGE_CHECK); buf_push(b, type);
+        buf_push_sized(b, size, keys[0] ^ bias);
+        buf_push_sized(b, size, keys[n - 1] ^ bias);
+    } else if (n > 0 && spread < 65535 && (spread < 256 || spread / 8 + 1 <= n * size)) {
+        uint16_t span = (uint16_t)(spread + 1);
+        size_t bytes = ((size_t)span + 7) / 8;
+        buf_push(b, OP_ENUM_BITMAP); buf_push(b, type);
+        buf_push_sized(b, size, keys[0] ^ bias);
+        buf_push_u16(b, span);
+        size_t at = b->size;
+        for (size_t i = 0; i < bytes; i++) buf_push(b, 0);
+        for (size_t i = 0; i < n; i++) {
+            uint64_t index = keys[i] - keys[0];
+            b->data[at + (index >> 3)] |= (uint8_t)(1u << (index & 7));
+        }
+    } else if (n <= 16) {
+        buf_push(b, OP_ENUM_CHECK); buf_push(b, type);
+        buf_push_u16(b, (uint16_t)n);
+        for (size_t i = 0; i < n; i++) buf_push_sized(b, size, keys[i] ^ bias);
+    } else {
+        // The VM compares raw values, so order by them rather than by key
+        for (size_t i = 0; i < n; i++) keys[i] ^= bias;
+        if (bias) qsort(keys, n, sizeof(uint64_t), u64_cmp);
+        buf_push(b, OP_ENUM_SORTED); buf_push(b, type);
+        buf_push_u16(b, (uint16_t)n);
+        for (size_t i = 0; i < n; i++) buf_push_sized(b, size, keys[i]);
+    }
+    free(keys);
+}
+
 void parse_field(Parser* p, const char* doc); // Forward declaration
 void parse_block(Parser* p); // Forward declaration
 
@@ -499,16 +594,12 @@ void parse_if(Parser* p) {
     }
     
     // Patch jump_end
+    bit_group_break(p);
     size_t end_loc = buf_current_offset(p->target);
     int32_t end_offset = (int32_t)(end_loc - (jump_end_loc + 1 + 4));
     buf_write_u32_at(p->target, jump_end_loc + 1, (uint32_t)end_offset);
 }
 
-typedef struct {
-    uint64_t val;
-    int32_t offset;
-} SwitchCase;
-
 void parse_switch(Parser* p) {
     consume(p, TOK_LPAREN, "Expect ( after switch");
     Token field_tok = p->current;
@@ -636,80 +727,11 @@ void parse_switch(Parser* p) {
     }
     consume(p, TOK_RBRACE, "Expect }");
     
-    // Analyze cases for Jump Table optimization
-    int use_jump_table = 0;
-    uint64_t min_val = UINT64_MAX;
-    uint64_t max_val = 0;
-    
-    if (case_count > 3) { // Only optimize if enough cases
-        min_val = cases[0].val;
-        max_val = cases[0].val;
-        for(size_t i=1; i<case_count; i++) {
-            if (cases[i].val < min_val) min_val = cases[i].val;
-            if (cases[i].val > max_val) max_val = cases[i].val;
-        }
-        
-        uint64_t range = max_val - min_val;
-        // Heuristic: Range must be reasonable (e.g. < 256) and density > 50%
-        // Or just small range. Let's say range < 256 is always good.
-        if (range < 256) {
-            use_jump_table = 1;
-        }
-    }
-
     // Emit Table
     size_t table_start = buf_current_offset(p->target);
     size_t table_end = 0;
-    
-    if (use_jump_table) {
-        // Patch Opcode
-        buf_write_u8_at(p->target, switch_instr_loc, OP_SWITCH_TABLE);
-        
-        // Table Layout: Min(8), Max(8), Default(4), [Offset(4)] * (Range+1)
-        buf_push_u64(p->target, min_val);
-        buf_push_u64(p->target, max_val);
-        
-        // We need to know table_end to calculate default_offset if it's missing
-        size_t range = (size_t)(max_val - min_val);
-        size_t table_size = 8 + 8 + 4 + (range + 1) * 4;
-        table_end = table_start + table_size;
-        
-        if (default_offset == -1) {
-            default_offset = (int32_t)(table_end - code_start_loc);
-        }
-        buf_push_u32(p->target, (uint32_t)default_offset);
-        
-        // Fill table
-        for (size_t i = 0; i <= range; i++) {
-            uint64_t current_val = min_val + i;
-            int32_t target = default_offset;
-            // Find case (linear search is fine for compile time)
-            for (size_t j = 0; j < case_count; j++) {
-                if (cases[j].val == current_val) {
-                    target = cases[j].offset;
-                    break;
-                }
-            }
-            buf_push_u32(p->target, (uint32_t)target);
-        }
-        
-    } else {
-        // Sparse Table Layout: Count(2), Default(4), [Val(8), Offset(4)] * Count
-        buf_push_u16(p->target, (uint16_t)case_count);
-        
-        size_t table_size = 2 + 4 + case_count * 12;
-        table_end = table_start + table_size;
-        
-        if (default_offset == -1) {
-            default_offset = (int32_t)(table_end - code_start_loc);
-        }
-        buf_push_u32(p->target, (uint32_t)default_offset);
-        
-        for(size_t i=0; i<case_count; i++) {
-            buf_push_u64(p->target, cases[i].val);
-            buf_push_u32(p->target, (uint32_t)cases[i].offset);
-        }
-    }
+    uint8_t opcode = switch_emit_table(p->target, cases, case_count, default_offset, code_start_loc, &table_end);
+    buf_write_u8_at(p->target, switch_instr_loc, opcode);
     
     // Fixup Jumps to point to AFTER the table
     for(size_t i=0; i<jump_count; i++) {
@@ -823,6 +845,12 @@ void parse_field(Parser* p, const char* doc) {
             crc_flags |= 1;
         } else if (match_keyword(dec_name_token, "crc_refout")) {
             crc_flags |= 2;
+        } else if (match_keyword(dec_name_token, "crc_begin")) {
+            is_standalone_op = 1;
+            buf_push(p->target, OP_CRC_BEGIN);
+        } else if (match_keyword(dec_name_token, "crc_end")) {
+            is_standalone_op = 1;
+            buf_push(p->target, OP_CRC_END);
         } else if (match_keyword(dec_name_token, "optional")) {
             buf_push(p->target, OP_MARK_OPTIONAL);
         } else if (match_keyword(dec_name_token, "eof")) {
@@ -956,33 +984,6 @@ void parse_field(Parser* p, const char* doc) {
         // Do nothing here, wait until type is parsed
     }
     
-    // Emit Transform Op
-    if (trans_type == CND_TRANS_SCALE_F64) {
-        buf_push(p->target, OP_SCALE_LIN);
-        buf_push_u64(p->target, *(uint64_t*)&trans_scale);
-        buf_push_u64(p->target, *(uint64_t*)&trans_offset);
-    } else if (trans_type == CND_TRANS_MUL_I64) {
-        buf_push(p->target, OP_TRANS_MUL); buf_push_u64(p->target, (uint64_t)trans_int_val);
-    } else if (trans_type == CND_TRANS_DIV_I64) {
-        buf_push(p->target, OP_TRANS_DIV); buf_push_u64(p->target, (uint64_t)trans_int_val);
-    } else if (trans_type == CND_TRANS_ADD_I64) {
-        buf_push(p->target, OP_TRANS_ADD); buf_push_u64(p->target, (uint64_t)trans_int_val);
-    } else if (trans_type == CND_TRANS_SUB_I64) {
-        buf_push(p->target, OP_TRANS_SUB); buf_push_u64(p->target, (uint64_t)trans_int_val);
-    } else if (trans_type == CND_TRANS_POLY) {
-        buf_push(p->target, OP_TRANS_POLY);
-        buf_push(p->target, poly_count);
-        for (int i = 0; i < poly_count; i++) {
-            buf_push_u64(p->target, *(uint64_t*)&poly_coeffs[i]);
-        }
-    } else if (trans_type == CND_TRANS_SPLINE) {
-        buf_push(p->target, OP_TRANS_SPLINE);
-        buf_push(p->target, spline_count);
-        for (int i = 0; i < spline_count * 2; i++) {
-            buf_push_u64(p->target, *(uint64_t*)&spline_points[i]);
-        }
-    }
-
     Token type_tok = p->current;
     consume(p, TOK_IDENTIFIER, "Expect field type");
 
@@ -1079,6 +1080,33 @@ void parse_field(Parser* p, const char* doc) {
         buf_push(p->target, str_prefix_op); buf_push_u16(p->target, key_id);
     }
 
+    // Emit Transform Op (inside the loop body for arrays: transforms apply to one IO)
+    if (trans_type == CND_TRANS_SCALE_F64) {
+        buf_push(p->target, OP_SCALE_LIN);
+        buf_push_u64(p->target, *(uint64_t*)&trans_scale);
+        buf_push_u64(p->target, *(uint64_t*)&trans_offset);
+    } else if (trans_type == CND_TRANS_MUL_I64) {
+        buf_push(p->target, OP_TRANS_MUL); buf_push_u64(p->target, (uint64_t)trans_int_val);
+    } else if (trans_type == CND_TRANS_DIV_I64) {
+        buf_push(p->target, OP_TRANS_DIV); buf_push_u64(p->target, (uint64_t)trans_int_val);
+    } else if (trans_type == CND_TRANS_ADD_I64) {
+        buf_push(p->target, OP_TRANS_ADD); buf_push_u64(p->target, (uint64_t)trans_int_val);
+    } else if (trans_type == CND_TRANS_SUB_I64) {
+        buf_push(p->target, OP_TRANS_SUB); buf_push_u64(p->target, (uint64_t)trans_int_val);
+    } else if (trans_type == CND_TRANS_POLY) {
+        buf_push(p->target, OP_TRANS_POLY);
+        buf_push(p->target, poly_count);
+        for (int i = 0; i < poly_count; i++) {
+            buf_push_u64(p->target, *(uint64_t*)&poly_coeffs[i]);
+        }
+    } else if (trans_type == CND_TRANS_SPLINE) {
+        buf_push(p->target, OP_TRANS_SPLINE);
+        buf_push(p->target, spline_count);
+        for (int i = 0; i < spline_count * 2; i++) {
+            buf_push_u64(p->target, *(uint64_t*)&spline_points[i]);
+        }
+    }
+
     if (has_const) {
         uint8_t type_op = OP_IO_U16;
         int is_signed = 0;
@@ -1164,9 +1192,11 @@ void parse_field(Parser* p, const char* doc) {
             memcpy(field_name, name_tok.start, field_name_len);
             field_name[field_name_len] = '\0';
             
-            // Append struct bytecode with field names prefixed
-            buf_append_with_prefix(p->target, sdef->bytecode.data, sdef->bytecode.size,
-                                   field_name, field_name_len, &p->strtab);
+            // Call the struct's subroutine, or append its bytecode with field names prefixed
+            if (!subr_emit_call(p, sdef, field_name, field_name_len)) {
+                buf_append_with_prefix(p->target, sdef->bytecode.data, sdef->bytecode.size,
+                                       field_name, field_name_len, &p->strtab);
+            }
             
             buf_push(p->target, OP_EXIT_STRUCT);
         } else if (edef) {
@@ -1176,17 +1206,7 @@ void parse_field(Parser* p, const char* doc) {
             
             buf_push(p->target, edef->underlying_type); buf_push_u16(p->target, key_id);
             
-            // Emit Enum Validation
-            buf_push(p->target, OP_ENUM_CHECK);
-            buf_push(p->target, edef->underlying_type);
-            buf_push_u16(p->target, (uint16_t)edef->count);
-            for (size_t i = 0; i < edef->count; i++) {
-                int64_t val = edef->values[i].value;
-                if (edef->underlying_type == OP_IO_U8 || edef->underlying_type == OP_IO_I8) buf_push(p->target, (uint8_t)val);
-                else if (edef->underlying_type == OP_IO_U16 || edef->underlying_type == OP_IO_I16) buf_push_u16(p->target, (uint16_t)val);
-                else if (edef->underlying_type == OP_IO_U32 || edef->underlying_type == OP_IO_I32) buf_push_u32(p->target, (uint32_t)val);
-                else if (edef->underlying_type == OP_IO_U64 || edef->underlying_type == OP_IO_I64) buf_push_u64(p->target, (uint64_t)val);
-            }
+            emit_enum_check(p, edef);
 
             if (has_range) { emit_range_check(p, edef->underlying_type, range_min_tok, range_max_tok); }
         }
@@ -1235,7 +1255,7 @@ void parse_field(Parser* p, const char* doc) {
                  }
                  else { parser_error(p, "Bitfields only supported for integer/bool types"); return; }
                  
-                 buf_push(p->target, op); buf_push_u16(p->target, key_id); buf_push(p->target, bit_width);
+                 emit_bitfield(p, op, key_id, bit_width);
                  
                  if (p->in_bit_mode && p->is_bit_count_valid) {
                      p->current_bit_count += bit_width;
@@ -1436,6 +1456,7 @@ void parse_struct(Parser* p, const char* doc) {
     p->current_struct_name_len = name.length;
 
     Buffer* prev = p->target; p->target = &def->bytecode;
+    bit_group_break(p);
 
     int was_in_bit_mode = p->in_bit_mode;
     int prev_bit_count = p->current_bit_count;
@@ -1473,6 +1494,7 @@ void parse_struct(Parser* p, const char* doc) {
     p->is_bit_count_valid = prev_bit_valid;
 
     p->target = prev;
+    bit_group_break(p);
 
     p->current_struct_name = prev_name;
     p->current_struct_name_len = prev_len;
@@ -0,0 +1,186 @@
+#include "cnd_internal.h"
+
+// --- Struct Subroutines ---
+//
+// A struct used as a field of the packet is compiled once, as a subroutine,
+// instead of being inlined at every use. The body is the struct's bytecode
+// with its Key IDs renumbered 0..K-1 in order of first appearance, ending in
+// OP_RET. Each use emits OP_CALL with the Key ID of its first prefixed field
+// name as the key base, so the K names of one instance need consecutive Key
+// IDs. A new instance adds its names in exactly that order, which also gives
+// them the Key IDs inlining would have given.
+//
+// Struct definitions keep their nested structs inlined, so bodies never call.
+// Small bodies, structs whose arrays take their count from another field, and
+// instances whose names already exist out of order are inlined as before.
+//
+// Bodies are collected in Parser.subr_bc. subr_link appends them behind an
+// OP_RET that ends the packet and turns body offsets into call targets.
+
+// Bodies smaller than this are cheaper to inline than to call (OP_CALL is 9
+// bytes and a dispatch in each direction)
+#define SUBR_MIN_BODY 16
+
+#define SUBR_NO_KEY 0xFFFF
+
+typedef struct {
+    uint16_t* local;  // Local Key ID by global Key ID, or SUBR_NO_KEY
+    uint16_t* keys;   // Global Key ID by local Key ID
+    uint16_t count;
+} SubrKeys;
+
+static uint16_t subr_local_key(SubrKeys* k, uint16_t key) {
+    if (k->local[key] == SUBR_NO_KEY) {
+        k->local[key] = k->count;
+        k->keys[k->count++] = key;
+    }
+    return k->local[key];
+}
+
+// Appends the body of `def` to `out` with local Key IDs. Returns 0 if the
+// struct cannot be called.
+static int subr_body(const StructDef* def, size_t key_limit, SubrKeys* k, Buffer* out) {
+    const uint8_t* src = def->bytecode.data;
+    size_t len = def->bytecode.size;
+    SwitchTables tables = {0};
+    size_t i = 0;
+
+    while (i < len) {
+        // Jump tables hold no keys and are copied as they are
+        size_t table_end = switch_tables_skip(&tables, i);
+        if (table_end) {
+            buf_append(out, src + i, table_end - i);
+            i = table_end;
+            continue;
+        }
+
+        uint8_t op = src[i];
+        if (op == OP_SWITCH || op == OP_SWITCH_TABLE || op == OP_SWITCH_SORTED || op == OP_SWITCH_HASH) {
+            switch_tables_add(&tables, src, len, i);
+        }
+        // The count field is looked up by its unprefixed name
+        if (op == OP_ARR_DYNAMIC) return 0;
+
+        if (op == OP_IO_BIT_GROUP) {
+            // Count(1) + Count * {Type(1) Key(2) Width(1)}
+            if (i + 2 > len || i + 2 + (size_t)src[i + 1] * 4 > len) return 0;
+            uint8_t count = src[i + 1];
+            buf_append(out, src + i, 2);
+            for (uint8_t f = 0; f < count; f++) {
+                const uint8_t* e = src + i + 2 + (size_t)f * 4;
+                uint16_t key = (uint16_t)(e[1] | (e[2] << 8));
+                if (key >= key_limit) return 0;
+                buf_push(out, e[0]);
+                buf_push_u16(out, subr_local_key(k, key));
+                buf_push(out, e[3]);
+            }
+            i += 2 + (size_t)count * 4;
+            continue;
+        }
+
+        int keyid_offset;
+        int size = get_opcode_size_and_keyid_offset(src + i, len - i, &keyid_offset);
+        if (size < 0 || i + size > len) return 0;
+
+        if (keyid_offset < 0) {
+            buf_append(out, src + i, size);
+        } else {
+            uint16_t key = (uint16_t)(src[i + keyid_offset] | (src[i + keyid_offset + 1] << 8));
+            if (key >= key_limit) return 0;
+            buf_append(out, src + i, keyid_offset);
+            buf_push_u16(out, subr_local_key(k, key));
+            buf_append(out, src + i + keyid_offset + 2, size - keyid_offset - 2);
+        }
+        i += size;
+    }
+    buf_push(out, OP_RET);
+    return 1;
+}
+
+// Builds the subroutine of `def` on first use. Returns 0 if it is inlined.
+static int subr_build(Parser* p, StructDef* def) {
+    if (def->subr_at != SUBR_NONE) return def->subr_at >= 0;
+    def->subr_at = SUBR_INLINE;
+    if (def->bytecode.size < SUBR_MIN_BODY) return 0;
+
+    size_t key_limit = p->strtab.count;
+    SubrKeys k;
+    k.local = malloc((key_limit ? key_limit : 1) * sizeof(uint16_t));
+    k.keys = malloc((key_limit ? key_limit : 1) * sizeof(uint16_t));
+    k.count = 0;
+    for (size_t i = 0; i < key_limit; i++) k.local[i] = SUBR_NO_KEY;
+
+    if (!p->subr_bc.data) buf_init(&p->subr_bc);
+    size_t at = p->subr_bc.size;
+    if (at <= 0x7FFFFFFF && subr_body(def, key_limit, &k, &p->subr_bc)) {
+        def->subr_at = (int32_t)at;
+        def->subr_keys = k.keys;
+        def->subr_key_count = k.count;
+        k.keys = NULL;
+    } else {
+        p->subr_bc.size = at;
+    }
+    free(k.local);
+    free(k.keys);
+    return def->subr_at >= 0;
+}
+
+int subr_emit_call(Parser* p, StructDef* def, const char* name, int name_len) {
+    // Only the packet calls; struct definitions stay self-contained
+    if (!p->subroutines || p->current_struct_name) return 0;
+    if (!subr_build(p, def)) return 0;
+
+    uint16_t base = 0;
+    for (uint16_t i = 0; i < def->subr_key_count; i++) {
+        uint16_t key = prefixed_key(def->subr_keys[i], name, name_len, &p->strtab);
+        if (i == 0) base = key;
+        else if (key != (uint16_t)(base + i)) return 0;
+    }
+
+    // Offset holds the body offset until subr_link
+    buf_push(p->target, OP_CALL);
+    buf_push_u16(p->target, base);
+    buf_push_u16(p->target, def->subr_key_count);
+    buf_push_u32(p->target, (uint32_t)def->subr_at);
+    p->subr_calls++;
+    return 1;
+}
+
+void subr_link(Parser* p) {
+    if (p->subr_calls == 0) return;
+
+    Buffer* b = &p->global_bc;
+    size_t code_len = b->size;
+    size_t bodies = code_len + 1; // Behind the OP_RET ending the packet
+    SwitchTables tables = {0};
+    size_t i = 0;
+
+    while (i < code_len) {
+        size_t table_end = switch_tables_skip(&tables, i);
+        if (table_end) { i = table_end; continue; }
+
+        uint8_t op = b->data[i];
+        if (op == OP_SWITCH || op == OP_SWITCH_TABLE || op == OP_SWITCH_SORTED || op == OP_SWITCH_HASH) {
+            switch_tables_add(&tables, b->data, code_len, i);
+        }
+        if (op == OP_IO_BIT_GROUP) {
+            if (i + 2 > code_len) break;
+            i += 2 + (size_t)b->data[i + 1] * 4;
+            continue;
+        }
+
+        int keyid_offset;
+        int size = get_opcode_size_and_keyid_offset(b->data + i, code_len - i, &keyid_offset);
+        if (size < 0) break;
+        if (op == OP_CALL && i + 9 <= code_len) {
+            uint32_t body = (uint32_t)b->data[i + 5] | ((uint32_t)b->data[i + 6] << 8) |
+                            ((uint32_t)b->data[i + 7] << 16) | ((uint32_t)b->data[i + 8] << 24);
+            // Target is relative to the end of the OP_CALL
+            buf_write_u32_at(b, i + 5, (uint32_t)(bodies + body - (i + 9)));
+        }
+        i += size;
+    }
+
+    buf_push(b, OP_RET);
+    buf_append(b, p->subr_bc.data, p->subr_bc.size);
+}
@@ -0,0 +1,292 @@
+#include "cnd_internal.h"
+
+// --- Switch Tables ---
+//
+// parse_switch collects the (value, offset) pairs of a switch and calls
+// switch_emit_table once the case bodies are emitted. Dense value ranges use
+// a direct OP_SWITCH_TABLE. Sparse switches are costed as a linear scan
+// (OP_SWITCH), a binary search over sorted cases (OP_SWITCH_SORTED) or a
+// perfect-hash lookup (OP_SWITCH_HASH), and the cheapest one is emitted.
+//
+// Costs are per dispatch, in units of one sequential table probe. A binary
+// search step is a dependent load plus a branch that mispredicts about half
+// the time, so it counts double. A hash lookup is a multiply and two
+// dependent loads (displacement, then slot) with one predictable compare.
+
+#define SWITCH_COST_SORTED_STEP 2
+#define SWITCH_COST_HASH 6
+
+// Multipliers tried per table size before growing the table or giving up
+#define SWITCH_HASH_ATTEMPTS 16
+// Matches the VM's limit on OP_SWITCH_HASH slot and bucket exponents
+#define SWITCH_HASH_MAX_BITS 16
+
+typedef struct {
+    uint64_t mult;
+    uint8_t slot_bits;
+    uint8_t bucket_bits;
+    uint16_t* disp;      // 2^bucket_bits displacements
+    uint32_t* slot_case; // Case index per slot, or UINT32_MAX when empty
+} SwitchHash;
+
+static uint32_t ceil_log2(size_t n) {
+    uint32_t bits = 0;
+    while (((size_t)1 << bits) < n) bits++;
+    return bits;
+}
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static int case_cmp(const void* a, const void* b) {
+    uint64_t va = ((const SwitchCase*)a)->val;
+    uint64_t vb = ((const SwitchCase*)b)->val;
+    return (va > vb) - (va < vb);
+}
+
+// Same slot function as the VM (vm_switch_hash_slot), before displacement
+static void hash_split(uint64_t v, uint64_t mult, uint8_t slot_bits, uint8_t bucket_bits,
+                       uint32_t* bucket, uint32_t* base) {
+    uint64_t h = v * mult;
+    *bucket = (uint32_t)(h >> (64 - bucket_bits));
+    *base = (uint32_t)((h << bucket_bits) >> (64 - slot_bits));
+}
+
+// Hash-and-displace construction: buckets are placed largest first, each
+// with the first displacement that sends all of its keys to free slots.
+static int hash_try(const SwitchCase* cases, size_t count, SwitchHash* h,
+                    uint32_t* bucket, uint32_t* base, uint32_t* order) {
+    uint32_t slots = 1u << h->slot_bits;
+    uint32_t buckets = 1u << h->bucket_bits;
+
+    uint32_t* start = calloc((size_t)buckets + 1, sizeof(uint32_t));
+    if (!start) return 0;
+    for (size_t i = 0; i < count; i++) {
+        hash_split(cases[i].val, h->mult, h->slot_bits, h->bucket_bits, &bucket[i], &base[i]);
+        start[bucket[i] + 1]++;
+    }
+    uint32_t max_size = 0;
+    for (uint32_t i = 0; i < buckets; i++) {
+        if (start[i + 1] > max_size) max_size = start[i + 1];
+        start[i + 1] += start[i];
+    }
+    // Group case indices by bucket
+    uint32_t* fill = malloc((size_t)buckets * sizeof(uint32_t));
+    if (!fill) { free(start); return 0; }
+    memcpy(fill, start, (size_t)buckets * sizeof(uint32_t));
+    for (size_t i = 0; i < count; i++) order[fill[bucket[i]]++] = (uint32_t)i;
+    free(fill);
+
+    memset(h->disp, 0, (size_t)buckets * sizeof(uint16_t));
+    for (uint32_t s = 0; s < slots; s++) h->slot_case[s] = UINT32_MAX;
+
+    int ok = 1;
+    for (uint32_t size = max_size; size > 0 && ok; size--) {
+        for (uint32_t b = 0; b < buckets && ok; b++) {
+            uint32_t first = start[b];
+            if (start[b + 1] - first != size) continue;
+
+            // Keys sharing a bucket and a base can never be separated
+            for (uint32_t i = 0; i < size && ok; i++) {
+                for (uint32_t j = i + 1; j < size; j++) {
+                    if (base[order[first + i]] == base[order[first + j]]) { ok = 0; break; }
+                }
+            }
+            if (!ok) break;
+
+            uint32_t d = 0;
+            for (; d < slots; d++) {
+                uint32_t i = 0;
+                while (i < size && h->slot_case[base[order[first + i]] ^ d] == UINT32_MAX) i++;
+                if (i == size) break;
+            }
+            if (d == slots) { ok = 0; break; }
+
+            h->disp[b] = (uint16_t)d;
+            for (uint32_t i = 0; i < size; i++) {
+                h->slot_case[base[order[first + i]] ^ d] = order[first + i];
+            }
+        }
+    }
+    free(start);
+    return ok;
+}
+
+// Searches for a perfect hash of the case values with a load factor of at
+// most 80%. The multiplier sequence is fixed so output is reproducible.
+static int hash_build(const SwitchCase* cases, size_t count, SwitchHash* h) {
+    uint32_t min_bits = ceil_log2(count + count / 4);
+    if (min_bits < 1) min_bits = 1;
+    if (min_bits > SWITCH_HASH_MAX_BITS) return 0;
+
+    uint32_t* scratch = malloc(count * 3 * sizeof(uint32_t));
+    if (!scratch) return 0;
+
+    int found = 0;
+    uint64_t seed = 0;
+    for (uint32_t bits = min_bits; bits <= min_bits + 1 && bits <= SWITCH_HASH_MAX_BITS && !found; bits++) {
+        h->slot_bits = (uint8_t)bits;
+        h->bucket_bits = (uint8_t)(bits > 3 ? bits - 2 : 1);
+        h->disp = malloc(((size_t)1 << h->bucket_bits) * sizeof(uint16_t));
+        h->slot_case = malloc(((size_t)1 << bits) * sizeof(uint32_t));
+        if (!h->disp || !h->slot_case) break;
+
+        for (int attempt = 0; attempt < SWITCH_HASH_ATTEMPTS && !found; attempt++) {
+            h->mult = splitmix64(&seed) | 1;
+            found = hash_try(cases, count, h, scratch, scratch + count, scratch + count * 2);
+        }
+        if (!found) {
+            free(h->disp); h->disp = NULL;
+            free(h->slot_case); h->slot_case = NULL;
+        }
+    }
+    free(scratch);
+    if (!found) {
+        free(h->disp); h->disp = NULL;
+        free(h->slot_case); h->slot_case = NULL;
+    }
+    return found;
+}
+
+uint8_t switch_emit_table(Buffer* b, SwitchCase* cases, size_t case_count,
+                          int32_t default_offset, size_t code_start_loc, size_t* table_end) {
+    size_t table_start = buf_current_offset(b);
+    uint8_t opcode = OP_SWITCH;
+
+    // Dense ranges index the table directly
+    uint64_t min_val = 0, max_val = 0;
+    if (case_count > 3) {
+        min_val = cases[0].val;
+        max_val = cases[0].val;
+        for (size_t i = 1; i < case_count; i++) {
+            if (cases[i].val < min_val) min_val = cases[i].val;
+            if (cases[i].val > max_val) max_val = cases[i].val;
+        }
+        // Range < 256 keeps the table small whatever the density
+        if (max_val - min_val < 256) opcode = OP_SWITCH_TABLE;
+    }
+
+    SwitchHash hash = {0};
+    if (opcode == OP_SWITCH) {
+        size_t cost = (case_count + 1) / 2;
+        size_t cost_sorted = SWITCH_COST_SORTED_STEP * ceil_log2(case_count + 1);
+        if (cost_sorted < cost) {
+            opcode = OP_SWITCH_SORTED;
+            cost = cost_sorted;
+        }
+        // Hashing is only tried when it would win; it can fail to find a table
+        if (SWITCH_COST_HASH < cost && hash_build(cases, case_count, &hash)) {
+            opcode = OP_SWITCH_HASH;
+        }
+    }
+
+    if (opcode == OP_SWITCH_TABLE) {
+        // Table Layout: Min(8), Max(8), Default(4), [Offset(4)] * (Range+1)
+        size_t range = (size_t)(max_val - min_val);
+        *table_end = table_start + 8 + 8 + 4 + (range + 1) * 4;
+        if (default_offset == -1) default_offset = (int32_t)(*table_end - code_start_loc);
+
+        buf_push_u64(b, min_val);
+        buf_push_u64(b, max_val);
+        buf_push_u32(b, (uint32_t)default_offset);
+        for (size_t i = 0; i <= range; i++) {
+            int32_t target = default_offset;
+            for (size_t j = 0; j < case_count; j++) {
+                if (cases[j].val == min_val + i) {
+                    target = cases[j].offset;
+                    break;
+                }
+            }
+            buf_push_u32(b, (uint32_t)target);
+        }
+    } else if (opcode == OP_SWITCH_HASH) {
+        // Table Layout: Default(4), Mult(8), SlotBits(1), BucketBits(1),
+        //   [Disp(2)] * 2^BucketBits, [Val(8), Offset(4)] * 2^SlotBits
+        size_t slots = (size_t)1 << hash.slot_bits;
+        size_t buckets = (size_t)1 << hash.bucket_bits;
+        *table_end = table_start + 14 + buckets * 2 + slots * 12;
+        if (default_offset == -1) default_offset = (int32_t)(*table_end - code_start_loc);
+
+        buf_push_u32(b, (uint32_t)default_offset);
+        buf_push_u64(b, hash.mult);
+        buf_push(b, hash.slot_bits);
+        buf_push(b, hash.bucket_bits);
+        for (size_t i = 0; i < buckets; i++) buf_push_u16(b, hash.disp[i]);
+        // Empty slots hold value 0 and the default, which is right for 0 either way
+        for (size_t i = 0; i < slots; i++) {
+            uint32_t c = hash.slot_case[i];
+            buf_push_u64(b, c == UINT32_MAX ? 0 : cases[c].val);
+            buf_push_u32(b, (uint32_t)(c == UINT32_MAX ? default_offset : cases[c].offset));
+        }
+        free(hash.disp);
+        free(hash.slot_case);
+    } else {
+        // Sparse Table Layout: Count(2), Default(4), [Val(8), Offset(4)] * Count
+        if (opcode == OP_SWITCH_SORTED) qsort(cases, case_count, sizeof(SwitchCase), case_cmp);
+
+        *table_end = table_start + 2 + 4 + case_count * 12;
+        if (default_offset == -1) default_offset = (int32_t)(*table_end - code_start_loc);
+
+        buf_push_u16(b, (uint16_t)case_count);
+        buf_push_u32(b, (uint32_t)default_offset);
+        for (size_t i = 0; i < case_count; i++) {
+            buf_push_u64(b, cases[i].val);
+            buf_push_u32(b, (uint32_t)cases[i].offset);
+        }
+    }
+
+    return opcode;
+}
+
+void switch_tables_add(SwitchTables* t, const uint8_t* bc, size_t len, size_t ip) {
+    if (ip + 7 > len || t->count >= CND_MAX_PENDING_TABLES) return;
+    size_t start = ip + 7 + ((size_t)bc[ip + 3] | ((size_t)bc[ip + 4] << 8) |
+                             ((size_t)bc[ip + 5] << 16) | ((size_t)bc[ip + 6] << 24));
+    const uint8_t* h = bc + start;
+    uint64_t size;
+    switch (bc[ip]) {
+        case OP_SWITCH:
+        case OP_SWITCH_SORTED:
+            if (start + 6 > len) return;
+            size = 6 + (uint64_t)(h[0] | (h[1] << 8)) * 12;
+            break;
+        case OP_SWITCH_TABLE: {
+            if (start + 20 > len) return;
+            uint64_t min_val = 0, max_val = 0;
+            for (int i = 7; i >= 0; i--) {
+                min_val = (min_val << 8) | h[i];
+                max_val = (max_val << 8) | h[8 + i];
+            }
+            if (max_val < min_val || max_val - min_val >= 0xFFFFFFFF) return;
+            size = 20 + (max_val - min_val + 1) * 4;
+            break;
+        }
+        case OP_SWITCH_HASH:
+            if (start + 14 > len || h[12] > SWITCH_HASH_MAX_BITS || h[13] > SWITCH_HASH_MAX_BITS) return;
+            size = 14 + ((uint64_t)2 << h[13]) + ((uint64_t)12 << h[12]);
+            break;
+        default:
+            return;
+    }
+    if (size > len - start) return;
+    t->start[t->count] = start;
+    t->end[t->count] = start + (size_t)size;
+    t->count++;
+}
+
+size_t switch_tables_skip(SwitchTables* t, size_t ip) {
+    for (int i = 0; i < t->count; i++) {
+        if (t->start[i] == ip) {
+            size_t end = t->end[i];
+            t->count--;
+            t->start[i] = t->start[t->count];
+            t->end[i] = t->end[t->count];
+            return end;
+        }
+    }
+    return 0;
+}
@@ -27,8 +27,20 @@ char* cnd_canonicalize_path(const char* path) {
 #endif
 }
 
-// Helper to get opcode instruction size (returns total bytes including opcode)
-static int get_opcode_size_and_keyid_offset(uint8_t op, int* keyid_offset) {
+static int opcode_type_size(uint8_t type) {
+    switch (type) {
+        case OP_IO_U8: case OP_IO_I8: case OP_IO_BOOL: return 1;
+        case OP_IO_U16: case OP_IO_I16: return 2;
+        case OP_IO_U32: case OP_IO_I32: case OP_IO_F32: return 4;
+        case OP_IO_U64: case OP_IO_I64: case OP_IO_F64: return 8;
+        default: return 0;
+    }
+}
+
+// Helper to get opcode instruction size (returns total bytes including opcode).
+// `ins` points at the opcode with `avail` bytes left, for operand-sized ops.
+int get_opcode_size_and_keyid_offset(const uint8_t* ins, size_t avail, int* keyid_offset) {
+    uint8_t op = ins[0];
     *keyid_offset = -1; // -1 means no key ID in this instruction
     
     switch (op) {
@@ -39,6 +51,8 @@ static int get_opcode_size_and_keyid_offset(uint8_t op, int* keyid_offset) {
         case OP_ARR_END:
         case OP_EXIT_BIT_MODE:
         case OP_ENTER_BIT_MODE:
+        case OP_CRC_BEGIN:
+        case OP_CRC_END:
         case OP_ADD:
         case OP_SUB:
         case OP_MUL:
@@ -85,6 +99,7 @@ static int get_opcode_size_and_keyid_offset(uint8_t op, int* keyid_offset) {
         case OP_LTE_F:
             return 1;
             
+        case OP_META_VERSION:
         case OP_ALIGN_PAD:
         case OP_ALIGN_FILL:
         case OP_EMIT:
@@ -93,7 +108,6 @@ static int get_opcode_size_and_keyid_offset(uint8_t op, int* keyid_offset) {
         // Opcodes with key_id at offset 1
         case OP_ENTER_STRUCT:
         case OP_META_NAME:
-        case OP_META_VERSION:
         case OP_IO_U8:
         case OP_IO_U16:
         case OP_IO_U32:
@@ -105,7 +119,6 @@ static int get_opcode_size_and_keyid_offset(uint8_t op, int* keyid_offset) {
         case OP_IO_F32:
         case OP_IO_F64:
         case OP_IO_BOOL:
-        case OP_IO_BIT_BOOL:
         case OP_LOAD_CTX:
         case OP_STORE_CTX:
         case OP_ARR_EOF:
@@ -114,6 +127,7 @@ static int get_opcode_size_and_keyid_offset(uint8_t op, int* keyid_offset) {
             
         case OP_IO_BIT_U:
         case OP_IO_BIT_I:
+        case OP_IO_BIT_BOOL:
             *keyid_offset = 1;
             return 4; // op + key(2) + bits(1)
             
@@ -142,42 +156,141 @@ static int get_opcode_size_and_keyid_offset(uint8_t op, int* keyid_offset) {
         case OP_JUMP:
         case OP_JUMP_IF_NOT:
             return 5; // op + offset(4)
+
+        case OP_CALL:
+            return 9; // op + key_base(2) + key_count(2) + offset(4)
+
+        case OP_RET:
+            return 1;
             
         case OP_PUSH_IMM:
             return 9; // op + val(8)
             
         case OP_SWITCH:
+        case OP_SWITCH_TABLE:
+        case OP_SWITCH_SORTED:
+        case OP_SWITCH_HASH:
             *keyid_offset = 1;
             return 7; // op + key(2) + table_off(4)
             
-        // Variable length - skip for now, struct bytecode shouldn't have these
-        case OP_CONST_CHECK:
-        case OP_CONST_WRITE:
-        case OP_RANGE_CHECK:
-        case OP_SCALE_LIN:
+        case OP_MARK_OPTIONAL:
+            return 1;
+
         case OP_TRANS_ADD:
         case OP_TRANS_SUB:
         case OP_TRANS_MUL:
         case OP_TRANS_DIV:
-        case OP_TRANS_POLY:
-        case OP_TRANS_SPLINE:
+            return 9; // op + val(8)
+
+        case OP_SCALE_LIN:
+            return 17; // op + factor(8) + offset(8)
+
         case OP_CRC_16:
+            return 8; // op + poly(2) + init(2) + xor(2) + flags(1)
+
         case OP_CRC_32:
+            return 14; // op + poly(4) + init(4) + xor(4) + flags(1)
+
+        // Variable length, sized from their operands
+        case OP_CONST_CHECK: {
+            if (avail < 4 || opcode_type_size(ins[3]) == 0) return -1;
+            *keyid_offset = 1;
+            return 4 + opcode_type_size(ins[3]); // op + key(2) + type(1) + value
+        }
+
+        case OP_CONST_WRITE:
+            if (avail < 2 || opcode_type_size(ins[1]) == 0) return -1;
+            return 2 + opcode_type_size(ins[1]);
+
+        case OP_RANGE_CHECK:
+            if (avail < 2 || opcode_type_size(ins[1]) == 0) return -1;
+            return 2 + 2 * opcode_type_size(ins[1]);
+
         case OP_ENUM_CHECK:
-        case OP_MARK_OPTIONAL:
+        case OP_ENUM_SORTED:
+            if (avail < 4 || opcode_type_size(ins[1]) == 0) return -1;
+            return 4 + (ins[2] | (ins[3] << 8)) * opcode_type_size(ins[1]);
+
+        case OP_ENUM_BITMAP: {
+            int size = opcode_type_size(avail < 2 ? 0 : ins[1]);
+            if (size == 0 || avail < (size_t)size + 4) return -1;
+            return 4 + size + ((ins[2 + size] | (ins[3 + size] << 8)) + 7) / 8;
+        }
+
+        case OP_TRANS_POLY:
+            if (avail < 2) return -1;
+            return 2 + ins[1] * 8;
+
+        case OP_TRANS_SPLINE:
+            if (avail < 2) return -1;
+            return 2 + ins[1] * 16;
+
+        case OP_EXPR:
+            if (avail < 2) return -1;
+            return 2 + ins[1]; // op + len(1) + register program
+
         default:
-            return -1; // Unknown/variable - can't process
+            return -1; // Unknown - can't process
+    }
+}
+
+uint16_t prefixed_key(uint16_t old_key, const char* prefix, int prefix_len, StringTable* strtab) {
+    // Look up old string
+    const char* old_name = (old_key < strtab->count) ? strtab->strings[old_key] : "";
+    int old_len = (int)strlen(old_name);
+
+    // Build new prefixed name
+    char new_name[512];
+    if (prefix_len + 1 + old_len < 512) {
+        memcpy(new_name, prefix, prefix_len);
+        new_name[prefix_len] = '.';
+        memcpy(new_name + prefix_len + 1, old_name, old_len);
+        new_name[prefix_len + 1 + old_len] = '\0';
+    } else {
+        // Fallback - just use old name
+        memcpy(new_name, old_name, old_len + 1);
     }
+
+    // Add new name to strtab and get new key ID
+    return strtab_add(strtab, new_name, prefix_len + 1 + old_len);
 }
 
 // Append struct bytecode with key IDs remapped to include prefix
 void buf_append_with_prefix(Buffer* b, const uint8_t* src, size_t len, 
                             const char* prefix, int prefix_len, StringTable* strtab) {
+    SwitchTables tables = {0};
     size_t i = 0;
     while (i < len) {
+        // Jump tables hold no keys and are copied as they are
+        size_t table_end = switch_tables_skip(&tables, i);
+        if (table_end) {
+            buf_append(b, src + i, table_end - i);
+            i = table_end;
+            continue;
+        }
+
         uint8_t op = src[i];
+        if (op == OP_SWITCH || op == OP_SWITCH_TABLE || op == OP_SWITCH_SORTED || op == OP_SWITCH_HASH) {
+            switch_tables_add(&tables, src, len, i);
+        }
+
+        if (op == OP_IO_BIT_GROUP && i + 2 <= len && i + 2 + (size_t)src[i + 1] * 4 <= len) {
+            // Count(1) + Count * {Type(1) Key(2) Width(1)}: every field has a key
+            uint8_t count = src[i + 1];
+            buf_append(b, src + i, 2);
+            for (uint8_t f = 0; f < count; f++) {
+                const uint8_t* e = src + i + 2 + (size_t)f * 4;
+                uint16_t new_key = prefixed_key((uint16_t)(e[1] | (e[2] << 8)), prefix, prefix_len, strtab);
+                buf_push(b, e[0]);
+                buf_push_u16(b, new_key);
+                buf_push(b, e[3]);
+            }
+            i += 2 + (size_t)count * 4;
+            continue;
+        }
+
         int keyid_offset;
-        int instr_size = get_opcode_size_and_keyid_offset(op, &keyid_offset);
+        int instr_size = get_opcode_size_and_keyid_offset(src + i, len - i, &keyid_offset);
         
         if (instr_size < 0 || i + instr_size > len) {
             // Unknown opcode or would overflow - just copy rest verbatim
@@ -195,25 +308,7 @@ void buf_append_with_prefix(Buffer* b, const uint8_t* src, size_t len,
             
             // Read old key ID
             uint16_t old_key = src[i + keyid_offset] | (src[i + keyid_offset + 1] << 8);
-            
-            // Look up old string
-            const char* old_name = (old_key < strtab->count) ? strtab->strings[old_key] : "";
-            int old_len = (int)strlen(old_name);
-            
-            // Build new prefixed name
-            char new_name[512];
-            if (prefix_len + 1 + old_len < 512) {
-                memcpy(new_name, prefix, prefix_len);
-                new_name[prefix_len] = '.';
-                memcpy(new_name + prefix_len + 1, old_name, old_len);
-                new_name[prefix_len + 1 + old_len] = '\0';
-            } else {
-                // Fallback - just use old name
-                memcpy(new_name, old_name, old_len + 1);
-            }
-            
-            // Add new name to strtab and get new key ID
-            uint16_t new_key = strtab_add(strtab, new_name, prefix_len + 1 + old_len);
+            uint16_t new_key = prefixed_key(old_key, prefix, prefix_len, strtab);
             
             // Write new key ID
             buf_push(b, new_key & 0xFF);
@@ -251,6 +346,16 @@ void buf_append(Buffer* b, const uint8_t* data, size_t len) {
     b->size += len;
 }
 
+void buf_insert(Buffer* b, size_t offset, const uint8_t* data, size_t len) {
+    if (b->size + len > b->capacity) {
+        while (b->size + len > b->capacity) b->capacity *= 2;
+        b->data = realloc(b->data, b->capacity);
+    }
+    memmove(b->data + offset + len, b->data + offset, b->size - offset);
+    memcpy(b->data + offset, data, len);
+    b->size += len;
+}
+
 void buf_push(Buffer* b, uint8_t byte) {
     if (b->size >= b->capacity) {
         b->capacity *= 2;
@@ -348,6 +453,7 @@ void reg_free(StructRegistry* r) {
         if (r->defs[i].file) free(r->defs[i].file);
         if (r->defs[i].doc_comment) free(r->defs[i].doc_comment);
         buf_free(&r->defs[i].bytecode);
+        free(r->defs[i].subr_keys);
     }
     free(r->defs);
     r->count = 0;
@@ -368,6 +474,9 @@ StructDef* reg_add(StructRegistry* r, const char* name, int len, int line, const
     def->file = file ? strdup(file) : NULL;
     def->doc_comment = doc ? strdup(doc) : NULL;
     buf_init(&def->bytecode);
+    def->subr_at = SUBR_NONE;
+    def->subr_keys = NULL;
+    def->subr_key_count = 0;
     return def;
 }
 
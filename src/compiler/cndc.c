@@ -23,8 +23,11 @@ static void optimize_strings(Parser* p) {
     size_t offset = 0;
     uint8_t* bc = p->global_bc.data;
     size_t len = p->global_bc.size;
+    SwitchTables tables = {0};
 
     while (offset < len) {
+        size_t table_end = switch_tables_skip(&tables, offset);
+        if (table_end) { offset = table_end; continue; }
         uint8_t op = bc[offset++];
         
         // Opcodes with string ID at offset 0 (immediately after op)
@@ -38,6 +41,9 @@ static void optimize_strings(Parser* p) {
             op == OP_ARR_DYNAMIC ||
             op == OP_CONST_CHECK ||
             op == OP_SWITCH ||
+            op == OP_SWITCH_TABLE ||
+            op == OP_SWITCH_SORTED ||
+            op == OP_SWITCH_HASH ||
             op == OP_LOAD_CTX ||
             op == OP_CTX_QUERY ||
             op == OP_STORE_CTX) {
@@ -53,6 +59,16 @@ static void optimize_strings(Parser* p) {
             case OP_META_VERSION: offset += 1; break;
             case OP_IO_BIT_U: case OP_IO_BIT_I: case OP_IO_BIT_BOOL: offset += 1; break;
             case OP_ALIGN_PAD: case OP_ALIGN_FILL: offset += 1; break;
+            case OP_IO_BIT_GROUP: {
+                // Count(1) + Count * {Type(1) Key(2) Width(1)}
+                if (offset + 1 > len) break;
+                uint8_t count = bc[offset++];
+                for (uint8_t f = 0; f < count && offset + 4 <= len; f++, offset += 4) {
+                    uint16_t id = il_get_u16(bc + offset + 1);
+                    if (id < p->strtab.count) used[id] = 1;
+                }
+                break;
+            }
             case OP_ARR_FIXED: offset += 4; break; // u32 count
             case OP_ARR_PRE_U8: case OP_ARR_PRE_U16: case OP_ARR_PRE_U32: break; // No extra args
             case OP_ARR_EOF: break; // No extra args
@@ -91,13 +107,21 @@ static void optimize_strings(Parser* p) {
                 offset += sz * 2; // min, max
                 break;
             }
-            case OP_ENUM_CHECK: {
+            case OP_ENUM_CHECK: case OP_ENUM_SORTED: {
                 if (offset + 3 > len) break;
                 uint8_t type = bc[offset++];
                 uint16_t count = *(uint16_t*)(bc + offset); offset += 2;
                 offset += count * get_type_size(type);
                 break;
             }
+            case OP_ENUM_BITMAP: {
+                if (offset + 1 > len) break;
+                int size = get_type_size(bc[offset++]);
+                if (offset + size + 2 > len) break;
+                uint16_t span = *(uint16_t*)(bc + offset + size);
+                offset += size + 2 + (span + 7) / 8;
+                break;
+            }
             case OP_CRC_16: offset += 7; break; // poly(2), init(2), xor(2), flags(1)
             case OP_CRC_32: offset += 13; break; // poly(4), init(4), xor(4), flags(1)
             case OP_SCALE_LIN: offset += 16; break; // double, double
@@ -116,17 +140,23 @@ static void optimize_strings(Parser* p) {
             }
             
             case OP_JUMP_IF_NOT: case OP_JUMP: offset += 4; break;
-            case OP_SWITCH: {
+            case OP_SWITCH: case OP_SWITCH_TABLE: case OP_SWITCH_SORTED: case OP_SWITCH_HASH: {
                 if (offset + 4 > len) break;
+                switch_tables_add(&tables, bc, len, offset - 3);
                 offset += 4; // Table Offset
                 break;
             }
-            case OP_PUSH_IMM: {
-                if (offset + 1 > len) break;
-                uint8_t type = bc[offset++];
-                offset += get_type_size(type);
+            case OP_CALL: {
+                // KeyBase(2) KeyCount(2) Offset(4): the callee uses the whole block
+                if (offset + 8 > len) break;
+                uint16_t base = *(uint16_t*)(bc + offset);
+                uint16_t count = *(uint16_t*)(bc + offset + 2);
+                for (uint32_t k = base; k < (uint32_t)base + count && k < p->strtab.count; k++) used[k] = 1;
+                offset += 8;
                 break;
             }
+            case OP_PUSH_IMM: offset += 8; break; // u64 immediate
+            case OP_EMIT: offset += 1; break; // type
             case OP_STR_NULL: offset += 2; break; // max_len
             case OP_STR_PRE_U8: case OP_STR_PRE_U16: case OP_STR_PRE_U32: break; // No extra args
         }
@@ -148,7 +178,10 @@ static void optimize_strings(Parser* p) {
 
     // 3. Update bytecode
     offset = 0;
+    tables.count = 0;
     while (offset < len) {
+        size_t table_end = switch_tables_skip(&tables, offset);
+        if (table_end) { offset = table_end; continue; }
         uint8_t op = bc[offset++];
         
         if (op == OP_META_NAME || 
@@ -161,6 +194,9 @@ static void optimize_strings(Parser* p) {
             op == OP_ARR_DYNAMIC ||
             op == OP_CONST_CHECK ||
             op == OP_SWITCH ||
+            op == OP_SWITCH_TABLE ||
+            op == OP_SWITCH_SORTED ||
+            op == OP_SWITCH_HASH ||
             op == OP_LOAD_CTX ||
             op == OP_CTX_QUERY ||
             op == OP_STORE_CTX) {
@@ -179,6 +215,18 @@ static void optimize_strings(Parser* p) {
             case OP_META_VERSION: offset += 1; break;
             case OP_IO_BIT_U: case OP_IO_BIT_I: case OP_IO_BIT_BOOL: offset += 1; break;
             case OP_ALIGN_PAD: case OP_ALIGN_FILL: offset += 1; break;
+            case OP_IO_BIT_GROUP: {
+                if (offset + 1 > len) break;
+                uint8_t count = bc[offset++];
+                for (uint8_t f = 0; f < count && offset + 4 <= len; f++, offset += 4) {
+                    uint16_t* id_ptr = (uint16_t*)(bc + offset + 1);
+                    uint16_t old_id = *id_ptr;
+                    if (old_id < p->strtab.count) {
+                        *id_ptr = map[old_id];
+                    }
+                }
+                break;
+            }
             case OP_ARR_FIXED: offset += 4; break; // u32 count
             case OP_ARR_PRE_U8: case OP_ARR_PRE_U16: case OP_ARR_PRE_U32: break; // No extra args
             case OP_ARR_DYNAMIC: {
@@ -217,29 +265,57 @@ static void optimize_strings(Parser* p) {
                 offset += sz * 2;
                 break;
             }
-            case OP_ENUM_CHECK: {
+            case OP_ENUM_CHECK: case OP_ENUM_SORTED: {
                 if (offset + 3 > len) break;
                 uint8_t type = bc[offset++];
                 uint16_t count = *(uint16_t*)(bc + offset); offset += 2;
                 offset += count * get_type_size(type);
                 break;
             }
+            case OP_ENUM_BITMAP: {
+                if (offset + 1 > len) break;
+                int size = get_type_size(bc[offset++]);
+                if (offset + size + 2 > len) break;
+                uint16_t span = *(uint16_t*)(bc + offset + size);
+                offset += size + 2 + (span + 7) / 8;
+                break;
+            }
             case OP_CRC_16: offset += 7; break;
             case OP_CRC_32: offset += 13; break;
             case OP_SCALE_LIN: offset += 16; break;
             case OP_TRANS_ADD: case OP_TRANS_SUB: case OP_TRANS_MUL: case OP_TRANS_DIV: offset += 8; break;
+            case OP_TRANS_POLY: {
+                if (offset + 1 > len) break;
+                uint8_t count = bc[offset++];
+                offset += count * 8;
+                break;
+            }
+            case OP_TRANS_SPLINE: {
+                if (offset + 1 > len) break;
+                uint8_t count = bc[offset++];
+                offset += count * 16;
+                break;
+            }
             case OP_JUMP_IF_NOT: case OP_JUMP: offset += 4; break;
-            case OP_SWITCH: {
+            case OP_SWITCH: case OP_SWITCH_TABLE: case OP_SWITCH_SORTED: case OP_SWITCH_HASH: {
                 if (offset + 4 > len) break;
+                switch_tables_add(&tables, bc, len, offset - 3);
                 offset += 4; // Table Offset
                 break;
             }
-            case OP_PUSH_IMM: {
-                if (offset + 1 > len) break;
-                uint8_t type = bc[offset++];
-                offset += get_type_size(type);
+            case OP_CALL: {
+                // The block stays contiguous: every key in it is used and the map is monotonic
+                if (offset + 8 > len) break;
+                uint16_t* id_ptr = (uint16_t*)(bc + offset);
+                uint16_t old_id = *id_ptr;
+                if (old_id < p->strtab.count) {
+                    *id_ptr = map[old_id];
+                }
+                offset += 8;
                 break;
             }
+            case OP_PUSH_IMM: offset += 8; break; // u64 immediate
+            case OP_EMIT: offset += 1; break; // type
             case OP_STR_NULL: offset += 2; break; // max_len
             case OP_STR_PRE_U8: case OP_STR_PRE_U16: case OP_STR_PRE_U32: break; // No extra args
         }
@@ -254,8 +330,12 @@ static void optimize_strings(Parser* p) {
     free(map);
 }
 
-// Implementation of cnd_compile_file using the new modular structure
 int cnd_compile_file(const char* in_path, const char* out_path, int json_output, int verbose) {
+    return cnd_compile_file_ex(in_path, out_path, json_output, verbose, 0);
+}
+
+// Implementation of cnd_compile_file using the new modular structure
+int cnd_compile_file_ex(const char* in_path, const char* out_path, int json_output, int verbose, int opt_level) {
     setbuf(stdout, NULL); // Ensure debug prints are flushed immediately
     char* canonical_in_path = cnd_canonicalize_path(in_path);
     const char* open_path = canonical_in_path ? canonical_in_path : in_path;
@@ -281,6 +361,7 @@ int cnd_compile_file(const char* in_path, const char* out_path, int json_output,
     reg_init(&p.registry);
     enum_reg_init(&p.enums);
     p.target = &p.global_bc;
+    p.subroutines = 1;
     p.current_path = open_path;
     p.json_output = json_output;
     p.verbose = verbose;
@@ -297,6 +378,10 @@ int cnd_compile_file(const char* in_path, const char* out_path, int json_output,
         ret = 1;
     } else {
         optimize_strings(&p);
+        subr_link(&p);
+
+        OptStats opt = {0};
+        int optimized = opt_level > 0 && il_optimize(&p.global_bc, &opt);
 
         FILE* out = fopen(out_path, "wb");
         if (!out) { 
@@ -304,17 +389,36 @@ int cnd_compile_file(const char* in_path, const char* out_path, int json_output,
             else printf(COLOR_BOLD COLOR_RED "[ERROR]" COLOR_RESET " Error opening output file: %s\n", out_path); 
             ret = 1; 
         } else {
-            fwrite("CNDIL", 1, 5, out); fputc(1, out);
+            Buffer layout;
+            buf_init(&layout);
+            uint16_t layout_count = 0;
+            layout_build(p.global_bc.data, p.global_bc.size, (uint16_t)p.strtab.count, &layout, &layout_count);
+
+            // Packet size bounds over every path of the final bytecode
+            cnd_program sized;
+            uint32_t min_size = 0, max_size = 0;
+            cnd_program_load(&sized, p.global_bc.data, p.global_bc.size);
+            cnd_program_size_bounds(&sized, &min_size, &max_size);
+
+            // Header (v3): Magic(5) Ver(1) StrCount(2) StrOff(4) BCOff(4) LayoutOff(4) LayoutCount(2) Reserved(2)
+            //              MinSize(4) MaxSize(4)
+            fwrite("CNDIL", 1, 5, out); fputc(CND_IL_VERSION, out);
             uint16_t str_count = (uint16_t)p.strtab.count; fwrite(&str_count, 2, 1, out); 
             
-            uint32_t str_offset = 16;
+            uint32_t str_offset = CND_IL_HEADER_SIZE;
             uint32_t str_bytes = 0;
             for(size_t i=0; i<p.strtab.count; i++) { str_bytes += (uint32_t)(strlen(p.strtab.strings[i]) + 1); }
-            uint32_t bytecode_offset = str_offset + str_bytes;
+            uint32_t layout_offset = str_offset + str_bytes;
+            uint32_t bytecode_offset = layout_offset + (uint32_t)layout.size;
+            uint16_t reserved = 0;
             
             fwrite(&str_offset, 4, 1, out); fwrite(&bytecode_offset, 4, 1, out);
+            fwrite(&layout_offset, 4, 1, out); fwrite(&layout_count, 2, 1, out); fwrite(&reserved, 2, 1, out);
+            fwrite(&min_size, 4, 1, out); fwrite(&max_size, 4, 1, out);
             
             for(size_t i=0; i<p.strtab.count; i++) { fwrite(p.strtab.strings[i], 1, strlen(p.strtab.strings[i]) + 1, out); }
+            if (layout.size) fwrite(layout.data, 1, layout.size, out);
+            buf_free(&layout);
             
             fwrite(p.global_bc.data, 1, p.global_bc.size, out);
             
@@ -322,12 +426,26 @@ int cnd_compile_file(const char* in_path, const char* out_path, int json_output,
             if (json_output) {
                 // Escape paths for JSON (simple check)
                 // For now assuming paths don't have crazy characters, but in production should be escaped properly
-                printf("{\"status\": \"success\", \"input\": \"%s\", \"output\": \"%s\", \"stats\": {\"strings\": %zu, \"bytecode_size\": %zu}}\n",
+                printf("{\"status\": \"success\", \"input\": \"%s\", \"output\": \"%s\", \"stats\": {\"strings\": %zu, \"bytecode_size\": %zu",
                     in_path, out_path, p.strtab.count, p.global_bc.size);
+                printf(", \"min_size\": %u, \"max_size\": ", min_size);
+                if (max_size) printf("%u", max_size);
+                else printf("null");
+                if (optimized) {
+                    printf(", \"optimized\": {\"bytecode_before\": %zu, \"bytecode_after\": %zu, \"instructions_before\": %zu, \"instructions_after\": %zu}",
+                        opt.bytes_before, opt.bytes_after, opt.insns_before, opt.insns_after);
+                }
+                printf("}}\n");
             } else {
                 printf(COLOR_BOLD COLOR_GREEN "[SUCCESS]" COLOR_RESET " Compiled " COLOR_CYAN "%s" COLOR_RESET "\n", in_path);
                 printf("  " COLOR_BOLD "Output:" COLOR_RESET "   %s\n", out_path);
                 printf("  " COLOR_BOLD "Stats:" COLOR_RESET "    %zu strings, %zu bytes bytecode\n", p.strtab.count, p.global_bc.size);
+                if (max_size) printf("  " COLOR_BOLD "Packet:" COLOR_RESET "   %u to %u bytes\n", min_size, max_size);
+                else printf("  " COLOR_BOLD "Packet:" COLOR_RESET "   %u bytes or more\n", min_size);
+                if (optimized) {
+                    printf("  " COLOR_BOLD "Optimized:" COLOR_RESET " %zu -> %zu bytes, %zu -> %zu instructions\n",
+                        opt.bytes_before, opt.bytes_after, opt.insns_before, opt.insns_after);
+                }
             }
         }
     }
@@ -335,12 +453,14 @@ int cnd_compile_file(const char* in_path, const char* out_path, int json_output,
     // Cleanup
     free(source);
     buf_free(&p.global_bc);
+    if (p.subr_bc.data) buf_free(&p.subr_bc);
     
     // Free registries
     if (p.registry.defs) {
         for(size_t i=0; i<p.registry.count; i++) {
             free(p.registry.defs[i].name);
             buf_free(&p.registry.defs[i].bytecode);
+            free(p.registry.defs[i].subr_keys);
             if(p.registry.defs[i].file) free(p.registry.defs[i].file);
             if(p.registry.defs[i].doc_comment) free(p.registry.defs[i].doc_comment);
         }
@@ -0,0 +1,305 @@
+#include "vm_internal.h"
+#include <string.h>
+
+// --- Native Struct Binding ---
+//
+// The binder follows the callback protocol: ENTER_STRUCT / EXIT_STRUCT and the
+// array start / ARR_END events push and pop frames, and every value event is
+// resolved against the innermost frame. The bound interpreter loops handle
+// plain primitives inline (vm_bind_scalar) and call in here for the rest.
+
+static cnd_bind_frame* bind_top(cnd_binder* b) {
+    return &b->frames[b->depth - 1];
+}
+
+static bool bind_push(cnd_binder* b, uint8_t* base, uint8_t* elems, uint32_t stride, uint32_t limit, uint16_t key) {
+    if (b->depth >= CND_MAX_BIND_DEPTH) return false;
+    cnd_bind_frame* f = &b->frames[b->depth++];
+    f->base = base;
+    f->elems = elems;
+    f->stride = stride;
+    f->index = 0;
+    f->limit = limit;
+    f->key = key;
+    return true;
+}
+
+uint8_t bind_wire_type(uint8_t type) {
+    switch (type) {
+        case OP_IO_BIT_U: return OP_IO_U64;
+        case OP_IO_BIT_I: return OP_IO_I64;
+        case OP_IO_BIT_BOOL: return OP_IO_U8;
+        case OP_CTX_QUERY: case OP_LOAD_CTX: case OP_STORE_CTX: return OP_IO_U64;
+        default: return type;
+    }
+}
+
+static bool bind_is_float(uint8_t type) {
+    return type == OP_IO_F32 || type == OP_IO_F64;
+}
+
+static int64_t bind_load_int(uint8_t type, const void* p) {
+    switch (type) {
+        case OP_IO_U8: case OP_IO_BOOL: { uint8_t v; memcpy(&v, p, 1); return v; }
+        case OP_IO_I8: { int8_t v; memcpy(&v, p, 1); return v; }
+        case OP_IO_U16: { uint16_t v; memcpy(&v, p, 2); return v; }
+        case OP_IO_I16: { int16_t v; memcpy(&v, p, 2); return v; }
+        case OP_IO_U32: { uint32_t v; memcpy(&v, p, 4); return v; }
+        case OP_IO_I32: { int32_t v; memcpy(&v, p, 4); return v; }
+        case OP_IO_F32: { float v; memcpy(&v, p, 4); return (int64_t)v; }
+        case OP_IO_F64: { double v; memcpy(&v, p, 8); return (int64_t)v; }
+        default: { int64_t v; memcpy(&v, p, 8); return v; }
+    }
+}
+
+static double bind_load_float(uint8_t type, const void* p) {
+    if (type == OP_IO_F32) { float v; memcpy(&v, p, 4); return v; }
+    if (type == OP_IO_F64) { double v; memcpy(&v, p, 8); return v; }
+    if (type == OP_IO_U64) { uint64_t v; memcpy(&v, p, 8); return (double)v; }
+    return (double)bind_load_int(type, p);
+}
+
+static void bind_store_int(uint8_t type, void* p, int64_t v) {
+    switch (type) {
+        case OP_IO_U8: case OP_IO_I8: case OP_IO_BOOL: { uint8_t t = (uint8_t)v; memcpy(p, &t, 1); break; }
+        case OP_IO_U16: case OP_IO_I16: { uint16_t t = (uint16_t)v; memcpy(p, &t, 2); break; }
+        case OP_IO_U32: case OP_IO_I32: { uint32_t t = (uint32_t)v; memcpy(p, &t, 4); break; }
+        case OP_IO_F32: { float t = (float)v; memcpy(p, &t, 4); break; }
+        case OP_IO_F64: { double t = (double)v; memcpy(p, &t, 8); break; }
+        default: memcpy(p, &v, 8); break;
+    }
+}
+
+static void bind_store_float(uint8_t type, void* p, double v) {
+    if (type == OP_IO_F32) { float t = (float)v; memcpy(p, &t, 4); }
+    else if (type == OP_IO_F64) memcpy(p, &v, 8);
+    else bind_store_int(type, p, (int64_t)v);
+}
+
+void bind_copy(bool encode, uint8_t wire_type, void* wire, uint8_t host_type, void* host) {
+    if (wire_type == host_type) {
+        size_t size = il_type_size(host_type);
+        if (encode) memcpy(wire, host, size);
+        else memcpy(host, wire, size);
+        return;
+    }
+    if (encode) {
+        if (bind_is_float(wire_type)) bind_store_float(wire_type, wire, bind_load_float(host_type, host));
+        else bind_store_int(wire_type, wire, bind_load_int(host_type, host));
+    } else {
+        if (bind_is_float(wire_type)) bind_store_float(host_type, host, bind_load_float(wire_type, wire));
+        else bind_store_int(host_type, host, bind_load_int(wire_type, wire));
+    }
+}
+
+// Storage for the next value of `key`: the next element when the innermost
+// frame is an array of `key`, otherwise the field in the innermost struct.
+static uint8_t* bind_slot(cnd_binder* b, uint16_t key, const cnd_binding* e) {
+    cnd_bind_frame* f = bind_top(b);
+    if (f->key != key && e->stride != 0) {
+        // Until-EOF arrays have no start event; open their frame here
+        if (!bind_push(b, f->base, f->base + e->offset, e->stride, e->capacity, key)) return NULL;
+        f = bind_top(b);
+    }
+    if (f->key == key) {
+        if (f->index >= f->limit) return NULL;
+        return f->elems + (size_t)f->index++ * f->stride;
+    }
+    return f->base + e->offset;
+}
+
+static uint32_t bind_count_size(uint8_t type) {
+    switch (type) {
+        case OP_ARR_PRE_U8: return 1;
+        case OP_ARR_PRE_U16: return 2;
+        case OP_ARR_PRE_U32: return 4;
+        default: return 4; // OP_ARR_FIXED / OP_ARR_DYNAMIC pass a uint32_t
+    }
+}
+
+static cnd_error_t bind_array_start(cnd_vm_ctx* ctx, cnd_binder* b, uint16_t key, const cnd_binding* e,
+                                    uint8_t type, void* ptr) {
+    cnd_bind_frame* f = bind_top(b);
+    uint32_t size = bind_count_size(type);
+    uint64_t count = 0;
+
+    if (ctx->mode == CND_MODE_ENCODE && (type == OP_ARR_PRE_U8 || type == OP_ARR_PRE_U16 || type == OP_ARR_PRE_U32)) {
+        count = e->count_type ? (uint64_t)bind_load_int(e->count_type, f->base + e->count_offset) : e->capacity;
+        if (count > e->capacity) return CND_ERR_VALIDATION;
+        if (size == 1) { uint8_t v = (uint8_t)count; memcpy(ptr, &v, 1); }
+        else if (size == 2) { uint16_t v = (uint16_t)count; memcpy(ptr, &v, 2); }
+        else { uint32_t v = (uint32_t)count; memcpy(ptr, &v, 4); }
+    } else {
+        if (size == 1) { uint8_t v; memcpy(&v, ptr, 1); count = v; }
+        else if (size == 2) { uint16_t v; memcpy(&v, ptr, 2); count = v; }
+        else { uint32_t v; memcpy(&v, ptr, 4); count = v; }
+        if (count > e->capacity) return CND_ERR_VALIDATION;
+        if (ctx->mode == CND_MODE_DECODE && e->count_type) {
+            bind_store_int(e->count_type, f->base + e->count_offset, (int64_t)count);
+        }
+    }
+
+    // Empty arrays skip their body and never report ARR_END
+    if (count == 0) return CND_ERR_OK;
+    if (!bind_push(b, f->base, f->base + e->offset, e->stride, (uint32_t)count, key)) return CND_ERR_STACK_OVERFLOW;
+    return CND_ERR_OK;
+}
+
+static cnd_error_t bind_string(cnd_vm_ctx* ctx, uint8_t* slot, uint32_t cap, uint8_t type, void* ptr) {
+    if (cap == 0) return CND_ERR_VALIDATION;
+    if (ctx->mode == CND_MODE_ENCODE) {
+        // The VM measures with strlen; keep it inside the host buffer
+        if (!memchr(slot, 0, cap)) return CND_ERR_VALIDATION;
+        *(const char**)ptr = (const char*)slot;
+        return CND_ERR_OK;
+    }
+
+    const uint8_t* src = (const uint8_t*)ptr;
+    size_t len;
+    switch (type) {
+        case OP_STR_PRE_U8: len = read_u8(src - 1); break;
+        case OP_STR_PRE_U16: len = read_u16(src - 2, ctx->endianness); break;
+        case OP_STR_PRE_U32: len = read_u32(src - 4, ctx->endianness); break;
+        default: {
+            // OP_STR_NULL: terminated in the buffer unless max_len was reached
+            size_t avail = ctx->data_len - (size_t)(src - ctx->data_buffer);
+            const uint8_t* nul = (const uint8_t*)memchr(src, 0, avail);
+            len = nul ? (size_t)(nul - src) : avail;
+            break;
+        }
+    }
+    if (len > cap - 1) len = cap - 1;
+    memcpy(slot, src, len);
+    slot[len] = 0;
+    return CND_ERR_OK;
+}
+
+void cnd_binder_init(cnd_binder* binder, const cnd_binding* table, uint16_t count, void* host) {
+    if (!binder) return;
+    binder->table = table;
+    binder->count = count;
+    binder->depth = 0;
+    bind_push(binder, (uint8_t*)host, NULL, 0, 0, 0xFFFF);
+}
+
+cnd_error_t cnd_binding_set(cnd_binding* table, uint16_t count, const cnd_program* program,
+                            const char* name, const cnd_binding* entry) {
+    if (!table || !program || !name || !entry) return CND_ERR_VALIDATION;
+    uint16_t key = cnd_get_key_id(program, name);
+    if (key == 0xFFFF || key >= count) return CND_ERR_VALIDATION;
+    table[key] = *entry;
+    return CND_ERR_OK;
+}
+
+cnd_error_t cnd_bind_io(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    cnd_binder* b = (cnd_binder*)ctx->user_ptr;
+    if (!b || b->depth == 0) return CND_ERR_CALLBACK;
+
+    if (type == OP_EXIT_STRUCT) {
+        if (b->depth <= 1 || bind_top(b)->key != 0xFFFF) return CND_ERR_CALLBACK;
+        b->depth--;
+        return CND_ERR_OK;
+    }
+    if (type == OP_ARR_END) {
+        if (b->depth > 1 && bind_top(b)->key != 0xFFFF) b->depth--;
+        return CND_ERR_OK;
+    }
+
+    if (key_id >= b->count) return CND_ERR_CALLBACK;
+    const cnd_binding* e = &b->table[key_id];
+    if (e->type == 0) return CND_ERR_CALLBACK;
+
+    switch (type) {
+        case OP_ENTER_STRUCT: {
+            if (e->type != OP_ENTER_STRUCT) return CND_ERR_CALLBACK;
+            uint8_t* slot = bind_slot(b, key_id, e);
+            if (!slot) return CND_ERR_OOB;
+            if (!bind_push(b, slot, NULL, 0, 0, 0xFFFF)) return CND_ERR_STACK_OVERFLOW;
+            return CND_ERR_OK;
+        }
+
+        case OP_ARR_PRE_U8: case OP_ARR_PRE_U16: case OP_ARR_PRE_U32:
+        case OP_ARR_FIXED: case OP_ARR_DYNAMIC:
+            return bind_array_start(ctx, b, key_id, e, type, ptr);
+
+        case OP_RAW_BYTES: {
+            // Byte-array fast path: the whole (remaining) array in one copy.
+            // Failing here makes the VM fall back to per-element events.
+            cnd_bind_frame* f = bind_top(b);
+            if (f->key != key_id || f->stride != 1 || il_type_size(e->type) != 1) return CND_ERR_CALLBACK;
+            size_t n = f->limit - f->index;
+            if (ctx->mode == CND_MODE_ENCODE) memcpy(ptr, f->elems + f->index, n);
+            else memcpy(f->elems + f->index, ptr, n);
+            b->depth--; // The fast path consumes the loop's ARR_END
+            return CND_ERR_OK;
+        }
+
+        case OP_ARR_SPAN: {
+            // Run of primitive elements; the last span of an array closes its frame
+            const cnd_span* s = (const cnd_span*)ptr;
+            cnd_bind_frame* f = bind_top(b);
+            uint32_t host_size = il_type_size(e->type);
+            if (f->key != key_id || host_size == 0 || s->count > f->limit - f->index) return CND_ERR_CALLBACK;
+            bool encode = (ctx->mode == CND_MODE_ENCODE);
+            uint8_t* elems = f->elems + (size_t)f->index * f->stride;
+            if (s->type == e->type && f->stride == host_size) {
+                if (encode) memcpy(s->data, elems, (size_t)s->count * host_size);
+                else memcpy(elems, s->data, (size_t)s->count * host_size);
+            } else {
+                uint32_t size = il_type_size(s->type);
+                for (uint32_t i = 0; i < s->count; i++) {
+                    bind_copy(encode, s->type, (uint8_t*)s->data + (size_t)i * size, e->type, elems + (size_t)i * f->stride);
+                }
+            }
+            f->index += s->count;
+            if (f->index == f->limit) b->depth--;
+            return CND_ERR_OK;
+        }
+
+        case OP_STR_NULL: case OP_STR_PRE_U8: case OP_STR_PRE_U16: case OP_STR_PRE_U32: {
+            if (e->type != OP_STR_NULL) return CND_ERR_CALLBACK;
+            uint8_t* slot = bind_slot(b, key_id, e);
+            if (!slot) return CND_ERR_OOB;
+            return bind_string(ctx, slot, e->stride ? e->stride : e->capacity, type, ptr);
+        }
+
+        case OP_CTX_QUERY: case OP_LOAD_CTX: {
+            // Expression context reads the field without consuming an element
+            if (il_type_size(e->type) == 0 || e->stride != 0) return CND_ERR_CALLBACK;
+            uint8_t* field = bind_top(b)->base + e->offset;
+            uint64_t v;
+            if (bind_is_float(e->type)) {
+                double d = bind_load_float(e->type, field);
+                memcpy(&v, &d, 8);
+            } else {
+                v = (uint64_t)bind_load_int(e->type, field);
+            }
+            memcpy(ptr, &v, 8);
+            return CND_ERR_OK;
+        }
+
+        case OP_STORE_CTX: {
+            if (il_type_size(e->type) == 0 || e->stride != 0) return CND_ERR_CALLBACK;
+            uint8_t* field = bind_top(b)->base + e->offset;
+            uint64_t v;
+            memcpy(&v, ptr, 8);
+            if (bind_is_float(e->type)) {
+                double d;
+                memcpy(&d, &v, 8);
+                bind_store_float(e->type, field, d);
+            } else {
+                bind_store_int(e->type, field, (int64_t)v);
+            }
+            return CND_ERR_OK;
+        }
+
+        default: {
+            uint8_t wire = bind_wire_type(type);
+            if (il_type_size(wire) == 0 || il_type_size(e->type) == 0) return CND_ERR_CALLBACK;
+            uint8_t* slot = bind_slot(b, key_id, e);
+            if (!slot) return CND_ERR_OOB;
+            bind_copy(ctx->mode == CND_MODE_ENCODE, wire, ptr, e->type, slot);
+            return CND_ERR_OK;
+        }
+    }
+}
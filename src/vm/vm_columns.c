@@ -0,0 +1,310 @@
+#include "vm_internal.h"
+#include <string.h>
+
+// --- Columnar Batches ---
+//
+// Packets run through the VM with a callback that moves each value between
+// the event and element `batch_index` of its key's column. Programs made only
+// of fixed-position fields skip the VM after the first packet: packets are
+// taken in blocks and each column is filled from the layout table in one
+// tight loop per block.
+
+#define COLUMN_RECENT 32
+#define COLUMN_BLOCK 64
+
+typedef struct {
+    const cnd_column* columns;
+    uint16_t count;
+
+    // Values of the current packet, served back for switch / expression queries
+    size_t packet;
+    uint16_t recent_keys[COLUMN_RECENT];
+    uint64_t recent_vals[COLUMN_RECENT];
+    uint8_t recent_count;
+    uint8_t recent_next;
+} column_set;
+
+static const cnd_column* column_for(const column_set* s, uint16_t key) {
+    if (key >= s->count) return NULL;
+    const cnd_column* c = &s->columns[key];
+    return (c->data && c->type) ? c : NULL;
+}
+
+static uint8_t* column_slot(const cnd_column* c, size_t i) {
+    return (uint8_t*)c->data + i * il_type_size(c->type);
+}
+
+static void column_remember(column_set* s, uint16_t key, uint8_t wire_type, void* wire) {
+    uint64_t val = 0;
+    bind_copy(false, wire_type, wire, OP_IO_U64, &val);
+    for (uint8_t i = 0; i < s->recent_count; i++) {
+        if (s->recent_keys[i] == key) { s->recent_vals[i] = val; return; }
+    }
+    s->recent_keys[s->recent_next] = key;
+    s->recent_vals[s->recent_next] = val;
+    s->recent_next = (uint8_t)((s->recent_next + 1) % COLUMN_RECENT);
+    if (s->recent_count < COLUMN_RECENT) s->recent_count++;
+}
+
+static bool column_recall(const column_set* s, uint16_t key, uint64_t* val) {
+    for (uint8_t i = 0; i < s->recent_count; i++) {
+        if (s->recent_keys[i] == key) { *val = s->recent_vals[i]; return true; }
+    }
+    return false;
+}
+
+static uint8_t column_count_type(uint8_t type) {
+    switch (type) {
+        case OP_ARR_PRE_U8: return OP_IO_U8;
+        case OP_ARR_PRE_U16: return OP_IO_U16;
+        default: return OP_IO_U32; // OP_ARR_PRE_U32 / OP_ARR_FIXED / OP_ARR_DYNAMIC pass a uint32_t
+    }
+}
+
+static cnd_error_t column_io(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    column_set* s = (column_set*)ctx->user_ptr;
+    bool encode = (ctx->mode == CND_MODE_ENCODE);
+    const cnd_column* c = column_for(s, key_id);
+
+    if (s->packet != ctx->batch_index) {
+        s->packet = ctx->batch_index;
+        s->recent_count = 0;
+        s->recent_next = 0;
+    }
+
+    switch (type) {
+        case OP_ENTER_STRUCT: case OP_EXIT_STRUCT: case OP_ARR_END: case OP_STORE_CTX:
+            return CND_ERR_OK;
+
+        case OP_CTX_QUERY: case OP_LOAD_CTX: {
+            uint64_t val;
+            if (!column_recall(s, key_id, &val)) return CND_ERR_VALIDATION;
+            memcpy(ptr, &val, 8);
+            return CND_ERR_OK;
+        }
+
+        case OP_ARR_PRE_U8: case OP_ARR_PRE_U16: case OP_ARR_PRE_U32:
+        case OP_ARR_FIXED: case OP_ARR_DYNAMIC: {
+            // Prefixed counts come from the array's column when encoding
+            bool prefixed = (type == OP_ARR_PRE_U8 || type == OP_ARR_PRE_U16 || type == OP_ARR_PRE_U32);
+            if (encode && !prefixed) return CND_ERR_OK;
+            if (!c) return encode ? CND_ERR_VALIDATION : CND_ERR_OK;
+            bind_copy(encode, column_count_type(type), ptr, c->type, column_slot(c, ctx->batch_index));
+            return CND_ERR_OK;
+        }
+
+        case OP_RAW_BYTES:
+        case OP_STR_NULL: case OP_STR_PRE_U8: case OP_STR_PRE_U16: case OP_STR_PRE_U32:
+            // Byte arrays fall back to one event per element; strings have no column form
+            return (encode || type == OP_RAW_BYTES) ? CND_ERR_VALIDATION : CND_ERR_OK;
+
+        default: {
+            uint8_t wire_type = bind_wire_type(type);
+            if (il_type_size(wire_type) == 0) return CND_ERR_OK;
+            if (c) bind_copy(encode, wire_type, ptr, c->type, column_slot(c, ctx->batch_index));
+            else if (encode) return CND_ERR_VALIDATION;
+            column_remember(s, key_id, wire_type, ptr);
+            return CND_ERR_OK;
+        }
+    }
+}
+
+static cnd_error_t column_validate(const cnd_program* program, const cnd_batch* batch,
+                                   const cnd_column* columns, uint16_t column_count) {
+    if (!program || !program->bytecode || !batch || !batch->lengths) return CND_ERR_OOB;
+    if (batch->base ? !batch->offsets : !batch->buffers) return CND_ERR_OOB;
+    if (column_count > 0 && !columns) return CND_ERR_OOB;
+    for (uint16_t k = 0; k < column_count; k++) {
+        if (columns[k].data && columns[k].type && il_type_size(columns[k].type) == 0) return CND_ERR_VALIDATION;
+    }
+    return CND_ERR_OK;
+}
+
+static void column_init(column_set* s, const cnd_column* columns, uint16_t column_count) {
+    memset(s, 0, sizeof(*s));
+    s->columns = columns;
+    s->count = column_count;
+}
+
+// --- Fixed-Layout Decode ---
+
+// True if every instruction has a data-independent effect that cannot fail
+// on a long enough buffer, so a packet's fields are exactly the layout table.
+static bool column_fixed_layout(const cnd_program* program) {
+    if (!program->layout || program->layout_count == 0) return false;
+
+    const uint8_t* bc = program->bytecode;
+    size_t ip = 0;
+    while (ip < program->bytecode_len) {
+        uint8_t op = bc[ip];
+        bool fixed = (op >= OP_IO_U8 && op <= OP_IO_F64) ||
+                     (op >= OP_IO_BIT_U && op <= OP_IO_BIT_GROUP) ||
+                     op == OP_NOOP || op == OP_SET_ENDIAN_LE || op == OP_SET_ENDIAN_BE ||
+                     op == OP_ENTER_STRUCT || op == OP_EXIT_STRUCT ||
+                     op == OP_META_VERSION || op == OP_META_NAME ||
+                     op == OP_CALL || op == OP_RET || op == OP_IO_RUN;
+        if (!fixed) return false;
+
+        size_t n;
+        if (vm_insn_length(bc, program->bytecode_len, ip, &n) != CND_ERR_OK) return false;
+        if (op == OP_IO_RUN) {
+            // Booleans fail on values above 1
+            for (size_t f = ip + 4; f < ip + n; f += 3) {
+                if (bc[f] == OP_IO_BOOL) return false;
+            }
+        }
+        ip += n;
+    }
+    return true;
+}
+
+// Typed gather of one byte-aligned field whose column has the wire type
+#define COLUMN_GATHER(T, READ) \
+    for (size_t k = 0; k < n; k++) { \
+        T v = (T)(READ); \
+        memcpy(out + idx[k] * sizeof(T), &v, sizeof(T)); \
+    }
+
+static void column_gather(const uint8_t* e, const cnd_column* c,
+                          const uint8_t* const* src, const size_t* idx, size_t n) {
+    uint8_t type = e[2];
+    uint8_t width = e[3] & (uint8_t)~CND_LAYOUT_BE;
+    cnd_endian_t endian = (e[3] & CND_LAYOUT_BE) ? CND_BE : CND_LE;
+    uint64_t bit = il_get_u32(e + 4);
+    size_t byte = (size_t)(bit / 8);
+    uint8_t* out = (uint8_t*)c->data;
+
+    bool bits = (type == OP_IO_BIT_U || type == OP_IO_BIT_I || type == OP_IO_BIT_BOOL);
+    if (!bits && c->type == type) {
+        switch (width) {
+            case 8: COLUMN_GATHER(uint8_t, read_u8(src[k] + byte)); return;
+            case 16:
+                if (endian == CND_LE) { COLUMN_GATHER(uint16_t, read_u16(src[k] + byte, CND_LE)); }
+                else { COLUMN_GATHER(uint16_t, read_u16(src[k] + byte, CND_BE)); }
+                return;
+            case 32:
+                if (endian == CND_LE) { COLUMN_GATHER(uint32_t, read_u32(src[k] + byte, CND_LE)); }
+                else { COLUMN_GATHER(uint32_t, read_u32(src[k] + byte, CND_BE)); }
+                return;
+            default:
+                if (endian == CND_LE) { COLUMN_GATHER(uint64_t, read_u64(src[k] + byte, CND_LE)); }
+                else { COLUMN_GATHER(uint64_t, read_u64(src[k] + byte, CND_BE)); }
+                return;
+        }
+    }
+
+    // Bitfields and converted columns: rebuild the event value, then convert
+    uint8_t wire_type = bind_wire_type(type);
+    for (size_t k = 0; k < n; k++) {
+        cnd_vm_ctx ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.data_buffer = (uint8_t*)src[k];
+        ctx.data_len = byte + (width + 7) / 8 + 1;
+        ctx.cursor = byte;
+        ctx.bit_offset = (uint8_t)(bit % 8);
+        ctx.endianness = endian;
+        uint64_t raw = read_bits(&ctx, width);
+
+        union { uint8_t u8; uint16_t u16; uint32_t u32; uint64_t u64; } wire;
+        switch (il_type_size(wire_type)) {
+            case 1: wire.u8 = (uint8_t)raw; break;
+            case 2: wire.u16 = (uint16_t)raw; break;
+            case 4: wire.u32 = (uint32_t)raw; break;
+            default:
+                if (type == OP_IO_BIT_I && width < 64) {
+                    uint64_t m = (uint64_t)1 << (width - 1);
+                    raw = (raw ^ m) - m;
+                }
+                wire.u64 = raw;
+                break;
+        }
+        bind_copy(false, wire_type, &wire, c->type, column_slot(c, idx[k]));
+    }
+}
+
+#undef COLUMN_GATHER
+
+static uint8_t* column_packet(const cnd_batch* batch, size_t i) {
+    if (batch->base) return batch->base + batch->offsets[i];
+    return batch->buffers[i];
+}
+
+static cnd_error_t column_run(cnd_vm_ctx* ctx, const cnd_program* program, cnd_mode_t mode,
+                              const cnd_batch* batch, size_t i, column_set* s) {
+    uint8_t* data = column_packet(batch, i);
+    cnd_init(ctx, mode, program, data, batch->lengths[i], column_io, s);
+    ctx->batch_index = i;
+    s->packet = (size_t)-1;
+    if (!data) return CND_ERR_OOB;
+    return cnd_execute(ctx);
+}
+
+// --- Public API ---
+
+cnd_error_t cnd_decode_columns(const cnd_program* program, const cnd_batch* batch,
+                               const cnd_column* columns, uint16_t column_count,
+                               cnd_error_t* errors) {
+    cnd_error_t err = column_validate(program, batch, columns, column_count);
+    if (err != CND_ERR_OK) return err;
+
+    column_set s;
+    column_init(&s, columns, column_count);
+    cnd_vm_ctx ctx;
+    cnd_error_t first = CND_ERR_OK;
+    bool fixed = column_fixed_layout(program);
+    size_t size = 0; // Bytes a fixed-layout packet needs, once known
+    size_t i = 0;
+
+    // Every packet runs through the VM until one succeeds and sizes the layout
+    while (i < batch->count && (!fixed || size == 0)) {
+        err = column_run(&ctx, program, CND_MODE_DECODE, batch, i, &s);
+        if (errors) errors[i] = err;
+        if (err != CND_ERR_OK && first == CND_ERR_OK) first = err;
+        if (err == CND_ERR_OK && fixed) size = ctx.cursor + (ctx.bit_offset ? 1 : 0);
+        if (fixed && size == 0 && err == CND_ERR_OK) fixed = false; // Empty packet: nothing to gather
+        i++;
+    }
+
+    while (i < batch->count) {
+        const uint8_t* src[COLUMN_BLOCK];
+        size_t idx[COLUMN_BLOCK];
+        size_t n = 0;
+        size_t end = (batch->count - i < COLUMN_BLOCK) ? batch->count : i + COLUMN_BLOCK;
+
+        // Short packets take the VM to report the same error a single run would
+        for (; i < end; i++) {
+            const uint8_t* data = column_packet(batch, i);
+            if (data && batch->lengths[i] >= size) {
+                src[n] = data;
+                idx[n++] = i;
+                if (errors) errors[i] = CND_ERR_OK;
+                continue;
+            }
+            err = column_run(&ctx, program, CND_MODE_DECODE, batch, i, &s);
+            if (errors) errors[i] = err;
+            if (err != CND_ERR_OK && first == CND_ERR_OK) first = err;
+        }
+        if (n == 0) continue;
+
+        for (uint16_t l = 0; l < program->layout_count; l++) {
+            const uint8_t* e = program->layout + (size_t)l * CND_LAYOUT_ENTRY_SIZE;
+            const cnd_column* c = column_for(&s, il_get_u16(e));
+            if (c) column_gather(e, c, src, idx, n);
+        }
+    }
+    return first;
+}
+
+cnd_error_t cnd_encode_columns(const cnd_program* program, const cnd_batch* batch,
+                               const cnd_column* columns, uint16_t column_count,
+                               cnd_error_t* errors, size_t* used) {
+    cnd_error_t err = column_validate(program, batch, columns, column_count);
+    if (err != CND_ERR_OK) return err;
+
+    column_set s;
+    column_init(&s, columns, column_count);
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_ENCODE, program, NULL, 0, column_io, &s);
+    s.packet = (size_t)-1;
+    return cnd_execute_batch(&ctx, batch, errors, used);
+}
@@ -0,0 +1,399 @@
+#include "vm_internal.h"
+#include <string.h>
+
+// --- CRC Engine ---
+//
+// Every (polynomial, width, refin) configuration gets slice-by-8 tables and
+// carry-less folding constants, built once in a small process-wide cache:
+// while the program loads for the CRCs it contains, or on first use for
+// anything else. Payloads of 64 bytes and more are folded 16 bytes at a time
+// with PCLMULQDQ where the CPU has it (x86, selected at runtime); ARMv8 CRC
+// instructions handle CRC-32 and CRC-32C. The tables finish the remainder.
+// When the cache is full (or disabled with CND_CRC_TABLE_SLOTS=0), the
+// bytewise loop below is used.
+
+#ifndef CND_CRC_TABLE_SLOTS
+#define CND_CRC_TABLE_SLOTS 4 // 8.2 KB each
+#endif
+
+// Slots are claimed and published atomically so concurrent loads are safe
+#if !defined(__GNUC__)
+#undef CND_CRC_TABLE_SLOTS
+#define CND_CRC_TABLE_SLOTS 0
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VM_CRC_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_FEATURE_CRC32) && !defined(__ARM_BIG_ENDIAN)
+#define VM_CRC_ARM 1
+#include <arm_acle.h>
+#endif
+
+#define CRC_STD32_POLY 0x04C11DB7u
+#define CRC_32C_POLY   0x1EDC6F41u
+
+// --- CRC Helpers ---
+
+// Reverses the low `bits` bits of val
+static uint32_t reflect(uint32_t val, int bits) {
+    val = ((val >> 1) & 0x55555555u) | ((val & 0x55555555u) << 1);
+    val = ((val >> 2) & 0x33333333u) | ((val & 0x33333333u) << 2);
+    val = ((val >> 4) & 0x0F0F0F0Fu) | ((val & 0x0F0F0F0Fu) << 4);
+    val = ((val >> 8) & 0x00FF00FFu) | ((val & 0x00FF00FFu) << 8);
+    val = (val >> 16) | (val << 16);
+    return val >> (32 - bits);
+}
+
+static const uint32_t crc32_table[256] = {
+    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
+    0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
+    0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+    0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
+    0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172, 0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
+    0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+    0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
+    0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924, 0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
+    0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
+    0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e, 0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
+    0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+    0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
+    0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0, 0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
+    0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+    0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
+    0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a, 0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
+    0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
+    0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc, 0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
+    0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+    0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
+    0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236, 0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
+    0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+    0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
+    0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38, 0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
+    0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
+    0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2, 0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
+    0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+    0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
+    0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
+};
+
+// Bytewise reference path, used when no engine slot is available. Runs on
+// the same register as the engines (see vm_crc_start).
+static uint32_t crc_bytewise(uint32_t crc, const uint8_t* data, size_t len, uint32_t poly, bool refin, int width) {
+    if (refin) {
+        // Fast path for Standard CRC32 (Poly 0x04C11DB7, RefIn=1)
+        if (width == 32 && poly == CRC_STD32_POLY) {
+            for (size_t i = 0; i < len; i++) {
+                crc = (crc >> 8) ^ crc32_table[(crc ^ data[i]) & 0xFF];
+            }
+            return crc;
+        }
+        uint32_t rpoly = reflect(poly, width);
+        for (size_t i = 0; i < len; i++) {
+            crc ^= data[i];
+            for (int j = 0; j < 8; j++) crc = (crc & 1) ? (crc >> 1) ^ rpoly : crc >> 1;
+        }
+    } else {
+        uint32_t apoly = poly << (32 - width);
+        for (size_t i = 0; i < len; i++) {
+            crc ^= (uint32_t)data[i] << 24;
+            for (int j = 0; j < 8; j++) crc = (crc & 0x80000000u) ? (crc << 1) ^ apoly : crc << 1;
+        }
+    }
+    return crc;
+}
+
+#if CND_CRC_TABLE_SLOTS > 0
+
+// --- Engine Cache ---
+
+#define CRC_SLOT_FREE     0
+#define CRC_SLOT_BUILDING 1
+#define CRC_SLOT_READY    2
+
+// Reflected engines keep the register bit-reversed in the low `width` bits;
+// MSB-first engines keep it left-aligned in 32 bits.
+typedef struct {
+    uint32_t poly;
+    uint8_t width;
+    uint8_t refin;
+    uint8_t state;       // CRC_SLOT_*
+    uint64_t fold16[2];  // Folding constants for the low / high lane, 16-byte distance
+    uint64_t fold64[2];  // Same for the 64-byte distance
+    uint32_t t[8][256];  // t[k]: byte followed by k zero bytes
+} crc_engine;
+
+static crc_engine crc_slots[CND_CRC_TABLE_SLOTS];
+
+// x^n mod P, with P given without its leading term
+static uint32_t crc_xpow(uint32_t poly, int width, unsigned n) {
+    uint64_t top = (uint64_t)1 << width;
+    uint64_t r = 1;
+    while (n--) {
+        r <<= 1;
+        if (r & top) r ^= top | poly;
+    }
+    return (uint32_t)r;
+}
+
+static void crc_engine_build(crc_engine* e) {
+    int width = e->width;
+    if (e->refin) {
+        uint32_t rpoly = reflect(e->poly, width);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int j = 0; j < 8; j++) c = (c & 1) ? (c >> 1) ^ rpoly : c >> 1;
+            e->t[0][i] = c;
+        }
+        for (int k = 1; k < 8; k++) {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = e->t[k - 1][i];
+                e->t[k][i] = (c >> 8) ^ e->t[0][c & 0xFF];
+            }
+        }
+        // Reflected clmul products come out multiplied by x, hence n - 1
+        e->fold16[0] = (uint64_t)reflect(crc_xpow(e->poly, width, 191), 32) << 32;
+        e->fold16[1] = (uint64_t)reflect(crc_xpow(e->poly, width, 127), 32) << 32;
+        e->fold64[0] = (uint64_t)reflect(crc_xpow(e->poly, width, 575), 32) << 32;
+        e->fold64[1] = (uint64_t)reflect(crc_xpow(e->poly, width, 511), 32) << 32;
+    } else {
+        uint32_t apoly = e->poly << (32 - width);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i << 24;
+            for (int j = 0; j < 8; j++) c = (c & 0x80000000u) ? (c << 1) ^ apoly : c << 1;
+            e->t[0][i] = c;
+        }
+        for (int k = 1; k < 8; k++) {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = e->t[k - 1][i];
+                e->t[k][i] = (c << 8) ^ e->t[0][c >> 24];
+            }
+        }
+        e->fold16[0] = crc_xpow(e->poly, width, 128);
+        e->fold16[1] = crc_xpow(e->poly, width, 192);
+        e->fold64[0] = crc_xpow(e->poly, width, 512);
+        e->fold64[1] = crc_xpow(e->poly, width, 576);
+    }
+}
+
+static const crc_engine* crc_engine_get(uint32_t poly, int width, bool refin) {
+    for (int i = 0; i < CND_CRC_TABLE_SLOTS; i++) {
+        crc_engine* e = &crc_slots[i];
+        uint8_t state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+        if (state == CRC_SLOT_FREE) {
+            uint8_t expected = CRC_SLOT_FREE;
+            if (__atomic_compare_exchange_n(&e->state, &expected, CRC_SLOT_BUILDING, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+                e->poly = poly;
+                e->width = (uint8_t)width;
+                e->refin = refin;
+                crc_engine_build(e);
+                __atomic_store_n(&e->state, CRC_SLOT_READY, __ATOMIC_RELEASE);
+                return e;
+            }
+            state = expected;
+        }
+        if (state == CRC_SLOT_READY && e->poly == poly && e->width == width && e->refin == refin) return e;
+    }
+    return NULL;
+}
+
+// --- Table Update ---
+
+static uint32_t crc_update_ref(const crc_engine* e, uint32_t crc, const uint8_t* p, size_t n) {
+    for (; n >= 8; p += 8, n -= 8) {
+        uint32_t lo = crc ^ il_get_u32(p);
+        uint32_t hi = il_get_u32(p + 4);
+        crc = e->t[7][lo & 0xFF] ^ e->t[6][(lo >> 8) & 0xFF] ^ e->t[5][(lo >> 16) & 0xFF] ^ e->t[4][lo >> 24] ^
+              e->t[3][hi & 0xFF] ^ e->t[2][(hi >> 8) & 0xFF] ^ e->t[1][(hi >> 16) & 0xFF] ^ e->t[0][hi >> 24];
+    }
+    while (n--) crc = (crc >> 8) ^ e->t[0][(crc ^ *p++) & 0xFF];
+    return crc;
+}
+
+static uint32_t crc_get_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t crc_update_msb(const crc_engine* e, uint32_t crc, const uint8_t* p, size_t n) {
+    for (; n >= 8; p += 8, n -= 8) {
+        uint32_t hi = crc ^ crc_get_be32(p);
+        uint32_t lo = crc_get_be32(p + 4);
+        crc = e->t[7][hi >> 24] ^ e->t[6][(hi >> 16) & 0xFF] ^ e->t[5][(hi >> 8) & 0xFF] ^ e->t[4][hi & 0xFF] ^
+              e->t[3][lo >> 24] ^ e->t[2][(lo >> 16) & 0xFF] ^ e->t[1][(lo >> 8) & 0xFF] ^ e->t[0][lo & 0xFF];
+    }
+    while (n--) crc = (crc << 8) ^ e->t[0][(crc >> 24) ^ *p++];
+    return crc;
+}
+
+// --- Hardware Folding ---
+
+#if VM_CRC_X86
+// Folds whole 16-byte blocks into 16 bytes congruent to them modulo P, then
+// runs the tables over those. Returns the bytes consumed (a multiple of 16).
+__attribute__((target("pclmul,ssse3")))
+static size_t crc_fold_pclmul(const crc_engine* e, uint32_t* crc, const uint8_t* p, size_t n) {
+    const __m128i rev = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m128i k16 = _mm_set_epi64x((long long)e->fold16[1], (long long)e->fold16[0]);
+    const __m128i k64 = _mm_set_epi64x((long long)e->fold64[1], (long long)e->fold64[0]);
+    bool ref = e->refin;
+
+    // MSB-first data is byte-reversed so that bit k is the coefficient of x^k
+#define CRC_LOAD(q) (ref ? _mm_loadu_si128((const __m128i*)(q)) : _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(q)), rev))
+#define CRC_FOLD(x, k) _mm_xor_si128(_mm_clmulepi64_si128((x), (k), 0x00), _mm_clmulepi64_si128((x), (k), 0x11))
+
+    __m128i seed = ref ? _mm_cvtsi32_si128((int)*crc) : _mm_set_epi32((int)*crc, 0, 0, 0);
+    __m128i x0 = _mm_xor_si128(CRC_LOAD(p), seed);
+    __m128i x1 = CRC_LOAD(p + 16);
+    __m128i x2 = CRC_LOAD(p + 32);
+    __m128i x3 = CRC_LOAD(p + 48);
+    size_t i = 64;
+    for (; i + 64 <= n; i += 64) {
+        x0 = _mm_xor_si128(CRC_FOLD(x0, k64), CRC_LOAD(p + i));
+        x1 = _mm_xor_si128(CRC_FOLD(x1, k64), CRC_LOAD(p + i + 16));
+        x2 = _mm_xor_si128(CRC_FOLD(x2, k64), CRC_LOAD(p + i + 32));
+        x3 = _mm_xor_si128(CRC_FOLD(x3, k64), CRC_LOAD(p + i + 48));
+    }
+    x1 = _mm_xor_si128(CRC_FOLD(x0, k16), x1);
+    x2 = _mm_xor_si128(CRC_FOLD(x1, k16), x2);
+    x3 = _mm_xor_si128(CRC_FOLD(x2, k16), x3);
+    for (; i + 16 <= n; i += 16) x3 = _mm_xor_si128(CRC_FOLD(x3, k16), CRC_LOAD(p + i));
+
+#undef CRC_LOAD
+#undef CRC_FOLD
+
+    uint8_t rest[16];
+    _mm_storeu_si128((__m128i*)rest, ref ? x3 : _mm_shuffle_epi8(x3, rev));
+    *crc = ref ? crc_update_ref(e, 0, rest, 16) : crc_update_msb(e, 0, rest, 16);
+    return i;
+}
+
+// 0 = unknown, 1 = no, 2 = yes. Threads racing to detect store the same
+// value, so relaxed atomics are enough
+static int crc_has_pclmul = 0;
+
+static bool crc_detect_pclmul(void) {
+    int has = __atomic_load_n(&crc_has_pclmul, __ATOMIC_RELAXED);
+    if (has == 0) {
+        __builtin_cpu_init();
+        has = (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3")) ? 2 : 1;
+        __atomic_store_n(&crc_has_pclmul, has, __ATOMIC_RELAXED);
+    }
+    return has == 2;
+}
+#endif
+
+#if VM_CRC_ARM
+// CRC-32 and CRC-32C in hardware, 8 bytes per instruction
+static size_t crc_arm(const crc_engine* e, uint32_t* crc, const uint8_t* p, size_t n) {
+    if (!e->refin || e->width != 32 || (e->poly != CRC_STD32_POLY && e->poly != CRC_32C_POLY)) return 0;
+    uint32_t c = *crc;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t v;
+        memcpy(&v, p + i, 8);
+        c = (e->poly == CRC_STD32_POLY) ? __crc32d(c, v) : __crc32cd(c, v);
+    }
+    *crc = c;
+    return i;
+}
+#endif
+
+#endif // CND_CRC_TABLE_SLOTS > 0
+
+void vm_crc_prepare(const cnd_program* program) {
+#if CND_CRC_TABLE_SLOTS > 0
+    const uint8_t* bc = program->bytecode;
+    size_t len = program->bytecode_len;
+    vm_insn_walk walk;
+    vm_walk_init(&walk);
+    size_t ip, n;
+    while (vm_walk_next(&walk, bc, len, &ip, &n)) {
+        if (bc[ip] == OP_CRC_16 && n >= 8) crc_engine_get(il_get_u16(bc + ip + 1), 16, bc[ip + 7] & 1);
+        else if (bc[ip] == OP_CRC_32 && n >= 14) crc_engine_get(il_get_u32(bc + ip + 1), 32, bc[ip + 13] & 1);
+    }
+#else
+    (void)program;
+#endif
+}
+
+// --- Running Register ---
+//
+// Reflected CRCs keep the register bit-reversed in the low `width` bits and
+// MSB-first CRCs keep it left-aligned in 32 bits, so a CRC can be fed in any
+// number of pieces and finished once.
+
+uint32_t vm_crc_start(uint32_t poly, uint32_t init, uint8_t flags, int width) {
+    uint32_t mask = (width == 32) ? 0xFFFFFFFF : 0xFFFF;
+    if (flags & 1) {
+        // Standard CRC-32 takes init as the (reflected) register, like zlib
+        bool std32 = (width == 32 && poly == CRC_STD32_POLY && (flags & 2));
+        return std32 ? init : reflect(init & mask, width);
+    }
+    return (init & mask) << (32 - width);
+}
+
+uint32_t vm_crc_update(uint32_t crc, const uint8_t* data, size_t len, uint32_t poly, uint8_t flags, int width) {
+    bool refin = flags & 1;
+    poly &= (width == 32) ? 0xFFFFFFFF : 0xFFFF;
+#if CND_CRC_TABLE_SLOTS > 0
+    const crc_engine* e = crc_engine_get(poly, width, refin);
+    if (e) {
+        size_t done = 0;
+#if VM_CRC_X86
+        if (len >= 64 && crc_detect_pclmul()) done = crc_fold_pclmul(e, &crc, data, len);
+#elif VM_CRC_ARM
+        done = crc_arm(e, &crc, data, len);
+#endif
+        return refin ? crc_update_ref(e, crc, data + done, len - done) : crc_update_msb(e, crc, data + done, len - done);
+    }
+#endif
+    return crc_bytewise(crc, data, len, poly, refin, width);
+}
+
+uint32_t vm_crc_finish(uint32_t crc, uint32_t xorout, uint8_t flags, int width) {
+    uint32_t mask = (width == 32) ? 0xFFFFFFFF : 0xFFFF;
+    if (flags & 1) {
+        if (!(flags & 2)) crc = reflect(crc, width);
+    } else {
+        crc >>= 32 - width;
+        if (flags & 2) crc = reflect(crc, width);
+    }
+    return (crc ^ xorout) & mask;
+}
+
+uint32_t vm_calc_crc(const uint8_t* data, size_t len, uint32_t poly, uint32_t init, uint32_t xorout, uint8_t flags, int width) {
+    uint32_t crc = vm_crc_start(poly, init, flags, width);
+    crc = vm_crc_update(crc, data, len, poly, flags, width);
+    return vm_crc_finish(crc, xorout, flags, width);
+}
+
+// --- CRC Regions ---
+//
+// A CRC field covers [crc_start, crc_end) of the buffer, clipped to the
+// field's own position: from the last OP_CRC_BEGIN (or the packet start) to
+// the last OP_CRC_END (or the field). The register is kept in the context
+// between fields, so a CRC over a region that an earlier CRC field with the
+// same parameters already covered only hashes the bytes added since.
+
+uint32_t vm_crc_region(cnd_vm_ctx* ctx, uint32_t poly, uint32_t init, uint32_t xorout, uint8_t flags, int width) {
+    size_t end = (ctx->crc_end < ctx->cursor) ? ctx->crc_end : ctx->cursor;
+    if (end < ctx->crc_start) end = ctx->crc_start;
+    flags &= 3;
+
+    if (ctx->crc_width != width || ctx->crc_poly != poly || ctx->crc_init != init ||
+        ctx->crc_flags != flags || ctx->crc_done > end) {
+        ctx->crc_width = (uint8_t)width;
+        ctx->crc_poly = poly;
+        ctx->crc_init = init;
+        ctx->crc_flags = flags;
+        ctx->crc_reg = vm_crc_start(poly, init, flags, width);
+        ctx->crc_done = ctx->crc_start;
+    }
+    ctx->crc_reg = vm_crc_update(ctx->crc_reg, ctx->data_buffer + ctx->crc_done, end - ctx->crc_done, poly, flags, width);
+    ctx->crc_done = end;
+    return vm_crc_finish(ctx->crc_reg, xorout, flags, width);
+}
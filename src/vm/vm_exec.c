@@ -1,306 +1,16 @@
-#include "vm_internal.h"
+#include "vm_handlers.h"
 #include <string.h>
 #include <stdio.h>
 #include <inttypes.h>
 
-#ifndef CND_NO_MATH
-#include <math.h>
+// Computed-goto dispatch needs the GNU labels-as-values extension. The build
+// enables it through CND_THREADED_DISPATCH; other compilers use the switch.
+#if defined(CND_THREADED_DISPATCH) && CND_THREADED_DISPATCH && defined(__GNUC__) && !defined(_MSC_VER)
+#define VM_HAVE_THREADED_DISPATCH 1
+#else
+#define VM_HAVE_THREADED_DISPATCH 0
 #endif
 
-// --- Instruction Fetch Macros ---
-// Can be overridden in cnd_execute for optimization
-#define FETCH_IL_U8(ctx) read_il_u8(ctx)
-#define FETCH_IL_U16(ctx) read_il_u16(ctx)
-
-// --- Math Helpers ---
-
-static inline double vm_math_poly_eval(cnd_vm_ctx* ctx, double x) {
-    double y = 0;
-    if (ctx->trans_poly_count > 0) {
-        uint64_t tmp;
-        memcpy(&tmp, ctx->trans_poly_data + (ctx->trans_poly_count - 1) * 8, 8);
-        memcpy(&y, &tmp, 8);
-        for (int i = ctx->trans_poly_count - 2; i >= 0; i--) {
-            double c;
-            memcpy(&tmp, ctx->trans_poly_data + i * 8, 8);
-            memcpy(&c, &tmp, 8);
-            y = y * x + c;
-        }
-    }
-    return y;
-}
-
-static inline double vm_math_poly_solve(cnd_vm_ctx* ctx, double target_y) {
-    double x = 0;
-    for(int iter=0; iter<20; iter++) {
-        double y = 0;
-        double dy = 0;
-        if (ctx->trans_poly_count > 0) {
-            uint64_t tmp;
-            memcpy(&tmp, ctx->trans_poly_data + (ctx->trans_poly_count - 1) * 8, 8);
-            memcpy(&y, &tmp, 8);
-            for (int i = ctx->trans_poly_count - 2; i >= 0; i--) {
-                double c;
-                memcpy(&tmp, ctx->trans_poly_data + i * 8, 8);
-                memcpy(&c, &tmp, 8);
-                dy = dy * x + y;
-                y = y * x + c;
-            }
-        }
-        double diff = y - target_y;
-        if (diff > -0.001 && diff < 0.001) break;
-        if (dy == 0) break;
-        x = x - diff / dy;
-    }
-    return x;
-}
-
-static inline double vm_math_spline_eval(cnd_vm_ctx* ctx, double x) {
-    double y = 0;
-    if (ctx->trans_spline_count >= 2) {
-        for (int i = 0; i < ctx->trans_spline_count - 1; i++) {
-            double x0, y0, x1, y1;
-            uint64_t tmp;
-            memcpy(&tmp, ctx->trans_spline_data + (i * 2) * 8, 8); memcpy(&x0, &tmp, 8);
-            memcpy(&tmp, ctx->trans_spline_data + (i * 2 + 1) * 8, 8); memcpy(&y0, &tmp, 8);
-            memcpy(&tmp, ctx->trans_spline_data + ((i + 1) * 2) * 8, 8); memcpy(&x1, &tmp, 8);
-            memcpy(&tmp, ctx->trans_spline_data + ((i + 1) * 2 + 1) * 8, 8); memcpy(&y1, &tmp, 8);
-            if ((x >= x0 && x <= x1) || (i == ctx->trans_spline_count - 2)) {
-                if (x1 == x0) y = y0;
-                else y = y0 + (x - x0) * (y1 - y0) / (x1 - x0);
-                break;
-            }
-        }
-    }
-    return y;
-}
-
-static inline double vm_math_spline_solve(cnd_vm_ctx* ctx, double target_y) {
-    double x = 0;
-    if (ctx->trans_spline_count >= 2) {
-        for (int i = 0; i < ctx->trans_spline_count - 1; i++) {
-            double x0, y0, x1, y1;
-            uint64_t tmp;
-            memcpy(&tmp, ctx->trans_spline_data + (i * 2) * 8, 8); memcpy(&x0, &tmp, 8);
-            memcpy(&tmp, ctx->trans_spline_data + (i * 2 + 1) * 8, 8); memcpy(&y0, &tmp, 8);
-            memcpy(&tmp, ctx->trans_spline_data + ((i + 1) * 2) * 8, 8); memcpy(&x1, &tmp, 8);
-            memcpy(&tmp, ctx->trans_spline_data + ((i + 1) * 2 + 1) * 8, 8); memcpy(&y1, &tmp, 8);
-            if ((target_y >= y0 && target_y <= y1) || (target_y <= y0 && target_y >= y1)) {
-                if (y1 == y0) x = x0;
-                else x = x0 + (target_y - y0) * (x1 - x0) / (y1 - y0);
-                break;
-            }
-        }
-    }
-    return x;
-}
-
-static inline int64_t vm_math_int_to_eng(cnd_vm_ctx* ctx, int64_t raw) {
-    switch(ctx->trans_type) {
-        case CND_TRANS_ADD_I64: return raw + ctx->trans_i_val;
-        case CND_TRANS_SUB_I64: return raw - ctx->trans_i_val;
-        case CND_TRANS_MUL_I64: return raw * ctx->trans_i_val;
-        case CND_TRANS_DIV_I64: return (ctx->trans_i_val != 0) ? raw / ctx->trans_i_val : raw;
-        default: return raw;
-    }
-}
-
-static inline int64_t vm_math_int_to_raw(cnd_vm_ctx* ctx, int64_t eng) {
-    switch(ctx->trans_type) {
-        case CND_TRANS_ADD_I64: return eng - ctx->trans_i_val;
-        case CND_TRANS_SUB_I64: return eng + ctx->trans_i_val;
-        case CND_TRANS_MUL_I64: return (ctx->trans_i_val != 0) ? eng / ctx->trans_i_val : eng;
-        case CND_TRANS_DIV_I64: return eng * ctx->trans_i_val;
-        default: return eng;
-    }
-}
-
-// --- Helpers / Macros to reduce repeated IO case code ---
-// HANDLE_PRIMITIVE(size, ctype, READ_EXPR, WRITE_EXPR)
-//   - size: number of bytes this IO consumes
-//   - ctype: C type used for the value (e.g. uint8_t)
-//   - READ_EXPR: expression to evaluate to read `ctype` from data buffer
-//   - WRITE_EXPR: expression to evaluate to write `val` into buffer
-#define HANDLE_PRIMITIVE(size, ctype, READ_EXPR, WRITE_EXPR) \
-    { uint16_t key = FETCH_IL_U16(ctx); \
-      if (ctx->cursor + (size) > ctx->data_len) { \
-          if (ctx->is_next_optional) { \
-              ctx->is_next_optional = false; \
-              ctype val = 0; \
-              SYNC_IP(); \
-              if (ctx->io_callback(ctx, key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-              break; \
-          } \
-          return CND_ERR_OOB; \
-      } \
-      if (ctx->trans_type != CND_TRANS_NONE) { \
-          if (ctx->trans_type == CND_TRANS_SCALE_F64) { \
-              double eng_val = 0; \
-              if (ctx->mode == CND_MODE_ENCODE) { \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-                  ctype val = (ctype)((eng_val - ctx->trans_f_offset) / ctx->trans_f_factor); \
-                  WRITE_EXPR; \
-              } else { \
-                  ctype raw = (READ_EXPR); \
-                  eng_val = (double)raw * ctx->trans_f_factor + ctx->trans_f_offset; \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-              } \
-          } else if (ctx->trans_type == CND_TRANS_POLY) { \
-              double eng_val = 0; \
-              if (ctx->mode == CND_MODE_ENCODE) { \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-                  ctype val = (ctype)vm_math_poly_solve(ctx, eng_val); \
-                  WRITE_EXPR; \
-              } else { \
-                  ctype raw = (READ_EXPR); \
-                  eng_val = vm_math_poly_eval(ctx, (double)raw); \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-              } \
-          } else if (ctx->trans_type == CND_TRANS_SPLINE) { \
-              double eng_val = 0; \
-              if (ctx->mode == CND_MODE_ENCODE) { \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-                  ctype val = (ctype)vm_math_spline_solve(ctx, eng_val); \
-                  WRITE_EXPR; \
-              } else { \
-                  ctype raw = (READ_EXPR); \
-                  eng_val = vm_math_spline_eval(ctx, (double)raw); \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-              } \
-          } else { \
-              int64_t eng_val = 0; \
-              if (ctx->mode == CND_MODE_ENCODE) { \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_I64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-                  ctype val = (ctype)vm_math_int_to_raw(ctx, eng_val); \
-                  WRITE_EXPR; \
-              } else { \
-                  ctype raw = (READ_EXPR); \
-                  eng_val = vm_math_int_to_eng(ctx, (int64_t)raw); \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_I64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-              } \
-          } \
-          ctx->trans_type = CND_TRANS_NONE; \
-      } else { \
-          ctype val = 0; \
-          if (ctx->mode == CND_MODE_ENCODE) { \
-              SYNC_IP(); \
-              if (ctx->io_callback(ctx, key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-              WRITE_EXPR; \
-          } else { \
-              val = (READ_EXPR); \
-              SYNC_IP(); \
-              if (ctx->io_callback(ctx, key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-          } \
-      } \
-      ctx->cursor += (size); \
-      ctx->is_next_optional = false; \
-      break; }
-
-// Helper for float/double where we must memcopy to/from an integer representation
-#define HANDLE_FLOAT(size, ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
-    { uint16_t key = FETCH_IL_U16(ctx); \
-      if (ctx->cursor + (size) > ctx->data_len) { \
-          if (ctx->is_next_optional) { \
-              ctx->is_next_optional = false; \
-              ctype val = 0; \
-              SYNC_IP(); \
-              if (ctx->io_callback(ctx, key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-              break; \
-          } \
-          return CND_ERR_OOB; \
-      } \
-      if (ctx->trans_type != CND_TRANS_NONE) { \
-          if (ctx->trans_type == CND_TRANS_SCALE_F64) { \
-              double eng_val = 0; \
-              if (ctx->mode == CND_MODE_ENCODE) { \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-                  ctype val = (ctype)((eng_val - ctx->trans_f_offset) / ctx->trans_f_factor); \
-                  int_t t; memcpy(&t, &val, sizeof(t)); WRITE_INT_EXPR; \
-              } else { \
-                  int_t t = (READ_INT_EXPR); ctype val; memcpy(&val, &t, sizeof(t)); \
-                  eng_val = (double)val * ctx->trans_f_factor + ctx->trans_f_offset; \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-              } \
-          } else { \
-              int64_t eng_val = 0; \
-              if (ctx->mode == CND_MODE_ENCODE) { \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_I64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-                  int64_t raw64 = eng_val; \
-                  switch(ctx->trans_type) { \
-                      case CND_TRANS_ADD_I64: raw64 -= ctx->trans_i_val; break; \
-                      case CND_TRANS_SUB_I64: raw64 += ctx->trans_i_val; break; \
-                      case CND_TRANS_MUL_I64: if(ctx->trans_i_val!=0) raw64 /= ctx->trans_i_val; break; \
-                      case CND_TRANS_DIV_I64: raw64 *= ctx->trans_i_val; break; \
-                      default: break; \
-                  } \
-                  ctype val = (ctype)raw64; \
-                  int_t t; memcpy(&t, &val, sizeof(t)); WRITE_INT_EXPR; \
-              } else { \
-                  int_t t = (READ_INT_EXPR); ctype val; memcpy(&val, &t, sizeof(t)); \
-                  int64_t raw64 = (int64_t)val; \
-                  switch(ctx->trans_type) { \
-                      case CND_TRANS_ADD_I64: raw64 += ctx->trans_i_val; break; \
-                      case CND_TRANS_SUB_I64: raw64 -= ctx->trans_i_val; break; \
-                      case CND_TRANS_MUL_I64: raw64 *= ctx->trans_i_val; break; \
-                      case CND_TRANS_DIV_I64: if(ctx->trans_i_val!=0) raw64 /= ctx->trans_i_val; break; \
-                      default: break; \
-                  } \
-                  eng_val = raw64; \
-                  SYNC_IP(); \
-                  if (ctx->io_callback(ctx, key, OP_IO_I64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-              } \
-          } \
-          ctx->trans_type = CND_TRANS_NONE; \
-      } else { \
-          ctype val = 0; \
-          if (ctx->mode == CND_MODE_ENCODE) { \
-              SYNC_IP(); \
-              if (ctx->io_callback(ctx, key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-              int_t t; memcpy(&t, &val, sizeof(t)); WRITE_INT_EXPR; \
-          } else { \
-              int_t t = (READ_INT_EXPR); memcpy(&val, &t, sizeof(t)); \
-              SYNC_IP(); \
-              if (ctx->io_callback(ctx, key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-          } \
-      } \
-      ctx->cursor += (size); \
-      ctx->is_next_optional = false; \
-      break; }
-
-#define CHECK_RANGE(size, ctype, IL_READ, BUF_READ) \
-    { \
-        ctype min = (ctype)(IL_READ); \
-        ctype max = (ctype)(IL_READ); \
-        if (ctx->cursor < size) return CND_ERR_OOB; \
-        ctype val = (ctype)(BUF_READ); \
-        if (val < min || val > max) return CND_ERR_VALIDATION; \
-    }
-
-#define CHECK_RANGE_FLOAT(size, ctype, int_type, IL_READ, BUF_READ) \
-    { \
-        int_type imin = (IL_READ); \
-        int_type imax = (IL_READ); \
-        ctype min, max; \
-        memcpy(&min, &imin, sizeof(ctype)); \
-        memcpy(&max, &imax, sizeof(ctype)); \
-        if (ctx->cursor < size) return CND_ERR_OOB; \
-        int_type ival = (BUF_READ); \
-        ctype val; \
-        memcpy(&val, &ival, sizeof(ctype)); \
-        if (val < min || val > max) return CND_ERR_VALIDATION; \
-    }
-
 // --- Loop Stack Helpers ---
 
 static void skip_loop_body(cnd_vm_ctx* ctx) {
@@ -314,226 +24,55 @@ static void skip_loop_body(cnd_vm_ctx* ctx) {
     }
 }
 
-static bool loop_push(cnd_vm_ctx* ctx, size_t start_ip, uint32_t count) {
-    if (ctx->loop_depth >= CND_MAX_LOOP_DEPTH) return false;
-    ctx->loop_stack[ctx->loop_depth].start_ip = start_ip;
-    ctx->loop_stack[ctx->loop_depth].remaining = count;
-    ctx->loop_depth++;
-    return true;
-}
-
-static void loop_pop(cnd_vm_ctx* ctx) {
-    if (ctx->loop_depth > 0) ctx->loop_depth--;
-}
-
 // --- Optimization Helpers ---
 
-static bool try_optimize_byte_array(cnd_vm_ctx* ctx, uint32_t count) {
+// Bulk array path for a loop body made of one primitive IO (optionally behind
+// SCALE_LIN): byte arrays go to the host as OP_RAW_BYTES, other primitives as
+// OP_ARR_SPAN. Returns false to run the loop instead; otherwise the array is
+// done (or failed, see *err) and ctx->ip is past its OP_ARR_END.
+static bool try_bulk_array(cnd_vm_ctx* ctx, uint32_t count, cnd_error_t* err) {
     if (count == 0) return false;
-    if (ctx->ip + 3 >= ctx->program->bytecode_len) return false;
-    
-    uint8_t next_op = ctx->program->bytecode[ctx->ip];
-    uint8_t after_op = ctx->program->bytecode[ctx->ip + 3];
-    
-    if ((next_op == OP_IO_U8 || next_op == OP_IO_I8) && after_op == OP_ARR_END) {
-        uint16_t elem_key = (uint16_t)(ctx->program->bytecode[ctx->ip + 1] | (ctx->program->bytecode[ctx->ip + 2] << 8));
-        
-        if (ctx->cursor + count > ctx->data_len) return false; // Let normal loop handle OOB
-        
-        void* ptr = ctx->data_buffer + ctx->cursor;
-        
-        // Call callback with OP_RAW_BYTES
-        if (ctx->io_callback(ctx, elem_key, OP_RAW_BYTES, ptr) != CND_ERR_OK) {
-            return false; // Fallback to loop if callback fails (e.g. doesn't handle RAW_BYTES)
-        }
-        
-        ctx->cursor += count;
-        ctx->ip += 4; // Skip OP_IO_U8(1) + KEY(2) + OP_ARR_END(1)
-        return true;
-    }
-    return false;
-}
-
-// --- Array/String Helpers ---
-
-#define HANDLE_ARRAY_PRE(size, ctype, READ_EXPR, WRITE_EXPR) \
-    { \
-        uint16_t key = FETCH_IL_U16(ctx); \
-        ctype count = 0; \
-        if (ctx->mode == CND_MODE_ENCODE) { \
-            SYNC_IP(); \
-            if (ctx->io_callback(ctx, key, opcode, &count) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-            if (ctx->cursor + (size) > ctx->data_len) return CND_ERR_OOB; \
-            WRITE_EXPR; \
-            ctx->cursor += (size); \
-        } else { \
-            if (ctx->cursor + (size) > ctx->data_len) return CND_ERR_OOB; \
-            count = (READ_EXPR); \
-            ctx->cursor += (size); \
-            SYNC_IP(); \
-            if (ctx->io_callback(ctx, key, opcode, &count) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-        } \
-        if (count > 0) { \
-            SYNC_IP(); \
-            if (try_optimize_byte_array(ctx, (uint32_t)count)) { RELOAD_PC(); break; } \
-            if (!loop_push(ctx, ctx->ip, (uint32_t)count)) return CND_ERR_OOB; \
-        } else { \
-             SYNC_IP(); \
-             skip_loop_body(ctx); \
-             RELOAD_PC(); \
-        } \
-        break; \
-    }
-
-#define HANDLE_STRING_PRE(size, ctype, READ_EXPR, WRITE_EXPR) \
-    { \
-        uint16_t key = FETCH_IL_U16(ctx); \
-        const char* str = NULL; \
-        if (ctx->mode == CND_MODE_ENCODE) { \
-            SYNC_IP(); \
-            if (ctx->io_callback(ctx, key, opcode, &str) != CND_ERR_OK) { \
-                if (ctx->is_next_optional) { \
-                    ctx->is_next_optional = false; \
-                    break; \
-                } \
-                return CND_ERR_CALLBACK; \
-            } \
-            size_t len = str ? strlen(str) : 0; \
-            ctype max_val = (ctype)-1; \
-            if (len > (size_t)max_val) len = (size_t)max_val; \
-            if (ctx->cursor + (size) + len > ctx->data_len) return CND_ERR_OOB; \
-            ctype len_val = (ctype)len; \
-            WRITE_EXPR; \
-            memcpy(ctx->data_buffer + ctx->cursor + (size), str, len); \
-            ctx->cursor += (size) + len; \
-        } else { \
-            if (ctx->cursor + (size) > ctx->data_len) return CND_ERR_OOB; \
-            ctype len_val = (READ_EXPR); \
-            if (ctx->cursor + (size) + len_val > ctx->data_len) return CND_ERR_OOB; \
-            const char* ptr = (const char*)(ctx->data_buffer + ctx->cursor + (size)); \
-            SYNC_IP(); \
-            if (ctx->io_callback(ctx, key, opcode, (void*)ptr) != CND_ERR_OK) return CND_ERR_CALLBACK; \
-            ctx->cursor += (size) + len_val; \
-        } \
-        ctx->is_next_optional = false; \
-        break; \
+    const uint8_t* bc = ctx->program->bytecode;
+    size_t len = ctx->program->bytecode_len;
+    size_t ip = ctx->ip;
+
+    double scale[2];
+    bool scaled = false;
+    if (ip < len && bc[ip] == OP_SCALE_LIN) {
+        if (ip + 17 > len) return false;
+        uint64_t fac = il_get_u64(bc + ip + 1);
+        uint64_t off = il_get_u64(bc + ip + 9);
+        memcpy(&scale[0], &fac, 8);
+        memcpy(&scale[1], &off, 8);
+        scaled = true;
+        ip += 17;
     }
+    if (ip + 3 >= len || bc[ip + 3] != OP_ARR_END) return false;
+    uint8_t elem_op = bc[ip];
+    uint16_t elem_key = (uint16_t)(il_get_u16(bc + ip + 1) + ctx->key_base);
 
-static int64_t sign_extend(uint64_t val, uint8_t bits) {
-    if (bits >= 64) return (int64_t)val;
-    uint64_t m = 1ULL << (bits - 1);
-    return (int64_t)((val ^ m) - m);
-}
-
-// --- CRC Helpers ---
-
-static uint32_t reflect(uint32_t val, int bits) {
-    uint32_t res = 0;
-    for (int i = 0; i < bits; i++) {
-        if (val & (1 << i)) res |= (1 << (bits - 1 - i));
-    }
-    return res;
-}
-
-static const uint32_t crc32_table[256] = {
-    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
-    0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
-    0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
-    0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
-    0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172, 0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
-    0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
-    0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
-    0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924, 0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
-    0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
-    0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e, 0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
-    0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
-    0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
-    0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0, 0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
-    0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
-    0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
-    0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a, 0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
-    0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
-    0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc, 0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
-    0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
-    0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
-    0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236, 0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
-    0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
-    0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
-    0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38, 0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
-    0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
-    0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2, 0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
-    0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
-    0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
-    0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
-};
-
-static uint32_t calc_crc(const uint8_t* data, size_t len, uint32_t poly, uint32_t init, uint32_t xorout, uint8_t flags, int width) {
-    // Fast path for Standard CRC32 (Poly 0x04C11DB7, RefIn=1, RefOut=1)
-    if (width == 32 && poly == 0x04C11DB7 && (flags & 1) && (flags & 2)) {
-        uint32_t crc = init;
-        for (size_t i = 0; i < len; i++) {
-            crc = (crc >> 8) ^ crc32_table[(crc ^ data[i]) & 0xFF];
+    if (!scaled && (elem_op == OP_IO_U8 || elem_op == OP_IO_I8) && ctx->cursor + count <= ctx->data_len) {
+        // Callback reads or writes the bytes in place
+        void* ptr = ctx->data_buffer + ctx->cursor;
+        if (ctx->io_callback(ctx, elem_key, OP_RAW_BYTES, ptr) == CND_ERR_OK) {
+            ctx->cursor += count;
+            ctx->ip = ip + 4; // Skip element IO + OP_ARR_END
+            *err = CND_ERR_OK;
+            return true;
         }
-        return crc ^ xorout;
     }
 
-    uint32_t crc = init;
-    bool refin = flags & 1;
-    bool refout = flags & 2;
-    uint32_t mask = (width == 32) ? 0xFFFFFFFF : 0xFFFF;
-
-    for (size_t i = 0; i < len; i++) {
-        uint8_t octet = data[i];
-        if (refin) octet = (uint8_t)reflect(octet, 8);
-        
-        if (width == 16) {
-            crc ^= (uint16_t)(octet << 8);
-            for (int j = 0; j < 8; j++) {
-                if (crc & 0x8000) crc = ((crc << 1) ^ poly) & 0xFFFF;
-                else crc = (crc << 1) & 0xFFFF;
-            }
-        } else { // 32
-            crc ^= (uint32_t)(octet << 24);
-            for (int j = 0; j < 8; j++) {
-                if (crc & 0x80000000) crc = (crc << 1) ^ poly;
-                else crc <<= 1;
-            }
-        }
+    // Streaming: the bytes go to the host as they arrive
+    if (!scaled && (elem_op == OP_IO_U8 || elem_op == OP_IO_I8) && vm_stream_open(ctx) &&
+        vm_stream_span(ctx, elem_key, elem_op, count, err)) {
+        ctx->ip = ip + 4;
+        return true;
     }
-    
-    if (refout) crc = reflect(crc, width);
-    return (crc ^ xorout) & mask;
-}
 
-static const bool ALIGN_TABLE[256] = {
-    // 0x00 - 0x0F (Meta & State) - No alignment
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    // 0x10 - 0x1F (Primitives) - Align
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-    // 0x20 - 0x2F (Bitfields) - No alignment
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    // 0x30 - 0x3F (Arrays & Strings) - Align
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-    // 0x40 - 0x4F (Validation)
-    1, // 0x40 CONST_CHECK
-    1, // 0x41 CONST_WRITE
-    0, // 0x42 RANGE_CHECK
-    0, // 0x43 SCALE_LIN
-    1, // 0x44 CRC_16
-    0, // 0x45 TRANS_ADD
-    0, // 0x46 TRANS_SUB
-    0, // 0x47 TRANS_MUL
-    0, // 0x48 TRANS_DIV
-    1, // 0x49 CRC_32
-    0, // 0x4A MARK_OPTIONAL
-    1, // 0x4B ENUM_CHECK
-    1, 1, 1, 1, // 0x4C - 0x4F
-    // 0x50 - 0xFF (Control Flow & Others) - No alignment
-    0 // ... rest 0
-};
+    if (!vm_array_span(ctx, elem_key, elem_op, count, scaled ? scale : NULL, err)) return false;
+    ctx->ip = ip + 4;
+    return true;
+}
 
 // --- Public API ---
 
@@ -543,26 +82,55 @@ void cnd_program_load(cnd_program* program, const uint8_t* bytecode, size_t len)
     program->bytecode_len = len;
     program->string_table = NULL;
     program->string_count = 0;
+    program->layout = NULL;
+    program->layout_count = 0;
+    program->min_size = 0;
+    program->max_size = 0;
 }
 
 cnd_error_t cnd_program_load_il(cnd_program* program, const uint8_t* image, size_t len) {
     if (!program || !image) return CND_ERR_INVALID_OP;
     
     // Header Check: "CNDIL" (5 bytes) + Ver (1 byte) + StrCount (2) + StrOff (4) + BCOff (4) = 16 bytes
+    // v2 adds LayoutOff (4) + LayoutCount (2) + Reserved (2) = 24 bytes
+    // v3 adds MinSize (4) + MaxSize (4) = 32 bytes
     if (len < 16) return CND_ERR_OOB;
     if (memcmp(image, "CNDIL", 5) != 0) return CND_ERR_INVALID_OP;
-    if (image[5] != 1) return CND_ERR_INVALID_OP; // Version check
+    uint8_t version = image[5];
+    if (version < 1 || version > 3) return CND_ERR_INVALID_OP; // Version check
+    if (version == 2 && len < 24) return CND_ERR_OOB;
+    if (version == 3 && len < CND_IL_HEADER_SIZE) return CND_ERR_OOB;
 
-    uint16_t str_count = image[6] | (image[7] << 8);
-    uint32_t str_offset = image[8] | (image[9] << 8) | (image[10] << 16) | (image[11] << 24);
-    uint32_t bc_offset = image[12] | (image[13] << 8) | (image[14] << 16) | (image[15] << 24);
+    uint16_t str_count = il_get_u16(image + 6);
+    uint32_t str_offset = il_get_u32(image + 8);
+    uint32_t bc_offset = il_get_u32(image + 12);
 
     if (str_offset > len || bc_offset > len) return CND_ERR_OOB;
+
+    const uint8_t* layout = NULL;
+    uint16_t layout_count = 0;
+    if (version >= 2) {
+        uint32_t layout_offset = il_get_u32(image + 16);
+        layout_count = il_get_u16(image + 20);
+        if (layout_offset > bc_offset ||
+            (size_t)layout_count * CND_LAYOUT_ENTRY_SIZE > bc_offset - layout_offset) return CND_ERR_OOB;
+        layout = layout_count ? image + layout_offset : NULL;
+    }
+    uint32_t min_size = 0, max_size = 0;
+    if (version >= 3) {
+        min_size = il_get_u32(image + 24);
+        max_size = il_get_u32(image + 28);
+    }
     
     program->string_table = (const char*)(image + str_offset);
     program->string_count = str_count;
     program->bytecode = image + bc_offset;
     program->bytecode_len = len - bc_offset;
+    program->layout = layout;
+    program->layout_count = layout_count;
+    program->min_size = min_size;
+    program->max_size = max_size;
+    vm_crc_prepare(program);
     
     return CND_ERR_OK;
 }
@@ -590,1089 +158,281 @@ uint16_t cnd_get_key_id(const cnd_program* program, const char* name) {
     return 0xFFFF;
 }
 
-void cnd_init(cnd_vm_ctx* ctx, 
-              cnd_mode_t mode,
-              const cnd_program* program,
-              uint8_t* data, size_t data_len,
-              cnd_io_cb cb, void* user) 
-{
-    if (!ctx) return;
-    ctx->mode = mode;
-    ctx->program = program;
-    ctx->data_buffer = data;
-    ctx->data_len = data_len;
-    ctx->io_callback = cb;
-    ctx->user_ptr = user;
-    
+// Runtime state every run starts from
+static void vm_reset_run(cnd_vm_ctx* ctx) {
     ctx->ip = 0;
     ctx->cursor = 0;
     ctx->bit_offset = 0;
-    ctx->endianness = CND_LE; 
+    ctx->endianness = CND_LE;
     ctx->loop_depth = 0;
+    ctx->call_depth = 0;
+    ctx->key_base = 0;
     ctx->expr_sp = 0;
-    
+    ctx->slot_valid = 0;
+
     ctx->trans_type = CND_TRANS_NONE;
     ctx->trans_f_factor = 1.0;
     ctx->trans_f_offset = 0.0;
     ctx->trans_i_val = 0;
-    
+
     ctx->is_next_optional = false;
-}
 
-// Helper for stack operations
-static inline cnd_error_t stack_push(cnd_vm_ctx* ctx, uint64_t val) {
-    if (ctx->expr_sp >= CND_MAX_EXPR_STACK) return CND_ERR_STACK_OVERFLOW;
-    ctx->expr_stack[ctx->expr_sp++] = val;
-    return CND_ERR_OK;
-}
+    ctx->crc_start = 0;
+    ctx->crc_end = SIZE_MAX;
+    ctx->crc_done = 0;
+    ctx->crc_width = 0;
 
-static inline cnd_error_t stack_pop(cnd_vm_ctx* ctx, uint64_t* val) {
-    if (ctx->expr_sp == 0) return CND_ERR_STACK_UNDERFLOW;
-    *val = ctx->expr_stack[--ctx->expr_sp];
-    return CND_ERR_OK;
+    ctx->span_left = 0;
 }
 
-// Helper for binary operations
-#define BINARY_OP(OP) \
-    uint64_t b; if (stack_pop(ctx, &b) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW; \
-    uint64_t a; if (stack_pop(ctx, &a) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW; \
-    if (stack_push(ctx, a OP b) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-
-// Helper for unary operations
-#define UNARY_OP(OP) \
-    uint64_t a; if (stack_pop(ctx, &a) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW; \
-    if (stack_push(ctx, OP a) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-
-// Helper for float binary operations
-#define BINARY_OP_F(OP) \
-    uint64_t b_bits; if (stack_pop(ctx, &b_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW; \
-    uint64_t a_bits; if (stack_pop(ctx, &a_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW; \
-    double a, b; memcpy(&a, &a_bits, 8); memcpy(&b, &b_bits, 8); \
-    double res = a OP b; \
-    uint64_t res_bits; memcpy(&res_bits, &res, 8); \
-    if (stack_push(ctx, res_bits) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-
-// Helper for float comparison operations (returns boolean integer)
-#define BINARY_OP_F_BOOL(OP) \
-    uint64_t b_bits; if (stack_pop(ctx, &b_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW; \
-    uint64_t a_bits; if (stack_pop(ctx, &a_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW; \
-    double a, b; memcpy(&a, &a_bits, 8); memcpy(&b, &b_bits, 8); \
-    uint64_t res = (a OP b) ? 1 : 0; \
-    if (stack_push(ctx, res) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-
-// Helper for float unary operations
-#define UNARY_OP_F(FUNC) \
-    uint64_t a_bits; if (stack_pop(ctx, &a_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW; \
-    double a; memcpy(&a, &a_bits, 8); \
-    double res = FUNC(a); \
-    uint64_t res_bits; memcpy(&res_bits, &res, 8); \
-    if (stack_push(ctx, res_bits) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-
-cnd_error_t cnd_execute(cnd_vm_ctx* ctx) {
-    if (!ctx || !ctx->program || !ctx->program->bytecode || !ctx->data_buffer) return CND_ERR_OOB;
-
-    const uint8_t* pc = ctx->program->bytecode + ctx->ip;
-    const uint8_t* end = ctx->program->bytecode + ctx->program->bytecode_len;
-
-    // Override fetch macros to use local pc
-    #undef FETCH_IL_U8
-    #undef FETCH_IL_U16
-    #define FETCH_IL_U8(c) ((pc < end) ? *pc++ : 0)
-    #define FETCH_IL_U16(c) ((pc + 2 <= end) ? (pc += 2, (uint16_t)(pc[-2] | (pc[-1] << 8))) : 0)
-    #define FETCH_IL_U32(c) ((pc + 4 <= end) ? (pc += 4, (uint32_t)(pc[-4] | (pc[-3] << 8) | (pc[-2] << 16) | (pc[-1] << 24))) : 0)
-    #define FETCH_IL_U64(c) ((pc + 8 <= end) ? (pc += 8, ((uint64_t)pc[-8] | ((uint64_t)pc[-7] << 8) | ((uint64_t)pc[-6] << 16) | ((uint64_t)pc[-5] << 24) | ((uint64_t)pc[-4] << 32) | ((uint64_t)pc[-3] << 40) | ((uint64_t)pc[-2] << 48) | ((uint64_t)pc[-1] << 56))) : 0)
-    
-    #define SYNC_IP() (ctx->ip = (size_t)(pc - ctx->program->bytecode))
-    #define RELOAD_PC() (pc = ctx->program->bytecode + ctx->ip)
-
-    while (pc < end) {
-        uint8_t opcode = *pc++;
-        // printf("Opcode: %02X at IP %zu\n", opcode, (size_t)(pc - ctx->program->bytecode - 1));
-
-        // Check alignment
-        if (ALIGN_TABLE[opcode]) {
-             if (ctx->bit_offset != 0) {
-                ctx->cursor++;
-                ctx->bit_offset = 0;
-            }
-        }
-
-        switch (opcode) {
-            case OP_NOOP: break;
-            case OP_SET_ENDIAN_LE: ctx->endianness = CND_LE; break;
-            case OP_SET_ENDIAN_BE: ctx->endianness = CND_BE; break;
-            
-            case OP_ENTER_STRUCT: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                // printf("VM_DEBUG: Calling callback for ENTER_STRUCT (Key %d)\n", key);
-                SYNC_IP();
-                // Allow callback to return error, but also allow it to just return OK.
-                // If callback returns error, we stop.
-                if (ctx->io_callback(ctx, key, opcode, NULL) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                break; 
-            }
-            
-            case OP_EXIT_STRUCT: {
-                // printf("VM_DEBUG: Calling callback for EXIT_STRUCT\n");
-                SYNC_IP();
-                if (ctx->io_callback(ctx, 0, opcode, NULL) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                break; 
-            }
-
-            case OP_META_VERSION: {
-                FETCH_IL_U8(ctx); // Skip version
-                break;
-            }
-
-            case OP_META_NAME: {
-                FETCH_IL_U16(ctx); // Skip name key
-                break;
-            }
-            
-            case OP_CONST_WRITE: {
-                uint8_t type = FETCH_IL_U8(ctx);
-                uint64_t val = 0;
-                int size = 0;
-                if (type == OP_IO_U8) { val = FETCH_IL_U8(ctx); size=1; }
-                else if (type == OP_IO_U16) { val = FETCH_IL_U16(ctx); size=2; }
-                else if (type == OP_IO_U32) { val = FETCH_IL_U32(ctx); size=4; }
-                else if (type == OP_IO_U64) { val = FETCH_IL_U64(ctx); size=8; }
-                else { return CND_ERR_INVALID_OP; }
-                
-                if (ctx->cursor + size > ctx->data_len) return CND_ERR_OOB;
-                
-                if (size == 1) write_u8(ctx->data_buffer + ctx->cursor, (uint8_t)val);
-                else if (size == 2) write_u16(ctx->data_buffer + ctx->cursor, (uint16_t)val, ctx->endianness);
-                else if (size == 4) write_u32(ctx->data_buffer + ctx->cursor, (uint32_t)val, ctx->endianness);
-                else if (size == 8) write_u64(ctx->data_buffer + ctx->cursor, val, ctx->endianness);
-                
-                ctx->cursor += size;
-                break;
-            }
-            
-            case OP_CONST_CHECK: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                uint8_t type = FETCH_IL_U8(ctx);
-                uint64_t expected = 0;
-                int size = 0;
-                if (type == OP_IO_U8 || type == OP_IO_I8) { expected = FETCH_IL_U8(ctx); size=1; }
-                else if (type == OP_IO_U16 || type == OP_IO_I16) { expected = FETCH_IL_U16(ctx); size=2; }
-                else if (type == OP_IO_U32 || type == OP_IO_I32) { expected = FETCH_IL_U32(ctx); size=4; }
-                else if (type == OP_IO_U64 || type == OP_IO_I64) { expected = FETCH_IL_U64(ctx); size=8; }
-                else { return CND_ERR_INVALID_OP; }
-                
-                if (ctx->cursor + size > ctx->data_len) return CND_ERR_OOB;
-                
-                if (ctx->mode == CND_MODE_ENCODE) {
-                    if (size == 1) write_u8(ctx->data_buffer + ctx->cursor, (uint8_t)expected);
-                    else if (size == 2) write_u16(ctx->data_buffer + ctx->cursor, (uint16_t)expected, ctx->endianness);
-                    else if (size == 4) write_u32(ctx->data_buffer + ctx->cursor, (uint32_t)expected, ctx->endianness);
-                    else if (size == 8) write_u64(ctx->data_buffer + ctx->cursor, expected, ctx->endianness);
-                } else {
-                    uint64_t actual = 0;
-                    if (size == 1) actual = read_u8(ctx->data_buffer + ctx->cursor);
-                    else if (size == 2) actual = read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness);
-                    else if (size == 4) actual = read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness);
-                    else if (size == 8) actual = read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness);
-                    if (actual != expected) return CND_ERR_VALIDATION;
-
-                    // Notify host (Read-Only)
-                    SYNC_IP();
-                    if (size == 1) { uint8_t v = (uint8_t)actual; if (ctx->io_callback(ctx, key, type, &v) != CND_ERR_OK) return CND_ERR_CALLBACK; }
-                    else if (size == 2) { uint16_t v = (uint16_t)actual; if (ctx->io_callback(ctx, key, type, &v) != CND_ERR_OK) return CND_ERR_CALLBACK; }
-                    else if (size == 4) { uint32_t v = (uint32_t)actual; if (ctx->io_callback(ctx, key, type, &v) != CND_ERR_OK) return CND_ERR_CALLBACK; }
-                    else if (size == 8) { uint64_t v = actual; if (ctx->io_callback(ctx, key, type, &v) != CND_ERR_OK) return CND_ERR_CALLBACK; }
-                }
-                
-                ctx->cursor += size;
-                break;
-            }
-
-            case OP_ENUM_CHECK: {
-                uint8_t type = FETCH_IL_U8(ctx);
-                uint16_t count = FETCH_IL_U16(ctx);
-                bool found = false;
-                
-                #define CHECK_ENUM(size, ctype, READ_EXPR) \
-                    ctype actual = (READ_EXPR); \
-                    for (uint16_t i = 0; i < count; i++) { \
-                        ctype val = 0; \
-                        if (size == 1) val = (ctype)FETCH_IL_U8(ctx); \
-                        else if (size == 2) val = (ctype)FETCH_IL_U16(ctx); \
-                        else if (size == 4) val = (ctype)FETCH_IL_U32(ctx); \
-                        else if (size == 8) val = (ctype)FETCH_IL_U64(ctx); \
-                        if (actual == val) { \
-                            found = true; \
-                            pc += (count - 1 - i) * size; \
-                            break; \
-                        } \
-                    }
+void cnd_init(cnd_vm_ctx* ctx, 
+              cnd_mode_t mode,
+              const cnd_program* program,
+              uint8_t* data, size_t data_len,
+              cnd_io_cb cb, void* user) 
+{
+    if (!ctx) return;
+    ctx->mode = mode;
+    ctx->program = program;
+    ctx->data_buffer = data;
+    ctx->data_len = data_len;
+    ctx->io_callback = cb;
+    ctx->user_ptr = user;
+    ctx->batch_index = 0;
+    ctx->flags = 0;
+    vm_reset_run(ctx);
+}
 
-#ifdef _MSC_VER
-#pragma warning(push)
-#pragma warning(disable: 4127)
+// --- Interpreter Loop ---
+// Fetch and IP macros operate on the loop-local `pc`/`end` of vm_exec_loop.h.
+
+#define FETCH_IL_U8(c) ((pc < end) ? *pc++ : 0)
+#define FETCH_IL_U16(c) ((pc + 2 <= end) ? (pc += 2, (uint16_t)(pc[-2] | (pc[-1] << 8))) : 0)
+#define FETCH_KEY(c) ((uint16_t)(FETCH_IL_U16(c) + (c)->key_base))
+#define FETCH_IL_U32(c) ((pc + 4 <= end) ? (pc += 4, (uint32_t)(pc[-4] | (pc[-3] << 8) | (pc[-2] << 16) | (pc[-1] << 24))) : 0)
+#define FETCH_IL_U64(c) ((pc + 8 <= end) ? (pc += 8, ((uint64_t)pc[-8] | ((uint64_t)pc[-7] << 8) | ((uint64_t)pc[-6] << 16) | ((uint64_t)pc[-5] << 24) | ((uint64_t)pc[-4] << 32) | ((uint64_t)pc[-3] << 40) | ((uint64_t)pc[-2] << 48) | ((uint64_t)pc[-1] << 56))) : 0)
+
+#define SYNC_IP() (ctx->ip = (size_t)(pc - ctx->program->bytecode))
+#define RELOAD_PC() (pc = ctx->program->bytecode + ctx->ip)
+#define TRY_BULK_ARRAY(count, err) try_bulk_array(ctx, (count), (err))
+#define SKIP_LOOP() skip_loop_body(ctx)
+
+// One loop per (mode, callback/binder) pair so VM_ENCODING and VM_BOUND fold away
+#define VM_LOOP_FN vm_exec_switch_encode
+#define VM_THREADED 0
+#define VM_ENCODING 1
+#define VM_BOUND 0
+#include "vm_exec_loop.h"
+#define VM_LOOP_FN vm_exec_switch_decode
+#define VM_THREADED 0
+#define VM_ENCODING 0
+#define VM_BOUND 0
+#include "vm_exec_loop.h"
+#define VM_LOOP_FN vm_exec_switch_encode_bound
+#define VM_THREADED 0
+#define VM_ENCODING 1
+#define VM_BOUND 1
+#include "vm_exec_loop.h"
+#define VM_LOOP_FN vm_exec_switch_decode_bound
+#define VM_THREADED 0
+#define VM_ENCODING 0
+#define VM_BOUND 1
+#include "vm_exec_loop.h"
+#define VM_LOOP_FN vm_exec_switch_decode_stream
+#define VM_THREADED 0
+#define VM_ENCODING 0
+#define VM_BOUND 0
+#define VM_STREAM 1
+#include "vm_exec_loop.h"
+
+#if VM_HAVE_THREADED_DISPATCH
+// Labels as values are a GNU extension; keep -pedantic builds quiet here only.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#if defined(__clang__)
+#pragma GCC diagnostic ignored "-Winitializer-overrides"
+#else
+#pragma GCC diagnostic ignored "-Woverride-init"
 #endif
-                switch (type) {
-                    case OP_IO_U8:  { CHECK_ENUM(1, uint8_t, read_u8(ctx->data_buffer + ctx->cursor - 1)); break; }
-                    case OP_IO_I8:  { CHECK_ENUM(1, int8_t,  (int8_t)read_u8(ctx->data_buffer + ctx->cursor - 1)); break; }
-                    case OP_IO_U16: { CHECK_ENUM(2, uint16_t, read_u16(ctx->data_buffer + ctx->cursor - 2, ctx->endianness)); break; }
-                    case OP_IO_I16: { CHECK_ENUM(2, int16_t,  (int16_t)read_u16(ctx->data_buffer + ctx->cursor - 2, ctx->endianness)); break; }
-                    case OP_IO_U32: { CHECK_ENUM(4, uint32_t, read_u32(ctx->data_buffer + ctx->cursor - 4, ctx->endianness)); break; }
-                    case OP_IO_I32: { CHECK_ENUM(4, int32_t,  (int32_t)read_u32(ctx->data_buffer + ctx->cursor - 4, ctx->endianness)); break; }
-                    case OP_IO_U64: { CHECK_ENUM(8, uint64_t, read_u64(ctx->data_buffer + ctx->cursor - 8, ctx->endianness)); break; }
-                    case OP_IO_I64: { CHECK_ENUM(8, int64_t,  (int64_t)read_u64(ctx->data_buffer + ctx->cursor - 8, ctx->endianness)); break; }
-                    default: return CND_ERR_INVALID_OP;
-                }
-#ifdef _MSC_VER
-#pragma warning(pop)
+#define VM_LOOP_FN vm_exec_threaded_encode
+#define VM_THREADED 1
+#define VM_ENCODING 1
+#define VM_BOUND 0
+#include "vm_exec_loop.h"
+#define VM_LOOP_FN vm_exec_threaded_decode
+#define VM_THREADED 1
+#define VM_ENCODING 0
+#define VM_BOUND 0
+#include "vm_exec_loop.h"
+#define VM_LOOP_FN vm_exec_threaded_encode_bound
+#define VM_THREADED 1
+#define VM_ENCODING 1
+#define VM_BOUND 1
+#include "vm_exec_loop.h"
+#define VM_LOOP_FN vm_exec_threaded_decode_bound
+#define VM_THREADED 1
+#define VM_ENCODING 0
+#define VM_BOUND 1
+#include "vm_exec_loop.h"
+#pragma GCC diagnostic pop
 #endif
-                #undef CHECK_ENUM
-                
-                if (!found) return CND_ERR_VALIDATION;
-                break;
-            }
-
-            case OP_RANGE_CHECK: {
-                uint8_t type = FETCH_IL_U8(ctx);
-                switch (type) {
-                    case OP_IO_U8:  CHECK_RANGE(1, uint8_t, FETCH_IL_U8(ctx), read_u8(ctx->data_buffer + ctx->cursor - 1)); break;
-                    case OP_IO_I8:  CHECK_RANGE(1, int8_t,  FETCH_IL_U8(ctx), read_u8(ctx->data_buffer + ctx->cursor - 1)); break;
-                    case OP_IO_U16: CHECK_RANGE(2, uint16_t, FETCH_IL_U16(ctx), read_u16(ctx->data_buffer + ctx->cursor - 2, ctx->endianness)); break;
-                    case OP_IO_I16: CHECK_RANGE(2, int16_t,  FETCH_IL_U16(ctx), read_u16(ctx->data_buffer + ctx->cursor - 2, ctx->endianness)); break;
-                    case OP_IO_U32: CHECK_RANGE(4, uint32_t, FETCH_IL_U32(ctx), read_u32(ctx->data_buffer + ctx->cursor - 4, ctx->endianness)); break;
-                    case OP_IO_I32: CHECK_RANGE(4, int32_t,  FETCH_IL_U32(ctx), read_u32(ctx->data_buffer + ctx->cursor - 4, ctx->endianness)); break;
-                    case OP_IO_U64: CHECK_RANGE(8, uint64_t, FETCH_IL_U64(ctx), read_u64(ctx->data_buffer + ctx->cursor - 8, ctx->endianness)); break;
-                    case OP_IO_I64: CHECK_RANGE(8, int64_t,  FETCH_IL_U64(ctx), read_u64(ctx->data_buffer + ctx->cursor - 8, ctx->endianness)); break;
-                    
-                    case OP_IO_F32: CHECK_RANGE_FLOAT(4, float, uint32_t, FETCH_IL_U32(ctx), read_u32(ctx->data_buffer + ctx->cursor - 4, ctx->endianness)); break;
-                    case OP_IO_F64: CHECK_RANGE_FLOAT(8, double, uint64_t, FETCH_IL_U64(ctx), read_u64(ctx->data_buffer + ctx->cursor - 8, ctx->endianness)); break;
-                    
-                    default: return CND_ERR_INVALID_OP;
-                }
-                break;
-            }
-
-            case OP_CRC_16: {
-                uint16_t poly = FETCH_IL_U16(ctx);
-                uint16_t init = FETCH_IL_U16(ctx);
-                uint16_t xorout = FETCH_IL_U16(ctx);
-                uint8_t flags = FETCH_IL_U8(ctx);
-                
-                uint32_t crc = calc_crc(ctx->data_buffer, ctx->cursor, poly, init, xorout, flags, 16);
-                
-                if (ctx->cursor + 2 > ctx->data_len) return CND_ERR_OOB;
-                
-                if (ctx->mode == CND_MODE_ENCODE) {
-                    write_u16(ctx->data_buffer + ctx->cursor, (uint16_t)crc, ctx->endianness);
-                } else {
-                    uint16_t actual = read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness);
-                    if (actual != (uint16_t)crc) return CND_ERR_CRC_MISMATCH;
-                }
-                ctx->cursor += 2;
-                break;
-            }
-
-            case OP_CRC_32: {
-                uint32_t poly = FETCH_IL_U32(ctx);
-                uint32_t init = FETCH_IL_U32(ctx);
-                uint32_t xorout = FETCH_IL_U32(ctx);
-                uint8_t flags = FETCH_IL_U8(ctx);
-                
-                uint32_t crc = calc_crc(ctx->data_buffer, ctx->cursor, poly, init, xorout, flags, 32);
-                
-                if (ctx->cursor + 4 > ctx->data_len) return CND_ERR_OOB;
-                
-                if (ctx->mode == CND_MODE_ENCODE) {
-                    write_u32(ctx->data_buffer + ctx->cursor, crc, ctx->endianness);
-                } else {
-                    uint32_t actual = read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness);
-                    if (actual != crc) return CND_ERR_CRC_MISMATCH;
-                }
-                ctx->cursor += 4;
-                break;
-            }
-
-            case OP_SCALE_LIN: {
-                uint64_t i_fac = FETCH_IL_U64(ctx);
-                uint64_t i_off = FETCH_IL_U64(ctx);
-                double fac, off;
-                memcpy(&fac, &i_fac, 8);
-                memcpy(&off, &i_off, 8);
-                ctx->trans_type = CND_TRANS_SCALE_F64;
-                ctx->trans_f_factor = fac;
-                ctx->trans_f_offset = off;
-                break;
-            }
-
-            case OP_TRANS_POLY: {
-                uint8_t count = FETCH_IL_U8(ctx);
-                ctx->trans_type = CND_TRANS_POLY;
-                ctx->trans_poly_count = count;
-                ctx->trans_poly_data = pc;
-                pc += (count * 8);
-                if (pc > end) return CND_ERR_OOB;
-                break;
-            }
-
-            case OP_TRANS_SPLINE: {
-                uint8_t count = FETCH_IL_U8(ctx);
-                ctx->trans_type = CND_TRANS_SPLINE;
-                ctx->trans_spline_count = count;
-                ctx->trans_spline_data = pc;
-                pc += (count * 2 * 8); // 2 doubles per point
-                if (pc > end) return CND_ERR_OOB;
-                break;
-            }
-
-            case OP_MARK_OPTIONAL:
-                ctx->is_next_optional = true;
-                break;
-            
-            case OP_TRANS_ADD: ctx->trans_type = CND_TRANS_ADD_I64; ctx->trans_i_val = (int64_t)FETCH_IL_U64(ctx); break;
-            case OP_TRANS_SUB: ctx->trans_type = CND_TRANS_SUB_I64; ctx->trans_i_val = (int64_t)FETCH_IL_U64(ctx); break;
-            case OP_TRANS_MUL: ctx->trans_type = CND_TRANS_MUL_I64; ctx->trans_i_val = (int64_t)FETCH_IL_U64(ctx); break;
-            case OP_TRANS_DIV: ctx->trans_type = CND_TRANS_DIV_I64; ctx->trans_i_val = (int64_t)FETCH_IL_U64(ctx); break;
-
-            // ... Category B (Primitives) ...
-            case OP_IO_U8: HANDLE_PRIMITIVE(1, uint8_t, read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, val));
-            case OP_IO_U16: HANDLE_PRIMITIVE(2, uint16_t, read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, val, ctx->endianness));
-            case OP_IO_U32: HANDLE_PRIMITIVE(4, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, val, ctx->endianness));
-            case OP_IO_U64: HANDLE_PRIMITIVE(8, uint64_t, read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u64(ctx->data_buffer + ctx->cursor, val, ctx->endianness));
-            
-            case OP_IO_I8: HANDLE_PRIMITIVE(1, int8_t, (int8_t)read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, (uint8_t)val));
-            case OP_IO_I16: HANDLE_PRIMITIVE(2, int16_t, (int16_t)read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, (uint16_t)val, ctx->endianness));
-            case OP_IO_I32: HANDLE_PRIMITIVE(4, int32_t, (int32_t)read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, (uint32_t)val, ctx->endianness));
-            case OP_IO_I64: HANDLE_PRIMITIVE(8, int64_t, (int64_t)read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u64(ctx->data_buffer + ctx->cursor, (uint64_t)val, ctx->endianness));
-
-            case OP_IO_BOOL: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                if (ctx->cursor + 1 > ctx->data_len) {
-                    if (ctx->is_next_optional) {
-                        ctx->is_next_optional = false;
-                        uint8_t val = 0;
-                        SYNC_IP();
-                        if (ctx->io_callback(ctx, key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                        break;
-                    }
-                    return CND_ERR_OOB;
-                }
-                uint8_t val = 0;
-                if (ctx->mode == CND_MODE_ENCODE) {
-                    SYNC_IP();
-                    if (ctx->io_callback(ctx, key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                    if (val > 1) return CND_ERR_VALIDATION;
-                    write_u8(ctx->data_buffer + ctx->cursor, val);
-                } else {
-                    val = read_u8(ctx->data_buffer + ctx->cursor);
-                    if (val > 1) return CND_ERR_VALIDATION;
-                    SYNC_IP();
-                    if (ctx->io_callback(ctx, key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                }
-                ctx->cursor += 1;
-                ctx->is_next_optional = false;
-                break;
-            }
-
-            case OP_IO_F32: HANDLE_FLOAT(4, float, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, t, ctx->endianness));
-            case OP_IO_F64: HANDLE_FLOAT(8, double, uint64_t, read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u64(ctx->data_buffer + ctx->cursor, t, ctx->endianness));
-
-            // ... Category C (Bitfields) ...
-            case OP_IO_BIT_U: { uint16_t k=FETCH_IL_U16(ctx); uint8_t b=FETCH_IL_U8(ctx); uint64_t v=0; if(ctx->mode==CND_MODE_ENCODE){ SYNC_IP(); if(ctx->io_callback(ctx,k,opcode,&v)) return CND_ERR_CALLBACK; write_bits(ctx,v,b); } else { v=read_bits(ctx,b); SYNC_IP(); if(ctx->io_callback(ctx,k,opcode,&v)) return CND_ERR_CALLBACK; } break; } 
-            
-            case OP_ENTER_BIT_MODE: {
-                // No-op for now
-                break;
-            }
-
-            case OP_EXIT_BIT_MODE: {
-                if (ctx->bit_offset > 0) {
-                    return CND_ERR_VALIDATION; // Unaligned exit is not allowed
-                }
-                break;
-            }
-
-            case OP_ALIGN_FILL: {
-                uint8_t fill_bit = FETCH_IL_U8(ctx);
-                if (ctx->bit_offset > 0) {
-                    uint8_t bits_needed = 8 - ctx->bit_offset;
-                    uint64_t fill_val = (fill_bit ? 0xFFFFFFFFFFFFFFFF : 0);
-                    
-                    if (ctx->mode == CND_MODE_ENCODE) {
-                        write_bits(ctx, fill_val, bits_needed);
-                    } else {
-                        read_bits(ctx, bits_needed); // Discard
-                    }
-                }
-                break;
-            } 
-            case OP_IO_BIT_I: { 
-                uint16_t k=FETCH_IL_U16(ctx); 
-                uint8_t b=FETCH_IL_U8(ctx); 
-                int64_t v=0; 
-                if(ctx->mode==CND_MODE_ENCODE){ 
-                    SYNC_IP();
-                    if(ctx->io_callback(ctx,k,opcode,&v)) return CND_ERR_CALLBACK; 
-                    write_bits(ctx,(uint64_t)v,b); 
-                } else { 
-                    uint64_t raw = read_bits(ctx,b); 
-                    v = sign_extend(raw, b);
-                    SYNC_IP();
-                    if(ctx->io_callback(ctx,k,opcode,&v)) return CND_ERR_CALLBACK; 
-                } 
-                break; 
-            }
-            case OP_IO_BIT_BOOL: {
-                uint16_t k = FETCH_IL_U16(ctx);
-                uint8_t v = 0;
-                if (ctx->mode == CND_MODE_ENCODE) {
-                    SYNC_IP();
-                    if (ctx->io_callback(ctx, k, opcode, &v) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                    if (v > 1) return CND_ERR_VALIDATION;
-                    write_bits(ctx, (uint64_t)v, 1);
-                } else {
-                    uint64_t raw = read_bits(ctx, 1);
-                    v = (uint8_t)raw;
-                    SYNC_IP();
-                    if (ctx->io_callback(ctx, k, opcode, &v) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                }
-                break;
-            }
-            case OP_ALIGN_PAD: { 
-                uint8_t b=FETCH_IL_U8(ctx); 
-                if (ctx->mode == CND_MODE_ENCODE) {
-                    write_bits(ctx, 0, b);
-                } else {
-                    size_t total_bits = ctx->bit_offset + b;
-                    ctx->cursor += total_bits / 8;
-                    ctx->bit_offset = total_bits % 8;
-                }
-                break; 
-            } 
-
-            // ... Category D: Arrays & Strings ...
-            
-            case OP_STR_NULL: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                uint16_t max_len = FETCH_IL_U16(ctx);
-                const char* str = NULL;
-                // printf("VM_DEBUG: Calling callback for STR_NULL (Key %d)\n", key);
-                if (ctx->mode == CND_MODE_ENCODE) {
-                    SYNC_IP();
-                    if (ctx->io_callback(ctx, key, opcode, &str) != CND_ERR_OK) {
-                        if (ctx->is_next_optional) {
-                            ctx->is_next_optional = false;
-                            break; // Skip optional string
-                        }
-                        return CND_ERR_CALLBACK;
-                    }
-                    
-                    size_t len = str ? strlen(str) : 0;
-                    if (len > max_len) len = max_len;
-                    
-                    if (ctx->cursor + len + 1 > ctx->data_len) return CND_ERR_OOB;
-                    
-                    memcpy(ctx->data_buffer + ctx->cursor, str, len);
-                    ctx->cursor += len;
-                    ctx->data_buffer[ctx->cursor] = 0x00; // Null terminator
-                    ctx->cursor++;
-                } else {
-                    size_t start = ctx->cursor;
-                    size_t len = 0;
-                    
-                    // Optimization: Use memchr to find the null terminator quickly
-                    size_t remaining = ctx->data_len - ctx->cursor;
-                    size_t search_len = (remaining < max_len) ? remaining : max_len;
-                    
-                    void* found = memchr(ctx->data_buffer + ctx->cursor, 0x00, search_len);
-                    
-                    if (found) {
-                        len = (uint8_t*)found - (ctx->data_buffer + ctx->cursor);
-                        ctx->cursor += len;
-                    } else {
-                        len = search_len;
-                        ctx->cursor += len;
-                    }
-
-                    if (ctx->cursor >= ctx->data_len) return CND_ERR_OOB; 
-                    
-                    const char* ptr = (const char*)(ctx->data_buffer + start);
-                    SYNC_IP();
-                    if (ctx->io_callback(ctx, key, opcode, (void*)ptr) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                    
-                    ctx->cursor++; // Skip null
-                }
-                ctx->is_next_optional = false;
-                break;
-            }
-
-            case OP_STR_PRE_U8:  HANDLE_STRING_PRE(1, uint8_t,  read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, len_val));
-            case OP_STR_PRE_U16: HANDLE_STRING_PRE(2, uint16_t, read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, len_val, ctx->endianness));
-            case OP_STR_PRE_U32: HANDLE_STRING_PRE(4, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, len_val, ctx->endianness));
-
-            case OP_ARR_PRE_U8:  HANDLE_ARRAY_PRE(1, uint8_t,  read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, count));
-            case OP_ARR_PRE_U16: HANDLE_ARRAY_PRE(2, uint16_t, read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, count, ctx->endianness));
-            case OP_ARR_PRE_U32: HANDLE_ARRAY_PRE(4, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, count, ctx->endianness));
-
-            case OP_ARR_FIXED: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                uint32_t count = FETCH_IL_U32(ctx);
-                // printf("VM_DEBUG: Calling callback for ARR_FIXED (Key %d)\n", key);
-                if (ctx->mode == CND_MODE_ENCODE) {
-                     // Notify host about array start so it can push context
-                     // We should probably pass u32, but for now let's cast or ensure callback handles it.
-                     // The callback signature is (ctx, key, type, void*).
-                     // For ARR_FIXED, we pass pointer to count.
-                     SYNC_IP();
-                     if (ctx->io_callback(ctx, key, opcode, &count) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                } else {
-                     // Notify host about array start
-                     SYNC_IP();
-                     if (ctx->io_callback(ctx, key, opcode, &count) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                }
-
-                if (count > 0) {
-                    SYNC_IP();
-                    if (try_optimize_byte_array(ctx, count)) { RELOAD_PC(); break; }
-                    if (!loop_push(ctx, ctx->ip, count)) return CND_ERR_OOB;
-                } else {
-                     SYNC_IP();
-                     skip_loop_body(ctx);
-                     RELOAD_PC();
-                }
-                break;
-            }
 
-            case OP_ARR_EOF: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                (void)key; // Unused for now
-                
-                SYNC_IP();
-
-                if (ctx->loop_depth >= CND_MAX_LOOP_DEPTH) return CND_ERR_STACK_OVERFLOW;
-                cnd_loop_frame* frame = &ctx->loop_stack[ctx->loop_depth++];
-                frame->start_ip = ctx->ip;
-                frame->remaining = 0xFFFFFFFF; // Special value for EOF loop
-                
-                // Check if we are already at EOF
-                if (ctx->cursor >= ctx->data_len) {
-                    // Skip loop
-                    skip_loop_body(ctx);
-                    RELOAD_PC();
-                }
-                break;
-            }
-
-            case OP_ARR_DYNAMIC: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                uint16_t ref_key = FETCH_IL_U16(ctx);
-                
-                uint64_t count_val = 0;
-                SYNC_IP();
-                if (ctx->io_callback(ctx, ref_key, OP_CTX_QUERY, &count_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                // printf("VM_DEBUG: OpCtxQuery Key=%d returned %" PRIu64 "\n", ref_key, count_val);
-                
-                if (count_val > 0xFFFFFFFF) return CND_ERR_ARITHMETIC;
-                uint32_t count = (uint32_t)count_val;
-                
-                SYNC_IP();
-                if (ctx->io_callback(ctx, key, OP_ARR_DYNAMIC, &count) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                
-                if (count > 0) {
-                    if (try_optimize_byte_array(ctx, count)) { RELOAD_PC(); break; }
-                    if (!loop_push(ctx, ctx->ip, count)) return CND_ERR_OOB;
-                } else {
-                     skip_loop_body(ctx);
-                     RELOAD_PC();
-                }
-                break;
-            }
-
-            case OP_ARR_END: {
-                // printf("VM_DEBUG: Calling callback for ARR_END\n");
-                if (ctx->loop_depth == 0) return CND_ERR_INVALID_OP;
-                cnd_loop_frame* frame = &ctx->loop_stack[ctx->loop_depth - 1];
-                
-                bool loop_continue = false;
-                
-                if (frame->remaining == 0xFFFFFFFF) {
-                    // EOF Loop
-                    if (ctx->cursor < ctx->data_len) loop_continue = true;
-                } else {
-                    // Fixed/Prefixed Loop
-                    if (frame->remaining > 0) frame->remaining--;
-                    if (frame->remaining > 0) loop_continue = true;
-                }
-                
-                if (loop_continue) {
-                    ctx->ip = frame->start_ip;
-                    RELOAD_PC();
-                } else {
-                    // Loop finished, notify callback
-                    SYNC_IP();
-                    if (ctx->io_callback(ctx, 0, OP_ARR_END, NULL) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                    loop_pop(ctx);
-                }
-                break;
-            }
-
-            case OP_RAW_BYTES: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                uint32_t count = FETCH_IL_U32(ctx);
-                
-                if (ctx->cursor + count > ctx->data_len) return CND_ERR_OOB;
-                
-                // Callback receives/provides pointer to data in buffer
-                // For Encode: Callback writes TO this pointer
-                // For Decode: Callback reads FROM this pointer
-                // Since it's raw bytes, we just pass the pointer to the buffer.
-                void* ptr = ctx->data_buffer + ctx->cursor;
-                
-                SYNC_IP();
-                if (ctx->io_callback(ctx, key, opcode, ptr) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                
-                ctx->cursor += count;
-                break;
-            }
-
-            case OP_SWITCH: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                uint32_t table_rel_offset = FETCH_IL_U32(ctx);
-                
-                // IP is now at the start of the code block (immediately after SWITCH instruction)
-                SYNC_IP();
-                size_t code_start_ip = ctx->ip;
-                size_t table_start_ip = code_start_ip + table_rel_offset;
-                
-                if (table_start_ip > ctx->program->bytecode_len) return CND_ERR_OOB;
-                
-                // Jump to table to read it
-                size_t original_ip = ctx->ip;
-                ctx->ip = table_start_ip;
-                
-                uint16_t count = read_il_u16(ctx);
-                int32_t default_off = (int32_t)read_il_u32(ctx);
-                
-                uint64_t disc_val = 0;
-                if (ctx->io_callback(ctx, key, OP_CTX_QUERY, &disc_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                
-                int32_t target_off = default_off;
-                bool found = false;
-                
-                for (uint16_t i = 0; i < count; i++) {
-                    uint64_t case_val = read_il_u64(ctx);
-                    int32_t case_off = (int32_t)read_il_u32(ctx);
-                    
-                    if (!found && disc_val == case_val) {
-                        target_off = case_off;
-                        found = true;
-                    }
-                }
-                
-                // Target offset is relative to code_start_ip (original_ip)
-                ctx->ip = original_ip; // Restore just in case calculations need it, or just set new
-                
-                if (target_off < 0) {
-                     size_t abs_off = (size_t)(-(int64_t)target_off);
-                     if (code_start_ip < abs_off) return CND_ERR_OOB;
-                     ctx->ip = code_start_ip - abs_off;
-                } else {
-                     size_t abs_off = (size_t)target_off;
-                     if (code_start_ip + abs_off < code_start_ip) return CND_ERR_OOB;
-                     ctx->ip = code_start_ip + abs_off;
-                }
-                
-                if (ctx->ip > ctx->program->bytecode_len) return CND_ERR_OOB;
-                RELOAD_PC();
-                break;
-            }
-
-            case OP_SWITCH_TABLE: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                uint32_t table_rel_offset = FETCH_IL_U32(ctx);
-                
-                SYNC_IP();
-                size_t code_start_ip = ctx->ip;
-                size_t table_start_ip = code_start_ip + table_rel_offset;
-                
-                // Check if table start is valid and if we can read the header (20 bytes)
-                if (table_start_ip > ctx->program->bytecode_len || 
-                    table_start_ip + 20 > ctx->program->bytecode_len) return CND_ERR_OOB;
-                
-                // Jump to table
-                size_t original_ip = ctx->ip;
-                ctx->ip = table_start_ip;
-                
-                uint64_t min_val = read_il_u64(ctx);
-                uint64_t max_val = read_il_u64(ctx);
-                int32_t default_off = (int32_t)read_il_u32(ctx);
-                
-                uint64_t disc_val = 0;
-                if (ctx->io_callback(ctx, key, OP_CTX_QUERY, &disc_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                
-                int32_t target_off = default_off;
-                
-                if (disc_val >= min_val && disc_val <= max_val) {
-                    uint64_t index = disc_val - min_val;
-                    // Offset is at table_start + 8 + 8 + 4 + index * 4
-                    // We are currently at table_start + 20 (ctx->ip)
-                    size_t offset_loc = ctx->ip + (size_t)(index * 4);
-                    
-                    // Check bounds for the offset entry
-                    if (offset_loc + 4 > ctx->program->bytecode_len) return CND_ERR_OOB;
-                    
-                    target_off = (int32_t)peek_il_u32(ctx, offset_loc);
-                }
-                
-                ctx->ip = original_ip;
-                
-                if (target_off < 0) {
-                     size_t abs_off = (size_t)(-(int64_t)target_off);
-                     if (code_start_ip < abs_off) return CND_ERR_OOB;
-                     ctx->ip = code_start_ip - abs_off;
-                } else {
-                     size_t abs_off = (size_t)target_off;
-                     if (code_start_ip + abs_off < code_start_ip) return CND_ERR_OOB;
-                     ctx->ip = code_start_ip + abs_off;
-                }
-                
-                if (ctx->ip > ctx->program->bytecode_len) return CND_ERR_OOB;
-                RELOAD_PC();
-                break;
-            }
-
-            case OP_JUMP_IF_NOT: {
-                int32_t offset = (int32_t)FETCH_IL_U32(ctx);
-                uint64_t condition;
-                if (stack_pop(ctx, &condition) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                
-                if (condition == 0) {
-                    // Jump
-                    SYNC_IP();
-                    if (offset < 0) {
-                        size_t abs_off = (size_t)(-(int64_t)offset);
-                        if (ctx->ip < abs_off) return CND_ERR_OOB;
-                        ctx->ip -= abs_off;
-                    } else {
-                        size_t abs_off = (size_t)offset;
-                        if (ctx->ip + abs_off < ctx->ip) return CND_ERR_OOB;
-                        ctx->ip += abs_off;
-                    }
-                    if (ctx->ip > ctx->program->bytecode_len) return CND_ERR_OOB;
-                    RELOAD_PC();
-                }
-                break;
-            }
-
-            case OP_JUMP: {
-                int32_t offset = (int32_t)FETCH_IL_U32(ctx);
-                // Offset is relative to IP *after* reading the offset (which is current ctx->ip)
-                SYNC_IP();
-                if (offset < 0) {
-                    size_t abs_off = (size_t)(-(int64_t)offset);
-                    if (ctx->ip < abs_off) return CND_ERR_OOB;
-                    ctx->ip -= abs_off;
-                } else {
-                    size_t abs_off = (size_t)offset;
-                    if (ctx->ip + abs_off < ctx->ip) return CND_ERR_OOB;
-                    ctx->ip += abs_off;
-                }
-                if (ctx->ip > ctx->program->bytecode_len) return CND_ERR_OOB;
-                RELOAD_PC();
-                break;
-            }
-
-            // --- Category G: Expression Stack & ALU ---
-
-            case OP_LOAD_CTX: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                uint64_t val = 0;
-                SYNC_IP();
-                if (ctx->io_callback(ctx, key, OP_LOAD_CTX, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                if (stack_push(ctx, val) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break;
-            }
+#undef FETCH_IL_U8
+#undef FETCH_IL_U16
+#undef FETCH_KEY
+#undef FETCH_IL_U32
+#undef FETCH_IL_U64
+#undef SYNC_IP
+#undef RELOAD_PC
+#undef TRY_BULK_ARRAY
+#undef SKIP_LOOP
+
+typedef cnd_error_t (*vm_loop_fn)(cnd_vm_ctx* ctx);
+
+// Indexed by [bound][encode]
+static const vm_loop_fn VM_SWITCH_LOOPS[2][2] = {
+    { vm_exec_switch_decode, vm_exec_switch_encode },
+    { vm_exec_switch_decode_bound, vm_exec_switch_encode_bound },
+};
 
-            case OP_STORE_CTX: {
-                uint16_t key = FETCH_IL_U16(ctx);
-                uint64_t val;
-                if (stack_pop(ctx, &val) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                SYNC_IP();
-                if (ctx->io_callback(ctx, key, OP_STORE_CTX, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
-                break;
-            }
+#if VM_HAVE_THREADED_DISPATCH
+static const vm_loop_fn VM_THREADED_LOOPS[2][2] = {
+    { vm_exec_threaded_decode, vm_exec_threaded_encode },
+    { vm_exec_threaded_decode_bound, vm_exec_threaded_encode_bound },
+};
+#endif
 
-            case OP_PUSH_IMM: {
-                uint64_t val = FETCH_IL_U64(ctx);
-                if (stack_push(ctx, val) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break;
-            }
+// Sampled once per run; callbacks must not change ctx->mode mid-run
+static vm_loop_fn vm_select_loop(const cnd_vm_ctx* ctx, cnd_dispatch_t dispatch) {
+    int encode = (ctx->mode == CND_MODE_ENCODE);
+    int bound = (ctx->io_callback == cnd_bind_io && ctx->user_ptr != NULL);
+
+    switch (dispatch) {
+        case CND_DISPATCH_SWITCH:
+            return VM_SWITCH_LOOPS[bound][encode];
+        case CND_DISPATCH_THREADED:
+#if VM_HAVE_THREADED_DISPATCH
+            return VM_THREADED_LOOPS[bound][encode];
+#else
+            return NULL;
+#endif
+        case CND_DISPATCH_AUTO:
+#if VM_HAVE_THREADED_DISPATCH
+            return VM_THREADED_LOOPS[bound][encode];
+#else
+            return VM_SWITCH_LOOPS[bound][encode];
+#endif
+        default:
+            return NULL;
+    }
+}
 
-            case OP_POP: {
-                uint64_t val;
-                if (stack_pop(ctx, &val) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                break;
-            }
+// Streaming decode. The pending byte array comes first; an instruction that
+// then runs out of input is rolled back to its mark (vm_exec_loop.h), leaving
+// ctx->ip on it for the next chunk. Nothing it did before failing outlives
+// the rollback: reads check the buffer before they call the host.
+static cnd_error_t vm_exec_stream(cnd_vm_ctx* ctx) {
+    cnd_error_t err = vm_stream_span_resume(ctx);
+    if (err != CND_ERR_OK) return err;
+    err = vm_exec_switch_decode_stream(ctx);
+    if (err != CND_ERR_OOB || !vm_stream_open(ctx)) return err;
+    ctx->ip = ctx->mark_ip;
+    ctx->cursor = ctx->mark_cursor;
+    ctx->bit_offset = ctx->mark_bit_offset;
+    ctx->expr_sp = ctx->mark_expr_sp;
+    return CND_ERR_NEED_MORE;
+}
 
-            case OP_DUP: {
-                if (ctx->expr_sp == 0) return CND_ERR_STACK_UNDERFLOW;
-                uint64_t val = ctx->expr_stack[ctx->expr_sp - 1];
-                if (stack_push(ctx, val) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break;
-            }
+cnd_error_t cnd_execute_dispatch(cnd_vm_ctx* ctx, cnd_dispatch_t dispatch) {
+    if (!ctx || !ctx->program || !ctx->program->bytecode || !ctx->data_buffer) return CND_ERR_OOB;
 
-            case OP_EMIT: {
-                uint8_t type = FETCH_IL_U8(ctx);
-                uint64_t val;
-                if (stack_pop(ctx, &val) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                
-                if (ctx->mode == CND_MODE_ENCODE) {
-                    int size = 0;
-                    if (type == OP_IO_U8 || type == OP_IO_I8 || type == OP_IO_BOOL) size = 1;
-                    else if (type == OP_IO_U16 || type == OP_IO_I16) size = 2;
-                    else if (type == OP_IO_U32 || type == OP_IO_I32 || type == OP_IO_F32) size = 4;
-                    else if (type == OP_IO_U64 || type == OP_IO_I64 || type == OP_IO_F64) size = 8;
-                    else return CND_ERR_INVALID_OP;
-                    
-                    if (ctx->cursor + size > ctx->data_len) return CND_ERR_OOB;
-                    
-                    if (type == OP_IO_F32) {
-                        double d; memcpy(&d, &val, 8);
-                        float f = (float)d;
-                        uint32_t f_bits; memcpy(&f_bits, &f, 4);
-                        write_u32(ctx->data_buffer + ctx->cursor, f_bits, ctx->endianness);
-                    } else if (size == 1) write_u8(ctx->data_buffer + ctx->cursor, (uint8_t)val);
-                    else if (size == 2) write_u16(ctx->data_buffer + ctx->cursor, (uint16_t)val, ctx->endianness);
-                    else if (size == 4) write_u32(ctx->data_buffer + ctx->cursor, (uint32_t)val, ctx->endianness);
-                    else if (size == 8) write_u64(ctx->data_buffer + ctx->cursor, val, ctx->endianness);
-                    
-                    ctx->cursor += size;
-                } else {
-                    // In Decode mode, OP_EMIT might be used to push a calculated value to the JSON output?
-                    // If so, we need to call the callback.
-                    // But we don't have a key here. OP_EMIT is just "write to stream".
-                    // Wait, if we are decoding, we read from stream.
-                    // But @expr fields are calculated, not read.
-                    // So in Decode mode, we shouldn't be reading from stream for @expr fields?
-                    // If @expr is used, it means "Calculate this".
-                    // If the field exists in the binary, we should read it and compare? Or just read it?
-                    // Usually @expr(x) means "The value of this field is x".
-                    // If it's in the packet definition, it usually implies it's present in the binary.
-                    // If it's present in binary, we should read it.
-                    // But if we calculate it, do we verify it matches the binary?
-                    // Or do we ignore the binary and use the calculated value?
-                    
-                    // If the user writes:
-                    // @expr(len(x)) uint16 length;
-                    // In Encode: Calculate len(x), write to binary.
-                    // In Decode: Read from binary. (And maybe verify it matches len(x)?)
-                    
-                    // If I use OP_EMIT for Encode, what do I use for Decode?
-                    // For Decode, I should use OP_IO_... to read it.
-                    
-                    // So the parser needs to emit different code for Encode vs Decode?
-                    // The VM bytecode is the same for both.
-                    // So the bytecode must handle both.
-                    
-                    // If I use OP_EMIT, it only works for Encode (writing).
-                    // In Decode, we want to READ.
-                    
-                    // So OP_EMIT should be:
-                    // Encode: Pop val, Write val.
-                    // Decode: Read val, Push val? Or just Read val and discard?
-                    // If we want to verify, we need to compare popped val with read val.
-                    
-                    // Let's assume for now OP_EMIT is "Write Stack to Binary" (Encode) and "Read Binary to Stack" (Decode)?
-                    // If Decode:
-                    //   Read val from binary.
-                    //   Pop expected val from stack (calculated).
-                    //   Compare?
-                    
-                    // If I implement it as:
-                    // Encode: Write(pop())
-                    // Decode: Read() -> push() ? No, that's OP_IO.
-                    
-                    // If the field is @expr(calc), then:
-                    // Encode: val = calc(); write(val);
-                    // Decode: val_bin = read(); val_calc = calc(); if (val_bin != val_calc) error;
-                    
-                    // So:
-                    // 1. Calculate value (pushes to stack).
-                    // 2. OP_EMIT (type)
-                    //    Encode: val = pop(); write(val);
-                    //    Decode: val_calc = pop(); val_bin = read(); if (val_bin != val_calc) error;
-                    
-                    int size = 0;
-                    if (type == OP_IO_U8 || type == OP_IO_I8 || type == OP_IO_BOOL) size = 1;
-                    else if (type == OP_IO_U16 || type == OP_IO_I16) size = 2;
-                    else if (type == OP_IO_U32 || type == OP_IO_I32 || type == OP_IO_F32) size = 4;
-                    else if (type == OP_IO_U64 || type == OP_IO_I64 || type == OP_IO_F64) size = 8;
-                    else return CND_ERR_INVALID_OP;
-                    
-                    if (ctx->cursor + size > ctx->data_len) return CND_ERR_OOB;
-                    
-                    uint64_t bin_val = 0;
-                    if (size == 1) bin_val = read_u8(ctx->data_buffer + ctx->cursor);
-                    else if (size == 2) bin_val = read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness);
-                    else if (size == 4) bin_val = read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness);
-                    else if (size == 8) bin_val = read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness);
-                    
-                    // Compare
-                    if (type == OP_IO_F32) {
-                        double d_val; memcpy(&d_val, &val, 8);
-                        float f_val = (float)d_val;
-                        
-                        float f_bin; memcpy(&f_bin, &bin_val, 4);
-                        
-                        float diff = f_val - f_bin;
-                        if (diff < -0.00001f || diff > 0.00001f) return CND_ERR_VALIDATION;
-                    } else if (type == OP_IO_F64) {
-                        double d_val; memcpy(&d_val, &val, 8);
-                        double d_bin; memcpy(&d_bin, &bin_val, 8);
-                        
-                        double diff = d_val - d_bin;
-                        if (diff < -0.0000001 || diff > 0.0000001) return CND_ERR_VALIDATION;
-                    } else {
-                        if (bin_val != val) return CND_ERR_VALIDATION;
-                    }
-                    
-                    ctx->cursor += size;
-                }
-                break;
-            }
+    if (ctx->flags & CND_CTX_STREAM) {
+        if (ctx->mode != CND_MODE_DECODE) return CND_ERR_INVALID_OP;
+        return vm_exec_stream(ctx);
+    }
 
-            // Arithmetic (Integer)
-            case OP_ADD: { BINARY_OP(+); break; }
-            case OP_SUB: { BINARY_OP(-); break; }
-            case OP_MUL: { BINARY_OP(*); break; }
-            case OP_DIV: { 
-                uint64_t b; if (stack_pop(ctx, &b) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                uint64_t a; if (stack_pop(ctx, &a) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                if (b == 0) return CND_ERR_ARITHMETIC;
-                if (stack_push(ctx, a / b) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break; 
-            }
-            case OP_MOD: { 
-                uint64_t b; if (stack_pop(ctx, &b) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                uint64_t a; if (stack_pop(ctx, &a) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                if (b == 0) return CND_ERR_ARITHMETIC;
-                if (stack_push(ctx, a % b) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break; 
-            }
-            case OP_NEG: {
-                uint64_t a;
-                if (stack_pop(ctx, &a) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                // Cast to signed to avoid C4146 (unary minus on unsigned)
-                if (stack_push(ctx, (uint64_t)(-(int64_t)a)) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break;
-            }
+    vm_loop_fn loop = vm_select_loop(ctx, dispatch);
+    if (!loop) return CND_ERR_INVALID_OP;
+    return loop(ctx);
+}
 
-            // Arithmetic (Float)
-            case OP_FADD: { BINARY_OP_F(+); break; }
-            case OP_FSUB: { BINARY_OP_F(-); break; }
-            case OP_FMUL: { BINARY_OP_F(*); break; }
-            case OP_FDIV: { 
-                uint64_t b_bits; if (stack_pop(ctx, &b_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                uint64_t a_bits; if (stack_pop(ctx, &a_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                double a, b; memcpy(&a, &a_bits, 8); memcpy(&b, &b_bits, 8);
-                if (b == 0.0) return CND_ERR_ARITHMETIC;
-                double res = a / b;
-                uint64_t res_bits; memcpy(&res_bits, &res, 8);
-                if (stack_push(ctx, res_bits) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break; 
-            }
-            case OP_FNEG: { UNARY_OP_F(-); break; }
+cnd_error_t cnd_execute(cnd_vm_ctx* ctx) {
+    return cnd_execute_dispatch(ctx, CND_DISPATCH_AUTO);
+}
 
-            // Math Functions
-#ifndef CND_NO_MATH
-            case OP_SIN:  { UNARY_OP_F(sin); break; }
-            case OP_COS:  { UNARY_OP_F(cos); break; }
-            case OP_TAN:  { UNARY_OP_F(tan); break; }
-            case OP_SQRT: { 
-                uint64_t a_bits; if (stack_pop(ctx, &a_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                double a; memcpy(&a, &a_bits, 8);
-                if (a < 0) return CND_ERR_ARITHMETIC;
-                double res = sqrt(a);
-                uint64_t res_bits; memcpy(&res_bits, &res, 8);
-                if (stack_push(ctx, res_bits) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break; 
-            }
-            case OP_LOG:  { 
-                uint64_t a_bits; if (stack_pop(ctx, &a_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                double a; memcpy(&a, &a_bits, 8);
-                if (a <= 0) return CND_ERR_ARITHMETIC;
-                double res = log(a);
-                uint64_t res_bits; memcpy(&res_bits, &res, 8);
-                if (stack_push(ctx, res_bits) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break; 
-            }
-            case OP_ABS:  { UNARY_OP_F(fabs); break; }
-            case OP_POW: {
-                uint64_t b_bits; if (stack_pop(ctx, &b_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                uint64_t a_bits; if (stack_pop(ctx, &a_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                double a, b; memcpy(&a, &a_bits, 8); memcpy(&b, &b_bits, 8);
-                
-                if (a < 0 && floor(b) != b) return CND_ERR_ARITHMETIC;
-                if (a == 0 && b <= 0) return CND_ERR_ARITHMETIC;
+// --- Batch Execution ---
 
-                double res = pow(a, b);
-                uint64_t res_bits; memcpy(&res_bits, &res, 8);
-                if (stack_push(ctx, res_bits) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break;
-            }
+#if defined(__GNUC__)
+#define VM_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define VM_PREFETCH(p) ((void)(p))
 #endif
 
-            // Conversion
-            case OP_ITOF: {
-                uint64_t a; if (stack_pop(ctx, &a) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                double f = (double)(int64_t)a;
-                uint64_t res; memcpy(&res, &f, 8);
-                if (stack_push(ctx, res) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break;
-            }
-            case OP_FTOI: {
-                uint64_t a_bits; if (stack_pop(ctx, &a_bits) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
-                double f; memcpy(&f, &a_bits, 8);
-                int64_t i = (int64_t)f;
-                if (stack_push(ctx, (uint64_t)i) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
-                break;
-            }
+static uint8_t* batch_packet(const cnd_batch* batch, size_t i) {
+    if (batch->base) return batch->base + batch->offsets[i];
+    return batch->buffers[i];
+}
 
-            // Comparison (Float)
-            case OP_EQ_F:  { BINARY_OP_F_BOOL(==); break; }
-            case OP_NEQ_F: { BINARY_OP_F_BOOL(!=); break; }
-            case OP_GT_F:  { BINARY_OP_F_BOOL(>); break; }
-            case OP_LT_F:  { BINARY_OP_F_BOOL(<); break; }
-            case OP_GTE_F: { BINARY_OP_F_BOOL(>=); break; }
-            case OP_LTE_F: { BINARY_OP_F_BOOL(<=); break; }
+cnd_error_t cnd_execute_batch(cnd_vm_ctx* ctx, const cnd_batch* batch,
+                              cnd_error_t* errors, size_t* used) {
+    if (!ctx || !ctx->program || !ctx->program->bytecode || !batch || !batch->lengths) return CND_ERR_OOB;
+    if (batch->base ? !batch->offsets : !batch->buffers) return CND_ERR_OOB;
+
+    vm_loop_fn loop = vm_select_loop(ctx, CND_DISPATCH_AUTO);
+
+    // Bound runs rewind the binder to its root frame before every packet,
+    // and hand it back pointing at the first record when the batch is done
+    cnd_binder* binder = NULL;
+    uint8_t* host = NULL;
+    uint8_t depth = 0;
+    if (ctx->io_callback == cnd_bind_io && ctx->user_ptr != NULL) {
+        binder = (cnd_binder*)ctx->user_ptr;
+        if (binder->depth == 0) return CND_ERR_VALIDATION;
+        host = binder->frames[0].base;
+        depth = binder->depth;
+    }
+    size_t batch_index = ctx->batch_index;
 
-            // Bitwise
-            case OP_BIT_AND: { BINARY_OP(&); break; }
-            case OP_BIT_OR:  { BINARY_OP(|); break; }
-            case OP_BIT_XOR: { BINARY_OP(^); break; }
-            case OP_BIT_NOT: { UNARY_OP(~); break; }
-            case OP_SHL:     { BINARY_OP(<<); break; }
-            case OP_SHR:     { BINARY_OP(>>); break; }
+    cnd_error_t first = CND_ERR_OK;
+    uint8_t* next = (batch->count > 0) ? batch_packet(batch, 0) : NULL;
 
-            // Comparison
-            case OP_EQ:  { BINARY_OP(==); break; }
-            case OP_NEQ: { BINARY_OP(!=); break; }
-            case OP_GT:  { BINARY_OP(>); break; }
-            case OP_LT:  { BINARY_OP(<); break; }
-            case OP_GTE: { BINARY_OP(>=); break; }
-            case OP_LTE: { BINARY_OP(<=); break; }
+    for (size_t i = 0; i < batch->count; i++) {
+        uint8_t* data = next;
+        size_t len = batch->lengths[i];
 
-            // Logical
-            case OP_LOG_AND: { BINARY_OP(&&); break; }
-            case OP_LOG_OR:  { BINARY_OP(||); break; }
-            case OP_LOG_NOT: { UNARY_OP(!); break; }
+        // Start pulling in the next packet while this one runs
+        if (i + 1 < batch->count) {
+            next = batch_packet(batch, i + 1);
+            if (next) VM_PREFETCH(next);
+        }
 
-            default:
-                break;
+        cnd_error_t err;
+        if (!data) {
+            ctx->cursor = 0;
+            err = CND_ERR_OOB;
+        } else {
+            ctx->data_buffer = data;
+            ctx->data_len = len;
+            ctx->batch_index = i;
+            vm_reset_run(ctx);
+            if (binder) {
+                binder->depth = 1;
+                binder->frames[0].base = host + i * batch->host_stride;
+            }
+            err = loop(ctx);
         }
+
+        if (errors) errors[i] = err;
+        if (used) used[i] = ctx->cursor;
+        if (err != CND_ERR_OK && first == CND_ERR_OK) first = err;
     }
-    
-    // fprintf(stderr, "VM_DEBUG: Execution finished. Cursor=%zu, DataLen=%zu. Returning OK.\n", ctx->cursor, ctx->data_len);
-    return CND_ERR_OK;
+
+    ctx->batch_index = batch_index;
+    if (binder) {
+        binder->frames[0].base = host;
+        binder->depth = depth;
+    }
+    return first;
 }
 
 const char* cnd_error_string(cnd_error_t err) {
@@ -1686,6 +446,7 @@ const char* cnd_error_string(cnd_error_t err) {
         case CND_ERR_STACK_UNDERFLOW: return "Stack Underflow";
         case CND_ERR_CRC_MISMATCH: return "CRC Mismatch";
         case CND_ERR_ARITHMETIC: return "Arithmetic Error";
+        case CND_ERR_NEED_MORE: return "Need More Input";
         default: return "Unknown Error";
     }
 }
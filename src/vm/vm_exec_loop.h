@@ -0,0 +1,1160 @@
+// Bytecode interpreter loop, instantiated by vm_exec.c.
+//
+// This file is included once per dispatch strategy and mode and therefore
+// has no include guard. The includer defines:
+//   VM_LOOP_FN   - name of the generated function
+//   VM_THREADED  - 1 for computed-goto dispatch, 0 for a switch
+//   VM_ENCODING  - 1 for the encode loop, 0 for the decode loop
+//   VM_BOUND     - 1 to serve fields from a cnd_binder (ctx->user_ptr)
+//                  instead of calling ctx->io_callback
+// and optionally
+//   VM_STREAM    - 1 to mark where each instruction starts (ctx->mark_*) so
+//                  a streaming decode can undo one that runs out of input;
+//                  switch loops only
+// and #undef's them at the end.
+//
+// Every handler is written as VM_CASE(op) ... VM_END. A `break` inside a
+// handler leaves the handler; VM_END then either returns to the switch loop
+// or jumps straight to the next handler through the label table, so each
+// handler carries its own indirect branch in threaded mode.
+//
+// Functions are only instantiated per dispatch strategy, mode, binding and
+// streaming; the byte order and a pending transform are instead part of the
+// dispatch within one function, so that plain primitive handlers test
+// neither. The threaded loop keeps them in its choice of label table:
+// vm_labels_be routes multi-byte primitives to big-endian handlers and
+// vm_labels_trans routes primitives to the transform handlers. The switch
+// loops (including the bound and stream ones) fold the same state into the
+// case value instead: vm_sel is VM_SEL_BE or VM_SEL_TR, and vm_sel_mask
+// limits it to the opcodes that have such a case. VM_RETABLE() re-derives
+// the table or vm_sel after any handler that changes that state.
+
+#ifndef VM_STREAM
+#define VM_STREAM 0
+#endif
+
+#define VM_BUF (ctx->data_buffer + ctx->cursor)
+
+#if VM_BOUND
+#define VM_CALLBACK(key, op, ptr) vm_bind_event(ctx, (key), (op), (ptr))
+#define VM_CALLBACK_SCALAR(key, op, ptr) vm_bind_scalar(ctx, (key), (op), (ptr), sizeof(*(ptr)), VM_ENCODING)
+#else
+#define VM_CALLBACK(key, op, ptr) ctx->io_callback(ctx, (key), (op), (ptr))
+#define VM_CALLBACK_SCALAR(key, op, ptr) VM_CALLBACK(key, op, ptr)
+#endif
+
+// Context reads take the value from the scoreboard when it has the key
+#define VM_CTX_VALUE(key, op, ptr) (vm_slot_get(ctx, (key), (ptr)) ? CND_ERR_OK : VM_CALLBACK(key, op, ptr))
+
+// Primitives with a big-endian handler
+#define VM_IO_ENDIAN_LABELS(X) \
+    X(OP_IO_U16) X(OP_IO_U32) X(OP_IO_U64) \
+    X(OP_IO_I16) X(OP_IO_I32) X(OP_IO_I64) \
+    X(OP_IO_F32) X(OP_IO_F64)
+
+#if VM_THREADED
+#define VM_CASE(op) L_##op: do {
+#define VM_DEFAULT L_default: do {
+#define VM_NEXT() do { \
+        if (pc >= end) goto vm_done; \
+        opcode = *pc++; \
+        goto *vm_table[opcode]; \
+    } while (0)
+#define VM_END } while (0); VM_NEXT();
+#define VM_RETABLE() (vm_table = ctx->trans_type != CND_TRANS_NONE ? vm_labels_trans : \
+                      ctx->endianness == CND_BE ? vm_labels_be : vm_labels)
+
+#define VM_LABEL(op) [op] = &&L_##op,
+#define VM_LABEL_BE(op) [op] = &&L_BE_##op,
+#define VM_LABEL_TR(op) [op] = &&L_TR_##op,
+
+#define VM_OP_LABELS(X) \
+    X(OP_NOOP) \
+    X(OP_SET_ENDIAN_LE) \
+    X(OP_SET_ENDIAN_BE) \
+    X(OP_ENTER_STRUCT) \
+    X(OP_EXIT_STRUCT) \
+    X(OP_META_VERSION) \
+    X(OP_META_NAME) \
+    X(OP_CONST_WRITE) \
+    X(OP_CONST_CHECK) \
+    X(OP_ENUM_CHECK) \
+    X(OP_ENUM_BITMAP) \
+    X(OP_ENUM_SORTED) \
+    X(OP_RANGE_CHECK) \
+    X(OP_CRC_16) \
+    X(OP_CRC_32) \
+    X(OP_CRC_BEGIN) \
+    X(OP_CRC_END) \
+    X(OP_SCALE_LIN) \
+    X(OP_TRANS_POLY) \
+    X(OP_TRANS_SPLINE) \
+    X(OP_MARK_OPTIONAL) \
+    X(OP_TRANS_ADD) \
+    X(OP_TRANS_SUB) \
+    X(OP_TRANS_MUL) \
+    X(OP_TRANS_DIV) \
+    X(OP_IO_U8) \
+    X(OP_IO_U16) \
+    X(OP_IO_U32) \
+    X(OP_IO_U64) \
+    X(OP_IO_I8) \
+    X(OP_IO_I16) \
+    X(OP_IO_I32) \
+    X(OP_IO_I64) \
+    X(OP_IO_BOOL) \
+    X(OP_IO_RUN) \
+    X(OP_IO_CHECK) \
+    X(OP_IO_SLOT) \
+    X(OP_IO_F32) \
+    X(OP_IO_F64) \
+    X(OP_IO_BIT_U) \
+    X(OP_ENTER_BIT_MODE) \
+    X(OP_EXIT_BIT_MODE) \
+    X(OP_ALIGN_FILL) \
+    X(OP_IO_BIT_I) \
+    X(OP_IO_BIT_BOOL) \
+    X(OP_IO_BIT_GROUP) \
+    X(OP_ALIGN_PAD) \
+    X(OP_STR_NULL) \
+    X(OP_STR_PRE_U8) \
+    X(OP_STR_PRE_U16) \
+    X(OP_STR_PRE_U32) \
+    X(OP_ARR_PRE_U8) \
+    X(OP_ARR_PRE_U16) \
+    X(OP_ARR_PRE_U32) \
+    X(OP_ARR_FIXED) \
+    X(OP_ARR_EOF) \
+    X(OP_ARR_DYNAMIC) \
+    X(OP_ARR_END) \
+    X(OP_RAW_BYTES) \
+    X(OP_SWITCH) \
+    X(OP_SWITCH_TABLE) \
+    X(OP_SWITCH_SORTED) \
+    X(OP_SWITCH_HASH) \
+    X(OP_JUMP_IF_NOT) \
+    X(OP_JUMP) \
+    X(OP_CALL) \
+    X(OP_RET) \
+    X(OP_LOAD_CTX) \
+    X(OP_STORE_CTX) \
+    X(OP_PUSH_IMM) \
+    X(OP_POP) \
+    X(OP_SWAP) \
+    X(OP_DUP) \
+    X(OP_EMIT) \
+    X(OP_EXPR)
+
+// Single-byte primitives: plain and transform handlers
+#define VM_IO_BYTE(op, ctype) \
+    L_##op: do HANDLE_PRIMITIVE_PLAIN(1, ctype, (ctype)read_u8(VM_BUF), write_u8(VM_BUF, (uint8_t)val)) while (0); \
+    VM_NEXT(); \
+    L_TR_##op: do HANDLE_PRIMITIVE_TRANSFORM(1, ctype, (ctype)read_u8(VM_BUF), write_u8(VM_BUF, (uint8_t)val)) while (0); \
+    VM_RETABLE(); \
+    VM_NEXT();
+
+// Multi-byte integers: little-endian, big-endian and transform handlers
+#define VM_IO_INT(op, size, ctype, ut, RD, WR) \
+    L_##op: do HANDLE_PRIMITIVE_PLAIN(size, ctype, (ctype)RD(VM_BUF, CND_LE), WR(VM_BUF, (ut)val, CND_LE)) while (0); \
+    VM_NEXT(); \
+    L_BE_##op: do HANDLE_PRIMITIVE_PLAIN(size, ctype, (ctype)RD(VM_BUF, CND_BE), WR(VM_BUF, (ut)val, CND_BE)) while (0); \
+    VM_NEXT(); \
+    L_TR_##op: do HANDLE_PRIMITIVE_TRANSFORM(size, ctype, (ctype)RD(VM_BUF, ctx->endianness), WR(VM_BUF, (ut)val, ctx->endianness)) while (0); \
+    VM_RETABLE(); \
+    VM_NEXT();
+
+#define VM_IO_FLOAT(op, size, ctype, int_t, RD, WR) \
+    L_##op: do HANDLE_FLOAT_PLAIN(size, ctype, int_t, RD(VM_BUF, CND_LE), WR(VM_BUF, t, CND_LE)) while (0); \
+    VM_NEXT(); \
+    L_BE_##op: do HANDLE_FLOAT_PLAIN(size, ctype, int_t, RD(VM_BUF, CND_BE), WR(VM_BUF, t, CND_BE)) while (0); \
+    VM_NEXT(); \
+    L_TR_##op: do HANDLE_FLOAT_TRANSFORM(size, ctype, int_t, RD(VM_BUF, ctx->endianness), WR(VM_BUF, t, ctx->endianness)) while (0); \
+    VM_RETABLE(); \
+    VM_NEXT();
+#else
+#define VM_CASE(op) case op: do {
+#define VM_DEFAULT default: do {
+#define VM_END } while (0); break;
+#define VM_SEL_BE 0x100u
+#define VM_SEL_TR 0x200u
+#define VM_RETABLE() (vm_sel = ctx->trans_type != CND_TRANS_NONE ? VM_SEL_TR : \
+                      ctx->endianness == CND_BE ? VM_SEL_BE : 0)
+
+#define VM_SEL_MASK(op) [op] = VM_SEL_BE | VM_SEL_TR,
+
+// Single-byte primitives: plain and transform cases
+#define VM_IO_BYTE(op, ctype) \
+    case op: do HANDLE_PRIMITIVE_PLAIN(1, ctype, (ctype)read_u8(VM_BUF), write_u8(VM_BUF, (uint8_t)val)) while (0); break; \
+    case op | VM_SEL_TR: do HANDLE_PRIMITIVE_TRANSFORM(1, ctype, (ctype)read_u8(VM_BUF), write_u8(VM_BUF, (uint8_t)val)) while (0); \
+    VM_RETABLE(); \
+    break;
+
+// Multi-byte integers: little-endian, big-endian and transform cases
+#define VM_IO_INT(op, size, ctype, ut, RD, WR) \
+    case op: do HANDLE_PRIMITIVE_PLAIN(size, ctype, (ctype)RD(VM_BUF, CND_LE), WR(VM_BUF, (ut)val, CND_LE)) while (0); break; \
+    case op | VM_SEL_BE: do HANDLE_PRIMITIVE_PLAIN(size, ctype, (ctype)RD(VM_BUF, CND_BE), WR(VM_BUF, (ut)val, CND_BE)) while (0); break; \
+    case op | VM_SEL_TR: do HANDLE_PRIMITIVE_TRANSFORM(size, ctype, (ctype)RD(VM_BUF, ctx->endianness), WR(VM_BUF, (ut)val, ctx->endianness)) while (0); \
+    VM_RETABLE(); \
+    break;
+
+#define VM_IO_FLOAT(op, size, ctype, int_t, RD, WR) \
+    case op: do HANDLE_FLOAT_PLAIN(size, ctype, int_t, RD(VM_BUF, CND_LE), WR(VM_BUF, t, CND_LE)) while (0); break; \
+    case op | VM_SEL_BE: do HANDLE_FLOAT_PLAIN(size, ctype, int_t, RD(VM_BUF, CND_BE), WR(VM_BUF, t, CND_BE)) while (0); break; \
+    case op | VM_SEL_TR: do HANDLE_FLOAT_TRANSFORM(size, ctype, int_t, RD(VM_BUF, ctx->endianness), WR(VM_BUF, t, ctx->endianness)) while (0); \
+    VM_RETABLE(); \
+    break;
+#endif
+
+// Fields of OP_IO_RUN and OP_IO_CHECK. The handler has checked the buffer for
+// all of them and no transform or @optional is pending, so a field is just
+// the transfer and its event. `limit` only guards against a run whose Bytes
+// does not match its fields in unverified bytecode.
+#define VM_FIELD_SCALAR_BODY(op, ctype, READ_EXPR, WRITE_EXPR) { \
+        ctype val = 0; \
+        if (ctx->cursor + sizeof(ctype) > limit) return CND_ERR_INVALID_OP; \
+        if (VM_ENCODING) { \
+            if (VM_CALLBACK_SCALAR(key, op, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+            WRITE_EXPR; \
+        } else { \
+            val = (ctype)(READ_EXPR); \
+            if (VM_CALLBACK_SCALAR(key, op, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+        } \
+        ctx->cursor += sizeof(ctype); \
+    }
+
+#define VM_FIELD_FLOAT_BODY(op, ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) { \
+        ctype val = 0; \
+        int_t t; \
+        if (ctx->cursor + sizeof(ctype) > limit) return CND_ERR_INVALID_OP; \
+        if (VM_ENCODING) { \
+            if (VM_CALLBACK_SCALAR(key, op, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+            memcpy(&t, &val, sizeof(t)); \
+            WRITE_INT_EXPR; \
+        } else { \
+            t = (READ_INT_EXPR); \
+            memcpy(&val, &t, sizeof(t)); \
+            if (VM_CALLBACK_SCALAR(key, op, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+        } \
+        ctx->cursor += sizeof(ctype); \
+    }
+
+// Every field type of a run, read and written in byte order E
+#define VM_FIELD_TYPES(S, F, tag, E) \
+    S(OP_IO_U8, uint8_t, read_u8(VM_BUF), write_u8(VM_BUF, val), tag) \
+    S(OP_IO_I8, int8_t, read_u8(VM_BUF), write_u8(VM_BUF, (uint8_t)val), tag) \
+    S(OP_IO_U16, uint16_t, read_u16(VM_BUF, E), write_u16(VM_BUF, val, E), tag) \
+    S(OP_IO_I16, int16_t, read_u16(VM_BUF, E), write_u16(VM_BUF, (uint16_t)val, E), tag) \
+    S(OP_IO_U32, uint32_t, read_u32(VM_BUF, E), write_u32(VM_BUF, val, E), tag) \
+    S(OP_IO_I32, int32_t, read_u32(VM_BUF, E), write_u32(VM_BUF, (uint32_t)val, E), tag) \
+    S(OP_IO_U64, uint64_t, read_u64(VM_BUF, E), write_u64(VM_BUF, val, E), tag) \
+    S(OP_IO_I64, int64_t, read_u64(VM_BUF, E), write_u64(VM_BUF, (uint64_t)val, E), tag) \
+    F(OP_IO_F32, float, uint32_t, read_u32(VM_BUF, E), write_u32(VM_BUF, t, E), tag) \
+    F(OP_IO_F64, double, uint64_t, read_u64(VM_BUF, E), write_u64(VM_BUF, t, E), tag)
+
+#define VM_FIELD_SCALAR(op, ctype, READ_EXPR, WRITE_EXPR, tag) \
+    case op: VM_FIELD_SCALAR_BODY(op, ctype, READ_EXPR, WRITE_EXPR) break;
+#define VM_FIELD_FLOAT(op, ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR, tag) \
+    case op: VM_FIELD_FLOAT_BODY(op, ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) break;
+
+// One field of type `type` at the cursor, up to `limit`, reported as `key`
+#define VM_FIELD(type) VM_FIELD_E(type, ctx->endianness)
+#define VM_FIELD_E(type, E) \
+    switch (type) { \
+        VM_FIELD_TYPES(VM_FIELD_SCALAR, VM_FIELD_FLOAT, _, E) \
+        case OP_IO_BOOL: { \
+            cnd_error_t err = vm_op_io_bool(ctx, key); \
+            if (err != CND_ERR_OK) return err; \
+            break; \
+        } \
+        default: \
+            return CND_ERR_INVALID_OP; \
+    }
+
+#if VM_THREADED
+// Threaded loops jump from one run entry straight to the next, like they do
+// between instructions, with labels specialised for the byte order
+#define VM_RUN_NEXT() do { \
+        run_entry += 3; \
+        if (run_entry == run_end) goto R_done; \
+        goto *run_table[*run_entry]; \
+    } while (0)
+#define VM_RUN_ENTRY() \
+    uint16_t key = (uint16_t)(il_get_u16(run_entry + 1) + ctx->key_base); \
+    size_t limit = run_limit; \
+    ctx->ip = (size_t)(run_entry + 3 - ctx->program->bytecode);
+#define VM_RUN_SCALAR(op, ctype, READ_EXPR, WRITE_EXPR, tag) \
+    R_##tag##_##op: { VM_RUN_ENTRY() VM_FIELD_SCALAR_BODY(op, ctype, READ_EXPR, WRITE_EXPR) } VM_RUN_NEXT();
+#define VM_RUN_FLOAT(op, ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR, tag) \
+    R_##tag##_##op: { VM_RUN_ENTRY() VM_FIELD_FLOAT_BODY(op, ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) } VM_RUN_NEXT();
+#define VM_RUN_LABEL(op, ...) [op] = &&R_LE_##op,
+#define VM_RUN_LABEL_BE(op, ...) [op] = &&R_BE_##op,
+#endif
+
+static cnd_error_t VM_LOOP_FN(cnd_vm_ctx* ctx) {
+    const uint8_t* pc = ctx->program->bytecode + ctx->ip;
+    const uint8_t* end = ctx->program->bytecode + ctx->program->bytecode_len;
+    uint8_t opcode;
+#if VM_THREADED
+    // State of the OP_IO_RUN in progress; its entry labels are reachable from
+    // every computed goto as far as the compiler can tell
+    const void* const* run_table = NULL;
+    const uint8_t* run_entry = NULL;
+    const uint8_t* run_end = NULL;
+    size_t run_limit = 0;
+#endif
+
+#if VM_THREADED
+    static const void* const vm_labels[256] = {
+        [0 ... 255] = &&L_default,
+        VM_OP_LABELS(VM_LABEL)
+    };
+    static const void* const vm_labels_be[256] = {
+        [0 ... 255] = &&L_default,
+        VM_OP_LABELS(VM_LABEL)
+        VM_IO_ENDIAN_LABELS(VM_LABEL_BE)
+    };
+    static const void* const vm_labels_trans[256] = {
+        [0 ... 255] = &&L_default,
+        VM_OP_LABELS(VM_LABEL)
+        VM_IO_ENDIAN_LABELS(VM_LABEL_TR)
+        VM_LABEL_TR(OP_IO_U8)
+        VM_LABEL_TR(OP_IO_I8)
+    };
+    const void* const* vm_table = vm_labels;
+
+    VM_RETABLE();
+    VM_NEXT();
+#else
+    static const uint16_t vm_sel_mask[256] = {
+        VM_IO_ENDIAN_LABELS(VM_SEL_MASK)
+        [OP_IO_U8] = VM_SEL_TR,
+        [OP_IO_I8] = VM_SEL_TR,
+    };
+    unsigned vm_sel = 0;
+
+    VM_RETABLE();
+    while (pc < end) {
+#if VM_STREAM
+        // Where this instruction restarts if it runs out of input
+        ctx->mark_ip = (size_t)(pc - ctx->program->bytecode);
+        ctx->mark_cursor = ctx->cursor;
+        ctx->mark_bit_offset = ctx->bit_offset;
+        ctx->mark_expr_sp = ctx->expr_sp;
+#endif
+        opcode = *pc++;
+        switch (opcode | (vm_sel & vm_sel_mask[opcode])) {
+#endif
+
+        VM_CASE(OP_NOOP) break; VM_END
+        VM_CASE(OP_SET_ENDIAN_LE) ctx->endianness = CND_LE; VM_RETABLE(); break; VM_END
+        VM_CASE(OP_SET_ENDIAN_BE) ctx->endianness = CND_BE; VM_RETABLE(); break; VM_END
+        
+        VM_CASE(OP_ENTER_STRUCT) {
+            uint16_t key = FETCH_KEY(ctx);
+            // printf("VM_DEBUG: Calling callback for ENTER_STRUCT (Key %d)\n", key);
+            SYNC_IP();
+            // Allow callback to return error, but also allow it to just return OK.
+            // If callback returns error, we stop.
+            if (VM_CALLBACK(key, opcode, NULL) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            break; 
+        } VM_END
+        
+        VM_CASE(OP_EXIT_STRUCT) {
+            // printf("VM_DEBUG: Calling callback for EXIT_STRUCT\n");
+            SYNC_IP();
+            if (VM_CALLBACK(0, opcode, NULL) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            break; 
+        } VM_END
+
+        VM_CASE(OP_META_VERSION) {
+            FETCH_IL_U8(ctx); // Skip version
+            break;
+        } VM_END
+
+        VM_CASE(OP_META_NAME) {
+            FETCH_IL_U16(ctx); // Skip name key
+            break;
+        } VM_END
+        
+        VM_CASE(OP_CONST_WRITE) {
+            vm_align(ctx);
+            uint8_t type = FETCH_IL_U8(ctx);
+            uint32_t size = il_type_size(type);
+            uint64_t val = 0;
+            if (size == 1) val = FETCH_IL_U8(ctx);
+            else if (size == 2) val = FETCH_IL_U16(ctx);
+            else if (size == 4) val = FETCH_IL_U32(ctx);
+            else if (size == 8) val = FETCH_IL_U64(ctx);
+            cnd_error_t err = vm_op_const_write(ctx, type, val);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+        
+        VM_CASE(OP_CONST_CHECK) {
+            vm_align(ctx);
+            uint16_t key = FETCH_KEY(ctx);
+            uint8_t type = FETCH_IL_U8(ctx);
+            uint32_t size = il_type_size(type);
+            uint64_t expected = 0;
+            if (size == 1) expected = FETCH_IL_U8(ctx);
+            else if (size == 2) expected = FETCH_IL_U16(ctx);
+            else if (size == 4) expected = FETCH_IL_U32(ctx);
+            else if (size == 8) expected = FETCH_IL_U64(ctx);
+            SYNC_IP();
+            cnd_error_t err = vm_op_const_check(ctx, key, type, expected);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_CASE(OP_ENUM_CHECK) {
+            vm_align(ctx);
+            uint8_t type = FETCH_IL_U8(ctx);
+            uint16_t count = FETCH_IL_U16(ctx);
+            size_t values_len = (size_t)count * il_type_size(type);
+            if ((size_t)(end - pc) < values_len) return CND_ERR_OOB;
+            const uint8_t* values = pc;
+            pc += values_len;
+            cnd_error_t err = vm_op_enum_check(ctx, type, count, values);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_CASE(OP_ENUM_BITMAP) {
+            vm_align(ctx);
+            uint8_t type = FETCH_IL_U8(ctx);
+            uint32_t size = il_type_size(type);
+            uint64_t base = 0;
+            if (size == 1) base = FETCH_IL_U8(ctx);
+            else if (size == 2) base = FETCH_IL_U16(ctx);
+            else if (size == 4) base = FETCH_IL_U32(ctx);
+            else if (size == 8) base = FETCH_IL_U64(ctx);
+            uint16_t span = FETCH_IL_U16(ctx);
+            size_t bits_len = ((size_t)span + 7) / 8;
+            if ((size_t)(end - pc) < bits_len) return CND_ERR_OOB;
+            const uint8_t* bits = pc;
+            pc += bits_len;
+            cnd_error_t err = vm_op_enum_bitmap(ctx, type, base, span, bits);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_CASE(OP_ENUM_SORTED) {
+            vm_align(ctx);
+            uint8_t type = FETCH_IL_U8(ctx);
+            uint16_t count = FETCH_IL_U16(ctx);
+            size_t values_len = (size_t)count * il_type_size(type);
+            if ((size_t)(end - pc) < values_len) return CND_ERR_OOB;
+            const uint8_t* values = pc;
+            pc += values_len;
+            cnd_error_t err = vm_op_enum_sorted(ctx, type, count, values);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_CASE(OP_RANGE_CHECK) {
+            uint8_t type = FETCH_IL_U8(ctx);
+            uint32_t size = il_type_size(type);
+            uint64_t lo = 0, hi = 0;
+            if (size == 1) { lo = FETCH_IL_U8(ctx); hi = FETCH_IL_U8(ctx); }
+            else if (size == 2) { lo = FETCH_IL_U16(ctx); hi = FETCH_IL_U16(ctx); }
+            else if (size == 4) { lo = FETCH_IL_U32(ctx); hi = FETCH_IL_U32(ctx); }
+            else if (size == 8) { lo = FETCH_IL_U64(ctx); hi = FETCH_IL_U64(ctx); }
+            cnd_error_t err = vm_op_range_check(ctx, type, lo, hi);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_CASE(OP_CRC_16) {
+            vm_align(ctx);
+            uint16_t poly = FETCH_IL_U16(ctx);
+            uint16_t init = FETCH_IL_U16(ctx);
+            uint16_t xorout = FETCH_IL_U16(ctx);
+            uint8_t flags = FETCH_IL_U8(ctx);
+            cnd_error_t err = vm_op_crc(ctx, poly, init, xorout, flags, 16);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_CASE(OP_CRC_32) {
+            vm_align(ctx);
+            uint32_t poly = FETCH_IL_U32(ctx);
+            uint32_t init = FETCH_IL_U32(ctx);
+            uint32_t xorout = FETCH_IL_U32(ctx);
+            uint8_t flags = FETCH_IL_U8(ctx);
+            cnd_error_t err = vm_op_crc(ctx, poly, init, xorout, flags, 32);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_CASE(OP_CRC_BEGIN) vm_op_crc_begin(ctx); break; VM_END
+        VM_CASE(OP_CRC_END) vm_op_crc_end(ctx); break; VM_END
+
+        VM_CASE(OP_SCALE_LIN) {
+            uint64_t i_fac = FETCH_IL_U64(ctx);
+            uint64_t i_off = FETCH_IL_U64(ctx);
+            double fac, off;
+            memcpy(&fac, &i_fac, 8);
+            memcpy(&off, &i_off, 8);
+            ctx->trans_type = CND_TRANS_SCALE_F64;
+            ctx->trans_f_factor = fac;
+            ctx->trans_f_offset = off;
+            VM_RETABLE();
+            break;
+        } VM_END
+
+        VM_CASE(OP_TRANS_POLY) {
+            vm_align(ctx);
+            uint8_t count = FETCH_IL_U8(ctx);
+            ctx->trans_type = CND_TRANS_POLY;
+            ctx->trans_poly_count = count;
+            ctx->trans_poly_data = pc;
+            pc += (count * 8);
+            if (pc > end) return CND_ERR_OOB;
+            VM_RETABLE();
+            break;
+        } VM_END
+
+        VM_CASE(OP_TRANS_SPLINE) {
+            vm_align(ctx);
+            uint8_t count = FETCH_IL_U8(ctx);
+            ctx->trans_type = CND_TRANS_SPLINE;
+            ctx->trans_spline_count = count;
+            ctx->trans_spline_data = pc;
+            pc += (count * 2 * 8); // 2 doubles per point
+            if (pc > end) return CND_ERR_OOB;
+            VM_RETABLE();
+            break;
+        } VM_END
+
+        VM_CASE(OP_MARK_OPTIONAL)
+            ctx->is_next_optional = true;
+            break;
+        VM_END
+        
+        VM_CASE(OP_TRANS_ADD) ctx->trans_type = CND_TRANS_ADD_I64; ctx->trans_i_val = (int64_t)FETCH_IL_U64(ctx); VM_RETABLE(); break; VM_END
+        VM_CASE(OP_TRANS_SUB) ctx->trans_type = CND_TRANS_SUB_I64; ctx->trans_i_val = (int64_t)FETCH_IL_U64(ctx); VM_RETABLE(); break; VM_END
+        VM_CASE(OP_TRANS_MUL) ctx->trans_type = CND_TRANS_MUL_I64; ctx->trans_i_val = (int64_t)FETCH_IL_U64(ctx); VM_RETABLE(); break; VM_END
+        VM_CASE(OP_TRANS_DIV) ctx->trans_type = CND_TRANS_DIV_I64; ctx->trans_i_val = (int64_t)FETCH_IL_U64(ctx); VM_RETABLE(); break; VM_END
+
+        // ... Category B (Primitives) ...
+        VM_IO_BYTE(OP_IO_U8, uint8_t)
+        VM_IO_INT(OP_IO_U16, 2, uint16_t, uint16_t, read_u16, write_u16)
+        VM_IO_INT(OP_IO_U32, 4, uint32_t, uint32_t, read_u32, write_u32)
+        VM_IO_INT(OP_IO_U64, 8, uint64_t, uint64_t, read_u64, write_u64)
+
+        VM_IO_BYTE(OP_IO_I8, int8_t)
+        VM_IO_INT(OP_IO_I16, 2, int16_t, uint16_t, read_u16, write_u16)
+        VM_IO_INT(OP_IO_I32, 4, int32_t, uint32_t, read_u32, write_u32)
+        VM_IO_INT(OP_IO_I64, 8, int64_t, uint64_t, read_u64, write_u64)
+
+        VM_CASE(OP_IO_BOOL) {
+            vm_align(ctx);
+            uint16_t key = FETCH_KEY(ctx);
+            SYNC_IP();
+            cnd_error_t err = vm_op_io_bool(ctx, key);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_IO_FLOAT(OP_IO_F32, 4, float, uint32_t, read_u32, write_u32)
+        VM_IO_FLOAT(OP_IO_F64, 8, double, uint64_t, read_u64, write_u64)
+
+        // Superinstructions. Anything the fast path does not cover (a short
+        // buffer, a pending transform or @optional) runs the embedded
+        // instructions one by one instead.
+        VM_CASE(OP_IO_RUN) {
+            uint8_t n = FETCH_IL_U8(ctx);
+            uint16_t bytes = FETCH_IL_U16(ctx);
+            const uint8_t* fields = pc;
+            if ((size_t)(end - pc) < (size_t)n * 3) return CND_ERR_OOB;
+            vm_align(ctx);
+            if (n == 0 || ctx->cursor + bytes > ctx->data_len || ctx->is_next_optional ||
+                ctx->trans_type != CND_TRANS_NONE) break;
+#if VM_THREADED
+            static const void* const run_le[256] = {
+                [0 ... 255] = &&R_bad,
+                VM_FIELD_TYPES(VM_RUN_LABEL, VM_RUN_LABEL, LE, CND_LE)
+                [OP_IO_BOOL] = &&R_bool,
+            };
+            static const void* const run_be[256] = {
+                [0 ... 255] = &&R_bad,
+                VM_FIELD_TYPES(VM_RUN_LABEL_BE, VM_RUN_LABEL_BE, BE, CND_BE)
+                [OP_IO_BOOL] = &&R_bool,
+            };
+            run_table = ctx->endianness == CND_BE ? run_be : run_le;
+            run_limit = ctx->cursor + bytes;
+            run_entry = fields;
+            pc += (size_t)n * 3;
+            run_end = pc;
+            goto *run_table[*run_entry];
+
+            VM_FIELD_TYPES(VM_RUN_SCALAR, VM_RUN_FLOAT, LE, CND_LE)
+            VM_FIELD_TYPES(VM_RUN_SCALAR, VM_RUN_FLOAT, BE, CND_BE)
+        R_bool: {
+                VM_RUN_ENTRY()
+                (void)limit;
+                cnd_error_t err = vm_op_io_bool(ctx, key);
+                if (err != CND_ERR_OK) return err;
+            }
+            VM_RUN_NEXT();
+        R_bad:
+            return CND_ERR_INVALID_OP;
+        R_done:
+            break;
+#else
+            size_t limit = ctx->cursor + bytes;
+            pc += (size_t)n * 3;
+            if (vm_sel == VM_SEL_BE) {
+                for (const uint8_t* f = fields; f < pc; f += 3) {
+                    uint16_t key = (uint16_t)(il_get_u16(f + 1) + ctx->key_base);
+                    ctx->ip = (size_t)(f + 3 - ctx->program->bytecode);
+                    VM_FIELD_E(f[0], CND_BE)
+                }
+            } else {
+                for (const uint8_t* f = fields; f < pc; f += 3) {
+                    uint16_t key = (uint16_t)(il_get_u16(f + 1) + ctx->key_base);
+                    ctx->ip = (size_t)(f + 3 - ctx->program->bytecode);
+                    VM_FIELD_E(f[0], CND_LE)
+                }
+            }
+            break;
+#endif
+        } VM_END
+
+        VM_CASE(OP_IO_CHECK) {
+            if (end - pc < 4) return CND_ERR_OOB;
+            uint8_t type = pc[0];
+            uint32_t size = il_type_size(type);
+            vm_align(ctx);
+            if (size == 0 || ctx->cursor + size > ctx->data_len || ctx->is_next_optional ||
+                ctx->trans_type != CND_TRANS_NONE) break;
+            uint16_t key = (uint16_t)(il_get_u16(pc + 1) + ctx->key_base);
+            size_t limit = ctx->cursor + size;
+            pc += 3;
+            SYNC_IP();
+            VM_FIELD(type)
+            size_t check_len = 0;
+            cnd_error_t err = vm_op_check_insn(ctx, pc, (size_t)(end - pc), &check_len);
+            if (err != CND_ERR_OK) return err;
+            pc += check_len;
+            break;
+        } VM_END
+
+        VM_CASE(OP_IO_SLOT) {
+            if (end - pc < 3) return CND_ERR_OOB;
+            uint8_t type = pc[0];
+            uint32_t size = il_type_size(type);
+            vm_align(ctx);
+            // A stream restarts here rather than at the embedded field, which
+            // would not record the slot
+            if (VM_STREAM && size != 0 && ctx->cursor + size > ctx->data_len && vm_stream_open(ctx)) {
+                return CND_ERR_OOB;
+            }
+            if (size == 0 || ctx->cursor + size > ctx->data_len || ctx->is_next_optional ||
+                ctx->trans_type != CND_TRANS_NONE) break;
+            uint16_t key = (uint16_t)(il_get_u16(pc + 1) + ctx->key_base);
+            size_t limit = ctx->cursor + size;
+            pc += 3;
+            SYNC_IP();
+            VM_FIELD(type)
+            vm_slot_set(ctx, key, vm_slot_field(ctx, type));
+            break;
+        } VM_END
+
+        // ... Category C (Bitfields) ...
+        VM_CASE(OP_IO_BIT_U) {
+            uint16_t k = FETCH_KEY(ctx);
+            uint8_t b = FETCH_IL_U8(ctx);
+            SYNC_IP();
+            cnd_error_t err = vm_op_bit_u(ctx, k, b);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+        
+        VM_CASE(OP_ENTER_BIT_MODE) {
+            // No-op for now
+            break;
+        } VM_END
+
+        VM_CASE(OP_EXIT_BIT_MODE) {
+            if (ctx->bit_offset > 0) {
+                return CND_ERR_VALIDATION; // Unaligned exit is not allowed
+            }
+            break;
+        } VM_END
+
+        VM_CASE(OP_ALIGN_FILL) {
+            uint8_t fill_bit = FETCH_IL_U8(ctx);
+            vm_op_align_fill(ctx, fill_bit);
+            break;
+        } VM_END
+        VM_CASE(OP_IO_BIT_I) {
+            uint16_t k = FETCH_KEY(ctx);
+            uint8_t b = FETCH_IL_U8(ctx);
+            SYNC_IP();
+            cnd_error_t err = vm_op_bit_i(ctx, k, b);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+        VM_CASE(OP_IO_BIT_BOOL) {
+            uint16_t k = FETCH_KEY(ctx);
+            FETCH_IL_U8(ctx); // Skip bit width (always 1)
+            SYNC_IP();
+            cnd_error_t err = vm_op_bit_bool(ctx, k);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+        VM_CASE(OP_IO_BIT_GROUP) {
+            uint8_t n = FETCH_IL_U8(ctx);
+            const uint8_t* fields = pc;
+            if ((size_t)(end - pc) < (size_t)n * 4) return CND_ERR_OOB;
+            pc += (size_t)n * 4;
+            SYNC_IP();
+            cnd_error_t err = vm_op_bit_group(ctx, fields, n, true);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+        VM_CASE(OP_ALIGN_PAD) {
+            uint8_t b = FETCH_IL_U8(ctx);
+            if (VM_STREAM && vm_stream_open(ctx) && !bits_in_bounds(ctx, b)) return CND_ERR_OOB;
+            vm_op_align_pad(ctx, b);
+            break;
+        } VM_END
+
+        // ... Category D: Arrays & Strings ...
+        
+        VM_CASE(OP_STR_NULL) {
+            vm_align(ctx);
+            uint16_t key = FETCH_KEY(ctx);
+            uint16_t max_len = FETCH_IL_U16(ctx);
+            SYNC_IP();
+            cnd_error_t err = vm_op_str_null(ctx, key, max_len);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_CASE(OP_STR_PRE_U8)  HANDLE_STRING_PRE(1, uint8_t,  read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, len_val)); VM_END
+        VM_CASE(OP_STR_PRE_U16) HANDLE_STRING_PRE(2, uint16_t, read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, len_val, ctx->endianness)); VM_END
+        VM_CASE(OP_STR_PRE_U32) HANDLE_STRING_PRE(4, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, len_val, ctx->endianness)); VM_END
+
+        VM_CASE(OP_ARR_PRE_U8)  HANDLE_ARRAY_PRE(1, uint8_t,  read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, count)); VM_END
+        VM_CASE(OP_ARR_PRE_U16) HANDLE_ARRAY_PRE(2, uint16_t, read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, count, ctx->endianness)); VM_END
+        VM_CASE(OP_ARR_PRE_U32) HANDLE_ARRAY_PRE(4, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, count, ctx->endianness)); VM_END
+
+        VM_CASE(OP_ARR_FIXED) {
+            vm_align(ctx);
+            uint16_t key = FETCH_KEY(ctx);
+            uint32_t count = FETCH_IL_U32(ctx);
+            // printf("VM_DEBUG: Calling callback for ARR_FIXED (Key %d)\n", key);
+            if (VM_ENCODING) {
+                 // Notify host about array start so it can push context
+                 // We should probably pass u32, but for now let's cast or ensure callback handles it.
+                 // The callback signature is (ctx, key, type, void*).
+                 // For ARR_FIXED, we pass pointer to count.
+                 SYNC_IP();
+                 if (VM_CALLBACK(key, opcode, &count) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            } else {
+                 // Notify host about array start
+                 SYNC_IP();
+                 if (VM_CALLBACK(key, opcode, &count) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            }
+
+            if (count > 0) {
+                SYNC_IP();
+                cnd_error_t bulk_err;
+                if (TRY_BULK_ARRAY(count, &bulk_err)) { if (bulk_err != CND_ERR_OK) return bulk_err; RELOAD_PC(); break; }
+                if (!loop_push(ctx, ctx->ip, count)) return CND_ERR_OOB;
+            } else {
+                 SYNC_IP();
+                 skip_loop_body(ctx);
+                 RELOAD_PC();
+            }
+            break;
+        } VM_END
+
+        VM_CASE(OP_ARR_EOF) {
+            vm_align(ctx);
+            FETCH_IL_U16(ctx); // Key unused for now
+            SYNC_IP();
+            bool empty = false;
+            cnd_error_t err = vm_op_arr_eof(ctx, &empty);
+            if (err != CND_ERR_OK) return err;
+            if (empty) {
+                // Already at EOF: skip the loop body
+                skip_loop_body(ctx);
+                RELOAD_PC();
+            }
+            break;
+        } VM_END
+
+        VM_CASE(OP_ARR_DYNAMIC) {
+            vm_align(ctx);
+            uint16_t key = FETCH_KEY(ctx);
+            uint16_t ref_key = FETCH_KEY(ctx);
+            
+            uint64_t count_val = 0;
+            SYNC_IP();
+            if (VM_CTX_VALUE(ref_key, OP_CTX_QUERY, &count_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            // printf("VM_DEBUG: OpCtxQuery Key=%d returned %" PRIu64 "\n", ref_key, count_val);
+            
+            if (count_val > 0xFFFFFFFF) return CND_ERR_ARITHMETIC;
+            uint32_t count = (uint32_t)count_val;
+            
+            SYNC_IP();
+            if (VM_CALLBACK(key, OP_ARR_DYNAMIC, &count) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            
+            if (count > 0) {
+                cnd_error_t bulk_err;
+                if (TRY_BULK_ARRAY(count, &bulk_err)) { if (bulk_err != CND_ERR_OK) return bulk_err; RELOAD_PC(); break; }
+                if (!loop_push(ctx, ctx->ip, count)) return CND_ERR_OOB;
+            } else {
+                 skip_loop_body(ctx);
+                 RELOAD_PC();
+            }
+            break;
+        } VM_END
+
+        VM_CASE(OP_ARR_END) {
+            vm_align(ctx);
+            SYNC_IP();
+            bool again = false;
+            cnd_error_t err = vm_op_arr_end(ctx, &again);
+            if (err != CND_ERR_OK) return err;
+            if (again) RELOAD_PC();
+            break;
+        } VM_END
+
+        VM_CASE(OP_RAW_BYTES) {
+            vm_align(ctx);
+            uint16_t key = FETCH_KEY(ctx);
+            uint32_t count = FETCH_IL_U32(ctx);
+            SYNC_IP();
+            cnd_error_t err = vm_op_raw_bytes(ctx, key, count);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_CASE(OP_SWITCH) {
+            uint16_t key = FETCH_KEY(ctx);
+            uint32_t table_rel_offset = FETCH_IL_U32(ctx);
+            
+            // IP is now at the start of the code block (immediately after SWITCH instruction)
+            SYNC_IP();
+            size_t code_start_ip = ctx->ip;
+            size_t table_start_ip = code_start_ip + table_rel_offset;
+            
+            if (table_start_ip > ctx->program->bytecode_len) return CND_ERR_OOB;
+            
+            // Jump to table to read it
+            ctx->ip = table_start_ip;
+            
+            uint16_t count = read_il_u16(ctx);
+            int32_t default_off = (int32_t)read_il_u32(ctx);
+            
+            uint64_t disc_val = 0;
+            if (VM_CTX_VALUE(key, OP_CTX_QUERY, &disc_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            
+            int32_t target_off = default_off;
+            for (uint16_t i = 0; i < count; i++) {
+                uint64_t case_val = read_il_u64(ctx);
+                int32_t case_off = (int32_t)read_il_u32(ctx);
+                if (disc_val == case_val) {
+                    target_off = case_off;
+                    break;
+                }
+            }
+            
+            // Target offset is relative to code_start_ip
+            if (vm_switch_target(code_start_ip, target_off, ctx->program->bytecode_len, &ctx->ip) != CND_ERR_OK) return CND_ERR_OOB;
+            RELOAD_PC();
+            break;
+        } VM_END
+
+        VM_CASE(OP_SWITCH_SORTED) {
+            size_t insn_ip = (size_t)(pc - ctx->program->bytecode) - 1;
+            uint16_t key = FETCH_KEY(ctx);
+            FETCH_IL_U32(ctx);
+            SYNC_IP();
+            size_t code_start_ip = insn_ip + 7;
+
+            // Checks the table header and that the whole table is in bounds
+            size_t table_start, table_len;
+            cnd_error_t err = vm_switch_table_span(ctx->program->bytecode, ctx->program->bytecode_len,
+                                                   insn_ip, &table_start, &table_len);
+            if (err != CND_ERR_OK) return err;
+
+            uint64_t disc_val = 0;
+            if (VM_CTX_VALUE(key, OP_CTX_QUERY, &disc_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+
+            int32_t target_off = vm_switch_sorted_lookup(ctx->program->bytecode + table_start, disc_val);
+            if (vm_switch_target(code_start_ip, target_off, ctx->program->bytecode_len, &ctx->ip) != CND_ERR_OK) return CND_ERR_OOB;
+            RELOAD_PC();
+            break;
+        } VM_END
+
+        VM_CASE(OP_SWITCH_HASH) {
+            size_t insn_ip = (size_t)(pc - ctx->program->bytecode) - 1;
+            uint16_t key = FETCH_KEY(ctx);
+            FETCH_IL_U32(ctx);
+            SYNC_IP();
+            size_t code_start_ip = insn_ip + 7;
+
+            // Checks the table header and that the whole table is in bounds
+            size_t table_start, table_len;
+            cnd_error_t err = vm_switch_table_span(ctx->program->bytecode, ctx->program->bytecode_len,
+                                                   insn_ip, &table_start, &table_len);
+            if (err != CND_ERR_OK) return err;
+
+            uint64_t disc_val = 0;
+            if (VM_CTX_VALUE(key, OP_CTX_QUERY, &disc_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+
+            int32_t target_off = vm_switch_hash_lookup(ctx->program->bytecode + table_start, disc_val);
+            if (vm_switch_target(code_start_ip, target_off, ctx->program->bytecode_len, &ctx->ip) != CND_ERR_OK) return CND_ERR_OOB;
+            RELOAD_PC();
+            break;
+        } VM_END
+
+        VM_CASE(OP_SWITCH_TABLE) {
+            uint16_t key = FETCH_KEY(ctx);
+            uint32_t table_rel_offset = FETCH_IL_U32(ctx);
+            
+            SYNC_IP();
+            size_t code_start_ip = ctx->ip;
+            size_t table_start_ip = code_start_ip + table_rel_offset;
+            
+            // Check if table start is valid and if we can read the header (20 bytes)
+            if (table_start_ip > ctx->program->bytecode_len || 
+                table_start_ip + 20 > ctx->program->bytecode_len) return CND_ERR_OOB;
+            
+            // Jump to table
+            size_t original_ip = ctx->ip;
+            ctx->ip = table_start_ip;
+            
+            uint64_t min_val = read_il_u64(ctx);
+            uint64_t max_val = read_il_u64(ctx);
+            int32_t default_off = (int32_t)read_il_u32(ctx);
+            
+            uint64_t disc_val = 0;
+            if (VM_CTX_VALUE(key, OP_CTX_QUERY, &disc_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            
+            int32_t target_off = default_off;
+            
+            if (disc_val >= min_val && disc_val <= max_val) {
+                uint64_t index = disc_val - min_val;
+                // Offset is at table_start + 8 + 8 + 4 + index * 4
+                // We are currently at table_start + 20 (ctx->ip)
+                size_t offset_loc = ctx->ip + (size_t)(index * 4);
+                
+                // Check bounds for the offset entry
+                if (offset_loc + 4 > ctx->program->bytecode_len) return CND_ERR_OOB;
+                
+                target_off = (int32_t)peek_il_u32(ctx, offset_loc);
+            }
+            
+            ctx->ip = original_ip;
+            
+            if (target_off < 0) {
+                 size_t abs_off = (size_t)(-(int64_t)target_off);
+                 if (code_start_ip < abs_off) return CND_ERR_OOB;
+                 ctx->ip = code_start_ip - abs_off;
+            } else {
+                 size_t abs_off = (size_t)target_off;
+                 if (code_start_ip + abs_off < code_start_ip) return CND_ERR_OOB;
+                 ctx->ip = code_start_ip + abs_off;
+            }
+            
+            if (ctx->ip > ctx->program->bytecode_len) return CND_ERR_OOB;
+            RELOAD_PC();
+            break;
+        } VM_END
+
+        VM_CASE(OP_JUMP_IF_NOT) {
+            int32_t offset = (int32_t)FETCH_IL_U32(ctx);
+            uint64_t condition;
+            if (stack_pop(ctx, &condition) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
+            
+            if (condition == 0) {
+                // Jump
+                SYNC_IP();
+                if (offset < 0) {
+                    size_t abs_off = (size_t)(-(int64_t)offset);
+                    if (ctx->ip < abs_off) return CND_ERR_OOB;
+                    ctx->ip -= abs_off;
+                } else {
+                    size_t abs_off = (size_t)offset;
+                    if (ctx->ip + abs_off < ctx->ip) return CND_ERR_OOB;
+                    ctx->ip += abs_off;
+                }
+                if (ctx->ip > ctx->program->bytecode_len) return CND_ERR_OOB;
+                RELOAD_PC();
+            }
+            break;
+        } VM_END
+
+        VM_CASE(OP_JUMP) {
+            int32_t offset = (int32_t)FETCH_IL_U32(ctx);
+            // Offset is relative to IP *after* reading the offset (which is current ctx->ip)
+            SYNC_IP();
+            if (offset < 0) {
+                size_t abs_off = (size_t)(-(int64_t)offset);
+                if (ctx->ip < abs_off) return CND_ERR_OOB;
+                ctx->ip -= abs_off;
+            } else {
+                size_t abs_off = (size_t)offset;
+                if (ctx->ip + abs_off < ctx->ip) return CND_ERR_OOB;
+                ctx->ip += abs_off;
+            }
+            if (ctx->ip > ctx->program->bytecode_len) return CND_ERR_OOB;
+            RELOAD_PC();
+            break;
+        } VM_END
+
+        VM_CASE(OP_CALL) {
+            uint16_t key_base = FETCH_IL_U16(ctx);
+            FETCH_IL_U16(ctx); // Key count, for tools
+            int32_t offset = (int32_t)FETCH_IL_U32(ctx);
+            SYNC_IP();
+            size_t target;
+            if (vm_switch_target(ctx->ip, offset, ctx->program->bytecode_len, &target) != CND_ERR_OK) return CND_ERR_OOB;
+            cnd_error_t err = vm_op_call(ctx, ctx->ip, key_base);
+            if (err != CND_ERR_OK) return err;
+            ctx->ip = target;
+            RELOAD_PC();
+            break;
+        } VM_END
+
+        VM_CASE(OP_RET) {
+            SYNC_IP();
+            if (!vm_op_ret(ctx)) return CND_ERR_OK; // Top level: end of the packet
+            RELOAD_PC();
+            break;
+        } VM_END
+
+        // --- Category G: Expression Stack & ALU ---
+
+        VM_CASE(OP_LOAD_CTX) {
+            uint16_t key = FETCH_KEY(ctx);
+            uint64_t val = 0;
+            SYNC_IP();
+            if (VM_CTX_VALUE(key, OP_LOAD_CTX, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            if (stack_push(ctx, val) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
+            break;
+        } VM_END
+
+        VM_CASE(OP_STORE_CTX) {
+            uint16_t key = FETCH_KEY(ctx);
+            uint64_t val;
+            if (stack_pop(ctx, &val) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
+            SYNC_IP();
+            if (VM_CALLBACK(key, OP_STORE_CTX, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            vm_slot_set(ctx, key, val);
+            break;
+        } VM_END
+
+        VM_CASE(OP_PUSH_IMM) {
+            uint64_t val = FETCH_IL_U64(ctx);
+            if (stack_push(ctx, val) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
+            break;
+        } VM_END
+
+        VM_CASE(OP_POP) {
+            uint64_t val;
+            if (stack_pop(ctx, &val) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
+            break;
+        } VM_END
+
+        VM_CASE(OP_SWAP) {
+            if (ctx->expr_sp < 2) return CND_ERR_STACK_UNDERFLOW;
+            uint64_t tmp = ctx->expr_stack[ctx->expr_sp - 1];
+            ctx->expr_stack[ctx->expr_sp - 1] = ctx->expr_stack[ctx->expr_sp - 2];
+            ctx->expr_stack[ctx->expr_sp - 2] = tmp;
+            break;
+        } VM_END
+
+        VM_CASE(OP_DUP) {
+            if (ctx->expr_sp == 0) return CND_ERR_STACK_UNDERFLOW;
+            uint64_t val = ctx->expr_stack[ctx->expr_sp - 1];
+            if (stack_push(ctx, val) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
+            break;
+        } VM_END
+
+        VM_CASE(OP_EMIT) {
+            uint8_t type = FETCH_IL_U8(ctx);
+            cnd_error_t err = vm_op_emit(ctx, type);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+        VM_CASE(OP_EXPR) {
+            uint8_t n = FETCH_IL_U8(ctx);
+            if ((size_t)(end - pc) < n) return CND_ERR_OOB;
+            const uint8_t* code = pc;
+            uint64_t val;
+            pc += n;
+            SYNC_IP();
+            cnd_error_t err = vm_expr_eval(ctx, code, n, &val);
+            if (err != CND_ERR_OK) return err;
+            if (stack_push(ctx, val) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
+            break;
+        } VM_END
+
+        VM_DEFAULT {
+            // Unimplemented opcodes in the byte-aligned ranges still align
+            if (ALIGN_TABLE[opcode]) vm_align(ctx);
+            // Expression stack ALU (no IL operands)
+            cnd_error_t err = vm_alu(ctx, opcode);
+            if (err != CND_ERR_OK) return err;
+            break;
+        } VM_END
+
+#if VM_THREADED
+vm_done:
+#else
+        }
+    }
+#endif
+    return CND_ERR_OK;
+}
+
+#undef VM_BUF
+#undef VM_CALLBACK
+#undef VM_CALLBACK_SCALAR
+#undef VM_CTX_VALUE
+#undef VM_CASE
+#undef VM_DEFAULT
+#undef VM_END
+#undef VM_RETABLE
+#undef VM_IO_BYTE
+#undef VM_IO_INT
+#undef VM_IO_FLOAT
+#undef VM_FIELD_SCALAR_BODY
+#undef VM_FIELD_FLOAT_BODY
+#undef VM_FIELD_TYPES
+#undef VM_FIELD_SCALAR
+#undef VM_FIELD_FLOAT
+#undef VM_FIELD
+#undef VM_FIELD_E
+#undef VM_IO_ENDIAN_LABELS
+#if VM_THREADED
+#undef VM_RUN_NEXT
+#undef VM_RUN_ENTRY
+#undef VM_RUN_SCALAR
+#undef VM_RUN_FLOAT
+#undef VM_RUN_LABEL
+#undef VM_RUN_LABEL_BE
+#undef VM_NEXT
+#undef VM_LABEL
+#undef VM_LABEL_BE
+#undef VM_LABEL_TR
+#undef VM_OP_LABELS
+#else
+#undef VM_SEL_BE
+#undef VM_SEL_TR
+#undef VM_SEL_MASK
+#endif
+
+#undef VM_LOOP_FN
+#undef VM_THREADED
+#undef VM_ENCODING
+#undef VM_BOUND
+#undef VM_STREAM
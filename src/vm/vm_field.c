@@ -0,0 +1,275 @@
+#include "vm_internal.h"
+#include <string.h>
+
+// --- Random-Access Field Accessors ---
+//
+// A field is located as a bit position, wire type and byte order. Fields with
+// a static position come from the program's layout table; the rest are found
+// by running the decoder with a callback that stops at the requested key.
+
+typedef struct {
+    uint64_t bit;            // Bit offset from the start of the buffer
+    uint8_t type;            // Wire opcode (OP_IO_* or OP_IO_BIT_*)
+    uint8_t width;           // Width in bits
+    cnd_endian_t endianness;
+} field_loc;
+
+#define FIELD_SCAN_RECENT 32
+
+typedef struct {
+    uint16_t key;
+    bool found;
+    field_loc loc;
+
+    // Recently decoded values, served back for switch / expression queries
+    uint16_t recent_keys[FIELD_SCAN_RECENT];
+    uint64_t recent_vals[FIELD_SCAN_RECENT];
+    uint8_t recent_count;
+    uint8_t recent_next;
+} field_scan;
+
+static bool field_is_signed(uint8_t type) {
+    return type == OP_IO_I8 || type == OP_IO_I16 || type == OP_IO_I32 || type == OP_IO_I64 || type == OP_IO_BIT_I;
+}
+
+static uint64_t field_sign_extend(uint64_t v, uint8_t width) {
+    if (width >= 64) return v;
+    uint64_t m = (uint64_t)1 << (width - 1);
+    v &= ((uint64_t)1 << width) - 1;
+    return (v ^ m) - m;
+}
+
+static bool field_lookup(const cnd_program* program, uint16_t key, field_loc* loc) {
+    size_t lo = 0, hi = program->layout_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const uint8_t* e = program->layout + mid * CND_LAYOUT_ENTRY_SIZE;
+        uint16_t k = il_get_u16(e);
+        if (k == key) {
+            loc->type = e[2];
+            loc->width = e[3] & (uint8_t)~CND_LAYOUT_BE;
+            loc->endianness = (e[3] & CND_LAYOUT_BE) ? CND_BE : CND_LE;
+            loc->bit = il_get_u32(e + 4);
+            return true;
+        }
+        if (k < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return false;
+}
+
+// --- Decode Scan ---
+
+// Value delivered to the callback as a u64 (floats as double bits)
+static uint64_t field_cb_value(uint8_t type, const void* ptr) {
+    switch (type) {
+        case OP_IO_U8: case OP_IO_BOOL: case OP_IO_BIT_BOOL: { uint8_t v; memcpy(&v, ptr, 1); return v; }
+        case OP_IO_I8: { int8_t v; memcpy(&v, ptr, 1); return (uint64_t)(int64_t)v; }
+        case OP_IO_U16: { uint16_t v; memcpy(&v, ptr, 2); return v; }
+        case OP_IO_I16: { int16_t v; memcpy(&v, ptr, 2); return (uint64_t)(int64_t)v; }
+        case OP_IO_U32: { uint32_t v; memcpy(&v, ptr, 4); return v; }
+        case OP_IO_I32: { int32_t v; memcpy(&v, ptr, 4); return (uint64_t)(int64_t)v; }
+        case OP_IO_F32: { float f; double d; uint64_t v; memcpy(&f, ptr, 4); d = f; memcpy(&v, &d, 8); return v; }
+        default: { uint64_t v; memcpy(&v, ptr, 8); return v; }
+    }
+}
+
+static void field_remember(field_scan* s, uint16_t key, uint64_t val) {
+    for (uint8_t i = 0; i < s->recent_count; i++) {
+        if (s->recent_keys[i] == key) { s->recent_vals[i] = val; return; }
+    }
+    s->recent_keys[s->recent_next] = key;
+    s->recent_vals[s->recent_next] = val;
+    s->recent_next = (uint8_t)((s->recent_next + 1) % FIELD_SCAN_RECENT);
+    if (s->recent_count < FIELD_SCAN_RECENT) s->recent_count++;
+}
+
+// Position of the value just delivered to the callback. Byte-aligned values
+// are reported before the cursor advances, bitfields after; the wire type is
+// taken from the instruction since transforms change the callback type.
+static bool field_scan_locate(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, field_loc* loc) {
+    const uint8_t* bc = ctx->program->bytecode;
+    size_t ip = ctx->ip;
+    loc->endianness = ctx->endianness;
+
+    if (type == OP_IO_BIT_U || type == OP_IO_BIT_I || type == OP_IO_BIT_BOOL) {
+        if (ip < 4 || bc[ip - 4] != type || (uint16_t)(il_get_u16(bc + ip - 3) + ctx->key_base) != key) return false;
+        loc->type = type;
+        loc->width = (type == OP_IO_BIT_BOOL) ? 1 : bc[ip - 1];
+        uint64_t end_bit = (uint64_t)ctx->cursor * 8 + ctx->bit_offset;
+        if (loc->width == 0 || end_bit < loc->width) return false;
+        loc->bit = end_bit - loc->width;
+        return true;
+    }
+
+    if (type == OP_STORE_CTX) {
+        // Expression field: DUP, STORE_CTX(key), EMIT(type)
+        if (ip + 2 > ctx->program->bytecode_len || bc[ip] != OP_EMIT) return false;
+        loc->type = bc[ip + 1];
+    } else if (ip >= 3 && bc[ip - 3] >= OP_IO_U8 && bc[ip - 3] <= OP_IO_BOOL && (uint16_t)(il_get_u16(bc + ip - 2) + ctx->key_base) == key) {
+        loc->type = bc[ip - 3];
+    } else {
+        // OP_CONST_CHECK: Key(2) Type(1) Value(size)
+        uint32_t size = il_type_size(type);
+        if (size == 0 || ip < 4 + size) return false;
+        size_t start = ip - 4 - size;
+        if (bc[start] != OP_CONST_CHECK || (uint16_t)(il_get_u16(bc + start + 1) + ctx->key_base) != key) return false;
+        loc->type = type;
+    }
+    if (il_type_size(loc->type) == 0) return false;
+    loc->width = (uint8_t)(il_type_size(loc->type) * 8);
+    loc->bit = (uint64_t)ctx->cursor * 8;
+    return true;
+}
+
+static cnd_error_t field_scan_cb(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    field_scan* s = (field_scan*)ctx->user_ptr;
+
+    switch (type) {
+        case OP_CTX_QUERY: case OP_LOAD_CTX:
+            for (uint8_t i = 0; i < s->recent_count; i++) {
+                if (s->recent_keys[i] == key_id) {
+                    memcpy(ptr, &s->recent_vals[i], 8);
+                    return CND_ERR_OK;
+                }
+            }
+            return CND_ERR_CALLBACK;
+
+        case OP_RAW_BYTES:
+            // Decline so byte arrays are walked element by element
+            return CND_ERR_CALLBACK;
+
+        case OP_STORE_CTX:
+        case OP_IO_U8: case OP_IO_U16: case OP_IO_U32: case OP_IO_U64:
+        case OP_IO_I8: case OP_IO_I16: case OP_IO_I32: case OP_IO_I64:
+        case OP_IO_F32: case OP_IO_F64: case OP_IO_BOOL:
+        case OP_IO_BIT_U: case OP_IO_BIT_I: case OP_IO_BIT_BOOL:
+            if (key_id == s->key && field_scan_locate(ctx, key_id, type, &s->loc)) {
+                s->found = true;
+                return CND_ERR_CALLBACK; // Stop the scan
+            }
+            field_remember(s, key_id, field_cb_value(type, ptr));
+            return CND_ERR_OK;
+
+        default:
+            // Structure, array and string events need nothing from the host
+            return CND_ERR_OK;
+    }
+}
+
+static cnd_error_t field_locate(const cnd_program* program, const uint8_t* data, size_t len,
+                                uint16_t key, field_loc* loc) {
+    if (program->layout && field_lookup(program, key, loc)) return CND_ERR_OK;
+
+    field_scan s;
+    memset(&s, 0, sizeof(s));
+    s.key = key;
+
+    cnd_vm_ctx ctx;
+    cnd_init(&ctx, CND_MODE_DECODE, program, (uint8_t*)data, len, field_scan_cb, &s);
+    cnd_error_t err = cnd_execute(&ctx);
+    if (s.found) {
+        *loc = s.loc;
+        return CND_ERR_OK;
+    }
+    return err == CND_ERR_OK ? CND_ERR_VALIDATION : err;
+}
+
+// Scratch context for the bit and byte helpers in vm_internal.h
+static void field_ctx(cnd_vm_ctx* ctx, const uint8_t* data, size_t len, const field_loc* loc) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->data_buffer = (uint8_t*)data;
+    ctx->data_len = len;
+    ctx->cursor = (size_t)(loc->bit / 8);
+    ctx->bit_offset = (uint8_t)(loc->bit % 8);
+    ctx->endianness = loc->endianness;
+}
+
+static bool field_in_bounds(const field_loc* loc, size_t len) {
+    return loc->width > 0 && loc->width <= 64 && loc->bit + loc->width <= (uint64_t)len * 8;
+}
+
+// --- Public API ---
+
+cnd_error_t cnd_field_read(const cnd_program* program, const uint8_t* data, size_t len,
+                           uint16_t key_id, uint64_t* value) {
+    if (!program || !program->bytecode || !data || !value) return CND_ERR_OOB;
+
+    field_loc loc;
+    cnd_error_t err = field_locate(program, data, len, key_id, &loc);
+    if (err != CND_ERR_OK) return err;
+    if (!field_in_bounds(&loc, len)) return CND_ERR_OOB;
+
+    cnd_vm_ctx ctx;
+    field_ctx(&ctx, data, len, &loc);
+
+    uint64_t raw;
+    if (loc.type == OP_IO_BIT_U || loc.type == OP_IO_BIT_I || loc.type == OP_IO_BIT_BOOL) {
+        raw = read_bits(&ctx, loc.width);
+    } else {
+        if (ctx.bit_offset != 0) return CND_ERR_INVALID_OP;
+        const uint8_t* p = data + ctx.cursor;
+        switch (loc.width) {
+            case 8: raw = read_u8(p); break;
+            case 16: raw = read_u16(p, loc.endianness); break;
+            case 32: raw = read_u32(p, loc.endianness); break;
+            default: raw = read_u64(p, loc.endianness); break;
+        }
+    }
+
+    if (loc.type == OP_IO_F32) {
+        uint32_t bits = (uint32_t)raw;
+        float f;
+        memcpy(&f, &bits, 4);
+        double d = f;
+        memcpy(&raw, &d, 8);
+    } else if (field_is_signed(loc.type)) {
+        raw = field_sign_extend(raw, loc.width);
+    }
+    *value = raw;
+    return CND_ERR_OK;
+}
+
+cnd_error_t cnd_field_write(const cnd_program* program, uint8_t* data, size_t len,
+                            uint16_t key_id, uint64_t value) {
+    if (!program || !program->bytecode || !data) return CND_ERR_OOB;
+
+    field_loc loc;
+    cnd_error_t err = field_locate(program, data, len, key_id, &loc);
+    if (err != CND_ERR_OK) return err;
+    if (!field_in_bounds(&loc, len)) return CND_ERR_OOB;
+
+    uint64_t raw = value;
+    if (loc.type == OP_IO_F32) {
+        double d;
+        memcpy(&d, &value, 8);
+        float f = (float)d;
+        uint32_t bits;
+        memcpy(&bits, &f, 4);
+        raw = bits;
+    } else if (loc.type == OP_IO_BOOL || loc.type == OP_IO_BIT_BOOL) {
+        if (value > 1) return CND_ERR_VALIDATION;
+    } else if (loc.type != OP_IO_F64 && loc.width < 64) {
+        // Integers must survive the round trip through the field width
+        uint64_t back = field_is_signed(loc.type) ? field_sign_extend(value, loc.width)
+                                                  : (value & (((uint64_t)1 << loc.width) - 1));
+        if (back != value) return CND_ERR_VALIDATION;
+    }
+
+    cnd_vm_ctx ctx;
+    field_ctx(&ctx, data, len, &loc);
+
+    if (loc.type == OP_IO_BIT_U || loc.type == OP_IO_BIT_I || loc.type == OP_IO_BIT_BOOL) {
+        write_bits(&ctx, raw, loc.width);
+        return CND_ERR_OK;
+    }
+    if (ctx.bit_offset != 0) return CND_ERR_INVALID_OP;
+    uint8_t* p = data + ctx.cursor;
+    switch (loc.width) {
+        case 8: write_u8(p, (uint8_t)raw); break;
+        case 16: write_u16(p, (uint16_t)raw, loc.endianness); break;
+        case 32: write_u32(p, (uint32_t)raw, loc.endianness); break;
+        default: write_u64(p, raw, loc.endianness); break;
+    }
+    return CND_ERR_OK;
+}
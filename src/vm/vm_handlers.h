@@ -0,0 +1,1412 @@
+#ifndef VM_HANDLERS_H
+#define VM_HANDLERS_H
+
+// Opcode handler building blocks shared by cnd_execute (bytecode) and
+// cnd_execute_prepared (pre-decoded instructions).
+//
+// The HANDLE_* macros expect the including interpreter to define:
+//   FETCH_KEY(ctx)        - yields the instruction's Key ID plus ctx->key_base
+//   SYNC_IP() / RELOAD_PC() - publish / reload the instruction pointer in ctx->ip
+//   TRY_BULK_ARRAY(count, err) - attempt the OP_RAW_BYTES / OP_ARR_SPAN path for the loop body at ctx->ip
+//   SKIP_LOOP()           - move ctx->ip past the matching OP_ARR_END
+//   VM_ENCODING           - true when encoding; a constant in mode-specialized loops
+//   VM_CALLBACK(key, op, ptr)        - deliver an event to the host
+//   VM_CALLBACK_SCALAR(key, op, ptr) - deliver a plain primitive value to the host
+// and a local `opcode` holding the IO opcode reported to the callback.
+
+#include "vm_internal.h"
+#include <string.h>
+
+#ifndef CND_NO_MATH
+#include <math.h>
+#endif
+
+// --- Math Helpers ---
+
+static inline double vm_math_poly_eval(cnd_vm_ctx* ctx, double x) {
+    double y = 0;
+    if (ctx->trans_poly_count > 0) {
+        uint64_t tmp;
+        memcpy(&tmp, ctx->trans_poly_data + (ctx->trans_poly_count - 1) * 8, 8);
+        memcpy(&y, &tmp, 8);
+        for (int i = ctx->trans_poly_count - 2; i >= 0; i--) {
+            double c;
+            memcpy(&tmp, ctx->trans_poly_data + i * 8, 8);
+            memcpy(&c, &tmp, 8);
+            y = y * x + c;
+        }
+    }
+    return y;
+}
+
+static inline double vm_math_poly_solve(cnd_vm_ctx* ctx, double target_y) {
+    double x = 0;
+    for(int iter=0; iter<20; iter++) {
+        double y = 0;
+        double dy = 0;
+        if (ctx->trans_poly_count > 0) {
+            uint64_t tmp;
+            memcpy(&tmp, ctx->trans_poly_data + (ctx->trans_poly_count - 1) * 8, 8);
+            memcpy(&y, &tmp, 8);
+            for (int i = ctx->trans_poly_count - 2; i >= 0; i--) {
+                double c;
+                memcpy(&tmp, ctx->trans_poly_data + i * 8, 8);
+                memcpy(&c, &tmp, 8);
+                dy = dy * x + y;
+                y = y * x + c;
+            }
+        }
+        double diff = y - target_y;
+        if (diff > -0.001 && diff < 0.001) break;
+        if (dy == 0) break;
+        x = x - diff / dy;
+    }
+    return x;
+}
+
+static inline double vm_math_spline_eval(cnd_vm_ctx* ctx, double x) {
+    double y = 0;
+    if (ctx->trans_spline_count >= 2) {
+        for (int i = 0; i < ctx->trans_spline_count - 1; i++) {
+            double x0, y0, x1, y1;
+            uint64_t tmp;
+            memcpy(&tmp, ctx->trans_spline_data + (i * 2) * 8, 8); memcpy(&x0, &tmp, 8);
+            memcpy(&tmp, ctx->trans_spline_data + (i * 2 + 1) * 8, 8); memcpy(&y0, &tmp, 8);
+            memcpy(&tmp, ctx->trans_spline_data + ((i + 1) * 2) * 8, 8); memcpy(&x1, &tmp, 8);
+            memcpy(&tmp, ctx->trans_spline_data + ((i + 1) * 2 + 1) * 8, 8); memcpy(&y1, &tmp, 8);
+            if ((x >= x0 && x <= x1) || (i == ctx->trans_spline_count - 2)) {
+                if (x1 == x0) y = y0;
+                else y = y0 + (x - x0) * (y1 - y0) / (x1 - x0);
+                break;
+            }
+        }
+    }
+    return y;
+}
+
+static inline double vm_math_spline_solve(cnd_vm_ctx* ctx, double target_y) {
+    double x = 0;
+    if (ctx->trans_spline_count >= 2) {
+        for (int i = 0; i < ctx->trans_spline_count - 1; i++) {
+            double x0, y0, x1, y1;
+            uint64_t tmp;
+            memcpy(&tmp, ctx->trans_spline_data + (i * 2) * 8, 8); memcpy(&x0, &tmp, 8);
+            memcpy(&tmp, ctx->trans_spline_data + (i * 2 + 1) * 8, 8); memcpy(&y0, &tmp, 8);
+            memcpy(&tmp, ctx->trans_spline_data + ((i + 1) * 2) * 8, 8); memcpy(&x1, &tmp, 8);
+            memcpy(&tmp, ctx->trans_spline_data + ((i + 1) * 2 + 1) * 8, 8); memcpy(&y1, &tmp, 8);
+            if ((target_y >= y0 && target_y <= y1) || (target_y <= y0 && target_y >= y1)) {
+                if (y1 == y0) x = x0;
+                else x = x0 + (target_y - y0) * (x1 - x0) / (y1 - y0);
+                break;
+            }
+        }
+    }
+    return x;
+}
+
+static inline int64_t vm_math_int_to_eng(cnd_vm_ctx* ctx, int64_t raw) {
+    switch(ctx->trans_type) {
+        case CND_TRANS_ADD_I64: return raw + ctx->trans_i_val;
+        case CND_TRANS_SUB_I64: return raw - ctx->trans_i_val;
+        case CND_TRANS_MUL_I64: return raw * ctx->trans_i_val;
+        case CND_TRANS_DIV_I64: return (ctx->trans_i_val != 0) ? raw / ctx->trans_i_val : raw;
+        default: return raw;
+    }
+}
+
+static inline int64_t vm_math_int_to_raw(cnd_vm_ctx* ctx, int64_t eng) {
+    switch(ctx->trans_type) {
+        case CND_TRANS_ADD_I64: return eng - ctx->trans_i_val;
+        case CND_TRANS_SUB_I64: return eng + ctx->trans_i_val;
+        case CND_TRANS_MUL_I64: return (ctx->trans_i_val != 0) ? eng / ctx->trans_i_val : eng;
+        case CND_TRANS_DIV_I64: return eng * ctx->trans_i_val;
+        default: return eng;
+    }
+}
+// --- Helpers / Macros to reduce repeated IO case code ---
+// HANDLE_PRIMITIVE(size, ctype, READ_EXPR, WRITE_EXPR)
+//   - size: number of bytes this IO consumes
+//   - ctype: C type used for the value (e.g. uint8_t)
+//   - READ_EXPR: expression to evaluate to read `ctype` from data buffer
+//   - WRITE_EXPR: expression to evaluate to write `val` into buffer
+//
+// HANDLE_PRIMITIVE picks the plain or transformed path at run time.
+// Interpreters that track a pending transform themselves use
+// HANDLE_PRIMITIVE_PLAIN / HANDLE_PRIMITIVE_TRANSFORM directly.
+
+// Shared prologue: alignment, key fetch, bounds check and @optional handling
+#define IO_FIELD_PROLOGUE(size, ctype) \
+      vm_align(ctx); \
+      uint16_t key = FETCH_KEY(ctx); \
+      if (ctx->cursor + (size) > ctx->data_len) { \
+          if (ctx->is_next_optional && !vm_stream_open(ctx)) { \
+              ctx->is_next_optional = false; \
+              ctype val = 0; \
+              SYNC_IP(); \
+              if (VM_CALLBACK(key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+              break; \
+          } \
+          return CND_ERR_OOB; \
+      }
+
+#define IO_FIELD_EPILOGUE(size) \
+      ctx->cursor += (size); \
+      ctx->is_next_optional = false; \
+      break;
+
+#define IO_PRIMITIVE_PLAIN(ctype, READ_EXPR, WRITE_EXPR) \
+      { \
+          ctype val = 0; \
+          if (VM_ENCODING) { \
+              SYNC_IP(); \
+              if (VM_CALLBACK_SCALAR(key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+              WRITE_EXPR; \
+          } else { \
+              val = (READ_EXPR); \
+              SYNC_IP(); \
+              if (VM_CALLBACK_SCALAR(key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+          } \
+      }
+
+#define IO_PRIMITIVE_TRANSFORM(ctype, READ_EXPR, WRITE_EXPR) \
+      { \
+          if (ctx->trans_type == CND_TRANS_SCALE_F64) { \
+              double eng_val = 0; \
+              if (VM_ENCODING) { \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+                  ctype val = (ctype)((eng_val - ctx->trans_f_offset) / ctx->trans_f_factor); \
+                  WRITE_EXPR; \
+              } else { \
+                  ctype raw = (READ_EXPR); \
+                  eng_val = (double)raw * ctx->trans_f_factor + ctx->trans_f_offset; \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+              } \
+          } else if (ctx->trans_type == CND_TRANS_POLY) { \
+              double eng_val = 0; \
+              if (VM_ENCODING) { \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+                  ctype val = (ctype)vm_math_poly_solve(ctx, eng_val); \
+                  WRITE_EXPR; \
+              } else { \
+                  ctype raw = (READ_EXPR); \
+                  eng_val = vm_math_poly_eval(ctx, (double)raw); \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+              } \
+          } else if (ctx->trans_type == CND_TRANS_SPLINE) { \
+              double eng_val = 0; \
+              if (VM_ENCODING) { \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+                  ctype val = (ctype)vm_math_spline_solve(ctx, eng_val); \
+                  WRITE_EXPR; \
+              } else { \
+                  ctype raw = (READ_EXPR); \
+                  eng_val = vm_math_spline_eval(ctx, (double)raw); \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+              } \
+          } else { \
+              int64_t eng_val = 0; \
+              if (VM_ENCODING) { \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_I64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+                  ctype val = (ctype)vm_math_int_to_raw(ctx, eng_val); \
+                  WRITE_EXPR; \
+              } else { \
+                  ctype raw = (READ_EXPR); \
+                  eng_val = vm_math_int_to_eng(ctx, (int64_t)raw); \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_I64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+              } \
+          } \
+          ctx->trans_type = CND_TRANS_NONE; \
+      }
+
+#define HANDLE_PRIMITIVE(size, ctype, READ_EXPR, WRITE_EXPR) \
+    { IO_FIELD_PROLOGUE(size, ctype) \
+      if (ctx->trans_type != CND_TRANS_NONE) IO_PRIMITIVE_TRANSFORM(ctype, READ_EXPR, WRITE_EXPR) \
+      else IO_PRIMITIVE_PLAIN(ctype, READ_EXPR, WRITE_EXPR) \
+      IO_FIELD_EPILOGUE(size) }
+
+#define HANDLE_PRIMITIVE_PLAIN(size, ctype, READ_EXPR, WRITE_EXPR) \
+    { IO_FIELD_PROLOGUE(size, ctype) \
+      IO_PRIMITIVE_PLAIN(ctype, READ_EXPR, WRITE_EXPR) \
+      IO_FIELD_EPILOGUE(size) }
+
+#define HANDLE_PRIMITIVE_TRANSFORM(size, ctype, READ_EXPR, WRITE_EXPR) \
+    { IO_FIELD_PROLOGUE(size, ctype) \
+      IO_PRIMITIVE_TRANSFORM(ctype, READ_EXPR, WRITE_EXPR) \
+      IO_FIELD_EPILOGUE(size) }
+
+// Helper for float/double where we must memcopy to/from an integer representation
+#define IO_FLOAT_PLAIN(ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
+      { \
+          ctype val = 0; \
+          if (VM_ENCODING) { \
+              SYNC_IP(); \
+              if (VM_CALLBACK_SCALAR(key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+              int_t t; memcpy(&t, &val, sizeof(t)); WRITE_INT_EXPR; \
+          } else { \
+              int_t t = (READ_INT_EXPR); memcpy(&val, &t, sizeof(t)); \
+              SYNC_IP(); \
+              if (VM_CALLBACK_SCALAR(key, opcode, &val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+          } \
+      }
+
+#define IO_FLOAT_TRANSFORM(ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
+      { \
+          if (ctx->trans_type == CND_TRANS_SCALE_F64) { \
+              double eng_val = 0; \
+              if (VM_ENCODING) { \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+                  ctype val = (ctype)((eng_val - ctx->trans_f_offset) / ctx->trans_f_factor); \
+                  int_t t; memcpy(&t, &val, sizeof(t)); WRITE_INT_EXPR; \
+              } else { \
+                  int_t t = (READ_INT_EXPR); ctype val; memcpy(&val, &t, sizeof(t)); \
+                  eng_val = (double)val * ctx->trans_f_factor + ctx->trans_f_offset; \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_F64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+              } \
+          } else { \
+              int64_t eng_val = 0; \
+              if (VM_ENCODING) { \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_I64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+                  int64_t raw64 = eng_val; \
+                  switch(ctx->trans_type) { \
+                      case CND_TRANS_ADD_I64: raw64 -= ctx->trans_i_val; break; \
+                      case CND_TRANS_SUB_I64: raw64 += ctx->trans_i_val; break; \
+                      case CND_TRANS_MUL_I64: if(ctx->trans_i_val!=0) raw64 /= ctx->trans_i_val; break; \
+                      case CND_TRANS_DIV_I64: raw64 *= ctx->trans_i_val; break; \
+                      default: break; \
+                  } \
+                  ctype val = (ctype)raw64; \
+                  int_t t; memcpy(&t, &val, sizeof(t)); WRITE_INT_EXPR; \
+              } else { \
+                  int_t t = (READ_INT_EXPR); ctype val; memcpy(&val, &t, sizeof(t)); \
+                  int64_t raw64 = (int64_t)val; \
+                  switch(ctx->trans_type) { \
+                      case CND_TRANS_ADD_I64: raw64 += ctx->trans_i_val; break; \
+                      case CND_TRANS_SUB_I64: raw64 -= ctx->trans_i_val; break; \
+                      case CND_TRANS_MUL_I64: raw64 *= ctx->trans_i_val; break; \
+                      case CND_TRANS_DIV_I64: if(ctx->trans_i_val!=0) raw64 /= ctx->trans_i_val; break; \
+                      default: break; \
+                  } \
+                  eng_val = raw64; \
+                  SYNC_IP(); \
+                  if (VM_CALLBACK(key, OP_IO_I64, &eng_val) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+              } \
+          } \
+          ctx->trans_type = CND_TRANS_NONE; \
+      }
+
+#define HANDLE_FLOAT(size, ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
+    { IO_FIELD_PROLOGUE(size, ctype) \
+      if (ctx->trans_type != CND_TRANS_NONE) IO_FLOAT_TRANSFORM(ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
+      else IO_FLOAT_PLAIN(ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
+      IO_FIELD_EPILOGUE(size) }
+
+#define HANDLE_FLOAT_PLAIN(size, ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
+    { IO_FIELD_PROLOGUE(size, ctype) \
+      IO_FLOAT_PLAIN(ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
+      IO_FIELD_EPILOGUE(size) }
+
+#define HANDLE_FLOAT_TRANSFORM(size, ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
+    { IO_FIELD_PROLOGUE(size, ctype) \
+      IO_FLOAT_TRANSFORM(ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
+      IO_FIELD_EPILOGUE(size) }
+
+// --- Binding Helpers ---
+
+// Inline path for plain primitives in the bound loops: a field or array
+// element whose host type matches is copied directly. Anything else goes
+// through cnd_bind_io, which converts types and reports errors.
+static inline cnd_error_t vm_bind_scalar(cnd_vm_ctx* ctx, uint16_t key, uint8_t type,
+                                         void* val, size_t size, bool encode) {
+    cnd_binder* b = (cnd_binder*)ctx->user_ptr;
+    if (key < b->count && b->depth > 0) {
+        const cnd_binding* e = &b->table[key];
+        cnd_bind_frame* f = &b->frames[b->depth - 1];
+        if (e->type == type) {
+            uint8_t* p = NULL;
+            if (f->key == key) {
+                if (f->index < f->limit) p = f->elems + (size_t)f->index++ * f->stride;
+            } else if (e->stride == 0) {
+                p = f->base + e->offset;
+            }
+            if (p) {
+                if (encode) memcpy(val, p, size);
+                else memcpy(p, val, size);
+                return CND_ERR_OK;
+            }
+        }
+    }
+    return cnd_bind_io(ctx, key, type, val);
+}
+
+// Structural events in the bound loops. `type` is a constant at every call
+// site, so entering and leaving array elements folds to a few stores.
+static inline cnd_error_t vm_bind_event(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, void* ptr) {
+    cnd_binder* b = (cnd_binder*)ctx->user_ptr;
+    if (type == OP_ENTER_STRUCT && key < b->count && b->depth > 0 && b->depth < CND_MAX_BIND_DEPTH) {
+        cnd_bind_frame* f = &b->frames[b->depth - 1];
+        if (f->key == key && f->index < f->limit && b->table[key].type == OP_ENTER_STRUCT) {
+            cnd_bind_frame* n = &b->frames[b->depth++];
+            n->base = f->elems + (size_t)f->index++ * f->stride;
+            n->key = 0xFFFF;
+            return CND_ERR_OK;
+        }
+    } else if (type == OP_EXIT_STRUCT && b->depth > 1 && b->frames[b->depth - 1].key == 0xFFFF) {
+        b->depth--;
+        return CND_ERR_OK;
+    }
+    return cnd_bind_io(ctx, key, type, ptr);
+}
+
+// --- Loop Stack Helpers ---
+
+static inline bool loop_push(cnd_vm_ctx* ctx, size_t start_ip, uint32_t count) {
+    if (ctx->loop_depth >= CND_MAX_LOOP_DEPTH) return false;
+    ctx->loop_stack[ctx->loop_depth].start_ip = start_ip;
+    ctx->loop_stack[ctx->loop_depth].remaining = count;
+    ctx->loop_depth++;
+    return true;
+}
+
+static inline void loop_pop(cnd_vm_ctx* ctx) {
+    if (ctx->loop_depth > 0) ctx->loop_depth--;
+}
+
+// --- Array/String Helpers ---
+
+#define HANDLE_ARRAY_PRE(size, ctype, READ_EXPR, WRITE_EXPR) \
+    { \
+        vm_align(ctx); \
+        uint16_t key = FETCH_KEY(ctx); \
+        ctype count = 0; \
+        if (VM_ENCODING) { \
+            SYNC_IP(); \
+            if (VM_CALLBACK(key, opcode, &count) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+            if (ctx->cursor + (size) > ctx->data_len) return CND_ERR_OOB; \
+            WRITE_EXPR; \
+            ctx->cursor += (size); \
+        } else { \
+            if (ctx->cursor + (size) > ctx->data_len) return CND_ERR_OOB; \
+            count = (READ_EXPR); \
+            ctx->cursor += (size); \
+            SYNC_IP(); \
+            if (VM_CALLBACK(key, opcode, &count) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+        } \
+        if (count > 0) { \
+            SYNC_IP(); \
+            cnd_error_t bulk_err; \
+            if (TRY_BULK_ARRAY((uint32_t)count, &bulk_err)) { if (bulk_err != CND_ERR_OK) return bulk_err; RELOAD_PC(); break; } \
+            if (!loop_push(ctx, ctx->ip, (uint32_t)count)) return CND_ERR_OOB; \
+        } else { \
+             SYNC_IP(); \
+             SKIP_LOOP(); \
+             RELOAD_PC(); \
+        } \
+        break; \
+    }
+
+#define HANDLE_STRING_PRE(size, ctype, READ_EXPR, WRITE_EXPR) \
+    { \
+        vm_align(ctx); \
+        uint16_t key = FETCH_KEY(ctx); \
+        const char* str = NULL; \
+        if (VM_ENCODING) { \
+            SYNC_IP(); \
+            if (VM_CALLBACK(key, opcode, &str) != CND_ERR_OK) { \
+                if (ctx->is_next_optional) { \
+                    ctx->is_next_optional = false; \
+                    break; \
+                } \
+                return CND_ERR_CALLBACK; \
+            } \
+            size_t len = str ? strlen(str) : 0; \
+            ctype max_val = (ctype)-1; \
+            if (len > (size_t)max_val) len = (size_t)max_val; \
+            if (ctx->cursor + (size) + len > ctx->data_len) return CND_ERR_OOB; \
+            ctype len_val = (ctype)len; \
+            WRITE_EXPR; \
+            memcpy(ctx->data_buffer + ctx->cursor + (size), str, len); \
+            ctx->cursor += (size) + len; \
+        } else { \
+            if (ctx->cursor + (size) > ctx->data_len) return CND_ERR_OOB; \
+            ctype len_val = (READ_EXPR); \
+            if (ctx->cursor + (size) + len_val > ctx->data_len) return CND_ERR_OOB; \
+            const char* ptr = (const char*)(ctx->data_buffer + ctx->cursor + (size)); \
+            SYNC_IP(); \
+            if (VM_CALLBACK(key, opcode, (void*)ptr) != CND_ERR_OK) return CND_ERR_CALLBACK; \
+            ctx->cursor += (size) + len_val; \
+        } \
+        ctx->is_next_optional = false; \
+        break; \
+    }
+
+// Byte-aligned opcodes flush a partially consumed bit field first. Each
+// handler that needs it calls vm_align() itself; ALIGN_TABLE remains the
+// reference for opcodes the interpreters do not implement.
+static inline void vm_align(cnd_vm_ctx* ctx) {
+    if (ctx->bit_offset != 0) {
+        ctx->cursor++;
+        ctx->bit_offset = 0;
+    }
+}
+
+static inline int64_t sign_extend(uint64_t val, uint8_t bits) {
+    if (bits >= 64) return (int64_t)val;
+    uint64_t m = 1ULL << (bits - 1);
+    return (int64_t)((val ^ m) - m);
+}
+
+static const bool ALIGN_TABLE[256] = {
+    // 0x00 - 0x0F (Meta & State) - No alignment
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    // 0x10 - 0x1F (Primitives) - Align
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    // 0x20 - 0x2F (Bitfields) - No alignment
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    // 0x30 - 0x3F (Arrays & Strings) - Align
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    // 0x40 - 0x4F (Validation)
+    1, // 0x40 CONST_CHECK
+    1, // 0x41 CONST_WRITE
+    0, // 0x42 RANGE_CHECK
+    0, // 0x43 SCALE_LIN
+    1, // 0x44 CRC_16
+    0, // 0x45 TRANS_ADD
+    0, // 0x46 TRANS_SUB
+    0, // 0x47 TRANS_MUL
+    0, // 0x48 TRANS_DIV
+    1, // 0x49 CRC_32
+    0, // 0x4A MARK_OPTIONAL
+    1, // 0x4B ENUM_CHECK
+    1, 1, 1, 1, // 0x4C - 0x4F
+    // 0x50 - 0xFF (Control Flow & Others) - No alignment
+    0 // ... rest 0
+};
+
+// Helper for stack operations
+static inline cnd_error_t stack_push(cnd_vm_ctx* ctx, uint64_t val) {
+    if (ctx->expr_sp >= CND_MAX_EXPR_STACK) return CND_ERR_STACK_OVERFLOW;
+    ctx->expr_stack[ctx->expr_sp++] = val;
+    return CND_ERR_OK;
+}
+
+static inline cnd_error_t stack_pop(cnd_vm_ctx* ctx, uint64_t* val) {
+    if (ctx->expr_sp == 0) return CND_ERR_STACK_UNDERFLOW;
+    *val = ctx->expr_stack[--ctx->expr_sp];
+    return CND_ERR_OK;
+}
+
+// --- Decoded Opcode Bodies ---
+// Everything below runs after the instruction's IL operands have been decoded,
+// so both interpreters share it. Callers SYNC_IP() before calling any helper
+// that may invoke the IO callback.
+
+static inline void vm_write_sized(cnd_vm_ctx* ctx, uint32_t size, uint64_t val) {
+    if (size == 1) write_u8(ctx->data_buffer + ctx->cursor, (uint8_t)val);
+    else if (size == 2) write_u16(ctx->data_buffer + ctx->cursor, (uint16_t)val, ctx->endianness);
+    else if (size == 4) write_u32(ctx->data_buffer + ctx->cursor, (uint32_t)val, ctx->endianness);
+    else if (size == 8) write_u64(ctx->data_buffer + ctx->cursor, val, ctx->endianness);
+}
+
+static inline uint64_t vm_read_sized(const cnd_vm_ctx* ctx, size_t at, uint32_t size) {
+    if (size == 1) return read_u8(ctx->data_buffer + at);
+    if (size == 2) return read_u16(ctx->data_buffer + at, ctx->endianness);
+    if (size == 4) return read_u32(ctx->data_buffer + at, ctx->endianness);
+    return read_u64(ctx->data_buffer + at, ctx->endianness);
+}
+
+// --- Scoreboard ---
+
+static inline void vm_slot_set(cnd_vm_ctx* ctx, uint16_t key, uint64_t val) {
+    uint32_t s = key & (CND_SCOREBOARD_SLOTS - 1);
+    ctx->slot_keys[s] = key;
+    ctx->slot_values[s] = val;
+    ctx->slot_valid |= (uint16_t)(1u << s);
+}
+
+static inline bool vm_slot_get(const cnd_vm_ctx* ctx, uint16_t key, uint64_t* val) {
+    uint32_t s = key & (CND_SCOREBOARD_SLOTS - 1);
+    if (!((ctx->slot_valid >> s) & 1) || ctx->slot_keys[s] != key) return false;
+    *val = ctx->slot_values[s];
+    return true;
+}
+
+// The integer or bool field of `type` that ends at the cursor, as hosts report
+// it in expression context: signed types sign-extended, booleans 0 or 1
+static inline uint64_t vm_slot_field(const cnd_vm_ctx* ctx, uint8_t type) {
+    uint32_t size = il_type_size(type);
+    uint64_t v = vm_read_sized(ctx, ctx->cursor - size, size);
+    switch (type) {
+        case OP_IO_I8:   return (uint64_t)(int64_t)(int8_t)v;
+        case OP_IO_I16:  return (uint64_t)(int64_t)(int16_t)v;
+        case OP_IO_I32:  return (uint64_t)(int64_t)(int32_t)v;
+        case OP_IO_BOOL: return v != 0;
+        default:         return v;
+    }
+}
+
+// Value of context key `key` for `op` (OP_LOAD_CTX or OP_CTX_QUERY): from the
+// scoreboard, or from the host
+static inline cnd_error_t vm_ctx_value(cnd_vm_ctx* ctx, uint16_t key, uint8_t op, uint64_t* val) {
+    if (vm_slot_get(ctx, key, val)) return CND_ERR_OK;
+    return ctx->io_callback(ctx, key, op, val);
+}
+
+static inline cnd_error_t vm_op_const_write(cnd_vm_ctx* ctx, uint8_t type, uint64_t val) {
+    uint32_t size;
+    switch (type) {
+        case OP_IO_U8: size = 1; break;
+        case OP_IO_U16: size = 2; break;
+        case OP_IO_U32: size = 4; break;
+        case OP_IO_U64: size = 8; break;
+        default: return CND_ERR_INVALID_OP;
+    }
+    if (ctx->cursor + size > ctx->data_len) return CND_ERR_OOB;
+    vm_write_sized(ctx, size, val);
+    ctx->cursor += size;
+    return CND_ERR_OK;
+}
+
+static inline cnd_error_t vm_op_const_check(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, uint64_t expected) {
+    uint32_t size;
+    switch (type) {
+        case OP_IO_U8: case OP_IO_I8: size = 1; break;
+        case OP_IO_U16: case OP_IO_I16: size = 2; break;
+        case OP_IO_U32: case OP_IO_I32: size = 4; break;
+        case OP_IO_U64: case OP_IO_I64: size = 8; break;
+        default: return CND_ERR_INVALID_OP;
+    }
+    if (ctx->cursor + size > ctx->data_len) return CND_ERR_OOB;
+
+    if (ctx->mode == CND_MODE_ENCODE) {
+        vm_write_sized(ctx, size, expected);
+    } else {
+        uint64_t actual = vm_read_sized(ctx, ctx->cursor, size);
+        if (actual != expected) return CND_ERR_VALIDATION;
+
+        // Notify host (Read-Only)
+        cnd_error_t cb;
+        if (size == 1) { uint8_t v = (uint8_t)actual; cb = ctx->io_callback(ctx, key, type, &v); }
+        else if (size == 2) { uint16_t v = (uint16_t)actual; cb = ctx->io_callback(ctx, key, type, &v); }
+        else if (size == 4) { uint32_t v = (uint32_t)actual; cb = ctx->io_callback(ctx, key, type, &v); }
+        else { uint64_t v = actual; cb = ctx->io_callback(ctx, key, type, &v); }
+        if (cb != CND_ERR_OK) return CND_ERR_CALLBACK;
+    }
+    ctx->cursor += size;
+    return CND_ERR_OK;
+}
+
+// `values` points at `count` little-endian IL values of the type's size.
+static inline cnd_error_t vm_op_enum_check(cnd_vm_ctx* ctx, uint8_t type, uint16_t count, const uint8_t* values) {
+    uint32_t size;
+    switch (type) {
+        case OP_IO_U8: case OP_IO_I8: size = 1; break;
+        case OP_IO_U16: case OP_IO_I16: size = 2; break;
+        case OP_IO_U32: case OP_IO_I32: size = 4; break;
+        case OP_IO_U64: case OP_IO_I64: size = 8; break;
+        default: return CND_ERR_INVALID_OP;
+    }
+    if (ctx->cursor < size) return CND_ERR_OOB;
+    // Values are compared at their stored width, so signedness does not matter.
+    uint64_t actual = vm_read_sized(ctx, ctx->cursor - size, size);
+    for (uint16_t i = 0; i < count; i++) {
+        const uint8_t* v = values + (size_t)i * size;
+        uint64_t val;
+        if (size == 1) val = v[0];
+        else if (size == 2) val = il_get_u16(v);
+        else if (size == 4) val = il_get_u32(v);
+        else val = il_get_u64(v);
+        if (actual == val) return CND_ERR_OK;
+    }
+    return CND_ERR_VALIDATION;
+}
+
+// OP_ENUM_BITMAP: bit (v - base) of `bits` must be set. The subtraction wraps
+// at the type's width, so one test covers signed and unsigned windows.
+static inline cnd_error_t vm_op_enum_bitmap(cnd_vm_ctx* ctx, uint8_t type, uint64_t base, uint16_t span, const uint8_t* bits) {
+    uint32_t size = il_type_size(type);
+    if (size == 0 || type == OP_IO_BOOL || type == OP_IO_F32 || type == OP_IO_F64) return CND_ERR_INVALID_OP;
+    if (ctx->cursor < size) return CND_ERR_OOB;
+    uint64_t mask = (size == 8) ? UINT64_MAX : (((uint64_t)1 << (size * 8)) - 1);
+    uint64_t index = (vm_read_sized(ctx, ctx->cursor - size, size) - base) & mask;
+    if (index < span && (bits[index >> 3] & (1u << (index & 7)))) return CND_ERR_OK;
+    return CND_ERR_VALIDATION;
+}
+
+// OP_ENUM_SORTED: binary search over values ascending at their stored width
+static inline cnd_error_t vm_op_enum_sorted(cnd_vm_ctx* ctx, uint8_t type, uint16_t count, const uint8_t* values) {
+    uint32_t size = il_type_size(type);
+    if (size == 0 || type == OP_IO_BOOL || type == OP_IO_F32 || type == OP_IO_F64) return CND_ERR_INVALID_OP;
+    if (ctx->cursor < size) return CND_ERR_OOB;
+    uint64_t actual = vm_read_sized(ctx, ctx->cursor - size, size);
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) >> 1;
+        const uint8_t* v = values + (size_t)mid * size;
+        uint64_t val;
+        if (size == 1) val = v[0];
+        else if (size == 2) val = il_get_u16(v);
+        else if (size == 4) val = il_get_u32(v);
+        else val = il_get_u64(v);
+        if (actual == val) return CND_ERR_OK;
+        if (val < actual) lo = mid + 1;
+        else hi = mid;
+    }
+    return CND_ERR_VALIDATION;
+}
+
+#define VM_RANGE_INT(ctype, size) \
+    { \
+        ctype min = (ctype)lo; \
+        ctype max = (ctype)hi; \
+        ctype val = (ctype)vm_read_sized(ctx, ctx->cursor - (size), (size)); \
+        if (val < min || val > max) return CND_ERR_VALIDATION; \
+        break; \
+    }
+
+// `lo` and `hi` carry the IL bounds zero-extended from the type's size.
+// The checked value is the one just transferred (ending at the cursor).
+static inline cnd_error_t vm_op_range_check(cnd_vm_ctx* ctx, uint8_t type, uint64_t lo, uint64_t hi) {
+    uint32_t size = il_type_size(type);
+    if (size == 0 || type == OP_IO_BOOL) return CND_ERR_INVALID_OP;
+    if (ctx->cursor < size) return CND_ERR_OOB;
+
+    switch (type) {
+        case OP_IO_U8:  VM_RANGE_INT(uint8_t, 1)
+        case OP_IO_I8:  VM_RANGE_INT(int8_t, 1)
+        case OP_IO_U16: VM_RANGE_INT(uint16_t, 2)
+        case OP_IO_I16: VM_RANGE_INT(int16_t, 2)
+        case OP_IO_U32: VM_RANGE_INT(uint32_t, 4)
+        case OP_IO_I32: VM_RANGE_INT(int32_t, 4)
+        case OP_IO_U64: VM_RANGE_INT(uint64_t, 8)
+        case OP_IO_I64: VM_RANGE_INT(int64_t, 8)
+        case OP_IO_F32: {
+            uint32_t imin = (uint32_t)lo, imax = (uint32_t)hi;
+            uint32_t ival = (uint32_t)vm_read_sized(ctx, ctx->cursor - 4, 4);
+            float min, max, val;
+            memcpy(&min, &imin, 4); memcpy(&max, &imax, 4); memcpy(&val, &ival, 4);
+            if (val < min || val > max) return CND_ERR_VALIDATION;
+            break;
+        }
+        case OP_IO_F64: {
+            uint64_t ival = vm_read_sized(ctx, ctx->cursor - 8, 8);
+            double min, max, val;
+            memcpy(&min, &lo, 8); memcpy(&max, &hi, 8); memcpy(&val, &ival, 8);
+            if (val < min || val > max) return CND_ERR_VALIDATION;
+            break;
+        }
+        default: return CND_ERR_INVALID_OP;
+    }
+    return CND_ERR_OK;
+}
+
+#undef VM_RANGE_INT
+
+static inline uint64_t vm_il_sized(const uint8_t* b, uint32_t size) {
+    if (size == 1) return b[0];
+    if (size == 2) return il_get_u16(b);
+    if (size == 4) return il_get_u32(b);
+    return il_get_u64(b);
+}
+
+// Runs the check instruction embedded in an OP_IO_CHECK, at most `avail`
+// bytes long, and stores its length in *len.
+static inline cnd_error_t vm_op_check_insn(cnd_vm_ctx* ctx, const uint8_t* insn, size_t avail, size_t* len) {
+    if (avail < 2) return CND_ERR_OOB;
+    uint8_t type = insn[1];
+    uint32_t size = il_type_size(type);
+    if (size == 0) return CND_ERR_INVALID_OP;
+
+    switch (insn[0]) {
+        case OP_RANGE_CHECK:
+            *len = 2 + 2 * (size_t)size;
+            if (avail < *len) return CND_ERR_OOB;
+            return vm_op_range_check(ctx, type, vm_il_sized(insn + 2, size), vm_il_sized(insn + 2 + size, size));
+        case OP_ENUM_CHECK:
+        case OP_ENUM_SORTED: {
+            if (avail < 4) return CND_ERR_OOB;
+            uint16_t count = il_get_u16(insn + 2);
+            *len = 4 + (size_t)count * size;
+            if (avail < *len) return CND_ERR_OOB;
+            if (insn[0] == OP_ENUM_CHECK) return vm_op_enum_check(ctx, type, count, insn + 4);
+            return vm_op_enum_sorted(ctx, type, count, insn + 4);
+        }
+        case OP_ENUM_BITMAP: {
+            if (avail < 4 + (size_t)size) return CND_ERR_OOB;
+            uint16_t span = il_get_u16(insn + 2 + size);
+            *len = 4 + (size_t)size + ((size_t)span + 7) / 8;
+            if (avail < *len) return CND_ERR_OOB;
+            return vm_op_enum_bitmap(ctx, type, vm_il_sized(insn + 2, size), span, insn + 4 + size);
+        }
+        default:
+            return CND_ERR_INVALID_OP;
+    }
+}
+
+static inline void vm_op_crc_begin(cnd_vm_ctx* ctx) {
+    ctx->crc_start = ctx->cursor;
+    ctx->crc_end = SIZE_MAX;
+    ctx->crc_width = 0;
+}
+
+static inline void vm_op_crc_end(cnd_vm_ctx* ctx) {
+    ctx->crc_end = ctx->cursor;
+}
+
+static inline cnd_error_t vm_op_crc(cnd_vm_ctx* ctx, uint32_t poly, uint32_t init, uint32_t xorout, uint8_t flags, int width) {
+    uint32_t crc = vm_crc_region(ctx, poly, init, xorout, flags, width);
+    size_t size = (size_t)width / 8;
+
+    if (ctx->cursor + size > ctx->data_len) return CND_ERR_OOB;
+
+    if (ctx->mode == CND_MODE_ENCODE) {
+        if (width == 16) write_u16(ctx->data_buffer + ctx->cursor, (uint16_t)crc, ctx->endianness);
+        else write_u32(ctx->data_buffer + ctx->cursor, crc, ctx->endianness);
+    } else {
+        uint32_t actual = (width == 16) ? read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness)
+                                        : read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness);
+        uint32_t expected = (width == 16) ? (uint16_t)crc : crc;
+        if (actual != expected) return CND_ERR_CRC_MISMATCH;
+    }
+    ctx->cursor += size;
+    return CND_ERR_OK;
+}
+
+static inline cnd_error_t vm_op_io_bool(cnd_vm_ctx* ctx, uint16_t key) {
+    uint8_t val = 0;
+    if (ctx->cursor + 1 > ctx->data_len) {
+        if (ctx->is_next_optional && !vm_stream_open(ctx)) {
+            ctx->is_next_optional = false;
+            if (ctx->io_callback(ctx, key, OP_IO_BOOL, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+            return CND_ERR_OK;
+        }
+        return CND_ERR_OOB;
+    }
+    if (ctx->mode == CND_MODE_ENCODE) {
+        if (ctx->io_callback(ctx, key, OP_IO_BOOL, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+        if (val > 1) return CND_ERR_VALIDATION;
+        write_u8(ctx->data_buffer + ctx->cursor, val);
+    } else {
+        val = read_u8(ctx->data_buffer + ctx->cursor);
+        if (val > 1) return CND_ERR_VALIDATION;
+        if (ctx->io_callback(ctx, key, OP_IO_BOOL, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+    }
+    ctx->cursor += 1;
+    ctx->is_next_optional = false;
+    return CND_ERR_OK;
+}
+
+static inline cnd_error_t vm_op_bit_u(cnd_vm_ctx* ctx, uint16_t key, uint8_t bits) {
+    uint64_t v = 0;
+    if (ctx->mode == CND_MODE_ENCODE) {
+        if (ctx->io_callback(ctx, key, OP_IO_BIT_U, &v) != CND_ERR_OK) return CND_ERR_CALLBACK;
+        write_bits(ctx, v, bits);
+    } else {
+        if (vm_stream_open(ctx) && !bits_in_bounds(ctx, bits)) return CND_ERR_OOB;
+        v = read_bits(ctx, bits);
+        if (ctx->io_callback(ctx, key, OP_IO_BIT_U, &v) != CND_ERR_OK) return CND_ERR_CALLBACK;
+    }
+    return CND_ERR_OK;
+}
+
+static inline cnd_error_t vm_op_bit_i(cnd_vm_ctx* ctx, uint16_t key, uint8_t bits) {
+    int64_t v = 0;
+    if (ctx->mode == CND_MODE_ENCODE) {
+        if (ctx->io_callback(ctx, key, OP_IO_BIT_I, &v) != CND_ERR_OK) return CND_ERR_CALLBACK;
+        write_bits(ctx, (uint64_t)v, bits);
+    } else {
+        if (vm_stream_open(ctx) && !bits_in_bounds(ctx, bits)) return CND_ERR_OOB;
+        v = sign_extend(read_bits(ctx, bits), bits);
+        if (ctx->io_callback(ctx, key, OP_IO_BIT_I, &v) != CND_ERR_OK) return CND_ERR_CALLBACK;
+    }
+    return CND_ERR_OK;
+}
+
+static inline cnd_error_t vm_op_bit_bool(cnd_vm_ctx* ctx, uint16_t key) {
+    uint8_t v = 0;
+    if (ctx->mode == CND_MODE_ENCODE) {
+        if (ctx->io_callback(ctx, key, OP_IO_BIT_BOOL, &v) != CND_ERR_OK) return CND_ERR_CALLBACK;
+        if (v > 1) return CND_ERR_VALIDATION;
+        write_bits(ctx, (uint64_t)v, 1);
+    } else {
+        if (vm_stream_open(ctx) && !bits_in_bounds(ctx, 1)) return CND_ERR_OOB;
+        v = (uint8_t)read_bits(ctx, 1);
+        if (ctx->io_callback(ctx, key, OP_IO_BIT_BOOL, &v) != CND_ERR_OK) return CND_ERR_CALLBACK;
+    }
+    return CND_ERR_OK;
+}
+
+// --- Bit Groups ---
+//
+// OP_IO_BIT_GROUP reads or writes its fields' container with one bit-stream
+// access. Field events look exactly like those of single OP_IO_BIT_* ops:
+// the cursor sits at the end of the field (decode) or at its start (encode),
+// and with `track_ip` ctx->ip points just past the field's descriptor, which
+// has the same Type/Key/Width shape as a single bitfield instruction.
+
+static inline void bit_group_seek(cnd_vm_ctx* ctx, uint64_t bit) {
+    ctx->cursor = (size_t)(bit >> 3);
+    ctx->bit_offset = (uint8_t)(bit & 7);
+}
+
+// Fallback: one bit-stream access per field (groups reaching past the buffer)
+static inline cnd_error_t vm_bit_group_each(cnd_vm_ctx* ctx, const uint8_t* fields, uint8_t count, size_t fields_ip, bool track_ip) {
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t* f = fields + (size_t)i * 4;
+        uint16_t key = (uint16_t)(il_get_u16(f + 1) + ctx->key_base);
+        cnd_error_t err;
+        if (track_ip) ctx->ip = fields_ip + (size_t)(i + 1) * 4;
+        if (f[0] == OP_IO_BIT_U) err = vm_op_bit_u(ctx, key, f[3]);
+        else if (f[0] == OP_IO_BIT_I) err = vm_op_bit_i(ctx, key, f[3]);
+        else err = vm_op_bit_bool(ctx, key);
+        if (err != CND_ERR_OK) return err;
+    }
+    return CND_ERR_OK;
+}
+
+static inline cnd_error_t vm_op_bit_group(cnd_vm_ctx* ctx, const uint8_t* fields, uint8_t count, bool track_ip) {
+    size_t ip = ctx->ip;
+    size_t fields_ip = track_ip ? (size_t)(fields - ctx->program->bytecode) : 0;
+    bool be = (ctx->endianness == CND_BE);
+    // cnd_execute runs unverified IL: the group event holds at most
+    // CND_MAX_BIT_GROUP values, and zero widths would slip past `total`
+    if (count == 0 || count > CND_MAX_BIT_GROUP) return CND_ERR_INVALID_OP;
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t w = fields[(size_t)i * 4 + 3];
+        if (w == 0) return CND_ERR_INVALID_OP;
+        total += w;
+    }
+
+    // A stream decodes the group only once all of it has arrived
+    if (ctx->mode == CND_MODE_DECODE && vm_stream_open(ctx)) {
+        size_t nbytes = ((size_t)ctx->bit_offset + total + 7) >> 3;
+        if (ctx->cursor > ctx->data_len || nbytes > ctx->data_len - ctx->cursor) return CND_ERR_OOB;
+    }
+
+    cnd_error_t err = CND_ERR_OK;
+    if (total > 64 || !bits_in_bounds(ctx, (uint8_t)total)) {
+        err = vm_bit_group_each(ctx, fields, count, fields_ip, track_ip);
+        ctx->ip = ip;
+        return err;
+    }
+
+    uint64_t start = (uint64_t)ctx->cursor * 8 + ctx->bit_offset;
+    bool grouped = false;
+    cnd_bit_group group;
+
+    if (ctx->mode == CND_MODE_ENCODE) {
+        uint64_t word = 0;
+        uint32_t cum = 0;
+        if (ctx->flags & CND_CTX_BIT_GROUPS) {
+            memset(group.values, 0, sizeof(uint64_t) * count);
+            group.word = 0;
+            group.fields = fields;
+            group.count = count;
+            group.bits = (uint8_t)total;
+            group.key_base = ctx->key_base;
+            grouped = ctx->io_callback(ctx, (uint16_t)(il_get_u16(fields + 1) + ctx->key_base), OP_IO_BIT_GROUP, &group) == CND_ERR_OK;
+        }
+        for (uint8_t i = 0; i < count && err == CND_ERR_OK; i++) {
+            const uint8_t* f = fields + (size_t)i * 4;
+            uint8_t w = f[3];
+            uint64_t v = 0;
+            if (grouped) {
+                v = group.values[i];
+                if (f[0] == OP_IO_BIT_BOOL && v > 1) err = CND_ERR_VALIDATION;
+            } else {
+                uint16_t key = (uint16_t)(il_get_u16(f + 1) + ctx->key_base);
+                bit_group_seek(ctx, start + cum);
+                if (track_ip) ctx->ip = fields_ip + (size_t)(i + 1) * 4;
+                if (f[0] == OP_IO_BIT_BOOL) {
+                    uint8_t b = 0;
+                    if (ctx->io_callback(ctx, key, OP_IO_BIT_BOOL, &b) != CND_ERR_OK) err = CND_ERR_CALLBACK;
+                    else if (b > 1) err = CND_ERR_VALIDATION;
+                    v = b;
+                } else if (ctx->io_callback(ctx, key, f[0], &v) != CND_ERR_OK) {
+                    err = CND_ERR_CALLBACK;
+                }
+            }
+            v &= bit_mask(w);
+            if (be) word = (w >= 64) ? v : (word << w) | v;
+            else word |= (cum >= 64) ? 0 : v << cum;
+            cum += w;
+        }
+        bit_group_seek(ctx, start);
+        if (err == CND_ERR_OK) write_bits(ctx, word, (uint8_t)total);
+    } else {
+        uint64_t word = read_bits(ctx, (uint8_t)total);
+        if (ctx->flags & CND_CTX_BIT_GROUPS) {
+            uint32_t cum = 0;
+            for (uint8_t i = 0; i < count; i++) {
+                const uint8_t* f = fields + (size_t)i * 4;
+                uint8_t w = f[3];
+                cum += w;
+                uint64_t v = (word >> (be ? total - cum : cum - w)) & bit_mask(w);
+                group.values[i] = (f[0] == OP_IO_BIT_I) ? (uint64_t)sign_extend(v, w) : v;
+            }
+            group.word = word;
+            group.fields = fields;
+            group.count = count;
+            group.bits = (uint8_t)total;
+            group.key_base = ctx->key_base;
+            grouped = ctx->io_callback(ctx, (uint16_t)(il_get_u16(fields + 1) + ctx->key_base), OP_IO_BIT_GROUP, &group) == CND_ERR_OK;
+        }
+        uint32_t cum = 0;
+        for (uint8_t i = 0; i < count && !grouped; i++) {
+            const uint8_t* f = fields + (size_t)i * 4;
+            uint8_t w = f[3];
+            uint16_t key = (uint16_t)(il_get_u16(f + 1) + ctx->key_base);
+            cum += w;
+            uint64_t v = (word >> (be ? total - cum : cum - w)) & bit_mask(w);
+            bit_group_seek(ctx, start + cum);
+            if (track_ip) ctx->ip = fields_ip + (size_t)(i + 1) * 4;
+            cnd_error_t cb;
+            if (f[0] == OP_IO_BIT_U) {
+                cb = ctx->io_callback(ctx, key, OP_IO_BIT_U, &v);
+            } else if (f[0] == OP_IO_BIT_I) {
+                int64_t s = sign_extend(v, w);
+                cb = ctx->io_callback(ctx, key, OP_IO_BIT_I, &s);
+            } else {
+                uint8_t b = (uint8_t)v;
+                cb = ctx->io_callback(ctx, key, OP_IO_BIT_BOOL, &b);
+            }
+            if (cb != CND_ERR_OK) { err = CND_ERR_CALLBACK; break; }
+        }
+        bit_group_seek(ctx, start + total);
+    }
+    ctx->ip = ip;
+    return err;
+}
+
+static inline void vm_op_align_fill(cnd_vm_ctx* ctx, uint8_t fill_bit) {
+    if (ctx->bit_offset > 0) {
+        uint8_t bits_needed = 8 - ctx->bit_offset;
+        uint64_t fill_val = (fill_bit ? 0xFFFFFFFFFFFFFFFF : 0);
+        if (ctx->mode == CND_MODE_ENCODE) {
+            write_bits(ctx, fill_val, bits_needed);
+        } else {
+            read_bits(ctx, bits_needed); // Discard
+        }
+    }
+}
+
+static inline void vm_op_align_pad(cnd_vm_ctx* ctx, uint8_t bits) {
+    if (ctx->mode == CND_MODE_ENCODE) {
+        write_bits(ctx, 0, bits);
+    } else {
+        size_t total_bits = ctx->bit_offset + bits;
+        ctx->cursor += total_bits / 8;
+        ctx->bit_offset = total_bits % 8;
+    }
+}
+
+static inline cnd_error_t vm_op_str_null(cnd_vm_ctx* ctx, uint16_t key, uint16_t max_len) {
+    if (ctx->mode == CND_MODE_ENCODE) {
+        const char* str = NULL;
+        if (ctx->io_callback(ctx, key, OP_STR_NULL, &str) != CND_ERR_OK) {
+            if (ctx->is_next_optional) {
+                ctx->is_next_optional = false;
+                return CND_ERR_OK; // Skip optional string
+            }
+            return CND_ERR_CALLBACK;
+        }
+
+        size_t len = str ? strlen(str) : 0;
+        if (len > max_len) len = max_len;
+
+        if (ctx->cursor + len + 1 > ctx->data_len) return CND_ERR_OOB;
+
+        if (len > 0) memcpy(ctx->data_buffer + ctx->cursor, str, len);
+        ctx->cursor += len;
+        ctx->data_buffer[ctx->cursor] = 0x00; // Null terminator
+        ctx->cursor++;
+    } else {
+        size_t start = ctx->cursor;
+
+        // Use memchr to find the null terminator quickly
+        size_t remaining = ctx->data_len - ctx->cursor;
+        size_t search_len = (remaining < max_len) ? remaining : max_len;
+
+        void* found = memchr(ctx->data_buffer + ctx->cursor, 0x00, search_len);
+        size_t len = found ? (size_t)((uint8_t*)found - (ctx->data_buffer + ctx->cursor)) : search_len;
+        ctx->cursor += len;
+
+        if (ctx->cursor >= ctx->data_len) return CND_ERR_OOB;
+
+        const char* ptr = (const char*)(ctx->data_buffer + start);
+        if (ctx->io_callback(ctx, key, OP_STR_NULL, (void*)ptr) != CND_ERR_OK) return CND_ERR_CALLBACK;
+
+        ctx->cursor++; // Skip null
+    }
+    ctx->is_next_optional = false;
+    return CND_ERR_OK;
+}
+
+static inline cnd_error_t vm_op_raw_bytes(cnd_vm_ctx* ctx, uint16_t key, uint32_t count) {
+    if (ctx->cursor + count > ctx->data_len) return CND_ERR_OOB;
+
+    // Callback writes to (encode) or reads from (decode) the buffer directly
+    void* ptr = ctx->data_buffer + ctx->cursor;
+    if (ctx->io_callback(ctx, key, OP_RAW_BYTES, ptr) != CND_ERR_OK) return CND_ERR_CALLBACK;
+
+    ctx->cursor += count;
+    return CND_ERR_OK;
+}
+
+// Encode: pop the computed value and write it.
+// Decode: pop the computed value and verify it against the stream.
+static inline cnd_error_t vm_op_emit(cnd_vm_ctx* ctx, uint8_t type) {
+    uint64_t val;
+    if (stack_pop(ctx, &val) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
+
+    uint32_t size = il_type_size(type);
+    if (size == 0) return CND_ERR_INVALID_OP;
+    if (ctx->cursor + size > ctx->data_len) return CND_ERR_OOB;
+
+    if (ctx->mode == CND_MODE_ENCODE) {
+        if (type == OP_IO_F32) {
+            double d; memcpy(&d, &val, 8);
+            float f = (float)d;
+            uint32_t f_bits; memcpy(&f_bits, &f, 4);
+            write_u32(ctx->data_buffer + ctx->cursor, f_bits, ctx->endianness);
+        } else {
+            vm_write_sized(ctx, size, val);
+        }
+    } else {
+        uint64_t bin_val = vm_read_sized(ctx, ctx->cursor, size);
+
+        if (type == OP_IO_F32) {
+            double d_val; memcpy(&d_val, &val, 8);
+            float f_val = (float)d_val;
+            uint32_t f_bits = (uint32_t)bin_val;
+            float f_bin; memcpy(&f_bin, &f_bits, 4);
+
+            float diff = f_val - f_bin;
+            if (diff < -0.00001f || diff > 0.00001f) return CND_ERR_VALIDATION;
+        } else if (type == OP_IO_F64) {
+            double d_val; memcpy(&d_val, &val, 8);
+            double d_bin; memcpy(&d_bin, &bin_val, 8);
+
+            double diff = d_val - d_bin;
+            if (diff < -0.0000001 || diff > 0.0000001) return CND_ERR_VALIDATION;
+        } else {
+            if (bin_val != val) return CND_ERR_VALIDATION;
+        }
+    }
+    ctx->cursor += size;
+    return CND_ERR_OK;
+}
+
+// Closes one iteration of the innermost loop. Sets *again and rewinds ctx->ip
+// to the loop body when another iteration follows; otherwise notifies the host.
+static inline cnd_error_t vm_op_arr_end(cnd_vm_ctx* ctx, bool* again) {
+    if (ctx->loop_depth == 0) return CND_ERR_INVALID_OP;
+    cnd_loop_frame* frame = &ctx->loop_stack[ctx->loop_depth - 1];
+
+    bool loop_continue = false;
+    if (frame->remaining == 0xFFFFFFFF) {
+        // EOF Loop; a stream can only end it at the end of the stream
+        if (ctx->cursor >= ctx->data_len && vm_stream_open(ctx)) return CND_ERR_OOB;
+        if (ctx->cursor < ctx->data_len) loop_continue = true;
+    } else {
+        // Fixed/Prefixed Loop
+        if (frame->remaining > 0) frame->remaining--;
+        if (frame->remaining > 0) loop_continue = true;
+    }
+
+    *again = loop_continue;
+    if (loop_continue) {
+        ctx->ip = frame->start_ip;
+    } else {
+        if (ctx->io_callback(ctx, 0, OP_ARR_END, NULL) != CND_ERR_OK) return CND_ERR_CALLBACK;
+        loop_pop(ctx);
+    }
+    return CND_ERR_OK;
+}
+
+static inline cnd_error_t vm_op_arr_eof(cnd_vm_ctx* ctx, bool* empty) {
+    if (ctx->loop_depth >= CND_MAX_LOOP_DEPTH) return CND_ERR_STACK_OVERFLOW;
+    if (ctx->cursor >= ctx->data_len && vm_stream_open(ctx)) return CND_ERR_OOB;
+    cnd_loop_frame* frame = &ctx->loop_stack[ctx->loop_depth++];
+    frame->start_ip = ctx->ip;
+    frame->remaining = 0xFFFFFFFF; // Special value for EOF loop
+    *empty = ctx->cursor >= ctx->data_len;
+    return CND_ERR_OK;
+}
+
+// Enters a struct subroutine. The callee's Key IDs are relative to `key_base`,
+// itself relative to the caller's; ctx->ip is set by the caller.
+static inline cnd_error_t vm_op_call(cnd_vm_ctx* ctx, size_t return_ip, uint16_t key_base) {
+    if (ctx->call_depth >= CND_MAX_CALL_DEPTH) return CND_ERR_STACK_OVERFLOW;
+    cnd_call_frame* frame = &ctx->call_stack[ctx->call_depth++];
+    frame->return_ip = return_ip;
+    frame->key_base = ctx->key_base;
+    ctx->key_base = (uint16_t)(ctx->key_base + key_base);
+    return CND_ERR_OK;
+}
+
+// Leaves a struct subroutine, restoring ctx->ip and the caller's key base.
+// Returns false at top level, where OP_RET ends the program.
+static inline bool vm_op_ret(cnd_vm_ctx* ctx) {
+    if (ctx->call_depth == 0) return false;
+    cnd_call_frame* frame = &ctx->call_stack[--ctx->call_depth];
+    ctx->ip = frame->return_ip;
+    ctx->key_base = frame->key_base;
+    return true;
+}
+
+// Computes an expression ALU operation (see vm_alu_arity). Binary operations
+// take `a` below `b` on the stack; unary ones take `a`. Shared by the checked
+// stack machine below and the prepared programs' unchecked evaluator.
+static inline cnd_error_t vm_alu_eval(uint8_t opcode, uint64_t a, uint64_t b, uint64_t* out) {
+    double fa, fb;
+    memcpy(&fa, &a, 8);
+    memcpy(&fb, &b, 8);
+
+    #define ALU_F(EXPR) { double r_ = (EXPR); memcpy(out, &r_, 8); break; }
+
+    switch (opcode) {
+        // Arithmetic (Integer)
+        case OP_ADD: *out = a + b; break;
+        case OP_SUB: *out = a - b; break;
+        case OP_MUL: *out = a * b; break;
+        case OP_DIV:
+            if (b == 0) return CND_ERR_ARITHMETIC;
+            *out = a / b;
+            break;
+        case OP_MOD:
+            if (b == 0) return CND_ERR_ARITHMETIC;
+            *out = a % b;
+            break;
+        // Cast to signed to avoid C4146 (unary minus on unsigned)
+        case OP_NEG: *out = (uint64_t)(-(int64_t)a); break;
+
+        // Arithmetic (Float)
+        case OP_FADD: ALU_F(fa + fb)
+        case OP_FSUB: ALU_F(fa - fb)
+        case OP_FMUL: ALU_F(fa * fb)
+        case OP_FDIV:
+            if (fb == 0.0) return CND_ERR_ARITHMETIC;
+            ALU_F(fa / fb)
+        case OP_FNEG: ALU_F(-fa)
+
+        // Math Functions
+#ifndef CND_NO_MATH
+        case OP_SIN: ALU_F(sin(fa))
+        case OP_COS: ALU_F(cos(fa))
+        case OP_TAN: ALU_F(tan(fa))
+        case OP_SQRT:
+            if (fa < 0) return CND_ERR_ARITHMETIC;
+            ALU_F(sqrt(fa))
+        case OP_LOG:
+            if (fa <= 0) return CND_ERR_ARITHMETIC;
+            ALU_F(log(fa))
+        case OP_ABS: ALU_F(fabs(fa))
+        case OP_POW:
+            if (fa < 0 && floor(fb) != fb) return CND_ERR_ARITHMETIC;
+            if (fa == 0 && fb <= 0) return CND_ERR_ARITHMETIC;
+            ALU_F(pow(fa, fb))
+#endif
+
+        // Conversion
+        case OP_ITOF: ALU_F((double)(int64_t)a)
+        case OP_FTOI: *out = (uint64_t)(int64_t)fa; break;
+
+        // Comparison (Float)
+        case OP_EQ_F:  *out = (fa == fb) ? 1 : 0; break;
+        case OP_NEQ_F: *out = (fa != fb) ? 1 : 0; break;
+        case OP_GT_F:  *out = (fa > fb) ? 1 : 0; break;
+        case OP_LT_F:  *out = (fa < fb) ? 1 : 0; break;
+        case OP_GTE_F: *out = (fa >= fb) ? 1 : 0; break;
+        case OP_LTE_F: *out = (fa <= fb) ? 1 : 0; break;
+
+        // Bitwise
+        case OP_BIT_AND: *out = a & b; break;
+        case OP_BIT_OR:  *out = a | b; break;
+        case OP_BIT_XOR: *out = a ^ b; break;
+        case OP_BIT_NOT: *out = ~a; break;
+        case OP_SHL:     *out = a << b; break;
+        case OP_SHR:     *out = a >> b; break;
+
+        // Comparison
+        case OP_EQ:  *out = a == b; break;
+        case OP_NEQ: *out = a != b; break;
+        case OP_GT:  *out = a > b; break;
+        case OP_LT:  *out = a < b; break;
+        case OP_GTE: *out = a >= b; break;
+        case OP_LTE: *out = a <= b; break;
+
+        // Logical
+        case OP_LOG_AND: *out = a && b; break;
+        case OP_LOG_OR:  *out = a || b; break;
+        case OP_LOG_NOT: *out = !a; break;
+
+        default:
+            break;
+    }
+
+    #undef ALU_F
+    return CND_ERR_OK;
+}
+
+// Executes an expression stack operation that takes no IL operands.
+// Unknown opcodes are ignored, matching the interpreters' default case.
+static inline cnd_error_t vm_alu(cnd_vm_ctx* ctx, uint8_t opcode) {
+    int arity = vm_alu_arity(opcode);
+    if (arity == 0) return CND_ERR_OK;
+    if (ctx->expr_sp < arity) return CND_ERR_STACK_UNDERFLOW;
+
+    uint64_t* args = &ctx->expr_stack[ctx->expr_sp - arity];
+    ctx->expr_sp = (uint8_t)(ctx->expr_sp - arity);
+    cnd_error_t err = vm_alu_eval(opcode, args[0], arity == 2 ? args[1] : 0, &args[0]);
+    if (err != CND_ERR_OK) return err;
+    ctx->expr_sp++;
+    return CND_ERR_OK;
+}
+
+// --- Register Expressions ---
+
+// Runs the register program of an OP_EXPR (`len` bytes at `code`) and stores
+// its result in *out. Values stay in typed registers, so float operations
+// need no conversion through the uint64_t stack slots, and operands are
+// decoded once per instruction rather than per push and pop. Register
+// numbers are masked and the program is bounded by `len`, so unverified
+// bytecode cannot reach outside either; cnd_verify_program rejects malformed
+// programs. Math functions are invalid in CND_NO_MATH builds.
+static inline cnd_error_t vm_expr_eval(cnd_vm_ctx* ctx, const uint8_t* code, size_t len, uint64_t* out) {
+    uint64_t r[CND_EXPR_REGS];
+    double f[CND_EXPR_REGS];
+    const uint8_t* p = code;
+    const uint8_t* end = code + len;
+
+    #define EXPR_REG(i) ((i) & (CND_EXPR_REGS - 1))
+    #define RD r[EXPR_REG(p[1])]
+    #define FD f[EXPR_REG(p[1])]
+    #define RA r[EXPR_REG(p[2])]
+    #define FA f[EXPR_REG(p[2])]
+    #define RB ((p[1] & CND_EXPR_IMM) ? (uint64_t)(int64_t)(int8_t)p[3] : r[EXPR_REG(p[3])])
+    #define FB f[EXPR_REG(p[3])]
+
+    while (end - p >= 4) {
+        switch (p[0]) {
+            case OP_REG_LOAD: {
+                uint64_t val = 0;
+                uint16_t key = (uint16_t)(il_get_u16(p + 2) + ctx->key_base);
+                if (vm_ctx_value(ctx, key, OP_LOAD_CTX, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                RD = val;
+                break;
+            }
+            case OP_REG_IMM: RD = (uint64_t)(int64_t)(int16_t)il_get_u16(p + 2); break;
+            case OP_REG_CONST:
+            case OP_REG_FCONST: {
+                if (end - p < 12) return CND_ERR_OOB;
+                uint64_t bits = il_get_u64(p + 4);
+                if (p[0] == OP_REG_CONST) RD = bits;
+                else memcpy(&FD, &bits, 8);
+                p += 8;
+                break;
+            }
+            case OP_REG_ITOB: memcpy(&FD, &RA, 8); break;
+            case OP_REG_BTOI: memcpy(&RD, &FA, 8); break;
+            case OP_REG_RET:
+                if (p[3]) memcpy(out, &FA, 8);
+                else *out = RA;
+                return CND_ERR_OK;
+
+            // Integer
+            case OP_ADD: RD = RA + RB; break;
+            case OP_SUB: RD = RA - RB; break;
+            case OP_MUL: RD = RA * RB; break;
+            case OP_DIV: {
+                uint64_t b = RB;
+                if (b == 0) return CND_ERR_ARITHMETIC;
+                RD = RA / b;
+                break;
+            }
+            case OP_MOD: {
+                uint64_t b = RB;
+                if (b == 0) return CND_ERR_ARITHMETIC;
+                RD = RA % b;
+                break;
+            }
+            case OP_NEG: RD = (uint64_t)(-(int64_t)RA); break;
+            case OP_BIT_AND: RD = RA & RB; break;
+            case OP_BIT_OR:  RD = RA | RB; break;
+            case OP_BIT_XOR: RD = RA ^ RB; break;
+            case OP_BIT_NOT: RD = ~RA; break;
+            case OP_SHL:     RD = RA << RB; break;
+            case OP_SHR:     RD = RA >> RB; break;
+            case OP_EQ:  RD = RA == RB; break;
+            case OP_NEQ: RD = RA != RB; break;
+            case OP_GT:  RD = RA > RB; break;
+            case OP_LT:  RD = RA < RB; break;
+            case OP_GTE: RD = RA >= RB; break;
+            case OP_LTE: RD = RA <= RB; break;
+            case OP_LOG_AND: RD = RA && RB; break;
+            case OP_LOG_OR:  RD = RA || RB; break;
+            case OP_LOG_NOT: RD = !RA; break;
+
+            // Float
+            case OP_FADD: FD = FA + FB; break;
+            case OP_FSUB: FD = FA - FB; break;
+            case OP_FMUL: FD = FA * FB; break;
+            case OP_FDIV:
+                if (FB == 0.0) return CND_ERR_ARITHMETIC;
+                FD = FA / FB;
+                break;
+            case OP_FNEG: FD = -FA; break;
+            case OP_EQ_F:  RD = FA == FB; break;
+            case OP_NEQ_F: RD = FA != FB; break;
+            case OP_GT_F:  RD = FA > FB; break;
+            case OP_LT_F:  RD = FA < FB; break;
+            case OP_GTE_F: RD = FA >= FB; break;
+            case OP_LTE_F: RD = FA <= FB; break;
+            case OP_ITOF: FD = (double)(int64_t)RA; break;
+            case OP_FTOI: RD = (uint64_t)(int64_t)FA; break;
+#ifndef CND_NO_MATH
+            case OP_SIN: FD = sin(FA); break;
+            case OP_COS: FD = cos(FA); break;
+            case OP_TAN: FD = tan(FA); break;
+            case OP_SQRT:
+                if (FA < 0) return CND_ERR_ARITHMETIC;
+                FD = sqrt(FA);
+                break;
+            case OP_LOG:
+                if (FA <= 0) return CND_ERR_ARITHMETIC;
+                FD = log(FA);
+                break;
+            case OP_ABS: FD = fabs(FA); break;
+            case OP_POW:
+                if (FA < 0 && floor(FB) != FB) return CND_ERR_ARITHMETIC;
+                if (FA == 0 && FB <= 0) return CND_ERR_ARITHMETIC;
+                FD = pow(FA, FB);
+                break;
+#endif
+            default:
+                return CND_ERR_INVALID_OP;
+        }
+        p += 4;
+    }
+
+    #undef EXPR_REG
+    #undef RD
+    #undef FD
+    #undef RA
+    #undef FA
+    #undef RB
+    #undef FB
+    return CND_ERR_OOB; // No OP_REG_RET
+}
+
+#endif
@@ -3,6 +3,10 @@
 
 #include "concordia.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // --- IL Access ---
 
 static inline uint16_t read_il_u16(cnd_vm_ctx* ctx) {
@@ -50,6 +54,215 @@ static inline uint32_t peek_il_u32(cnd_vm_ctx* ctx, size_t idx) {
     return b[0] | (b[1] << 8) | (b[2] << 16) | (b[3] << 24);
 }
 
+// --- Raw IL Decoding (little-endian operands) ---
+
+static inline uint16_t il_get_u16(const uint8_t* b) {
+    return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+static inline uint32_t il_get_u32(const uint8_t* b) {
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static inline uint64_t il_get_u64(const uint8_t* b) {
+    return (uint64_t)il_get_u32(b) | ((uint64_t)il_get_u32(b + 4) << 32);
+}
+
+// Size in bytes of the value moved by a primitive IO opcode, or 0 if `type` is not one.
+static inline uint32_t il_type_size(uint8_t type) {
+    switch (type) {
+        case OP_IO_U8: case OP_IO_I8: case OP_IO_BOOL: return 1;
+        case OP_IO_U16: case OP_IO_I16: return 2;
+        case OP_IO_U32: case OP_IO_I32: case OP_IO_F32: return 4;
+        case OP_IO_U64: case OP_IO_I64: case OP_IO_F64: return 8;
+        default: return 0;
+    }
+}
+
+// --- IL Structure (vm_verify.c) ---
+
+// Maximum number of switch tables that may be pending (emitted later in the
+// bytecode than the instruction currently being walked).
+#define VM_MAX_PENDING_TABLES 32
+
+// Length of the instruction at `ip`, including its inline operands.
+// Out-of-line switch tables are not included (see vm_switch_table_span).
+cnd_error_t vm_insn_length(const uint8_t* bc, size_t len, size_t ip, size_t* out_len);
+
+// Location and size of the jump table referenced by the switch instruction
+// at `ip` (OP_SWITCH, OP_SWITCH_TABLE, OP_SWITCH_SORTED or OP_SWITCH_HASH).
+cnd_error_t vm_switch_table_span(const uint8_t* bc, size_t len, size_t ip, size_t* table_start, size_t* table_len);
+
+// Instructions in bytecode order with the switch tables stepped over, for
+// scans of unverified IL that only look for certain opcodes
+typedef struct {
+    size_t ip;
+    size_t pending_start[VM_MAX_PENDING_TABLES];
+    size_t pending_end[VM_MAX_PENDING_TABLES];
+    int pending;
+} vm_insn_walk;
+
+static inline void vm_walk_init(vm_insn_walk* w) {
+    w->ip = 0;
+    w->pending = 0;
+}
+
+// Moves to the next instruction and returns its offset and length in `ip`
+// and `n`; false at the end of the bytecode or at anything malformed (left
+// to the verifier)
+bool vm_walk_next(vm_insn_walk* w, const uint8_t* bc, size_t len, size_t* ip, size_t* n);
+
+// Operands an expression ALU opcode pops before pushing its result, or 0 if
+// `op` is not one (math functions only count when they are compiled in).
+static inline int vm_alu_arity(uint8_t op) {
+    switch (op) {
+        case OP_NEG: case OP_FNEG: case OP_ITOF: case OP_FTOI:
+        case OP_BIT_NOT: case OP_LOG_NOT:
+#ifndef CND_NO_MATH
+        case OP_SIN: case OP_COS: case OP_TAN: case OP_SQRT: case OP_LOG: case OP_ABS:
+#endif
+            return 1;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FDIV:
+        case OP_EQ_F: case OP_NEQ_F: case OP_GT_F: case OP_LT_F: case OP_GTE_F: case OP_LTE_F:
+        case OP_BIT_AND: case OP_BIT_OR: case OP_BIT_XOR: case OP_SHL: case OP_SHR:
+        case OP_EQ: case OP_NEQ: case OP_GT: case OP_LT: case OP_GTE: case OP_LTE:
+        case OP_LOG_AND: case OP_LOG_OR:
+#ifndef CND_NO_MATH
+        case OP_POW:
+#endif
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// Scratch bytes per prepared slot used by vm_verify_depths
+#define VM_DEPTH_SCRATCH 8
+
+// Abstract interpretation of a prepared program: proves that no run starting
+// at instruction 0 with empty stacks can underflow the expression stack or
+// grow it or the loop stack past CND_MAX_EXPR_STACK / CND_MAX_LOOP_DEPTH, and
+// reports the deepest each gets. Returns false when it cannot prove this
+// (the program still runs, with checked stacks).
+bool vm_verify_depths(const cnd_insn* insns, size_t count, uint8_t* scratch,
+                      uint8_t* max_stack, uint8_t* max_loops);
+
+// Largest slot and bucket exponent of an OP_SWITCH_HASH table
+#define VM_SWITCH_HASH_MAX_BITS 16
+
+// --- Switch Lookup (tables checked by vm_switch_table_span) ---
+
+// Bytecode address of a switch target stored relative to `code_start_ip`
+static inline cnd_error_t vm_switch_target(size_t code_start_ip, int32_t off, size_t len, size_t* out) {
+    if (off < 0) {
+        size_t abs_off = (size_t)(-(int64_t)off);
+        if (code_start_ip < abs_off) return CND_ERR_OOB;
+        *out = code_start_ip - abs_off;
+    } else {
+        *out = code_start_ip + (size_t)off;
+        if (*out < code_start_ip) return CND_ERR_OOB;
+    }
+    return (*out > len) ? CND_ERR_OOB : CND_ERR_OK;
+}
+
+// Case offset for `v` in an OP_SWITCH_SORTED table, or its default offset
+static inline int32_t vm_switch_sorted_lookup(const uint8_t* table, uint64_t v) {
+    const uint8_t* entries = table + 6;
+    uint32_t lo = 0, hi = il_get_u16(table);
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) >> 1;
+        uint64_t case_val = il_get_u64(entries + (size_t)mid * 12);
+        if (case_val == v) return (int32_t)il_get_u32(entries + (size_t)mid * 12 + 8);
+        if (case_val < v) lo = mid + 1;
+        else hi = mid;
+    }
+    return (int32_t)il_get_u32(table + 2);
+}
+
+// Slot of `v` in an OP_SWITCH_HASH table. The top `bucket_bits` of
+// v * mult select a displacement that is XORed into the next `slot_bits`.
+static inline uint32_t vm_switch_hash_slot(uint64_t v, uint64_t mult, uint8_t slot_bits,
+                                           uint8_t bucket_bits, const uint8_t* disp) {
+    uint64_t h = v * mult;
+    uint32_t bucket = (uint32_t)(h >> (64 - bucket_bits));
+    uint32_t slot = (uint32_t)((h << bucket_bits) >> (64 - slot_bits));
+    return (slot ^ il_get_u16(disp + (size_t)bucket * 2)) & ((1u << slot_bits) - 1);
+}
+
+// Case offset for `v` in an OP_SWITCH_HASH table, or its default offset
+static inline int32_t vm_switch_hash_lookup(const uint8_t* table, uint64_t v) {
+    uint8_t slot_bits = table[12];
+    uint8_t bucket_bits = table[13];
+    const uint8_t* disp = table + 14;
+    uint32_t slot = vm_switch_hash_slot(v, il_get_u64(table + 4), slot_bits, bucket_bits, disp);
+    const uint8_t* entry = disp + ((size_t)2 << bucket_bits) + (size_t)slot * 12;
+    if (il_get_u64(entry) == v) return (int32_t)il_get_u32(entry + 8);
+    return (int32_t)il_get_u32(table);
+}
+
+// --- Value Conversion (vm_bind.c) ---
+
+// Value type the VM delivers for an event type that is not a host storage
+// type (bitfields, expression context).
+uint8_t bind_wire_type(uint8_t type);
+
+// Copies one value between the VM (`wire`, of type `wire_type`) and host
+// storage (`host`, of type `host_type`), converting when the types differ.
+void bind_copy(bool encode, uint8_t wire_type, void* wire, uint8_t host_type, void* host);
+
+// --- Bulk Arrays (vm_span.c) ---
+
+// Transfers `count` elements of primitive `type` at ctx->cursor as OP_ARR_SPAN
+// events, applying scale[0] (factor) and scale[1] (offset) when `scale` is
+// set. Returns false when the bulk path does not apply or the host declined
+// the first span, so the caller runs the loop; otherwise true with the
+// outcome in *err.
+bool vm_array_span(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, uint32_t count,
+                   const double* scale, cnd_error_t* err);
+
+// --- Streaming Decode (vm_span.c, vm_stream.c) ---
+
+// More input may follow the buffer (CND_CTX_STREAM without CND_CTX_STREAM_END).
+// Reads that run out of data must then fail with CND_ERR_OOB, which the
+// stream loop turns into CND_ERR_NEED_MORE, rather than stop at the end of
+// the buffer: no @optional default, no partial bitfield, no end of an
+// until-EOF array.
+static inline bool vm_stream_open(const cnd_vm_ctx* ctx) {
+    return (ctx->flags & (CND_CTX_STREAM | CND_CTX_STREAM_END)) == CND_CTX_STREAM;
+}
+
+// Byte array of `count` elements running past the buffer of an open stream:
+// sends the bytes at hand as an OP_ARR_SPAN and records the rest in
+// ctx->span_*. Returns false when spans do not apply or the host declined
+// the first one; otherwise true with CND_ERR_NEED_MORE (or the callback
+// error) in *err.
+bool vm_stream_span(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, uint32_t count, cnd_error_t* err);
+
+// Continues the pending byte array from the cursor: CND_ERR_OK once it is
+// complete, CND_ERR_NEED_MORE (CND_ERR_OOB at the end of the stream) while
+// bytes are missing.
+cnd_error_t vm_stream_span_resume(cnd_vm_ctx* ctx);
+
+// --- Prepared Execution (vm_prepare.c) ---
+
+// Runs the prepared instruction at ctx->ip and leaves ctx->ip at the next one
+// to run. An unchecked expression run (see cnd_prepared.stacks_verified)
+// counts as one instruction. *finished is set when the program has ended.
+cnd_error_t vm_prepared_step(cnd_vm_ctx* ctx, const cnd_prepared* prepared, bool unchecked, bool* finished);
+
+// --- CRC ---
+
+// Builds the CRC engines for the program's CRC opcodes (called on load)
+void vm_crc_prepare(const cnd_program* program);
+uint32_t vm_calc_crc(const uint8_t* data, size_t len, uint32_t poly, uint32_t init, uint32_t xorout, uint8_t flags, int width);
+// Incremental form of vm_calc_crc: start, feed any number of pieces, finish
+uint32_t vm_crc_start(uint32_t poly, uint32_t init, uint8_t flags, int width);
+uint32_t vm_crc_update(uint32_t crc, const uint8_t* data, size_t len, uint32_t poly, uint8_t flags, int width);
+uint32_t vm_crc_finish(uint32_t crc, uint32_t xorout, uint8_t flags, int width);
+// CRC of the current region (see OP_CRC_BEGIN / OP_CRC_END), reusing the running register
+uint32_t vm_crc_region(cnd_vm_ctx* ctx, uint32_t poly, uint32_t init, uint32_t xorout, uint8_t flags, int width);
+
 // --- Data Access (Read) ---
 
 static inline uint8_t read_u8(const uint8_t* buf) {
@@ -94,18 +307,53 @@ static inline uint64_t read_u64(const uint8_t* buf, cnd_endian_t endian) {
     }
 }
 
-static inline uint64_t read_bits(cnd_vm_ctx* ctx, uint8_t count) {
-    // Optimization: Byte-aligned reads
-    if (ctx->bit_offset == 0 && (count & 7) == 0) {
-        uint8_t bytes = count / 8;
-        if (ctx->cursor + bytes <= ctx->data_len) {
-            if (bytes == 1) { uint64_t v = read_u8(ctx->data_buffer + ctx->cursor); ctx->cursor++; return v; }
-            if (bytes == 2) { uint64_t v = read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness); ctx->cursor+=2; return v; }
-            if (bytes == 4) { uint64_t v = read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness); ctx->cursor+=4; return v; }
-            if (bytes == 8) { uint64_t v = read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness); ctx->cursor+=8; return v; }
-        }
+// --- Bit Stream ---
+//
+// Bitfields go through a 64-bit window loaded at the cursor byte. LE streams
+// fill each byte from bit 0, so the window is a little-endian load and a field
+// starts bit_offset bits up from the bottom; BE streams fill from bit 7, so the
+// window is a big-endian load and the field starts bit_offset bits down from
+// the top. Either way a field is one shift and mask. Fields spanning more than
+// 8 bytes (over 56 bits, unaligned) take two windows.
+
+static inline uint64_t bit_mask(uint8_t count) {
+    return (count >= 64) ? ~(uint64_t)0 : (((uint64_t)1 << count) - 1);
+}
+
+// Loads `nbytes` (1-8) bytes at the cursor as a window; missing bytes are 0
+static inline uint64_t bit_window_load(const cnd_vm_ctx* ctx, size_t nbytes) {
+    const uint8_t* p = ctx->data_buffer + ctx->cursor;
+    if (ctx->data_len - ctx->cursor >= 8) return read_u64(p, ctx->endianness);
+    uint64_t w = 0;
+    for (size_t i = 0; i < nbytes; i++) {
+        w |= (uint64_t)p[i] << ((ctx->endianness == CND_BE) ? 56 - 8 * i : 8 * i);
     }
+    return w;
+}
 
+static inline void bit_advance(cnd_vm_ctx* ctx, uint32_t bits) {
+    ctx->cursor += bits >> 3;
+    ctx->bit_offset = (uint8_t)(bits & 7);
+}
+
+// True when `count` bits from the cursor lie inside the buffer
+static inline bool bits_in_bounds(const cnd_vm_ctx* ctx, uint8_t count) {
+    size_t nbytes = ((size_t)ctx->bit_offset + count + 7) >> 3;
+    return ctx->cursor <= ctx->data_len && nbytes <= ctx->data_len - ctx->cursor;
+}
+
+// One field of at most 64 - bit_offset bits
+static inline uint64_t read_bits_window(cnd_vm_ctx* ctx, uint8_t count) {
+    uint32_t span = ctx->bit_offset + count;
+    uint64_t w = bit_window_load(ctx, (span + 7) >> 3);
+    uint64_t v = (ctx->endianness == CND_BE) ? (w << ctx->bit_offset) >> (64 - count)
+                                             : (w >> ctx->bit_offset) & bit_mask(count);
+    bit_advance(ctx, span);
+    return v;
+}
+
+// Fields running past the end of the buffer: bit by bit up to the end
+static inline uint64_t read_bits_tail(cnd_vm_ctx* ctx, uint8_t count) {
     uint64_t val = 0;
     for (uint8_t i = 0; i < count; i++) {
         if (ctx->cursor >= ctx->data_len) break; 
@@ -134,6 +382,16 @@ static inline uint64_t read_bits(cnd_vm_ctx* ctx, uint8_t count) {
     return val;
 }
 
+static inline uint64_t read_bits(cnd_vm_ctx* ctx, uint8_t count) {
+    if (count == 0) return 0;
+    if (count > 64 || !bits_in_bounds(ctx, count)) return read_bits_tail(ctx, count);
+    if (ctx->bit_offset + count <= 64) return read_bits_window(ctx, count);
+
+    uint64_t first = read_bits_window(ctx, 32);
+    uint64_t rest = read_bits_window(ctx, (uint8_t)(count - 32));
+    return (ctx->endianness == CND_BE) ? (first << (count - 32)) | rest : first | (rest << 32);
+}
+
 // --- Data Access (Write) ---
 
 static inline void write_u8(uint8_t* buf, uint8_t val) {
@@ -186,18 +444,27 @@ static inline void write_u64(uint8_t* buf, uint64_t val, cnd_endian_t endian) {
     }
 }
 
-static inline void write_bits(cnd_vm_ctx* ctx, uint64_t val, uint8_t count) {
-    // Optimization: Byte-aligned writes
-    if (ctx->bit_offset == 0 && (count & 7) == 0) {
-        uint8_t bytes = count / 8;
-        if (ctx->cursor + bytes <= ctx->data_len) {
-            if (bytes == 1) { write_u8(ctx->data_buffer + ctx->cursor, (uint8_t)val); ctx->cursor++; return; }
-            if (bytes == 2) { write_u16(ctx->data_buffer + ctx->cursor, (uint16_t)val, ctx->endianness); ctx->cursor+=2; return; }
-            if (bytes == 4) { write_u32(ctx->data_buffer + ctx->cursor, (uint32_t)val, ctx->endianness); ctx->cursor+=4; return; }
-            if (bytes == 8) { write_u64(ctx->data_buffer + ctx->cursor, val, ctx->endianness); ctx->cursor+=8; return; }
+static inline void write_bits_window(cnd_vm_ctx* ctx, uint64_t val, uint8_t count) {
+    uint32_t span = ctx->bit_offset + count;
+    size_t nbytes = (span + 7) >> 3;
+    uint64_t w = bit_window_load(ctx, nbytes);
+    uint64_t m = bit_mask(count);
+    uint32_t shift = (ctx->endianness == CND_BE) ? 64 - span : ctx->bit_offset;
+    w = (w & ~(m << shift)) | ((val & m) << shift);
+
+    uint8_t* p = ctx->data_buffer + ctx->cursor;
+    if (ctx->data_len - ctx->cursor >= 8) {
+        write_u64(p, w, ctx->endianness);
+    } else {
+        for (size_t i = 0; i < nbytes; i++) {
+            p[i] = (uint8_t)(w >> ((ctx->endianness == CND_BE) ? 56 - 8 * i : 8 * i));
         }
     }
+    bit_advance(ctx, span);
+}
 
+// Fields running past the end of the buffer: bit by bit up to the end
+static inline void write_bits_tail(cnd_vm_ctx* ctx, uint64_t val, uint8_t count) {
     for (uint8_t i = 0; i < count; i++) {
         if (ctx->cursor >= ctx->data_len) return; 
 
@@ -229,4 +496,22 @@ static inline void write_bits(cnd_vm_ctx* ctx, uint64_t val, uint8_t count) {
     }
 }
 
+static inline void write_bits(cnd_vm_ctx* ctx, uint64_t val, uint8_t count) {
+    if (count == 0) return;
+    if (count > 64 || !bits_in_bounds(ctx, count)) { write_bits_tail(ctx, val, count); return; }
+    if (ctx->bit_offset + count <= 64) { write_bits_window(ctx, val, count); return; }
+
+    if (ctx->endianness == CND_BE) {
+        write_bits_window(ctx, val >> (count - 32), 32);
+        write_bits_window(ctx, val, (uint8_t)(count - 32));
+    } else {
+        write_bits_window(ctx, val, 32);
+        write_bits_window(ctx, val >> 32, (uint8_t)(count - 32));
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
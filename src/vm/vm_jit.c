@@ -0,0 +1,752 @@
+#include "concordia.h"
+#include "vm_internal.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Native Code ---
+//
+// cnd_program_jit() translates a prepared program into x86-64 machine code:
+// one block per instruction, once for decoding and once for encoding, so the
+// mode and every operand are constants in the generated code.
+//
+// Byte-aligned primitive fields, linear transforms (OP_SCALE_LIN and the
+// scaled field after it), CRC regions and checks, byte order changes, no-ops
+// and jumps are emitted inline. A CRC field calls vm_crc_region() directly for
+// the checksum, which shares the table-driven engine and running register of
+// the interpreter. When the context runs with cnd_bind_io, an unscaled field
+// of the innermost bound struct is loaded from or stored to host memory right
+// there, like the bound interpreter loops do (vm_bind_scalar); array elements
+// and type conversions still call cnd_bind_io. A field whose preconditions do
+// not hold at run time (bit
+// offset, optional flag, other transforms, short buffer) and every other
+// instruction call vm_prepared_step(), so they behave exactly as in
+// cnd_execute_prepared(). The block that called it continues at the next
+// block when the instruction fell through, otherwise through a table of block
+// addresses indexed by ctx->ip.
+//
+// Register use inside generated code (all callee-saved):
+//   rbx  cnd_vm_ctx*
+//   r12  block address table of the mode
+//   r13  jit_run* (arguments of vm_prepared_step)
+// The field value handed to the host lives in an 8-byte slot at [rsp].
+
+#if defined(CND_JIT) && defined(__x86_64__) && defined(__linux__)
+#define VM_JIT_X64 1
+#include <sys/mman.h>
+#endif
+
+#ifdef VM_JIT_X64
+
+// Returned by jit_step when the program ended; never a cnd_error_t
+#define JIT_FINISHED 0x100
+
+#define JIT_UNPLACED SIZE_MAX
+
+typedef struct {
+    const cnd_prepared* prepared;
+    bool unchecked;
+} jit_run;
+
+typedef int (*jit_fn)(cnd_vm_ctx* ctx, const jit_run* run);
+
+// Runs one instruction through the prepared executor
+static int jit_step(cnd_vm_ctx* ctx, const jit_run* run) {
+    bool finished = false;
+    cnd_error_t err = vm_prepared_step(ctx, run->prepared, run->unchecked, &finished);
+    if (err != CND_ERR_OK) return (int)err;
+    return finished ? JIT_FINISHED : 0;
+}
+
+// --- Assembler ---
+
+typedef struct {
+    size_t at;      // Offset of the rel32 operand
+    size_t label;
+} jit_fixup;
+
+typedef struct {
+    uint8_t* code;
+    size_t len;
+    size_t cap;
+    size_t* labels;        // Code offset of each label, JIT_UNPLACED until bound
+    size_t label_count;
+    size_t label_cap;
+    jit_fixup* fixups;
+    size_t fixup_count;
+    size_t fixup_cap;
+    bool failed;           // Out of memory
+} jit_asm;
+
+static bool jit_grow(jit_asm* a, void** buf, size_t* cap, size_t need, size_t elem) {
+    if (need <= *cap) return true;
+    size_t n = *cap ? *cap * 2 : 256;
+    while (n < need) n *= 2;
+    void* p = realloc(*buf, n * elem);
+    if (!p) {
+        a->failed = true;
+        return false;
+    }
+    *buf = p;
+    *cap = n;
+    return true;
+}
+
+static void jit_byte(jit_asm* a, uint8_t b) {
+    if (!jit_grow(a, (void**)&a->code, &a->cap, a->len + 1, 1)) return;
+    a->code[a->len++] = b;
+}
+
+static void jit_bytes(jit_asm* a, const uint8_t* b, size_t n) {
+    for (size_t i = 0; i < n; i++) jit_byte(a, b[i]);
+}
+
+static void jit_u32(jit_asm* a, uint32_t v) {
+    for (int i = 0; i < 4; i++) jit_byte(a, (uint8_t)(v >> (i * 8)));
+}
+
+static void jit_u64(jit_asm* a, uint64_t v) {
+    for (int i = 0; i < 8; i++) jit_byte(a, (uint8_t)(v >> (i * 8)));
+}
+
+static size_t jit_label(jit_asm* a) {
+    if (!jit_grow(a, (void**)&a->labels, &a->label_cap, a->label_count + 1, sizeof(size_t))) return 0;
+    a->labels[a->label_count] = JIT_UNPLACED;
+    return a->label_count++;
+}
+
+static void jit_bind(jit_asm* a, size_t label) {
+    if (!a->failed) a->labels[label] = a->len;
+}
+
+// Emits `op` followed by a rel32 to `label`
+static void jit_branch(jit_asm* a, const uint8_t* op, size_t n, size_t label) {
+    jit_bytes(a, op, n);
+    if (!jit_grow(a, (void**)&a->fixups, &a->fixup_cap, a->fixup_count + 1, sizeof(jit_fixup))) return;
+    a->fixups[a->fixup_count].at = a->len;
+    a->fixups[a->fixup_count].label = label;
+    a->fixup_count++;
+    jit_u32(a, 0);
+}
+
+static void jit_jmp(jit_asm* a, size_t label) { static const uint8_t op[] = {0xE9}; jit_branch(a, op, 1, label); }
+static void jit_je(jit_asm* a, size_t label)  { static const uint8_t op[] = {0x0F, 0x84}; jit_branch(a, op, 2, label); }
+static void jit_jne(jit_asm* a, size_t label) { static const uint8_t op[] = {0x0F, 0x85}; jit_branch(a, op, 2, label); }
+static void jit_ja(jit_asm* a, size_t label)  { static const uint8_t op[] = {0x0F, 0x87}; jit_branch(a, op, 2, label); }
+static void jit_jae(jit_asm* a, size_t label) { static const uint8_t op[] = {0x0F, 0x83}; jit_branch(a, op, 2, label); }
+
+static bool jit_link(jit_asm* a) {
+    if (a->failed) return false;
+    for (size_t i = 0; i < a->fixup_count; i++) {
+        size_t target = a->labels[a->fixups[i].label];
+        if (target == JIT_UNPLACED) return false;
+        int64_t rel = (int64_t)target - (int64_t)(a->fixups[i].at + 4);
+        if (rel < INT32_MIN || rel > INT32_MAX) return false;
+        uint32_t v = (uint32_t)(int32_t)rel;
+        memcpy(a->code + a->fixups[i].at, &v, 4);
+    }
+    return true;
+}
+
+// ModRM + disp32 for [rbx + disp] with register field `reg`
+static void jit_ctx_operand(jit_asm* a, uint8_t reg, size_t disp) {
+    jit_byte(a, (uint8_t)(0x80 | ((reg & 7) << 3) | 3));
+    jit_u32(a, (uint32_t)disp);
+}
+
+enum { JIT_RAX = 0, JIT_RCX = 1, JIT_RDX = 2, JIT_RSI = 6, JIT_RDI = 7 };
+
+// mov r64, [rbx + disp]
+static void jit_load_ctx(jit_asm* a, uint8_t reg, size_t disp) {
+    jit_byte(a, 0x48); jit_byte(a, 0x8B); jit_ctx_operand(a, reg, disp);
+}
+
+// mov [rbx + disp], r64
+static void jit_store_ctx(jit_asm* a, size_t disp, uint8_t reg) {
+    jit_byte(a, 0x48); jit_byte(a, 0x89); jit_ctx_operand(a, reg, disp);
+}
+
+// mov rax, imm64 ; mov [rbx + disp], rax
+static void jit_store_ctx_u64(jit_asm* a, size_t disp, uint64_t imm) {
+    jit_byte(a, 0x48); jit_byte(a, 0xB8); jit_u64(a, imm);
+    jit_store_ctx(a, disp, JIT_RAX);
+}
+
+// mov dword [rbx + disp], imm32
+static void jit_store_ctx_u32(jit_asm* a, size_t disp, uint32_t imm) {
+    jit_byte(a, 0xC7); jit_ctx_operand(a, 0, disp); jit_u32(a, imm);
+}
+
+// SSE2 scalar double op `op` (F2 0F op) of xmm0 with the double at [rbx + disp]
+static void jit_sse_ctx(jit_asm* a, uint8_t op, size_t disp) {
+    jit_byte(a, 0xF2); jit_byte(a, 0x0F); jit_byte(a, op); jit_ctx_operand(a, 0, disp);
+}
+
+// mov qword [rbx + disp], imm32 (sign-extended)
+static void jit_store_ctx_imm(jit_asm* a, size_t disp, uint32_t imm) {
+    jit_byte(a, 0x48); jit_byte(a, 0xC7); jit_ctx_operand(a, 0, disp); jit_u32(a, imm);
+}
+
+// cmp byte [rbx + disp], imm8
+static void jit_cmp_ctx_u8(jit_asm* a, size_t disp, uint8_t imm) {
+    jit_byte(a, 0x80); jit_ctx_operand(a, 7, disp); jit_byte(a, imm);
+}
+
+// cmp dword [rbx + disp], imm8
+static void jit_cmp_ctx_u32(jit_asm* a, size_t disp, uint8_t imm) {
+    jit_byte(a, 0x83); jit_ctx_operand(a, 7, disp); jit_byte(a, imm);
+}
+
+// mov rax, imm64 ; call rax
+static void jit_call_abs(jit_asm* a, uint64_t target) {
+    jit_byte(a, 0x48); jit_byte(a, 0xB8); jit_u64(a, target);
+    jit_byte(a, 0xFF); jit_byte(a, 0xD0);
+}
+
+// --- Code Generation ---
+
+typedef struct {
+    jit_asm* a;
+    const cnd_prepared* prepared;
+    size_t first;       // Label of instruction 0; instruction i is first + i
+    size_t done;        // Program ended normally
+    size_t dispatch;    // Continue at ctx->ip
+    size_t exit;        // Return eax
+    size_t callback;    // Return CND_ERR_CALLBACK
+} jit_gen;
+
+#define JIT_BLOCK(g, i) ((g)->first + (i))
+
+// Calls the prepared executor for instruction i and continues wherever it left ctx->ip
+static void jit_emit_step(jit_gen* g, size_t i) {
+    jit_asm* a = g->a;
+    jit_store_ctx_imm(a, offsetof(cnd_vm_ctx, ip), (uint32_t)i);
+    jit_byte(a, 0x48); jit_byte(a, 0x89); jit_byte(a, 0xDF);     // mov rdi, rbx
+    jit_byte(a, 0x4C); jit_byte(a, 0x89); jit_byte(a, 0xEE);     // mov rsi, r13
+    jit_call_abs(a, (uint64_t)(uintptr_t)&jit_step);
+    jit_byte(a, 0x85); jit_byte(a, 0xC0);                         // test eax, eax
+    jit_jne(a, g->exit);
+    jit_load_ctx(a, JIT_RAX, offsetof(cnd_vm_ctx, ip));
+    jit_byte(a, 0x48); jit_byte(a, 0x3D); jit_u32(a, (uint32_t)(i + 1)); // cmp rax, i + 1
+    jit_je(a, JIT_BLOCK(g, i + 1));
+    jit_jmp(a, g->dispatch);
+}
+
+// Swaps the low `size` bytes of rcx when ctx->endianness is big endian
+static void jit_emit_swap(jit_gen* g, uint8_t size) {
+    static const uint8_t swap16[] = {0x66, 0xC1, 0xC1, 0x08};   // rol cx, 8
+    static const uint8_t swap32[] = {0x0F, 0xC9};               // bswap ecx
+    static const uint8_t swap64[] = {0x48, 0x0F, 0xC9};         // bswap rcx
+    jit_asm* a = g->a;
+    if (size == 1) return;
+    size_t little = jit_label(a);
+    jit_cmp_ctx_u32(a, offsetof(cnd_vm_ctx, endianness), CND_BE);
+    jit_jne(a, little);
+    if (size == 2) jit_bytes(a, swap16, sizeof(swap16));
+    else if (size == 4) jit_bytes(a, swap32, sizeof(swap32));
+    else jit_bytes(a, swap64, sizeof(swap64));
+    jit_bind(a, little);
+}
+
+// rax = ctx->cursor, rdx = ctx->data_buffer
+static void jit_emit_field_address(jit_gen* g) {
+    jit_load_ctx(g->a, JIT_RAX, offsetof(cnd_vm_ctx, cursor));
+    jit_load_ctx(g->a, JIT_RDX, offsetof(cnd_vm_ctx, data_buffer));
+}
+
+// xmm0 = (double) of the raw value of field type `op` in rcx (zero-extended)
+static void jit_emit_to_double(jit_asm* a, uint8_t op) {
+    static const uint8_t sx8[] = {0x48, 0x0F, 0xBE, 0xC9};          // movsx rcx, cl
+    static const uint8_t sx16[] = {0x48, 0x0F, 0xBF, 0xC9};         // movsx rcx, cx
+    static const uint8_t sx32[] = {0x48, 0x63, 0xC9};               // movsxd rcx, ecx
+    static const uint8_t f32[] = {0x66, 0x0F, 0x6E, 0xC1, 0xF3, 0x0F, 0x5A, 0xC0}; // movd xmm0, ecx ; cvtss2sd xmm0, xmm0
+    static const uint8_t f64[] = {0x66, 0x48, 0x0F, 0x6E, 0xC1};    // movq xmm0, rcx
+    static const uint8_t cvt[] = {0xF2, 0x48, 0x0F, 0x2A, 0xC1};    // cvtsi2sd xmm0, rcx
+    switch (op) {
+        case OP_IO_F32: jit_bytes(a, f32, sizeof(f32)); return;
+        case OP_IO_F64: jit_bytes(a, f64, sizeof(f64)); return;
+        case OP_IO_I8: jit_bytes(a, sx8, sizeof(sx8)); break;
+        case OP_IO_I16: jit_bytes(a, sx16, sizeof(sx16)); break;
+        case OP_IO_I32: jit_bytes(a, sx32, sizeof(sx32)); break;
+        default: break;
+    }
+    jit_bytes(a, cvt, sizeof(cvt));
+}
+
+// rcx = (ctype)xmm0 for field type `op`, truncating like the C conversion
+static void jit_emit_from_double(jit_asm* a, uint8_t op) {
+    static const uint8_t f32[] = {0xF2, 0x0F, 0x5A, 0xC0, 0x66, 0x0F, 0x7E, 0xC1}; // cvtsd2ss xmm0, xmm0 ; movd ecx, xmm0
+    static const uint8_t f64[] = {0x66, 0x48, 0x0F, 0x7E, 0xC1};    // movq rcx, xmm0
+    static const uint8_t cvt32[] = {0xF2, 0x0F, 0x2C, 0xC8};        // cvttsd2si ecx, xmm0
+    static const uint8_t cvt64[] = {0xF2, 0x48, 0x0F, 0x2C, 0xC8};  // cvttsd2si rcx, xmm0
+    switch (op) {
+        case OP_IO_F32: jit_bytes(a, f32, sizeof(f32)); break;
+        case OP_IO_F64: jit_bytes(a, f64, sizeof(f64)); break;
+        case OP_IO_U32: case OP_IO_I64: jit_bytes(a, cvt64, sizeof(cvt64)); break;
+        default: jit_bytes(a, cvt32, sizeof(cvt32)); break;
+    }
+}
+
+// esi = (uint16_t)(ctx->key_base + key), the Key ID the host sees
+static void jit_emit_key(jit_asm* a, uint16_t key) {
+    jit_byte(a, 0x0F); jit_byte(a, 0xB7); jit_ctx_operand(a, JIT_RSI, offsetof(cnd_vm_ctx, key_base)); // movzx esi, key_base
+    jit_byte(a, 0x81); jit_byte(a, 0xC6); jit_u32(a, key);                      // add esi, key
+    jit_byte(a, 0x0F); jit_byte(a, 0xB7); jit_byte(a, 0xF6);                    // movzx esi, si
+}
+
+// With cnd_bind_io as the callback: rdi = the host field of `I` when it is
+// bound with the same type in the innermost struct frame, else jumps to
+// `hosted`. Clobbers rax, rdx, rsi and r8.
+static void jit_emit_bound_field(jit_gen* g, const cnd_insn* I, size_t hosted) {
+    jit_asm* a = g->a;
+    jit_byte(a, 0x48); jit_byte(a, 0xB8); jit_u64(a, (uint64_t)(uintptr_t)&cnd_bind_io); // mov rax, cnd_bind_io
+    jit_byte(a, 0x48); jit_byte(a, 0x39); jit_ctx_operand(a, JIT_RAX, offsetof(cnd_vm_ctx, io_callback)); // cmp [rbx + io_callback], rax
+    jit_jne(a, hosted);
+    jit_load_ctx(a, JIT_RDI, offsetof(cnd_vm_ctx, user_ptr));                  // rdi = binder
+    jit_byte(a, 0x48); jit_byte(a, 0x85); jit_byte(a, 0xFF);                    // test rdi, rdi
+    jit_je(a, hosted);
+    jit_emit_key(a, I->key);
+    jit_byte(a, 0x66); jit_byte(a, 0x3B); jit_byte(a, 0xB7); jit_u32(a, offsetof(cnd_binder, count)); // cmp si, [rdi + count]
+    jit_jae(a, hosted);
+    jit_byte(a, 0x0F); jit_byte(a, 0xB6); jit_byte(a, 0x87); jit_u32(a, offsetof(cnd_binder, depth)); // movzx eax, byte [rdi + depth]
+    jit_byte(a, 0x85); jit_byte(a, 0xC0);                                       // test eax, eax
+    jit_je(a, hosted);
+
+    // r8 = &table[key]: a plain field of the op's own type
+    jit_byte(a, 0x4C); jit_byte(a, 0x8B); jit_byte(a, 0x87); jit_u32(a, offsetof(cnd_binder, table)); // mov r8, [rdi + table]
+    jit_byte(a, 0x69); jit_byte(a, 0xD6); jit_u32(a, sizeof(cnd_binding));      // imul edx, esi, sizeof(cnd_binding)
+    jit_byte(a, 0x49); jit_byte(a, 0x01); jit_byte(a, 0xD0);                    // add r8, rdx
+    jit_byte(a, 0x41); jit_byte(a, 0x80); jit_byte(a, 0xB8); jit_u32(a, offsetof(cnd_binding, type)); jit_byte(a, I->op); // cmp byte [r8 + type], op
+    jit_jne(a, hosted);
+    jit_byte(a, 0x41); jit_byte(a, 0x83); jit_byte(a, 0xB8); jit_u32(a, offsetof(cnd_binding, stride)); jit_byte(a, 0); // cmp dword [r8 + stride], 0
+    jit_jne(a, hosted);
+
+    // rax = &frames[depth - 1] - offsetof(frames); an array frame of the key takes elements
+    jit_byte(a, 0xFF); jit_byte(a, 0xC8);                                       // dec eax
+    jit_byte(a, 0x69); jit_byte(a, 0xC0); jit_u32(a, sizeof(cnd_bind_frame));   // imul eax, eax, sizeof(cnd_bind_frame)
+    jit_byte(a, 0x48); jit_byte(a, 0x01); jit_byte(a, 0xF8);                    // add rax, rdi
+    jit_byte(a, 0x66); jit_byte(a, 0x39); jit_byte(a, 0xB0);
+    jit_u32(a, offsetof(cnd_binder, frames) + offsetof(cnd_bind_frame, key));   // cmp [rax + frames.key], si
+    jit_je(a, hosted);
+
+    // rdi = frame base + offset
+    jit_byte(a, 0x48); jit_byte(a, 0x8B); jit_byte(a, 0xB8);
+    jit_u32(a, offsetof(cnd_binder, frames) + offsetof(cnd_bind_frame, base));  // mov rdi, [rax + frames.base]
+    jit_byte(a, 0x41); jit_byte(a, 0x8B); jit_byte(a, 0x80); jit_u32(a, offsetof(cnd_binding, offset)); // mov eax, [r8 + offset]
+    jit_byte(a, 0x48); jit_byte(a, 0x01); jit_byte(a, 0xC7);                    // add rdi, rax
+}
+
+// A byte-aligned primitive field of `size` bytes, plain or after OP_SCALE_LIN
+static void jit_emit_primitive(jit_gen* g, size_t i, const cnd_insn* I, uint8_t size, bool encode) {
+    static const uint8_t load1[] = {0x0F, 0xB6, 0x0C, 0x02};    // movzx ecx, byte [rdx+rax]
+    static const uint8_t load2[] = {0x0F, 0xB7, 0x0C, 0x02};    // movzx ecx, word [rdx+rax]
+    static const uint8_t load4[] = {0x8B, 0x0C, 0x02};          // mov ecx, [rdx+rax]
+    static const uint8_t load8[] = {0x48, 0x8B, 0x0C, 0x02};    // mov rcx, [rdx+rax]
+    static const uint8_t store1[] = {0x88, 0x0C, 0x02};         // mov [rdx+rax], cl
+    static const uint8_t store2[] = {0x66, 0x89, 0x0C, 0x02};   // mov [rdx+rax], cx
+    static const uint8_t store4[] = {0x89, 0x0C, 0x02};         // mov [rdx+rax], ecx
+    static const uint8_t store8[] = {0x48, 0x89, 0x0C, 0x02};   // mov [rdx+rax], rcx
+    static const uint8_t zero_slot[] = {0x48, 0xC7, 0x04, 0x24, 0, 0, 0, 0}; // mov qword [rsp], 0
+    static const uint8_t to_slot[] = {0x48, 0x89, 0x0C, 0x24};  // mov [rsp], rcx
+    static const uint8_t from_slot[] = {0x48, 0x8B, 0x0C, 0x24}; // mov rcx, [rsp]
+    static const uint8_t xmm0_to_slot[] = {0xF2, 0x0F, 0x11, 0x04, 0x24};   // movsd [rsp], xmm0
+    static const uint8_t slot_to_xmm0[] = {0xF2, 0x0F, 0x10, 0x04, 0x24};   // movsd xmm0, [rsp]
+    static const uint8_t host_load1[] = {0x0F, 0xB6, 0x0F};     // movzx ecx, byte [rdi]
+    static const uint8_t host_load2[] = {0x0F, 0xB7, 0x0F};     // movzx ecx, word [rdi]
+    static const uint8_t host_load4[] = {0x8B, 0x0F};           // mov ecx, [rdi]
+    static const uint8_t host_load8[] = {0x48, 0x8B, 0x0F};     // mov rcx, [rdi]
+    static const uint8_t host_store1[] = {0x88, 0x0F};          // mov [rdi], cl
+    static const uint8_t host_store2[] = {0x66, 0x89, 0x0F};    // mov [rdi], cx
+    static const uint8_t host_store4[] = {0x89, 0x0F};          // mov [rdi], ecx
+    static const uint8_t host_store8[] = {0x48, 0x89, 0x0F};    // mov [rdi], rcx
+    jit_asm* a = g->a;
+    size_t slow = jit_label(a);
+    size_t scaled = jit_label(a);
+    size_t next = JIT_BLOCK(g, i + 1);
+    bool can_scale = I->op != OP_IO_U64; // Needs no unsigned 64-bit conversion
+
+    // Anything but the plain and scaled cases goes through the prepared executor
+    jit_cmp_ctx_u8(a, offsetof(cnd_vm_ctx, bit_offset), 0);
+    jit_jne(a, slow);
+    jit_cmp_ctx_u8(a, offsetof(cnd_vm_ctx, is_next_optional), 0);
+    jit_jne(a, slow);
+    jit_cmp_ctx_u32(a, offsetof(cnd_vm_ctx, trans_type), CND_TRANS_NONE);
+    jit_jne(a, can_scale ? scaled : slow);
+
+    for (int pass = 0; pass < (can_scale ? 2 : 1); pass++) {
+        bool scale = pass == 1;
+        if (scale) {
+            jit_bind(a, scaled);
+            jit_cmp_ctx_u32(a, offsetof(cnd_vm_ctx, trans_type), CND_TRANS_SCALE_F64);
+            jit_jne(a, slow);
+        }
+        jit_load_ctx(a, JIT_RAX, offsetof(cnd_vm_ctx, cursor));
+        jit_byte(a, 0x48); jit_byte(a, 0x8D); jit_byte(a, 0x48); jit_byte(a, size); // lea rcx, [rax + size]
+        jit_byte(a, 0x48); jit_byte(a, 0x3B); jit_ctx_operand(a, JIT_RCX, offsetof(cnd_vm_ctx, data_len)); // cmp rcx, data_len
+        jit_ja(a, slow);
+
+        // Bound fields skip the callback: encoding has its value once rcx
+        // holds it, decoding is done once it is stored
+        size_t hosted = jit_label(a);
+        size_t have_value = jit_label(a);
+        size_t advance = jit_label(a);
+        if (encode) {
+            if (!scale) {
+                jit_emit_bound_field(g, I, hosted);
+                if (size == 1) jit_bytes(a, host_load1, sizeof(host_load1));
+                else if (size == 2) jit_bytes(a, host_load2, sizeof(host_load2));
+                else if (size == 4) jit_bytes(a, host_load4, sizeof(host_load4));
+                else jit_bytes(a, host_load8, sizeof(host_load8));
+                jit_jmp(a, have_value);
+            }
+            jit_bind(a, hosted);
+            jit_bytes(a, zero_slot, sizeof(zero_slot));
+        } else {
+            jit_load_ctx(a, JIT_RDX, offsetof(cnd_vm_ctx, data_buffer));
+            if (size == 1) jit_bytes(a, load1, sizeof(load1));
+            else if (size == 2) jit_bytes(a, load2, sizeof(load2));
+            else if (size == 4) jit_bytes(a, load4, sizeof(load4));
+            else jit_bytes(a, load8, sizeof(load8));
+            jit_emit_swap(g, size);
+            if (scale) {
+                // xmm0 = (double)raw * trans_f_factor + trans_f_offset
+                jit_emit_to_double(a, I->op);
+                jit_sse_ctx(a, 0x59, offsetof(cnd_vm_ctx, trans_f_factor));    // mulsd
+                jit_sse_ctx(a, 0x58, offsetof(cnd_vm_ctx, trans_f_offset));    // addsd
+                jit_bytes(a, xmm0_to_slot, sizeof(xmm0_to_slot));
+            } else {
+                jit_emit_bound_field(g, I, hosted);
+                if (size == 1) jit_bytes(a, host_store1, sizeof(host_store1));
+                else if (size == 2) jit_bytes(a, host_store2, sizeof(host_store2));
+                else if (size == 4) jit_bytes(a, host_store4, sizeof(host_store4));
+                else jit_bytes(a, host_store8, sizeof(host_store8));
+                jit_jmp(a, advance);
+                jit_bind(a, hosted);
+                jit_bytes(a, to_slot, sizeof(to_slot));
+            }
+        }
+
+        // ctx->io_callback(ctx, key + key_base, op, &slot); scaled values are doubles
+        jit_store_ctx_imm(a, offsetof(cnd_vm_ctx, ip), (uint32_t)(i + 1));
+        jit_emit_key(a, I->key);
+        jit_byte(a, 0x48); jit_byte(a, 0x89); jit_byte(a, 0xDF);                    // mov rdi, rbx
+        jit_byte(a, 0xBA); jit_u32(a, scale ? OP_IO_F64 : I->op);                   // mov edx, op
+        jit_byte(a, 0x48); jit_byte(a, 0x89); jit_byte(a, 0xE1);                    // mov rcx, rsp
+        jit_byte(a, 0xFF); jit_ctx_operand(a, 2, offsetof(cnd_vm_ctx, io_callback)); // call [rbx + io_callback]
+        jit_byte(a, 0x85); jit_byte(a, 0xC0);                                       // test eax, eax
+        jit_jne(a, g->callback);
+
+        if (encode) {
+            if (scale) {
+                // rcx = (ctype)((slot - trans_f_offset) / trans_f_factor)
+                jit_bytes(a, slot_to_xmm0, sizeof(slot_to_xmm0));
+                jit_sse_ctx(a, 0x5C, offsetof(cnd_vm_ctx, trans_f_offset));    // subsd
+                jit_sse_ctx(a, 0x5E, offsetof(cnd_vm_ctx, trans_f_factor));    // divsd
+                jit_emit_from_double(a, I->op);
+            } else {
+                jit_bytes(a, from_slot, sizeof(from_slot));
+            }
+            // The host may have moved the buffer or cursor
+            jit_bind(a, have_value);
+            jit_emit_field_address(g);
+            jit_emit_swap(g, size);
+            if (size == 1) jit_bytes(a, store1, sizeof(store1));
+            else if (size == 2) jit_bytes(a, store2, sizeof(store2));
+            else if (size == 4) jit_bytes(a, store4, sizeof(store4));
+            else jit_bytes(a, store8, sizeof(store8));
+        }
+        if (scale) jit_store_ctx_u32(a, offsetof(cnd_vm_ctx, trans_type), CND_TRANS_NONE);
+        jit_bind(a, advance);
+        jit_byte(a, 0x48); jit_byte(a, 0x83); jit_ctx_operand(a, 0, offsetof(cnd_vm_ctx, cursor)); jit_byte(a, size); // add cursor, size
+        jit_jmp(a, next);
+    }
+
+    jit_bind(a, slow);
+    jit_emit_step(g, i);
+}
+
+// OP_SCALE_LIN at i (extension slot at i + 1): the next field is scaled
+static void jit_emit_scale(jit_gen* g, size_t i, const cnd_insn* I) {
+    jit_asm* a = g->a;
+    jit_store_ctx_u64(a, offsetof(cnd_vm_ctx, trans_f_factor), I[0].imm);
+    jit_store_ctx_u64(a, offsetof(cnd_vm_ctx, trans_f_offset), I[1].imm);
+    jit_store_ctx_u32(a, offsetof(cnd_vm_ctx, trans_type), CND_TRANS_SCALE_F64);
+    jit_jmp(a, JIT_BLOCK(g, i + 2));
+}
+
+// OP_CRC_16 / OP_CRC_32: the checksum of the region comes from
+// vm_crc_region(); the field is then checked or written like a primitive
+static void jit_emit_crc(jit_gen* g, size_t i, const cnd_insn* I, bool encode) {
+    static const uint8_t load2[] = {0x0F, 0xB7, 0x0C, 0x32};    // movzx ecx, word [rdx+rsi]
+    static const uint8_t load4[] = {0x8B, 0x0C, 0x32};          // mov ecx, [rdx+rsi]
+    static const uint8_t store2[] = {0x66, 0x89, 0x0C, 0x32};   // mov [rdx+rsi], cx
+    static const uint8_t store4[] = {0x89, 0x0C, 0x32};         // mov [rdx+rsi], ecx
+    jit_asm* a = g->a;
+    size_t slow = jit_label(a);
+    size_t oob = jit_label(a);
+    size_t mismatch = jit_label(a);
+    uint8_t size = I->op == OP_CRC_16 ? 2 : 4;
+
+    jit_cmp_ctx_u8(a, offsetof(cnd_vm_ctx, bit_offset), 0);
+    jit_jne(a, slow);
+
+    // eax = vm_crc_region(ctx, poly, init, xorout, flags, width)
+    jit_byte(a, 0x48); jit_byte(a, 0x89); jit_byte(a, 0xDF);                    // mov rdi, rbx
+    jit_byte(a, 0xBE); jit_u32(a, I->a);                                        // mov esi, poly
+    jit_byte(a, 0xBA); jit_u32(a, (uint32_t)I->imm);                            // mov edx, init
+    jit_byte(a, 0xB9); jit_u32(a, (uint32_t)(I->imm >> 32));                    // mov ecx, xorout
+    jit_byte(a, 0x41); jit_byte(a, 0xB8); jit_u32(a, I->arg);                   // mov r8d, flags
+    jit_byte(a, 0x41); jit_byte(a, 0xB9); jit_u32(a, size * 8u);                // mov r9d, width
+    jit_call_abs(a, (uint64_t)(uintptr_t)&vm_crc_region);
+
+    jit_load_ctx(a, JIT_RSI, offsetof(cnd_vm_ctx, cursor));
+    jit_byte(a, 0x48); jit_byte(a, 0x8D); jit_byte(a, 0x56); jit_byte(a, size); // lea rdx, [rsi + size]
+    jit_byte(a, 0x48); jit_byte(a, 0x3B); jit_ctx_operand(a, JIT_RDX, offsetof(cnd_vm_ctx, data_len)); // cmp rdx, data_len
+    jit_ja(a, oob);
+    jit_load_ctx(a, JIT_RDX, offsetof(cnd_vm_ctx, data_buffer));
+    if (encode) {
+        jit_byte(a, 0x89); jit_byte(a, 0xC1);                                   // mov ecx, eax
+        jit_emit_swap(g, size);
+        if (size == 2) jit_bytes(a, store2, sizeof(store2));
+        else jit_bytes(a, store4, sizeof(store4));
+    } else {
+        if (size == 2) {
+            jit_bytes(a, load2, sizeof(load2));
+            jit_byte(a, 0x0F); jit_byte(a, 0xB7); jit_byte(a, 0xC0);            // movzx eax, ax
+        } else {
+            jit_bytes(a, load4, sizeof(load4));
+        }
+        jit_emit_swap(g, size);
+        jit_byte(a, 0x39); jit_byte(a, 0xC1);                                   // cmp ecx, eax
+        jit_jne(a, mismatch);
+    }
+    jit_byte(a, 0x48); jit_byte(a, 0x83); jit_ctx_operand(a, 0, offsetof(cnd_vm_ctx, cursor)); jit_byte(a, size); // add cursor, size
+    jit_jmp(a, JIT_BLOCK(g, i + 1));
+
+    jit_bind(a, oob);
+    jit_byte(a, 0xB8); jit_u32(a, CND_ERR_OOB);                                 // mov eax, CND_ERR_OOB
+    jit_jmp(a, g->exit);
+    jit_bind(a, mismatch);
+    jit_byte(a, 0xB8); jit_u32(a, CND_ERR_CRC_MISMATCH);                        // mov eax, CND_ERR_CRC_MISMATCH
+    jit_jmp(a, g->exit);
+    jit_bind(a, slow);
+    jit_emit_step(g, i);
+}
+
+static uint8_t jit_primitive_size(uint8_t op) {
+    switch (op) {
+        case OP_IO_U8: case OP_IO_I8: return 1;
+        case OP_IO_U16: case OP_IO_I16: return 2;
+        case OP_IO_U32: case OP_IO_I32: case OP_IO_F32: return 4;
+        case OP_IO_U64: case OP_IO_I64: case OP_IO_F64: return 8;
+        default: return 0;
+    }
+}
+
+// Where the pieces of one mode's function ended up
+typedef struct {
+    size_t entry;        // Label of the prologue
+    size_t first;        // Label of instruction 0
+    size_t table_patch;  // Offset of the table address in `mov r12, imm64`
+    size_t table;        // Offset of the block address table
+} jit_mode;
+
+// Emits the function for one mode followed by its block table
+static void jit_emit_mode(jit_asm* a, const cnd_prepared* prepared, bool encode, jit_mode* out) {
+    static const uint8_t prologue[] = {
+        0x53,                   // push rbx
+        0x41, 0x54,             // push r12
+        0x41, 0x55,             // push r13
+        0x48, 0x83, 0xEC, 0x10, // sub rsp, 16 (keeps rsp 16-byte aligned for calls)
+        0x48, 0x89, 0xFB,       // mov rbx, rdi
+        0x49, 0x89, 0xF5,       // mov r13, rsi
+    };
+    static const uint8_t epilogue[] = {
+        0x48, 0x83, 0xC4, 0x10, // add rsp, 16
+        0x41, 0x5D,             // pop r13
+        0x41, 0x5C,             // pop r12
+        0x5B,                   // pop rbx
+        0xC3,                   // ret
+    };
+    static const uint8_t indirect[] = {0x41, 0xFF, 0x24, 0xC4}; // jmp [r12 + rax*8]
+    size_t count = prepared->insn_count;
+    jit_gen g;
+
+    g.a = a;
+    g.prepared = prepared;
+    g.first = a->label_count;
+    for (size_t i = 0; i <= count; i++) jit_label(a);
+    g.done = JIT_BLOCK(&g, count);
+    g.dispatch = jit_label(a);
+    g.exit = jit_label(a);
+    g.callback = jit_label(a);
+    out->entry = jit_label(a);
+    out->first = g.first;
+
+    jit_bind(a, out->entry);
+    jit_bytes(a, prologue, sizeof(prologue));
+    jit_byte(a, 0x49); jit_byte(a, 0xBC);                       // mov r12, imm64
+    out->table_patch = a->len;
+    jit_u64(a, 0);
+
+    jit_bind(a, g.dispatch);
+    jit_load_ctx(a, JIT_RAX, offsetof(cnd_vm_ctx, ip));
+    jit_byte(a, 0x48); jit_byte(a, 0x3D); jit_u32(a, (uint32_t)count); // cmp rax, count
+    jit_jae(a, g.done);
+    jit_bytes(a, indirect, sizeof(indirect));
+
+    for (size_t i = 0; i < count; i++) {
+        const cnd_insn* I = &prepared->insns[i];
+        jit_bind(a, JIT_BLOCK(&g, i));
+        switch (I->op) {
+            case OP_NOOP:
+                break;
+            case OP_SET_ENDIAN_LE:
+            case OP_SET_ENDIAN_BE:
+                jit_store_ctx_u32(a, offsetof(cnd_vm_ctx, endianness), I->op == OP_SET_ENDIAN_BE ? CND_BE : CND_LE);
+                break;
+            case OP_JUMP:
+                jit_jmp(a, JIT_BLOCK(&g, I->a < count ? I->a : count));
+                break;
+            case OP_SCALE_LIN:
+                if (i + 1 < count) jit_emit_scale(&g, i, I);
+                else jit_emit_step(&g, i);
+                break;
+            case OP_CRC_BEGIN:
+                jit_load_ctx(a, JIT_RAX, offsetof(cnd_vm_ctx, cursor));
+                jit_store_ctx(a, offsetof(cnd_vm_ctx, crc_start), JIT_RAX);
+                jit_store_ctx_imm(a, offsetof(cnd_vm_ctx, crc_end), 0xFFFFFFFFu); // SIZE_MAX
+                jit_byte(a, 0xC6); jit_ctx_operand(a, 0, offsetof(cnd_vm_ctx, crc_width)); jit_byte(a, 0); // mov byte [rbx + crc_width], 0
+                break;
+            case OP_CRC_END:
+                jit_load_ctx(a, JIT_RAX, offsetof(cnd_vm_ctx, cursor));
+                jit_store_ctx(a, offsetof(cnd_vm_ctx, crc_end), JIT_RAX);
+                break;
+            case OP_CRC_16:
+            case OP_CRC_32:
+                jit_emit_crc(&g, i, I, encode);
+                break;
+            default: {
+                uint8_t size = jit_primitive_size(I->op);
+                if (size) jit_emit_primitive(&g, i, I, size, encode);
+                else jit_emit_step(&g, i);
+                break;
+            }
+        }
+    }
+
+    jit_bind(a, g.done);
+    jit_byte(a, 0x31); jit_byte(a, 0xC0);                       // xor eax, eax
+    jit_jmp(a, g.exit);
+    jit_bind(a, g.callback);
+    jit_byte(a, 0xB8); jit_u32(a, CND_ERR_CALLBACK);            // mov eax, CND_ERR_CALLBACK
+    jit_bind(a, g.exit);
+    jit_bytes(a, epilogue, sizeof(epilogue));
+
+    // Filled with absolute addresses once the code has its final place
+    while (a->len % 8) jit_byte(a, 0xCC);
+    out->table = a->len;
+    for (size_t i = 0; i < count; i++) jit_u64(a, 0);
+}
+
+static void jit_asm_free(jit_asm* a) {
+    free(a->code);
+    free(a->labels);
+    free(a->fixups);
+}
+
+cnd_error_t cnd_program_jit(cnd_jit* jit, const cnd_prepared* prepared) {
+    if (!jit || !prepared || !prepared->program) return CND_ERR_OOB;
+    if (!prepared->insns && prepared->insn_count > 0) return CND_ERR_OOB;
+    memset(jit, 0, sizeof(*jit));
+    // Instruction indices are 32-bit immediates in the generated code
+    if (prepared->insn_count >= INT32_MAX) return CND_ERR_OOB;
+    // Enum fields are compared as dwords
+    if (sizeof(cnd_endian_t) != 4 || sizeof(cnd_trans_t) != 4) return CND_ERR_INVALID_OP;
+
+    size_t count = prepared->insn_count;
+    jit_asm a;
+    jit_mode modes[2]; // Indexed by cnd_mode_t
+    memset(&a, 0, sizeof(a));
+    jit_emit_mode(&a, prepared, true, &modes[CND_MODE_ENCODE]);
+    jit_emit_mode(&a, prepared, false, &modes[CND_MODE_DECODE]);
+
+    if (!jit_link(&a)) {
+        jit_asm_free(&a);
+        return CND_ERR_OOB;
+    }
+
+    void* mem = mmap(NULL, a.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        jit_asm_free(&a);
+        return CND_ERR_OOB;
+    }
+    uint8_t* base = (uint8_t*)mem;
+    memcpy(base, a.code, a.len);
+
+    for (int m = 0; m < 2; m++) {
+        uint64_t table = (uint64_t)(uintptr_t)(base + modes[m].table);
+        memcpy(base + modes[m].table_patch, &table, 8);
+        for (size_t i = 0; i < count; i++) {
+            uint64_t addr = (uint64_t)(uintptr_t)(base + a.labels[modes[m].first + i]);
+            memcpy(base + modes[m].table + i * 8, &addr, 8);
+        }
+        jit->entry[m] = a.labels[modes[m].entry];
+    }
+    jit->code_size = a.len;
+    jit_asm_free(&a);
+
+    if (mprotect(mem, jit->code_size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, jit->code_size);
+        memset(jit, 0, sizeof(*jit));
+        return CND_ERR_OOB;
+    }
+    jit->prepared = prepared;
+    jit->code = mem;
+    return CND_ERR_OK;
+}
+
+cnd_error_t cnd_execute_jit(cnd_vm_ctx* ctx, const cnd_jit* jit) {
+    if (!ctx || !jit || !jit->code || !ctx->data_buffer) return CND_ERR_OOB;
+    const cnd_prepared* prepared = jit->prepared;
+    if (ctx->ip > prepared->insn_count) return CND_ERR_OOB;
+
+    // Same rule as cnd_execute_prepared()
+    jit_run run;
+    run.prepared = prepared;
+    run.unchecked = prepared->stacks_verified && ctx->ip == 0 && ctx->expr_sp == 0 &&
+                    ctx->loop_depth == 0 && ctx->call_depth == 0;
+
+    jit_fn fn;
+    void* entry = (uint8_t*)jit->code + jit->entry[ctx->mode == CND_MODE_ENCODE ? CND_MODE_ENCODE : CND_MODE_DECODE];
+    memcpy(&fn, &entry, sizeof(fn));
+    int result = fn(ctx, &run);
+    return result == JIT_FINISHED ? CND_ERR_OK : (cnd_error_t)result;
+}
+
+void cnd_jit_free(cnd_jit* jit) {
+    if (!jit) return;
+    if (jit->code) munmap(jit->code, jit->code_size);
+    memset(jit, 0, sizeof(*jit));
+}
+
+#else
+
+cnd_error_t cnd_program_jit(cnd_jit* jit, const cnd_prepared* prepared) {
+    (void)prepared;
+    if (jit) memset(jit, 0, sizeof(*jit));
+    return CND_ERR_INVALID_OP;
+}
+
+cnd_error_t cnd_execute_jit(cnd_vm_ctx* ctx, const cnd_jit* jit) {
+    (void)ctx;
+    (void)jit;
+    return CND_ERR_INVALID_OP;
+}
+
+void cnd_jit_free(cnd_jit* jit) {
+    if (jit) memset(jit, 0, sizeof(*jit));
+}
+
+#endif
@@ -0,0 +1,1162 @@
+#include "vm_handlers.h"
+
+// Prepared programs: the bytecode is verified and decoded once into fixed-size
+// cnd_insn slots, so the interpreter below never re-parses operands, never
+// scans for loop ends and never reads switch tables at run time.
+
+// Maximum array nesting the translator can match ARR_* openers against ARR_END.
+#define PREP_MAX_OPEN_ARRAYS 64
+
+// --- Translation ---
+
+// Byte offset scratch (one u32 per slot) lives directly after the instructions.
+static inline uint32_t prep_get_offset(const uint8_t* offsets, size_t idx) {
+    uint32_t v;
+    memcpy(&v, offsets + idx * 4, 4);
+    return v;
+}
+
+static inline void prep_set_offset(uint8_t* offsets, size_t idx, uint32_t v) {
+    memcpy(offsets + idx * 4, &v, 4);
+}
+
+static inline uint32_t prep_target(size_t code_start_ip, const uint8_t* off) {
+    // Verified in cnd_verify_program to land within [0, bytecode_len]
+    return (uint32_t)((int64_t)code_start_ip + (int32_t)il_get_u32(off));
+}
+
+// Decodes the fixed operands of the instruction at `ip` into `insn`.
+static void prep_decode(const uint8_t* bc, size_t ip, cnd_insn* insn) {
+    const uint8_t* op = bc + ip;
+    uint8_t opcode = op[0];
+
+    memset(insn, 0, sizeof(*insn));
+    insn->op = opcode;
+
+    switch (opcode) {
+        case OP_NOOP:
+        case OP_META_VERSION:
+        case OP_META_NAME:
+        case OP_ENTER_BIT_MODE:
+            insn->op = OP_NOOP;
+            break;
+
+        case OP_ENTER_STRUCT:
+        case OP_IO_U8: case OP_IO_U16: case OP_IO_U32: case OP_IO_U64:
+        case OP_IO_I8: case OP_IO_I16: case OP_IO_I32: case OP_IO_I64:
+        case OP_IO_F32: case OP_IO_F64: case OP_IO_BOOL:
+        case OP_STR_PRE_U8: case OP_STR_PRE_U16: case OP_STR_PRE_U32:
+        case OP_ARR_PRE_U8: case OP_ARR_PRE_U16: case OP_ARR_PRE_U32:
+        case OP_ARR_EOF:
+        case OP_LOAD_CTX:
+        case OP_STORE_CTX:
+            insn->key = il_get_u16(op + 1);
+            break;
+
+        case OP_IO_BIT_U:
+        case OP_IO_BIT_I:
+        case OP_IO_BIT_BOOL:
+            insn->key = il_get_u16(op + 1);
+            insn->arg = op[3];
+            break;
+
+        case OP_IO_SLOT:
+            // Scoreboard record of the field before it (see prep_build)
+            insn->arg = op[1];
+            insn->key = il_get_u16(op + 2);
+            break;
+
+        case OP_ALIGN_PAD:
+        case OP_ALIGN_FILL:
+        case OP_EMIT:
+            insn->arg = op[1];
+            break;
+
+        case OP_STR_NULL:
+            insn->key = il_get_u16(op + 1);
+            insn->a = il_get_u16(op + 3);
+            break;
+
+        case OP_RAW_BYTES:
+            insn->key = il_get_u16(op + 1);
+            insn->a = il_get_u32(op + 3);
+            break;
+
+        case OP_ARR_FIXED:
+            insn->key = il_get_u16(op + 1);
+            insn->imm = il_get_u32(op + 3);
+            break;
+
+        case OP_ARR_DYNAMIC:
+            insn->key = il_get_u16(op + 1);
+            insn->imm = il_get_u16(op + 3);
+            break;
+
+        case OP_CONST_CHECK: {
+            uint32_t size = il_type_size(op[3]);
+            insn->key = il_get_u16(op + 1);
+            insn->arg = op[3];
+            if (size == 1) insn->imm = op[4];
+            else if (size == 2) insn->imm = il_get_u16(op + 4);
+            else if (size == 4) insn->imm = il_get_u32(op + 4);
+            else insn->imm = il_get_u64(op + 4);
+            break;
+        }
+
+        case OP_CONST_WRITE: {
+            uint32_t size = il_type_size(op[1]);
+            insn->arg = op[1];
+            if (size == 1) insn->imm = op[2];
+            else if (size == 2) insn->imm = il_get_u16(op + 2);
+            else if (size == 4) insn->imm = il_get_u32(op + 2);
+            else insn->imm = il_get_u64(op + 2);
+            break;
+        }
+
+        case OP_RANGE_CHECK: {
+            uint32_t size = il_type_size(op[1]);
+            insn->arg = op[1];
+            if (size == 1) { insn->imm = op[2]; insn[1].imm = op[3]; }
+            else if (size == 2) { insn->imm = il_get_u16(op + 2); insn[1].imm = il_get_u16(op + 4); }
+            else if (size == 4) { insn->imm = il_get_u32(op + 2); insn[1].imm = il_get_u32(op + 6); }
+            else { insn->imm = il_get_u64(op + 2); insn[1].imm = il_get_u64(op + 10); }
+            break;
+        }
+
+        case OP_IO_BIT_GROUP:
+            insn->arg = op[1];
+            insn->imm = ip + 2; // Field descriptors stay in the bytecode
+            break;
+
+        case OP_ENUM_BITMAP: {
+            uint32_t size = il_type_size(op[1]);
+            insn->arg = op[1];
+            if (size == 1) insn->imm = op[2];
+            else if (size == 2) insn->imm = il_get_u16(op + 2);
+            else if (size == 4) insn->imm = il_get_u32(op + 2);
+            else insn->imm = il_get_u64(op + 2);
+            insn->a = il_get_u16(op + 2 + size);
+            insn[1].imm = ip + 4 + size; // Bitmap stays in the bytecode
+            break;
+        }
+
+        case OP_ENUM_CHECK:
+        case OP_ENUM_SORTED:
+            insn->arg = op[1];
+            insn->a = il_get_u16(op + 2);
+            insn->imm = ip + 4; // Values stay in the bytecode
+            break;
+
+        case OP_SCALE_LIN:
+            insn->imm = il_get_u64(op + 1);
+            insn[1].imm = il_get_u64(op + 9);
+            break;
+
+        case OP_CRC_16:
+            insn->a = il_get_u16(op + 1);
+            insn->imm = (uint64_t)il_get_u16(op + 3) | ((uint64_t)il_get_u16(op + 5) << 32);
+            insn->arg = op[7];
+            break;
+
+        case OP_CRC_32:
+            insn->a = il_get_u32(op + 1);
+            insn->imm = (uint64_t)il_get_u32(op + 5) | ((uint64_t)il_get_u32(op + 9) << 32);
+            insn->arg = op[13];
+            break;
+
+        case OP_TRANS_ADD:
+        case OP_TRANS_SUB:
+        case OP_TRANS_MUL:
+        case OP_TRANS_DIV:
+        case OP_PUSH_IMM:
+            insn->imm = il_get_u64(op + 1);
+            break;
+
+        case OP_TRANS_POLY:
+        case OP_TRANS_SPLINE:
+            insn->arg = op[1];
+            insn->imm = ip + 2; // Coefficients / points stay in the bytecode
+            break;
+
+        case OP_EXPR:
+            insn->arg = op[1];
+            insn->imm = ip + 2; // Register program stays in the bytecode
+            break;
+
+        case OP_JUMP:
+        case OP_JUMP_IF_NOT:
+            insn->a = prep_target(ip + 5, op + 1);
+            break;
+
+        case OP_CALL:
+            insn->key = il_get_u16(op + 1);
+            insn->imm = il_get_u16(op + 3);
+            insn->a = prep_target(ip + 9, op + 5);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Decodes the out-of-line table of the switch at `ip` into `insn` and its
+// extension slots. Targets are left as byte offsets.
+static void prep_decode_switch(const uint8_t* bc, size_t ip, size_t table_start, cnd_insn* insn) {
+    const uint8_t* t = bc + table_start;
+    size_t code_start_ip = ip + 7;
+
+    insn->key = il_get_u16(bc + ip + 1);
+    if (bc[ip] == OP_SWITCH || bc[ip] == OP_SWITCH_SORTED) {
+        uint16_t count = il_get_u16(t);
+        insn->a = prep_target(code_start_ip, t + 2);
+        insn->imm = count;
+        for (uint16_t i = 0; i < count; i++) {
+            cnd_insn* ext = &insn[1 + i];
+            ext->imm = il_get_u64(t + 6 + (size_t)i * 12);
+            ext->a = prep_target(code_start_ip, t + 6 + (size_t)i * 12 + 8);
+        }
+    } else if (bc[ip] == OP_SWITCH_HASH) {
+        // The displacements stay in the bytecode; slots follow the second slot
+        uint8_t bucket_bits = t[13];
+        const uint8_t* entries = t + 14 + ((size_t)2 << bucket_bits);
+        uint32_t slots = 1u << t[12];
+        insn->a = prep_target(code_start_ip, t);
+        insn->imm = il_get_u64(t + 4);
+        insn->arg = t[12];
+        insn[1].arg = bucket_bits;
+        insn[1].imm = table_start + 14;
+        for (uint32_t i = 0; i < slots; i++) {
+            insn[2 + i].imm = il_get_u64(entries + (size_t)i * 12);
+            insn[2 + i].a = prep_target(code_start_ip, entries + (size_t)i * 12 + 8);
+        }
+    } else {
+        uint64_t min_val = il_get_u64(t);
+        uint64_t max_val = il_get_u64(t + 8);
+        uint32_t count = (uint32_t)(max_val - min_val + 1);
+        insn->a = prep_target(code_start_ip, t + 16);
+        insn->imm = min_val;
+        insn[1].imm = max_val;
+        insn[1].a = count;
+        for (uint32_t i = 0; i < count; i++) {
+            insn[2 + i].a = prep_target(code_start_ip, t + 20 + (size_t)i * 4);
+        }
+    }
+}
+
+// Walks the verified bytecode. With `insns` == NULL only counts slots;
+// otherwise fills `insns` and the byte offset of every slot into `offsets`.
+static cnd_error_t prep_pass(const cnd_program* program, cnd_insn* insns, uint8_t* offsets, size_t* out_count) {
+    const uint8_t* bc = program->bytecode;
+    size_t len = program->bytecode_len;
+    size_t ip = 0;
+    size_t n = 0;
+
+    size_t pending_start[VM_MAX_PENDING_TABLES];
+    size_t pending_end[VM_MAX_PENDING_TABLES];
+    int pending = 0;
+
+    size_t open[PREP_MAX_OPEN_ARRAYS];
+    int open_depth = 0;
+
+    while (ip < len) {
+        // Skip over a switch table we have reached
+        bool skipped = false;
+        for (int i = 0; i < pending; i++) {
+            if (pending_start[i] == ip) {
+                ip = pending_end[i];
+                pending_start[i] = pending_start[pending - 1];
+                pending_end[i] = pending_end[pending - 1];
+                pending--;
+                skipped = true;
+                break;
+            }
+        }
+        if (skipped) continue;
+
+        uint8_t opcode = bc[ip];
+        size_t instr_len = 0;
+        cnd_error_t err = vm_insn_length(bc, len, ip, &instr_len);
+        if (err != CND_ERR_OK) return err;
+
+        size_t ext = 0;
+        size_t table_start = 0, table_len = 0;
+        switch (opcode) {
+            case OP_CTX_QUERY:
+                // Host-side query tag, never valid as an instruction
+                return CND_ERR_INVALID_OP;
+
+            case OP_RANGE_CHECK:
+            case OP_SCALE_LIN:
+            case OP_ENUM_BITMAP:
+                ext = 1;
+                break;
+
+            case OP_SWITCH:
+            case OP_SWITCH_TABLE:
+            case OP_SWITCH_SORTED:
+            case OP_SWITCH_HASH:
+                err = vm_switch_table_span(bc, len, ip, &table_start, &table_len);
+                if (err != CND_ERR_OK) return err;
+                if (pending >= VM_MAX_PENDING_TABLES) return CND_ERR_STACK_OVERFLOW;
+                pending_start[pending] = table_start;
+                pending_end[pending] = table_start + table_len;
+                pending++;
+                if (opcode == OP_SWITCH_TABLE) ext = 1 + (table_len - 20) / 4;
+                else if (opcode == OP_SWITCH_HASH) ext = 1 + ((size_t)1 << bc[table_start + 12]);
+                else ext = il_get_u16(bc + table_start);
+                break;
+
+            default:
+                break;
+        }
+
+        if (opcode == OP_IO_RUN || opcode == OP_IO_CHECK || opcode == OP_IO_SLOT) {
+            // Superinstructions save bytecode dispatches, which prepared
+            // programs do not have, so their parts become ordinary slots
+            // that all keep the superinstruction's offset. An OP_IO_SLOT
+            // becomes its field and then a slot that records it.
+            size_t slots = bc[ip + 1];
+            if (opcode == OP_IO_CHECK) slots = 2 + (bc[ip + 4] == OP_RANGE_CHECK || bc[ip + 4] == OP_ENUM_BITMAP);
+            if (opcode == OP_IO_SLOT) slots = 2;
+            if (n + slots > 0xFFFFFFFF) return CND_ERR_OOB;
+            if (insns) {
+                memset(&insns[n], 0, slots * sizeof(cnd_insn));
+                if (opcode == OP_IO_RUN) {
+                    for (size_t i = 0; i < slots; i++) prep_decode(bc, ip + 4 + i * 3, &insns[n + i]);
+                } else if (opcode == OP_IO_SLOT) {
+                    prep_decode(bc, ip + 1, &insns[n]);
+                    prep_decode(bc, ip, &insns[n + 1]);
+                } else {
+                    prep_decode(bc, ip + 1, &insns[n]);     // Type(1) Key(2) reads as the IO op
+                    prep_decode(bc, ip + 4, &insns[n + 1]);
+                }
+                for (size_t i = 0; i < slots; i++) prep_set_offset(offsets, n + i, (uint32_t)ip);
+            }
+            n += slots;
+            ip += instr_len;
+            continue;
+        }
+
+        if (n + 1 + ext > 0xFFFFFFFF) return CND_ERR_OOB;
+
+        if (insns) {
+            // Extension slots decode as OP_NOOP
+            if (ext > 0) memset(&insns[n + 1], 0, ext * sizeof(cnd_insn));
+            prep_decode(bc, ip, &insns[n]);
+            if (table_len > 0) prep_decode_switch(bc, ip, table_start, &insns[n]);
+            for (size_t i = 0; i <= ext; i++) prep_set_offset(offsets, n + i, (uint32_t)ip);
+        }
+
+        // Match loop openers with their ARR_END; the exit index is the slot after it
+        switch (opcode) {
+            case OP_ARR_FIXED:
+            case OP_ARR_PRE_U8:
+            case OP_ARR_PRE_U16:
+            case OP_ARR_PRE_U32:
+            case OP_ARR_EOF:
+            case OP_ARR_DYNAMIC:
+                if (open_depth >= PREP_MAX_OPEN_ARRAYS) return CND_ERR_STACK_OVERFLOW;
+                open[open_depth++] = n;
+                break;
+            case OP_ARR_END:
+                if (open_depth == 0) return CND_ERR_INVALID_OP;
+                open_depth--;
+                if (insns) insns[open[open_depth]].a = (uint32_t)(n + 1);
+                break;
+            default:
+                break;
+        }
+
+        n += 1 + ext;
+        ip += instr_len;
+    }
+
+    if (open_depth != 0 || pending != 0) return CND_ERR_INVALID_OP;
+
+    *out_count = n;
+    return CND_ERR_OK;
+}
+
+// Maps a byte offset to the index of the instruction starting there.
+static cnd_error_t prep_resolve(const uint8_t* offsets, size_t count, size_t bytecode_len, uint32_t* target) {
+    if (*target == bytecode_len) {
+        *target = (uint32_t)count;
+        return CND_ERR_OK;
+    }
+
+    // Lower bound: extension slots share their primary's offset and follow it
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (prep_get_offset(offsets, mid) < *target) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == count || prep_get_offset(offsets, lo) != *target) return CND_ERR_OOB; // Not an instruction boundary
+
+    *target = (uint32_t)lo;
+    return CND_ERR_OK;
+}
+
+// Instructions plus the scratch that follows them: the byte offset of every
+// slot while targets are resolved, then vm_verify_depths() state
+static size_t prep_capacity(size_t count) {
+    size_t scratch = count * (VM_DEPTH_SCRATCH > 4 ? VM_DEPTH_SCRATCH : 4);
+    return count + (scratch + sizeof(cnd_insn) - 1) / sizeof(cnd_insn);
+}
+
+static cnd_error_t prep_size(const cnd_program* program, size_t* count) {
+    if (!program || !program->bytecode) return CND_ERR_OOB;
+    if (program->bytecode_len > 0xFFFFFFFF) return CND_ERR_OOB;
+
+    cnd_error_t err = cnd_verify_program(program);
+    if (err != CND_ERR_OK) return err;
+
+    return prep_pass(program, NULL, NULL, count);
+}
+
+cnd_error_t cnd_program_prepare_size(const cnd_program* program, size_t* out_capacity) {
+    if (!out_capacity) return CND_ERR_OOB;
+
+    size_t count = 0;
+    cnd_error_t err = prep_size(program, &count);
+    if (err != CND_ERR_OK) return err;
+
+    *out_capacity = prep_capacity(count);
+    return CND_ERR_OK;
+}
+
+cnd_error_t cnd_program_prepare(cnd_prepared* prepared, const cnd_program* program,
+                                cnd_insn* storage, size_t capacity)
+{
+    if (!prepared) return CND_ERR_OOB;
+
+    size_t count = 0;
+    cnd_error_t err = prep_size(program, &count);
+    if (err != CND_ERR_OK) return err;
+
+    if (prep_capacity(count) > capacity) return CND_ERR_OOB;
+    if (count > 0 && !storage) return CND_ERR_OOB;
+
+    uint8_t* offsets = (uint8_t*)(storage + count);
+    err = prep_pass(program, storage, offsets, &count);
+    if (err != CND_ERR_OK) return err;
+
+    // Rewrite byte offset targets into instruction indices
+    for (size_t i = 0; i < count; i++) {
+        cnd_insn* insn = &storage[i];
+        size_t targets = 0;
+        cnd_insn* first = NULL;
+
+        switch (insn->op) {
+            case OP_JUMP:
+            case OP_JUMP_IF_NOT:
+            case OP_CALL:
+                break;
+            case OP_SWITCH:
+            case OP_SWITCH_SORTED:
+                first = insn + 1;
+                targets = (size_t)insn->imm;
+                break;
+            case OP_SWITCH_TABLE:
+                first = insn + 2;
+                targets = insn[1].a;
+                break;
+            case OP_SWITCH_HASH:
+                first = insn + 2;
+                targets = (size_t)1 << insn->arg;
+                break;
+            default:
+                continue;
+        }
+
+        err = prep_resolve(offsets, count, program->bytecode_len, &insn->a);
+        if (err != CND_ERR_OK) return err;
+        for (size_t t = 0; t < targets; t++) {
+            err = prep_resolve(offsets, count, program->bytecode_len, &first[t].a);
+            if (err != CND_ERR_OK) return err;
+        }
+    }
+
+    // The offsets are no longer needed; their scratch holds the depth proof
+    uint8_t max_stack = 0, max_loops = 0;
+    bool stacks_verified = vm_verify_depths(storage, count, offsets, &max_stack, &max_loops);
+
+    // Fixed prefix: plain fields (no transform, check or @optional can come
+    // between them) whose offsets do not depend on the data
+    size_t fixed_count = 0, fixed_size = 0;
+    for (; fixed_count < count; fixed_count++) {
+        uint8_t op = storage[fixed_count].op;
+        if (op >= OP_IO_U8 && op <= OP_IO_F64) fixed_size += il_type_size(op);
+        else if (op != OP_NOOP && op != OP_SET_ENDIAN_LE && op != OP_SET_ENDIAN_BE &&
+                 op != OP_ENTER_STRUCT && op != OP_EXIT_STRUCT && op != OP_IO_SLOT) break;
+    }
+
+    prepared->program = program;
+    prepared->insns = storage;
+    prepared->insn_count = count;
+    prepared->fixed_count = fixed_count;
+    prepared->fixed_size = fixed_size;
+    prepared->stacks_verified = stacks_verified;
+    prepared->max_stack_depth = max_stack;
+    prepared->max_loop_depth = max_loops;
+    return CND_ERR_OK;
+}
+
+// --- Execution ---
+
+// Prepared-image counterpart of the interpreter's bulk array path
+static bool prep_try_bulk_array(cnd_vm_ctx* ctx, const cnd_prepared* prepared, uint32_t count, cnd_error_t* err) {
+    if (count == 0) return false;
+    size_t ip = ctx->ip;
+
+    double scale[2];
+    bool scaled = false;
+    if (ip < prepared->insn_count && prepared->insns[ip].op == OP_SCALE_LIN) {
+        if (ip + 1 >= prepared->insn_count) return false;
+        memcpy(&scale[0], &prepared->insns[ip].imm, 8);
+        memcpy(&scale[1], &prepared->insns[ip + 1].imm, 8);
+        scaled = true;
+        ip += 2; // Op + extension slot
+    }
+    if (ip + 1 >= prepared->insn_count) return false;
+
+    const cnd_insn* body = prepared->insns + ip;
+    if (body[1].op != OP_ARR_END) return false;
+    if (!scaled && (body->op == OP_IO_U8 || body->op == OP_IO_I8) && ctx->cursor + count <= ctx->data_len) {
+        // Call callback with OP_RAW_BYTES
+        void* ptr = ctx->data_buffer + ctx->cursor;
+        if (ctx->io_callback(ctx, (uint16_t)(body->key + ctx->key_base), OP_RAW_BYTES, ptr) == CND_ERR_OK) {
+            ctx->cursor += count;
+            ctx->ip = ip + 2; // Skip element IO + OP_ARR_END
+            *err = CND_ERR_OK;
+            return true;
+        }
+    }
+
+    if (!vm_array_span(ctx, (uint16_t)(body->key + ctx->key_base), body->op, count, scaled ? scale : NULL, err)) return false;
+    ctx->ip = ip + 2;
+    return true;
+}
+
+// Runs the expression starting at *pcp with the stack pointer in a register
+// and no depth checks, up to the first instruction that is not an expression
+// operation. Only used for programs vm_verify_depths() has proved.
+static cnd_error_t prep_eval_unchecked(cnd_vm_ctx* ctx, const cnd_insn* base, const cnd_insn** pcp) {
+    const cnd_insn* pc = *pcp;
+    uint64_t* stack = ctx->expr_stack;
+    size_t sp = ctx->expr_sp;
+    cnd_error_t err = CND_ERR_OK;
+
+    for (;;) {
+        const cnd_insn* I = pc;
+        switch (I->op) {
+            case OP_PUSH_IMM:
+                stack[sp++] = I->imm;
+                break;
+
+            case OP_LOAD_CTX: {
+                uint64_t val = 0;
+                ctx->ip = (size_t)(pc + 1 - base);
+                if (vm_ctx_value(ctx, (uint16_t)(I->key + ctx->key_base), OP_LOAD_CTX, &val) != CND_ERR_OK) {
+                    err = CND_ERR_CALLBACK;
+                    goto done;
+                }
+                stack[sp++] = val;
+                break;
+            }
+
+            case OP_STORE_CTX: {
+                uint64_t val = stack[--sp];
+                ctx->ip = (size_t)(pc + 1 - base);
+                if (ctx->io_callback(ctx, (uint16_t)(I->key + ctx->key_base), OP_STORE_CTX, &val) != CND_ERR_OK) {
+                    err = CND_ERR_CALLBACK;
+                    goto done;
+                }
+                vm_slot_set(ctx, (uint16_t)(I->key + ctx->key_base), val);
+                break;
+            }
+
+            case OP_POP:
+                sp--;
+                break;
+
+            case OP_DUP:
+                stack[sp] = stack[sp - 1];
+                sp++;
+                break;
+
+            case OP_SWAP: {
+                uint64_t tmp = stack[sp - 1];
+                stack[sp - 1] = stack[sp - 2];
+                stack[sp - 2] = tmp;
+                break;
+            }
+
+            case OP_EMIT:
+                ctx->expr_sp = (uint8_t)sp;
+                err = vm_op_emit(ctx, I->arg);
+                sp = ctx->expr_sp;
+                if (err != CND_ERR_OK) goto done;
+                break;
+
+            case OP_EXPR: {
+                uint64_t val;
+                ctx->ip = (size_t)(pc + 1 - base);
+                err = vm_expr_eval(ctx, ctx->program->bytecode + I->imm, I->arg, &val);
+                if (err != CND_ERR_OK) goto done;
+                stack[sp++] = val;
+                break;
+            }
+
+            case OP_JUMP_IF_NOT:
+                pc = (stack[--sp] == 0) ? base + I->a : pc + 1;
+                goto done; // Control flow returns to the interpreter
+
+            default: {
+                int arity = vm_alu_arity(I->op);
+                if (arity == 0) goto done;
+                sp -= (size_t)arity;
+                err = vm_alu_eval(I->op, stack[sp], arity == 2 ? stack[sp + 1] : 0, &stack[sp]);
+                if (err != CND_ERR_OK) goto done;
+                sp++;
+                break;
+            }
+        }
+        pc++;
+    }
+
+done:
+    ctx->expr_sp = (uint8_t)sp;
+    *pcp = pc;
+    return err;
+}
+
+// Runs prepared instructions from ctx->ip until the program ends or, with
+// `single`, for one instruction (an unchecked expression run counts as one),
+// leaving ctx->ip at the next. *finished is set once the program has ended.
+static inline cnd_error_t prep_exec(cnd_vm_ctx* ctx, const cnd_prepared* prepared, bool unchecked,
+                                    bool single, bool* finished) {
+    const cnd_insn* base = prepared->insns;
+    const cnd_insn* pc = base + ctx->ip;
+    const cnd_insn* end = base + prepared->insn_count;
+    const cnd_insn* I;
+
+    #define FETCH_IL_U16(c) (I->key)
+    #define FETCH_KEY(c) ((uint16_t)(I->key + (c)->key_base))
+    #define SYNC_IP() (ctx->ip = (size_t)(pc - base))
+    #define RELOAD_PC() (pc = base + ctx->ip)
+    #define TRY_BULK_ARRAY(count, err) prep_try_bulk_array(ctx, prepared, (count), (err))
+    #define SKIP_LOOP() (ctx->ip = I->a)
+    #define VM_ENCODING (ctx->mode == CND_MODE_ENCODE)
+    #define VM_CALLBACK(key, op, ptr) ctx->io_callback(ctx, (key), (op), (ptr))
+    #define VM_CALLBACK_SCALAR(key, op, ptr) VM_CALLBACK(key, op, ptr)
+
+    // One length check covers the whole fixed prefix
+    #define PREP_FIXED(size, ctype, READ_EXPR, WRITE_EXPR) \
+        { IO_PRIMITIVE_PLAIN(ctype, READ_EXPR, WRITE_EXPR) ctx->cursor += (size); break; }
+    #define PREP_FIXED_FLOAT(size, ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) \
+        { IO_FLOAT_PLAIN(ctype, int_t, READ_INT_EXPR, WRITE_INT_EXPR) ctx->cursor += (size); break; }
+
+    if (!single && ctx->ip == 0 && prepared->fixed_count > 0 && ctx->bit_offset == 0 &&
+        !ctx->is_next_optional && ctx->trans_type == CND_TRANS_NONE &&
+        ctx->cursor <= ctx->data_len && ctx->data_len - ctx->cursor >= prepared->fixed_size) {
+        const cnd_insn* fixed_end = base + prepared->fixed_count;
+        while (pc < fixed_end) {
+            I = pc++;
+            uint8_t opcode = I->op;
+            uint16_t key = FETCH_KEY(ctx);
+
+            switch (opcode) {
+                case OP_SET_ENDIAN_LE: ctx->endianness = CND_LE; break;
+                case OP_SET_ENDIAN_BE: ctx->endianness = CND_BE; break;
+
+                case OP_ENTER_STRUCT:
+                    SYNC_IP();
+                    if (ctx->io_callback(ctx, key, opcode, NULL) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                    break;
+
+                case OP_EXIT_STRUCT:
+                    SYNC_IP();
+                    if (ctx->io_callback(ctx, 0, opcode, NULL) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                    break;
+
+                case OP_IO_U8: PREP_FIXED(1, uint8_t, read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, val));
+                case OP_IO_U16: PREP_FIXED(2, uint16_t, read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, val, ctx->endianness));
+                case OP_IO_U32: PREP_FIXED(4, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, val, ctx->endianness));
+                case OP_IO_U64: PREP_FIXED(8, uint64_t, read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u64(ctx->data_buffer + ctx->cursor, val, ctx->endianness));
+
+                case OP_IO_I8: PREP_FIXED(1, int8_t, (int8_t)read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, (uint8_t)val));
+                case OP_IO_I16: PREP_FIXED(2, int16_t, (int16_t)read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, (uint16_t)val, ctx->endianness));
+                case OP_IO_I32: PREP_FIXED(4, int32_t, (int32_t)read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, (uint32_t)val, ctx->endianness));
+                case OP_IO_I64: PREP_FIXED(8, int64_t, (int64_t)read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u64(ctx->data_buffer + ctx->cursor, (uint64_t)val, ctx->endianness));
+
+                case OP_IO_F32: PREP_FIXED_FLOAT(4, float, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, t, ctx->endianness));
+                case OP_IO_F64: PREP_FIXED_FLOAT(8, double, uint64_t, read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u64(ctx->data_buffer + ctx->cursor, t, ctx->endianness));
+
+                case OP_IO_SLOT: vm_slot_set(ctx, key, vm_slot_field(ctx, I->arg)); break;
+
+                default: break; // OP_NOOP
+            }
+        }
+    }
+
+    while (pc < end) {
+        I = pc++;
+        uint8_t opcode = I->op;
+
+        switch (opcode) {
+            case OP_NOOP: break;
+            case OP_SET_ENDIAN_LE: ctx->endianness = CND_LE; break;
+            case OP_SET_ENDIAN_BE: ctx->endianness = CND_BE; break;
+
+            case OP_ENTER_STRUCT: {
+                SYNC_IP();
+                if (ctx->io_callback(ctx, FETCH_KEY(ctx), opcode, NULL) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                break;
+            }
+
+            case OP_EXIT_STRUCT: {
+                SYNC_IP();
+                if (ctx->io_callback(ctx, 0, opcode, NULL) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                break;
+            }
+
+            case OP_CONST_WRITE: {
+                vm_align(ctx);
+                cnd_error_t err = vm_op_const_write(ctx, I->arg, I->imm);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_CONST_CHECK: {
+                vm_align(ctx);
+                SYNC_IP();
+                cnd_error_t err = vm_op_const_check(ctx, FETCH_KEY(ctx), I->arg, I->imm);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_ENUM_CHECK: {
+                vm_align(ctx);
+                cnd_error_t err = vm_op_enum_check(ctx, I->arg, (uint16_t)I->a, prepared->program->bytecode + I->imm);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_ENUM_SORTED: {
+                vm_align(ctx);
+                cnd_error_t err = vm_op_enum_sorted(ctx, I->arg, (uint16_t)I->a, prepared->program->bytecode + I->imm);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_ENUM_BITMAP: {
+                vm_align(ctx);
+                cnd_error_t err = vm_op_enum_bitmap(ctx, I->arg, I->imm, (uint16_t)I->a, prepared->program->bytecode + I[1].imm);
+                if (err != CND_ERR_OK) return err;
+                pc++; // Skip extension slot
+                break;
+            }
+
+            case OP_RANGE_CHECK: {
+                cnd_error_t err = vm_op_range_check(ctx, I->arg, I->imm, I[1].imm);
+                if (err != CND_ERR_OK) return err;
+                pc++; // Skip extension slot
+                break;
+            }
+
+            case OP_CRC_16:
+            case OP_CRC_32: {
+                vm_align(ctx);
+                cnd_error_t err = vm_op_crc(ctx, I->a, (uint32_t)I->imm, (uint32_t)(I->imm >> 32), I->arg,
+                                            opcode == OP_CRC_16 ? 16 : 32);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_CRC_BEGIN: vm_op_crc_begin(ctx); break;
+            case OP_CRC_END: vm_op_crc_end(ctx); break;
+
+            case OP_SCALE_LIN: {
+                uint64_t i_off = I[1].imm;
+                memcpy(&ctx->trans_f_factor, &I->imm, 8);
+                memcpy(&ctx->trans_f_offset, &i_off, 8);
+                ctx->trans_type = CND_TRANS_SCALE_F64;
+                pc++; // Skip extension slot
+                break;
+            }
+
+            case OP_TRANS_POLY:
+                vm_align(ctx);
+                ctx->trans_type = CND_TRANS_POLY;
+                ctx->trans_poly_count = I->arg;
+                ctx->trans_poly_data = prepared->program->bytecode + I->imm;
+                break;
+
+            case OP_TRANS_SPLINE:
+                vm_align(ctx);
+                ctx->trans_type = CND_TRANS_SPLINE;
+                ctx->trans_spline_count = I->arg;
+                ctx->trans_spline_data = prepared->program->bytecode + I->imm;
+                break;
+
+            case OP_MARK_OPTIONAL:
+                ctx->is_next_optional = true;
+                break;
+
+            case OP_TRANS_ADD: ctx->trans_type = CND_TRANS_ADD_I64; ctx->trans_i_val = (int64_t)I->imm; break;
+            case OP_TRANS_SUB: ctx->trans_type = CND_TRANS_SUB_I64; ctx->trans_i_val = (int64_t)I->imm; break;
+            case OP_TRANS_MUL: ctx->trans_type = CND_TRANS_MUL_I64; ctx->trans_i_val = (int64_t)I->imm; break;
+            case OP_TRANS_DIV: ctx->trans_type = CND_TRANS_DIV_I64; ctx->trans_i_val = (int64_t)I->imm; break;
+
+            // ... Category B (Primitives) ...
+            case OP_IO_U8: HANDLE_PRIMITIVE(1, uint8_t, read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, val));
+            case OP_IO_U16: HANDLE_PRIMITIVE(2, uint16_t, read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, val, ctx->endianness));
+            case OP_IO_U32: HANDLE_PRIMITIVE(4, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, val, ctx->endianness));
+            case OP_IO_U64: HANDLE_PRIMITIVE(8, uint64_t, read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u64(ctx->data_buffer + ctx->cursor, val, ctx->endianness));
+
+            case OP_IO_I8: HANDLE_PRIMITIVE(1, int8_t, (int8_t)read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, (uint8_t)val));
+            case OP_IO_I16: HANDLE_PRIMITIVE(2, int16_t, (int16_t)read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, (uint16_t)val, ctx->endianness));
+            case OP_IO_I32: HANDLE_PRIMITIVE(4, int32_t, (int32_t)read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, (uint32_t)val, ctx->endianness));
+            case OP_IO_I64: HANDLE_PRIMITIVE(8, int64_t, (int64_t)read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u64(ctx->data_buffer + ctx->cursor, (uint64_t)val, ctx->endianness));
+
+            case OP_IO_BOOL: {
+                vm_align(ctx);
+                SYNC_IP();
+                cnd_error_t err = vm_op_io_bool(ctx, FETCH_KEY(ctx));
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_IO_F32: HANDLE_FLOAT(4, float, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, t, ctx->endianness));
+            case OP_IO_F64: HANDLE_FLOAT(8, double, uint64_t, read_u64(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u64(ctx->data_buffer + ctx->cursor, t, ctx->endianness));
+
+            case OP_IO_SLOT:
+                // The field ends at the cursor unless its host callback moved it
+                if (ctx->cursor >= il_type_size(I->arg)) vm_slot_set(ctx, FETCH_KEY(ctx), vm_slot_field(ctx, I->arg));
+                break;
+
+            // ... Category C (Bitfields) ...
+            case OP_IO_BIT_U: {
+                SYNC_IP();
+                if (vm_op_bit_u(ctx, FETCH_KEY(ctx), I->arg) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                break;
+            }
+
+            case OP_IO_BIT_I: {
+                SYNC_IP();
+                if (vm_op_bit_i(ctx, FETCH_KEY(ctx), I->arg) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                break;
+            }
+
+            case OP_IO_BIT_BOOL: {
+                SYNC_IP();
+                cnd_error_t err = vm_op_bit_bool(ctx, FETCH_KEY(ctx));
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_IO_BIT_GROUP: {
+                SYNC_IP();
+                cnd_error_t err = vm_op_bit_group(ctx, prepared->program->bytecode + I->imm, I->arg, false);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_EXIT_BIT_MODE: {
+                if (ctx->bit_offset > 0) {
+                    return CND_ERR_VALIDATION; // Unaligned exit is not allowed
+                }
+                break;
+            }
+
+            case OP_ALIGN_FILL: vm_op_align_fill(ctx, I->arg); break;
+            case OP_ALIGN_PAD: vm_op_align_pad(ctx, I->arg); break;
+
+            // ... Category D: Arrays & Strings ...
+
+            case OP_STR_NULL: {
+                vm_align(ctx);
+                SYNC_IP();
+                cnd_error_t err = vm_op_str_null(ctx, FETCH_KEY(ctx), (uint16_t)I->a);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            case OP_STR_PRE_U8:  HANDLE_STRING_PRE(1, uint8_t,  read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, len_val));
+            case OP_STR_PRE_U16: HANDLE_STRING_PRE(2, uint16_t, read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, len_val, ctx->endianness));
+            case OP_STR_PRE_U32: HANDLE_STRING_PRE(4, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, len_val, ctx->endianness));
+
+            case OP_ARR_PRE_U8:  HANDLE_ARRAY_PRE(1, uint8_t,  read_u8(ctx->data_buffer + ctx->cursor), write_u8(ctx->data_buffer + ctx->cursor, count));
+            case OP_ARR_PRE_U16: HANDLE_ARRAY_PRE(2, uint16_t, read_u16(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u16(ctx->data_buffer + ctx->cursor, count, ctx->endianness));
+            case OP_ARR_PRE_U32: HANDLE_ARRAY_PRE(4, uint32_t, read_u32(ctx->data_buffer + ctx->cursor, ctx->endianness), write_u32(ctx->data_buffer + ctx->cursor, count, ctx->endianness));
+
+            case OP_ARR_FIXED: {
+                vm_align(ctx);
+                uint32_t count = (uint32_t)I->imm;
+                SYNC_IP();
+                if (ctx->io_callback(ctx, FETCH_KEY(ctx), opcode, &count) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                if (count > 0) {
+                    cnd_error_t bulk_err;
+                    if (TRY_BULK_ARRAY(count, &bulk_err)) { if (bulk_err != CND_ERR_OK) return bulk_err; RELOAD_PC(); break; }
+                    if (!loop_push(ctx, ctx->ip, count)) return CND_ERR_OOB;
+                } else {
+                    pc = base + I->a;
+                }
+                break;
+            }
+
+            case OP_ARR_EOF: {
+                vm_align(ctx);
+                SYNC_IP();
+                bool empty = false;
+                cnd_error_t err = vm_op_arr_eof(ctx, &empty);
+                if (err != CND_ERR_OK) return err;
+                if (empty) pc = base + I->a;
+                break;
+            }
+
+            case OP_ARR_DYNAMIC: {
+                vm_align(ctx);
+                uint64_t count_val = 0;
+                SYNC_IP();
+                if (vm_ctx_value(ctx, (uint16_t)(I->imm + ctx->key_base), OP_CTX_QUERY, &count_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                if (count_val > 0xFFFFFFFF) return CND_ERR_ARITHMETIC;
+                uint32_t count = (uint32_t)count_val;
+
+                if (ctx->io_callback(ctx, FETCH_KEY(ctx), OP_ARR_DYNAMIC, &count) != CND_ERR_OK) return CND_ERR_CALLBACK;
+
+                if (count > 0) {
+                    cnd_error_t bulk_err;
+                    if (TRY_BULK_ARRAY(count, &bulk_err)) { if (bulk_err != CND_ERR_OK) return bulk_err; RELOAD_PC(); break; }
+                    if (!loop_push(ctx, ctx->ip, count)) return CND_ERR_OOB;
+                } else {
+                    pc = base + I->a;
+                }
+                break;
+            }
+
+            case OP_ARR_END: {
+                vm_align(ctx);
+                SYNC_IP();
+                bool again = false;
+                cnd_error_t err = vm_op_arr_end(ctx, &again);
+                if (err != CND_ERR_OK) return err;
+                if (again) RELOAD_PC();
+                break;
+            }
+
+            case OP_RAW_BYTES: {
+                vm_align(ctx);
+                SYNC_IP();
+                cnd_error_t err = vm_op_raw_bytes(ctx, FETCH_KEY(ctx), I->a);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            // ... Category F: Control Flow ...
+
+            case OP_SWITCH: {
+                uint64_t disc_val = 0;
+                SYNC_IP();
+                if (vm_ctx_value(ctx, FETCH_KEY(ctx), OP_CTX_QUERY, &disc_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+
+                uint32_t target = I->a;
+                for (uint64_t i = 0; i < I->imm; i++) {
+                    if (I[1 + i].imm == disc_val) { target = I[1 + i].a; break; }
+                }
+                pc = base + target;
+                break;
+            }
+
+            case OP_SWITCH_SORTED: {
+                uint64_t disc_val = 0;
+                SYNC_IP();
+                if (vm_ctx_value(ctx, FETCH_KEY(ctx), OP_CTX_QUERY, &disc_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+
+                uint32_t target = I->a;
+                uint64_t lo = 0, hi = I->imm;
+                while (lo < hi) {
+                    uint64_t mid = (lo + hi) >> 1;
+                    if (I[1 + mid].imm == disc_val) { target = I[1 + mid].a; break; }
+                    if (I[1 + mid].imm < disc_val) lo = mid + 1;
+                    else hi = mid;
+                }
+                pc = base + target;
+                break;
+            }
+
+            case OP_SWITCH_HASH: {
+                uint64_t disc_val = 0;
+                SYNC_IP();
+                if (vm_ctx_value(ctx, FETCH_KEY(ctx), OP_CTX_QUERY, &disc_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+
+                uint32_t slot = vm_switch_hash_slot(disc_val, I->imm, I->arg, I[1].arg,
+                                                    prepared->program->bytecode + I[1].imm);
+                const cnd_insn* entry = &I[2 + slot];
+                pc = base + (entry->imm == disc_val ? entry->a : I->a);
+                break;
+            }
+
+            case OP_SWITCH_TABLE: {
+                uint64_t disc_val = 0;
+                SYNC_IP();
+                if (vm_ctx_value(ctx, FETCH_KEY(ctx), OP_CTX_QUERY, &disc_val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+
+                uint32_t target = I->a;
+                if (disc_val >= I->imm && disc_val <= I[1].imm) {
+                    target = I[2 + (disc_val - I->imm)].a;
+                }
+                pc = base + target;
+                break;
+            }
+
+            case OP_JUMP_IF_NOT: {
+                uint64_t condition;
+                if (stack_pop(ctx, &condition) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
+                if (condition == 0) pc = base + I->a;
+                break;
+            }
+
+            case OP_JUMP:
+                pc = base + I->a;
+                break;
+
+            case OP_CALL: {
+                cnd_error_t err = vm_op_call(ctx, (size_t)(pc - base), I->key);
+                if (err != CND_ERR_OK) return err;
+                pc = base + I->a;
+                break;
+            }
+
+            case OP_RET:
+                SYNC_IP();
+                if (!vm_op_ret(ctx)) {
+                    *finished = true;
+                    return CND_ERR_OK;
+                }
+                RELOAD_PC();
+                break;
+
+            // --- Category G: Expression Stack & ALU ---
+
+            case OP_LOAD_CTX: {
+                if (unchecked) {
+                    pc = I;
+                    cnd_error_t err = prep_eval_unchecked(ctx, base, &pc);
+                    if (err != CND_ERR_OK) return err;
+                    break;
+                }
+                uint64_t val = 0;
+                SYNC_IP();
+                if (vm_ctx_value(ctx, FETCH_KEY(ctx), OP_LOAD_CTX, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                if (stack_push(ctx, val) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
+                break;
+            }
+
+            case OP_STORE_CTX: {
+                uint64_t val;
+                if (stack_pop(ctx, &val) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
+                SYNC_IP();
+                if (ctx->io_callback(ctx, FETCH_KEY(ctx), OP_STORE_CTX, &val) != CND_ERR_OK) return CND_ERR_CALLBACK;
+                vm_slot_set(ctx, FETCH_KEY(ctx), val);
+                break;
+            }
+
+            case OP_PUSH_IMM:
+                if (unchecked) {
+                    pc = I;
+                    cnd_error_t err = prep_eval_unchecked(ctx, base, &pc);
+                    if (err != CND_ERR_OK) return err;
+                    break;
+                }
+                if (stack_push(ctx, I->imm) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
+                break;
+
+            case OP_EXPR: {
+                if (unchecked) {
+                    pc = I;
+                    cnd_error_t err = prep_eval_unchecked(ctx, base, &pc);
+                    if (err != CND_ERR_OK) return err;
+                    break;
+                }
+                uint64_t val;
+                SYNC_IP();
+                cnd_error_t err = vm_expr_eval(ctx, ctx->program->bytecode + I->imm, I->arg, &val);
+                if (err != CND_ERR_OK) return err;
+                if (stack_push(ctx, val) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
+                break;
+            }
+
+            case OP_POP: {
+                uint64_t val;
+                if (stack_pop(ctx, &val) != CND_ERR_OK) return CND_ERR_STACK_UNDERFLOW;
+                break;
+            }
+
+            case OP_SWAP: {
+                if (ctx->expr_sp < 2) return CND_ERR_STACK_UNDERFLOW;
+                uint64_t tmp = ctx->expr_stack[ctx->expr_sp - 1];
+                ctx->expr_stack[ctx->expr_sp - 1] = ctx->expr_stack[ctx->expr_sp - 2];
+                ctx->expr_stack[ctx->expr_sp - 2] = tmp;
+                break;
+            }
+
+            case OP_DUP: {
+                if (ctx->expr_sp == 0) return CND_ERR_STACK_UNDERFLOW;
+                if (stack_push(ctx, ctx->expr_stack[ctx->expr_sp - 1]) != CND_ERR_OK) return CND_ERR_STACK_OVERFLOW;
+                break;
+            }
+
+            case OP_EMIT: {
+                cnd_error_t err = vm_op_emit(ctx, I->arg);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+
+            default: {
+                // Unimplemented opcodes in the byte-aligned ranges still align
+                if (ALIGN_TABLE[opcode]) vm_align(ctx);
+                // Expression stack ALU (no IL operands)
+                cnd_error_t err = vm_alu(ctx, opcode);
+                if (err != CND_ERR_OK) return err;
+                break;
+            }
+        }
+        if (single) {
+            SYNC_IP();
+            return CND_ERR_OK;
+        }
+    }
+
+    #undef FETCH_IL_U16
+    #undef FETCH_KEY
+    #undef SYNC_IP
+    #undef RELOAD_PC
+    #undef TRY_BULK_ARRAY
+    #undef SKIP_LOOP
+    #undef VM_ENCODING
+    #undef VM_CALLBACK
+    #undef VM_CALLBACK_SCALAR
+    #undef PREP_FIXED
+    #undef PREP_FIXED_FLOAT
+
+    *finished = true;
+    return CND_ERR_OK;
+}
+
+cnd_error_t cnd_execute_prepared(cnd_vm_ctx* ctx, const cnd_prepared* prepared) {
+    if (!ctx || !prepared || !prepared->program || !ctx->data_buffer) return CND_ERR_OOB;
+    if (!prepared->insns && prepared->insn_count > 0) return CND_ERR_OOB;
+    if (ctx->ip > prepared->insn_count) return CND_ERR_OOB;
+
+    // The depth proof assumes a run from the first instruction with empty stacks
+    bool unchecked = prepared->stacks_verified && ctx->ip == 0 && ctx->expr_sp == 0 &&
+                     ctx->loop_depth == 0 && ctx->call_depth == 0;
+    bool finished = false;
+    return prep_exec(ctx, prepared, unchecked, false, &finished);
+}
+
+cnd_error_t vm_prepared_step(cnd_vm_ctx* ctx, const cnd_prepared* prepared, bool unchecked, bool* finished) {
+    return prep_exec(ctx, prepared, unchecked, true, finished);
+}
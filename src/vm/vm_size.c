@@ -0,0 +1,439 @@
+#include "concordia.h"
+#include "vm_internal.h"
+
+// --- Static Size Bounds ---
+//
+// Walks every path through the bytecode and sums what each instruction
+// consumes or produces. Sizes are kept in bits, together with the bit offset
+// at the end of the walk when it is known, so that the padding of byte-aligned
+// instructions after bitfields is counted exactly.
+//
+// The walk follows the structure the compiler emits rather than building a
+// control-flow graph (the VM does not allocate):
+//   - JUMP_IF_NOT T: the then-branch runs up to T; if it ends in JUMP M the
+//     else-branch runs from T to M. Both continue at M.
+//   - switches: every target runs up to the end of the jump table.
+//   - arrays: the body runs up to its ARR_END, once per element.
+//   - OP_CALL: the subroutine runs up to its OP_RET.
+// Anything else (backward jumps, branches that do not meet, too deep nesting)
+// stops the walk: the minimum is what every path consumed before it and the
+// maximum is unbounded.
+
+#define SIZE_UNBOUNDED UINT64_MAX
+#define SIZE_PHASE_UNKNOWN 0xFF
+#define SIZE_NO_STOP SIZE_MAX
+
+// Nesting of branches, arrays and calls the walk follows
+#define SIZE_MAX_DEPTH 64
+// Instructions visited before the walk gives up
+#define SIZE_MAX_STEPS (1u << 20)
+
+// What ends a walk besides its stop address
+typedef enum {
+    SIZE_UNTIL_END,   // End of program or OP_RET (packet)
+    SIZE_UNTIL_RET,   // OP_RET (subroutine)
+    SIZE_UNTIL_LOOP   // OP_ARR_END (array body)
+} size_until;
+
+typedef struct {
+    uint64_t min;   // Bits
+    uint64_t max;   // Bits, SIZE_UNBOUNDED if there is no limit
+    uint8_t phase;  // Bit offset at the end, or SIZE_PHASE_UNKNOWN
+} size_range;
+
+typedef struct {
+    const uint8_t* bc;
+    size_t len;
+    uint32_t steps;
+    uint8_t depth;
+    size_range exit;  // Paths of the current subroutine or packet that returned early
+    bool exited;
+} size_walker;
+
+static uint64_t size_add(uint64_t a, uint64_t b) {
+    return (a > SIZE_UNBOUNDED - b) ? SIZE_UNBOUNDED : a + b;
+}
+
+static uint64_t size_mul(uint64_t a, uint64_t b) {
+    if (a == 0 || b == 0) return 0;
+    return (a > SIZE_UNBOUNDED / b) ? SIZE_UNBOUNDED : a * b;
+}
+
+// Consumes between `min` and `max` bits
+static void size_consume(size_range* r, uint64_t min, uint64_t max, bool optional) {
+    if (!optional) r->min = size_add(r->min, min);
+    r->max = size_add(r->max, max);
+    if (r->phase != SIZE_PHASE_UNKNOWN) {
+        // Only whole-byte amounts or bitfields of a known width get here
+        if (min == max) r->phase = (uint8_t)((r->phase + min) & 7);
+        else if ((min & 7) != 0 || (max & 7) != 0) r->phase = SIZE_PHASE_UNKNOWN;
+    }
+}
+
+// vm_align(): skips to the next byte boundary
+static void size_align(size_range* r) {
+    if (r->phase == SIZE_PHASE_UNKNOWN) {
+        r->max = size_add(r->max, 7);
+    } else if (r->phase != 0) {
+        r->min = size_add(r->min, 8u - r->phase);
+        r->max = size_add(r->max, 8u - r->phase);
+    }
+    r->phase = 0;
+}
+
+static void size_union(size_range* a, const size_range* b) {
+    if (b->min < a->min) a->min = b->min;
+    if (b->max > a->max) a->max = b->max;
+    if (a->phase != b->phase) a->phase = SIZE_PHASE_UNKNOWN;
+}
+
+static bool size_walk(size_walker* w, size_t ip, size_t stop, size_until until, size_range* r, size_t* cont);
+
+// A branch that reached OP_RET (jumps to a return are threaded into one by
+// the optimizer) ends with the subroutine or packet; it is set aside and
+// joined with the paths that fall through to the end.
+static bool size_exits(size_walker* w, const size_range* r, size_t at) {
+    if (at >= w->len || w->bc[at] != OP_RET) return false;
+    if (w->exited) size_union(&w->exit, r);
+    else w->exit = *r;
+    w->exited = true;
+    return true;
+}
+
+// Continues two branches that ended at different addresses until they meet
+static bool size_merge(size_walker* w, size_until until, size_range* a, size_t* a_at, size_range* b, size_t* b_at) {
+    bool can_exit = (until != SIZE_UNTIL_LOOP);
+    for (;;) {
+        if (can_exit && size_exits(w, a, *a_at)) {
+            *a = *b;
+            *a_at = *b_at;
+            return true;
+        }
+        if (can_exit && size_exits(w, b, *b_at)) return true;
+        if (*a_at == *b_at) break;
+
+        size_range* lo = (*a_at < *b_at) ? a : b;
+        size_t* lo_at = (*a_at < *b_at) ? a_at : b_at;
+        size_t hi_at = (*a_at < *b_at) ? *b_at : *a_at;
+        size_t next = 0;
+        if (!size_walk(w, *lo_at, hi_at, until, lo, &next) || next <= *lo_at) return false;
+        *lo_at = next;
+    }
+    size_union(a, b);
+    return true;
+}
+
+// Array body: starts aligned and ARR_END aligns again, so every element has
+// the same size
+static bool size_array(size_walker* w, size_t body, uint64_t min_count, uint64_t max_count, size_range* r, size_t* after) {
+    size_range elem = {0, 0, 0};
+    size_t end = 0;
+    if (!size_walk(w, body, SIZE_NO_STOP, SIZE_UNTIL_LOOP, &elem, &end)) return false;
+    size_align(&elem);
+    r->min = size_add(r->min, size_mul(elem.min, min_count));
+    r->max = size_add(r->max, size_mul(elem.max, max_count));
+    r->phase = 0;
+    *after = end + 1;
+    return true;
+}
+
+static bool size_switch(size_walker* w, size_t ip, size_until until, size_range* r, size_t* after) {
+    size_t table_start = 0, table_len = 0;
+    if (vm_switch_table_span(w->bc, w->len, ip, &table_start, &table_len) != CND_ERR_OK) return false;
+    const uint8_t* t = w->bc + table_start;
+    size_t code_start = ip + 7;
+    size_t table_end = table_start + table_len;
+
+    // Offsets of the default and case targets
+    size_t first = 0, stride = 0, count = 0;
+    if (w->bc[ip] == OP_SWITCH || w->bc[ip] == OP_SWITCH_SORTED) {
+        first = 2; stride = 12; count = il_get_u16(t);
+    } else if (w->bc[ip] == OP_SWITCH_HASH) {
+        first = 0; stride = 12; count = (size_t)1 << t[12];
+    } else {
+        first = 16; stride = 4; count = (table_len - 20) / 4;
+    }
+
+    size_range merged = *r;
+    size_t merged_at = 0;
+    size_t default_target = 0, prev_target = 0;
+    for (size_t i = 0; i <= count; i++) {
+        size_t at;
+        if (i == 0) at = table_start + first;
+        else if (w->bc[ip] == OP_SWITCH_HASH) at = table_start + 14 + ((size_t)2 << t[13]) + (i - 1) * stride + 8;
+        else if (stride == 12) at = table_start + 6 + (i - 1) * stride + 8;
+        else at = table_start + 20 + (i - 1) * 4;
+
+        size_t target = 0;
+        if (vm_switch_target(code_start, (int32_t)il_get_u32(w->bc + at), w->len, &target) != CND_ERR_OK) return false;
+        if (target < code_start || (target >= table_start && target < table_end)) return false;
+        // Unused hash slots and neighbouring values share their target
+        if (i > 0 && (target == default_target || target == prev_target)) continue;
+        prev_target = target;
+
+        size_range branch = *r;
+        size_t branch_at = target;
+        if (target < table_start) {
+            if (!size_walk(w, target, table_start, until, &branch, &branch_at)) return false;
+            // Fell into its own jump table
+            if (branch_at == table_start) return false;
+        }
+        if (i == 0) {
+            merged = branch;
+            merged_at = branch_at;
+            default_target = target;
+        } else if (!size_merge(w, until, &merged, &merged_at, &branch, &branch_at)) {
+            return false;
+        }
+    }
+    *r = merged;
+    *after = merged_at;
+    return true;
+}
+
+static bool size_walk(size_walker* w, size_t ip, size_t stop, size_until until, size_range* r, size_t* cont) {
+    const uint8_t* bc = w->bc;
+    bool optional = false;
+    bool ok = false;
+
+    if (++w->depth > SIZE_MAX_DEPTH) goto done;
+
+    for (;;) {
+        if (ip == stop) { *cont = ip; ok = true; goto done; }
+        if (ip >= w->len) { *cont = w->len; ok = (until == SIZE_UNTIL_END); goto done; }
+        if (++w->steps > SIZE_MAX_STEPS) goto done;
+
+        size_t insn_len = 0;
+        if (vm_insn_length(bc, w->len, ip, &insn_len) != CND_ERR_OK) goto done;
+        uint8_t op = bc[ip];
+        size_t next = ip + insn_len;
+
+        switch (op) {
+            case OP_RET:
+                if (until == SIZE_UNTIL_LOOP) goto done;
+                *cont = ip;
+                ok = true;
+                goto done;
+
+            case OP_ARR_END:
+                if (until != SIZE_UNTIL_LOOP) goto done;
+                *cont = ip;
+                ok = true;
+                goto done;
+
+            case OP_MARK_OPTIONAL:
+                optional = true;
+                break;
+
+            case OP_IO_U8: case OP_IO_U16: case OP_IO_U32: case OP_IO_U64:
+            case OP_IO_I8: case OP_IO_I16: case OP_IO_I32: case OP_IO_I64:
+            case OP_IO_F32: case OP_IO_F64: case OP_IO_BOOL: {
+                uint64_t bits = (uint64_t)il_type_size(op) * 8;
+                size_align(r);
+                size_consume(r, bits, bits, optional);
+                optional = false;
+                break;
+            }
+
+            case OP_IO_RUN: {
+                uint64_t bits = (uint64_t)il_get_u16(bc + ip + 2) * 8;
+                size_align(r);
+                size_consume(r, bits, bits, optional);
+                optional = false;
+                break;
+            }
+
+            case OP_IO_CHECK:
+            case OP_IO_SLOT: {
+                // The embedded check or slot record follows the field and consumes nothing
+                uint64_t bits = (uint64_t)il_type_size(bc[ip + 1]) * 8;
+                size_align(r);
+                size_consume(r, bits, bits, optional);
+                optional = false;
+                break;
+            }
+
+            case OP_CONST_CHECK:
+            case OP_CONST_WRITE: {
+                uint64_t bits = (uint64_t)il_type_size(bc[ip + (op == OP_CONST_CHECK ? 3 : 1)]) * 8;
+                size_align(r);
+                size_consume(r, bits, bits, false);
+                break;
+            }
+
+            case OP_CRC_16:
+            case OP_CRC_32: {
+                uint64_t bits = (op == OP_CRC_16) ? 16 : 32;
+                size_align(r);
+                size_consume(r, bits, bits, false);
+                break;
+            }
+
+            case OP_RAW_BYTES: {
+                uint64_t bits = (uint64_t)il_get_u32(bc + ip + 3) * 8;
+                size_align(r);
+                size_consume(r, bits, bits, optional);
+                optional = false;
+                break;
+            }
+
+            case OP_EMIT: {
+                // Written at the cursor without aligning
+                uint64_t bits = (uint64_t)il_type_size(bc[ip + 1]) * 8;
+                size_consume(r, bits, bits, false);
+                break;
+            }
+
+            case OP_STR_NULL: {
+                // Terminator included; decode stops after max_len characters
+                uint64_t max_len = il_get_u16(bc + ip + 3);
+                size_align(r);
+                size_consume(r, 8, (max_len + 1) * 8, optional);
+                optional = false;
+                break;
+            }
+
+            case OP_STR_PRE_U8:
+            case OP_STR_PRE_U16:
+            case OP_STR_PRE_U32: {
+                uint64_t prefix = (op == OP_STR_PRE_U8) ? 1 : (op == OP_STR_PRE_U16) ? 2 : 4;
+                uint64_t max = (op == OP_STR_PRE_U32) ? SIZE_UNBOUNDED
+                                                      : (prefix + ((uint64_t)1 << (prefix * 8)) - 1) * 8;
+                size_align(r);
+                size_consume(r, prefix * 8, max, optional);
+                optional = false;
+                break;
+            }
+
+            case OP_IO_BIT_U:
+            case OP_IO_BIT_I:
+            case OP_IO_BIT_BOOL:
+                size_consume(r, bc[ip + 3], bc[ip + 3], false);
+                break;
+
+            case OP_IO_BIT_GROUP: {
+                uint64_t bits = 0;
+                for (uint8_t i = 0; i < bc[ip + 1]; i++) bits += bc[ip + 2 + (size_t)i * 4 + 3];
+                size_consume(r, bits, bits, false);
+                break;
+            }
+
+            case OP_ALIGN_PAD:
+                size_consume(r, bc[ip + 1], bc[ip + 1], false);
+                break;
+
+            case OP_ALIGN_FILL:
+            case OP_ENUM_CHECK:
+            case OP_ENUM_SORTED:
+            case OP_ENUM_BITMAP:
+            case OP_TRANS_POLY:
+            case OP_TRANS_SPLINE:
+                size_align(r);
+                break;
+
+            case OP_EXIT_BIT_MODE:
+                // Fails unless the bitfields ended on a byte boundary
+                r->phase = 0;
+                break;
+
+            case OP_ARR_FIXED:
+            case OP_ARR_PRE_U8:
+            case OP_ARR_PRE_U16:
+            case OP_ARR_PRE_U32:
+            case OP_ARR_EOF:
+            case OP_ARR_DYNAMIC: {
+                uint64_t min_count = 0, max_count = SIZE_UNBOUNDED;
+                size_align(r);
+                if (op == OP_ARR_FIXED) {
+                    min_count = max_count = il_get_u32(bc + ip + 3);
+                } else if (op == OP_ARR_PRE_U8 || op == OP_ARR_PRE_U16 || op == OP_ARR_PRE_U32) {
+                    uint64_t prefix = (op == OP_ARR_PRE_U8) ? 1 : (op == OP_ARR_PRE_U16) ? 2 : 4;
+                    size_consume(r, prefix * 8, prefix * 8, false);
+                    max_count = ((uint64_t)1 << (prefix * 8)) - 1;
+                }
+                if (optional) min_count = 0;
+                optional = false;
+                size_range body = *r;
+                if (!size_array(w, next, min_count, max_count, &body, &next)) goto done;
+                *r = body;
+                break;
+            }
+
+            case OP_CALL: {
+                size_t target = 0;
+                if (vm_switch_target(ip + 9, (int32_t)il_get_u32(bc + ip + 5), w->len, &target) != CND_ERR_OK) goto done;
+                size_range body = *r, caller_exit = w->exit;
+                bool caller_exited = w->exited;
+                size_t ret = 0;
+                w->exited = false;
+                bool called = size_walk(w, target, SIZE_NO_STOP, SIZE_UNTIL_RET, &body, &ret) &&
+                              ret < w->len && bc[ret] == OP_RET;
+                if (called && w->exited) size_union(&body, &w->exit);
+                w->exit = caller_exit;
+                w->exited = caller_exited;
+                if (!called) goto done;
+                *r = body;
+                break;
+            }
+
+            case OP_JUMP:
+            case OP_JUMP_IF_NOT: {
+                size_t target = 0;
+                if (vm_switch_target(next, (int32_t)il_get_u32(bc + ip + 1), w->len, &target) != CND_ERR_OK) goto done;
+                if (target < next) goto done;
+                if (op == OP_JUMP_IF_NOT) {
+                    // Then-branch up to T, else-branch (if any) from T
+                    size_range then_r = *r, else_r = *r;
+                    size_t then_at = 0, else_at = target;
+                    if (!size_walk(w, next, target, until, &then_r, &then_at)) goto done;
+                    if (then_at < target && (until == SIZE_UNTIL_LOOP || w->bc[then_at] != OP_RET)) goto done;
+                    if (!size_merge(w, until, &then_r, &then_at, &else_r, &else_at)) goto done;
+                    *r = then_r;
+                    target = then_at;
+                }
+                // Leaving this walk's region is for the caller to resolve
+                if (stop != SIZE_NO_STOP && target > stop) { *cont = target; ok = true; goto done; }
+                next = target;
+                break;
+            }
+
+            case OP_SWITCH:
+            case OP_SWITCH_TABLE:
+            case OP_SWITCH_SORTED:
+            case OP_SWITCH_HASH: {
+                size_range merged = *r;
+                if (!size_switch(w, ip, until, &merged, &next)) goto done;
+                *r = merged;
+                if (stop != SIZE_NO_STOP && next > stop) { *cont = next; ok = true; goto done; }
+                break;
+            }
+
+            default:
+                // Structure, metadata, checks, transforms and expressions
+                break;
+        }
+        ip = next;
+    }
+
+done:
+    w->depth--;
+    return ok;
+}
+
+cnd_error_t cnd_program_size_bounds(const cnd_program* program, uint32_t* min_size, uint32_t* max_size)
+{
+    if (!program || !program->bytecode || !min_size || !max_size) return CND_ERR_OOB;
+
+    size_walker w = {program->bytecode, program->bytecode_len, 0, 0, {0, 0, 0}, false};
+    size_range r = {0, 0, 0};
+    size_t end = 0;
+    bool ok = size_walk(&w, 0, SIZE_NO_STOP, SIZE_UNTIL_END, &r, &end);
+    if (w.exited) size_union(&r, &w.exit);
+
+    // A partly read byte still has to be present
+    uint64_t min_bytes = (r.min == SIZE_UNBOUNDED) ? SIZE_UNBOUNDED : (r.min + 7) / 8;
+    uint64_t max_bytes = (!ok || r.max == SIZE_UNBOUNDED) ? SIZE_UNBOUNDED : (r.max + 7) / 8;
+    *min_size = (min_bytes > UINT32_MAX) ? UINT32_MAX : (uint32_t)min_bytes;
+    *max_size = (max_bytes > UINT32_MAX) ? 0 : (uint32_t)max_bytes;
+    return CND_ERR_OK;
+}
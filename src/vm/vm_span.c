@@ -0,0 +1,248 @@
+#include "vm_internal.h"
+#include <string.h>
+
+// --- Bulk Primitive Arrays ---
+//
+// Arrays whose loop body is one primitive IO are handed to the host as spans
+// of elements in host byte order. When the wire order matches the host and no
+// transform applies, the span points straight into the data buffer; otherwise
+// elements are converted through a stack scratch buffer, VM_SPAN_CHUNK at a
+// time. Byte swapping uses SSSE3/AVX2 (selected at runtime on x86) or NEON
+// where available, with a portable loop for the rest.
+
+#define VM_SPAN_CHUNK 256
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define VM_HOST_BE 1
+#else
+#define VM_HOST_BE 0
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VM_SPAN_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define VM_SPAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+// --- Byte Swapping ---
+
+static void span_swap_scalar(uint8_t* dst, const uint8_t* src, size_t n, uint32_t size) {
+    for (size_t i = 0; i < n; i++, dst += size, src += size) {
+        for (uint32_t b = 0; b < size; b++) dst[b] = src[size - 1 - b];
+    }
+}
+
+#if VM_SPAN_X86
+// Shuffle control reversing each `size`-byte group of a 16-byte lane
+static void span_swap_mask(uint8_t mask[16], uint32_t size) {
+    for (uint32_t i = 0; i < 16; i++) mask[i] = (uint8_t)((i / size) * size + (size - 1 - i % size));
+}
+
+__attribute__((target("ssse3")))
+static size_t span_swap_ssse3(uint8_t* dst, const uint8_t* src, size_t bytes, uint32_t size) {
+    uint8_t m[16];
+    span_swap_mask(m, size);
+    __m128i mask = _mm_loadu_si128((const __m128i*)m);
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t span_swap_avx2(uint8_t* dst, const uint8_t* src, size_t bytes, uint32_t size) {
+    uint8_t m[16];
+    span_swap_mask(m, size);
+    __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)m));
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+// 0 = unknown, 1 = scalar, 2 = SSSE3, 3 = AVX2
+static int span_x86_level = 0;
+
+static int span_detect_x86(void) {
+    if (span_x86_level == 0) {
+        __builtin_cpu_init();
+        span_x86_level = __builtin_cpu_supports("avx2") ? 3 : __builtin_cpu_supports("ssse3") ? 2 : 1;
+    }
+    return span_x86_level;
+}
+#endif
+
+#if VM_SPAN_NEON
+static size_t span_swap_neon(uint8_t* dst, const uint8_t* src, size_t bytes, uint32_t size) {
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        if (size == 2) v = vrev16q_u8(v);
+        else if (size == 4) v = vrev32q_u8(v);
+        else v = vrev64q_u8(v);
+        vst1q_u8(dst + i, v);
+    }
+    return i;
+}
+#endif
+
+// Copies `n` elements of `size` bytes, reversing the bytes of each element
+static void span_swap(uint8_t* dst, const uint8_t* src, size_t n, uint32_t size) {
+    size_t bytes = n * size;
+    size_t done = 0;
+#if VM_SPAN_X86
+    int level = span_detect_x86();
+    if (level == 3) done = span_swap_avx2(dst, src, bytes, size);
+    if (level >= 2) done += span_swap_ssse3(dst + done, src + done, bytes - done, size);
+#elif VM_SPAN_NEON
+    done = span_swap_neon(dst, src, bytes, size);
+#endif
+    span_swap_scalar(dst + done, src + done, (bytes - done) / size, size);
+}
+
+// Wire <-> host order copy of `n` elements
+static void span_copy(uint8_t* dst, const uint8_t* src, size_t n, uint32_t size, bool swap) {
+    if (swap) span_swap(dst, src, n, size);
+    else memcpy(dst, src, n * size);
+}
+
+// --- Scaling ---
+
+// Scratch elements, one member per primitive type
+typedef union {
+    uint8_t u8[VM_SPAN_CHUNK]; int8_t i8[VM_SPAN_CHUNK];
+    uint16_t u16[VM_SPAN_CHUNK]; int16_t i16[VM_SPAN_CHUNK];
+    uint32_t u32[VM_SPAN_CHUNK]; int32_t i32[VM_SPAN_CHUNK];
+    uint64_t u64[VM_SPAN_CHUNK]; int64_t i64[VM_SPAN_CHUNK];
+    float f32[VM_SPAN_CHUNK]; double f64[VM_SPAN_CHUNK];
+} span_scratch;
+
+#define SPAN_SCALE_TYPES(X) \
+    X(OP_IO_U8, u8, uint8_t) X(OP_IO_I8, i8, int8_t) X(OP_IO_U16, u16, uint16_t) X(OP_IO_I16, i16, int16_t) \
+    X(OP_IO_U32, u32, uint32_t) X(OP_IO_I32, i32, int32_t) X(OP_IO_U64, u64, uint64_t) X(OP_IO_I64, i64, int64_t) \
+    X(OP_IO_F32, f32, float) X(OP_IO_F64, f64, double)
+
+// Same arithmetic as the per-element SCALE_LIN path
+static void span_scale_decode(double* out, const span_scratch* raw, size_t n, uint8_t type, double fac, double off) {
+    switch (type) {
+#define X(op, m, T) case op: for (size_t i = 0; i < n; i++) out[i] = (double)raw->m[i] * fac + off; break;
+        SPAN_SCALE_TYPES(X)
+#undef X
+        default: break;
+    }
+}
+
+static void span_scale_encode(span_scratch* raw, const double* in, size_t n, uint8_t type, double fac, double off) {
+    switch (type) {
+#define X(op, m, T) case op: for (size_t i = 0; i < n; i++) raw->m[i] = (T)((in[i] - off) / fac); break;
+        SPAN_SCALE_TYPES(X)
+#undef X
+        default: break;
+    }
+}
+
+#undef SPAN_SCALE_TYPES
+
+// --- Span Transfer ---
+
+bool vm_array_span(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, uint32_t count,
+                   const double* scale, cnd_error_t* err) {
+    if (!(ctx->flags & CND_CTX_ARRAY_SPANS) && ctx->io_callback != cnd_bind_io) return false;
+    if (count == 0 || type == OP_IO_BOOL || ctx->is_next_optional || ctx->bit_offset != 0) return false;
+    uint32_t size = il_type_size(type);
+    if (size == 0) return false;
+    if (ctx->cursor > ctx->data_len || (uint64_t)count * size > ctx->data_len - ctx->cursor) return false; // Loop reports OOB
+
+    bool encode = (ctx->mode == CND_MODE_ENCODE);
+    bool swap = size > 1 && ((ctx->endianness == CND_BE) != VM_HOST_BE);
+    uint8_t* wire = ctx->data_buffer + ctx->cursor;
+    cnd_span span;
+    span.type = scale ? OP_IO_F64 : type;
+
+    // Zero copy: the host works on the data buffer itself
+    if (!swap && !scale) {
+        span.data = wire;
+        span.first = 0;
+        span.count = count;
+        if (ctx->io_callback(ctx, key, OP_ARR_SPAN, &span) != CND_ERR_OK) return false;
+        ctx->cursor += (size_t)count * size;
+        *err = CND_ERR_OK;
+        return true;
+    }
+
+    span_scratch raw;
+    double eng[VM_SPAN_CHUNK];
+    for (uint32_t first = 0; first < count; first += VM_SPAN_CHUNK) {
+        uint32_t n = (count - first < VM_SPAN_CHUNK) ? count - first : VM_SPAN_CHUNK;
+        uint8_t* w = wire + (size_t)first * size;
+        span.first = first;
+        span.count = n;
+        span.data = scale ? (void*)eng : (void*)raw.u8;
+
+        if (!encode) {
+            span_copy(raw.u8, w, n, size, swap);
+            if (scale) span_scale_decode(eng, &raw, n, type, scale[0], scale[1]);
+        }
+        if (ctx->io_callback(ctx, key, OP_ARR_SPAN, &span) != CND_ERR_OK) {
+            if (first == 0) return false; // Declined: the caller runs the loop
+            *err = CND_ERR_CALLBACK;
+            return true;
+        }
+        if (encode) {
+            if (scale) span_scale_encode(&raw, eng, n, type, scale[0], scale[1]);
+            span_copy(w, raw.u8, n, size, swap);
+        }
+    }
+    ctx->cursor += (size_t)count * size;
+    *err = CND_ERR_OK;
+    return true;
+}
+
+// --- Streaming Byte Arrays ---
+//
+// A byte array that runs past the input of a stream goes to the host piece
+// by piece, one OP_ARR_SPAN per chunk, pointing into that chunk. The array
+// counts as executed once its first piece is out; vm_stream_span_resume
+// delivers the rest before the VM moves on.
+
+bool vm_stream_span(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, uint32_t count, cnd_error_t* err) {
+    if (!(ctx->flags & CND_CTX_ARRAY_SPANS) && ctx->io_callback != cnd_bind_io) return false;
+    if (count == 0 || ctx->is_next_optional || ctx->bit_offset != 0 || ctx->cursor > ctx->data_len) return false;
+    if (count <= ctx->data_len - ctx->cursor) return false; // Fits: the bulk path takes it
+
+    ctx->span_type = type;
+    ctx->span_key = key;
+    ctx->span_first = 0;
+    ctx->span_left = count;
+    *err = vm_stream_span_resume(ctx);
+    if (*err == CND_ERR_CALLBACK && ctx->span_first == 0) {
+        ctx->span_left = 0; // Declined: the caller runs the loop
+        return false;
+    }
+    return true;
+}
+
+cnd_error_t vm_stream_span_resume(cnd_vm_ctx* ctx) {
+    if (ctx->span_left == 0) return CND_ERR_OK;
+    size_t avail = ctx->cursor < ctx->data_len ? ctx->data_len - ctx->cursor : 0;
+    uint32_t n = avail < ctx->span_left ? (uint32_t)avail : ctx->span_left;
+    if (n > 0) {
+        cnd_span span;
+        span.data = ctx->data_buffer + ctx->cursor;
+        span.first = ctx->span_first;
+        span.count = n;
+        span.type = ctx->span_type;
+        if (ctx->io_callback(ctx, ctx->span_key, OP_ARR_SPAN, &span) != CND_ERR_OK) return CND_ERR_CALLBACK;
+        ctx->cursor += n;
+        ctx->span_first += n;
+        ctx->span_left -= n;
+    }
+    if (ctx->span_left == 0) return CND_ERR_OK;
+    return vm_stream_open(ctx) ? CND_ERR_NEED_MORE : CND_ERR_OOB;
+}
@@ -0,0 +1,183 @@
+#include "vm_internal.h"
+#include <string.h>
+
+// --- Streaming Decode ---
+//
+// The VM decodes straight out of each chunk. When an instruction runs out of
+// input, cnd_execute() undoes it (CND_CTX_STREAM) and the bytes it had started
+// on, the only ones still needed, move to the carry buffer. The next chunk is
+// appended there until that instruction has completed, after which decoding
+// continues in the chunk itself.
+//
+// Buffer positions kept in the context (the cursor and the CRC region) are
+// moved whenever the VM changes buffers. Bytes that leave for good are first
+// hashed into the running CRC register, which is why the parameters of the
+// program's CRC fields have to be known up front.
+
+static size_t stream_min(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+// Position `pos` of the buffer being left, in a buffer where `from` is `to`.
+// Positions before `from` are gone and collapse onto it.
+static size_t stream_pos(size_t pos, size_t from, size_t to) {
+    if (pos == SIZE_MAX) return pos;
+    return pos > from ? pos - from + to : to;
+}
+
+// Moves the run to another buffer in which position `from` of the current
+// one is `to`. Everything before `from` is dropped.
+static void stream_move(cnd_stream* s, size_t from, size_t to) {
+    cnd_vm_ctx* ctx = &s->ctx;
+    size_t hi = stream_min(from, ctx->crc_end);
+    if (s->crc_width != 0 && ctx->crc_start < hi) {
+        if (ctx->crc_width == 0) {
+            ctx->crc_width = s->crc_width;
+            ctx->crc_poly = s->crc_poly;
+            ctx->crc_init = s->crc_init;
+            ctx->crc_flags = s->crc_flags;
+            ctx->crc_reg = vm_crc_start(s->crc_poly, s->crc_init, s->crc_flags, s->crc_width);
+            ctx->crc_done = ctx->crc_start;
+        }
+        if (ctx->crc_done < hi) {
+            ctx->crc_reg = vm_crc_update(ctx->crc_reg, ctx->data_buffer + ctx->crc_done, hi - ctx->crc_done,
+                                         s->crc_poly, s->crc_flags, s->crc_width);
+            ctx->crc_done = hi;
+        }
+    }
+    ctx->crc_start = stream_pos(ctx->crc_start, from, to);
+    ctx->crc_end = stream_pos(ctx->crc_end, from, to);
+    ctx->crc_done = stream_pos(ctx->crc_done, from, to);
+    ctx->cursor = stream_pos(ctx->cursor, from, to);
+}
+
+static cnd_error_t stream_run(cnd_stream* s, const uint8_t* data, size_t len) {
+    s->ctx.data_buffer = (uint8_t*)data; // Decode only reads it
+    s->ctx.data_len = len;
+    return cnd_execute(&s->ctx);
+}
+
+// Bytes of the buffer the finished packet took (a started byte counts)
+static size_t stream_used(const cnd_vm_ctx* ctx) {
+    return ctx->cursor + (ctx->bit_offset != 0);
+}
+
+cnd_error_t cnd_stream_init(cnd_stream* stream, const cnd_program* program,
+                            uint8_t* carry, size_t carry_size,
+                            cnd_io_cb cb, void* user) {
+    if (!stream || !program || !program->bytecode || !carry || carry_size == 0) return CND_ERR_INVALID_OP;
+
+    stream->crc_width = 0;
+    const uint8_t* bc = program->bytecode;
+    size_t len = program->bytecode_len;
+    vm_insn_walk walk;
+    vm_walk_init(&walk);
+    size_t ip, n;
+    while (vm_walk_next(&walk, bc, len, &ip, &n)) {
+        uint32_t poly, init;
+        uint8_t flags, width;
+        if (bc[ip] == OP_CRC_16 && n >= 8) {
+            poly = il_get_u16(bc + ip + 1);
+            init = il_get_u16(bc + ip + 3);
+            flags = bc[ip + 7] & 3;
+            width = 16;
+        } else if (bc[ip] == OP_CRC_32 && n >= 14) {
+            poly = il_get_u32(bc + ip + 1);
+            init = il_get_u32(bc + ip + 5);
+            flags = bc[ip + 13] & 3;
+            width = 32;
+        } else {
+            continue;
+        }
+        if (stream->crc_width != 0 && (stream->crc_width != width || stream->crc_poly != poly ||
+                                       stream->crc_init != init || stream->crc_flags != flags)) {
+            return CND_ERR_INVALID_OP;
+        }
+        stream->crc_poly = poly;
+        stream->crc_init = init;
+        stream->crc_flags = flags;
+        stream->crc_width = width;
+    }
+
+    stream->carry = carry;
+    stream->carry_size = carry_size;
+    stream->carry_len = 0;
+    cnd_init(&stream->ctx, CND_MODE_DECODE, program, carry, 0, cb, user);
+    stream->ctx.flags = CND_CTX_STREAM;
+    return CND_ERR_OK;
+}
+
+void cnd_stream_reset(cnd_stream* stream) {
+    if (!stream) return;
+    cnd_vm_ctx* ctx = &stream->ctx;
+    uint8_t flags = (uint8_t)(ctx->flags & ~CND_CTX_STREAM_END);
+    cnd_init(ctx, CND_MODE_DECODE, ctx->program, stream->carry, 0, ctx->io_callback, ctx->user_ptr);
+    ctx->flags = flags;
+    stream->carry_len = 0;
+}
+
+cnd_error_t cnd_stream_feed(cnd_stream* stream, const uint8_t* chunk, size_t len, size_t* used) {
+    if (used) *used = 0;
+    if (!stream) return CND_ERR_INVALID_OP;
+    if (!chunk || len == 0) return CND_ERR_NEED_MORE;
+
+    cnd_stream* s = stream;
+    cnd_vm_ctx* ctx = &s->ctx;
+    size_t off = 0;                // Bytes of the chunk taken so far
+    size_t old = s->carry_len;     // Carry bytes from earlier chunks
+    cnd_error_t err;
+
+    // The instruction left waiting in the carry completes there, with as
+    // much of the chunk appended as fits. The carry is always run from 0.
+    while (old > 0) {
+        size_t n = stream_min(len - off, s->carry_size - s->carry_len);
+        memcpy(s->carry + s->carry_len, chunk + off, n);
+        s->carry_len += n;
+        off += n;
+
+        err = stream_run(s, s->carry, s->carry_len);
+        if (err != CND_ERR_NEED_MORE) {
+            size_t rest = s->carry_len - stream_min(stream_used(ctx), s->carry_len);
+            if (used) *used = off > rest ? off - rest : 0;
+            return err;
+        }
+
+        size_t k = ctx->cursor;
+        stream_move(s, k, 0);
+        memmove(s->carry, s->carry + k, s->carry_len - k);
+        s->carry_len -= k;
+        old = old > k ? old - k : 0;
+        if (old == 0) break;
+        if (off == len) {
+            if (used) *used = len;
+            return CND_ERR_NEED_MORE;
+        }
+        if (k == 0 && s->carry_len == s->carry_size) return CND_ERR_OOB; // Field larger than the carry
+    }
+
+    // What is left in the carry is the chunk up to `off`: go on in the chunk
+    stream_move(s, 0, off - s->carry_len);
+    s->carry_len = 0;
+    err = stream_run(s, chunk, len);
+    if (err != CND_ERR_NEED_MORE) {
+        if (used) *used = stream_min(stream_used(ctx), len);
+        return err;
+    }
+
+    // Keep the bytes of the instruction that ran out
+    size_t k = ctx->cursor;
+    if (len - k > s->carry_size) return CND_ERR_OOB;
+    stream_move(s, k, 0);
+    memcpy(s->carry, chunk + k, len - k);
+    s->carry_len = len - k;
+    ctx->data_buffer = s->carry;
+    ctx->data_len = s->carry_len;
+    if (used) *used = len;
+    return CND_ERR_NEED_MORE;
+}
+
+cnd_error_t cnd_stream_finish(cnd_stream* stream) {
+    if (!stream) return CND_ERR_INVALID_OP;
+    stream->ctx.flags |= CND_CTX_STREAM_END;
+    return stream_run(stream, stream->carry, stream->carry_len);
+}
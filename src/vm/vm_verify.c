@@ -1,5 +1,450 @@
 #include "concordia.h"
 #include "vm_internal.h"
+#include <string.h>
+
+// Register program of an OP_EXPR: known operations on registers that exist,
+// ending in its only OP_REG_RET
+static cnd_error_t expr_check(const uint8_t* code, size_t len)
+{
+    size_t i = 0;
+    while (i < len) {
+        if (len - i < 4) return CND_ERR_OOB;
+        const uint8_t* p = code + i;
+        uint8_t d = p[1] & (uint8_t)~CND_EXPR_IMM;
+        bool imm = (p[1] & CND_EXPR_IMM) != 0;
+        int arity = vm_alu_arity(p[0]);
+        size_t n = 4;
+
+        switch (p[0]) {
+            case OP_REG_LOAD:
+            case OP_REG_IMM:
+                arity = 0;
+                break;
+            case OP_REG_CONST:
+            case OP_REG_FCONST:
+                n = 12;
+                arity = 0;
+                break;
+            case OP_REG_ITOB:
+            case OP_REG_BTOI:
+                arity = 1;
+                break;
+            case OP_REG_RET:
+                if (p[3] > 1) return CND_ERR_INVALID_OP;
+                if (i + 4 != len) return CND_ERR_INVALID_OP;
+                arity = 1;
+                break;
+            default:
+                if (arity == 0) return CND_ERR_INVALID_OP;
+                break;
+        }
+
+        // Immediates only replace the second operand of integer operations
+        if (imm) {
+            bool int_op = (p[0] >= OP_EQ && p[0] <= OP_MOD) || (p[0] >= OP_BIT_AND && p[0] <= OP_SHR);
+            if (arity != 2 || !int_op) return CND_ERR_INVALID_OP;
+        }
+        if (d >= CND_EXPR_REGS) return CND_ERR_INVALID_OP;
+        if (arity >= 1 && p[2] >= CND_EXPR_REGS) return CND_ERR_INVALID_OP;
+        if (arity == 2 && !imm && p[3] >= CND_EXPR_REGS) return CND_ERR_INVALID_OP;
+        if (n > len - i) return CND_ERR_OOB;
+        i += n;
+        if (p[0] == OP_REG_RET) return CND_ERR_OK;
+    }
+    return CND_ERR_INVALID_OP;
+}
+
+cnd_error_t vm_insn_length(const uint8_t* bc, size_t len, size_t ip, size_t* out_len)
+{
+    if (ip >= len) return CND_ERR_OOB;
+
+    uint8_t opcode = bc[ip];
+    size_t instr_len = 1; // Opcode itself
+
+    // Add argument lengths based on opcode
+    switch (opcode) {
+        // 0 args
+        case OP_NOOP:
+        case OP_SET_ENDIAN_LE:
+        case OP_SET_ENDIAN_BE:
+        case OP_EXIT_STRUCT:
+        case OP_ARR_END:
+        case OP_POP:
+        case OP_SWAP:
+        case OP_DUP:
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_NEG:
+        case OP_FADD:
+        case OP_FSUB:
+        case OP_FMUL:
+        case OP_FDIV:
+        case OP_FNEG:
+        case OP_SIN:
+        case OP_COS:
+        case OP_TAN:
+        case OP_SQRT:
+        case OP_POW:
+        case OP_LOG:
+        case OP_ABS:
+        case OP_ITOF:
+        case OP_FTOI:
+        case OP_EQ_F:
+        case OP_NEQ_F:
+        case OP_GT_F:
+        case OP_LT_F:
+        case OP_GTE_F:
+        case OP_LTE_F:
+        case OP_BIT_AND:
+        case OP_BIT_OR:
+        case OP_BIT_XOR:
+        case OP_BIT_NOT:
+        case OP_SHL:
+        case OP_SHR:
+        case OP_EQ:
+        case OP_NEQ:
+        case OP_GT:
+        case OP_LT:
+        case OP_GTE:
+        case OP_LTE:
+        case OP_LOG_AND:
+        case OP_LOG_OR:
+        case OP_LOG_NOT:
+        case OP_MARK_OPTIONAL:
+        case OP_CRC_BEGIN:
+        case OP_CRC_END:
+        case OP_ENTER_BIT_MODE:
+        case OP_EXIT_BIT_MODE:
+        case OP_RET:
+            instr_len = 1;
+            break;
+
+        // 1 byte arg
+        case OP_META_VERSION:
+        case OP_ALIGN_PAD:
+        case OP_ALIGN_FILL:
+        case OP_EMIT:
+            instr_len = 2;
+            break;
+
+        // 2 byte arg (Key ID)
+        case OP_ENTER_STRUCT:
+        case OP_META_NAME:
+        case OP_CTX_QUERY:
+        case OP_IO_U8:
+        case OP_IO_U16:
+        case OP_IO_U32:
+        case OP_IO_U64:
+        case OP_IO_I8:
+        case OP_IO_I16:
+        case OP_IO_I32:
+        case OP_IO_I64:
+        case OP_IO_F32:
+        case OP_IO_F64:
+        case OP_IO_BOOL:
+        case OP_STR_PRE_U8:
+        case OP_ARR_PRE_U8:
+        case OP_STR_PRE_U16:
+        case OP_ARR_PRE_U16:
+        case OP_STR_PRE_U32:
+        case OP_ARR_PRE_U32:
+        case OP_ARR_EOF:
+        case OP_LOAD_CTX:
+        case OP_STORE_CTX:
+            instr_len = 3;
+            break;
+
+        // Key ID + Bit Width
+        case OP_IO_BIT_U:
+        case OP_IO_BIT_I:
+        case OP_IO_BIT_BOOL:
+            instr_len = 4;
+            break;
+
+        case OP_IO_BIT_GROUP: {
+            // Count(1) + Count * {Type(1) Key(2) Width(1)}, at most 64 bits in total
+            if (ip + 2 > len) return CND_ERR_OOB;
+            uint8_t count = bc[ip + 1];
+            if (count == 0) return CND_ERR_INVALID_OP;
+            instr_len = 2 + (size_t)count * 4;
+            if (ip + instr_len > len) return CND_ERR_OOB;
+            uint32_t total = 0;
+            for (uint8_t i = 0; i < count; i++) {
+                const uint8_t* f = bc + ip + 2 + (size_t)i * 4;
+                if (f[0] != OP_IO_BIT_U && f[0] != OP_IO_BIT_I && f[0] != OP_IO_BIT_BOOL) return CND_ERR_INVALID_OP;
+                if (f[3] == 0 || (f[0] == OP_IO_BIT_BOOL && f[3] != 1)) return CND_ERR_INVALID_OP;
+                total += f[3];
+            }
+            if (total > 64) return CND_ERR_INVALID_OP;
+            break;
+        }
+
+        case OP_IO_RUN: {
+            // Count(1) + Bytes(2) + Count * {Type(1) Key(2)}; Bytes is their total size
+            if (ip + 4 > len) return CND_ERR_OOB;
+            uint8_t count = bc[ip + 1];
+            if (count == 0) return CND_ERR_INVALID_OP;
+            instr_len = 4 + (size_t)count * 3;
+            if (ip + instr_len > len) return CND_ERR_OOB;
+            uint32_t total = 0;
+            for (uint8_t i = 0; i < count; i++) {
+                uint8_t type = bc[ip + 4 + (size_t)i * 3];
+                if (type < OP_IO_U8 || type > OP_IO_BOOL) return CND_ERR_INVALID_OP;
+                total += il_type_size(type);
+            }
+            if (total != il_get_u16(bc + ip + 2)) return CND_ERR_INVALID_OP;
+            break;
+        }
+
+        case OP_IO_CHECK: {
+            // Type(1) + Key(2) + a range or enum check of the same type
+            if (ip + 5 > len) return CND_ERR_OOB;
+            uint8_t type = bc[ip + 1];
+            uint8_t check = bc[ip + 4];
+            if (type < OP_IO_U8 || type > OP_IO_BOOL) return CND_ERR_INVALID_OP;
+            if (check != OP_RANGE_CHECK && check != OP_ENUM_CHECK &&
+                check != OP_ENUM_SORTED && check != OP_ENUM_BITMAP) return CND_ERR_INVALID_OP;
+            if (ip + 6 > len) return CND_ERR_OOB;
+            if (bc[ip + 5] != type) return CND_ERR_INVALID_OP;
+            size_t check_len = 0;
+            cnd_error_t err = vm_insn_length(bc, len, ip + 4, &check_len);
+            if (err != CND_ERR_OK) return err;
+            instr_len = 4 + check_len;
+            break;
+        }
+
+        case OP_IO_SLOT:
+            // Type(1) + Key(2) of an integer or bool field
+            if (ip + 4 > len) return CND_ERR_OOB;
+            if (bc[ip + 1] < OP_IO_U8 || bc[ip + 1] > OP_IO_BOOL ||
+                bc[ip + 1] == OP_IO_F32 || bc[ip + 1] == OP_IO_F64) return CND_ERR_INVALID_OP;
+            instr_len = 4;
+            break;
+
+        // Special cases
+        case OP_ARR_FIXED:
+            instr_len = 7; // 1 + Key(2) + Count(4)
+            break;
+
+        case OP_ARR_DYNAMIC:
+            instr_len = 5; // 1 + Key(2) + RefKey(2)
+            break;
+
+        case OP_STR_NULL:
+            instr_len = 5; // 1 + Key(2) + MaxLen(2)
+            break;
+
+        case OP_RAW_BYTES:
+            instr_len = 7; // 1 + Key(2) + Count(4)
+            break;
+
+        case OP_CONST_CHECK: {
+            // Key(2) + Type(1) + Value(type size)
+            if (ip + 4 > len) return CND_ERR_OOB;
+            uint32_t size = il_type_size(bc[ip + 3]);
+            if (size == 0) return CND_ERR_INVALID_OP;
+            instr_len = 1 + 2 + 1 + size;
+            break;
+        }
+
+        case OP_CONST_WRITE: {
+            // Type(1) + Value(type size)
+            if (ip + 2 > len) return CND_ERR_OOB;
+            uint32_t size = il_type_size(bc[ip + 1]);
+            if (size == 0) return CND_ERR_INVALID_OP;
+            instr_len = 1 + 1 + size;
+            break;
+        }
+
+        case OP_RANGE_CHECK: {
+            // Type(1) + Min(type size) + Max(type size)
+            if (ip + 2 > len) return CND_ERR_OOB;
+            uint32_t size = il_type_size(bc[ip + 1]);
+            if (size == 0) return CND_ERR_INVALID_OP;
+            instr_len = 1 + 1 + 2 * size;
+            break;
+        }
+
+        case OP_ENUM_CHECK:
+        case OP_ENUM_SORTED: {
+            // Type(1) + Count(2) + Values(count * type size)
+            if (ip + 4 > len) return CND_ERR_OOB;
+            uint32_t size = il_type_size(bc[ip + 1]);
+            if (size == 0) return CND_ERR_INVALID_OP;
+            instr_len = 1 + 1 + 2 + (size_t)il_get_u16(bc + ip + 2) * size;
+            break;
+        }
+
+        case OP_ENUM_BITMAP: {
+            // Type(1) + Base(type size) + Span(2) + Bits((span + 7) / 8)
+            if (ip + 2 > len) return CND_ERR_OOB;
+            uint32_t size = il_type_size(bc[ip + 1]);
+            if (size == 0) return CND_ERR_INVALID_OP;
+            if (ip + 2 + size + 2 > len) return CND_ERR_OOB;
+            instr_len = 1 + 1 + size + 2 + ((size_t)il_get_u16(bc + ip + 2 + size) + 7) / 8;
+            break;
+        }
+
+        case OP_SCALE_LIN:
+            // Factor(8) + Offset(8)
+            instr_len = 1 + 8 + 8;
+            break;
+
+        case OP_CRC_16:
+            // Poly(2) + Init(2) + XorOut(2) + Flags(1)
+            instr_len = 1 + 2 + 2 + 2 + 1;
+            break;
+
+        case OP_CRC_32:
+            // Poly(4) + Init(4) + XorOut(4) + Flags(1)
+            instr_len = 1 + 4 + 4 + 4 + 1;
+            break;
+
+        case OP_TRANS_ADD:
+        case OP_TRANS_SUB:
+        case OP_TRANS_MUL:
+        case OP_TRANS_DIV:
+        case OP_PUSH_IMM:
+            instr_len = 9; // 1 + 8
+            break;
+
+        case OP_TRANS_POLY:
+            // Count(1) + Coefficients(count * 8)
+            if (ip + 2 > len) return CND_ERR_OOB;
+            instr_len = 2 + (size_t)bc[ip + 1] * 8;
+            break;
+
+        case OP_TRANS_SPLINE:
+            // Count(1) + Points(count * 16)
+            if (ip + 2 > len) return CND_ERR_OOB;
+            instr_len = 2 + (size_t)bc[ip + 1] * 16;
+            break;
+
+        case OP_JUMP:
+        case OP_JUMP_IF_NOT:
+            instr_len = 5; // 1 + Offset(4)
+            break;
+
+        case OP_SWITCH:
+        case OP_SWITCH_TABLE:
+        case OP_SWITCH_SORTED:
+        case OP_SWITCH_HASH:
+            instr_len = 7; // 1 + Key(2) + TableOffset(4)
+            break;
+
+        case OP_CALL:
+            instr_len = 9; // 1 + KeyBase(2) + KeyCount(2) + Offset(4)
+            break;
+
+        case OP_EXPR: {
+            // Len(1) + Len bytes of register instructions
+            if (ip + 2 > len) return CND_ERR_OOB;
+            instr_len = 2 + (size_t)bc[ip + 1];
+            if (ip + instr_len > len) return CND_ERR_OOB;
+            cnd_error_t err = expr_check(bc + ip + 2, bc[ip + 1]);
+            if (err != CND_ERR_OK) return err;
+            break;
+        }
+
+        default:
+            return CND_ERR_INVALID_OP;
+    }
+
+    // Check if instruction fits
+    if (ip + instr_len > len) {
+        return CND_ERR_OOB;
+    }
+
+    *out_len = instr_len;
+    return CND_ERR_OK;
+}
+
+cnd_error_t vm_switch_table_span(const uint8_t* bc, size_t len, size_t ip, size_t* table_start, size_t* table_len)
+{
+    if (ip + 7 > len) return CND_ERR_OOB;
+
+    // Table is located relative to code_start_ip (ip + 7)
+    size_t start = (ip + 7) + il_get_u32(bc + ip + 3);
+    if (start > len) return CND_ERR_OOB;
+
+    uint64_t size;
+    if (bc[ip] == OP_SWITCH || bc[ip] == OP_SWITCH_SORTED) {
+        // Count(2) + Default(4) + count * (Value(8) + Offset(4))
+        if (start + 6 > len) return CND_ERR_OOB;
+        size = 6 + (uint64_t)il_get_u16(bc + start) * 12;
+    } else if (bc[ip] == OP_SWITCH_HASH) {
+        // Default(4) + Mult(8) + SlotBits(1) + BucketBits(1)
+        //   + 2^BucketBits * Disp(2) + 2^SlotBits * (Value(8) + Offset(4))
+        if (start + 14 > len) return CND_ERR_OOB;
+        uint8_t slot_bits = bc[start + 12];
+        uint8_t bucket_bits = bc[start + 13];
+        if (slot_bits < 1 || slot_bits > VM_SWITCH_HASH_MAX_BITS) return CND_ERR_VALIDATION;
+        if (bucket_bits < 1 || bucket_bits > VM_SWITCH_HASH_MAX_BITS) return CND_ERR_VALIDATION;
+        size = 14 + ((uint64_t)2 << bucket_bits) + ((uint64_t)12 << slot_bits);
+    } else {
+        // Min(8) + Max(8) + Default(4) + (max - min + 1) * Offset(4)
+        if (start + 20 > len) return CND_ERR_OOB;
+        uint64_t min_val = il_get_u64(bc + start);
+        uint64_t max_val = il_get_u64(bc + start + 8);
+        if (max_val < min_val) return CND_ERR_VALIDATION;
+        uint64_t count = max_val - min_val + 1;
+        if (count == 0 || count > 0xFFFFFFFF) return CND_ERR_OOB;
+        size = 20 + count * 4;
+    }
+
+    if (size > len - start) return CND_ERR_OOB;
+
+    *table_start = start;
+    *table_len = (size_t)size;
+    return CND_ERR_OK;
+}
+
+bool vm_walk_next(vm_insn_walk* w, const uint8_t* bc, size_t len, size_t* ip, size_t* n)
+{
+    while (w->ip < len) {
+        // Skip over a switch table we have reached
+        bool skipped = false;
+        for (int i = 0; i < w->pending; i++) {
+            if (w->pending_start[i] == w->ip) {
+                w->ip = w->pending_end[i];
+                w->pending_start[i] = w->pending_start[w->pending - 1];
+                w->pending_end[i] = w->pending_end[w->pending - 1];
+                w->pending--;
+                skipped = true;
+                break;
+            }
+        }
+        if (skipped) continue;
+
+        size_t insn_len = 0;
+        if (vm_insn_length(bc, len, w->ip, &insn_len) != CND_ERR_OK || insn_len == 0) return false;
+        uint8_t op = bc[w->ip];
+        if (op == OP_SWITCH || op == OP_SWITCH_TABLE || op == OP_SWITCH_SORTED || op == OP_SWITCH_HASH) {
+            size_t table_start = 0, table_len = 0;
+            if (vm_switch_table_span(bc, len, w->ip, &table_start, &table_len) != CND_ERR_OK) return false;
+            if (w->pending >= VM_MAX_PENDING_TABLES) return false;
+            w->pending_start[w->pending] = table_start;
+            w->pending_end[w->pending] = table_start + table_len;
+            w->pending++;
+        }
+        *ip = w->ip;
+        *n = insn_len;
+        w->ip += insn_len;
+        return true;
+    }
+    return false;
+}
+
+// Target relative to code_start_ip must land inside the program (or exactly at its end)
+static cnd_error_t check_target(size_t code_start_ip, int32_t offset, size_t len)
+{
+    int64_t target = (int64_t)code_start_ip + offset;
+    if (target < 0 || (uint64_t)target > len) return CND_ERR_OOB;
+    return CND_ERR_OK;
+}
 
 cnd_error_t cnd_verify_program(const cnd_program* program)
 {
@@ -7,277 +452,359 @@ cnd_error_t cnd_verify_program(const cnd_program* program)
         return CND_ERR_OOB;
     }
 
-    uint32_t ip = 0;
-    uint32_t len = (uint32_t)program->bytecode_len;
+    size_t ip = 0;
+    size_t len = program->bytecode_len;
     const uint8_t* bc = program->bytecode;
 
+    // Switch tables live after the code they dispatch into; they are data, not instructions.
+    size_t pending_start[VM_MAX_PENDING_TABLES];
+    size_t pending_end[VM_MAX_PENDING_TABLES];
+    int pending = 0;
+    uint8_t prev_op = OP_NOOP;
+
     while (ip < len) {
-        uint8_t opcode = bc[ip];
-        
-        // Get instruction length
-        uint32_t instr_len = 1; // Opcode itself
-        
-        // Add argument lengths based on opcode
-        switch (opcode) {
-            // 0 args
-            case OP_NOOP:
-            case OP_SET_ENDIAN_LE:
-            case OP_SET_ENDIAN_BE:
-            case OP_ENTER_STRUCT:
-            case OP_EXIT_STRUCT:
-            case OP_META_VERSION:
-            case OP_META_NAME:
-            case OP_ARR_END:
-            case OP_ARR_EOF:
-            case OP_ARR_DYNAMIC:
-            case OP_POP:
-            case OP_SWAP:
-            case OP_DUP:
-            case OP_EMIT:
-            case OP_ADD:
-            case OP_SUB:
-            case OP_MUL:
-            case OP_DIV:
-            case OP_MOD:
-            case OP_NEG:
-            case OP_FADD:
-            case OP_FSUB:
-            case OP_FMUL:
-            case OP_FDIV:
-            case OP_FNEG:
-            case OP_SIN:
-            case OP_COS:
-            case OP_TAN:
-            case OP_SQRT:
-            case OP_POW:
-            case OP_LOG:
-            case OP_ABS:
-            case OP_ITOF:
-            case OP_FTOI:
-            case OP_EQ_F:
-            case OP_NEQ_F:
-            case OP_GT_F:
-            case OP_LT_F:
-            case OP_GTE_F:
-            case OP_LTE_F:
-            case OP_BIT_AND:
-            case OP_BIT_OR:
-            case OP_BIT_XOR:
-            case OP_BIT_NOT:
-            case OP_SHL:
-            case OP_SHR:
-            case OP_EQ:
-            case OP_NEQ:
-            case OP_GT:
-            case OP_LT:
-            case OP_GTE:
-            case OP_LTE:
-            case OP_LOG_AND:
-            case OP_LOG_OR:
-            case OP_LOG_NOT:
-            case OP_LOAD_CTX:
-            case OP_STORE_CTX:
-            case OP_MARK_OPTIONAL:
-            case OP_ENTER_BIT_MODE:
-            case OP_EXIT_BIT_MODE:
-                instr_len = 1;
+        // Skip over a switch table we have reached
+        bool skipped = false;
+        for (int i = 0; i < pending; i++) {
+            if (pending_start[i] == ip) {
+                ip = pending_end[i];
+                pending_start[i] = pending_start[pending - 1];
+                pending_end[i] = pending_end[pending - 1];
+                pending--;
+                skipped = true;
                 break;
+            }
+        }
+        if (skipped) continue;
 
-            // 1 byte arg
-            case OP_ALIGN_PAD:
-            case OP_ALIGN_FILL:
-                instr_len = 2;
-                break;
+        uint8_t opcode = bc[ip];
+        size_t instr_len = 0;
+        cnd_error_t err = vm_insn_length(bc, len, ip, &instr_len);
+        if (err != CND_ERR_OK) return err;
 
-            // 2 byte arg (Key ID)
-            case OP_CTX_QUERY:
-            case OP_IO_U8:
-            case OP_IO_U16:
-            case OP_IO_U32:
-            case OP_IO_U64:
-            case OP_IO_I8:
-            case OP_IO_I16:
-            case OP_IO_I32:
-            case OP_IO_I64:
-            case OP_IO_F32:
-            case OP_IO_F64:
-            case OP_IO_BOOL:
-            case OP_IO_BIT_U:
-            case OP_IO_BIT_I:
-            case OP_IO_BIT_BOOL:
-            case OP_STR_PRE_U8:
-            case OP_ARR_PRE_U8:
-            case OP_STR_PRE_U16:
-            case OP_ARR_PRE_U16:
-            case OP_STR_PRE_U32:
-            case OP_ARR_PRE_U32:
-                instr_len = 3;
-                break;
+        // Additional checks for JMP
+        if (opcode == OP_JUMP || opcode == OP_JUMP_IF_NOT) {
+            int32_t offset = (int32_t)il_get_u32(bc + ip + 1);
+            if (check_target(ip + 5, offset, len) != CND_ERR_OK) return CND_ERR_OOB;
+        }
+        if (opcode == OP_CALL) {
+            int32_t offset = (int32_t)il_get_u32(bc + ip + 5);
+            if (check_target(ip + 9, offset, len) != CND_ERR_OK) return CND_ERR_OOB;
+        }
 
-            // Special cases
-            case OP_ARR_FIXED:
-                instr_len = 7; // 1 + 2 + 4
-                break;
-                
-            case OP_STR_NULL:
-                instr_len = 5; // 1 + Key(2) + MaxLen(2)
-                break;
-                
-            case OP_RAW_BYTES:
-                instr_len = 7; // 1 + Key(2) + Count(4)
-                break;
+        // The scoreboard records the raw field, so nothing may modify how it is read
+        if (opcode == OP_IO_SLOT && (prev_op == OP_MARK_OPTIONAL || prev_op == OP_SCALE_LIN ||
+                                     (prev_op >= OP_TRANS_ADD && prev_op <= OP_TRANS_DIV) ||
+                                     prev_op == OP_TRANS_POLY || prev_op == OP_TRANS_SPLINE)) {
+            return CND_ERR_INVALID_OP;
+        }
 
-            case OP_CONST_CHECK:
-            case OP_CONST_WRITE:
-                // Key(2) + Type(1) + Value(8)
-                instr_len = 1 + 2 + 1 + 8;
-                break;
-                
-            case OP_RANGE_CHECK:
-                // Key(2) + Type(1) + Min(8) + Max(8)
-                instr_len = 1 + 2 + 1 + 8 + 8;
-                break;
-                
-            case OP_SCALE_LIN:
-                // Key(2) + Factor(8) + Offset(8)
-                instr_len = 1 + 2 + 8 + 8;
-                break;
-                
-            case OP_CRC_16:
-            case OP_CRC_32:
-                // Key(2) + StartOffset(4) + Length(4) + Poly(4) + Init(4) + XorOut(4) + RefIn(1) + RefOut(1)
-                // This is a guess based on typical CRC params, but let's assume it's handled or skip detailed check.
-                // Actually, let's just check opcode existence.
-                // If we don't know length, we can't verify.
-                // Assuming standard CRC32 params: 2+4+4+4+4+4+1+1 = 24 bytes?
-                // Let's assume 1 for now and hope it's not used in tests or fix later.
-                // Wait, tests use CRC16/32.
-                // Let's check vm_exec.c for CRC length.
-                // But I can't read it now.
-                // I'll assume 1 and if tests fail I'll fix.
-                instr_len = 1; 
-                break;
+        // Binary search needs strictly ascending values
+        size_t sorted = ip;
+        if (opcode == OP_IO_CHECK) sorted = ip + 4;
+        if (bc[sorted] == OP_ENUM_SORTED) {
+            uint32_t size = il_type_size(bc[sorted + 1]);
+            uint16_t count = il_get_u16(bc + sorted + 2);
+            for (uint16_t i = 1; i < count; i++) {
+                const uint8_t* cur_v = bc + sorted + 4 + (size_t)i * size;
+                const uint8_t* prev_v = cur_v - size;
+                uint64_t prev = 0, cur = 0;
+                for (uint32_t b = size; b-- > 0;) {
+                    prev = (prev << 8) | prev_v[b];
+                    cur = (cur << 8) | cur_v[b];
+                }
+                if (cur <= prev) return CND_ERR_VALIDATION;
+            }
+        }
 
-            case OP_PUSH_IMM:
-                instr_len = 9; // 1 + 8
-                break;
+        if (opcode == OP_SWITCH || opcode == OP_SWITCH_TABLE ||
+            opcode == OP_SWITCH_SORTED || opcode == OP_SWITCH_HASH) {
+            size_t table_start = 0, table_len = 0;
+            err = vm_switch_table_span(bc, len, ip, &table_start, &table_len);
+            if (err != CND_ERR_OK) return err;
 
-            case OP_JUMP:
-            case OP_JUMP_IF_NOT:
-                instr_len = 5; // 1 + Offset(4)
-                break;
+            size_t code_start_ip = ip + 7;
+            const uint8_t* t_ptr = bc + table_start;
 
-            case OP_SWITCH: {
-                if (ip + 7 > len) return CND_ERR_OOB;
-                // 1 (op) + 2 (key) + 4 (table_offset)
-                const uint8_t* off_ptr = bc + ip + 3;
-                uint32_t table_rel = (uint32_t)(off_ptr[0] | (off_ptr[1] << 8) | (off_ptr[2] << 16) | (off_ptr[3] << 24));
-                
-                size_t table_start = (ip + 7) + table_rel;
-                
-                if (table_start > len) return CND_ERR_OOB;
-                
-                // Read table header: Count(2) + Default(4)
-                if (table_start + 6 > len) return CND_ERR_OOB;
-                
-                const uint8_t* t_ptr = bc + table_start;
-                uint16_t count = (uint16_t)(t_ptr[0] | (t_ptr[1] << 8));
-                
-                // Table size: 2 + 4 + count * (8 + 4)
-                uint32_t table_size = 6 + count * 12;
-                if (table_start + table_size > len) return CND_ERR_OOB;
-                
-                // Check offsets
+            if (opcode == OP_SWITCH || opcode == OP_SWITCH_SORTED) {
+                uint16_t count = il_get_u16(t_ptr);
                 // Default offset
-                const uint8_t* def_ptr = bc + table_start + 2;
-                int32_t def_off = (int32_t)(def_ptr[0] | (def_ptr[1] << 8) | (def_ptr[2] << 16) | (def_ptr[3] << 24));
-                
-                // Target relative to code_start_ip (ip + 7)
-                int64_t target = (int64_t)(ip + 7) + def_off;
-                if (target < 0 || target >= len) return CND_ERR_OOB;
-                
-                // Case offsets
+                if (check_target(code_start_ip, (int32_t)il_get_u32(t_ptr + 2), len) != CND_ERR_OK) return CND_ERR_OOB;
+                // Case offsets (skip value(8))
                 for (uint16_t i = 0; i < count; i++) {
-                    const uint8_t* case_ptr = bc + table_start + 6 + (i * 12) + 8; // Skip value(8)
-                    int32_t off = (int32_t)(case_ptr[0] | (case_ptr[1] << 8) | (case_ptr[2] << 16) | (case_ptr[3] << 24));
-                    target = (int64_t)(ip + 7) + off;
-                    if (target < 0 || target >= len) return CND_ERR_OOB;
+                    int32_t off = (int32_t)il_get_u32(t_ptr + 6 + (i * 12) + 8);
+                    if (check_target(code_start_ip, off, len) != CND_ERR_OK) return CND_ERR_OOB;
+                    // Binary search needs strictly ascending values
+                    if (opcode == OP_SWITCH_SORTED && i > 0 &&
+                        il_get_u64(t_ptr + 6 + (i * 12)) <= il_get_u64(t_ptr + 6 + ((i - 1) * 12))) {
+                        return CND_ERR_VALIDATION;
+                    }
                 }
-                
-                instr_len = 7;
-                break;
-            }
-            
-            case OP_SWITCH_TABLE: {
-                if (ip + 7 > len) return CND_ERR_OOB;
-                // 1 (op) + 2 (key) + 4 (table_offset)
-                const uint8_t* off_ptr = bc + ip + 3;
-                uint32_t table_rel = (uint32_t)(off_ptr[0] | (off_ptr[1] << 8) | (off_ptr[2] << 16) | (off_ptr[3] << 24));
-                
-                size_t table_start = (ip + 7) + table_rel;
-                
-                if (table_start > len) return CND_ERR_OOB;
-                
-                // Read table header: Min(8) + Max(8) + Default(4)
-                if (table_start + 20 > len) return CND_ERR_OOB;
-                
-                const uint8_t* t_ptr = bc + table_start;
-                uint64_t min_val = (uint64_t)t_ptr[0] | ((uint64_t)t_ptr[1] << 8) | ((uint64_t)t_ptr[2] << 16) | ((uint64_t)t_ptr[3] << 24) |
-                                   ((uint64_t)t_ptr[4] << 32) | ((uint64_t)t_ptr[5] << 40) | ((uint64_t)t_ptr[6] << 48) | ((uint64_t)t_ptr[7] << 56);
-                uint64_t max_val = (uint64_t)t_ptr[8] | ((uint64_t)t_ptr[9] << 8) | ((uint64_t)t_ptr[10] << 16) | ((uint64_t)t_ptr[11] << 24) |
-                                   ((uint64_t)t_ptr[12] << 32) | ((uint64_t)t_ptr[13] << 40) | ((uint64_t)t_ptr[14] << 48) | ((uint64_t)t_ptr[15] << 56);
-                
-                if (max_val < min_val) return CND_ERR_VALIDATION;
-                
-                uint64_t count = max_val - min_val + 1;
-                if (count > 0xFFFFFFFF) return CND_ERR_OOB;
-                
-                uint64_t table_size_64 = 20 + count * 4;
-                if (table_size_64 > 0xFFFFFFFF) return CND_ERR_OOB;
-                uint32_t table_size = (uint32_t)table_size_64;
-                
-                if (table_start + table_size > len) return CND_ERR_OOB;
-                
-                // Check default offset
-                const uint8_t* def_ptr = bc + table_start + 16;
-                int32_t def_off = (int32_t)(def_ptr[0] | (def_ptr[1] << 8) | (def_ptr[2] << 16) | (def_ptr[3] << 24));
-                int64_t target = (int64_t)(ip + 7) + def_off;
-                if (target < 0 || target >= len) return CND_ERR_OOB;
-                
-                // Check table offsets
-                for (uint64_t i = 0; i < count; i++) {
-                    const uint8_t* entry_ptr = bc + table_start + 20 + (i * 4);
-                    int32_t off = (int32_t)(entry_ptr[0] | (entry_ptr[1] << 8) | (entry_ptr[2] << 16) | (entry_ptr[3] << 24));
-                    target = (int64_t)(ip + 7) + off;
-                    if (target < 0 || target >= len) return CND_ERR_OOB;
+            } else if (opcode == OP_SWITCH_HASH) {
+                if (check_target(code_start_ip, (int32_t)il_get_u32(t_ptr), len) != CND_ERR_OK) return CND_ERR_OOB;
+                uint32_t slots = 1u << t_ptr[12];
+                uint32_t buckets = 1u << t_ptr[13];
+                // Displacements must keep every key inside the slot array
+                for (uint32_t i = 0; i < buckets; i++) {
+                    if (il_get_u16(t_ptr + 14 + i * 2) >= slots) return CND_ERR_VALIDATION;
+                }
+                const uint8_t* entries = t_ptr + 14 + (size_t)buckets * 2;
+                for (uint32_t i = 0; i < slots; i++) {
+                    int32_t off = (int32_t)il_get_u32(entries + (size_t)i * 12 + 8);
+                    if (check_target(code_start_ip, off, len) != CND_ERR_OK) return CND_ERR_OOB;
+                }
+            } else {
+                // Default offset
+                if (check_target(code_start_ip, (int32_t)il_get_u32(t_ptr + 16), len) != CND_ERR_OK) return CND_ERR_OOB;
+                // Table offsets
+                size_t count = (table_len - 20) / 4;
+                for (size_t i = 0; i < count; i++) {
+                    int32_t off = (int32_t)il_get_u32(t_ptr + 20 + (i * 4));
+                    if (check_target(code_start_ip, off, len) != CND_ERR_OK) return CND_ERR_OOB;
                 }
-                
-                instr_len = 7;
-                break;
             }
 
-            default:
-                return CND_ERR_INVALID_OP;
+            if (pending >= VM_MAX_PENDING_TABLES) return CND_ERR_STACK_OVERFLOW;
+            pending_start[pending] = table_start;
+            pending_end[pending] = table_start + table_len;
+            pending++;
         }
 
-        // Check if instruction fits
-        if (ip + instr_len > len) {
-            return CND_ERR_OOB;
+        prev_op = opcode;
+        ip += instr_len;
+    }
+
+    // Size bounds from the IL header must hold on every path
+    if (program->min_size > 0 || program->max_size > 0) {
+        uint32_t min_size = 0, max_size = 0;
+        cnd_error_t err = cnd_program_size_bounds(program, &min_size, &max_size);
+        if (err != CND_ERR_OK) return err;
+        if (program->min_size > min_size) return CND_ERR_VALIDATION;
+        if (program->max_size > 0 && (max_size == 0 || program->max_size < max_size)) return CND_ERR_VALIDATION;
+    }
+
+    return CND_ERR_OK;
+}
+
+// --- Stack Depths ---
+// The compiler only leaves values on the expression stack within one
+// straight-line expression, so every jump, call, return, switch and loop
+// instruction (and every jump target) sees an empty stack. Under that rule
+// the stack depth of each instruction is known exactly. Loop depth is
+// static nesting within a subroutine plus, at each call, the callee's own
+// worst case.
+
+// Per-slot scratch (VM_DEPTH_SCRATCH bytes)
+#define DEPTH_NEST   0 // Loops the slot's subroutine has open when it runs
+#define DEPTH_FLAGS  1
+#define DEPTH_LOOPS  2 // Entry slots: most loops open in the subroutine and its callees
+#define DEPTH_REGION 4 // Subroutine the slot belongs to (u32, 0 for extension slots)
+
+#define DEPTH_TARGET 0x01 // Reached by a jump, switch case or empty loop
+#define DEPTH_ENTRY  0x02 // Start of the program or of a subroutine
+#define DEPTH_BUSY   0x04 // DEPTH_LOOPS being computed (recursion guard)
+#define DEPTH_DONE   0x08 // DEPTH_LOOPS is valid
+
+static uint32_t depth_region(const uint8_t* s) {
+    uint32_t r;
+    memcpy(&r, s + DEPTH_REGION, 4);
+    return r;
+}
+
+static bool depth_is_loop(uint8_t op) {
+    return op == OP_ARR_FIXED || op == OP_ARR_PRE_U8 || op == OP_ARR_PRE_U16 ||
+           op == OP_ARR_PRE_U32 || op == OP_ARR_EOF || op == OP_ARR_DYNAMIC;
+}
+
+static bool depth_is_switch(uint8_t op) {
+    return op == OP_SWITCH || op == OP_SWITCH_SORTED || op == OP_SWITCH_TABLE || op == OP_SWITCH_HASH;
+}
+
+// Extension slots following the instruction at `i`
+static size_t depth_ext(const cnd_insn* insns, size_t i) {
+    switch (insns[i].op) {
+        case OP_RANGE_CHECK: case OP_SCALE_LIN: case OP_ENUM_BITMAP: return 1;
+        case OP_SWITCH: case OP_SWITCH_SORTED: return (size_t)insns[i].imm;
+        case OP_SWITCH_TABLE: return 1 + (size_t)insns[i + 1].a;
+        case OP_SWITCH_HASH: return 1 + ((size_t)1 << insns[i].arg);
+        default: return 0;
+    }
+}
+
+// Targets of the instruction at `i` besides insns[i].a: `*n` case slots from `*cases`
+static void depth_cases(const cnd_insn* insns, size_t i, const cnd_insn** cases, size_t* n) {
+    *cases = NULL;
+    *n = 0;
+    switch (insns[i].op) {
+        case OP_SWITCH: case OP_SWITCH_SORTED: *cases = &insns[i + 1]; *n = (size_t)insns[i].imm; break;
+        case OP_SWITCH_TABLE: *cases = &insns[i + 2]; *n = insns[i + 1].a; break;
+        case OP_SWITCH_HASH: *cases = &insns[i + 2]; *n = (size_t)1 << insns[i].arg; break;
+        default: break;
+    }
+}
+
+// A jump from slot `from` to `to` stays in its subroutine at the same loop nesting
+static bool depth_edge(const uint8_t* scratch, size_t count, size_t from, uint32_t to) {
+    if (to == count) return true; // Ends the program
+    const uint8_t* s = scratch + from * VM_DEPTH_SCRATCH;
+    const uint8_t* t = scratch + (size_t)to * VM_DEPTH_SCRATCH;
+    return depth_region(t) == depth_region(s) && t[DEPTH_NEST] == s[DEPTH_NEST];
+}
+
+// Most loops open at once while the subroutine at `entry` runs
+static bool depth_loops(const cnd_insn* insns, size_t count, uint8_t* scratch, size_t entry,
+                        int calls, uint8_t* out)
+{
+    uint8_t* e = scratch + entry * VM_DEPTH_SCRATCH;
+    if (e[DEPTH_FLAGS] & DEPTH_DONE) {
+        *out = e[DEPTH_LOOPS];
+        return true;
+    }
+    // Recursive, or deeper than the call stack allows
+    if ((e[DEPTH_FLAGS] & DEPTH_BUSY) || calls > CND_MAX_CALL_DEPTH) return false;
+    e[DEPTH_FLAGS] |= DEPTH_BUSY;
+
+    uint32_t region = depth_region(e);
+    int most = 0;
+    for (size_t i = entry; i < count; i += 1 + depth_ext(insns, i)) {
+        const uint8_t* s = scratch + i * VM_DEPTH_SCRATCH;
+        if (depth_region(s) != region) break;
+        int nest = s[DEPTH_NEST];
+        if (depth_is_loop(insns[i].op)) {
+            nest++;
+        } else if (insns[i].op == OP_CALL) {
+            uint8_t inner = 0;
+            if (!depth_loops(insns, count, scratch, insns[i].a, calls + 1, &inner)) return false;
+            nest += inner;
         }
+        if (nest > most) most = nest;
+    }
+    if (most > CND_MAX_LOOP_DEPTH) return false;
 
-        // Additional checks for JMP
-        if (opcode == OP_JUMP || opcode == OP_JUMP_IF_NOT) {
-            const uint8_t* ptr = bc + ip + 1;
-            int32_t offset = (int32_t)(ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | (ptr[3] << 24));
-            
-            int64_t target = (int64_t)ip + 5 + offset;
-            if (target < 0 || target >= len) {
-                return CND_ERR_OOB;
-            }
+    e[DEPTH_LOOPS] = (uint8_t)most;
+    e[DEPTH_FLAGS] = (uint8_t)((e[DEPTH_FLAGS] & ~DEPTH_BUSY) | DEPTH_DONE);
+    *out = (uint8_t)most;
+    return true;
+}
+
+bool vm_verify_depths(const cnd_insn* insns, size_t count, uint8_t* scratch,
+                      uint8_t* max_stack, uint8_t* max_loops)
+{
+    if (count == 0) {
+        *max_stack = 0;
+        *max_loops = 0;
+        return true;
+    }
+    memset(scratch, 0, count * VM_DEPTH_SCRATCH);
+
+    // Mark subroutine entries and jump targets
+    scratch[DEPTH_FLAGS] = DEPTH_ENTRY;
+    for (size_t i = 0; i < count; i += 1 + depth_ext(insns, i)) {
+        uint8_t op = insns[i].op;
+        if (op == OP_CALL) {
+            if (insns[i].a >= count) return false;
+            scratch[(size_t)insns[i].a * VM_DEPTH_SCRATCH + DEPTH_FLAGS] |= DEPTH_ENTRY;
+            continue;
         }
+        if (op != OP_JUMP && op != OP_JUMP_IF_NOT && !depth_is_switch(op) && !depth_is_loop(op)) continue;
 
-        ip += instr_len;
+        const cnd_insn* cases;
+        size_t n;
+        depth_cases(insns, i, &cases, &n);
+        if (insns[i].a < count) scratch[(size_t)insns[i].a * VM_DEPTH_SCRATCH + DEPTH_FLAGS] |= DEPTH_TARGET;
+        for (size_t c = 0; c < n; c++) {
+            if (cases[c].a < count) scratch[(size_t)cases[c].a * VM_DEPTH_SCRATCH + DEPTH_FLAGS] |= DEPTH_TARGET;
+        }
     }
 
-    return CND_ERR_OK;
+    // Straight-line pass: stack depth and loop nesting of every instruction
+    uint32_t region = 0;
+    int depth = 0, nest = 0, deepest = 0;
+    bool falls = false;
+    for (size_t i = 0; i < count; i += 1 + depth_ext(insns, i)) {
+        uint8_t* s = scratch + i * VM_DEPTH_SCRATCH;
+        uint8_t op = insns[i].op;
+
+        if (s[DEPTH_FLAGS] & DEPTH_ENTRY) {
+            // Subroutines are only entered through OP_CALL
+            if (falls || nest != 0) return false;
+            region++;
+            depth = 0;
+        } else if (!falls) {
+            depth = 0; // Reached only through jumps, which leave the stack empty
+        }
+        if ((s[DEPTH_FLAGS] & DEPTH_TARGET) && depth != 0) return false;
+        s[DEPTH_NEST] = (uint8_t)nest;
+        memcpy(s + DEPTH_REGION, &region, 4);
+
+        int arity = vm_alu_arity(op);
+        switch (op) {
+            case OP_PUSH_IMM:
+            case OP_LOAD_CTX:
+            case OP_EXPR:
+                depth++;
+                break;
+            case OP_DUP:
+                if (depth < 1) return false;
+                depth++;
+                break;
+            case OP_SWAP:
+                if (depth < 2) return false;
+                break;
+            case OP_POP:
+            case OP_STORE_CTX:
+            case OP_EMIT:
+                if (depth < 1) return false;
+                depth--;
+                break;
+            case OP_JUMP_IF_NOT:
+                if (depth != 1) return false;
+                depth = 0;
+                break;
+            case OP_JUMP:
+            case OP_CALL:
+            case OP_SWITCH: case OP_SWITCH_SORTED: case OP_SWITCH_TABLE: case OP_SWITCH_HASH:
+                if (depth != 0) return false;
+                break;
+            case OP_RET:
+                if (depth != 0 || nest != 0) return false;
+                break;
+            case OP_ARR_FIXED: case OP_ARR_PRE_U8: case OP_ARR_PRE_U16: case OP_ARR_PRE_U32:
+            case OP_ARR_EOF: case OP_ARR_DYNAMIC:
+                if (depth != 0 || ++nest > CND_MAX_LOOP_DEPTH) return false;
+                break;
+            case OP_ARR_END:
+                if (depth != 0 || nest == 0) return false;
+                nest--;
+                break;
+            default:
+                if (arity > 0) {
+                    if (depth < arity) return false;
+                    depth -= arity - 1;
+                }
+                break;
+        }
+        if (depth > CND_MAX_EXPR_STACK) return false;
+        if (depth > deepest) deepest = depth;
+        falls = !(op == OP_JUMP || op == OP_RET || depth_is_switch(op));
+    }
+    if (nest != 0) return false;
+
+    // Jumps must not leave their subroutine or enter or leave a loop body
+    for (size_t i = 0; i < count; i += 1 + depth_ext(insns, i)) {
+        uint8_t op = insns[i].op;
+        if (op != OP_JUMP && op != OP_JUMP_IF_NOT && !depth_is_switch(op) && !depth_is_loop(op)) continue;
+
+        const cnd_insn* cases;
+        size_t n;
+        depth_cases(insns, i, &cases, &n);
+        if (!depth_edge(scratch, count, i, insns[i].a)) return false;
+        for (size_t c = 0; c < n; c++) {
+            if (!depth_edge(scratch, count, i, cases[c].a)) return false;
+        }
+    }
+
+    if (!depth_loops(insns, count, scratch, 0, 0, max_loops)) return false;
+    *max_stack = (uint8_t)deepest;
+    return true;
 }
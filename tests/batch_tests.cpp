@@ -0,0 +1,182 @@
+#include "test_common.h"
+#include <cstddef>
+
+// cnd_execute_batch must give every packet the same result as a fresh
+// cnd_init + cnd_execute, whatever happened to the packets before it.
+
+struct BatchRecord {
+    uint8_t a;
+    uint16_t b;
+};
+
+// Decode stores into records[batch_index]; encode reads from it
+static cnd_error_t batch_io_callback(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    BatchRecord* r = (BatchRecord*)ctx->user_ptr + ctx->batch_index;
+    bool enc = (ctx->mode == CND_MODE_ENCODE);
+    if (type == OP_IO_U8 && key_id == 0) {
+        if (enc) *(uint8_t*)ptr = r->a; else r->a = *(uint8_t*)ptr;
+    } else if (type == OP_IO_U16 && key_id == 1) {
+        if (enc) *(uint16_t*)ptr = r->b; else r->b = *(uint16_t*)ptr;
+    }
+    return CND_ERR_OK;
+}
+
+class BatchTest : public ConcordiaTest {
+protected:
+    void LoadRecordSchema() {
+        CompileAndLoad("packet P { uint8 a; @big_endian uint16 b; }");
+        ASSERT_EQ(cnd_get_key_id(&program, "a"), 0);
+        ASSERT_EQ(cnd_get_key_id(&program, "b"), 1);
+    }
+};
+
+TEST_F(BatchTest, PackedDecodeReportsPerPacketErrors) {
+    LoadRecordSchema();
+
+    // Three packets back to back; the second one is truncated
+    uint8_t packed[] = {1, 0x00, 0x10, 2, 0x00, 3, 0x00, 0x30};
+    size_t offsets[] = {0, 3, 5};
+    size_t lengths[] = {3, 2, 3};
+    BatchRecord out[3] = {};
+
+    cnd_batch batch = {};
+    batch.base = packed;
+    batch.offsets = offsets;
+    batch.lengths = lengths;
+    batch.count = 3;
+
+    cnd_error_t errors[3];
+    size_t used[3];
+    cnd_init(&ctx, CND_MODE_DECODE, &program, NULL, 0, batch_io_callback, out);
+    EXPECT_EQ(cnd_execute_batch(&ctx, &batch, errors, used), CND_ERR_OOB);
+
+    EXPECT_EQ(errors[0], CND_ERR_OK);
+    EXPECT_EQ(errors[1], CND_ERR_OOB);
+    EXPECT_EQ(errors[2], CND_ERR_OK);
+    EXPECT_EQ(used[0], 3u);
+    EXPECT_EQ(used[2], 3u);
+    EXPECT_EQ(out[0].a, 1);
+    EXPECT_EQ(out[0].b, 0x10);
+    EXPECT_EQ(out[2].a, 3);
+    EXPECT_EQ(out[2].b, 0x30); // Unaffected by the failure before it
+}
+
+TEST_F(BatchTest, EncodeIntoSeparateBuffers) {
+    LoadRecordSchema();
+
+    BatchRecord in[3] = {{7, 0x0102}, {8, 0x0304}, {9, 0x0506}};
+    uint8_t bufs[3][4];
+    memset(bufs, 0xEE, sizeof(bufs));
+    uint8_t* ptrs[3] = {bufs[0], NULL, bufs[2]};
+    size_t lengths[] = {4, 4, 4};
+
+    cnd_batch batch = {};
+    batch.buffers = ptrs;
+    batch.lengths = lengths;
+    batch.count = 3;
+
+    cnd_error_t errors[3];
+    size_t used[3];
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, NULL, 0, batch_io_callback, in);
+    EXPECT_EQ(cnd_execute_batch(&ctx, &batch, errors, used), CND_ERR_OOB);
+
+    EXPECT_EQ(errors[0], CND_ERR_OK);
+    EXPECT_EQ(errors[1], CND_ERR_OOB); // Missing buffer
+    EXPECT_EQ(errors[2], CND_ERR_OK);
+    EXPECT_EQ(used[0], 3u);
+    EXPECT_EQ(used[1], 0u);
+    EXPECT_EQ(used[2], 3u);
+    EXPECT_EQ(bufs[0][0], 7);
+    EXPECT_EQ(bufs[0][1], 0x01);
+    EXPECT_EQ(bufs[0][2], 0x02);
+    EXPECT_EQ(bufs[0][3], 0xEE);
+    EXPECT_EQ(bufs[2][0], 9);
+    EXPECT_EQ(bufs[2][2], 0x06);
+
+    // Matches a single run of the same packet
+    uint8_t single[4];
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, single, sizeof(single), batch_io_callback, &in[2]);
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    EXPECT_EQ(memcmp(single, bufs[2], 3), 0);
+}
+
+TEST_F(BatchTest, BoundBatchFillsStructArray) {
+    CompileAndLoad(
+        "struct Pt { int16 x; int16 y; }"
+        "packet P { uint8 id; Pt pts[] prefix uint8; }"
+    );
+    struct HostPt { int16_t x, y; };
+    struct Host { uint8_t id; uint8_t n; HostPt pts[2]; };
+
+    cnd_binding table[8] = {};
+    cnd_binding id = {offsetof(Host, id), 0, 0, 0, OP_IO_U8, 0};
+    cnd_binding pts = {offsetof(Host, pts), sizeof(HostPt), 2, offsetof(Host, n), OP_ENTER_STRUCT, OP_IO_U8};
+    cnd_binding x = {offsetof(HostPt, x), 0, 0, 0, OP_IO_I16, 0};
+    cnd_binding y = {offsetof(HostPt, y), 0, 0, 0, OP_IO_I16, 0};
+    ASSERT_EQ(cnd_binding_set(table, 8, &program, "id", &id), CND_ERR_OK);
+    ASSERT_EQ(cnd_binding_set(table, 8, &program, "pts", &pts), CND_ERR_OK);
+    ASSERT_EQ(cnd_binding_set(table, 8, &program, "pts.x", &x), CND_ERR_OK);
+    ASSERT_EQ(cnd_binding_set(table, 8, &program, "pts.y", &y), CND_ERR_OK);
+
+    uint8_t packed[] = {
+        1, 2, 0x01, 0x00, 0x02, 0x00, 0x03, 0x00, 0x04, 0x00,
+        2, 1, 0xFF, 0xFF, 0x05, 0x00,
+    };
+    size_t offsets[] = {0, 10};
+    size_t lengths[] = {10, 6};
+    cnd_batch batch = {};
+    batch.base = packed;
+    batch.offsets = offsets;
+    batch.lengths = lengths;
+    batch.count = 2;
+    batch.host_stride = sizeof(Host);
+
+    // A guard record after the array catches writes past the last host
+    Host hosts[3];
+    memset(hosts, 0, sizeof(hosts));
+    memset(&hosts[2], 0xAB, sizeof(Host));
+    Host guard = hosts[2];
+    cnd_binder binder;
+    cnd_binder_init(&binder, table, 8, &hosts[0]);
+    cnd_init(&ctx, CND_MODE_DECODE, &program, NULL, 0, cnd_bind_io, &binder);
+    ASSERT_EQ(cnd_execute_batch(&ctx, &batch, NULL, NULL), CND_ERR_OK);
+    EXPECT_EQ(ctx.batch_index, 0u);
+
+    // The binder is rewound, so a second batch lands on the same records
+    Host second = hosts[1];
+    memset(&hosts[0], 0, sizeof(Host));
+    ASSERT_EQ(cnd_execute_batch(&ctx, &batch, NULL, NULL), CND_ERR_OK);
+    EXPECT_EQ(memcmp(&hosts[1], &second, sizeof(Host)), 0);
+    EXPECT_EQ(memcmp(&hosts[2], &guard, sizeof(Host)), 0);
+
+    EXPECT_EQ(hosts[0].id, 1);
+    EXPECT_EQ(hosts[0].n, 2);
+    EXPECT_EQ(hosts[0].pts[1].x, 3);
+    EXPECT_EQ(hosts[0].pts[1].y, 4);
+    EXPECT_EQ(hosts[1].id, 2);
+    EXPECT_EQ(hosts[1].n, 1);
+    EXPECT_EQ(hosts[1].pts[0].x, -1);
+    EXPECT_EQ(hosts[1].pts[0].y, 5);
+}
+
+TEST_F(BatchTest, RejectsIncompleteDescriptors) {
+    LoadRecordSchema();
+    BatchRecord out[1] = {};
+    uint8_t packed[3] = {0};
+    size_t lengths[] = {3};
+    cnd_init(&ctx, CND_MODE_DECODE, &program, NULL, 0, batch_io_callback, out);
+
+    cnd_batch batch = {};
+    batch.base = packed;
+    batch.lengths = lengths;
+    batch.count = 1;
+    EXPECT_EQ(cnd_execute_batch(&ctx, &batch, NULL, NULL), CND_ERR_OOB); // No offsets
+
+    batch.base = NULL;
+    EXPECT_EQ(cnd_execute_batch(&ctx, &batch, NULL, NULL), CND_ERR_OOB); // No buffers
+
+    batch.count = 0;
+    uint8_t* none[1] = {NULL};
+    batch.buffers = none;
+    EXPECT_EQ(cnd_execute_batch(&ctx, &batch, NULL, NULL), CND_ERR_OK); // Empty batch
+}
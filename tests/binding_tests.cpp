@@ -0,0 +1,373 @@
+#include "test_common.h"
+#include <cstddef>
+
+// Binding tables map Key IDs straight onto host structs. Each test binds a C
+// struct, encodes it, decodes into a fresh copy and checks the wire bytes.
+
+struct BindPoint {
+    int16_t a;
+    uint8_t b;
+};
+
+struct BindHost {
+    uint8_t version;
+    uint16_t be_val;
+    int32_t temp;
+    struct { float x; float y; } pos;
+    uint8_t n_pts;
+    BindPoint pts[4];
+    uint8_t raw[4];
+    char name[8];
+    char tag[8];
+};
+
+#define BIND_TABLE_SIZE 64
+
+class BindingTest : public ConcordiaTest {
+protected:
+    cnd_binding table[BIND_TABLE_SIZE];
+    cnd_binder binder;
+
+    void SetUp() override {
+        ConcordiaTest::SetUp();
+        memset(table, 0, sizeof(table));
+    }
+
+    void Bind(const char* name, uint8_t type, uint32_t offset, uint32_t stride = 0, uint32_t capacity = 0,
+              uint8_t count_type = 0, uint32_t count_offset = 0) {
+        cnd_binding e = {offset, stride, capacity, count_offset, type, count_type};
+        ASSERT_EQ(cnd_binding_set(table, BIND_TABLE_SIZE, &program, name, &e), CND_ERR_OK) << name;
+    }
+
+    cnd_error_t Run(cnd_mode_t mode, cnd_dispatch_t dispatch, void* host, uint8_t* buf, size_t len) {
+        cnd_binder_init(&binder, table, BIND_TABLE_SIZE, host);
+        cnd_init(&ctx, mode, &program, buf, len, cnd_bind_io, &binder);
+        return cnd_execute_dispatch(&ctx, dispatch);
+    }
+
+    void LoadHostSchema() {
+        CompileAndLoad(
+            "struct Vec { float x; float y; }"
+            "struct Pt { int16 a; uint8 b; }"
+            "packet P {"
+            "  uint8 version;"
+            "  @big_endian uint16 be_val;"
+            "  @little_endian int32 temp;"
+            "  Vec pos;"
+            "  Pt pts[] prefix uint8;"
+            "  uint8 raw[4];"
+            "  string name prefix uint8;"
+            "  string tag until 0x00 max 8;"
+            "}"
+        );
+        Bind("version", OP_IO_U8, offsetof(BindHost, version));
+        Bind("be_val", OP_IO_U16, offsetof(BindHost, be_val));
+        Bind("temp", OP_IO_I32, offsetof(BindHost, temp));
+        Bind("pos", OP_ENTER_STRUCT, offsetof(BindHost, pos));
+        Bind("pos.x", OP_IO_F32, 0);
+        Bind("pos.y", OP_IO_F32, sizeof(float));
+        Bind("pts", OP_ENTER_STRUCT, offsetof(BindHost, pts), sizeof(BindPoint), 4,
+             OP_IO_U8, offsetof(BindHost, n_pts));
+        Bind("pts.a", OP_IO_I16, offsetof(BindPoint, a));
+        Bind("pts.b", OP_IO_U8, offsetof(BindPoint, b));
+        Bind("raw", OP_IO_U8, offsetof(BindHost, raw), 1, 4);
+        Bind("name", OP_STR_NULL, offsetof(BindHost, name), 0, sizeof(((BindHost*)0)->name));
+        Bind("tag", OP_STR_NULL, offsetof(BindHost, tag), 0, sizeof(((BindHost*)0)->tag));
+    }
+
+    static BindHost SampleHost() {
+        BindHost h;
+        memset(&h, 0, sizeof(h));
+        h.version = 7;
+        h.be_val = 0x1234;
+        h.temp = -40;
+        h.pos.x = 1.5f;
+        h.pos.y = -2.25f;
+        h.n_pts = 2;
+        h.pts[0].a = -3; h.pts[0].b = 9;
+        h.pts[1].a = 300; h.pts[1].b = 0xAB;
+        h.raw[0] = 0xDE; h.raw[1] = 0xAD; h.raw[2] = 0xBE; h.raw[3] = 0xEF;
+        strcpy(h.name, "abc");
+        strcpy(h.tag, "xy");
+        return h;
+    }
+};
+
+TEST_F(BindingTest, RoundTripsHostStruct) {
+    LoadHostSchema();
+    BindHost in = SampleHost();
+    uint8_t buf[64] = {0};
+
+    ASSERT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_AUTO, &in, buf, sizeof(buf)), CND_ERR_OK);
+    size_t len = ctx.cursor;
+    EXPECT_EQ(len, 1u + 2 + 4 + 8 + 1 + 2 * 3 + 4 + 4 + 3);
+    EXPECT_EQ(buf[0], 7);
+    EXPECT_EQ(buf[1], 0x12); // big endian
+    EXPECT_EQ(buf[2], 0x34);
+    EXPECT_EQ(buf[15], 2);   // pts count
+
+    BindHost out;
+    memset(&out, 0xCC, sizeof(out));
+    ASSERT_EQ(Run(CND_MODE_DECODE, CND_DISPATCH_AUTO, &out, buf, len), CND_ERR_OK);
+    EXPECT_EQ(ctx.cursor, len);
+    EXPECT_EQ(binder.depth, 1);
+    EXPECT_EQ(out.version, in.version);
+    EXPECT_EQ(out.be_val, in.be_val);
+    EXPECT_EQ(out.temp, in.temp);
+    EXPECT_EQ(out.pos.x, in.pos.x);
+    EXPECT_EQ(out.pos.y, in.pos.y);
+    EXPECT_EQ(out.n_pts, 2);
+    EXPECT_EQ(out.pts[0].a, -3);
+    EXPECT_EQ(out.pts[0].b, 9);
+    EXPECT_EQ(out.pts[1].a, 300);
+    EXPECT_EQ(out.pts[1].b, 0xAB);
+    EXPECT_EQ(0, memcmp(out.raw, in.raw, sizeof(in.raw)));
+    EXPECT_STREQ(out.name, "abc");
+    EXPECT_STREQ(out.tag, "xy");
+}
+
+TEST_F(BindingTest, MatchesCallbackEncoding) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 a; @big_endian int16 b; uint32 c; double d;"
+        "  @big_endian float e; @little_endian uint64 f;"
+        "}"
+    );
+    struct { uint8_t a; int16_t b; uint32_t c; double d; float e; uint64_t f; } in = {
+        0x11, -2, 0xA1B2C3D4, 3.25, -0.5f, 0x0102030405060708ULL
+    };
+    Bind("a", OP_IO_U8, offsetof(decltype(in), a));
+    Bind("b", OP_IO_I16, offsetof(decltype(in), b));
+    Bind("c", OP_IO_U32, offsetof(decltype(in), c));
+    Bind("d", OP_IO_F64, offsetof(decltype(in), d));
+    Bind("e", OP_IO_F32, offsetof(decltype(in), e));
+    Bind("f", OP_IO_U64, offsetof(decltype(in), f));
+
+    uint8_t bound[32] = {0};
+    ASSERT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_AUTO, &in, bound, sizeof(bound)), CND_ERR_OK);
+    size_t len = ctx.cursor;
+
+    g_test_data[0] = test_data_entry(cnd_get_key_id(&program, "a"), in.a);
+    g_test_data[1] = test_data_entry(cnd_get_key_id(&program, "b"), (uint64_t)(int64_t)in.b);
+    g_test_data[2] = test_data_entry(cnd_get_key_id(&program, "c"), in.c);
+    g_test_data[3] = test_data_entry(cnd_get_key_id(&program, "d"), 0, in.d);
+    g_test_data[4] = test_data_entry(cnd_get_key_id(&program, "e"), 0, in.e);
+    g_test_data[5] = test_data_entry(cnd_get_key_id(&program, "f"), in.f);
+
+    uint8_t ref[32] = {0};
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, ref, sizeof(ref), test_io_callback, NULL);
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    EXPECT_EQ(ctx.cursor, len);
+    EXPECT_EQ(0, memcmp(ref, bound, sizeof(ref)));
+}
+
+TEST_F(BindingTest, EveryLoopAgrees) {
+    LoadHostSchema();
+    BindHost in = SampleHost();
+    uint8_t ref[64] = {0};
+    ASSERT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_SWITCH, &in, ref, sizeof(ref)), CND_ERR_OK);
+    size_t len = ctx.cursor;
+
+    const cnd_dispatch_t modes[] = {CND_DISPATCH_THREADED, CND_DISPATCH_AUTO};
+    for (cnd_dispatch_t d : modes) {
+        uint8_t got[64] = {0};
+        cnd_error_t err = Run(CND_MODE_ENCODE, d, &in, got, sizeof(got));
+        if (err == CND_ERR_INVALID_OP) continue; // threaded loops not compiled in
+        ASSERT_EQ(err, CND_ERR_OK);
+        EXPECT_EQ(ctx.cursor, len);
+        EXPECT_EQ(0, memcmp(ref, got, sizeof(ref)));
+    }
+
+    // The generic callback path (prepared programs) serves the same table
+    size_t cap = 0;
+    ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+    std::vector<cnd_insn> insns(cap);
+    cnd_prepared prepared;
+    ASSERT_EQ(cnd_program_prepare(&prepared, &program, insns.data(), cap), CND_ERR_OK);
+
+    BindHost out;
+    memset(&out, 0, sizeof(out));
+    cnd_binder_init(&binder, table, BIND_TABLE_SIZE, &out);
+    cnd_init(&ctx, CND_MODE_DECODE, &program, ref, len, cnd_bind_io, &binder);
+    ASSERT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OK);
+    EXPECT_EQ(out.temp, in.temp);
+    EXPECT_EQ(out.pts[1].a, in.pts[1].a);
+    EXPECT_STREQ(out.name, in.name);
+}
+
+TEST_F(BindingTest, ConvertsBitfieldsAndTransforms) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 flag : 1;"
+        "  uint8 mode : 3;"
+        "  @scale(0.5) uint8 scaled;"
+        "}"
+    );
+    struct { bool flag; uint8_t mode; double scaled; } in = {true, 5, 21.5}, out = {false, 0, 0.0};
+    Bind("flag", OP_IO_BOOL, offsetof(decltype(in), flag));
+    Bind("mode", OP_IO_U8, offsetof(decltype(in), mode));
+    Bind("scaled", OP_IO_F64, offsetof(decltype(in), scaled));
+
+    uint8_t buf[8] = {0};
+    ASSERT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_AUTO, &in, buf, sizeof(buf)), CND_ERR_OK);
+    EXPECT_EQ(buf[0], 0x01 | (5 << 1));
+    EXPECT_EQ(buf[1], 43);
+
+    ASSERT_EQ(Run(CND_MODE_DECODE, CND_DISPATCH_AUTO, &out, buf, ctx.cursor), CND_ERR_OK);
+    EXPECT_TRUE(out.flag);
+    EXPECT_EQ(out.mode, 5);
+    EXPECT_DOUBLE_EQ(out.scaled, 21.5);
+}
+
+TEST_F(BindingTest, SwitchReadsDiscriminatorFromHost) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 kind;"
+        "  switch (kind) {"
+        "    case 1: uint16 one;"
+        "    case 2: uint32 two;"
+        "  }"
+        "}"
+    );
+    struct { uint8_t kind; uint16_t one; uint32_t two; } in = {2, 0, 0xCAFEBABE}, out = {0, 0, 0};
+    Bind("kind", OP_IO_U8, offsetof(decltype(in), kind));
+    Bind("one", OP_IO_U16, offsetof(decltype(in), one));
+    Bind("two", OP_IO_U32, offsetof(decltype(in), two));
+
+    uint8_t buf[8] = {0};
+    ASSERT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_AUTO, &in, buf, sizeof(buf)), CND_ERR_OK);
+    EXPECT_EQ(ctx.cursor, 5u);
+    ASSERT_EQ(Run(CND_MODE_DECODE, CND_DISPATCH_AUTO, &out, buf, ctx.cursor), CND_ERR_OK);
+    EXPECT_EQ(out.kind, 2);
+    EXPECT_EQ(out.two, 0xCAFEBABEu);
+}
+
+TEST_F(BindingTest, RejectsOverCapacityAndUnboundFields) {
+    LoadHostSchema();
+    BindHost in = SampleHost();
+    uint8_t buf[64] = {0};
+
+    // Binder errors surface like any other callback failure
+    in.n_pts = 5;
+    EXPECT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_AUTO, &in, buf, sizeof(buf)), CND_ERR_CALLBACK);
+
+    // A wire count beyond the host array is rejected on decode as well
+    in.n_pts = 2;
+    ASSERT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_AUTO, &in, buf, sizeof(buf)), CND_ERR_OK);
+    size_t len = ctx.cursor;
+    buf[15] = 9;
+    BindHost out;
+    EXPECT_EQ(Run(CND_MODE_DECODE, CND_DISPATCH_AUTO, &out, buf, len), CND_ERR_CALLBACK);
+
+    // Unterminated host strings would make the VM read past the buffer
+    in = SampleHost();
+    memset(in.name, 'z', sizeof(in.name));
+    EXPECT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_AUTO, &in, buf, sizeof(buf)), CND_ERR_CALLBACK);
+
+    in = SampleHost();
+    table[cnd_get_key_id(&program, "temp")].type = 0;
+    EXPECT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_AUTO, &in, buf, sizeof(buf)), CND_ERR_CALLBACK);
+
+    cnd_binding e = {0, 0, 0, 0, OP_IO_U8, 0};
+    EXPECT_EQ(cnd_binding_set(table, BIND_TABLE_SIZE, &program, "missing", &e), CND_ERR_VALIDATION);
+}
+
+TEST_F(BindingTest, PrimitiveArraysBindAsSpans) {
+    CompileAndLoad(
+        "packet P {"
+        "  @big_endian int16 samples[300];"
+        "  @big_endian int32 vals[] prefix uint8;"
+        "  @scale(0.01) @big_endian int16 volts[4];"
+        "  uint8 tail;"
+        "}"
+    );
+    struct Host {
+        int16_t samples[300];
+        uint8_t n_vals;
+        int64_t vals[8]; // Widened from the wire type
+        double volts[4];
+        uint8_t tail;
+    };
+    Bind("samples", OP_IO_I16, offsetof(Host, samples), sizeof(int16_t), 300);
+    Bind("vals", OP_IO_I64, offsetof(Host, vals), sizeof(int64_t), 8, OP_IO_U8, offsetof(Host, n_vals));
+    Bind("volts", OP_IO_F64, offsetof(Host, volts), sizeof(double), 4);
+    Bind("tail", OP_IO_U8, offsetof(Host, tail));
+
+    static Host in, out;
+    memset(&in, 0, sizeof(in));
+    for (int i = 0; i < 300; i++) in.samples[i] = (int16_t)(i * 97 - 15000);
+    in.n_vals = 3;
+    in.vals[0] = -5;
+    in.vals[1] = 70000;
+    in.vals[2] = -2147483647;
+    for (int i = 0; i < 4; i++) in.volts[i] = 1.25 * i - 3;
+    in.tail = 0x5A;
+
+    uint8_t buf[640] = {0};
+    ASSERT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_AUTO, &in, buf, sizeof(buf)), CND_ERR_OK);
+    ASSERT_EQ(ctx.cursor, 600u + 1 + 12 + 8 + 1);
+    size_t len = ctx.cursor;
+    EXPECT_EQ(buf[0], 0xC5); // -15000, big endian
+    EXPECT_EQ(buf[1], 0x68);
+    EXPECT_EQ(buf[601], 0xFF); // vals[0] = -5
+    EXPECT_EQ(buf[604], 0xFB);
+    EXPECT_EQ(buf[613], 0xFE); // volts[0] raw = -300
+    EXPECT_EQ(buf[614], 0xD4);
+    EXPECT_EQ(buf[len - 1], 0x5A);
+
+    for (cnd_dispatch_t d : {CND_DISPATCH_SWITCH, CND_DISPATCH_AUTO}) {
+        memset(&out, 0, sizeof(out));
+        ASSERT_EQ(Run(CND_MODE_DECODE, d, &out, buf, len), CND_ERR_OK);
+        EXPECT_EQ(memcmp(out.samples, in.samples, sizeof(in.samples)), 0);
+        EXPECT_EQ(out.n_vals, 3);
+        EXPECT_EQ(out.vals[1], 70000);
+        EXPECT_EQ(out.vals[2], -2147483647);
+        for (int i = 0; i < 4; i++) EXPECT_DOUBLE_EQ(out.volts[i], in.volts[i]);
+        EXPECT_EQ(out.tail, 0x5A);
+        EXPECT_EQ(binder.depth, 1);
+    }
+}
+
+TEST_F(BindingTest, FusedFieldsBind) {
+    // Under -O the fields fuse into one OP_IO_RUN and an OP_IO_CHECK
+    struct Host { uint8_t a; uint16_t b; int32_t c; float d; double e; uint8_t level; };
+    const char* schema = "packet P { uint8 a; uint16 b; int32 c; float d; double e; @range(1, 100) uint8 level; }";
+    Host in = {0x11, 0x2233, -70000, 2.5f, -0.125, 42};
+
+    uint8_t ref[32] = {0};
+    size_t len = 0;
+    for (int opt_level : {0, 1}) {
+        CompileAndLoad(schema, opt_level);
+        Bind("a", OP_IO_U8, offsetof(Host, a));
+        Bind("b", OP_IO_U16, offsetof(Host, b));
+        Bind("c", OP_IO_I32, offsetof(Host, c));
+        Bind("d", OP_IO_F32, offsetof(Host, d));
+        Bind("e", OP_IO_F64, offsetof(Host, e));
+        Bind("level", OP_IO_U8, offsetof(Host, level));
+        if (opt_level == 0) {
+            ASSERT_EQ(Run(CND_MODE_ENCODE, CND_DISPATCH_SWITCH, &in, ref, sizeof(ref)), CND_ERR_OK);
+            len = ctx.cursor;
+            continue;
+        }
+        EXPECT_EQ(program.bytecode[3], OP_IO_RUN);
+
+        for (cnd_dispatch_t d : {CND_DISPATCH_SWITCH, CND_DISPATCH_THREADED}) {
+            uint8_t got[32] = {0};
+            cnd_error_t err = Run(CND_MODE_ENCODE, d, &in, got, sizeof(got));
+            if (err == CND_ERR_INVALID_OP) continue; // threaded loops not compiled in
+            ASSERT_EQ(err, CND_ERR_OK);
+            EXPECT_EQ(ctx.cursor, len);
+            EXPECT_EQ(0, memcmp(ref, got, sizeof(ref)));
+
+            Host out;
+            memset(&out, 0, sizeof(out));
+            ASSERT_EQ(Run(CND_MODE_DECODE, d, &out, got, len), CND_ERR_OK);
+            EXPECT_EQ(out.c, in.c);
+            EXPECT_EQ(out.e, in.e);
+            EXPECT_EQ(out.level, in.level);
+
+            got[len - 1] = 0;
+            EXPECT_EQ(Run(CND_MODE_DECODE, d, &out, got, len), CND_ERR_VALIDATION);
+        }
+    }
+}
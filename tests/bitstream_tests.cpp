@@ -0,0 +1,374 @@
+#include "test_common.h"
+#include "../src/vm/vm_internal.h"
+
+// The word-at-a-time bit reader and writer must match the bit-by-bit path for
+// every bit offset, width and bit order, including fields that span 9 bytes.
+
+class BitStreamTest : public ConcordiaTest {};
+
+static cnd_vm_ctx bit_ctx(uint8_t* buf, size_t len, size_t bit, cnd_endian_t endian) {
+    cnd_vm_ctx c;
+    memset(&c, 0, sizeof(c));
+    c.data_buffer = buf;
+    c.data_len = len;
+    c.cursor = bit / 8;
+    c.bit_offset = (uint8_t)(bit % 8);
+    c.endianness = endian;
+    return c;
+}
+
+static uint64_t bit_pattern(uint64_t seed) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed ^ (seed >> 29);
+}
+
+TEST_F(BitStreamTest, MatchesBitwiseReference) {
+    const cnd_endian_t orders[] = {CND_LE, CND_BE};
+    uint8_t src[24];
+    for (size_t i = 0; i < sizeof(src); i++) src[i] = (uint8_t)bit_pattern(i);
+
+    for (cnd_endian_t order : orders) {
+        for (size_t bit = 0; bit < 16; bit++) {
+            for (uint8_t width = 1; width <= 64; width++) {
+                // Reads
+                cnd_vm_ctx a = bit_ctx(src, sizeof(src), bit, order);
+                cnd_vm_ctx b = bit_ctx(src, sizeof(src), bit, order);
+                ASSERT_EQ(read_bits(&a, width), read_bits_tail(&b, width)) << bit << "+" << (int)width;
+                ASSERT_EQ(a.cursor, b.cursor);
+                ASSERT_EQ(a.bit_offset, b.bit_offset);
+
+                // Writes leave the neighbouring bits alone
+                uint8_t fast[24], slow[24];
+                memcpy(fast, src, sizeof(src));
+                memcpy(slow, src, sizeof(src));
+                uint64_t v = bit_pattern(bit * 64 + width);
+                a = bit_ctx(fast, sizeof(fast), bit, order);
+                b = bit_ctx(slow, sizeof(slow), bit, order);
+                write_bits(&a, v, width);
+                write_bits_tail(&b, v, width);
+                ASSERT_EQ(memcmp(fast, slow, sizeof(fast)), 0) << bit << "+" << (int)width;
+                ASSERT_EQ(a.cursor, b.cursor);
+                ASSERT_EQ(a.bit_offset, b.bit_offset);
+            }
+        }
+    }
+}
+
+TEST_F(BitStreamTest, FieldsAtTheEndOfTheBuffer) {
+    // Short buffers load and store only the bytes they have
+    const cnd_endian_t orders[] = {CND_LE, CND_BE};
+    for (cnd_endian_t order : orders) {
+        for (size_t len = 1; len <= 9; len++) {
+            for (size_t bit = 0; bit < len * 8; bit++) {
+                uint8_t width = (uint8_t)((len * 8 - bit) > 64 ? 64 : len * 8 - bit);
+                // 8 bytes of slack past the longest len: the window path only
+                // runs with 8 bytes left, but GCC cannot prove that once inlined
+                uint8_t buf[9 + 8], ref[9 + 8];
+                for (size_t i = 0; i < sizeof(buf); i++) buf[i] = ref[i] = (uint8_t)bit_pattern(i + len);
+                cnd_vm_ctx a = bit_ctx(buf, len, bit, order);
+                cnd_vm_ctx b = bit_ctx(ref, len, bit, order);
+                ASSERT_EQ(read_bits(&a, width), read_bits_tail(&b, width));
+
+                a = bit_ctx(buf, len, bit, order);
+                b = bit_ctx(ref, len, bit, order);
+                write_bits(&a, ~(uint64_t)0, width);
+                write_bits_tail(&b, ~(uint64_t)0, width);
+                ASSERT_EQ(memcmp(buf, ref, sizeof(buf)), 0) << len << " " << bit;
+                ASSERT_EQ(a.cursor, b.cursor);
+            }
+        }
+    }
+}
+
+// Bitfield values by Key ID
+static cnd_error_t bit_values_io(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    uint64_t* values = (uint64_t*)ctx->user_ptr;
+    if (type != OP_IO_BIT_U || key_id >= 32) return CND_ERR_OK;
+    if (ctx->mode == CND_MODE_ENCODE) *(uint64_t*)ptr = values[key_id];
+    else values[key_id] = *(uint64_t*)ptr;
+    return CND_ERR_OK;
+}
+
+TEST_F(BitStreamTest, StatusWordRoundTrip) {
+    CompileAndLoad(
+        "@unaligned_bytes struct Status {"
+        "  uint8 f0:1; uint8 f1:3; uint8 f2:5; uint8 f3:2; uint8 f4:1; uint8 f5:4;"
+        "  @le uint16 f6:11; uint8 f7:1; uint8 f8:5; @le uint8 f9:3; uint8 f10:4;"
+        "}"
+        "packet P { Status s; }"
+    );
+    const char* names[] = {"s.f0", "s.f1", "s.f2", "s.f3", "s.f4", "s.f5", "s.f6", "s.f7", "s.f8", "s.f9", "s.f10"};
+    const uint64_t expected[] = {1, 5, 17, 2, 0, 9, 1234, 1, 30, 6, 11};
+    uint64_t in[32] = {0}, out[32] = {0};
+    uint16_t keys[11];
+    for (int i = 0; i < 11; i++) {
+        keys[i] = cnd_get_key_id(&program, names[i]);
+        ASSERT_LT(keys[i], 32) << names[i];
+        in[keys[i]] = expected[i];
+    }
+
+    uint8_t buf[8] = {0};
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), bit_values_io, in);
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    EXPECT_EQ(ctx.cursor, 5u);
+
+    cnd_init(&ctx, CND_MODE_DECODE, &program, buf, 5, bit_values_io, out);
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    for (int i = 0; i < 11; i++) EXPECT_EQ(out[keys[i]], expected[i]) << names[i];
+}
+
+// --- Bit Groups ---
+
+// The same program with every OP_IO_BIT_GROUP split back into single
+// bitfield instructions (group entries have their exact shape)
+static std::vector<uint8_t> ungroup_bitfields(const cnd_program* prog) {
+    std::vector<uint8_t> out;
+    const uint8_t* bc = prog->bytecode;
+    size_t ip = 0;
+    while (ip < prog->bytecode_len) {
+        size_t n = 0;
+        EXPECT_EQ(vm_insn_length(bc, prog->bytecode_len, ip, &n), CND_ERR_OK);
+        if (n == 0) break;
+        if (bc[ip] == OP_IO_BIT_GROUP) out.insert(out.end(), bc + ip + 2, bc + ip + n);
+        else out.insert(out.end(), bc + ip, bc + ip + n);
+        ip += n;
+    }
+    return out;
+}
+
+static size_t count_groups(const cnd_program* prog) {
+    size_t groups = 0, ip = 0, n = 0;
+    while (ip < prog->bytecode_len && vm_insn_length(prog->bytecode, prog->bytecode_len, ip, &n) == CND_ERR_OK) {
+        if (prog->bytecode[ip] == OP_IO_BIT_GROUP) groups++;
+        ip += n;
+    }
+    return groups;
+}
+
+// Bitfield values by Key ID, for all bitfield types. Counts the events seen.
+struct GroupValues {
+    uint64_t v[32];
+    int field_events;
+    int group_events;
+    bool decline_groups;
+    uint8_t last_bits;
+};
+
+static cnd_error_t group_values_io(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    GroupValues* g = (GroupValues*)ctx->user_ptr;
+    bool enc = ctx->mode == CND_MODE_ENCODE;
+    if (type == OP_IO_BIT_GROUP) {
+        if (g->decline_groups) return CND_ERR_CALLBACK;
+        cnd_bit_group* grp = (cnd_bit_group*)ptr;
+        EXPECT_EQ(il_get_u16(grp->fields + 1), key_id);
+        for (uint8_t i = 0; i < grp->count; i++) {
+            uint16_t k = il_get_u16(grp->fields + i * 4 + 1);
+            if (enc) grp->values[i] = g->v[k];
+            else g->v[k] = grp->values[i];
+        }
+        g->group_events++;
+        g->last_bits = grp->bits;
+        return CND_ERR_OK;
+    }
+    if (key_id >= 32) return CND_ERR_OK;
+    if (type == OP_IO_BIT_U || type == OP_IO_BIT_I) {
+        if (enc) memcpy(ptr, &g->v[key_id], 8);
+        else memcpy(&g->v[key_id], ptr, 8);
+        g->field_events++;
+    } else if (type == OP_IO_BIT_BOOL) {
+        if (enc) *(uint8_t*)ptr = (uint8_t)g->v[key_id];
+        else g->v[key_id] = *(uint8_t*)ptr;
+        g->field_events++;
+    }
+    return CND_ERR_OK;
+}
+
+static const char* kGroupSchemaLE =
+    "packet P {"
+    "  uint8 a:3; int8 b:5; bool c:1; uint16 d:11; uint8 e:4; uint32 f:30;"
+    "  uint32 g:30; int8 h:4; uint8 tail;"
+    "}";
+static const char* kGroupSchemaBE =
+    "@unaligned_bytes struct S {"
+    "  uint8 a:3; int8 b:5; bool c:1; uint16 d:11; uint8 e:4; uint32 f:30;"
+    "  uint32 g:30; int8 h:4;"
+    "}"
+    "packet P { S s; uint8 tail; }";
+
+class BitGroupTest : public BitStreamTest {
+protected:
+    uint16_t keys[9];
+    uint64_t expected[9];
+
+    void Load(const char* schema, const char* prefix) {
+        CompileAndLoad(schema);
+        const char* names[] = {"a", "b", "c", "d", "e", "f", "g", "h", "tail"};
+        const int64_t vals[] = {5, -9, 1, 1500, 9, 0x2345678, 0x3FFFFFFF, -2, 0xA5};
+        for (int i = 0; i < 9; i++) {
+            std::string name = (i < 8 ? std::string(prefix) : std::string()) + names[i];
+            keys[i] = cnd_get_key_id(&program, name.c_str());
+            ASSERT_LT(keys[i], 32) << name;
+            expected[i] = (uint64_t)vals[i];
+        }
+    }
+
+    GroupValues Inputs() {
+        GroupValues g;
+        memset(&g, 0, sizeof(g));
+        for (int i = 0; i < 8; i++) g.v[keys[i]] = expected[i];
+        return g;
+    }
+};
+
+TEST_F(BitGroupTest, MatchesSingleInstructions) {
+    const char* schemas[] = {kGroupSchemaLE, kGroupSchemaBE};
+    const char* prefixes[] = {"", "s."};
+    for (int s = 0; s < 2; s++) {
+        Load(schemas[s], prefixes[s]);
+        // 88 bits of adjacent bitfields: a..f (54 bits) and g..h
+        EXPECT_EQ(count_groups(&program), 2u);
+
+        std::vector<uint8_t> singles = ungroup_bitfields(&program);
+        cnd_program reference = program;
+        reference.bytecode = singles.data();
+        reference.bytecode_len = singles.size();
+        reference.layout = NULL;
+        reference.layout_count = 0;
+
+        uint8_t grouped[16] = {0}, single[16] = {0};
+        GroupValues in = Inputs();
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, grouped, sizeof(grouped), group_values_io, &in);
+        ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        EXPECT_EQ(ctx.cursor, 12u);
+        EXPECT_EQ(in.field_events, 8);
+        in = Inputs();
+        cnd_init(&ctx, CND_MODE_ENCODE, &reference, single, sizeof(single), group_values_io, &in);
+        ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        EXPECT_EQ(memcmp(grouped, single, sizeof(grouped)), 0) << s;
+
+        // Interpreted and prepared decodes deliver the same values
+        size_t cap = 0;
+        ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+        std::vector<cnd_insn> storage(cap);
+        cnd_prepared prepared;
+        ASSERT_EQ(cnd_program_prepare(&prepared, &program, storage.data(), cap), CND_ERR_OK);
+        for (int prep = 0; prep < 2; prep++) {
+            GroupValues out;
+            memset(&out, 0, sizeof(out));
+            cnd_init(&ctx, CND_MODE_DECODE, &program, grouped, 12, group_values_io, &out);
+            ASSERT_EQ(prep ? cnd_execute_prepared(&ctx, &prepared) : cnd_execute(&ctx), CND_ERR_OK);
+            EXPECT_EQ(ctx.cursor, 12u);
+            for (int i = 0; i < 8; i++) EXPECT_EQ(out.v[keys[i]], expected[i]) << s << " " << i;
+        }
+    }
+}
+
+TEST_F(BitGroupTest, GroupEvents) {
+    Load(kGroupSchemaLE, "");
+    uint8_t buf[16] = {0}, ref[16] = {0};
+    GroupValues in = Inputs();
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, ref, sizeof(ref), group_values_io, &in);
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+
+    // One event per group, on encode and decode
+    in = Inputs();
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), group_values_io, &in);
+    ctx.flags |= CND_CTX_BIT_GROUPS;
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    EXPECT_EQ(in.group_events, 2);
+    EXPECT_EQ(in.field_events, 0);
+    EXPECT_EQ(memcmp(buf, ref, sizeof(buf)), 0);
+
+    GroupValues out;
+    memset(&out, 0, sizeof(out));
+    cnd_init(&ctx, CND_MODE_DECODE, &program, buf, 12, group_values_io, &out);
+    ctx.flags |= CND_CTX_BIT_GROUPS;
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    EXPECT_EQ(out.group_events, 2);
+    EXPECT_EQ(out.field_events, 0);
+    EXPECT_EQ(out.last_bits, 34);
+    for (int i = 0; i < 8; i++) EXPECT_EQ(out.v[keys[i]], expected[i]) << i;
+
+    // Declined group events fall back to per-field events
+    memset(&out, 0, sizeof(out));
+    out.decline_groups = true;
+    cnd_init(&ctx, CND_MODE_DECODE, &program, buf, 12, group_values_io, &out);
+    ctx.flags |= CND_CTX_BIT_GROUPS;
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    EXPECT_EQ(out.field_events, 8);
+    for (int i = 0; i < 8; i++) EXPECT_EQ(out.v[keys[i]], expected[i]) << i;
+
+    memset(buf, 0, sizeof(buf));
+    in = Inputs();
+    in.decline_groups = true;
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), group_values_io, &in);
+    ctx.flags |= CND_CTX_BIT_GROUPS;
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    EXPECT_EQ(memcmp(buf, ref, sizeof(buf)), 0);
+
+    // Booleans are still validated
+    in = Inputs();
+    in.v[keys[2]] = 2;
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), group_values_io, &in);
+    ctx.flags |= CND_CTX_BIT_GROUPS;
+    EXPECT_EQ(cnd_execute(&ctx), CND_ERR_VALIDATION);
+}
+
+TEST_F(BitGroupTest, ShortBufferAndFieldAccess) {
+    Load(kGroupSchemaBE, "s.");
+    uint8_t buf[16] = {0};
+    GroupValues in = Inputs();
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), group_values_io, &in);
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+
+    // Grouped fields are found through the layout table and by scanning
+    cnd_program scan = program;
+    scan.layout = NULL;
+    scan.layout_count = 0;
+    const cnd_program* progs[] = {&program, &scan};
+    for (const cnd_program* prog : progs) {
+        for (int i = 0; i < 8; i++) {
+            uint64_t v = 0;
+            ASSERT_EQ(cnd_field_read(prog, buf, 12, keys[i], &v), CND_ERR_OK) << i;
+            EXPECT_EQ(v, expected[i]) << i;
+        }
+        ASSERT_EQ(cnd_field_write(prog, buf, 12, keys[3], 77), CND_ERR_OK);
+        uint64_t v = 0;
+        ASSERT_EQ(cnd_field_read(prog, buf, 12, keys[3], &v), CND_ERR_OK);
+        EXPECT_EQ(v, 77u);
+        ASSERT_EQ(cnd_field_write(prog, buf, 12, keys[3], expected[3]), CND_ERR_OK);
+    }
+
+    // A group running past the end of the buffer behaves like single fields
+    GroupValues out;
+    memset(&out, 0, sizeof(out));
+    cnd_init(&ctx, CND_MODE_DECODE, &program, buf, 9, group_values_io, &out);
+    cnd_execute(&ctx);
+    EXPECT_EQ(out.field_events, 8);
+    for (int i = 0; i < 6; i++) EXPECT_EQ(out.v[keys[i]], expected[i]) << i;
+}
+
+TEST_F(BitGroupTest, MalformedGroupsAreRejected) {
+    // cnd_execute does not verify: group events must not overrun cnd_bit_group
+    Load(kGroupSchemaLE, "");
+    std::vector<uint8_t> many = {OP_IO_BIT_GROUP, 200};
+    for (int i = 0; i < 200; i++) many.insert(many.end(), {OP_IO_BIT_U, 0, 0, 0});
+    std::vector<uint8_t> too_many = {OP_IO_BIT_GROUP, CND_MAX_BIT_GROUP + 1};
+    for (int i = 0; i <= CND_MAX_BIT_GROUP; i++) too_many.insert(too_many.end(), {OP_IO_BIT_BOOL, 0, 0, 1});
+    const std::vector<uint8_t>* codes[] = {&many, &too_many};
+
+    for (const std::vector<uint8_t>* code : codes) {
+        cnd_program bad = program;
+        bad.bytecode = code->data();
+        bad.bytecode_len = code->size();
+        EXPECT_EQ(cnd_verify_program(&bad), CND_ERR_INVALID_OP);
+        for (cnd_mode_t mode : {CND_MODE_ENCODE, CND_MODE_DECODE}) {
+            uint8_t buf[16] = {0};
+            GroupValues g = Inputs();
+            cnd_init(&ctx, mode, &bad, buf, sizeof(buf), group_values_io, &g);
+            ctx.flags |= CND_CTX_BIT_GROUPS;
+            EXPECT_EQ(cnd_execute(&ctx), CND_ERR_INVALID_OP);
+            EXPECT_EQ(g.group_events, 0);
+        }
+    }
+}
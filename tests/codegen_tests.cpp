@@ -0,0 +1,133 @@
+#include "test_common.h"
+#include "codegen_features_gen.h"
+#include <cstddef>
+
+// `cnd gen-c` output for codegen_features.cnd (generated at build time, see
+// CMakeLists.txt) must agree with the interpreter running the same IL: the
+// same bytes, the same decoded values and the same error for every input.
+
+class CodegenTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> il;
+    cnd_program program;
+    cnd_binding table[16];
+    cnd_binder binder;
+    cnd_vm_ctx ctx;
+
+    void SetUp() override {
+        std::ifstream in(CND_CODEGEN_IL, std::ios::binary);
+        ASSERT_TRUE(in.good()) << CND_CODEGEN_IL;
+        il.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        ASSERT_EQ(cnd_program_load_il(&program, il.data(), il.size()), CND_ERR_OK);
+
+        memset(table, 0, sizeof(table));
+        Bind("arr", OP_IO_F64, offsetof(CodegenFeatures, arr), sizeof(double), 4);
+        Bind("magic", OP_IO_U16, offsetof(CodegenFeatures, magic));
+        Bind("r", OP_IO_I8, offsetof(CodegenFeatures, r));
+        Bind("f", OP_IO_F32, offsetof(CodegenFeatures, f), sizeof(float), 2);
+        Bind("x", OP_IO_U8, offsetof(CodegenFeatures, x));
+        Bind("s", OP_IO_I8, offsetof(CodegenFeatures, s));
+        Bind("u", OP_IO_U8, offsetof(CodegenFeatures, u));
+        Bind("e2", OP_IO_I16, offsetof(CodegenFeatures, e2));
+        Bind("hi", OP_IO_U8, offsetof(CodegenFeatures, hi));
+        Bind("lo", OP_IO_U16, offsetof(CodegenFeatures, lo));
+        Bind("o", OP_IO_U8, offsetof(CodegenFeatures, o));
+    }
+
+    void Bind(const char* name, uint8_t type, uint32_t offset, uint32_t stride = 0, uint32_t capacity = 0) {
+        cnd_binding e = {offset, stride, capacity, 0, type, 0};
+        ASSERT_EQ(cnd_binding_set(table, 16, &program, name, &e), CND_ERR_OK) << name;
+    }
+
+    cnd_error_t Run(cnd_mode_t mode, CodegenFeatures* host, uint8_t* buf, size_t len) {
+        cnd_binder_init(&binder, table, 16, host);
+        cnd_init(&ctx, mode, &program, buf, len, cnd_bind_io, &binder);
+        return cnd_execute(&ctx);
+    }
+
+    static void Fill(CodegenFeatures* p) {
+        memset(p, 0, sizeof(*p));
+        for (int i = 0; i < 4; i++) p->arr[i] = 1.5 * i;
+        p->magic = 0xCAFE;
+        p->r = -3;
+        p->f[0] = 0.25f;
+        p->f[1] = -8.0f;
+        p->x = 0x5A;
+        p->s = -9;
+        p->u = 6;
+        p->e2 = 19;
+        p->hi = 0xA;
+        p->lo = 0x123;
+        p->o = 77;
+    }
+};
+
+TEST_F(CodegenTest, EncodeMatchesInterpreter) {
+    CodegenFeatures host;
+    Fill(&host);
+    uint8_t gen[64] = {0}, vm[64] = {0};
+    size_t gen_len = 0;
+    ASSERT_EQ(CodegenFeatures_encode(&host, gen, sizeof(gen), &gen_len), CND_GEN_OK);
+    ASSERT_EQ(Run(CND_MODE_ENCODE, &host, vm, sizeof(vm)), CND_ERR_OK);
+    ASSERT_EQ(gen_len, ctx.cursor);
+    EXPECT_EQ(memcmp(gen, vm, gen_len), 0);
+}
+
+TEST_F(CodegenTest, DecodeMatchesInterpreter) {
+    CodegenFeatures host, gen, vm;
+    Fill(&host);
+    uint8_t buf[64] = {0};
+    size_t len = 0, used = 0;
+    ASSERT_EQ(CodegenFeatures_encode(&host, buf, sizeof(buf), &len), CND_GEN_OK);
+
+    memset(&gen, 0, sizeof(gen));
+    memset(&vm, 0, sizeof(vm));
+    ASSERT_EQ(CodegenFeatures_decode(&gen, buf, len, &used), CND_GEN_OK);
+    ASSERT_EQ(Run(CND_MODE_DECODE, &vm, buf, len), CND_ERR_OK);
+    EXPECT_EQ(used, ctx.cursor);
+    EXPECT_EQ(memcmp(&gen, &vm, sizeof(gen)), 0);
+    EXPECT_EQ(memcmp(&gen, &host, sizeof(gen)), 0);
+}
+
+TEST_F(CodegenTest, ShortBuffersFailAlike) {
+    CodegenFeatures host;
+    Fill(&host);
+    uint8_t full[64] = {0};
+    size_t len = 0;
+    ASSERT_EQ(CodegenFeatures_encode(&host, full, sizeof(full), &len), CND_GEN_OK);
+
+    for (size_t n = 0; n < len; n++) {
+        CodegenFeatures gen, vm;
+        memset(&gen, 0, sizeof(gen));
+        memset(&vm, 0, sizeof(vm));
+        int gen_err = CodegenFeatures_decode(&gen, full, n, NULL);
+        EXPECT_EQ(gen_err, (int)Run(CND_MODE_DECODE, &vm, full, n)) << "decode, " << n << " bytes";
+
+        uint8_t a[64] = {0}, b[64] = {0};
+        gen_err = CodegenFeatures_encode(&host, a, n, NULL);
+        EXPECT_EQ(gen_err, (int)Run(CND_MODE_ENCODE, &host, b, n)) << "encode, " << n << " bytes";
+    }
+}
+
+TEST_F(CodegenTest, ChecksFailAlike) {
+    CodegenFeatures host, out;
+    Fill(&host);
+    uint8_t buf[64] = {0};
+    size_t len = 0;
+    ASSERT_EQ(CodegenFeatures_encode(&host, buf, sizeof(buf), &len), CND_GEN_OK);
+
+    // Every single-byte corruption: range, constant, expression and CRC checks
+    for (size_t i = 0; i < len; i++) {
+        uint8_t bad[64];
+        memcpy(bad, buf, len);
+        bad[i] ^= 0x41;
+        memset(&out, 0, sizeof(out));
+        int gen_err = CodegenFeatures_decode(&out, bad, len, NULL);
+        EXPECT_EQ(gen_err, (int)Run(CND_MODE_DECODE, &out, bad, len)) << "byte " << i;
+    }
+
+    host.r = 6;
+    uint8_t a[64], b[64];
+    EXPECT_EQ(CodegenFeatures_encode(&host, a, sizeof(a), NULL), CND_GEN_ERR_VALIDATION);
+    EXPECT_EQ(Run(CND_MODE_ENCODE, &host, b, sizeof(b)), CND_ERR_VALIDATION);
+}
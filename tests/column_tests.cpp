@@ -0,0 +1,187 @@
+#include "test_common.h"
+
+// Columnar batches: encode from columns, decode back into fresh columns and
+// compare, on both the fixed-layout gather path and the VM path.
+
+class ColumnTest : public ConcordiaTest {
+protected:
+    std::vector<cnd_column> columns;
+
+    void SetColumn(const char* name, uint8_t type, void* data) {
+        uint16_t key = cnd_get_key_id(&program, name);
+        ASSERT_NE(key, 0xFFFF) << name;
+        if (columns.size() <= key) columns.resize(key + 1, cnd_column{NULL, 0});
+        columns[key].data = data;
+        columns[key].type = type;
+    }
+
+    static cnd_batch Packed(std::vector<uint8_t>& buf, std::vector<size_t>& offsets,
+                            std::vector<size_t>& lengths, size_t count, size_t stride) {
+        buf.assign(count * stride, 0);
+        offsets.resize(count);
+        lengths.assign(count, stride);
+        for (size_t i = 0; i < count; i++) offsets[i] = i * stride;
+        cnd_batch batch = {};
+        batch.base = buf.data();
+        batch.offsets = offsets.data();
+        batch.lengths = lengths.data();
+        batch.count = count;
+        return batch;
+    }
+};
+
+TEST_F(ColumnTest, FixedLayoutRoundTrip) {
+    CompileAndLoad(
+        "packet T {"
+        "  uint8 kind;"
+        "  @big_endian uint16 id;"
+        "  int32 temp;"
+        "  float volts;"
+        "  uint8 mode : 3;"
+        "  int8 delta : 5;"
+        "  @big_endian int64 stamp;"
+        "}"
+    );
+    const size_t N = 150; // Spans several gather blocks
+    std::vector<uint8_t> kind(N), mode(N);
+    std::vector<uint16_t> id(N);
+    std::vector<int32_t> temp(N);
+    std::vector<float> volts(N);
+    std::vector<int8_t> delta(N);
+    std::vector<int64_t> stamp(N);
+    for (size_t i = 0; i < N; i++) {
+        kind[i] = (uint8_t)i;
+        id[i] = (uint16_t)(0x1000 + i);
+        temp[i] = -(int32_t)i * 3;
+        volts[i] = (float)i * 0.5f;
+        mode[i] = (uint8_t)(i % 8);
+        delta[i] = (int8_t)((int)(i % 32) - 16);
+        stamp[i] = (int64_t)i * -1000000007LL;
+    }
+    SetColumn("kind", OP_IO_U8, kind.data());
+    SetColumn("id", OP_IO_U16, id.data());
+    SetColumn("temp", OP_IO_I32, temp.data());
+    SetColumn("volts", OP_IO_F32, volts.data());
+    SetColumn("mode", OP_IO_U8, mode.data());
+    SetColumn("delta", OP_IO_I8, delta.data());
+    SetColumn("stamp", OP_IO_I64, stamp.data());
+
+    std::vector<uint8_t> buf;
+    std::vector<size_t> offsets, lengths;
+    cnd_batch batch = Packed(buf, offsets, lengths, N, 20);
+    std::vector<size_t> used(N);
+    ASSERT_EQ(cnd_encode_columns(&program, &batch, columns.data(), (uint16_t)columns.size(), NULL, used.data()),
+              CND_ERR_OK);
+    EXPECT_EQ(used[0], 20u);
+    EXPECT_EQ(buf[1], 0x10); // id is big endian
+    EXPECT_EQ(buf[2], 0x00);
+
+    // Packet 70 is truncated: only it fails, with the VM's error
+    lengths[70] = 12;
+
+    std::vector<uint8_t> kind2(N), mode2(N);
+    std::vector<uint16_t> id2(N);
+    std::vector<int64_t> temp2(N); // Widened column
+    std::vector<double> volts2(N); // Converted column
+    std::vector<int8_t> delta2(N);
+    std::vector<int64_t> stamp2(N);
+    columns.clear();
+    SetColumn("kind", OP_IO_U8, kind2.data());
+    SetColumn("id", OP_IO_U16, id2.data());
+    SetColumn("temp", OP_IO_I64, temp2.data());
+    SetColumn("volts", OP_IO_F64, volts2.data());
+    SetColumn("mode", OP_IO_U8, mode2.data());
+    SetColumn("delta", OP_IO_I8, delta2.data());
+    SetColumn("stamp", OP_IO_I64, stamp2.data());
+
+    std::vector<cnd_error_t> errors(N);
+    EXPECT_EQ(cnd_decode_columns(&program, &batch, columns.data(), (uint16_t)columns.size(), errors.data()),
+              CND_ERR_OOB);
+    for (size_t i = 0; i < N; i++) {
+        if (i == 70) {
+            EXPECT_EQ(errors[i], CND_ERR_OOB);
+            continue;
+        }
+        ASSERT_EQ(errors[i], CND_ERR_OK) << i;
+        EXPECT_EQ(kind2[i], kind[i]) << i;
+        EXPECT_EQ(id2[i], id[i]) << i;
+        EXPECT_EQ(temp2[i], temp[i]) << i;
+        EXPECT_EQ(volts2[i], (double)volts[i]) << i;
+        EXPECT_EQ(mode2[i], mode[i]) << i;
+        EXPECT_EQ(delta2[i], delta[i]) << i;
+        EXPECT_EQ(stamp2[i], stamp[i]) << i;
+    }
+}
+
+TEST_F(ColumnTest, DynamicProgramsRunThroughVM) {
+    CompileAndLoad(
+        "packet D {"
+        "  uint8 kind;"
+        "  switch (kind) {"
+        "    case 1: uint16 a;"
+        "    case 2: uint32 b;"
+        "  }"
+        "  uint8 vals[] prefix uint8;"
+        "  uint8 tail;"
+        "}"
+    );
+    const size_t N = 4;
+    uint8_t kind[N] = {1, 2, 1, 2};
+    uint16_t a[N] = {100, 0, 300, 0};
+    uint32_t b[N] = {0, 200000, 0, 400000};
+    uint8_t vals[N] = {0, 1, 2, 3}; // Count and every element share the array's Key ID
+    uint8_t tail[N] = {5, 6, 7, 8};
+    SetColumn("kind", OP_IO_U8, kind);
+    SetColumn("a", OP_IO_U16, a);
+    SetColumn("b", OP_IO_U32, b);
+    SetColumn("vals", OP_IO_U8, vals);
+    SetColumn("tail", OP_IO_U8, tail);
+
+    std::vector<uint8_t> buf;
+    std::vector<size_t> offsets, lengths;
+    cnd_batch batch = Packed(buf, offsets, lengths, N, 16);
+    std::vector<size_t> used(N);
+    std::vector<cnd_error_t> errors(N);
+    EXPECT_EQ(cnd_encode_columns(&program, &batch, columns.data(), (uint16_t)columns.size(), errors.data(),
+                                 used.data()), CND_ERR_OK);
+    EXPECT_EQ(used[0], 1u + 2 + 1 + 0 + 1);
+    EXPECT_EQ(used[1], 1u + 4 + 1 + 1 + 1);
+    EXPECT_EQ(buf[16 * 3 + 5], 3); // Packet 3: count, then three copies of the column value
+    EXPECT_EQ(buf[16 * 3 + 6], 3);
+
+    uint8_t kind2[N], tail2[N];
+    uint16_t a2[N] = {};
+    uint32_t b2[N] = {};
+    columns.clear();
+    SetColumn("kind", OP_IO_U8, kind2);
+    SetColumn("a", OP_IO_U16, a2);
+    SetColumn("b", OP_IO_U32, b2);
+    SetColumn("tail", OP_IO_U8, tail2);
+    EXPECT_EQ(cnd_decode_columns(&program, &batch, columns.data(), (uint16_t)columns.size(), errors.data()),
+              CND_ERR_OK);
+    for (size_t i = 0; i < N; i++) {
+        EXPECT_EQ(kind2[i], kind[i]);
+        EXPECT_EQ(tail2[i], tail[i]);
+        if (kind[i] == 1) EXPECT_EQ(a2[i], a[i]);
+        else EXPECT_EQ(b2[i], b[i]);
+    }
+}
+
+TEST_F(ColumnTest, EncodeNeedsEveryField) {
+    CompileAndLoad("packet P { uint8 x; uint16 y; }");
+    uint8_t x[2] = {1, 2};
+    SetColumn("x", OP_IO_U8, x);
+
+    std::vector<uint8_t> buf;
+    std::vector<size_t> offsets, lengths;
+    cnd_batch batch = Packed(buf, offsets, lengths, 2, 3);
+    cnd_error_t errors[2];
+    EXPECT_EQ(cnd_encode_columns(&program, &batch, columns.data(), (uint16_t)columns.size(), errors, NULL),
+              CND_ERR_CALLBACK);
+    EXPECT_EQ(errors[1], CND_ERR_CALLBACK);
+
+    // Column types must be primitive
+    columns[0].type = OP_STR_NULL;
+    EXPECT_EQ(cnd_decode_columns(&program, &batch, columns.data(), (uint16_t)columns.size(), NULL),
+              CND_ERR_VALIDATION);
+}
@@ -3,6 +3,7 @@
 #include <cstdio>
 #include <filesystem>
 #include "compiler.h"
+#include "concordia.h"
 
 class CompilerTest : public ::testing::Test {
 protected:
@@ -213,6 +214,37 @@ TEST_F(CompilerTest, Transformations) {
     EXPECT_TRUE(CheckOutputExists());
 }
 
+TEST_F(CompilerTest, CurveTransformKeysSurviveStringCompaction) {
+    // Dropping the unused struct name renumbers every key; the coefficients
+    // of @poly and @spline must be skipped, not remapped as instructions
+    WriteSource(
+        "struct V { float x; }"
+        "packet P { V v; @poly(5.0, 2.0, 0.5) uint8 pv; @spline(0.0, 0.0, 10.0, 100.0, 20.0, 400.0) uint8 sv; bool h; }"
+    );
+    ASSERT_EQ(cnd_compile_file(kSourceFile, kOutFile, 0, 0), 0);
+    std::vector<uint8_t> image = ReadOutputFile();
+    cnd_program program;
+    ASSERT_EQ(cnd_program_load_il(&program, image.data(), image.size()), CND_ERR_OK);
+
+    const uint8_t* bc = program.bytecode;
+    std::vector<std::string> names;
+    for (size_t ip = 0; ip < program.bytecode_len; ) {
+        size_t len = 0;
+        if (bc[ip] == OP_TRANS_POLY) len = 2 + (size_t)bc[ip + 1] * 8;
+        else if (bc[ip] == OP_TRANS_SPLINE) len = 2 + (size_t)bc[ip + 1] * 16;
+        else if (bc[ip] == OP_EXIT_STRUCT) len = 1;
+        else {
+            len = 3;
+            if (bc[ip] == OP_IO_U8 || bc[ip] == OP_IO_BOOL) {
+                const char* name = cnd_get_key_name(&program, (uint16_t)(bc[ip + 1] | (bc[ip + 2] << 8)));
+                names.push_back(name ? name : "?");
+            }
+        }
+        ip += len;
+    }
+    EXPECT_EQ(names, (std::vector<std::string>{"pv", "sv", "h"}));
+}
+
 TEST_F(CompilerTest, EmptyStruct) {
     WriteSource("struct Empty {} packet P { Empty e; }");
     int res = cnd_compile_file(kSourceFile, kOutFile, 0, 0);
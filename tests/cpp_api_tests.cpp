@@ -0,0 +1,322 @@
+#include "test_common.h"
+#include "concordia.hpp"
+#include "cpp_api_features_il.h"
+#include <map>
+#include <string>
+
+// cnd::execute (concordia.hpp) runs its own instruction loop and hands the
+// rest of a packet to cnd_execute() at the first instruction it does not
+// implement. Each test runs a visitor both ways, natively and through
+// cnd::visitor_callback with cnd_execute(), and compares the visitor calls,
+// bytes, errors and cursor, for encode and for every truncated decode.
+
+namespace {
+
+// Field values derived from the key: distinct bytes in every position and
+// negative values for odd keys
+uint64_t seed(uint16_t key, size_t size) {
+    uint64_t base = (key * 37u + 5u) % 13u + 1u;
+    uint64_t v = size == 1 ? base : size == 2 ? base * 0x0101u : size == 4 ? base * 0x01020304u : base * 0x0102030405060708ull;
+    return (key & 1) ? static_cast<uint64_t>(-static_cast<int64_t>(v)) : v;
+}
+
+struct Recorder {
+    bool encode;
+    std::vector<std::string> log;
+    std::map<uint16_t, uint64_t> values;
+    int fail_at;  // Visitor call that fails, -1 for none
+
+    explicit Recorder(bool enc, int fail = -1) : encode(enc), fail_at(fail) {}
+
+    bool Record(std::string event) {
+        log.push_back(event);
+        return static_cast<int>(log.size()) - 1 != fail_at;
+    }
+
+    template <class T>
+    bool on(uint16_t key, T& v) {
+        if (encode) {
+            if (std::is_floating_point<T>::value) v = static_cast<T>(static_cast<int64_t>(seed(key, 1))) / 4;
+            else v = static_cast<T>(seed(key, sizeof(T)));
+        }
+        values[key] = static_cast<uint64_t>(static_cast<int64_t>(v));
+        return Record(std::to_string(key) + (std::is_floating_point<T>::value ? ":f" : std::is_signed<T>::value ? ":i" : ":u") +
+                      std::to_string(sizeof(T)) + "=" + std::to_string(v));
+    }
+    bool on(uint16_t key, bool& v) {
+        if (encode) v = (key & 1) != 0;
+        values[key] = v;
+        return Record(std::to_string(key) + ":b=" + std::to_string(v));
+    }
+    bool on(uint16_t key, const char*& s) {
+        if (encode) s = "hello";
+        return Record(std::to_string(key) + ":s=" + s);
+    }
+    bool on_enter(uint16_t key) { return Record("enter " + std::to_string(key)); }
+    bool on_exit() { return Record("exit"); }
+    bool on_array(uint16_t key, uint32_t& count) {
+        if (encode && count == 0) count = 3;
+        return Record("array " + std::to_string(key) + " " + std::to_string(count));
+    }
+    bool on_array_end() { return Record("end"); }
+    bool on_query(uint16_t key, uint64_t& v) {
+        auto it = values.find(key);
+        if (it == values.end()) return false;
+        v = it->second;
+        return Record("query " + std::to_string(key));
+    }
+    bool on_store(uint16_t key, uint64_t v) {
+        values[key] = v;
+        return Record("store " + std::to_string(key) + "=" + std::to_string(v));
+    }
+};
+
+// Takes byte arrays in place
+struct BytesRecorder : Recorder {
+    using Recorder::Recorder;
+
+    bool on_bytes(uint16_t key, uint8_t* data, uint32_t count) {
+        std::string s = "bytes " + std::to_string(key) + ":";
+        for (uint32_t i = 0; i < count; i++) {
+            if (encode) data[i] = static_cast<uint8_t>(key + i);
+            s += " " + std::to_string(data[i]);
+        }
+        return Record(s);
+    }
+};
+
+} // namespace
+
+class CppApiTest : public ConcordiaTest {
+protected:
+    struct Result {
+        cnd_error_t err;
+        size_t cursor;
+        std::vector<std::string> log;
+    };
+
+    template <class V, class Program>
+    Result Native(const Program& prog, cnd_mode_t mode, uint8_t* buf, size_t len, int fail_at = -1) {
+        V v(mode == CND_MODE_ENCODE, fail_at);
+        Result r;
+        r.cursor = 0;
+        r.err = mode == CND_MODE_ENCODE ? cnd::encode(prog, buf, len, v, &r.cursor) : cnd::decode(prog, buf, len, v, &r.cursor);
+        r.log = v.log;
+        return r;
+    }
+
+    template <class V>
+    Result Reference(cnd_mode_t mode, uint8_t* buf, size_t len, int fail_at = -1) {
+        V v(mode == CND_MODE_ENCODE, fail_at);
+        cnd::visitor_callback<V> adapter(v);
+        cnd_init(&ctx, mode, &program, buf, len, adapter.callback, &adapter);
+        Result r;
+        r.err = cnd_execute(&ctx);
+        r.cursor = ctx.cursor;
+        r.log = v.log;
+        return r;
+    }
+
+    static void ExpectSame(const Result& ref, const Result& got, const char* what, size_t len) {
+        EXPECT_EQ(ref.err, got.err) << what << " len " << len;
+        EXPECT_EQ(ref.cursor, got.cursor) << what << " len " << len;
+        EXPECT_EQ(ref.log, got.log) << what << " len " << len;
+    }
+
+    // Compares native and reference runs; returns the encoded size
+    template <class V = Recorder>
+    size_t ExpectSameRuns(cnd_error_t expected = CND_ERR_OK) {
+        uint8_t ref_buf[256], got_buf[256];
+        memset(ref_buf, 0, sizeof(ref_buf));
+        memset(got_buf, 0, sizeof(got_buf));
+        Result ref = Reference<V>(CND_MODE_ENCODE, ref_buf, sizeof(ref_buf));
+        Result got = Native<V>(program, CND_MODE_ENCODE, got_buf, sizeof(got_buf));
+        EXPECT_EQ(ref.err, expected);
+        ExpectSame(ref, got, "encode", sizeof(ref_buf));
+        EXPECT_EQ(0, memcmp(ref_buf, got_buf, sizeof(ref_buf)));
+
+        size_t size = ref.cursor;
+        for (size_t len = 0; len <= size; len++) {
+            Result dref = Reference<V>(CND_MODE_DECODE, ref_buf, len);
+            Result dgot = Native<V>(program, CND_MODE_DECODE, ref_buf, len);
+            ExpectSame(dref, dgot, "decode", len);
+        }
+
+        // A visitor failing at each call in turn
+        for (int fail = 0; fail < static_cast<int>(ref.log.size()); fail++) {
+            memset(ref_buf, 0, sizeof(ref_buf));
+            memset(got_buf, 0, sizeof(got_buf));
+            ExpectSame(Reference<V>(CND_MODE_ENCODE, ref_buf, sizeof(ref_buf), fail),
+                       Native<V>(program, CND_MODE_ENCODE, got_buf, sizeof(got_buf), fail), "failing encode", fail);
+        }
+        return size;
+    }
+
+    void ExpectSameAtLevels(const char* source) {
+        for (int level = 0; level <= 2; level += 2) {
+            SCOPED_TRACE(level);
+            CompileAndLoad(source, level);
+            ExpectSameRuns<Recorder>();
+            ExpectSameRuns<BytesRecorder>();
+        }
+    }
+};
+
+TEST_F(CppApiTest, Primitives) {
+    ExpectSameAtLevels(
+        "packet P { uint8 a; int8 b; uint16 c; int16 d; uint32 e; int32 f; uint64 g; int64 h;"
+        "  float i; double j; bool k; @big_endian uint32 l; @big_endian int64 m; @big_endian double n; uint16 o; }");
+}
+
+TEST_F(CppApiTest, StructsAndConstants) {
+    ExpectSameAtLevels(
+        "struct Inner { uint16 x; @const(7) uint8 tag; @big_endian int32 y; }"
+        "packet P { @const(0xCAFE) uint16 magic; Inner in; Inner pair[2]; @big_endian @const(0x1234) uint16 be; uint8 tail; }");
+}
+
+TEST_F(CppApiTest, Arrays) {
+    ExpectSameAtLevels(
+        "struct Pt { int16 x; uint8 y; }"
+        "packet P { uint16 a[3]; uint8 raw[4]; int8 sraw[2]; int32 v[] prefix uint8;"
+        "  uint8 b[] prefix uint16; Pt pts[] prefix uint8; @big_endian uint32 w[] prefix uint32; uint8 tail; }");
+}
+
+TEST_F(CppApiTest, Bitfields) {
+    ExpectSameAtLevels(
+        "packet P { uint8 a : 3; int8 b : 5; bool c : 1; @pad(3); uint16 d : 12; @fill uint8 e;"
+        "  uint8 f; @big_endian uint16 g : 10; @big_endian int8 h : 6; uint32 i; }");
+}
+
+TEST_F(CppApiTest, MalformedBitGroupsAreRejected) {
+    // Unverified IL: empty, oversized and zero-width groups fail as in cnd_execute()
+    CompileAndLoad("packet P { uint8 a : 3; uint8 b : 5; }");
+    std::vector<uint8_t> empty = {OP_IO_BIT_GROUP, 0};
+    std::vector<uint8_t> too_many = {OP_IO_BIT_GROUP, CND_MAX_BIT_GROUP + 1};
+    for (int i = 0; i <= CND_MAX_BIT_GROUP; i++) too_many.insert(too_many.end(), {OP_IO_BIT_BOOL, 0, 0, 1});
+    std::vector<uint8_t> zero_width = {OP_IO_BIT_GROUP, 2, OP_IO_BIT_U, 0, 0, 3, OP_IO_BIT_U, 1, 0, 0};
+    const std::vector<uint8_t>* codes[] = {&empty, &too_many, &zero_width};
+
+    for (const std::vector<uint8_t>* code : codes) {
+        program.bytecode = code->data();
+        program.bytecode_len = code->size();
+        for (cnd_mode_t mode : {CND_MODE_ENCODE, CND_MODE_DECODE}) {
+            uint8_t ref_buf[16] = {0}, got_buf[16] = {0};
+            Result ref = Reference<Recorder>(mode, ref_buf, sizeof(ref_buf));
+            EXPECT_EQ(ref.err, CND_ERR_INVALID_OP);
+            ExpectSame(ref, Native<Recorder>(program, mode, got_buf, sizeof(got_buf)), "malformed group", code->size());
+            EXPECT_EQ(0, memcmp(ref_buf, got_buf, sizeof(ref_buf)));
+        }
+    }
+}
+
+TEST_F(CppApiTest, HandsOffToTheInterpreter) {
+    ExpectSameAtLevels(
+        "packet P { uint8 kind; switch (kind) { case 1: uint16 a; default: uint32 b; }"
+        "  string name prefix u8; uint8 n; @count(n) uint16 data[]; @range(0, 9000) uint16 c;"
+        "  uint16 d[2]; bool e; uint8 tail; }");
+}
+
+TEST_F(CppApiTest, ExpressionsAndOptionals) {
+    ExpectSameAtLevels(
+        "packet P { uint8 u; @expr(u * 3 + 1) uint16 e; uint8 g; @optional uint8 o; @optional uint32 p; }");
+}
+
+TEST_F(CppApiTest, ValidationErrors) {
+    CompileAndLoad("packet P { uint8 a; bool b; @const(9) uint8 c; uint8 d : 4; }");
+    uint8_t bad_bool[] = {1, 2, 9, 0};
+    uint8_t bad_const[] = {1, 1, 8, 0};
+    for (uint8_t* buf : {bad_bool, bad_const}) {
+        Result ref = Reference<Recorder>(CND_MODE_DECODE, buf, 4);
+        EXPECT_EQ(ref.err, CND_ERR_VALIDATION);
+        ExpectSame(ref, Native<Recorder>(program, CND_MODE_DECODE, buf, 4), "decode", 4);
+    }
+}
+
+TEST_F(CppApiTest, VisitorWithoutHooks) {
+    // Only field overloads: structs and arrays are transparent, strings fail
+    struct Sum {
+        uint64_t total = 0;
+        void on(uint16_t, uint8_t& v) { total += v; }
+        void on(uint16_t, uint16_t& v) { total += v; }
+    };
+    CompileAndLoad("struct S { uint8 a; } packet P { S s; uint16 b[2]; uint8 c[] prefix uint8; }");
+    uint8_t buf[] = {1, 2, 0, 3, 0, 2, 4, 5};
+    Sum sum;
+    size_t used = 0;
+    EXPECT_EQ(cnd::decode(program, buf, sizeof(buf), sum, &used), CND_ERR_OK);
+    EXPECT_EQ(used, sizeof(buf));
+    EXPECT_EQ(sum.total, 1u + 2u + 3u + 4u + 5u);
+
+    CompileAndLoad("packet P { uint8 a; int32 b; }");
+    EXPECT_EQ(cnd::decode(program, buf, sizeof(buf), sum, &used), CND_ERR_CALLBACK);
+    EXPECT_EQ(used, 1u);
+}
+
+TEST_F(CppApiTest, EmbeddedMatchesRuntime) {
+    static const cnd::embedded<cpp_api_features_il, sizeof(cpp_api_features_il)> frame;
+    ASSERT_EQ(frame.status(), CND_ERR_OK);
+    // The prefix ends at the @count array, whose length is read from the context
+    EXPECT_GT(frame.prefix_end, 0u);
+    EXPECT_EQ(frame.prefix_bytes, 2u + 1u + 4u + 2u + 4u + 1u + 1u + 8u + 8u + 1u);
+
+    ASSERT_EQ(cnd_program_load_il(&program, cpp_api_features_il, sizeof(cpp_api_features_il)), CND_ERR_OK);
+    size_t size = ExpectSameRuns<Recorder>();
+    ASSERT_GT(size, frame.prefix_bytes);
+
+    uint8_t ref_buf[256], got_buf[256];
+    memset(ref_buf, 0, sizeof(ref_buf));
+    memset(got_buf, 0, sizeof(got_buf));
+    Result ref = Reference<Recorder>(CND_MODE_ENCODE, ref_buf, sizeof(ref_buf));
+    ExpectSame(ref, Native<Recorder>(frame, CND_MODE_ENCODE, got_buf, sizeof(got_buf)), "embedded encode", sizeof(got_buf));
+    EXPECT_EQ(0, memcmp(ref_buf, got_buf, sizeof(ref_buf)));
+    for (size_t len = 0; len <= size; len++) {
+        ExpectSame(Reference<Recorder>(CND_MODE_DECODE, ref_buf, len),
+                   Native<Recorder>(frame, CND_MODE_DECODE, ref_buf, len), "embedded decode", len);
+    }
+    for (int fail = 0; fail < static_cast<int>(ref.log.size()); fail++) {
+        ExpectSame(Reference<Recorder>(CND_MODE_DECODE, ref_buf, size, fail),
+                   Native<Recorder>(frame, CND_MODE_DECODE, ref_buf, size, fail), "embedded failing decode", fail);
+    }
+
+    // A wrong constant in the unrolled prefix
+    ref_buf[0] ^= 1;
+    ExpectSame(Reference<Recorder>(CND_MODE_DECODE, ref_buf, size),
+               Native<Recorder>(frame, CND_MODE_DECODE, ref_buf, size), "embedded bad magic", size);
+}
+
+TEST_F(CppApiTest, AdapterWorksWithPreparedPrograms) {
+    CompileAndLoad("packet P { uint16 a; uint8 raw[4]; uint8 b[] prefix uint8; string s prefix u8; uint8 c : 4; @fill uint8 d; }", 2);
+    size_t cap = 0;
+    ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+    std::vector<cnd_insn> storage(cap > 0 ? cap : 1);
+    cnd_prepared prepared;
+    ASSERT_EQ(cnd_program_prepare(&prepared, &program, storage.data(), cap), CND_ERR_OK);
+
+    uint8_t ref_buf[64] = {0}, got_buf[64] = {0};
+    Result ref = Reference<BytesRecorder>(CND_MODE_ENCODE, ref_buf, sizeof(ref_buf));
+    ASSERT_EQ(ref.err, CND_ERR_OK);
+
+    BytesRecorder enc(true);
+    cnd::visitor_callback<BytesRecorder> adapter(enc);
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, got_buf, sizeof(got_buf), adapter.callback, &adapter);
+    EXPECT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OK);
+    EXPECT_EQ(ctx.cursor, ref.cursor);
+    EXPECT_EQ(enc.log, ref.log);
+    EXPECT_EQ(0, memcmp(ref_buf, got_buf, sizeof(ref_buf)));
+
+    BytesRecorder dec(false);
+    cnd::visitor_callback<BytesRecorder> dec_adapter(dec);
+    cnd_init(&ctx, CND_MODE_DECODE, &program, got_buf, ref.cursor, dec_adapter.callback, &dec_adapter);
+    EXPECT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OK);
+    EXPECT_EQ(dec.log, Reference<BytesRecorder>(CND_MODE_DECODE, ref_buf, ref.cursor).log);
+}
+
+TEST_F(CppApiTest, RejectsNullBuffers) {
+    CompileAndLoad("packet P { uint8 a; }");
+    Recorder v(false);
+    EXPECT_EQ(cnd::decode(program, nullptr, 4, v), CND_ERR_OOB);
+    cnd_program empty;
+    cnd_program_load(&empty, nullptr, 0);
+    uint8_t buf[4] = {0};
+    EXPECT_EQ(cnd::decode(empty, buf, sizeof(buf), v), CND_ERR_OOB);
+}
@@ -0,0 +1,214 @@
+#include "test_common.h"
+#include "../src/vm/vm_internal.h"
+#include <algorithm>
+
+// The CRC engine (slice-by-8 tables and PCLMULQDQ folding) must match a plain
+// bit-at-a-time CRC for every configuration, length and alignment.
+
+class CrcTest : public ConcordiaTest {};
+
+struct CrcConfig {
+    uint32_t poly, init, xorout;
+    uint8_t flags; // 1 = refin, 2 = refout
+    int width;
+};
+
+static uint32_t reflect_bits(uint32_t v, int bits) {
+    uint32_t r = 0;
+    for (int i = 0; i < bits; i++) if (v & (1u << i)) r |= 1u << (bits - 1 - i);
+    return r;
+}
+
+static uint32_t reference_crc(const CrcConfig& c, const uint8_t* data, size_t len) {
+    uint32_t top = 1u << (c.width - 1);
+    uint32_t mask = (c.width == 32) ? 0xFFFFFFFF : 0xFFFF;
+    uint32_t crc = c.init & mask;
+    // Standard CRC-32 treats init as the reflected register
+    if (c.width == 32 && c.poly == 0x04C11DB7 && c.flags == 3) crc = reflect_bits(crc, 32);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = (c.flags & 1) ? (uint8_t)reflect_bits(data[i], 8) : data[i];
+        crc ^= (uint32_t)b << (c.width - 8);
+        for (int j = 0; j < 8; j++) crc = ((crc & top) ? (crc << 1) ^ c.poly : crc << 1) & mask;
+    }
+    if (c.flags & 2) crc = reflect_bits(crc, c.width);
+    return (crc ^ c.xorout) & mask;
+}
+
+static uint32_t vm_crc(const CrcConfig& c, const uint8_t* data, size_t len) {
+    return vm_calc_crc(data, len, c.poly, c.init, c.xorout, c.flags, c.width);
+}
+
+static std::vector<uint8_t> crc_payload(size_t len) {
+    std::vector<uint8_t> v(len);
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < len; i++) {
+        x = x * 1103515245u + 12345u;
+        v[i] = (uint8_t)(x >> 16);
+    }
+    return v;
+}
+
+static void ExpectMatchesReference(const CrcConfig& c) {
+    std::vector<uint8_t> data = crc_payload(70000);
+    const size_t lengths[] = {1000, 4096, 65536 + 5};
+    for (size_t len = 0; len <= 300; len++) {
+        ASSERT_EQ(vm_crc(c, data.data() + 1, len), reference_crc(c, data.data() + 1, len)) << "len " << len;
+    }
+    for (size_t len : lengths) {
+        for (size_t off = 0; off < 3; off++) {
+            ASSERT_EQ(vm_crc(c, data.data() + off, len), reference_crc(c, data.data() + off, len)) << "len " << len;
+        }
+    }
+}
+
+TEST_F(CrcTest, CatalogueCheckValues) {
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    EXPECT_EQ(vm_crc({0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, 3, 32}, check, 9), 0xCBF43926u); // CRC-32
+    EXPECT_EQ(vm_crc({0x1021, 0xFFFF, 0, 0, 16}, check, 9), 0x29B1u);                       // CCITT-FALSE
+    EXPECT_EQ(vm_crc({0x1EDC6F41, 0xFFFFFFFF, 0xFFFFFFFF, 3, 32}, check, 9), 0xE3069283u); // CRC-32C
+    EXPECT_EQ(vm_crc({0x8005, 0xFFFF, 0, 3, 16}, check, 9), 0x4B37u);                       // MODBUS
+    EXPECT_EQ(vm_crc({0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, 0, 32}, check, 9), 0xFC891918u); // BZIP2
+    EXPECT_EQ(vm_crc({0x8005, 0, 0, 3, 16}, check, 9), 0xBB3Du);                            // ARC
+}
+
+TEST_F(CrcTest, ReflectedMatchesReference) {
+    ExpectMatchesReference({0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, 3, 32});
+    ExpectMatchesReference({0x1EDC6F41, 0x12345678, 0, 3, 32});
+    ExpectMatchesReference({0x8005, 0xFFFF, 0, 3, 16});
+    ExpectMatchesReference({0x04C11DB7, 0xA5A5A5A5, 0, 1, 32}); // Reflected input only
+}
+
+TEST_F(CrcTest, MsbFirstMatchesReference) {
+    ExpectMatchesReference({0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, 0, 32});
+    ExpectMatchesReference({0x1021, 0x1D0F, 0, 0, 16});
+    ExpectMatchesReference({0x8BB7, 0, 0x5555, 2, 16}); // Reflected output only
+    ExpectMatchesReference({0x000000AF, 0x1, 0, 0, 32});
+}
+
+TEST_F(CrcTest, EngineCacheOverflowFallsBack) {
+    // More configurations than cache slots: the rest take the bytewise path
+    for (uint32_t poly = 0x1021; poly < 0x1021 + 2 * 8; poly += 2) {
+        CrcConfig c = {poly, 0xFFFF, 0, (uint8_t)(poly & 2 ? 3 : 0), 16};
+        std::vector<uint8_t> data = crc_payload(777);
+        EXPECT_EQ(vm_crc(c, data.data(), data.size()), reference_crc(c, data.data(), data.size())) << poly;
+    }
+}
+
+// Leaves the payload bytes as they are in the buffer (OP_RAW_BYTES)
+static cnd_error_t crc_keep_buffer(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    (void)ctx; (void)key_id; (void)type; (void)ptr;
+    return CND_ERR_OK;
+}
+
+TEST_F(CrcTest, LargePayloadRoundTrip) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 payload[5000];"
+        "  @crc(16) @crc_poly(0x8005) @crc_refin @crc_refout uint16 c16;"
+        "  @crc(32) uint32 c32;"
+        "}"
+    );
+    std::vector<uint8_t> buf = crc_payload(5006);
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf.data(), buf.size(), crc_keep_buffer, NULL);
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+
+    CrcConfig modbus = {0x8005, 0xFFFF, 0, 3, 16};
+    uint32_t c16 = reference_crc(modbus, buf.data(), 5000);
+    EXPECT_EQ(buf[5000], (uint8_t)c16);
+    EXPECT_EQ(buf[5001], (uint8_t)(c16 >> 8));
+
+    cnd_init(&ctx, CND_MODE_DECODE, &program, buf.data(), buf.size(), crc_keep_buffer, NULL);
+    EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+
+    buf[4321] ^= 0x10;
+    cnd_init(&ctx, CND_MODE_DECODE, &program, buf.data(), buf.size(), crc_keep_buffer, NULL);
+    EXPECT_EQ(cnd_execute(&ctx), CND_ERR_CRC_MISMATCH);
+}
+
+TEST_F(CrcTest, IncrementalMatchesOneShot) {
+    const CrcConfig configs[] = {
+        {0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, 3, 32}, {0x1021, 0xFFFF, 0, 0, 16},
+        {0x8005, 0xFFFF, 0, 3, 16}, {0x8BB7, 0, 0x5555, 2, 16},
+    };
+    std::vector<uint8_t> data = crc_payload(3000);
+    for (const CrcConfig& c : configs) {
+        uint32_t crc = vm_crc_start(c.poly, c.init, c.flags, c.width);
+        size_t pos = 0, piece = 1;
+        while (pos < data.size()) {
+            size_t n = std::min(piece, data.size() - pos);
+            crc = vm_crc_update(crc, data.data() + pos, n, c.poly, c.flags, c.width);
+            pos += n;
+            piece = piece * 3 + 1; // 1, 4, 13, 40, ... crosses the folding threshold
+        }
+        EXPECT_EQ(vm_crc_finish(crc, c.xorout, c.flags, c.width), reference_crc(c, data.data(), data.size()));
+    }
+}
+
+TEST_F(CrcTest, RegionsCoverOnlyTheirBytes) {
+    CompileAndLoad(
+        "packet Frame {"
+        "  uint8 sync[1];"
+        "  @crc_begin uint8 head[2];"
+        "  uint8 payload[32];"
+        "  @crc(16) uint16 header_crc;"
+        "  uint8 body[64];"
+        "  @crc(16) uint16 frame_crc;"
+        "  @crc(32) uint32 frame_crc32;"
+        "}"
+    );
+    std::vector<uint8_t> buf = crc_payload(107);
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf.data(), buf.size(), crc_keep_buffer, NULL);
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    ASSERT_EQ(ctx.cursor, 107u);
+
+    CrcConfig ccitt = {0x1021, 0xFFFF, 0, 0, 16};
+    CrcConfig crc32 = {0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, 3, 32};
+    uint32_t header = reference_crc(ccitt, buf.data() + 1, 34);
+    uint32_t frame = reference_crc(ccitt, buf.data() + 1, 100);
+    uint32_t frame32 = reference_crc(crc32, buf.data() + 1, 102);
+    EXPECT_EQ(buf[35] | (buf[36] << 8), (int)header);
+    EXPECT_EQ(buf[101] | (buf[102] << 8), (int)frame);
+    EXPECT_EQ(il_get_u32(buf.data() + 103), frame32);
+
+    cnd_init(&ctx, CND_MODE_DECODE, &program, buf.data(), buf.size(), crc_keep_buffer, NULL);
+    EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+
+    // The sync byte is outside the region
+    buf[0] ^= 0xFF;
+    cnd_init(&ctx, CND_MODE_DECODE, &program, buf.data(), buf.size(), crc_keep_buffer, NULL);
+    EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+
+    buf[50] ^= 0x01;
+    cnd_init(&ctx, CND_MODE_DECODE, &program, buf.data(), buf.size(), crc_keep_buffer, NULL);
+    EXPECT_EQ(cnd_execute(&ctx), CND_ERR_CRC_MISMATCH);
+}
+
+TEST_F(CrcTest, RegionEndAndRestart) {
+    CompileAndLoad(
+        "packet P {"
+        "  @crc_begin uint8 a[10];"
+        "  @crc_end uint8 gap[5];"
+        "  @crc(32) uint32 ca;"
+        "  @crc_begin;"
+        "  uint8 b[20];"
+        "  @crc(32) uint32 cb;"
+        "}"
+    );
+    std::vector<uint8_t> buf = crc_payload(43);
+    CrcConfig crc32 = {0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, 3, 32};
+
+    // Interpreted and prepared runs give the same bytes
+    size_t cap = 0;
+    ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+    std::vector<cnd_insn> storage(cap);
+    cnd_prepared prepared;
+    ASSERT_EQ(cnd_program_prepare(&prepared, &program, storage.data(), cap), CND_ERR_OK);
+    for (int prep = 0; prep < 2; prep++) {
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, buf.data(), buf.size(), crc_keep_buffer, NULL);
+        ASSERT_EQ(prep ? cnd_execute_prepared(&ctx, &prepared) : cnd_execute(&ctx), CND_ERR_OK);
+        EXPECT_EQ(il_get_u32(buf.data() + 15), reference_crc(crc32, buf.data(), 10));
+        EXPECT_EQ(il_get_u32(buf.data() + 39), reference_crc(crc32, buf.data() + 19, 20));
+        memset(buf.data() + 15, 0, 4);
+        memset(buf.data() + 39, 0, 4);
+    }
+}
@@ -0,0 +1,135 @@
+#include "test_common.h"
+
+// Switch and computed-goto dispatch must be indistinguishable. Each test
+// encodes and decodes the same data with both loops and compares the results.
+
+class DispatchTest : public ConcordiaTest {
+protected:
+    bool HasThreaded() {
+        uint8_t buf[1];
+        cnd_program empty;
+        static const uint8_t noop = OP_NOOP;
+        cnd_program_load(&empty, &noop, 1);
+        cnd_init(&ctx, CND_MODE_ENCODE, &empty, buf, sizeof(buf), test_io_callback, NULL);
+        return cnd_execute_dispatch(&ctx, CND_DISPATCH_THREADED) == CND_ERR_OK;
+    }
+
+    cnd_error_t Run(cnd_mode_t mode, cnd_dispatch_t dispatch, uint8_t* buf, size_t len, size_t* cursor) {
+        cnd_init(&ctx, mode, &program, buf, len, test_io_callback, NULL);
+        cnd_error_t err = cnd_execute_dispatch(&ctx, dispatch);
+        *cursor = ctx.cursor;
+        return err;
+    }
+
+    void Set(const char* name, uint64_t u64, double f64 = 0.0, const char* str = "") {
+        uint16_t key = cnd_get_key_id(&program, name);
+        ASSERT_NE(key, 0xFFFF) << name;
+        for (int i = 0; i < MAX_TEST_ENTRIES; i++) {
+            if (g_test_data[i].key == 0xFFFF || g_test_data[i].key == key) {
+                g_test_data[i] = test_data_entry(key, u64, f64, str);
+                return;
+            }
+        }
+        FAIL() << "Out of test entries";
+    }
+
+    cnd_error_t ExpectSameRoundTrip() {
+        test_data_entry input[MAX_TEST_ENTRIES];
+        memcpy(input, g_test_data, sizeof(input));
+
+        uint8_t ref[64] = {0}, got[64] = {0};
+        size_t ref_cursor = 0, got_cursor = 0;
+
+        cnd_error_t ref_err = Run(CND_MODE_ENCODE, CND_DISPATCH_SWITCH, ref, sizeof(ref), &ref_cursor);
+        memcpy(g_test_data, input, sizeof(input));
+        cnd_error_t got_err = Run(CND_MODE_ENCODE, CND_DISPATCH_THREADED, got, sizeof(got), &got_cursor);
+
+        EXPECT_EQ(ref_err, got_err);
+        EXPECT_EQ(ref_cursor, got_cursor);
+        EXPECT_EQ(0, memcmp(ref, got, sizeof(ref)));
+        if (ref_err != CND_ERR_OK) return ref_err;
+
+        test_data_entry decoded[MAX_TEST_ENTRIES];
+        clear_test_data();
+        cnd_error_t ref_dec = Run(CND_MODE_DECODE, CND_DISPATCH_SWITCH, ref, ref_cursor, &ref_cursor);
+        memcpy(decoded, g_test_data, sizeof(decoded));
+
+        clear_test_data();
+        cnd_error_t got_dec = Run(CND_MODE_DECODE, CND_DISPATCH_THREADED, ref, got_cursor, &got_cursor);
+
+        EXPECT_EQ(ref_dec, got_dec);
+        EXPECT_EQ(ref_cursor, got_cursor);
+        for (int i = 0; i < MAX_TEST_ENTRIES; i++) {
+            EXPECT_EQ(decoded[i].key, g_test_data[i].key) << "entry " << i;
+            EXPECT_EQ(decoded[i].u64_val, g_test_data[i].u64_val) << "entry " << i;
+            EXPECT_STREQ(decoded[i].string_val, g_test_data[i].string_val) << "entry " << i;
+        }
+        return ref_err;
+    }
+};
+
+TEST_F(DispatchTest, RejectsUnknownStrategy) {
+    CompileAndLoad("packet P { uint8 a; }");
+    uint8_t buf[4];
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), test_io_callback, NULL);
+    EXPECT_EQ(cnd_execute_dispatch(&ctx, (cnd_dispatch_t)99), CND_ERR_INVALID_OP);
+}
+
+TEST_F(DispatchTest, BitfieldsRealignBeforeByteFields) {
+    if (!HasThreaded()) GTEST_SKIP() << "threaded dispatch not compiled in";
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 a : 3; uint8 b : 2;"
+        "  uint16 c;"
+        "  uint8 d : 1;"
+        "  uint8 bytes[2];"
+        "  uint8 e : 4;"
+        "  string s prefix uint8;"
+        "}"
+    );
+    Set("a", 5); Set("b", 2); Set("c", 0xBEEF); Set("d", 1);
+    Set("bytes", 0x5A); Set("e", 9); Set("s", 0, 0, "ok");
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+}
+
+TEST_F(DispatchTest, ControlFlowAndValidation) {
+    if (!HasThreaded()) GTEST_SKIP() << "threaded dispatch not compiled in";
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 kind;"
+        "  switch (kind) {"
+        "    case 1: uint16 one;"
+        "    case 2: uint32 two;"
+        "    default: uint8 other;"
+        "  }"
+        "  @range(0, 10) uint8 r;"
+        "  if (kind == 2) { uint8 extra; }"
+        "  @crc(32) uint32 crc;"
+        "}"
+    );
+    Set("kind", 2); Set("two", 0xCAFEBABE); Set("r", 7); Set("extra", 3);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+
+    clear_test_data();
+    Set("kind", 1); Set("one", 0x1234); Set("r", 11);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_VALIDATION);
+}
+
+TEST_F(DispatchTest, TransformsAcrossByteOrders) {
+    if (!HasThreaded()) GTEST_SKIP() << "threaded dispatch not compiled in";
+    CompileAndLoad(
+        "packet P {"
+        "  @mul(10) @add(5) uint8 val1;"
+        "  @big_endian @div(2) @sub(1) uint16 val2;"
+        "  uint32 plain_be;"
+        "  @little_endian @scale(0.5) @offset(100.0) float val3;"
+        "  @poly(5.0, 2.0, 0.5) int16 val4;"
+        "  @big_endian @spline(0.0, 0.0, 10.0, 100.0, 20.0, 400.0) uint32 val5;"
+        "  @little_endian int64 plain_le;"
+        "  @big_endian double f;"
+        "}"
+    );
+    Set("val1", 55); Set("val2", 9); Set("plain_be", 0x01020304); Set("val3", 0, 110.0);
+    Set("val4", 0, 23.0); Set("val5", 0, 250.0); Set("plain_le", (uint64_t)-2); Set("f", 0, 6.5);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+}
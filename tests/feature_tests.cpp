@@ -288,7 +288,37 @@ TEST_F(ConcordiaTest, SwitchEnumSugar) {
     EXPECT_EQ(local_buffer[1], 0x11);
 }
 
-class EnumTest : public ConcordiaTest {};
+class EnumTest : public ConcordiaTest {
+protected:
+    std::vector<cnd_insn> insns;
+    cnd_prepared prepared;
+
+    void Prepare() {
+        size_t cap = 0;
+        ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+        insns.resize(cap > 0 ? cap : 1);
+        ASSERT_EQ(cnd_program_prepare(&prepared, &program, insns.data(), cap), CND_ERR_OK);
+    }
+
+    bool UsesOp(uint8_t op) {
+        for (size_t i = 0; i < prepared.insn_count; i++) {
+            if (insns[i].op == op) return true;
+        }
+        return false;
+    }
+
+    // Decodes a single little-endian value of `size` bytes with both
+    // interpreters, which must agree
+    cnd_error_t Check(uint64_t value, size_t size) {
+        uint8_t buf[8];
+        for (size_t i = 0; i < size; i++) buf[i] = (uint8_t)(value >> (i * 8));
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buf, size, test_io_callback, NULL);
+        cnd_error_t err = cnd_execute(&ctx);
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buf, size, test_io_callback, NULL);
+        EXPECT_EQ(cnd_execute_prepared(&ctx, &prepared), err) << value;
+        return err;
+    }
+};
 
 TEST_F(EnumTest, BasicEnum) {
     CompileAndLoad(
@@ -417,6 +447,73 @@ TEST_F(EnumTest, EnumEndianness) {
     EXPECT_EQ(m_buffer[3], 0x12);
 }
 
+TEST_F(EnumTest, ContiguousValuesUseRangeCheck) {
+    CompileAndLoad("enum E : uint8 { A = 3, B = 4, C = 5, D = 6, E2 = 7 } packet P { E e; }");
+    Prepare();
+    EXPECT_TRUE(UsesOp(OP_RANGE_CHECK));
+    EXPECT_FALSE(UsesOp(OP_ENUM_CHECK));
+
+    for (uint64_t v = 3; v <= 7; v++) EXPECT_EQ(Check(v, 1), CND_ERR_OK) << v;
+    EXPECT_EQ(Check(2, 1), CND_ERR_VALIDATION);
+    EXPECT_EQ(Check(8, 1), CND_ERR_VALIDATION);
+}
+
+TEST_F(EnumTest, DenseValuesUseBitmap) {
+    CompileAndLoad("enum E : int16 { A = -5, B = -1, C = 0, D = 7, E2 = 100, F = 200 } packet P { E e; }");
+    Prepare();
+    EXPECT_TRUE(UsesOp(OP_ENUM_BITMAP));
+
+    const int16_t valid[] = { -5, -1, 0, 7, 100, 200 };
+    for (int16_t v : valid) EXPECT_EQ(Check((uint16_t)v, 2), CND_ERR_OK) << v;
+    const int16_t invalid[] = { -6, -4, 1, 99, 201, 0x7FFF, -0x8000 };
+    for (int16_t v : invalid) EXPECT_EQ(Check((uint16_t)v, 2), CND_ERR_VALIDATION) << v;
+}
+
+TEST_F(EnumTest, SparseValuesUseSortedTable) {
+    std::string src = "enum E : int32 {";
+    std::vector<int32_t> values;
+    for (int i = 0; i < 40; i++) {
+        int32_t v = (i % 2 ? -1 : 1) * (i * i * 1000 + 7);
+        values.push_back(v);
+        src += " V" + std::to_string(i) + " = " + std::to_string(v) + ",";
+    }
+    src.back() = '}';
+    src += " packet P { E e; }";
+    CompileAndLoad(src.c_str());
+    Prepare();
+    EXPECT_TRUE(UsesOp(OP_ENUM_SORTED));
+
+    for (int32_t v : values) {
+        EXPECT_EQ(Check((uint32_t)v, 4), CND_ERR_OK) << v;
+        EXPECT_EQ(Check((uint32_t)(v + 1), 4), CND_ERR_VALIDATION) << v + 1;
+    }
+    EXPECT_EQ(Check(0, 4), CND_ERR_VALIDATION);
+    EXPECT_EQ(Check(0xFFFFFFFF, 4), CND_ERR_VALIDATION);
+}
+
+TEST_F(EnumTest, FewSparseValuesStayLinear) {
+    CompileAndLoad("enum E : uint32 { A = 1, B = 100000, C = 4000000000 } packet P { E e; }");
+    Prepare();
+    EXPECT_TRUE(UsesOp(OP_ENUM_CHECK));
+
+    EXPECT_EQ(Check(100000, 4), CND_ERR_OK);
+    EXPECT_EQ(Check(4000000000u, 4), CND_ERR_OK);
+    EXPECT_EQ(Check(2, 4), CND_ERR_VALIDATION);
+}
+
+TEST_F(EnumTest, EnumInStructKeepsFieldPrefixes) {
+    // Fields after the enum check must still get the struct prefix
+    CompileAndLoad(
+        "enum C : uint8 { A = 1, B = 5 }"
+        "struct S { C c; @range(0, 9) uint8 x; @const(7) uint8 k; uint8 y; }"
+        "packet P { S s; }"
+    );
+    EXPECT_NE(cnd_get_key_id(&program, "s.c"), 0xFFFF);
+    EXPECT_NE(cnd_get_key_id(&program, "s.x"), 0xFFFF);
+    EXPECT_NE(cnd_get_key_id(&program, "s.k"), 0xFFFF);
+    EXPECT_NE(cnd_get_key_id(&program, "s.y"), 0xFFFF);
+}
+
 class StringArrayTest : public ConcordiaTest {};
 
 TEST_F(StringArrayTest, LenAlias) {
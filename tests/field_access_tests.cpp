@@ -0,0 +1,197 @@
+#include "test_common.h"
+
+// cnd_field_read / cnd_field_write must agree with a full decode, whether the
+// field comes from the static layout table or from a decode scan.
+
+class FieldAccessTest : public ConcordiaTest {
+protected:
+    uint16_t Key(const char* name) {
+        uint16_t key = cnd_get_key_id(&program, name);
+        EXPECT_NE(key, 0xFFFF) << name;
+        return key;
+    }
+
+    bool InLayout(const char* name) {
+        uint16_t key = Key(name);
+        for (uint16_t i = 0; i < program.layout_count; i++) {
+            const uint8_t* e = program.layout + i * CND_LAYOUT_ENTRY_SIZE;
+            if ((uint16_t)(e[0] | (e[1] << 8)) == key) return true;
+        }
+        return false;
+    }
+
+    uint64_t Read(const uint8_t* buf, size_t len, const char* name) {
+        uint64_t v = 0;
+        EXPECT_EQ(cnd_field_read(&program, buf, len, Key(name), &v), CND_ERR_OK) << name;
+        return v;
+    }
+
+    static uint64_t F64Bits(double d) {
+        uint64_t v;
+        memcpy(&v, &d, 8);
+        return v;
+    }
+
+    // Decodes `buf` with the regular VM and returns the value seen for `name`
+    uint64_t Decode(uint8_t* buf, size_t len, const char* name) {
+        clear_test_data();
+        cnd_init(&ctx, CND_MODE_DECODE, &program, buf, len, test_io_callback, NULL);
+        g_test_data[0].key = Key(name);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        return g_test_data[0].u64_val;
+    }
+};
+
+TEST_F(FieldAccessTest, StaticLayoutFields) {
+    CompileAndLoad(
+        "struct Vec { int16 x; int16 y; }"
+        "packet P {"
+        "  uint8 version;"
+        "  @big_endian uint16 id;"
+        "  @little_endian int32 temp;"
+        "  uint8 mode : 3;"
+        "  int8 delta : 5;"
+        "  Vec pos;"
+        "  uint8 pad[3];"
+        "  float ratio;"
+        "  @big_endian uint64 stamp;"
+        "}"
+    );
+    EXPECT_GT(program.layout_count, 0);
+    EXPECT_TRUE(InLayout("version"));
+    EXPECT_TRUE(InLayout("delta"));
+    EXPECT_TRUE(InLayout("pos.y"));
+    EXPECT_TRUE(InLayout("ratio"));
+    EXPECT_TRUE(InLayout("stamp"));
+
+    float ratio = 0.75f;
+    uint8_t buf[32] = {
+        7,                      // version
+        0x12, 0x34,             // id (BE)
+        0xD8, 0xFF, 0xFF, 0xFF, // temp = -40
+        (uint8_t)(5 | (0x1E << 3)), // mode = 5, delta = -2
+        0x01, 0x00, 0xFE, 0xFF, // pos = {1, -2}
+        0, 0, 0,                // pad
+    };
+    memcpy(buf + 15, &ratio, 4);
+    const uint8_t stamp[8] = {0, 0, 0, 0, 0, 0, 0x01, 0x02};
+    memcpy(buf + 19, stamp, 8);
+
+    EXPECT_EQ(Read(buf, 27, "version"), 7u);
+    EXPECT_EQ(Read(buf, 27, "id"), 0x1234u);
+    EXPECT_EQ((int64_t)Read(buf, 27, "temp"), -40);
+    EXPECT_EQ(Read(buf, 27, "mode"), 5u);
+    EXPECT_EQ((int64_t)Read(buf, 27, "delta"), -2);
+    EXPECT_EQ(Read(buf, 27, "pos.x"), 1u);
+    EXPECT_EQ((int64_t)Read(buf, 27, "pos.y"), -2);
+    EXPECT_EQ(Read(buf, 27, "ratio"), F64Bits(0.75));
+    EXPECT_EQ(Read(buf, 27, "stamp"), 0x0102u);
+
+    // Patches land where the decoder looks for them
+    EXPECT_EQ(cnd_field_write(&program, buf, 27, Key("id"), 0xBEEF), CND_ERR_OK);
+    EXPECT_EQ(cnd_field_write(&program, buf, 27, Key("delta"), (uint64_t)-16), CND_ERR_OK);
+    EXPECT_EQ(cnd_field_write(&program, buf, 27, Key("ratio"), F64Bits(-1.5)), CND_ERR_OK);
+    EXPECT_EQ(buf[1], 0xBE);
+    EXPECT_EQ(buf[2], 0xEF);
+    EXPECT_EQ(Decode(buf, 27, "mode"), 5u);
+    EXPECT_EQ((int64_t)Decode(buf, 27, "delta"), -16);
+    EXPECT_EQ(Read(buf, 27, "ratio"), F64Bits(-1.5));
+
+    // Values must fit the field; truncated buffers are rejected
+    EXPECT_EQ(cnd_field_write(&program, buf, 27, Key("mode"), 8), CND_ERR_VALIDATION);
+    EXPECT_EQ(cnd_field_write(&program, buf, 27, Key("delta"), 16), CND_ERR_VALIDATION);
+    uint64_t v;
+    EXPECT_EQ(cnd_field_read(&program, buf, 20, Key("stamp"), &v), CND_ERR_OOB);
+}
+
+TEST_F(FieldAccessTest, DynamicFieldsFallBackToScan) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 kind;"
+        "  string name prefix uint8;"
+        "  uint16 after;"
+        "  switch (kind) {"
+        "    case 1: uint8 one;"
+        "    case 2: @big_endian uint32 two;"
+        "  }"
+        "  uint8 items[] prefix uint8;"
+        "  uint8 tail : 4;"
+        "}"
+    );
+    EXPECT_TRUE(InLayout("kind"));
+    EXPECT_FALSE(InLayout("after"));
+    EXPECT_FALSE(InLayout("two"));
+
+    uint8_t buf[] = {
+        2,                      // kind
+        3, 'a', 'b', 'c',       // name
+        0x34, 0x12,             // after
+        0xCA, 0xFE, 0xBA, 0xBE, // two (BE)
+        2, 9, 8,                // items
+        0x0B,                   // tail
+    };
+    size_t len = sizeof(buf);
+
+    EXPECT_EQ(Read(buf, len, "after"), 0x1234u);
+    EXPECT_EQ(Read(buf, len, "two"), 0xCAFEBABEu);
+    EXPECT_EQ(Read(buf, len, "items"), 9u); // First element
+    EXPECT_EQ(Read(buf, len, "tail"), 0x0Bu);
+
+    // The untaken case and non-scalar keys are not fields of this buffer
+    uint64_t v;
+    EXPECT_EQ(cnd_field_read(&program, buf, len, Key("one"), &v), CND_ERR_VALIDATION);
+    EXPECT_EQ(cnd_field_read(&program, buf, len, Key("name"), &v), CND_ERR_VALIDATION);
+    EXPECT_EQ(cnd_field_read(&program, buf, len, 0xFFF0, &v), CND_ERR_VALIDATION);
+
+    EXPECT_EQ(cnd_field_write(&program, buf, len, Key("two"), 0x01020304), CND_ERR_OK);
+    EXPECT_EQ(buf[7], 0x01);
+    EXPECT_EQ(buf[10], 0x04);
+    EXPECT_EQ(cnd_field_write(&program, buf, len, Key("tail"), 3), CND_ERR_OK);
+    EXPECT_EQ(Decode(buf, len, "tail"), 3u);
+    EXPECT_EQ(Decode(buf, len, "two"), 0x01020304u);
+}
+
+TEST_F(FieldAccessTest, ExpressionAndConstFields) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 len;"
+        "  @expr(len * 2) uint16 doubled;"
+        "  @const(5) uint8 magic;"
+        "  @scale(0.5) uint8 scaled;"
+        "}"
+    );
+    EXPECT_TRUE(InLayout("doubled"));
+    EXPECT_TRUE(InLayout("magic"));
+
+    uint8_t buf[] = {4, 8, 0, 5, 21};
+    EXPECT_EQ(Read(buf, sizeof(buf), "doubled"), 8u);
+    EXPECT_EQ(Read(buf, sizeof(buf), "magic"), 5u);
+    EXPECT_EQ(Read(buf, sizeof(buf), "scaled"), 21u); // Raw wire value
+}
+
+TEST_F(FieldAccessTest, VersionOneImagesUseScan) {
+    CompileAndLoad("packet P { uint8 a; @big_endian uint16 b; uint8 c : 2; }");
+    ASSERT_GT(program.layout_count, 0);
+
+    // Same image with a v1 header: the layout table is ignored
+    std::vector<uint8_t> v1 = il_buffer;
+    v1[5] = 1;
+    cnd_program old;
+    ASSERT_EQ(cnd_program_load_il(&old, v1.data(), v1.size()), CND_ERR_OK);
+    EXPECT_EQ(old.layout, nullptr);
+    EXPECT_EQ(old.layout_count, 0);
+
+    uint8_t buf[] = {9, 0xAB, 0xCD, 0x02};
+    uint64_t v = 0;
+    EXPECT_EQ(cnd_field_read(&old, buf, sizeof(buf), Key("b"), &v), CND_ERR_OK);
+    EXPECT_EQ(v, 0xABCDu);
+    EXPECT_EQ(cnd_field_read(&old, buf, sizeof(buf), Key("c"), &v), CND_ERR_OK);
+    EXPECT_EQ(v, 2u);
+
+    // Unknown versions and truncated layout sections are rejected
+    v1[5] = 4;
+    EXPECT_EQ(cnd_program_load_il(&old, v1.data(), v1.size()), CND_ERR_INVALID_OP);
+    std::vector<uint8_t> bad = il_buffer;
+    bad[20] = 0xFF;
+    EXPECT_EQ(cnd_program_load_il(&old, bad.data(), bad.size()), CND_ERR_OOB);
+}
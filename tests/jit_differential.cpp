@@ -0,0 +1,84 @@
+#include "test_common.h"
+#include <vector>
+
+#undef cnd_execute
+
+// Built into jit_differential_runner together with the opcode and feature
+// suites: every cnd_execute() those tests make also runs the program through
+// cnd_program_jit() from the same starting state, and the two runs must agree
+// on result, cursor, bit offset, buffer contents and what the host saw.
+// Runs that cannot be prepared (unverifiable programs, resumed runs) are only
+// interpreted.
+
+namespace {
+
+// Host state touched by test_io_callback; other test callbacks are stateless
+struct HostState {
+    std::vector<test_data_entry> data;
+    TestContext tape;
+    bool has_tape;
+};
+
+HostState SaveHost(const cnd_vm_ctx* ctx) {
+    HostState s;
+    s.has_tape = ctx->io_callback == test_io_callback && ctx->user_ptr != NULL;
+    if (ctx->io_callback == test_io_callback) s.data.assign(g_test_data, g_test_data + MAX_TEST_ENTRIES);
+    if (s.has_tape) s.tape = *(TestContext*)ctx->user_ptr;
+    return s;
+}
+
+void RestoreHost(const cnd_vm_ctx* ctx, const HostState& s) {
+    if (!s.data.empty()) std::copy(s.data.begin(), s.data.end(), g_test_data);
+    if (s.has_tape) *(TestContext*)ctx->user_ptr = s.tape;
+}
+
+void ExpectSameHost(const HostState& ref, const HostState& jit) {
+    ASSERT_EQ(ref.data.size(), jit.data.size());
+    for (size_t i = 0; i < ref.data.size(); i++) {
+        EXPECT_EQ(ref.data[i].key, jit.data[i].key) << "entry " << i;
+        EXPECT_EQ(ref.data[i].u64_val, jit.data[i].u64_val) << "entry " << i;
+        EXPECT_EQ(0, memcmp(&ref.data[i].f64_val, &jit.data[i].f64_val, sizeof(double))) << "entry " << i;
+        EXPECT_STREQ(ref.data[i].string_val, jit.data[i].string_val) << "entry " << i;
+    }
+    if (ref.has_tape) {
+        EXPECT_EQ(ref.tape.tape_index, jit.tape.tape_index);
+    }
+}
+
+} // namespace
+
+cnd_error_t jit_differential_execute(cnd_vm_ctx* ctx) {
+    if (!ctx || !ctx->program || !ctx->data_buffer || ctx->ip != 0) return cnd_execute(ctx);
+
+    size_t cap = 0;
+    if (cnd_program_prepare_size(ctx->program, &cap) != CND_ERR_OK) return cnd_execute(ctx);
+    std::vector<cnd_insn> storage(cap > 0 ? cap : 1);
+    cnd_prepared prepared;
+    if (cnd_program_prepare(&prepared, ctx->program, storage.data(), cap) != CND_ERR_OK) return cnd_execute(ctx);
+    cnd_jit jit;
+    EXPECT_EQ(cnd_program_jit(&jit, &prepared), CND_ERR_OK);
+    if (!jit.code) return cnd_execute(ctx);
+
+    const cnd_vm_ctx start = *ctx;
+    const HostState host = SaveHost(ctx);
+    std::vector<uint8_t> buffer(ctx->data_buffer, ctx->data_buffer + ctx->data_len);
+
+    // Generated code first, then the reference run is left in place for the test
+    cnd_error_t jit_err = cnd_execute_jit(ctx, &jit);
+    const cnd_vm_ctx jit_end = *ctx;
+    const HostState jit_host = SaveHost(ctx);
+    std::vector<uint8_t> jit_buffer(ctx->data_buffer, ctx->data_buffer + ctx->data_len);
+    cnd_jit_free(&jit);
+
+    *ctx = start;
+    RestoreHost(ctx, host);
+    std::copy(buffer.begin(), buffer.end(), ctx->data_buffer);
+    cnd_error_t err = cnd_execute(ctx);
+
+    EXPECT_EQ(err, jit_err);
+    EXPECT_EQ(ctx->cursor, jit_end.cursor);
+    EXPECT_EQ(ctx->bit_offset, jit_end.bit_offset);
+    EXPECT_EQ(0, memcmp(ctx->data_buffer, jit_buffer.data(), jit_buffer.size()));
+    ExpectSameHost(SaveHost(ctx), jit_host);
+    return err;
+}
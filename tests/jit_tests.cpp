@@ -0,0 +1,362 @@
+#include "test_common.h"
+#include <cstddef>
+#include <vector>
+
+// Generated code must behave exactly like the bytecode interpreter. These
+// tests compare the two directly; with CND_JIT the opcode and feature suites
+// additionally run every cnd_execute() through jit_differential_runner.
+
+class JitTest : public ConcordiaTest {
+protected:
+    cnd_prepared prepared;
+    std::vector<cnd_insn> storage;
+    cnd_jit jit;
+
+    void SetUp() override {
+        ConcordiaTest::SetUp();
+        memset(&jit, 0, sizeof(jit));
+    }
+
+    void TearDown() override {
+        cnd_jit_free(&jit);
+    }
+
+    // Prepares and compiles the loaded program; false when the JIT is not built in
+    bool Jit() {
+        size_t cap = 0;
+        EXPECT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+        storage.resize(cap > 0 ? cap : 1);
+        EXPECT_EQ(cnd_program_prepare(&prepared, &program, storage.data(), cap), CND_ERR_OK);
+        cnd_jit_free(&jit);
+        cnd_error_t err = cnd_program_jit(&jit, &prepared);
+        if (err == CND_ERR_INVALID_OP) return false;
+        EXPECT_EQ(err, CND_ERR_OK);
+        return err == CND_ERR_OK;
+    }
+
+    cnd_error_t Run(cnd_mode_t mode, bool use_jit, uint8_t* buf, size_t len, size_t* cursor) {
+        cnd_init(&ctx, mode, &program, buf, len, test_io_callback, NULL);
+        cnd_error_t err = use_jit ? cnd_execute_jit(&ctx, &jit) : cnd_execute(&ctx);
+        *cursor = ctx.cursor;
+        return err;
+    }
+
+    void Set(const char* name, uint64_t u64, double f64 = 0.0, const char* str = "") {
+        uint16_t key = cnd_get_key_id(&program, name);
+        ASSERT_NE(key, 0xFFFF) << name;
+        for (int i = 0; i < MAX_TEST_ENTRIES; i++) {
+            if (g_test_data[i].key == 0xFFFF || g_test_data[i].key == key) {
+                g_test_data[i] = test_data_entry(key, u64, f64, str);
+                return;
+            }
+        }
+        FAIL() << "Out of test entries";
+    }
+
+    // Encodes the current g_test_data with the interpreter and the JIT, then
+    // decodes the reference output with both. Returns the encode result.
+    cnd_error_t ExpectSameRoundTrip() {
+        test_data_entry input[MAX_TEST_ENTRIES];
+        memcpy(input, g_test_data, sizeof(input));
+
+        uint8_t ref[64] = {0}, got[64] = {0};
+        size_t ref_cursor = 0, got_cursor = 0;
+
+        cnd_error_t ref_err = Run(CND_MODE_ENCODE, false, ref, sizeof(ref), &ref_cursor);
+        memcpy(g_test_data, input, sizeof(input));
+        cnd_error_t got_err = Run(CND_MODE_ENCODE, true, got, sizeof(got), &got_cursor);
+
+        EXPECT_EQ(ref_err, got_err);
+        EXPECT_EQ(ref_cursor, got_cursor);
+        EXPECT_EQ(0, memcmp(ref, got, sizeof(ref)));
+        if (ref_err != CND_ERR_OK) return ref_err;
+
+        test_data_entry decoded[MAX_TEST_ENTRIES];
+        clear_test_data();
+        cnd_error_t ref_dec = Run(CND_MODE_DECODE, false, ref, ref_cursor, &ref_cursor);
+        memcpy(decoded, g_test_data, sizeof(decoded));
+
+        clear_test_data();
+        cnd_error_t got_dec = Run(CND_MODE_DECODE, true, ref, got_cursor, &got_cursor);
+
+        EXPECT_EQ(ref_dec, got_dec);
+        EXPECT_EQ(ref_cursor, got_cursor);
+        for (int i = 0; i < MAX_TEST_ENTRIES; i++) {
+            EXPECT_EQ(decoded[i].key, g_test_data[i].key) << "entry " << i;
+            EXPECT_EQ(decoded[i].u64_val, g_test_data[i].u64_val) << "entry " << i;
+            EXPECT_EQ(0, memcmp(&decoded[i].f64_val, &g_test_data[i].f64_val, sizeof(double))) << "entry " << i;
+            EXPECT_STREQ(decoded[i].string_val, g_test_data[i].string_val) << "entry " << i;
+        }
+        return ref_err;
+    }
+};
+
+#define REQUIRE_JIT() \
+    if (!Jit()) GTEST_SKIP() << "JIT not compiled in"
+
+TEST_F(JitTest, UnsupportedBuildsReportInvalidOp) {
+    CompileAndLoad("packet P { uint8 a; }");
+    if (Jit()) GTEST_SKIP() << "JIT compiled in";
+
+    EXPECT_EQ(jit.code, nullptr);
+    uint8_t buf[4] = {0};
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), test_io_callback, NULL);
+    EXPECT_EQ(cnd_execute_jit(&ctx, &jit), CND_ERR_INVALID_OP);
+}
+
+TEST_F(JitTest, Primitives) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 a; int16 b; @big_endian uint32 c; uint64 d;"
+        "  float e; @big_endian double f; bool g; int8 h; @big_endian int16 i;"
+        "}"
+    );
+    REQUIRE_JIT();
+
+    Set("a", 0x12); Set("b", (uint64_t)-1234); Set("c", 0xDEADBEEF); Set("d", 0x0102030405060708ULL);
+    Set("e", 0, 1.5); Set("f", 0, -2.25); Set("g", 1); Set("h", (uint64_t)-7); Set("i", 0x1234);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+}
+
+TEST_F(JitTest, ControlFlowAndHelpers) {
+    // Arrays, switches, branches, integer transforms and bitfields run
+    // through the prepared executor between native fields
+    CompileAndLoad(
+        "struct Item { uint16 id; @scale(0.5) uint8 v; }"
+        "packet P {"
+        "  uint8 type;"
+        "  uint8 a : 3; uint8 b : 5;"
+        "  switch (type) {"
+        "    case 1: uint32 one;"
+        "    case 2: @mul(10) uint16 two;"
+        "    default: uint8 other;"
+        "  }"
+        "  Item items[] prefix uint8;"
+        "  if (type > 1) { uint16 big; } else { uint8 small; }"
+        "  string s prefix uint8;"
+        "  @crc(32) uint32 c;"
+        "}"
+    );
+    REQUIRE_JIT();
+
+    for (uint64_t type = 1; type <= 3; type++) {
+        clear_test_data();
+        Set("type", type); Set("a", 5); Set("b", 17);
+        Set("one", 0xCAFEBABE); Set("two", 420); Set("other", 9);
+        Set("items", 2); Set("items.id", 0x4242); Set("items.v", 0, 3.5);
+        Set("big", 0xBEEF); Set("small", 3); Set("s", 0, 0, "jit");
+        EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK) << "type " << type;
+    }
+}
+
+TEST_F(JitTest, ScaledFieldsAndCrc) {
+    // Linear transforms and CRC fields are generated inline; 64-bit unsigned
+    // scaled fields still take the prepared executor
+    CompileAndLoad(
+        "packet P {"
+        "  @crc_begin @scale(0.5) @offset(-10.0) uint8 a;"
+        "  @scale(0.25) int8 b;"
+        "  @big_endian @scale(0.01) int16 c;"
+        "  @scale(2.0) @offset(1.5) uint16 d;"
+        "  @big_endian @scale(0.001) uint32 e;"
+        "  @scale(0.5) int32 f;"
+        "  @scale(3.0) @offset(-1.0) int64 g;"
+        "  @scale(2.0) uint64 h;"
+        "  @scale(0.5) @offset(100.0) float i;"
+        "  @big_endian @scale(0.5) @offset(100.0) double j;"
+        "  uint8 k : 3;"
+        "  @crc_end @crc(16) uint16 c16;"
+        "  @big_endian @crc(32) uint32 c32;"
+        "}"
+    );
+    REQUIRE_JIT();
+
+    Set("a", 0, 20.5); Set("b", 0, -3.25); Set("c", 0, -123.45); Set("d", 0, 901.5);
+    Set("e", 0, 4000000.125); Set("f", 0, -7777.5); Set("g", 0, 299.0); Set("h", 0, 88.0);
+    Set("i", 0, 42.75); Set("j", 0, -1e6); Set("k", 5);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+
+    // A damaged packet is rejected the same way, as is one cut before a CRC
+    uint8_t buf[64] = {0};
+    size_t len = 0, ref_cursor = 0, got_cursor = 0;
+    ASSERT_EQ(Run(CND_MODE_ENCODE, false, buf, sizeof(buf), &len), CND_ERR_OK);
+    for (size_t at : {(size_t)1, len - 5, len - 1}) {
+        buf[at] ^= 0x20;
+        cnd_error_t ref = Run(CND_MODE_DECODE, false, buf, len, &ref_cursor);
+        cnd_error_t got = Run(CND_MODE_DECODE, true, buf, len, &got_cursor);
+        EXPECT_EQ(ref, CND_ERR_CRC_MISMATCH) << "byte " << at;
+        EXPECT_EQ(ref, got) << "byte " << at;
+        buf[at] ^= 0x20;
+    }
+    for (size_t cut : {len - 1, len - 5}) {
+        cnd_error_t ref = Run(CND_MODE_DECODE, false, buf, cut, &ref_cursor);
+        cnd_error_t got = Run(CND_MODE_DECODE, true, buf, cut, &got_cursor);
+        EXPECT_EQ(ref, CND_ERR_OOB) << "len " << cut;
+        EXPECT_EQ(ref, got) << "len " << cut;
+        EXPECT_EQ(ref_cursor, got_cursor) << "len " << cut;
+    }
+}
+
+TEST_F(JitTest, Expressions) {
+    for (int opt = 0; opt <= 1; opt++) {
+        CompileAndLoad(
+            "packet P {"
+            "  uint8 x;"
+            "  uint8 d;"
+            "  @expr(x * 3 + 7) uint16 y;"
+            "  if (x > 10 && x != d) { uint8 big; } else { uint8 small; }"
+            "  @expr(x / d) uint8 q;"
+            "}", opt);
+        REQUIRE_JIT();
+
+        clear_test_data();
+        Set("x", 21); Set("d", 4); Set("big", 9); Set("small", 1);
+        EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK) << "-O" << opt;
+
+        Set("d", 0);
+        EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_ARITHMETIC) << "-O" << opt;
+    }
+}
+
+TEST_F(JitTest, Errors) {
+    CompileAndLoad("packet P { uint16 a; uint32 b; }");
+    REQUIRE_JIT();
+
+    // Missing host value
+    Set("a", 1);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_CALLBACK);
+
+    // Short buffers fail on the same field
+    Set("b", 2);
+    uint8_t buf[6] = {0};
+    for (size_t len = 0; len < sizeof(buf); len++) {
+        size_t ref_cursor = 0, got_cursor = 0;
+        cnd_error_t ref = Run(CND_MODE_DECODE, false, buf, len, &ref_cursor);
+        cnd_error_t got = Run(CND_MODE_DECODE, true, buf, len, &got_cursor);
+        EXPECT_EQ(ref, CND_ERR_OOB) << "len " << len;
+        EXPECT_EQ(ref, got) << "len " << len;
+        EXPECT_EQ(ref_cursor, got_cursor) << "len " << len;
+    }
+}
+
+TEST_F(JitTest, OptionalTail) {
+    CompileAndLoad("packet P { uint8 a; @optional uint16 b; }");
+    REQUIRE_JIT();
+
+    // The missing optional field takes the slow path and is reported as zero
+    uint8_t buf[1] = {0x7F};
+    g_test_data[0].key = cnd_get_key_id(&program, "b");
+    g_test_data[0].u64_val = 0xAA;
+    size_t cursor = 0;
+    ASSERT_EQ(Run(CND_MODE_DECODE, true, buf, sizeof(buf), &cursor), CND_ERR_OK);
+    EXPECT_EQ(cursor, 1u);
+    EXPECT_EQ(g_test_data[0].u64_val, 0u);
+}
+
+TEST_F(JitTest, ResumesFromInstructionIndex) {
+    CompileAndLoad("packet P { uint8 a; uint8 b; }");
+    REQUIRE_JIT();
+
+    uint16_t key_b = cnd_get_key_id(&program, "b");
+    size_t idx_b = prepared.insn_count;
+    for (size_t i = 0; i < prepared.insn_count; i++) {
+        if (prepared.insns[i].op == OP_IO_U8 && prepared.insns[i].key == key_b) idx_b = i;
+    }
+    ASSERT_LT(idx_b, prepared.insn_count);
+
+    Set("a", 1); Set("b", 2);
+    uint8_t buf[4] = {0};
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), test_io_callback, NULL);
+    ctx.ip = idx_b;
+    EXPECT_EQ(cnd_execute_jit(&ctx, &jit), CND_ERR_OK);
+    EXPECT_EQ(ctx.cursor, 1u);
+    EXPECT_EQ(buf[0], 2);
+
+    ctx.ip = prepared.insn_count + 1;
+    EXPECT_EQ(cnd_execute_jit(&ctx, &jit), CND_ERR_OOB);
+}
+
+TEST_F(JitTest, BoundFieldsMatchInterpreter) {
+    // Plain struct fields are stored inline; array elements, conversions and
+    // scaled fields still go through cnd_bind_io
+    struct Pt { int16_t x; uint32_t y; };
+    struct Host { uint8_t a; int16_t b; uint32_t c; double d; float e; Pt p1; Pt p2; uint16_t arr[3]; uint32_t conv; double s; uint64_t u; };
+    for (int opt = 0; opt <= 1; opt++) {
+        CompileAndLoad(
+            "struct Pt { int16 x; @big_endian uint32 y; }"
+            "packet P { uint8 a; int16 b; @big_endian uint32 c; double d; float e; Pt p1; Pt p2;"
+            "  uint16 arr[3]; uint16 conv; @scale(0.5) uint8 s; uint64 u; }", opt);
+        REQUIRE_JIT();
+
+        cnd_binding table[32] = {};
+        const struct { const char* name; cnd_binding e; } binds[] = {
+            {"a", {offsetof(Host, a), 0, 0, 0, OP_IO_U8, 0}},
+            {"b", {offsetof(Host, b), 0, 0, 0, OP_IO_I16, 0}},
+            {"c", {offsetof(Host, c), 0, 0, 0, OP_IO_U32, 0}},
+            {"d", {offsetof(Host, d), 0, 0, 0, OP_IO_F64, 0}},
+            {"e", {offsetof(Host, e), 0, 0, 0, OP_IO_F32, 0}},
+            {"p1", {offsetof(Host, p1), 0, 0, 0, OP_ENTER_STRUCT, 0}},
+            {"p2", {offsetof(Host, p2), 0, 0, 0, OP_ENTER_STRUCT, 0}},
+            {"p1.x", {offsetof(Pt, x), 0, 0, 0, OP_IO_I16, 0}},
+            {"p1.y", {offsetof(Pt, y), 0, 0, 0, OP_IO_U32, 0}},
+            {"p2.x", {offsetof(Pt, x), 0, 0, 0, OP_IO_I16, 0}},
+            {"p2.y", {offsetof(Pt, y), 0, 0, 0, OP_IO_U32, 0}},
+            {"arr", {offsetof(Host, arr), sizeof(uint16_t), 3, 0, OP_IO_U16, 0}},
+            {"conv", {offsetof(Host, conv), 0, 0, 0, OP_IO_U32, 0}},
+            {"s", {offsetof(Host, s), 0, 0, 0, OP_IO_F64, 0}},
+            {"u", {offsetof(Host, u), 0, 0, 0, OP_IO_U64, 0}},
+        };
+        for (const auto& b : binds) ASSERT_EQ(cnd_binding_set(table, 32, &program, b.name, &b.e), CND_ERR_OK) << b.name;
+
+        Host in;
+        memset(&in, 0, sizeof(in));
+        in.a = 0x12; in.b = -1234; in.c = 0xDEADBEEF; in.d = -2.25; in.e = 1.5f;
+        in.p1 = {-7, 0x01020304}; in.p2 = {300, 0xA0B0C0D0};
+        in.arr[0] = 1; in.arr[1] = 0x4242; in.arr[2] = 0xFFFF;
+        in.conv = 0xBEEF; in.s = 21.5; in.u = 0x0102030405060708ULL;
+
+        uint8_t ref[64] = {0}, got[64] = {0};
+        cnd_binder binder;
+        cnd_binder_init(&binder, table, 32, &in);
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, ref, sizeof(ref), cnd_bind_io, &binder);
+        ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        size_t len = ctx.cursor;
+        cnd_binder_init(&binder, table, 32, &in);
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, got, sizeof(got), cnd_bind_io, &binder);
+        ASSERT_EQ(cnd_execute_jit(&ctx, &jit), CND_ERR_OK);
+        EXPECT_EQ(ctx.cursor, len);
+        EXPECT_EQ(0, memcmp(ref, got, sizeof(ref))) << "-O" << opt;
+
+        Host out_ref, out_got;
+        memset(&out_ref, 0, sizeof(out_ref));
+        memset(&out_got, 0, sizeof(out_got));
+        cnd_binder_init(&binder, table, 32, &out_ref);
+        cnd_init(&ctx, CND_MODE_DECODE, &program, ref, len, cnd_bind_io, &binder);
+        ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        cnd_binder_init(&binder, table, 32, &out_got);
+        cnd_init(&ctx, CND_MODE_DECODE, &program, ref, len, cnd_bind_io, &binder);
+        ASSERT_EQ(cnd_execute_jit(&ctx, &jit), CND_ERR_OK);
+        EXPECT_EQ(ctx.cursor, len);
+        EXPECT_EQ(0, memcmp(&out_ref, &out_got, sizeof(Host))) << "-O" << opt;
+        EXPECT_EQ(0, memcmp(&out_got, &in, sizeof(Host))) << "-O" << opt;
+
+        // Unbound fields still fail through cnd_bind_io
+        cnd_binding empty[32] = {};
+        cnd_binder_init(&binder, empty, 32, &out_got);
+        cnd_init(&ctx, CND_MODE_DECODE, &program, ref, len, cnd_bind_io, &binder);
+        EXPECT_EQ(cnd_execute_jit(&ctx, &jit), CND_ERR_CALLBACK);
+    }
+}
+
+TEST_F(JitTest, FreeIsIdempotent) {
+    CompileAndLoad("packet P { uint8 a; }");
+    REQUIRE_JIT();
+
+    cnd_jit_free(&jit);
+    EXPECT_EQ(jit.code, nullptr);
+    cnd_jit_free(&jit);
+
+    uint8_t buf[1];
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), test_io_callback, NULL);
+    EXPECT_EQ(cnd_execute_jit(&ctx, &jit), CND_ERR_OOB);
+}
@@ -0,0 +1,531 @@
+#include "test_common.h"
+#include <map>
+#include <string>
+
+// `cnd compile -O` rewrites the linked bytecode. Every test compiles the
+// schema both ways and checks that the optimized program encodes the same
+// wire and reports the same fields as the plain one.
+
+struct OptEvent {
+    uint16_t key;
+    uint8_t type;
+    uint64_t value;
+    bool operator==(const OptEvent& o) const { return key == o.key && type == o.type && value == o.value; }
+};
+
+struct OptHost {
+    const std::map<uint16_t, uint64_t>* values;
+    std::vector<OptEvent> events;
+    size_t queries = 0; // Context reads the VM asked the host for
+};
+
+static size_t opt_value_size(uint8_t type) {
+    switch (type) {
+        case OP_IO_U8: case OP_IO_I8: case OP_IO_BIT_BOOL: return 1;
+        case OP_IO_U16: case OP_IO_I16: return 2;
+        case OP_IO_U32: case OP_IO_I32: return 4;
+        case OP_IO_U64: case OP_IO_I64: case OP_IO_BIT_U: return 8;
+        default: return 0;
+    }
+}
+
+// Fields take the value set for their key, or `key * 7 + 1`. Context
+// queries are answered from the same values and are not recorded, since
+// the optimizer removes the ones whose answer is known.
+static cnd_error_t opt_host_io(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, void* ptr) {
+    OptHost* h = (OptHost*)ctx->user_ptr;
+    auto it = h->values->find(key);
+    uint64_t want = it != h->values->end() ? it->second : key * 7u + 1;
+
+    if (type == OP_CTX_QUERY || type == OP_LOAD_CTX) {
+        h->queries++;
+        *(uint64_t*)ptr = want;
+        return CND_ERR_OK;
+    }
+    size_t size = opt_value_size(type);
+    uint64_t v = 0;
+    if (type == OP_STORE_CTX) {
+        v = *(uint64_t*)ptr;
+    } else if (size > 0) {
+        if (ctx->mode == CND_MODE_ENCODE) {
+            v = type == OP_IO_BIT_BOOL ? (want & 1) : want;
+            memcpy(ptr, &v, size);
+        } else {
+            memcpy(&v, ptr, size);
+        }
+    }
+    h->events.push_back({key, type, v});
+    return CND_ERR_OK;
+}
+
+class OptimizerTest : public ConcordiaTest {
+protected:
+    std::vector<uint8_t> base_il;
+    cnd_program base;
+    std::map<uint16_t, uint64_t> values;
+
+    // Loads the plain build into `base` and the optimized one into `program`
+    void CompileBoth(const char* source) {
+        CompileAndLoad(source);
+        base_il = il_buffer;
+        ASSERT_EQ(cnd_program_load_il(&base, base_il.data(), base_il.size()), CND_ERR_OK);
+        CompileAndLoad(source, 1);
+        ASSERT_EQ(cnd_verify_program(&base), CND_ERR_OK);
+        ASSERT_EQ(cnd_verify_program(&program), CND_ERR_OK);
+    }
+
+    void Set(const char* name, uint64_t v) {
+        uint16_t key = cnd_get_key_id(&program, name);
+        ASSERT_NE(key, 0xFFFF) << name;
+        values[key] = v;
+    }
+
+    // Instructions with opcode `op`, counted on the prepared form
+    size_t CountOps(const cnd_program* p, uint8_t op) {
+        std::vector<cnd_insn> insns;
+        cnd_prepared prepared;
+        size_t cap = 0;
+        EXPECT_EQ(cnd_program_prepare_size(p, &cap), CND_ERR_OK);
+        insns.resize(cap > 0 ? cap : 1);
+        EXPECT_EQ(cnd_program_prepare(&prepared, p, insns.data(), cap), CND_ERR_OK);
+        size_t n = 0;
+        for (size_t i = 0; i < prepared.insn_count; i++) {
+            if (insns[i].op == op) n++;
+        }
+        return n;
+    }
+
+    // Prepared slots, where superinstructions count as their parts
+    size_t CountInsns(const cnd_program* p) {
+        std::vector<cnd_insn> insns;
+        cnd_prepared prepared;
+        size_t cap = 0;
+        EXPECT_EQ(cnd_program_prepare_size(p, &cap), CND_ERR_OK);
+        insns.resize(cap > 0 ? cap : 1);
+        EXPECT_EQ(cnd_program_prepare(&prepared, p, insns.data(), cap), CND_ERR_OK);
+        return prepared.insn_count;
+    }
+
+    // OP_JUMPs whose target is another OP_JUMP
+    size_t CountJumpsToJumps(const cnd_program* p) {
+        std::vector<cnd_insn> insns;
+        cnd_prepared prepared;
+        size_t cap = 0;
+        EXPECT_EQ(cnd_program_prepare_size(p, &cap), CND_ERR_OK);
+        insns.resize(cap > 0 ? cap : 1);
+        EXPECT_EQ(cnd_program_prepare(&prepared, p, insns.data(), cap), CND_ERR_OK);
+        size_t n = 0;
+        for (size_t i = 0; i < prepared.insn_count; i++) {
+            if (insns[i].op == OP_JUMP && insns[i].a < prepared.insn_count && insns[insns[i].a].op == OP_JUMP) n++;
+        }
+        return n;
+    }
+
+    std::vector<uint8_t> Encode(cnd_program* p) {
+        OptHost h = {&values, {}};
+        uint8_t wire[256] = {0};
+        cnd_init(&ctx, CND_MODE_ENCODE, p, wire, sizeof(wire), opt_host_io, &h);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        return std::vector<uint8_t>(wire, wire + ctx.cursor);
+    }
+
+    std::vector<OptEvent> Decode(cnd_program* p, std::vector<uint8_t> wire) {
+        OptHost h = {&values, {}};
+        cnd_init(&ctx, CND_MODE_DECODE, p, wire.data(), wire.size(), opt_host_io, &h);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        EXPECT_EQ(ctx.cursor, wire.size());
+        return h.events;
+    }
+
+    // Both programs write the same bytes and read back the same fields
+    void ExpectSameBehaviour() {
+        std::vector<uint8_t> wire = Encode(&base);
+        EXPECT_TRUE(Encode(&program) == wire);
+        std::vector<OptEvent> events = Decode(&base, wire);
+        EXPECT_FALSE(events.empty());
+        EXPECT_TRUE(Decode(&program, wire) == events);
+    }
+};
+
+TEST_F(OptimizerTest, EndianRunsCollapse) {
+    CompileBoth(
+        "packet P {"
+        "  uint8 head;"
+        "  @big_endian uint16 a; @big_endian uint32 b; @big_endian uint16 c;"
+        "  uint16 d;"
+        "}");
+    EXPECT_EQ(CountOps(&base, OP_SET_ENDIAN_BE), 3u);
+    EXPECT_EQ(CountOps(&program, OP_SET_ENDIAN_BE), 1u);
+    EXPECT_EQ(CountOps(&program, OP_SET_ENDIAN_LE), 1u);
+    EXPECT_LT(CountInsns(&program), CountInsns(&base));
+    ExpectSameBehaviour();
+}
+
+TEST_F(OptimizerTest, PaddingMerges) {
+    CompileBoth("packet P { uint8 head; @pad(3); @pad(5); uint8 tail; }");
+    EXPECT_EQ(CountOps(&base, OP_ALIGN_PAD), 2u);
+    EXPECT_EQ(CountOps(&program, OP_ALIGN_PAD), 1u);
+    ExpectSameBehaviour();
+}
+
+TEST_F(OptimizerTest, FoldsConstantExpressions) {
+    CompileBoth("packet P { uint8 head; @expr(2 * 3 + 1) uint8 seven; @expr(head * 2) uint8 twice; }");
+    EXPECT_EQ(CountOps(&base, OP_MUL), 2u);
+    // `seven` is a single push; `head * 2` is left to the VM, in registers
+    EXPECT_EQ(CountOps(&program, OP_PUSH_IMM), 1u);
+    EXPECT_EQ(CountOps(&program, OP_EXPR), 1u);
+    EXPECT_EQ(CountOps(&program, OP_MUL), 0u);
+    EXPECT_EQ(CountOps(&program, OP_ADD), 0u);
+    Set("head", 5);
+    ExpectSameBehaviour();
+}
+
+TEST_F(OptimizerTest, DivisionByZeroIsNotFolded) {
+    CompileBoth("packet P { @expr(8 / 0) uint8 bad; @expr(1 << 70) uint8 wide; }");
+    EXPECT_EQ(CountOps(&program, OP_DIV), 1u);
+    EXPECT_EQ(CountOps(&program, OP_SHL), 1u);
+}
+
+TEST_F(OptimizerTest, ConstDiscriminatorDropsDeadArms) {
+    CompileBoth(
+        "packet P {"
+        "  @const(2) uint8 kind;"
+        "  switch (kind) {"
+        "    case 1: uint32 x;"
+        "    case 2: uint16 y;"
+        "    default: uint8 q;"
+        "  }"
+        "  uint8 tail;"
+        "}");
+    EXPECT_EQ(CountOps(&program, OP_SWITCH) + CountOps(&program, OP_SWITCH_SORTED) +
+              CountOps(&program, OP_SWITCH_TABLE) + CountOps(&program, OP_SWITCH_HASH), 0u);
+    EXPECT_EQ(CountOps(&program, OP_IO_U32), 0u);
+
+    // The fields behind the switch now have a fixed position
+    EXPECT_GT(program.layout_count, base.layout_count);
+    Set("kind", 2);
+    ExpectSameBehaviour();
+}
+
+TEST_F(OptimizerTest, ConstConditionFolds) {
+    CompileBoth(
+        "packet P {"
+        "  @const(2) uint8 kind;"
+        "  if (kind == 2) { uint8 z; } else { uint64 w; }"
+        "  uint8 tail;"
+        "}");
+    EXPECT_EQ(CountOps(&base, OP_JUMP_IF_NOT), 1u);
+    EXPECT_EQ(CountOps(&program, OP_JUMP_IF_NOT), 0u);
+    EXPECT_EQ(CountOps(&program, OP_LOAD_CTX), 0u);
+    EXPECT_EQ(CountOps(&program, OP_IO_U64), 0u);
+    Set("kind", 2);
+    ExpectSameBehaviour();
+}
+
+TEST_F(OptimizerTest, NonConstDiscriminatorKept) {
+    const char* schema =
+        "packet P {"
+        "  uint8 kind;"
+        "  switch (kind) { case 1: uint32 x; case 2: uint16 y; default: uint8 q; }"
+        "  uint8 tail;"
+        "}";
+    CompileBoth(schema);
+    EXPECT_EQ(CountOps(&program, OP_SWITCH) + CountOps(&program, OP_SWITCH_SORTED) +
+              CountOps(&program, OP_SWITCH_TABLE) + CountOps(&program, OP_SWITCH_HASH), 1u);
+    for (uint64_t kind : {1u, 2u, 3u}) {
+        Set("kind", kind);
+        ExpectSameBehaviour();
+    }
+}
+
+TEST_F(OptimizerTest, OptionalConstNotPropagated) {
+    // A missing optional field leaves the host's value in place
+    CompileBoth(
+        "packet P {"
+        "  @optional @const(2) uint8 kind;"
+        "  if (kind == 2) { uint8 z; }"
+        "}");
+    EXPECT_EQ(CountOps(&program, OP_JUMP_IF_NOT), 1u);
+    EXPECT_EQ(CountOps(&program, OP_EXPR), 1u);
+}
+
+TEST_F(OptimizerTest, ConstInsideConditionalNotPropagated) {
+    // `kind` is only written when `flag` is set, so it does not dominate the if
+    const char* schema =
+        "packet P {"
+        "  uint8 flag;"
+        "  if (flag == 1) { @const(2) uint8 kind; }"
+        "  if (kind == 2) { uint8 z; }"
+        "}";
+    CompileBoth(schema);
+    EXPECT_EQ(CountOps(&program, OP_JUMP_IF_NOT), 2u);
+    Set("flag", 1);
+    Set("kind", 2);
+    ExpectSameBehaviour();
+}
+
+TEST_F(OptimizerTest, JumpsAreThreaded) {
+    // The arms of the switch jump to the end of the if block, which jumps
+    // over the else block
+    CompileBoth(
+        "packet P {"
+        "  uint8 flag; uint8 kind;"
+        "  if (flag == 1) {"
+        "    switch (kind) { case 1: uint32 x; case 2: uint16 y; default: uint8 q; }"
+        "  } else { uint8 other; }"
+        "  uint8 tail;"
+        "}");
+    EXPECT_GT(CountJumpsToJumps(&base), 0u);
+    EXPECT_EQ(CountJumpsToJumps(&program), 0u);
+    for (uint64_t flag : {0u, 1u}) {
+        for (uint64_t kind : {1u, 2u, 3u}) {
+            Set("flag", flag);
+            Set("kind", kind);
+            ExpectSameBehaviour();
+        }
+    }
+}
+
+TEST_F(OptimizerTest, SubroutinesAndArrays) {
+    // Struct bodies start with an unknown byte order, since every caller can
+    // have its own
+    CompileBoth(
+        "struct Sample { @big_endian uint16 id; @big_endian uint32 time; uint8 flags; uint16 value; uint32 seq; }"
+        "packet P {"
+        "  @const(1) uint8 version;"
+        "  Sample first;"
+        "  @big_endian uint16 mid;"
+        "  Sample history[3];"
+        "  @pad(2); @pad(6);"
+        "  @expr(version + 1) uint8 next;"
+        "}");
+    EXPECT_EQ(CountOps(&program, OP_CALL), CountOps(&base, OP_CALL));
+    EXPECT_LT(CountInsns(&program), CountInsns(&base));
+    ExpectSameBehaviour();
+}
+
+// --- Superinstructions ---
+// Flat packets start with META_NAME(3), so their first field is at offset 3.
+
+TEST_F(OptimizerTest, FieldRunsFuse) {
+    CompileBoth("packet P { uint8 a; int16 b; uint32 c; uint64 d; int8 e; bool f; uint16 g; }");
+    ASSERT_GT(program.bytecode_len, 7u);
+    EXPECT_EQ(program.bytecode[3], OP_IO_RUN);
+    EXPECT_EQ(program.bytecode[4], 7);
+    EXPECT_EQ(program.bytecode[5] | (program.bytecode[6] << 8), 1 + 2 + 4 + 8 + 1 + 1 + 2);
+    // Prepared programs run the fields one by one
+    EXPECT_EQ(CountInsns(&program), CountInsns(&base));
+    ExpectSameBehaviour();
+
+    std::vector<uint8_t> wire = Encode(&base);
+    std::vector<OptEvent> events = Decode(&base, wire);
+    for (cnd_dispatch_t d : {CND_DISPATCH_SWITCH, CND_DISPATCH_THREADED}) {
+        OptHost h = {&values, {}};
+        cnd_init(&ctx, CND_MODE_DECODE, &program, wire.data(), wire.size(), opt_host_io, &h);
+        cnd_error_t err = cnd_execute_dispatch(&ctx, d);
+        if (err == CND_ERR_INVALID_OP) continue; // threaded loops not compiled in
+        EXPECT_EQ(err, CND_ERR_OK);
+        EXPECT_TRUE(h.events == events);
+    }
+
+    size_t cap = 0;
+    ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+    std::vector<cnd_insn> insns(cap);
+    cnd_prepared prepared;
+    ASSERT_EQ(cnd_program_prepare(&prepared, &program, insns.data(), cap), CND_ERR_OK);
+    OptHost h = {&values, {}};
+    cnd_init(&ctx, CND_MODE_DECODE, &program, wire.data(), wire.size(), opt_host_io, &h);
+    EXPECT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OK);
+    EXPECT_TRUE(h.events == events);
+}
+
+TEST_F(OptimizerTest, ShortBufferRunsFieldByField) {
+    CompileBoth("packet P { uint8 a; uint16 b; uint32 c; uint8 d; @optional uint16 e; }");
+    EXPECT_EQ(program.bytecode[3], OP_IO_RUN);
+    std::vector<uint8_t> wire = Encode(&base);
+    ASSERT_EQ(wire.size(), 10u);
+
+    // Up to the failing field, both report the same events and error
+    for (size_t len : {7u, 5u, 2u}) {
+        OptHost plain = {&values, {}}, fused = {&values, {}};
+        cnd_init(&ctx, CND_MODE_DECODE, &base, wire.data(), len, opt_host_io, &plain);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OOB);
+        cnd_init(&ctx, CND_MODE_DECODE, &program, wire.data(), len, opt_host_io, &fused);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OOB);
+        EXPECT_TRUE(fused.events == plain.events) << len;
+    }
+
+    // The optional tail may be missing
+    wire.resize(8);
+    std::vector<OptEvent> events = Decode(&base, wire);
+    EXPECT_TRUE(Decode(&program, wire) == events);
+}
+
+TEST_F(OptimizerTest, ChecksFuse) {
+    CompileBoth(
+        "enum Mode : uint8 { Off = 0, On = 1, Auto = 2 }"
+        "enum Code : uint16 { A = 1, B = 50, C = 900, D = 7000, E = 30000 }"
+        "enum Bits : uint8 { X = 1, Y = 3, Z = 5, W = 7, V = 12 }"
+        "packet P { uint8 head; @range(10, 20) uint16 level; Mode mode; Code code; Bits bits; }");
+    EXPECT_EQ(program.bytecode[6], OP_IO_CHECK);
+    EXPECT_EQ(program.bytecode[7], OP_IO_U16);
+    EXPECT_EQ(program.bytecode[10], OP_RANGE_CHECK);
+    Set("level", 15);
+    Set("mode", 2);
+    Set("code", 7000);
+    Set("bits", 12);
+    ExpectSameBehaviour();
+
+    // A value outside the set fails the same way
+    std::vector<uint8_t> wire = Encode(&base);
+    for (size_t at : {1u, 3u, 4u, 6u}) {
+        std::vector<uint8_t> bad = wire;
+        bad[at] = 0xEE;
+        OptHost plain = {&values, {}}, fused = {&values, {}};
+        cnd_init(&ctx, CND_MODE_DECODE, &base, bad.data(), bad.size(), opt_host_io, &plain);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_VALIDATION) << at;
+        cnd_init(&ctx, CND_MODE_DECODE, &program, bad.data(), bad.size(), opt_host_io, &fused);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_VALIDATION) << at;
+        EXPECT_TRUE(fused.events == plain.events) << at;
+    }
+    Set("code", 7001);
+    OptHost h = {&values, {}};
+    uint8_t out[16];
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, out, sizeof(out), opt_host_io, &h);
+    EXPECT_EQ(cnd_execute(&ctx), CND_ERR_VALIDATION);
+}
+
+TEST_F(OptimizerTest, FusedFieldsAreFoundByScans) {
+    // Fields behind a variable-length array are not in the static layout
+    CompileBoth(
+        "packet P { uint8 n; @count(n) uint8 data[]; uint16 a; uint32 b; @range(0, 9000) uint16 c; uint8 d; }");
+    Set("n", 3);
+    Set("c", 1234);
+    ExpectSameBehaviour();
+    std::vector<uint8_t> wire = Encode(&base);
+    for (const char* name : {"a", "b", "c", "d"}) {
+        uint16_t key = cnd_get_key_id(&program, name);
+        uint64_t want = 0, got = 0;
+        ASSERT_EQ(cnd_field_read(&base, wire.data(), wire.size(), key, &want), CND_ERR_OK) << name;
+        ASSERT_EQ(cnd_field_read(&program, wire.data(), wire.size(), key, &got), CND_ERR_OK) << name;
+        EXPECT_EQ(got, want) << name;
+    }
+}
+
+// --- Register Expressions ---
+
+TEST_F(OptimizerTest, ExpressionsRunInRegisters) {
+    CompileBoth(
+        "packet P {"
+        "  uint8 mode; uint16 level;"
+        "  @expr((mode - 1) * 2) uint8 grouped;"
+        "  @expr(mode * 300 + 100000) uint32 wide;"
+        "  @expr(level / 3 - mode % 4 + (level << 2)) uint32 mixed;"
+        "  @expr(int(sqrt(float(level)) * 10.0)) uint16 root;"
+        "  @expr(int(float(mode) / 2.5 + pow(2.0, 3.0))) uint8 ratio;"
+        "  if (mode == 3 && float(level) > 1.5) { uint8 extra; }"
+        "}");
+    EXPECT_EQ(CountOps(&program, OP_EXPR), 6u);
+    EXPECT_EQ(CountOps(&program, OP_LOAD_CTX), 0u);
+    for (uint64_t mode : {1u, 3u, 100u}) {
+        Set("mode", mode);
+        Set("level", mode * 97);
+        ExpectSameBehaviour();
+
+        // Switch and threaded loops, and the prepared form, agree
+        std::vector<uint8_t> wire = Encode(&base);
+        std::vector<OptEvent> events = Decode(&base, wire);
+        for (cnd_dispatch_t d : {CND_DISPATCH_SWITCH, CND_DISPATCH_THREADED}) {
+            OptHost h = {&values, {}};
+            cnd_init(&ctx, CND_MODE_DECODE, &program, wire.data(), wire.size(), opt_host_io, &h);
+            cnd_error_t err = cnd_execute_dispatch(&ctx, d);
+            if (err == CND_ERR_INVALID_OP) continue; // threaded loops not compiled in
+            EXPECT_EQ(err, CND_ERR_OK) << mode;
+            EXPECT_TRUE(h.events == events) << mode;
+        }
+        size_t cap = 0;
+        ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+        std::vector<cnd_insn> insns(cap);
+        cnd_prepared prepared;
+        ASSERT_EQ(cnd_program_prepare(&prepared, &program, insns.data(), cap), CND_ERR_OK);
+        EXPECT_TRUE(prepared.stacks_verified);
+        OptHost h = {&values, {}};
+        cnd_init(&ctx, CND_MODE_DECODE, &program, wire.data(), wire.size(), opt_host_io, &h);
+        EXPECT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OK) << mode;
+        EXPECT_TRUE(h.events == events) << mode;
+    }
+}
+
+TEST_F(OptimizerTest, RegisterExpressionErrors) {
+    CompileBoth("packet P { uint8 n; @expr(100 / n) uint8 q; @expr(int(sqrt(float(n) - 5.0))) uint8 r; }");
+    EXPECT_EQ(CountOps(&program, OP_EXPR), 2u);
+    // n = 0 divides by zero, n = 2 takes a negative square root
+    for (uint64_t n : {0u, 2u}) {
+        Set("n", n);
+        OptHost plain = {&values, {}}, regs = {&values, {}};
+        uint8_t out[8];
+        cnd_init(&ctx, CND_MODE_ENCODE, &base, out, sizeof(out), opt_host_io, &plain);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_ARITHMETIC) << n;
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, out, sizeof(out), opt_host_io, &regs);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_ARITHMETIC) << n;
+        EXPECT_TRUE(regs.events == plain.events) << n;
+    }
+}
+
+// --- Scoreboard ---
+
+TEST_F(OptimizerTest, ReferencedFieldsSkipTheHost) {
+    CompileBoth(
+        "packet P {"
+        "  uint8 kind; int8 delta; uint8 n;"
+        "  switch (kind) { case 1: uint32 x; case 2: uint16 y; default: uint8 q; }"
+        "  @count(n) uint16 data[];"
+        "  if (delta < 0) { uint8 neg; }"
+        "  @expr(kind * 2 + n) uint8 derived;"
+        "}");
+    EXPECT_EQ(CountOps(&base, OP_IO_SLOT), 0u);
+    EXPECT_EQ(CountOps(&program, OP_IO_SLOT), 3u);
+
+    for (uint64_t kind : {1u, 2u, 7u}) {
+        Set("kind", kind);
+        Set("delta", kind == 2 ? (uint64_t)-3 : 4);
+        Set("n", kind);
+        ExpectSameBehaviour();
+
+        std::vector<uint8_t> wire = Encode(&base);
+        std::vector<OptEvent> events = Decode(&base, wire);
+        OptHost h = {&values, {}};
+        cnd_init(&ctx, CND_MODE_DECODE, &program, wire.data(), wire.size(), opt_host_io, &h);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK) << kind;
+        EXPECT_TRUE(h.events == events) << kind;
+        EXPECT_EQ(h.queries, 0u) << kind;
+
+        size_t cap = 0;
+        ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+        std::vector<cnd_insn> insns(cap);
+        cnd_prepared prepared;
+        ASSERT_EQ(cnd_program_prepare(&prepared, &program, insns.data(), cap), CND_ERR_OK);
+        OptHost p = {&values, {}};
+        cnd_init(&ctx, CND_MODE_DECODE, &program, wire.data(), wire.size(), opt_host_io, &p);
+        EXPECT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OK) << kind;
+        EXPECT_TRUE(p.events == events) << kind;
+        EXPECT_EQ(p.queries, 0u) << kind;
+    }
+}
+
+TEST_F(OptimizerTest, ConditionalFieldsKeepAskingTheHost) {
+    // `a` may be missing when `b` reads it, and @optional fields may be absent
+    CompileBoth(
+        "packet P {"
+        "  uint8 flag;"
+        "  if (flag == 1) { uint8 a; }"
+        "  @optional uint8 b;"
+        "  if (a == 2) { uint8 c; }"
+        "  if (b == 3) { uint8 d; }"
+        "}");
+    EXPECT_EQ(CountOps(&program, OP_IO_SLOT), 1u);
+    Set("flag", 1);
+    Set("a", 2);
+    Set("b", 3);
+    ExpectSameBehaviour();
+}
@@ -0,0 +1,602 @@
+#include "test_common.h"
+#include <string>
+
+// Prepared programs must behave exactly like the bytecode interpreter:
+// every test runs the same schema through cnd_execute and cnd_execute_prepared
+// and compares result codes, cursors, output bytes and callback results.
+
+class PreparedTest : public ConcordiaTest {
+protected:
+    cnd_prepared prepared;
+    std::vector<cnd_insn> storage;
+
+    void Prepare() {
+        size_t cap = 0;
+        ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+        storage.resize(cap > 0 ? cap : 1);
+        ASSERT_EQ(cnd_program_prepare(&prepared, &program, storage.data(), cap), CND_ERR_OK);
+        ASSERT_LE(prepared.insn_count, cap);
+    }
+
+    cnd_error_t Run(cnd_mode_t mode, bool use_prepared, uint8_t* buf, size_t len, size_t* cursor) {
+        cnd_init(&ctx, mode, &program, buf, len, test_io_callback, NULL);
+        cnd_error_t err = use_prepared ? cnd_execute_prepared(&ctx, &prepared) : cnd_execute(&ctx);
+        *cursor = ctx.cursor;
+        return err;
+    }
+
+    void Set(const char* name, uint64_t u64, double f64 = 0.0, const char* str = "") {
+        uint16_t key = cnd_get_key_id(&program, name);
+        ASSERT_NE(key, 0xFFFF) << name;
+        for (int i = 0; i < MAX_TEST_ENTRIES; i++) {
+            if (g_test_data[i].key == 0xFFFF || g_test_data[i].key == key) {
+                g_test_data[i] = test_data_entry(key, u64, f64, str);
+                return;
+            }
+        }
+        FAIL() << "Out of test entries";
+    }
+
+    static void ExpectSameData(const test_data_entry* a, const test_data_entry* b) {
+        for (int i = 0; i < MAX_TEST_ENTRIES; i++) {
+            EXPECT_EQ(a[i].key, b[i].key) << "entry " << i;
+            EXPECT_EQ(a[i].u64_val, b[i].u64_val) << "entry " << i;
+            EXPECT_EQ(0, memcmp(&a[i].f64_val, &b[i].f64_val, sizeof(double))) << "entry " << i;
+            EXPECT_STREQ(a[i].string_val, b[i].string_val) << "entry " << i;
+        }
+    }
+
+    // Encodes the current g_test_data with both interpreters, then decodes the
+    // reference output with both. Returns the encode result.
+    cnd_error_t ExpectSameRoundTrip() {
+        test_data_entry input[MAX_TEST_ENTRIES];
+        memcpy(input, g_test_data, sizeof(input));
+
+        uint8_t ref[64] = {0}, got[64] = {0};
+        size_t ref_cursor = 0, got_cursor = 0;
+
+        cnd_error_t ref_err = Run(CND_MODE_ENCODE, false, ref, sizeof(ref), &ref_cursor);
+        memcpy(g_test_data, input, sizeof(input));
+        cnd_error_t got_err = Run(CND_MODE_ENCODE, true, got, sizeof(got), &got_cursor);
+
+        EXPECT_EQ(ref_err, got_err);
+        EXPECT_EQ(ref_cursor, got_cursor);
+        EXPECT_EQ(0, memcmp(ref, got, sizeof(ref)));
+        if (ref_err != CND_ERR_OK) return ref_err;
+
+        test_data_entry decoded[MAX_TEST_ENTRIES];
+        clear_test_data();
+        cnd_error_t ref_dec = Run(CND_MODE_DECODE, false, ref, ref_cursor, &ref_cursor);
+        memcpy(decoded, g_test_data, sizeof(decoded));
+
+        clear_test_data();
+        cnd_error_t got_dec = Run(CND_MODE_DECODE, true, ref, got_cursor, &got_cursor);
+
+        EXPECT_EQ(ref_dec, got_dec);
+        EXPECT_EQ(ref_cursor, got_cursor);
+        ExpectSameData(decoded, g_test_data);
+        return ref_err;
+    }
+};
+
+TEST_F(PreparedTest, Primitives) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 a; int16 b; @big_endian uint32 c; uint64 d;"
+        "  float e; double f; bool g; int8 h;"
+        "}"
+    );
+    Prepare();
+
+    Set("a", 0x12); Set("b", (uint64_t)-1234); Set("c", 0xDEADBEEF); Set("d", 0x0102030405060708ULL);
+    Set("e", 0, 1.5); Set("f", 0, -2.25); Set("g", 1); Set("h", (uint64_t)-7);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+}
+
+TEST_F(PreparedTest, ArraysAndStrings) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint16 fixed[3];"
+        "  uint8 bytes[4];"
+        "  uint16 var[] prefix uint8;"
+        "  string s prefix uint8;"
+        "  string z until 0x00 max 16;"
+        "  uint8 tail;"
+        "}"
+    );
+    Prepare();
+
+    Set("fixed", 0x1234); Set("bytes", 0xAB); Set("var", 2);
+    Set("s", 0, 0, "hey"); Set("z", 0, 0, "zed"); Set("tail", 0x77);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+
+    // Empty prefixed array skips straight to the loop exit
+    clear_test_data();
+    Set("fixed", 1); Set("bytes", 2); Set("var", 0);
+    Set("s", 0, 0, ""); Set("z", 0, 0, "x"); Set("tail", 0x55);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+}
+
+TEST_F(PreparedTest, ArrayOfStructs) {
+    CompileAndLoad(
+        "struct Item { uint32 id; uint16 val; }"
+        "packet P { Item items[3]; uint8 end; }"
+    );
+    Prepare();
+
+    Set("items.id", 42); Set("items.val", 7); Set("end", 1);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+}
+
+TEST_F(PreparedTest, Switch) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 type;"
+        "  switch (type) {"
+        "    case 1: uint8 val_a;"
+        "    case 2: uint16 val_b;"
+        "    default: uint32 val_def;"
+        "  }"
+        "  uint8 end;"
+        "}"
+    );
+    Prepare();
+
+    const uint64_t tags[] = {1, 2, 99};
+    for (uint64_t tag : tags) {
+        clear_test_data();
+        Set("type", tag); Set("val_a", 0xAA); Set("val_b", 0xBBCC); Set("val_def", 0xDEADBEEF); Set("end", 0xEE);
+        EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK) << "tag " << tag;
+    }
+}
+
+TEST_F(PreparedTest, SwitchTable) {
+    // Dense case values compile to OP_SWITCH_TABLE
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 type;"
+        "  switch (type) {"
+        "    case 0: uint8 a;"
+        "    case 1: uint16 b;"
+        "    case 2: uint32 c;"
+        "    case 3: uint8 d;"
+        "  }"
+        "}"
+    );
+    Prepare();
+
+    for (uint64_t tag = 0; tag < 6; tag++) {
+        clear_test_data();
+        Set("type", tag); Set("a", 1); Set("b", 2); Set("c", 3); Set("d", 4);
+        EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK) << "tag " << tag;
+    }
+}
+
+// Sparse switch over `count` cases: case i is `(i * stride + first) & 0xFFFF`
+// and holds field f<i>, whose width cycles through 1, 2 and 4 bytes.
+static std::string SparseSwitchSchema(int count, uint32_t stride, uint32_t first, bool with_default) {
+    static const char* types[] = {"uint8", "uint16", "uint32"};
+    std::string src = "packet P { uint16 type; switch (type) {";
+    for (int i = 0; i < count; i++) {
+        src += " case " + std::to_string((i * stride + first) & 0xFFFF) + ": " + types[i % 3] + " f" + std::to_string(i) + ";";
+    }
+    if (with_default) src += " default: uint8 d;";
+    return src + " } uint8 end; }";
+}
+
+// Bytecode offset of the switch on `type` in the loaded program
+static size_t SwitchOffset(const cnd_program& program) {
+    uint16_t key = cnd_get_key_id(&program, "type");
+    for (size_t i = 0; i + 3 <= program.bytecode_len; i++) {
+        uint8_t op = program.bytecode[i];
+        if ((op == OP_SWITCH || op == OP_SWITCH_SORTED || op == OP_SWITCH_HASH) &&
+            (program.bytecode[i + 1] | (program.bytecode[i + 2] << 8)) == key) {
+            return i;
+        }
+    }
+    return program.bytecode_len;
+}
+
+static uint8_t FirstSwitchOp(const cnd_program& program) {
+    size_t at = SwitchOffset(program);
+    return at < program.bytecode_len ? program.bytecode[at] : 0;
+}
+
+TEST_F(PreparedTest, SwitchHash) {
+    // Many sparse cases compile to a perfect-hash table
+    CompileAndLoad(SparseSwitchSchema(200, 311, 7, true).c_str());
+    ASSERT_EQ(FirstSwitchOp(program), OP_SWITCH_HASH);
+    Prepare();
+
+    // Only the selected case's field is set, so a wrong branch fails to encode
+    for (int i = 0; i < 200; i += 3) {
+        clear_test_data();
+        Set("type", (i * 311 + 7) & 0xFFFF);
+        Set(("f" + std::to_string(i)).c_str(), 0x55);
+        Set("end", 0xEE);
+        EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK) << "case " << i;
+    }
+
+    const uint64_t misses[] = {0, 1, 8, 0xFFFF};
+    for (uint64_t tag : misses) {
+        clear_test_data();
+        Set("type", tag); Set("d", 0x44); Set("end", 0xEE);
+        EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK) << "tag " << tag;
+    }
+}
+
+TEST_F(PreparedTest, SwitchHashWithoutDefault) {
+    CompileAndLoad(SparseSwitchSchema(20, 977, 3, false).c_str());
+    ASSERT_EQ(FirstSwitchOp(program), OP_SWITCH_HASH);
+    Prepare();
+
+    for (int i = 0; i < 20; i++) {
+        clear_test_data();
+        Set("type", (i * 977 + 3) & 0xFFFF);
+        Set(("f" + std::to_string(i)).c_str(), 0x1234);
+        Set("end", 0xEE);
+        EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK) << "case " << i;
+    }
+
+    // Unmatched values skip the switch
+    clear_test_data();
+    Set("type", 4); Set("end", 0xEE);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+}
+
+TEST_F(PreparedTest, SwitchSorted) {
+    // Few cases stay a linear OP_SWITCH; with ascending values its table is
+    // also a valid OP_SWITCH_SORTED table, so the two must agree.
+    CompileAndLoad(SparseSwitchSchema(9, 7001, 5, true).c_str());
+    ASSERT_EQ(FirstSwitchOp(program), OP_SWITCH);
+
+    std::vector<uint64_t> tags = {0, 4, 6, 0xFFFF};
+    for (int i = 0; i < 9; i++) tags.push_back((i * 7001 + 5) & 0xFFFF);
+
+    std::vector<std::vector<uint8_t>> expected;
+    for (uint64_t tag : tags) {
+        clear_test_data();
+        for (int i = 0; i < 9; i++) Set(("f" + std::to_string(i)).c_str(), 0xA0 + i);
+        Set("type", tag); Set("d", 0x44); Set("end", 0xEE);
+        std::vector<uint8_t> buf(16);
+        size_t cursor = 0;
+        ASSERT_EQ(Run(CND_MODE_ENCODE, false, buf.data(), buf.size(), &cursor), CND_ERR_OK);
+        buf.resize(cursor);
+        expected.push_back(buf);
+    }
+
+    il_buffer[program.bytecode - il_buffer.data() + SwitchOffset(program)] = OP_SWITCH_SORTED;
+    ASSERT_EQ(cnd_verify_program(&program), CND_ERR_OK);
+    Prepare();
+
+    for (size_t t = 0; t < tags.size(); t++) {
+        for (bool use_prepared : {false, true}) {
+            clear_test_data();
+            for (int i = 0; i < 9; i++) Set(("f" + std::to_string(i)).c_str(), 0xA0 + i);
+            Set("type", tags[t]); Set("d", 0x44); Set("end", 0xEE);
+            std::vector<uint8_t> buf(16);
+            size_t cursor = 0;
+            ASSERT_EQ(Run(CND_MODE_ENCODE, use_prepared, buf.data(), buf.size(), &cursor), CND_ERR_OK);
+            buf.resize(cursor);
+            EXPECT_EQ(buf, expected[t]) << "tag " << tags[t] << (use_prepared ? " (prepared)" : "");
+        }
+    }
+}
+
+TEST_F(PreparedTest, SparseSwitchInStruct) {
+    // Struct bytecode is copied with prefixed keys for each use; the jump
+    // table must be copied as data, not remapped as instructions.
+    std::string src = SparseSwitchSchema(40, 1543, 11, true);
+    src.replace(0, strlen("packet P"), "struct S");
+    src += " packet P { S a; S b; }";
+    CompileAndLoad(src.c_str());
+    Prepare();
+
+    const int picks[][2] = {{0, 39}, {17, 3}, {25, -1}};
+    for (const auto& pick : picks) {
+        clear_test_data();
+        const char* names[] = {"a", "b"};
+        for (int s = 0; s < 2; s++) {
+            std::string prefix = std::string(names[s]) + ".";
+            int i = pick[s];
+            if (i < 0) {
+                Set((prefix + "type").c_str(), 2);
+                Set((prefix + "d").c_str(), 0x44);
+            } else {
+                Set((prefix + "type").c_str(), (i * 1543 + 11) & 0xFFFF);
+                Set((prefix + "f" + std::to_string(i)).c_str(), 0x77);
+            }
+            Set((prefix + "end").c_str(), 0xEE);
+        }
+        EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK) << "cases " << pick[0] << ", " << pick[1];
+    }
+}
+
+TEST_F(PreparedTest, IfElse) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 x;"
+        "  uint8 y;"
+        "  if (x > 10) {"
+        "    if (y < 5) {"
+        "      uint8 z;"
+        "    }"
+        "  } else {"
+        "    uint16 w;"
+        "  }"
+        "}"
+    );
+    Prepare();
+
+    const uint64_t xs[] = {20, 20, 3};
+    const uint64_t ys[] = {2, 9, 2};
+    for (int i = 0; i < 3; i++) {
+        clear_test_data();
+        Set("x", xs[i]); Set("y", ys[i]); Set("z", 0xFF); Set("w", 0x1234);
+        EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK) << "case " << i;
+    }
+}
+
+TEST_F(PreparedTest, Validation) {
+    CompileAndLoad(
+        "enum Level : uint8 { Low = 10, High = 20 }"
+        "packet P {"
+        "  @const(0xCAFE) uint16 magic;"
+        "  @range(0, 100) uint8 score;"
+        "  @range(-5, 5) int16 delta;"
+        "  Level level;"
+        "  uint8 d[3];"
+        "  @crc(16) uint16 c16;"
+        "  @crc(32) uint32 c32;"
+        "}"
+    );
+    Prepare();
+
+    Set("score", 50); Set("delta", (uint64_t)-3); Set("level", 20); Set("d", 0x31);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+
+    // Failing range and enum checks must fail identically
+    clear_test_data();
+    Set("score", 101); Set("delta", 0); Set("level", 20); Set("d", 0x31);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_VALIDATION);
+
+    clear_test_data();
+    Set("score", 1); Set("delta", 0); Set("level", 15); Set("d", 0x31);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_VALIDATION);
+}
+
+TEST_F(PreparedTest, CrcMismatch) {
+    CompileAndLoad("packet P { uint8 d[4]; @crc(32) uint32 c; }");
+    Prepare();
+
+    Set("d", 0x5A);
+    uint8_t buf[16] = {0};
+    size_t cursor = 0;
+    ASSERT_EQ(Run(CND_MODE_ENCODE, false, buf, sizeof(buf), &cursor), CND_ERR_OK);
+    buf[1] ^= 0x01;
+
+    size_t c1 = 0, c2 = 0;
+    EXPECT_EQ(Run(CND_MODE_DECODE, false, buf, cursor, &c1), CND_ERR_CRC_MISMATCH);
+    EXPECT_EQ(Run(CND_MODE_DECODE, true, buf, cursor, &c2), CND_ERR_CRC_MISMATCH);
+    EXPECT_EQ(c1, c2);
+}
+
+TEST_F(PreparedTest, Transforms) {
+    CompileAndLoad(
+        "packet P {"
+        "  @mul(10) @add(5) uint8 val1;"
+        "  @div(2) @sub(1) uint16 val2;"
+        "  @scale(0.5) @offset(100.0) float val3;"
+        "  @poly(5.0, 2.0, 0.5) uint8 val4;"
+        "  @spline(0.0, 0.0, 10.0, 100.0, 20.0, 400.0) uint8 val5;"
+        "}"
+    );
+    Prepare();
+
+    Set("val1", 55); Set("val2", 9); Set("val3", 0, 110.0); Set("val4", 0, 23.0); Set("val5", 0, 250.0);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+}
+
+TEST_F(PreparedTest, Bitfields) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 a : 3;"
+        "  int8 b : 4;"
+        "  bool c : 1;"
+        "  @pad(4) uint8 d : 4;"
+        "  @fill uint8 e;"
+        "}"
+    );
+    Prepare();
+
+    Set("a", 5); Set("b", (uint64_t)-3); Set("c", 1); Set("d", 9); Set("e", 0x42);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+}
+
+TEST_F(PreparedTest, Expressions) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 x;"
+        "  @expr(x * 2 + 1) uint16 y;"
+        "  @expr(float(x) + 10.0) float f;"
+        "}"
+    );
+    Prepare();
+
+    Set("x", 21);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+}
+
+TEST_F(PreparedTest, ResumesFromInstructionIndex) {
+    CompileAndLoad("packet P { uint8 a; uint8 b; }");
+    Prepare();
+
+    // ctx->ip is an instruction index in prepared execution
+    uint16_t key_b = cnd_get_key_id(&program, "b");
+    size_t idx_b = prepared.insn_count;
+    for (size_t i = 0; i < prepared.insn_count; i++) {
+        if (prepared.insns[i].op == OP_IO_U8 && prepared.insns[i].key == key_b) idx_b = i;
+    }
+    ASSERT_LT(idx_b, prepared.insn_count);
+
+    Set("a", 1); Set("b", 2);
+    uint8_t buf[4] = {0};
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), test_io_callback, NULL);
+    ctx.ip = idx_b; // Skip 'a'
+    EXPECT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OK);
+    EXPECT_EQ(ctx.cursor, 1u);
+    EXPECT_EQ(buf[0], 2);
+
+    ctx.ip = prepared.insn_count + 1;
+    EXPECT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OOB);
+}
+
+TEST_F(PreparedTest, StorageTooSmall) {
+    CompileAndLoad("packet P { uint8 a; uint16 b[2]; }");
+
+    size_t cap = 0;
+    ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+    storage.resize(cap);
+    EXPECT_EQ(cnd_program_prepare(&prepared, &program, storage.data(), cap - 1), CND_ERR_OOB);
+    EXPECT_EQ(cnd_program_prepare(&prepared, &program, storage.data(), cap), CND_ERR_OK);
+}
+
+TEST_F(PreparedTest, RejectsBadPrograms) {
+    cnd_program prog;
+    cnd_prepared prep;
+    cnd_insn slots[16];
+    size_t cap = 0;
+
+    // Fails verification
+    uint8_t bad_op[] = { 0xFF };
+    cnd_program_load(&prog, bad_op, sizeof(bad_op));
+    EXPECT_EQ(cnd_program_prepare_size(&prog, &cap), CND_ERR_INVALID_OP);
+
+    // ARR_END without an opener
+    uint8_t unmatched[] = { OP_IO_U8, 0, 0, OP_ARR_END };
+    cnd_program_load(&prog, unmatched, sizeof(unmatched));
+    EXPECT_EQ(cnd_program_prepare(&prep, &prog, slots, 16), CND_ERR_INVALID_OP);
+
+    // Array never closed
+    uint8_t unclosed[] = { OP_ARR_FIXED, 0, 0, 2, 0, 0, 0, OP_IO_U8, 1, 0 };
+    cnd_program_load(&prog, unclosed, sizeof(unclosed));
+    EXPECT_EQ(cnd_program_prepare(&prep, &prog, slots, 16), CND_ERR_INVALID_OP);
+
+    // Jump into the middle of an instruction
+    uint8_t mid_jump[] = { OP_JUMP, 1, 0, 0, 0, OP_IO_U16, 0, 0 };
+    cnd_program_load(&prog, mid_jump, sizeof(mid_jump));
+    EXPECT_EQ(cnd_program_prepare(&prep, &prog, slots, 16), CND_ERR_OOB);
+
+    // Jump to the end of the program is fine
+    uint8_t end_jump[] = { OP_JUMP, 3, 0, 0, 0, OP_IO_U16, 0, 0 };
+    cnd_program_load(&prog, end_jump, sizeof(end_jump));
+    ASSERT_EQ(cnd_program_prepare(&prep, &prog, slots, 16), CND_ERR_OK);
+    EXPECT_EQ(prep.insn_count, 2u);
+    EXPECT_EQ(prep.insns[0].a, 2u);
+}
+
+TEST_F(PreparedTest, StackDepthsProved) {
+    for (int opt = 0; opt <= 1; opt++) {
+        CompileAndLoad(
+            "struct In { uint8 v[2]; }"
+            "struct Out { uint8 k; In x[3]; }"
+            "packet P {"
+            "  uint8 a;"
+            "  uint8 b;"
+            "  @expr(a * b + a * 2 - b) uint16 s;"
+            "  if (a > 3) { Out o[2]; }"
+            "  @expr(a) uint8 c;"
+            "}", opt);
+        Prepare();
+        EXPECT_TRUE(prepared.stacks_verified) << "-O" << opt;
+        // -O evaluates `s` in registers, so only its result and the DUP for
+        // STORE_CTX are stacked
+        EXPECT_EQ(prepared.max_stack_depth, opt ? 2 : 3) << "-O" << opt;
+        EXPECT_EQ(prepared.max_loop_depth, 3) << "-O" << opt; // o[], x[] in Out, v[] in In
+    }
+}
+
+TEST_F(PreparedTest, UncheckedExpressionsMatch) {
+    CompileAndLoad(
+        "packet P {"
+        "  uint8 x;"
+        "  uint8 d;"
+        "  @expr(x * 3 + 7 % 11 - x >> 1) uint16 y;"
+        "  @expr(float(x) * 0.5 + sqrt(16.0)) double f;"
+        "  if (x > 10 && x != d) { uint8 big; } else { uint8 small; }"
+        "  @expr(x / d) uint8 q;"
+        "}"
+    );
+    Prepare();
+    ASSERT_TRUE(prepared.stacks_verified);
+
+    Set("x", 21); Set("d", 4); Set("big", 9); Set("small", 1);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_OK);
+
+    // Arithmetic errors surface the same way
+    Set("d", 0);
+    EXPECT_EQ(ExpectSameRoundTrip(), CND_ERR_ARITHMETIC);
+}
+
+TEST_F(PreparedTest, UnprovedStacksStayChecked) {
+    cnd_program prog;
+    cnd_prepared prep;
+    cnd_insn slots[64];
+    uint8_t buf[8];
+
+    // Nine pushes overflow the expression stack
+    uint8_t deep[9 * 9];
+    for (int i = 0; i < 9; i++) {
+        memset(deep + i * 9, 0, 9);
+        deep[i * 9] = OP_PUSH_IMM;
+    }
+    cnd_program_load(&prog, deep, sizeof(deep));
+    ASSERT_EQ(cnd_program_prepare(&prep, &prog, slots, 64), CND_ERR_OK);
+    EXPECT_FALSE(prep.stacks_verified);
+    cnd_init(&ctx, CND_MODE_ENCODE, &prog, buf, sizeof(buf), test_io_callback, NULL);
+    EXPECT_EQ(cnd_execute(&ctx), CND_ERR_STACK_OVERFLOW);
+    cnd_init(&ctx, CND_MODE_ENCODE, &prog, buf, sizeof(buf), test_io_callback, NULL);
+    EXPECT_EQ(cnd_execute_prepared(&ctx, &prep), CND_ERR_STACK_OVERFLOW);
+
+    // Popping an empty stack
+    uint8_t shallow[] = { OP_PUSH_IMM, 1, 0, 0, 0, 0, 0, 0, 0, OP_ADD };
+    cnd_program_load(&prog, shallow, sizeof(shallow));
+    ASSERT_EQ(cnd_program_prepare(&prep, &prog, slots, 64), CND_ERR_OK);
+    EXPECT_FALSE(prep.stacks_verified);
+    cnd_init(&ctx, CND_MODE_ENCODE, &prog, buf, sizeof(buf), test_io_callback, NULL);
+    EXPECT_EQ(cnd_execute_prepared(&ctx, &prep), CND_ERR_STACK_UNDERFLOW);
+
+    // A value left on the stack across a branch is legal but not proved
+    uint8_t carried[] = {
+        OP_PUSH_IMM, 5, 0, 0, 0, 0, 0, 0, 0,
+        OP_PUSH_IMM, 1, 0, 0, 0, 0, 0, 0, 0,
+        OP_JUMP_IF_NOT, 0, 0, 0, 0,
+        OP_POP
+    };
+    cnd_program_load(&prog, carried, sizeof(carried));
+    ASSERT_EQ(cnd_program_prepare(&prep, &prog, slots, 64), CND_ERR_OK);
+    EXPECT_FALSE(prep.stacks_verified);
+    cnd_init(&ctx, CND_MODE_ENCODE, &prog, buf, sizeof(buf), test_io_callback, NULL);
+    EXPECT_EQ(cnd_execute_prepared(&ctx, &prep), CND_ERR_OK);
+
+    // A jump back into a loop body would push a frame per pass
+    uint8_t reenter[] = {
+        OP_ARR_FIXED, 0, 0, 2, 0, 0, 0,
+        OP_ARR_END,
+        OP_JUMP, 0xF3, 0xFF, 0xFF, 0xFF // Back to ARR_FIXED
+    };
+    cnd_program_load(&prog, reenter, sizeof(reenter));
+    ASSERT_EQ(cnd_program_prepare(&prep, &prog, slots, 64), CND_ERR_OK);
+    EXPECT_TRUE(prep.stacks_verified); // Same nesting at both ends: no frames leak
+
+    uint8_t leak[] = {
+        OP_ARR_FIXED, 0, 0, 2, 0, 0, 0,
+        OP_JUMP, 0xF4, 0xFF, 0xFF, 0xFF, // From inside the body back to ARR_FIXED
+        OP_ARR_END
+    };
+    cnd_program_load(&prog, leak, sizeof(leak));
+    ASSERT_EQ(cnd_program_prepare(&prep, &prog, slots, 64), CND_ERR_OK);
+    EXPECT_FALSE(prep.stacks_verified);
+    cnd_init(&ctx, CND_MODE_ENCODE, &prog, buf, sizeof(buf), test_io_callback, NULL);
+    EXPECT_EQ(cnd_execute_prepared(&ctx, &prep), CND_ERR_OOB); // Loop stack full
+}
@@ -0,0 +1,237 @@
+#include "test_common.h"
+#include <string>
+
+// Packet size bounds: computed by the compiler for the IL header, checked
+// by the verifier, and used by prepared programs to run their fixed prefix
+// with a single length check.
+
+struct SizeEvent {
+    uint16_t key;
+    uint8_t type;
+    uint64_t value;
+    bool operator==(const SizeEvent& o) const { return key == o.key && type == o.type && value == o.value; }
+};
+
+struct SizeRecorder {
+    std::vector<SizeEvent> events;
+    const char* text = "hello";
+    uint32_t count = 2;
+};
+
+// Encode writes `key * 7 + 1` to every field, `text` to strings and `count`
+// to array prefixes; decode records what it reads
+static cnd_error_t size_record_io(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, void* ptr) {
+    SizeRecorder* r = (SizeRecorder*)ctx->user_ptr;
+    bool enc = ctx->mode == CND_MODE_ENCODE;
+    uint64_t v = 0;
+    size_t size = 0;
+    switch (type) {
+        case OP_IO_U8: case OP_IO_I8: case OP_IO_BOOL: size = 1; break;
+        case OP_IO_U16: case OP_IO_I16: size = 2; break;
+        case OP_IO_U32: case OP_IO_I32: case OP_IO_F32: size = 4; break;
+        case OP_IO_U64: case OP_IO_I64: case OP_IO_F64: size = 8; break;
+        case OP_IO_BIT_U: case OP_IO_BIT_I: size = 8; break;
+        case OP_IO_BIT_BOOL: size = 1; break;
+        case OP_STR_NULL: case OP_STR_PRE_U8: case OP_STR_PRE_U16: case OP_STR_PRE_U32:
+            if (enc) *(const char**)ptr = r->text;
+            else v = strlen((const char*)ptr) > 0;
+            r->events.push_back({key, type, v});
+            return CND_ERR_OK;
+        case OP_ARR_PRE_U8: if (enc) *(uint8_t*)ptr = (uint8_t)r->count; break;
+        case OP_ARR_PRE_U16: if (enc) *(uint16_t*)ptr = (uint16_t)r->count; break;
+        case OP_ARR_PRE_U32: if (enc) *(uint32_t*)ptr = r->count; break;
+        case OP_CTX_QUERY: *(uint64_t*)ptr = 1; return CND_ERR_OK;
+        default: break;
+    }
+    if (size > 0) {
+        if (enc) {
+            v = key * 7u + 1;
+            if (type == OP_IO_BOOL || type == OP_IO_BIT_BOOL) v &= 1;
+            memcpy(ptr, &v, size);
+        } else {
+            memcpy(&v, ptr, size);
+        }
+    }
+    r->events.push_back({key, type, v});
+    return CND_ERR_OK;
+}
+
+class SizeBoundsTest : public ConcordiaTest {
+protected:
+    std::vector<cnd_insn> insns;
+    cnd_prepared prepared;
+    uint8_t wire[1024];
+
+    void ExpectBounds(const char* schema, uint32_t min_size, uint32_t max_size) {
+        for (int opt = 0; opt <= 1; opt++) {
+            CompileAndLoad(schema, opt);
+            EXPECT_EQ(program.min_size, min_size) << schema << " -O" << opt;
+            EXPECT_EQ(program.max_size, max_size) << schema << " -O" << opt;
+            uint32_t lo = 0, hi = 0;
+            ASSERT_EQ(cnd_program_size_bounds(&program, &lo, &hi), CND_ERR_OK);
+            EXPECT_EQ(lo, min_size);
+            EXPECT_EQ(hi, max_size);
+            EXPECT_EQ(cnd_verify_program(&program), CND_ERR_OK);
+        }
+    }
+
+    size_t Encode(SizeRecorder& r) {
+        memset(wire, 0, sizeof(wire));
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, wire, sizeof(wire), size_record_io, &r);
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        return ctx.cursor;
+    }
+
+    void Prepare() {
+        size_t cap = 0;
+        ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+        insns.resize(cap > 0 ? cap : 1);
+        ASSERT_EQ(cnd_program_prepare(&prepared, &program, insns.data(), cap), CND_ERR_OK);
+    }
+};
+
+TEST_F(SizeBoundsTest, FixedPackets) {
+    ExpectBounds("packet P { uint8 a; uint16 b; uint32 c; double d; }", 15, 15);
+    // Bitfields are padded to the next byte-aligned field
+    ExpectBounds("packet P { uint8 a : 3; uint8 b : 2; uint16 c; uint8 d : 4; }", 4, 4);
+    ExpectBounds("packet P { uint8 a; @const(7) uint16 magic; uint8 b[4]; @crc(32) uint32 crc; }", 11, 11);
+}
+
+TEST_F(SizeBoundsTest, VariableParts) {
+    // Terminator included; prefixes bound the length
+    ExpectBounds("packet P { uint8 a; string s max 10; }", 2, 12);
+    ExpectBounds("packet P { string s prefix uint8; }", 1, 256);
+    ExpectBounds("packet P { uint16 a; uint16 v[] prefix uint8; }", 3, 3 + 255 * 2);
+    ExpectBounds("packet P { uint8 a; @optional uint32 b; }", 1, 5);
+
+    // No upper bound
+    ExpectBounds("packet P { uint8 a; string s prefix uint32; }", 5, 0);
+    ExpectBounds("packet P { uint8 n; @count(n) uint16 data[]; }", 1, 0);
+}
+
+TEST_F(SizeBoundsTest, BranchesTakeBothArms) {
+    ExpectBounds("packet P { uint8 mode; if (mode == 1) { uint32 a; } else { uint8 b; } uint8 tail; }", 3, 6);
+    ExpectBounds("packet P { uint8 mode; if (mode == 1) { uint64 a; } uint8 tail; }", 2, 10);
+    ExpectBounds(
+        "packet P { uint8 kind; switch (kind) { case 1: uint16 a; case 2: uint64 b; case 3: { uint8 c; uint8 d; } } }",
+        1, 9);
+    ExpectBounds(
+        "packet P { uint8 kind; switch (kind) { case 1: uint16 a; default: uint32 b; } uint8 tail; }",
+        4, 6);
+}
+
+TEST_F(SizeBoundsTest, SubroutinesAndNesting) {
+    const char* sample = "struct Sample { uint16 id; uint32 time; uint8 flags; uint16 value; uint8 quality; uint32 seq; }";
+    std::string schema = std::string(sample) + "packet Log { uint8 count; Sample first; Sample history[3]; Sample last; }";
+    ExpectBounds(schema.c_str(), 1 + 5 * 14, 1 + 5 * 14);
+
+    // Arms that return straight from a subroutine
+    schema = "struct Tagged { uint8 tag; switch (tag) { case 1: uint16 a; case 2: uint32 b; } uint8 pad; uint8 more; }"
+             "packet P { Tagged x; Tagged y; }";
+    ExpectBounds(schema.c_str(), 6, 14);
+
+    ExpectBounds("struct V { uint8 n; uint16 m[2]; } packet P { V items[] prefix uint8; }", 1, 1 + 255 * 5);
+}
+
+TEST_F(SizeBoundsTest, EncodedSizesAreWithinBounds) {
+    const char* schemas[] = {
+        "packet P { uint8 a : 3; uint8 b : 5; uint16 c; string s max 10; }",
+        "packet P { uint8 mode; if (mode == 1) { uint32 a; } else { string s prefix uint8; } uint8 tail; }",
+        "packet P { uint8 kind; switch (kind) { case 1: uint16 a; case 8: uint64 b; } uint16 v[] prefix uint8; }",
+    };
+    for (const char* schema : schemas) {
+        CompileAndLoad(schema);
+        for (uint32_t count : {0u, 1u, 7u}) {
+            SizeRecorder r;
+            r.count = count;
+            size_t used = Encode(r);
+            EXPECT_GE(used, program.min_size) << schema;
+            EXPECT_LE(used, program.max_size) << schema;
+        }
+    }
+}
+
+TEST_F(SizeBoundsTest, VerifierChecksHeader) {
+    CompileAndLoad("packet P { uint8 a; string s max 10; }");
+    ASSERT_EQ(program.min_size, 2u);
+    ASSERT_EQ(program.max_size, 12u);
+    ASSERT_GE(il_buffer.size(), (size_t)CND_IL_HEADER_SIZE);
+
+    // A claimed minimum above the real one, or a maximum below it, is rejected
+    std::vector<uint8_t> image = il_buffer;
+    cnd_program tampered;
+    image[24] = 3;
+    ASSERT_EQ(cnd_program_load_il(&tampered, image.data(), image.size()), CND_ERR_OK);
+    EXPECT_EQ(cnd_verify_program(&tampered), CND_ERR_VALIDATION);
+    size_t cap = 0;
+    EXPECT_EQ(cnd_program_prepare_size(&tampered, &cap), CND_ERR_VALIDATION);
+
+    image = il_buffer;
+    image[28] = 11;
+    ASSERT_EQ(cnd_program_load_il(&tampered, image.data(), image.size()), CND_ERR_OK);
+    EXPECT_EQ(cnd_verify_program(&tampered), CND_ERR_VALIDATION);
+
+    // Looser bounds and unknown ones are fine
+    image = il_buffer;
+    image[24] = 1;
+    image[28] = 0;
+    ASSERT_EQ(cnd_program_load_il(&tampered, image.data(), image.size()), CND_ERR_OK);
+    EXPECT_EQ(cnd_verify_program(&tampered), CND_ERR_OK);
+
+    // v2 images have no bounds
+    image = il_buffer;
+    image[5] = 2;
+    ASSERT_EQ(cnd_program_load_il(&tampered, image.data(), image.size()), CND_ERR_OK);
+    EXPECT_EQ(tampered.min_size, 0u);
+    EXPECT_EQ(tampered.max_size, 0u);
+    EXPECT_EQ(cnd_verify_program(&tampered), CND_ERR_OK);
+}
+
+TEST_F(SizeBoundsTest, PreparedFixedPrefix) {
+    CompileAndLoad("packet P { uint8 a; @big_endian int16 b; uint32 c; float f; double d; uint8 n; string s max 8; }");
+    Prepare();
+    EXPECT_EQ(prepared.fixed_size, 1u + 2 + 4 + 4 + 8 + 1);
+    EXPECT_GT(prepared.fixed_count, 0u);
+    EXPECT_LE(prepared.fixed_size, program.min_size);
+
+    SizeRecorder enc;
+    size_t len = Encode(enc);
+    ASSERT_EQ(len, prepared.fixed_size + 6);
+
+    // Every buffer length: the prepared run must fail or succeed exactly like
+    // the interpreter, after the same events
+    for (size_t n = 0; n <= len; n++) {
+        SizeRecorder a, b;
+        cnd_init(&ctx, CND_MODE_DECODE, &program, wire, n, size_record_io, &a);
+        cnd_error_t err_a = cnd_execute(&ctx);
+        size_t cursor_a = ctx.cursor;
+        cnd_init(&ctx, CND_MODE_DECODE, &program, wire, n, size_record_io, &b);
+        cnd_error_t err_b = cnd_execute_prepared(&ctx, &prepared);
+        EXPECT_EQ(err_a, err_b) << n;
+        EXPECT_EQ(cursor_a, ctx.cursor) << n;
+        EXPECT_TRUE(a.events == b.events) << n;
+        EXPECT_EQ(err_b == CND_ERR_OK, n == len) << n;
+    }
+
+    // Encoding into a buffer too small for the prefix falls back to checked fields
+    SizeRecorder small;
+    uint8_t out[8];
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, out, sizeof(out), size_record_io, &small);
+    EXPECT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OOB);
+    EXPECT_EQ(ctx.cursor, 7u);
+}
+
+TEST_F(SizeBoundsTest, PrefixStopsAtChecksAndTransforms) {
+    // The checked field itself is read, its check is not
+    CompileAndLoad("packet P { uint8 a; uint16 b; @range(0, 10) uint8 c; uint32 d; }");
+    Prepare();
+    EXPECT_EQ(prepared.fixed_size, 4u);
+
+    CompileAndLoad("packet P { uint8 a; @scale(0.5) uint16 b; uint32 d; }");
+    Prepare();
+    EXPECT_EQ(prepared.fixed_size, 1u);
+
+    CompileAndLoad("packet P { uint8 a : 4; uint8 b : 4; uint32 d; }");
+    Prepare();
+    EXPECT_EQ(prepared.fixed_size, 0u);
+}
@@ -0,0 +1,216 @@
+#include "test_common.h"
+
+// Bulk array spans (CND_CTX_ARRAY_SPANS) must produce the same wire bytes and
+// the same values as the per-element path, for every primitive type, both
+// byte orders and scaled arrays.
+
+static size_t span_elem_size(uint8_t type) {
+    switch (type) {
+        case OP_IO_U8: case OP_IO_I8: return 1;
+        case OP_IO_U16: case OP_IO_I16: return 2;
+        case OP_IO_U32: case OP_IO_I32: case OP_IO_F32: return 4;
+        case OP_IO_U64: case OP_IO_I64: case OP_IO_F64: return 8;
+        default: return 0;
+    }
+}
+
+static double span_load(uint8_t type, const void* p) {
+    switch (type) {
+        case OP_IO_U8: { uint8_t v; memcpy(&v, p, 1); return v; }
+        case OP_IO_I8: { int8_t v; memcpy(&v, p, 1); return v; }
+        case OP_IO_U16: { uint16_t v; memcpy(&v, p, 2); return v; }
+        case OP_IO_I16: { int16_t v; memcpy(&v, p, 2); return v; }
+        case OP_IO_U32: { uint32_t v; memcpy(&v, p, 4); return v; }
+        case OP_IO_I32: { int32_t v; memcpy(&v, p, 4); return v; }
+        case OP_IO_U64: { uint64_t v; memcpy(&v, p, 8); return (double)v; }
+        case OP_IO_I64: { int64_t v; memcpy(&v, p, 8); return (double)v; }
+        case OP_IO_F32: { float v; memcpy(&v, p, 4); return v; }
+        default: { double v; memcpy(&v, p, 8); return v; }
+    }
+}
+
+static void span_store(uint8_t type, void* p, double d) {
+    switch (type) {
+        case OP_IO_U8: { uint8_t v = (uint8_t)d; memcpy(p, &v, 1); break; }
+        case OP_IO_I8: { int8_t v = (int8_t)d; memcpy(p, &v, 1); break; }
+        case OP_IO_U16: { uint16_t v = (uint16_t)d; memcpy(p, &v, 2); break; }
+        case OP_IO_I16: { int16_t v = (int16_t)d; memcpy(p, &v, 2); break; }
+        case OP_IO_U32: { uint32_t v = (uint32_t)d; memcpy(p, &v, 4); break; }
+        case OP_IO_I32: { int32_t v = (int32_t)d; memcpy(p, &v, 4); break; }
+        case OP_IO_U64: { uint64_t v = (uint64_t)d; memcpy(p, &v, 8); break; }
+        case OP_IO_I64: { int64_t v = (int64_t)d; memcpy(p, &v, 8); break; }
+        case OP_IO_F32: { float v = (float)d; memcpy(p, &v, 4); break; }
+        default: memcpy(p, &d, 8); break;
+    }
+}
+
+// Every primitive value in schema order, whether it came one by one or in a span
+struct SpanRecorder {
+    bool accept_spans = true;
+    int fail_span = -1; // Index of a span event to reject
+    int span_events = 0;
+    int elem_events = 0;
+    std::vector<double> values;
+    size_t next = 0;
+};
+
+static cnd_error_t span_io_callback(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    (void)key_id;
+    SpanRecorder* r = (SpanRecorder*)ctx->user_ptr;
+    bool enc = (ctx->mode == CND_MODE_ENCODE);
+    if (type == OP_RAW_BYTES) return CND_ERR_CALLBACK; // Byte arrays come as spans too
+
+    if (type == OP_ARR_SPAN) {
+        if (!r->accept_spans || r->span_events == r->fail_span) return CND_ERR_CALLBACK;
+        r->span_events++;
+        const cnd_span* s = (const cnd_span*)ptr;
+        size_t size = span_elem_size(s->type);
+        for (uint32_t i = 0; i < s->count; i++) {
+            uint8_t* p = (uint8_t*)s->data + i * size;
+            if (enc) span_store(s->type, p, r->values[r->next++]);
+            else r->values.push_back(span_load(s->type, p));
+        }
+        return CND_ERR_OK;
+    }
+
+    if (span_elem_size(type) == 0) return CND_ERR_OK;
+    r->elem_events++;
+    if (enc) span_store(type, ptr, r->values[r->next++]);
+    else r->values.push_back(span_load(type, ptr));
+    return CND_ERR_OK;
+}
+
+class SpanTest : public ConcordiaTest {
+protected:
+    cnd_error_t Run(cnd_mode_t mode, bool spans, SpanRecorder* r, uint8_t* buf, size_t len) {
+        cnd_init(&ctx, mode, &program, buf, len, span_io_callback, r);
+        if (spans) ctx.flags |= CND_CTX_ARRAY_SPANS;
+        return cnd_execute(&ctx);
+    }
+
+    // Encodes `values` per element and with spans; both must give the same bytes
+    std::vector<uint8_t> EncodeBoth(const std::vector<double>& values, int* span_events) {
+        std::vector<uint8_t> plain(4096, 0), bulk(4096, 0);
+        SpanRecorder a, b;
+        a.values = b.values = values;
+        EXPECT_EQ(Run(CND_MODE_ENCODE, false, &a, plain.data(), plain.size()), CND_ERR_OK);
+        size_t used = ctx.cursor;
+        EXPECT_EQ(a.span_events, 0);
+        EXPECT_EQ(Run(CND_MODE_ENCODE, true, &b, bulk.data(), bulk.size()), CND_ERR_OK);
+        EXPECT_EQ(ctx.cursor, used);
+        EXPECT_EQ(plain, bulk);
+        *span_events = b.span_events;
+        plain.resize(used);
+        return plain;
+    }
+};
+
+TEST_F(SpanTest, PrimitiveArraysInBothByteOrders) {
+    CompileAndLoad(
+        "packet P {"
+        "  @big_endian int16 a[19];"
+        "  @big_endian uint32 b[9];"
+        "  @big_endian double c[5];"
+        "  @big_endian int64 d[3];"
+        "  @big_endian float e[6];"
+        "  @little_endian float f[7];"
+        "  @little_endian uint16 g[4];"
+        "  int8 h[5];"
+        "  uint8 tag;"
+        "}"
+    );
+    std::vector<double> values;
+    for (int i = 0; i < 19; i++) values.push_back(-1000.0 * i + 7);
+    for (int i = 0; i < 9; i++) values.push_back(123456789.0 * i);
+    for (int i = 0; i < 5; i++) values.push_back(-0.125 * i + 1e10);
+    for (int i = 0; i < 3; i++) values.push_back(-(double)(1LL << 40) * i);
+    for (int i = 0; i < 6; i++) values.push_back(0.75 * i - 2);
+    for (int i = 0; i < 7; i++) values.push_back(-1.5 * i);
+    for (int i = 0; i < 4; i++) values.push_back(60000 + i);
+    for (int i = 0; i < 5; i++) values.push_back(i - 3);
+    values.push_back(0xAB);
+
+    int span_events = 0;
+    std::vector<uint8_t> wire = EncodeBoth(values, &span_events);
+    EXPECT_EQ(span_events, 8);
+    EXPECT_EQ(wire[2], 0xFC); // a[1] = -993, big endian
+    EXPECT_EQ(wire[3], 0x1F);
+    EXPECT_EQ(wire.back(), 0xAB);
+
+    SpanRecorder plain, bulk;
+    ASSERT_EQ(Run(CND_MODE_DECODE, false, &plain, wire.data(), wire.size()), CND_ERR_OK);
+    ASSERT_EQ(Run(CND_MODE_DECODE, true, &bulk, wire.data(), wire.size()), CND_ERR_OK);
+    EXPECT_EQ(plain.values, values);
+    EXPECT_EQ(bulk.values, values);
+    EXPECT_EQ(bulk.span_events, 8);
+    EXPECT_EQ(bulk.elem_events, 1);
+
+    // Prepared programs take the same path
+    size_t cap = 0;
+    ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+    std::vector<cnd_insn> storage(cap);
+    cnd_prepared prepared;
+    ASSERT_EQ(cnd_program_prepare(&prepared, &program, storage.data(), cap), CND_ERR_OK);
+    SpanRecorder prep;
+    cnd_init(&ctx, CND_MODE_DECODE, &program, wire.data(), wire.size(), span_io_callback, &prep);
+    ctx.flags |= CND_CTX_ARRAY_SPANS;
+    ASSERT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OK);
+    EXPECT_EQ(prep.values, values);
+    EXPECT_EQ(prep.span_events, 8);
+}
+
+TEST_F(SpanTest, ScaledArraysConvertEveryElement) {
+    CompileAndLoad(
+        "packet P {"
+        "  @scale(0.5) @offset(-20.0) @big_endian int16 v[600];"
+        "  @scale(0.25) uint8 w[3];"
+        "}"
+    );
+    std::vector<double> values;
+    for (int i = 0; i < 600; i++) values.push_back((i - 300) * 0.5 - 20.0);
+    for (int i = 0; i < 3; i++) values.push_back(0.25 * (i + 1));
+
+    int span_events = 0;
+    std::vector<uint8_t> wire = EncodeBoth(values, &span_events);
+    EXPECT_EQ(span_events, 4); // 600 elements in chunks of 256, then w
+    ASSERT_EQ(wire.size(), 1203u);
+    EXPECT_EQ(wire[0], 0xFE); // v[0] raw = -300
+    EXPECT_EQ(wire[1], 0xD4);
+    EXPECT_EQ(wire[1198], 0x01); // v[599] raw = 299
+    EXPECT_EQ(wire[1199], 0x2B);
+    EXPECT_EQ(wire[1202], 3);
+
+    SpanRecorder plain, bulk;
+    ASSERT_EQ(Run(CND_MODE_DECODE, false, &plain, wire.data(), wire.size()), CND_ERR_OK);
+    ASSERT_EQ(Run(CND_MODE_DECODE, true, &bulk, wire.data(), wire.size()), CND_ERR_OK);
+    EXPECT_EQ(plain.values, values);
+    EXPECT_EQ(bulk.values, values);
+}
+
+TEST_F(SpanTest, DeclinedSpansRunTheLoop) {
+    CompileAndLoad("packet P { @big_endian uint16 v[300]; uint8 tail; }");
+    std::vector<uint8_t> wire(601);
+    for (size_t i = 0; i < 300; i++) {
+        wire[2 * i] = (uint8_t)(i >> 8);
+        wire[2 * i + 1] = (uint8_t)i;
+    }
+    wire[600] = 9;
+
+    SpanRecorder declined;
+    declined.accept_spans = false;
+    ASSERT_EQ(Run(CND_MODE_DECODE, true, &declined, wire.data(), wire.size()), CND_ERR_OK);
+    EXPECT_EQ(declined.elem_events, 301);
+    ASSERT_EQ(declined.values.size(), 301u);
+    EXPECT_EQ(declined.values[299], 299);
+
+    // A span rejected after the first one is a callback error
+    SpanRecorder partial;
+    partial.fail_span = 1;
+    EXPECT_EQ(Run(CND_MODE_DECODE, true, &partial, wire.data(), wire.size()), CND_ERR_CALLBACK);
+    EXPECT_EQ(partial.values.size(), 256u);
+
+    // Truncated arrays are reported by the loop as before
+    SpanRecorder shortbuf;
+    EXPECT_EQ(Run(CND_MODE_DECODE, true, &shortbuf, wire.data(), 300), CND_ERR_OOB);
+    EXPECT_EQ(shortbuf.span_events, 0);
+}
@@ -0,0 +1,373 @@
+#include "test_common.h"
+#include <string>
+
+// Streaming decode (cnd_stream) must report exactly the events of a decode
+// of the whole packet, however the packet is cut into chunks, without
+// decoding any field twice.
+
+static const char* STREAM_SCHEMA =
+    "struct Pt { int16 x; @big_endian uint32 y; }"
+    "packet Frame {"
+    "  @const(0xA55A) uint16 sync;"
+    "  uint8 version;"
+    "  @crc_begin uint32 seq;"
+    "  @big_endian int64 stamp;"
+    "  double value;"
+    "  float ratio;"
+    "  bool armed;"
+    "  uint8 flags : 3;"
+    "  int8 delta : 5;"
+    "  uint16 wide : 12;"
+    "  uint8 tiny : 4;"
+    "  string name prefix uint8;"
+    "  string tag until 0x00 max 16;"
+    "  Pt pts[] prefix uint8;"
+    "  uint8 payload[] prefix uint32;"
+    "  @crc(32) uint32 crc;"
+    "}";
+
+static uint32_t value_size(uint8_t type) {
+    switch (type) {
+        case OP_IO_U8: case OP_IO_I8: return 1;
+        case OP_IO_U16: case OP_IO_I16: return 2;
+        case OP_IO_U32: case OP_IO_I32: case OP_IO_F32: return 4;
+        case OP_IO_U64: case OP_IO_I64: case OP_IO_F64: return 8;
+        default: return 0;
+    }
+}
+
+// Encode side: deterministic values for every field
+struct StreamGen {
+    uint32_t payload_len = 300;
+    uint8_t next = 1;
+    uint32_t array_count = 0;
+};
+
+static cnd_error_t stream_gen_io(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    (void)key_id;
+    StreamGen* g = (StreamGen*)ctx->user_ptr;
+    switch (type) {
+        case OP_ARR_PRE_U8: *(uint8_t*)ptr = 3; g->array_count = 3; break;
+        case OP_ARR_PRE_U16: *(uint16_t*)ptr = 3; g->array_count = 3; break;
+        case OP_ARR_PRE_U32: *(uint32_t*)ptr = g->payload_len; g->array_count = g->payload_len; break;
+        case OP_STR_PRE_U8: case OP_STR_PRE_U16: case OP_STR_PRE_U32: *(const char**)ptr = "streaming"; break;
+        case OP_STR_NULL: *(const char**)ptr = "tag"; break;
+        case OP_RAW_BYTES:
+            for (uint32_t i = 0; i < g->array_count; i++) ((uint8_t*)ptr)[i] = (uint8_t)(g->next++ * 7);
+            break;
+        case OP_IO_BOOL: case OP_IO_BIT_BOOL: *(uint8_t*)ptr = g->next++ & 1; break;
+        case OP_IO_BIT_U: case OP_IO_BIT_I: *(uint64_t*)ptr = g->next++ * 37u; break;
+        default:
+            for (uint32_t i = 0; i < value_size(type); i++) ((uint8_t*)ptr)[i] = g->next++;
+            break;
+    }
+    return CND_ERR_OK;
+}
+
+// Decode side: one line per event. Byte arrays are logged byte by byte so
+// that OP_RAW_BYTES, streamed OP_ARR_SPAN events and the per-element events
+// of an array cut by a chunk boundary compare equal.
+struct StreamLog {
+    std::vector<std::string> events;
+    uint32_t array_count = 0;
+    uint16_t array_key = 0xFFFF;
+    int spans = 0;
+    const uint8_t* chunk = nullptr; // Spans must point into it or the carry when set
+    size_t chunk_len = 0;
+    const uint8_t* carry = nullptr;
+    size_t carry_size = 0;
+};
+
+static bool within(const void* p, size_t n, const uint8_t* buf, size_t len) {
+    return buf && (const uint8_t*)p >= buf && (const uint8_t*)p + n <= buf + len;
+}
+
+static void log_bytes(StreamLog* log, uint16_t key, const uint8_t* p, size_t n) {
+    for (size_t i = 0; i < n; i++) log->events.push_back("b" + std::to_string(key) + ":" + std::to_string(p[i]));
+}
+
+static cnd_error_t stream_log_io(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    StreamLog* log = (StreamLog*)ctx->user_ptr;
+    std::string e = std::to_string(key_id) + "/" + std::to_string(type) + ":";
+    if (type == OP_ARR_PRE_U8 || type == OP_ARR_PRE_U16 || type == OP_ARR_PRE_U32) log->array_key = key_id;
+    if (type == OP_IO_U8 && key_id == log->array_key) {
+        log_bytes(log, key_id, (const uint8_t*)ptr, 1);
+        return CND_ERR_OK;
+    }
+    switch (type) {
+        case OP_ARR_END:
+            return CND_ERR_OK; // Spans replace it
+        case OP_ARR_SPAN: {
+            const cnd_span* s = (const cnd_span*)ptr;
+            if (log->chunk && !within(s->data, s->count, log->chunk, log->chunk_len) &&
+                !within(s->data, s->count, log->carry, log->carry_size)) {
+                ADD_FAILURE() << "span outside the chunk and the carry";
+            }
+            log->spans++;
+            log_bytes(log, key_id, (const uint8_t*)s->data, s->count);
+            return CND_ERR_OK;
+        }
+        case OP_RAW_BYTES:
+            log_bytes(log, key_id, (const uint8_t*)ptr, log->array_count);
+            return CND_ERR_OK;
+        case OP_ARR_PRE_U8: log->array_count = *(uint8_t*)ptr; e += std::to_string(log->array_count); break;
+        case OP_ARR_PRE_U16: log->array_count = *(uint16_t*)ptr; e += std::to_string(log->array_count); break;
+        case OP_ARR_PRE_U32: log->array_count = *(uint32_t*)ptr; e += std::to_string(log->array_count); break;
+        case OP_STR_PRE_U8: e += std::string((const char*)ptr, ((const uint8_t*)ptr)[-1]); break;
+        case OP_STR_NULL: e += (const char*)ptr; break;
+        case OP_IO_BIT_U: case OP_IO_BIT_I: e += std::to_string(*(uint64_t*)ptr); break;
+        case OP_IO_BOOL: case OP_IO_BIT_BOOL: e += std::to_string(*(uint8_t*)ptr); break;
+        default:
+            for (uint32_t i = 0; i < value_size(type); i++) e += std::to_string(((uint8_t*)ptr)[i]) + ".";
+            break;
+    }
+    log->events.push_back(e);
+    return CND_ERR_OK;
+}
+
+class StreamTest : public ConcordiaTest {
+protected:
+    std::vector<uint8_t> packet;
+    uint8_t carry[64];
+    cnd_stream stream;
+
+    void BuildPacket(uint32_t payload_len = 300) {
+        StreamGen gen;
+        gen.payload_len = payload_len;
+        packet.assign(payload_len + 256, 0);
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, packet.data(), packet.size(), stream_gen_io, &gen);
+        ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        packet.resize(ctx.cursor);
+    }
+
+    StreamLog DecodeWhole(uint8_t flags) {
+        StreamLog log;
+        cnd_init(&ctx, CND_MODE_DECODE, &program, packet.data(), packet.size(), stream_log_io, &log);
+        ctx.flags = flags;
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        return log;
+    }
+
+    // Feeds the packet `chunk` bytes at a time from a scratch copy that is
+    // overwritten after every call, like a reused socket buffer
+    cnd_error_t DecodeChunked(size_t chunk, uint8_t flags, StreamLog* log, size_t carry_size = sizeof(carry)) {
+        EXPECT_EQ(cnd_stream_init(&stream, &program, carry, carry_size, stream_log_io, log), CND_ERR_OK);
+        stream.ctx.flags |= flags;
+        log->carry = carry;
+        log->carry_size = carry_size;
+        std::vector<uint8_t> scratch(chunk);
+        cnd_error_t err = CND_ERR_NEED_MORE;
+        for (size_t off = 0; off < packet.size(); off += chunk) {
+            size_t n = std::min(chunk, packet.size() - off);
+            memcpy(scratch.data(), packet.data() + off, n);
+            log->chunk = scratch.data();
+            log->chunk_len = n;
+            size_t used = 0;
+            err = cnd_stream_feed(&stream, scratch.data(), n, &used);
+            memset(scratch.data(), 0xEE, chunk);
+            if (err != CND_ERR_NEED_MORE) {
+                if (err == CND_ERR_OK) {
+                    EXPECT_EQ(off + used, packet.size());
+                }
+                break;
+            }
+            EXPECT_EQ(used, n);
+        }
+        return err;
+    }
+};
+
+TEST_F(StreamTest, EveryChunkSizeMatchesWholeBuffer) {
+    for (int opt = 0; opt <= 1; opt++) {
+        CompileAndLoad(STREAM_SCHEMA, opt);
+        BuildPacket();
+        for (uint8_t flags : {(uint8_t)0, (uint8_t)CND_CTX_ARRAY_SPANS}) {
+            StreamLog whole = DecodeWhole(flags);
+            ASSERT_GT(whole.events.size(), 300u);
+            for (size_t chunk = 1; chunk <= packet.size(); chunk++) {
+                StreamLog log;
+                ASSERT_EQ(DecodeChunked(chunk, flags, &log), CND_ERR_OK) << "chunk " << chunk << " opt " << opt;
+                ASSERT_EQ(log.events, whole.events) << "chunk " << chunk << " opt " << opt;
+            }
+        }
+    }
+}
+
+TEST_F(StreamTest, NeedMoreKeepsThePlaceInTheProgram) {
+    CompileAndLoad("packet P { uint8 a; uint32 b; uint8 c; }");
+    packet = {1, 2, 3, 4, 5, 6};
+    StreamLog log;
+    ASSERT_EQ(cnd_stream_init(&stream, &program, carry, sizeof(carry), stream_log_io, &log), CND_ERR_OK);
+
+    // `b` is cut after two bytes: `a` is done, `b` waits in the carry
+    size_t used = 0;
+    ASSERT_EQ(cnd_stream_feed(&stream, packet.data(), 3, &used), CND_ERR_NEED_MORE);
+    EXPECT_EQ(used, 3u);
+    EXPECT_EQ(log.events.size(), 1u);
+    EXPECT_EQ(program.bytecode[stream.ctx.ip], OP_IO_U32);
+    EXPECT_EQ(stream.ctx.cursor, 0u);
+    EXPECT_EQ(stream.carry_len, 2u);
+
+    ASSERT_EQ(cnd_stream_feed(&stream, packet.data() + 3, 1, &used), CND_ERR_NEED_MORE);
+    EXPECT_EQ(log.events.size(), 1u);
+    ASSERT_EQ(cnd_stream_feed(&stream, packet.data() + 4, 2, &used), CND_ERR_OK);
+    EXPECT_EQ(used, 2u);
+    ASSERT_EQ(log.events.size(), 3u);
+    EXPECT_EQ(log.events[1], "1/" + std::to_string(OP_IO_U32) + ":2.3.4.5.");
+}
+
+TEST_F(StreamTest, LargePayloadStreamsWithoutCopies) {
+    CompileAndLoad("packet P { uint16 id; uint8 payload[] prefix uint32; uint16 tail; }");
+    const uint32_t n = 100000;
+    packet.assign(2 + 4 + n + 2, 0);
+    packet[2] = n & 0xFF;
+    packet[3] = (n >> 8) & 0xFF;
+    packet[4] = (n >> 16) & 0xFF;
+    for (uint32_t i = 0; i < n; i++) packet[6 + i] = (uint8_t)(i * 13);
+
+    StreamLog whole = DecodeWhole(CND_CTX_ARRAY_SPANS);
+    const size_t mss = 1460;
+    StreamLog log;
+    ASSERT_EQ(DecodeChunked(mss, CND_CTX_ARRAY_SPANS, &log, 8), CND_ERR_OK);
+    EXPECT_EQ(log.events, whole.events);
+    EXPECT_EQ(log.spans, (int)((packet.size() + mss - 1) / mss));
+    EXPECT_LE(stream.carry_len, 8u);
+}
+
+TEST_F(StreamTest, CrcCoversBytesOfEarlierChunks) {
+    CompileAndLoad(STREAM_SCHEMA);
+    BuildPacket();
+    for (size_t chunk : {1, 5, 64, 200}) {
+        StreamLog log;
+        ASSERT_EQ(DecodeChunked(chunk, 0, &log), CND_ERR_OK);
+    }
+    packet[20] ^= 0x10;
+    for (size_t chunk : {1, 5, 64, 200}) {
+        StreamLog log;
+        EXPECT_EQ(DecodeChunked(chunk, 0, &log), CND_ERR_CRC_MISMATCH) << "chunk " << chunk;
+    }
+}
+
+TEST_F(StreamTest, CrcAfterASwitchIsFound) {
+    // The CRC scan steps over the switch table to the @crc after it
+    for (int opt = 0; opt <= 1; opt++) {
+        CompileAndLoad("packet P { uint8 mode; switch (mode) { case 0: { uint8 x0; } case 1: { uint16 x1; } }"
+                       "  @crc(16) uint16 crc; }", opt);
+        BuildPacket();
+        StreamLog whole = DecodeWhole(0);
+        for (size_t chunk = 1; chunk <= packet.size(); chunk++) {
+            StreamLog log;
+            ASSERT_EQ(DecodeChunked(chunk, 0, &log), CND_ERR_OK) << "chunk " << chunk << " opt " << opt;
+            EXPECT_EQ(stream.crc_width, 16);
+            EXPECT_EQ(log.events, whole.events) << "chunk " << chunk << " opt " << opt;
+        }
+    }
+}
+
+TEST_F(StreamTest, EndOfInputSettlesOptionalAndEofFields) {
+    CompileAndLoad("packet P { uint8 a; @optional uint16 b; }");
+    StreamLog log;
+    uint8_t a = 7;
+    ASSERT_EQ(cnd_stream_init(&stream, &program, carry, sizeof(carry), stream_log_io, &log), CND_ERR_OK);
+    ASSERT_EQ(cnd_stream_feed(&stream, &a, 1, NULL), CND_ERR_NEED_MORE);
+    EXPECT_EQ(log.events.size(), 1u); // `b` could still arrive
+    ASSERT_EQ(cnd_stream_finish(&stream), CND_ERR_OK);
+    ASSERT_EQ(log.events.size(), 2u);
+    EXPECT_EQ(log.events[1], "1/" + std::to_string(OP_IO_U16) + ":0.0.");
+
+    CompileAndLoad("packet P { uint8 a; @eof uint16 rest[]; }");
+    packet = {1, 2, 3, 4, 5};
+    StreamLog eof;
+    ASSERT_EQ(DecodeChunked(2, 0, &eof), CND_ERR_NEED_MORE);
+    ASSERT_EQ(cnd_stream_finish(&stream), CND_ERR_OK);
+    EXPECT_EQ(eof.events, DecodeWhole(0).events);
+
+    // A field cut short by the end of input is still an error
+    CompileAndLoad("packet P { uint8 a; uint32 b; }");
+    packet = {1, 2, 3};
+    StreamLog cut;
+    ASSERT_EQ(DecodeChunked(2, 0, &cut), CND_ERR_NEED_MORE);
+    EXPECT_EQ(cnd_stream_finish(&stream), CND_ERR_OOB);
+}
+
+TEST_F(StreamTest, BackToBackPacketsInOneChunk) {
+    CompileAndLoad("packet P { uint8 a; string s prefix uint8; }");
+    std::vector<uint8_t> wire = {1, 2, 'h', 'i', 9, 3, 'a', 'b', 'c', 4};
+    StreamLog log;
+    ASSERT_EQ(cnd_stream_init(&stream, &program, carry, sizeof(carry), stream_log_io, &log), CND_ERR_OK);
+    size_t used = 0;
+    ASSERT_EQ(cnd_stream_feed(&stream, wire.data(), wire.size(), &used), CND_ERR_OK);
+    ASSERT_EQ(used, 4u);
+
+    cnd_stream_reset(&stream);
+    ASSERT_EQ(cnd_stream_feed(&stream, wire.data() + used, wire.size() - used, &used), CND_ERR_OK);
+    EXPECT_EQ(used, 5u);
+    ASSERT_EQ(log.events.size(), 4u);
+    EXPECT_EQ(log.events[3], "1/" + std::to_string(OP_STR_PRE_U8) + ":abc");
+}
+
+TEST_F(StreamTest, Limits) {
+    // A string split between chunks has to fit the carry
+    CompileAndLoad("packet P { string s prefix uint8; }");
+    packet.assign(41, 'x');
+    packet[0] = 40;
+    StreamLog log;
+    EXPECT_EQ(DecodeChunked(30, 0, &log, 16), CND_ERR_OOB);
+    StreamLog fits;
+    EXPECT_EQ(DecodeChunked(30, 0, &fits, 64), CND_ERR_OK);
+
+    // Bytes leaving the stream are hashed with the program's one CRC
+    CompileAndLoad("packet P { uint8 a; @crc(16) uint16 c; @crc(32) uint32 d; }");
+    EXPECT_EQ(cnd_stream_init(&stream, &program, carry, sizeof(carry), stream_log_io, &log), CND_ERR_INVALID_OP);
+    CompileAndLoad("packet P { uint8 a; @crc(16) uint16 c; @crc(16) uint16 d; }");
+    EXPECT_EQ(cnd_stream_init(&stream, &program, carry, sizeof(carry), stream_log_io, &log), CND_ERR_OK);
+    EXPECT_EQ(cnd_stream_init(&stream, &program, NULL, 0, stream_log_io, &log), CND_ERR_INVALID_OP);
+
+    // Streams decode only
+    uint8_t buf[8] = {0};
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, buf, sizeof(buf), stream_log_io, &log);
+    ctx.flags = CND_CTX_STREAM;
+    EXPECT_EQ(cnd_execute(&ctx), CND_ERR_INVALID_OP);
+}
+
+// Host that relies on the -O scoreboard: it fails every context query
+struct SlotHost {
+    StreamLog log;
+    size_t queries = 0;
+};
+
+static cnd_error_t slot_host_io(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr) {
+    SlotHost* h = (SlotHost*)ctx->user_ptr;
+    if (type == OP_CTX_QUERY || type == OP_LOAD_CTX) {
+        h->queries++;
+        return CND_ERR_CALLBACK;
+    }
+    ctx->user_ptr = &h->log;
+    cnd_error_t err = stream_log_io(ctx, key_id, type, ptr);
+    ctx->user_ptr = h;
+    return err;
+}
+
+TEST_F(StreamTest, SplitDiscriminatorKeepsItsScoreboardSlot) {
+    CompileAndLoad("packet P { uint8 pad; uint16 kind;"
+                   "  switch (kind) { case 1: uint32 x; case 2: uint16 y; default: uint8 q; } }", 1);
+    packet = {9, 2, 0, 0x34, 0x12};
+
+    SlotHost whole;
+    cnd_init(&ctx, CND_MODE_DECODE, &program, packet.data(), packet.size(), slot_host_io, &whole);
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    ASSERT_EQ(whole.queries, 0u);
+
+    // Every cut, including the one through `kind`
+    for (size_t chunk = 1; chunk < packet.size(); chunk++) {
+        SlotHost h;
+        ASSERT_EQ(cnd_stream_init(&stream, &program, carry, sizeof(carry), slot_host_io, &h), CND_ERR_OK);
+        cnd_error_t err = CND_ERR_NEED_MORE;
+        for (size_t off = 0; off < packet.size() && err == CND_ERR_NEED_MORE; off += chunk) {
+            err = cnd_stream_feed(&stream, packet.data() + off, std::min(chunk, packet.size() - off), NULL);
+        }
+        EXPECT_EQ(err, CND_ERR_OK) << "chunk " << chunk;
+        EXPECT_EQ(h.queries, 0u) << "chunk " << chunk;
+        EXPECT_EQ(h.log.events, whole.log.events) << "chunk " << chunk;
+    }
+}
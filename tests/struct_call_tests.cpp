@@ -0,0 +1,234 @@
+#include "test_common.h"
+#include <string>
+
+// A struct used by several packet fields is compiled once, as a subroutine,
+// and each use calls it with the Key IDs of its own field names.
+
+static const char* kSample =
+    "struct Sample { uint16 id; uint32 time; uint8 flags; uint16 value; uint8 quality; uint32 seq; }";
+
+struct CallEvent {
+    uint16_t key;
+    uint8_t type;
+    uint64_t value;
+    bool operator==(const CallEvent& o) const { return key == o.key && type == o.type && value == o.value; }
+};
+
+// Encode writes `key * 7 + 1` to every field; decode records what it reads
+struct CallRecorder {
+    std::vector<CallEvent> events;
+};
+
+static size_t call_value_size(uint8_t type) {
+    switch (type) {
+        case OP_IO_U8: case OP_IO_BIT_BOOL: return 1;
+        case OP_IO_U16: return 2;
+        case OP_IO_U32: return 4;
+        case OP_IO_BIT_U: return 8;
+        default: return 0;
+    }
+}
+
+static cnd_error_t call_record_io(cnd_vm_ctx* ctx, uint16_t key, uint8_t type, void* ptr) {
+    CallRecorder* r = (CallRecorder*)ctx->user_ptr;
+    if (type == OP_IO_BIT_GROUP) {
+        // Reported like the per-field events of the group
+        cnd_bit_group* g = (cnd_bit_group*)ptr;
+        for (uint8_t i = 0; i < g->count; i++) {
+            const uint8_t* f = g->fields + i * 4;
+            uint16_t k = (uint16_t)((f[1] | (f[2] << 8)) + g->key_base);
+            if (ctx->mode == CND_MODE_ENCODE) g->values[i] = (k * 7u + 1) & ((1ULL << f[3]) - 1);
+            r->events.push_back({k, f[0], g->values[i]});
+        }
+        return CND_ERR_OK;
+    }
+    size_t size = call_value_size(type);
+    uint64_t v = 0;
+    if (size > 0) {
+        if (ctx->mode == CND_MODE_ENCODE) {
+            v = key * 7u + 1;
+            if (type == OP_IO_BIT_BOOL) v &= 1;
+            memcpy(ptr, &v, size);
+        } else {
+            memcpy(&v, ptr, size);
+        }
+    } else if (type == OP_CTX_QUERY) {
+        // Switch discriminators are the first field of the packet
+        *(uint64_t*)ptr = 2;
+    }
+    r->events.push_back({key, type, v});
+    return CND_ERR_OK;
+}
+
+class StructCallTest : public ConcordiaTest {
+protected:
+    std::vector<cnd_insn> insns;
+    cnd_prepared prepared;
+    uint8_t wire[256];
+    size_t wire_len = 0;
+
+    void Prepare() {
+        size_t cap = 0;
+        ASSERT_EQ(cnd_program_prepare_size(&program, &cap), CND_ERR_OK);
+        insns.resize(cap > 0 ? cap : 1);
+        ASSERT_EQ(cnd_program_prepare(&prepared, &program, insns.data(), cap), CND_ERR_OK);
+    }
+
+    size_t CountCalls() {
+        size_t calls = 0;
+        for (size_t i = 0; i < prepared.insn_count; i++) {
+            if (insns[i].op == OP_CALL) calls++;
+        }
+        return calls;
+    }
+
+    uint16_t Key(const char* name) {
+        uint16_t key = cnd_get_key_id(&program, name);
+        EXPECT_NE(key, 0xFFFF) << name;
+        return key;
+    }
+
+    // Encodes, then decodes with both executors, which must see the same events
+    std::vector<CallEvent> RoundTrip(uint32_t flags = 0) {
+        CallRecorder enc;
+        memset(wire, 0, sizeof(wire));
+        cnd_init(&ctx, CND_MODE_ENCODE, &program, wire, sizeof(wire), call_record_io, &enc);
+        ctx.flags |= flags;
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        wire_len = ctx.cursor;
+
+        CallRecorder dec, dec_prepared;
+        cnd_init(&ctx, CND_MODE_DECODE, &program, wire, wire_len, call_record_io, &dec);
+        ctx.flags |= flags;
+        EXPECT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+        EXPECT_EQ(ctx.cursor, wire_len);
+        EXPECT_EQ(ctx.call_depth, 0);
+
+        cnd_init(&ctx, CND_MODE_DECODE, &program, wire, wire_len, call_record_io, &dec_prepared);
+        ctx.flags |= flags;
+        EXPECT_EQ(cnd_execute_prepared(&ctx, &prepared), CND_ERR_OK);
+        EXPECT_EQ(ctx.cursor, wire_len);
+        EXPECT_TRUE(dec.events == dec_prepared.events);
+        return dec.events;
+    }
+
+    // Checks that every field event of the decode is named `prefix.field` and
+    // carries the value encoded for its key
+    void ExpectFields(const std::vector<CallEvent>& events, const char* prefix, int expected) {
+        std::string want = std::string(prefix) + ".";
+        int seen = 0;
+        for (const CallEvent& e : events) {
+            const char* name = cnd_get_key_name(&program, e.key);
+            ASSERT_NE(name, nullptr);
+            if (call_value_size(e.type) == 0 || std::string(name).rfind(want, 0) != 0) continue;
+            uint64_t v = e.key * 7u + 1;
+            if (e.type != OP_IO_BIT_U && e.type != OP_IO_BIT_BOOL) {
+                size_t size = call_value_size(e.type);
+                if (size < 8) v &= (1ULL << (size * 8)) - 1;
+            }
+            if (e.type == OP_IO_BIT_BOOL) v &= 1;
+            if (e.type == OP_IO_BIT_U) v &= 0x3F; // 6-bit fields
+            EXPECT_EQ(e.value, v) << name;
+            seen++;
+        }
+        EXPECT_EQ(seen, expected) << prefix;
+    }
+};
+
+TEST_F(StructCallTest, ReusedStructIsEmittedOnce) {
+    std::string two = std::string(kSample) + "packet Log { uint8 count; Sample first; Sample second; }";
+    std::string three = std::string(kSample) + "packet Log { uint8 count; Sample first; Sample second; Sample third; }";
+
+    CompileAndLoad(two.c_str());
+    size_t two_len = program.bytecode_len;
+    CompileAndLoad(three.c_str());
+    Prepare();
+    EXPECT_EQ(CountCalls(), 3u);
+
+    // One more use costs ENTER_STRUCT + OP_CALL + EXIT_STRUCT, not the body
+    EXPECT_EQ(program.bytecode_len - two_len, 3u + 9u + 1u);
+
+    // Each instance's fields have consecutive Key IDs in field order
+    EXPECT_EQ(Key("third.time"), Key("third.id") + 1);
+    EXPECT_EQ(Key("third.seq"), Key("third.id") + 5);
+    EXPECT_EQ(Key("second.id"), Key("second") + 1);
+}
+
+TEST_F(StructCallTest, RoundTripReportsPrefixedKeys) {
+    std::string schema = std::string(kSample) +
+        "packet Log { uint8 count; Sample first; Sample history[3]; Sample last; uint8 tail; }";
+    CompileAndLoad(schema.c_str());
+    ASSERT_EQ(cnd_verify_program(&program), CND_ERR_OK);
+    Prepare();
+    EXPECT_EQ(CountCalls(), 3u);
+
+    std::vector<CallEvent> events = RoundTrip();
+    EXPECT_EQ(wire_len, 1u + 5 * 14 + 1);
+    ExpectFields(events, "first", 6);
+    ExpectFields(events, "history", 18);
+    ExpectFields(events, "last", 6);
+    EXPECT_EQ(events.back().key, Key("tail"));
+}
+
+TEST_F(StructCallTest, FieldAccessUsesLayout) {
+    std::string schema = std::string(kSample) + "packet Log { uint8 count; Sample first; Sample second; }";
+    CompileAndLoad(schema.c_str());
+    Prepare();
+    RoundTrip();
+
+    // second.value: count(1) + first(14) + id(2) + time(4) + flags(1)
+    uint64_t v = 0;
+    uint16_t key = Key("second.value");
+    ASSERT_EQ(cnd_field_read(&program, wire, wire_len, key, &v), CND_ERR_OK);
+    EXPECT_EQ(v, (key * 7u + 1) & 0xFFFF);
+    EXPECT_EQ(wire[1 + 14 + 7], (uint8_t)(key * 7u + 1));
+
+    ASSERT_EQ(cnd_field_write(&program, wire, wire_len, key, 0x1234), CND_ERR_OK);
+    EXPECT_EQ(wire[1 + 14 + 7], 0x34);
+}
+
+TEST_F(StructCallTest, BitGroupsCarryKeyBase) {
+    std::string schema =
+        "struct Status { bool ready : 1; bool error : 1; uint8 mode : 6; uint16 id; uint32 time; uint16 value; }"
+        "packet P { uint8 count; Status a; Status b; }";
+    CompileAndLoad(schema.c_str());
+    Prepare();
+    EXPECT_EQ(CountCalls(), 2u);
+
+    std::vector<CallEvent> events = RoundTrip();
+    ExpectFields(events, "a", 6);
+    ExpectFields(events, "b", 6);
+
+    // Group events add the key base themselves
+    std::vector<uint8_t> fields_wire(wire, wire + wire_len);
+    std::vector<CallEvent> grouped = RoundTrip(CND_CTX_BIT_GROUPS);
+    EXPECT_TRUE(grouped == events);
+    EXPECT_TRUE(std::vector<uint8_t>(wire, wire + wire_len) == fields_wire);
+}
+
+TEST_F(StructCallTest, NestedStructsStayInBody) {
+    std::string schema = std::string(kSample) +
+        "struct Tagged { uint8 tag; Sample inner; }"
+        "packet P { Tagged a; Tagged b; }";
+    CompileAndLoad(schema.c_str());
+    ASSERT_EQ(cnd_verify_program(&program), CND_ERR_OK);
+    Prepare();
+    EXPECT_EQ(CountCalls(), 2u);
+
+    std::vector<CallEvent> events = RoundTrip();
+    ExpectFields(events, "a", 7);
+    ExpectFields(events, "b.inner", 6);
+    EXPECT_EQ(Key("b.inner.seq"), Key("b.tag") + 7);
+}
+
+TEST_F(StructCallTest, CountReferenceIsInlined) {
+    // The array count is looked up by its unprefixed name, so it cannot be
+    // renumbered into the caller's key block
+    std::string schema =
+        "struct Blob { uint8 n; uint16 id; uint32 time; uint32 seq; @count(n) uint8 data[]; }"
+        "packet P { Blob a; Blob b; }";
+    CompileAndLoad(schema.c_str());
+    ASSERT_EQ(cnd_verify_program(&program), CND_ERR_OK);
+    Prepare();
+    EXPECT_EQ(CountCalls(), 0u);
+}
@@ -38,6 +38,13 @@ typedef struct {
 // C-compatible callback for the VM
 extern "C" cnd_error_t test_io_callback(cnd_vm_ctx* ctx, uint16_t key_id, uint8_t type, void* ptr);
 
+#ifdef CND_JIT_DIFFERENTIAL
+// Runs cnd_execute() and the JIT from the same state and fails the current
+// test if they disagree (jit_differential.cpp)
+cnd_error_t jit_differential_execute(cnd_vm_ctx* ctx);
+#define cnd_execute jit_differential_execute
+#endif
+
 class ConcordiaTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -66,7 +73,7 @@ protected:
         return res == 0;
     }
 
-    void CompileAndLoad(const char* source) {
+    void CompileAndLoad(const char* source, int opt_level = 0) {
         m_tctx.use_tape = false;
         m_tctx.tape_index = 0;
         
@@ -77,7 +84,7 @@ protected:
         out << source;
         out.close();
         
-        int res = cnd_compile_file(tmp_src, tmp_il, 0, 0);
+        int res = cnd_compile_file_ex(tmp_src, tmp_il, 0, 0, opt_level);
         ASSERT_EQ(res, 0) << "Compilation failed";
         
         std::ifstream f(tmp_il, std::ios::binary | std::ios::ate);
@@ -15,7 +15,7 @@ TEST_F(VerifierTest, ValidProgram) {
     uint8_t bytecode[] = {
         OP_PUSH_IMM, 10, 0, 0, 0, 0, 0, 0, 0
     };
-    cnd_program prog;
+    cnd_program prog = {};
     prog.bytecode = bytecode;
     prog.bytecode_len = sizeof(bytecode);
     prog.string_table = nullptr;
@@ -28,7 +28,7 @@ TEST_F(VerifierTest, InvalidOpcode) {
     uint8_t bytecode[] = {
         0xFF // Invalid opcode
     };
-    cnd_program prog;
+    cnd_program prog = {};
     prog.bytecode = bytecode;
     prog.bytecode_len = sizeof(bytecode);
 
@@ -40,7 +40,7 @@ TEST_F(VerifierTest, OOB_Arg) {
     uint8_t bytecode[] = {
         OP_PUSH_IMM, 10, 0 // Missing bytes
     };
-    cnd_program prog;
+    cnd_program prog = {};
     prog.bytecode = bytecode;
     prog.bytecode_len = sizeof(bytecode);
 
@@ -70,7 +70,7 @@ TEST_F(VerifierTest, SwitchTable_Valid) {
         0, 0, 0, 0  // Offset 1
     };
     
-    cnd_program prog;
+    cnd_program prog = {};
     prog.bytecode = bytecode;
     prog.bytecode_len = sizeof(bytecode);
 
@@ -92,7 +92,7 @@ TEST_F(VerifierTest, SwitchTable_OOB) {
         0xFF, 0xFF, 0xFF, 0x7F // INT32_MAX
     };
     
-    cnd_program prog;
+    cnd_program prog = {};
     prog.bytecode = bytecode;
     prog.bytecode_len = sizeof(bytecode);
 
@@ -117,9 +117,218 @@ TEST_F(VerifierTest, Switch_Valid) {
         0, 0, 0, 0 // Offset 0
     };
     
-    cnd_program prog;
+    cnd_program prog = {};
     prog.bytecode = bytecode;
     prog.bytecode_len = sizeof(bytecode);
 
     EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OK);
 }
+
+TEST_F(VerifierTest, SwitchSorted_Unsorted) {
+    // OP_SWITCH_SORTED shares the OP_SWITCH table, but values must ascend
+    uint8_t bytecode[] = {
+        OP_SWITCH_SORTED, 0, 0,
+        0, 0, 0, 0, // Rel 0
+
+        // Table
+        2, 0, // Count 2
+        0, 0, 0, 0, // Default 0
+        9, 0, 0, 0, 0, 0, 0, 0, // Val 9
+        0, 0, 0, 0,
+        5, 0, 0, 0, 0, 0, 0, 0, // Val 5
+        0, 0, 0, 0
+    };
+
+    cnd_program prog = {};
+    prog.bytecode = bytecode;
+    prog.bytecode_len = sizeof(bytecode);
+
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_VALIDATION);
+
+    bytecode[13] = 1; // Val 1 < 5
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OK);
+}
+
+TEST_F(VerifierTest, EnumSorted_Unsorted) {
+    uint8_t bytecode[] = {
+        OP_ENUM_SORTED, OP_IO_U16,
+        3, 0, // Count 3
+        1, 0, 0, 2, 0x10, 0 // 1, 0x200, 0x10
+    };
+
+    cnd_program prog = {};
+    prog.bytecode = bytecode;
+    prog.bytecode_len = sizeof(bytecode);
+
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_VALIDATION);
+
+    bytecode[9] = 3; // 0x310 > 0x200
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OK);
+
+    prog.bytecode_len--; // Truncated value table
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OOB);
+}
+
+TEST_F(VerifierTest, EnumBitmap_Truncated) {
+    uint8_t bytecode[] = {
+        OP_ENUM_BITMAP, OP_IO_U8,
+        10, // Base
+        9, 0, // Span 9
+        0x01, 0x01 // 10, 18
+    };
+
+    cnd_program prog = {};
+    prog.bytecode = bytecode;
+    prog.bytecode_len = sizeof(bytecode);
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OK);
+
+    bytecode[3] = 17; // Needs 3 bytes of bits
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OOB);
+}
+
+TEST_F(VerifierTest, Call_Target) {
+    uint8_t bytecode[] = {
+        OP_CALL, 0, 0, 1, 0, 1, 0, 0, 0, // Body behind the RET
+        OP_RET,
+        OP_IO_U8, 0, 0,
+        OP_RET
+    };
+
+    cnd_program prog = {};
+    prog.bytecode = bytecode;
+    prog.bytecode_len = sizeof(bytecode);
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OK);
+
+    bytecode[5] = 6; // Past the end
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OOB);
+
+    bytecode[5] = 0xF0; bytecode[6] = 0xFF; bytecode[7] = 0xFF; bytecode[8] = 0xFF; // Before the start
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OOB);
+}
+
+TEST_F(VerifierTest, SwitchHash) {
+    // Table: Default(4) + Mult(8) + SlotBits(1) + BucketBits(1)
+    //   + Disp(2) * 2^BucketBits + [Val(8) + Off(4)] * 2^SlotBits
+    uint8_t bytecode[] = {
+        OP_SWITCH_HASH, 0, 0,
+        0, 0, 0, 0, // Rel 0
+
+        // Table
+        0, 0, 0, 0, // Default 0
+        1, 0, 0, 0, 0, 0, 0, 0, // Mult 1
+        1, 1, // 2 slots, 2 buckets
+        0, 0, 1, 0, // Displacements
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // Slot 0
+        3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0  // Slot 1: Val 3
+    };
+
+    cnd_program prog = {};
+    prog.bytecode = bytecode;
+    prog.bytecode_len = sizeof(bytecode);
+
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OK);
+
+    // Displacement outside the slot array
+    bytecode[23] = 2;
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_VALIDATION);
+    bytecode[23] = 1;
+
+    // No slots
+    bytecode[19] = 0;
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_VALIDATION);
+
+    // Table larger than the program
+    bytecode[19] = 2;
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OOB);
+}
+
+TEST_F(VerifierTest, Superinstructions) {
+    uint8_t bytecode[] = {
+        OP_IO_RUN, 2, 3, 0, // Count 2, Bytes 3
+        OP_IO_U8, 0, 0,
+        OP_IO_U16, 1, 0,
+        OP_IO_CHECK, OP_IO_U16, 2, 0,
+        OP_ENUM_SORTED, OP_IO_U16, 2, 0, 5, 0, 9, 0
+    };
+
+    cnd_program prog = {};
+    prog.bytecode = bytecode;
+    prog.bytecode_len = sizeof(bytecode);
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OK);
+
+    bytecode[2] = 4; // Bytes must match the fields
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_INVALID_OP);
+    bytecode[2] = 3;
+
+    bytecode[7] = OP_IO_BIT_U; // Only byte-aligned primitives
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_INVALID_OP);
+    bytecode[7] = OP_IO_U16;
+
+    bytecode[15] = OP_IO_U8; // Check type must be the field type
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_INVALID_OP);
+    bytecode[15] = OP_IO_U16;
+
+    bytecode[18] = 10; // Embedded sorted values are checked too
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_VALIDATION);
+}
+
+TEST_F(VerifierTest, ScoreboardSlot) {
+    uint8_t bytecode[] = {
+        OP_NOOP,
+        OP_IO_SLOT, OP_IO_I16, 1, 0,
+        OP_IO_SLOT, OP_IO_BOOL, 2, 0
+    };
+
+    cnd_program prog = {};
+    prog.bytecode = bytecode;
+    prog.bytecode_len = sizeof(bytecode);
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OK);
+
+    bytecode[2] = OP_IO_F32; // Integer and bool fields only
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_INVALID_OP);
+    bytecode[2] = OP_IO_I16;
+
+    bytecode[0] = OP_MARK_OPTIONAL; // The value must be the raw field
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_INVALID_OP);
+    bytecode[0] = OP_NOOP;
+
+    prog.bytecode_len = sizeof(bytecode) - 1;
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OOB);
+}
+
+TEST_F(VerifierTest, RegisterExpression) {
+    // r0 = ctx[1]; r1 = r0 * 3; f0 = r1; f1 = 1.5; r0 = f0 > f1; return r0
+    uint8_t bytecode[] = {
+        OP_EXPR, 32,
+        OP_REG_LOAD, 0, 1, 0,
+        OP_MUL, 1 | CND_EXPR_IMM, 0, 3,
+        OP_ITOF, 0, 1, 0,
+        OP_REG_FCONST, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0xF8, 0x3F,
+        OP_GT_F, 0, 0, 1,
+        OP_REG_RET, 0, 0, 0
+    };
+
+    cnd_program prog = {};
+    prog.bytecode = bytecode;
+    prog.bytecode_len = sizeof(bytecode);
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_OK);
+
+    bytecode[7] = CND_EXPR_REGS; // Register out of range
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_INVALID_OP);
+    bytecode[7] = 1 | CND_EXPR_IMM;
+
+    bytecode[27] = 0 | CND_EXPR_IMM; // Immediates are for integer operations only
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_INVALID_OP);
+    bytecode[27] = 0;
+
+    bytecode[33] = 2; // Results are integer or float
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_INVALID_OP);
+    bytecode[33] = 0;
+
+    bytecode[30] = OP_NOOP; // Must end in OP_REG_RET
+    EXPECT_EQ(cnd_verify_program(&prog), CND_ERR_INVALID_OP);
+    bytecode[30] = OP_REG_RET;
+
+    bytecode[1] = 28; // Length must cover whole instructions
+    EXPECT_NE(cnd_verify_program(&prog), CND_ERR_OK);
+}
@@ -1433,6 +1433,44 @@ TEST_F(VmAluTest, JumpIfNotTaken) {
     EXPECT_EQ(ctx.expr_stack[1], 2);
 }
 
+TEST_F(ConcordiaTest, CallKeyBase) {
+    // Key 1 at top level; the body's Key 0 is Key 5 under base 5, Key 7 under base 7
+    g_test_data[0].key = 1; g_test_data[0].u64_val = 0x11;
+    g_test_data[1].key = 5; g_test_data[1].u64_val = 0x55;
+    g_test_data[2].key = 7; g_test_data[2].u64_val = 0x77;
+    uint8_t il[] = {
+        OP_IO_U8, 0x01, 0x00,
+        OP_CALL, 0x05, 0x00, 0x01, 0x00, 10, 0, 0, 0,
+        OP_CALL, 0x07, 0x00, 0x01, 0x00, 1, 0, 0, 0,
+        OP_RET,
+        OP_IO_U8, 0x00, 0x00,
+        OP_RET
+    };
+
+    memset(m_buffer, 0, sizeof(m_buffer));
+    cnd_program_load(&program, il, sizeof(il));
+    cnd_init(&ctx, CND_MODE_ENCODE, &program, m_buffer, sizeof(m_buffer), test_io_callback, NULL);
+    ASSERT_EQ(cnd_execute(&ctx), CND_ERR_OK);
+    EXPECT_EQ(ctx.cursor, 3u);
+    EXPECT_EQ(m_buffer[0], 0x11);
+    EXPECT_EQ(m_buffer[1], 0x55);
+    EXPECT_EQ(m_buffer[2], 0x77);
+    EXPECT_EQ(ctx.call_depth, 0);
+    EXPECT_EQ(ctx.key_base, 0);
+}
+
+TEST_F(ConcordiaTest, CallDepthLimit) {
+    // A subroutine calling itself
+    uint8_t il[] = {
+        OP_CALL, 0x00, 0x00, 0x00, 0x00, 0xF7, 0xFF, 0xFF, 0xFF
+    };
+
+    cnd_program_load(&program, il, sizeof(il));
+    cnd_init(&ctx, CND_MODE_DECODE, &program, m_buffer, sizeof(m_buffer), test_io_callback, NULL);
+    EXPECT_EQ(cnd_execute(&ctx), CND_ERR_STACK_OVERFLOW);
+    EXPECT_EQ(ctx.call_depth, CND_MAX_CALL_DEPTH);
+}
+
 TEST_F(ConcordiaTest, PolyCrashRepro) {
     const char* schema = "packet P { @poly(0.5, 2.0, 1.5) uint8 val; }";
     CompileAndLoad(schema);